@@ -0,0 +1,184 @@
+#include "AssetStreamer.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+    struct PendingOrder
+    {
+        template <typename T>
+        bool operator()(const T& a, const T& b) const
+        {
+            // std::push_heap keeps the largest element on top.
+            if (a.request.priority != b.request.priority)
+            {
+                return a.request.priority < b.request.priority;
+            }
+            return a.sequence > b.sequence;
+        }
+    };
+}
+
+AssetStreamer::AssetStreamer(StreamingCopyQueue& copyQueue, ThreadPool& loaders) :
+    _copyQueue(copyQueue),
+    _loaders(loaders),
+    _staging(copyQueue.GetStagingSize())
+{
+}
+
+AssetStreamer::~AssetStreamer()
+{
+    // Loader jobs write into tickets owned by this object.
+    std::unique_lock<std::mutex> lock(_loadMutex);
+    _loadsFinished.wait(lock, [this]() { return _loadsInFlight == 0; });
+}
+
+void AssetStreamer::Request(StreamingRequest request)
+{
+    if (request.stagingBytes > _staging.GetCapacity())
+    {
+        throw std::length_error("Streaming request does not fit in the staging buffer.");
+    }
+
+    PendingRequest pending;
+    pending.request = std::move(request);
+    pending.sequence = _nextSequence++;
+    pending.requestTime = std::chrono::steady_clock::now();
+
+    _pending.push_back(std::move(pending));
+    std::push_heap(_pending.begin(), _pending.end(), PendingOrder());
+}
+
+void AssetStreamer::Update()
+{
+    _completed.clear();
+    _failed.clear();
+
+    RetireCompleted();
+    SubmitLoaded();
+    DispatchPending();
+
+    _stats.pendingRequests = static_cast<uint32_t>(_pending.size());
+    _stats.loadingRequests = 0;
+    _stats.copiesInFlight = 0;
+    for (const std::unique_ptr<Ticket>& ticket : _tickets)
+    {
+        const TicketState state = ticket->state;
+        _stats.loadingRequests += state == TicketState::Loading || state == TicketState::Loaded;
+        _stats.copiesInFlight += state == TicketState::Submitted;
+    }
+    _stats.stagingBytesUsed = _staging.GetUsedSize();
+    _stats.averageLatencyMilliseconds = _stats.completedAssets > 0 ? _totalLatencyMilliseconds / _stats.completedAssets : 0.0;
+}
+
+void AssetStreamer::RetireCompleted()
+{
+    const uint64_t completedFence = _copyQueue.GetCompletedFenceValue();
+    const auto now = std::chrono::steady_clock::now();
+
+    for (std::unique_ptr<Ticket>& ticket : _tickets)
+    {
+        const TicketState state = ticket->state;
+        if (state == TicketState::Submitted && ticket->fenceValue <= completedFence)
+        {
+            _completed.push_back(ticket->request.assetId);
+            _stats.completedAssets++;
+            _stats.bytesStreamed += ticket->request.stagingBytes;
+            _totalLatencyMilliseconds += std::chrono::duration<double, std::milli>(now - ticket->requestTime).count();
+            ticket->state = TicketState::Done;
+        }
+        else if (state == TicketState::Failed)
+        {
+            _failed.push_back(ticket->request.assetId);
+            ticket->state = TicketState::Done;
+        }
+    }
+
+    // Staging memory is handed back in allocation order, so a slow load holds
+    // back the memory of the tickets behind it.
+    while (!_tickets.empty() && _tickets.front()->state == TicketState::Done)
+    {
+        _tickets.pop_front();
+        _firstTicket++;
+    }
+    _staging.Retire(_firstTicket - 1);
+}
+
+void AssetStreamer::SubmitLoaded()
+{
+    _copies.clear();
+    std::vector<Ticket*> submitted;
+    for (std::unique_ptr<Ticket>& ticket : _tickets)
+    {
+        if (ticket->state == TicketState::Loaded)
+        {
+            StreamingCopy copy;
+            copy.assetId = ticket->request.assetId;
+            copy.stagingOffset = ticket->stagingOffset;
+            copy.record = ticket->request.record;
+            _copies.push_back(std::move(copy));
+            submitted.push_back(ticket.get());
+        }
+    }
+
+    if (_copies.empty())
+    {
+        return;
+    }
+
+    const uint64_t fenceValue = _copyQueue.Submit(_copies.data(), _copies.size());
+    for (Ticket* pTicket : submitted)
+    {
+        pTicket->fenceValue = fenceValue;
+        pTicket->state = TicketState::Submitted;
+    }
+}
+
+void AssetStreamer::DispatchPending()
+{
+    uint8_t* pStagingMemory = _copyQueue.GetStagingMemory();
+
+    while (!_pending.empty())
+    {
+        // Strict priority order: a big request at the top waits for room rather
+        // than being overtaken by smaller ones forever.
+        PendingRequest& top = _pending.front();
+        uint64_t offset = 0;
+        if (!_staging.Allocate(top.request.stagingBytes, top.request.stagingAlignment, &offset))
+        {
+            break;
+        }
+
+        const uint64_t ticketNumber = _firstTicket + _tickets.size();
+        _staging.EndFrame(ticketNumber);
+
+        std::unique_ptr<Ticket> ticket(new Ticket());
+        ticket->request = std::move(top.request);
+        ticket->stagingOffset = offset;
+        ticket->fenceValue = 0;
+        ticket->state = TicketState::Loading;
+        ticket->requestTime = top.requestTime;
+
+        std::pop_heap(_pending.begin(), _pending.end(), PendingOrder());
+        _pending.pop_back();
+
+        Ticket* pTicket = ticket.get();
+        _tickets.push_back(std::move(ticket));
+
+        {
+            std::lock_guard<std::mutex> lock(_loadMutex);
+            _loadsInFlight++;
+        }
+
+        _loaders.Submit([this, pTicket, pStagingMemory]()
+        {
+            const bool loaded = pTicket->request.load(pStagingMemory + pTicket->stagingOffset);
+            pTicket->state = loaded ? TicketState::Loaded : TicketState::Failed;
+
+            std::lock_guard<std::mutex> lock(_loadMutex);
+            _loadsInFlight--;
+            _loadsFinished.notify_all();
+        });
+    }
+}
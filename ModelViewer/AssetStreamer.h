@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "ThreadPool.h"
+#include "UploadRing.h"
+
+// Records the copy of one asset out of the staging buffer. pCopyContext is
+// whatever the copy queue records into (an ID3D12GraphicsCommandList for D3D12).
+typedef std::function<void(void* pCopyContext, uint64_t stagingOffset)> StreamingRecordFunction;
+
+struct StreamingCopy
+{
+    uint64_t assetId;
+    uint64_t stagingOffset;
+    StreamingRecordFunction record;
+};
+
+// Queue the streamer submits its copies to. Copies run asynchronously to the
+// frame and complete when the returned fence value is reached.
+class StreamingCopyQueue
+{
+public: virtual ~StreamingCopyQueue() {}
+
+public: virtual uint8_t* GetStagingMemory() = 0;
+public: virtual uint64_t GetStagingSize() const = 0;
+
+public: virtual uint64_t Submit(const StreamingCopy* pCopies, size_t count) = 0;
+public: virtual uint64_t GetCompletedFenceValue() = 0;
+};
+
+struct StreamingRequest
+{
+    uint64_t assetId;
+    int priority;                   // Higher is loaded first.
+    uint64_t stagingBytes;
+    uint64_t stagingAlignment;
+
+    // Runs on a loader thread and fills the staging memory. Returning false
+    // drops the request; it is then reported through GetFailed().
+    std::function<bool(uint8_t* pStaging)> load;
+    StreamingRecordFunction record;
+};
+
+struct AssetStreamerStats
+{
+    uint32_t pendingRequests;
+    uint32_t loadingRequests;
+    uint32_t copiesInFlight;
+    uint64_t stagingBytesUsed;
+    uint64_t bytesStreamed;
+    uint64_t completedAssets;
+    double averageLatencyMilliseconds;  // Request to copy completion.
+};
+
+// Background asset streaming. Requests wait in a priority queue until the
+// staging buffer has room for them, a loader thread fills their staging
+// memory, then the render thread batches every loaded asset into one copy
+// queue submission. Update() never blocks: it is meant to be called once per
+// frame, and assets whose copy fence has passed show up in GetCompleted().
+class AssetStreamer
+{
+public: AssetStreamer(StreamingCopyQueue& copyQueue, ThreadPool& loaders);
+public: ~AssetStreamer();
+
+public: void Request(StreamingRequest request);
+
+public: void Update();
+
+    // Assets that finished during the last Update().
+public: const std::vector<uint64_t>& GetCompleted() const { return _completed; }
+public: const std::vector<uint64_t>& GetFailed() const { return _failed; }
+
+public: const AssetStreamerStats& GetStats() const { return _stats; }
+
+private: enum class TicketState
+    {
+        Loading,
+        Loaded,
+        Failed,
+        Submitted,
+        Done,
+    };
+
+    // A request that owns staging memory. Tickets are numbered in allocation
+    // order, which is also the order the staging ring frees them in.
+private: struct Ticket
+    {
+        StreamingRequest request;
+        uint64_t stagingOffset;
+        uint64_t fenceValue;
+        std::atomic<TicketState> state;
+        std::chrono::steady_clock::time_point requestTime;
+    };
+
+private: struct PendingRequest
+    {
+        StreamingRequest request;
+        uint64_t sequence;
+        std::chrono::steady_clock::time_point requestTime;
+    };
+
+private: void RetireCompleted();
+private: void SubmitLoaded();
+private: void DispatchPending();
+
+private: StreamingCopyQueue& _copyQueue;
+private: ThreadPool& _loaders;
+private: UploadRing _staging;
+
+private: std::vector<PendingRequest> _pending;     // Heap ordered by priority, then request order.
+private: uint64_t _nextSequence = 0;
+
+private: std::deque<std::unique_ptr<Ticket>> _tickets;
+private: uint64_t _firstTicket = 1;
+
+private: std::mutex _loadMutex;
+private: std::condition_variable _loadsFinished;
+private: uint32_t _loadsInFlight = 0;
+
+private: std::vector<StreamingCopy> _copies;
+private: std::vector<uint64_t> _completed;
+private: std::vector<uint64_t> _failed;
+private: AssetStreamerStats _stats = {};
+private: double _totalLatencyMilliseconds = 0.0;
+};
@@ -0,0 +1,226 @@
+#include "AssetStreamer.h"
+#include "UnitTest.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+    // Stands in for D3D12CopyQueue: copies run when Submit() is called, by
+    // the record function reading the staging memory, and the fence only
+    // moves when the test says the GPU got there.
+    class FakeCopyQueue : public StreamingCopyQueue
+    {
+    public: explicit FakeCopyQueue(uint64_t stagingSize) :
+            _staging(static_cast<size_t>(stagingSize), 0)
+        {
+        }
+
+    public: uint8_t* GetStagingMemory() override { return _staging.data(); }
+    public: uint64_t GetStagingSize() const override { return _staging.size(); }
+
+    public: uint64_t Submit(const StreamingCopy* pCopies, size_t count) override
+        {
+            submissions.push_back(std::vector<uint64_t>());
+            for (size_t i = 0; i < count; i++)
+            {
+                submissions.back().push_back(pCopies[i].assetId);
+                pCopies[i].record(this, pCopies[i].stagingOffset);
+            }
+            return ++submittedFence;
+        }
+
+    public: uint64_t GetCompletedFenceValue() override { return completedFence; }
+
+    public: const uint8_t* GetStaging(uint64_t offset) const { return _staging.data() + offset; }
+
+    public: std::vector<std::vector<uint64_t>> submissions;
+    public: uint64_t submittedFence = 0;
+    public: uint64_t completedFence = 0;
+
+    private: std::vector<uint8_t> _staging;
+    };
+
+    // Each asset fills its staging bytes with its id; the copy reads them
+    // back, so an allocation overwritten before its copy shows up.
+    struct StreamedAssets
+    {
+        std::mutex mutex;
+        std::vector<uint64_t> loadOrder;
+        std::map<uint64_t, std::vector<uint8_t>> copied;
+        std::vector<uint64_t> offsets;
+    };
+
+    StreamingRequest MakeRequest(StreamedAssets* pAssets, uint64_t assetId, int priority, uint64_t bytes, bool fails = false)
+    {
+        StreamingRequest request;
+        request.assetId = assetId;
+        request.priority = priority;
+        request.stagingBytes = bytes;
+        request.stagingAlignment = 16;
+        request.load = [pAssets, assetId, bytes, fails](uint8_t* pStaging)
+        {
+            memset(pStaging, static_cast<int>(assetId & 0xff), static_cast<size_t>(bytes));
+            std::lock_guard<std::mutex> lock(pAssets->mutex);
+            pAssets->loadOrder.push_back(assetId);
+            return !fails;
+        };
+        request.record = [pAssets, assetId, bytes](void* pCopyContext, uint64_t stagingOffset)
+        {
+            const uint8_t* pData = static_cast<FakeCopyQueue*>(pCopyContext)->GetStaging(stagingOffset);
+            pAssets->copied[assetId].assign(pData, pData + bytes);
+            pAssets->offsets.push_back(stagingOffset);
+        };
+        return request;
+    }
+
+    bool CopiedIntact(const StreamedAssets& assets, uint64_t assetId, uint64_t bytes)
+    {
+        auto found = assets.copied.find(assetId);
+        if (found == assets.copied.end() || found->second.size() != bytes)
+        {
+            return false;
+        }
+        for (uint8_t value : found->second)
+        {
+            if (value != (assetId & 0xff))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Loads start by priority, then request order; every loaded asset of an
+    // Update() goes out in one submission, and completes with its fence.
+    void TestOrderingAndRetirement()
+    {
+        FakeCopyQueue queue(4096);
+        ThreadPool loaders(1);
+        AssetStreamer streamer(queue, loaders);
+        StreamedAssets assets;
+
+        streamer.Request(MakeRequest(&assets, 1, 0, 100));
+        streamer.Request(MakeRequest(&assets, 2, 5, 100));
+        streamer.Request(MakeRequest(&assets, 3, 0, 100));
+        streamer.Request(MakeRequest(&assets, 4, 5, 100));
+        streamer.Update();
+        CHECK(streamer.GetStats().pendingRequests == 0);
+        loaders.WaitIdle();
+
+        const uint64_t expectedOrder[] = { 2, 4, 1, 3 };
+        CHECK(assets.loadOrder == std::vector<uint64_t>(expectedOrder, expectedOrder + 4));
+
+        streamer.Update();
+        CHECK(queue.submissions.size() == 1);
+        CHECK(queue.submissions[0].size() == 4);
+        CHECK(streamer.GetCompleted().empty());
+        CHECK(streamer.GetStats().copiesInFlight == 4);
+        CHECK(streamer.GetStats().stagingBytesUsed >= 400);
+
+        // Nothing completes before the fence does.
+        streamer.Update();
+        CHECK(streamer.GetCompleted().empty());
+        CHECK(queue.submissions.size() == 1);
+
+        queue.completedFence = queue.submittedFence;
+        streamer.Update();
+        std::vector<uint64_t> completed = streamer.GetCompleted();
+        std::sort(completed.begin(), completed.end());
+        CHECK(completed == std::vector<uint64_t>({ 1, 2, 3, 4 }));
+        for (uint64_t assetId = 1; assetId <= 4; assetId++)
+        {
+            CHECK(CopiedIntact(assets, assetId, 100));
+        }
+
+        const AssetStreamerStats& stats = streamer.GetStats();
+        CHECK(stats.completedAssets == 4);
+        CHECK(stats.bytesStreamed == 400);
+        CHECK(stats.copiesInFlight == 0);
+        CHECK(stats.stagingBytesUsed == 0);
+        CHECK(stats.averageLatencyMilliseconds >= 0.0);
+
+        // Reported once.
+        streamer.Update();
+        CHECK(streamer.GetCompleted().empty());
+    }
+
+    // Far more than the staging buffer holds, fed through with the fence a
+    // frame behind: allocations wrap around, none is reused before its copy
+    // retired, and everything arrives intact.
+    void TestStagingWraparound()
+    {
+        const uint64_t stagingSize = 1000;
+        const uint64_t assetBytes = 300;
+        FakeCopyQueue queue(stagingSize);
+        ThreadPool loaders(2);
+        AssetStreamer streamer(queue, loaders);
+        StreamedAssets assets;
+
+        const uint64_t assetCount = 40;
+        for (uint64_t assetId = 1; assetId <= assetCount; assetId++)
+        {
+            streamer.Request(MakeRequest(&assets, assetId, 0, assetBytes));
+        }
+
+        uint64_t completed = 0;
+        bool wrapped = false;
+        for (int frame = 0; frame < 1000 && completed < assetCount; frame++)
+        {
+            const uint64_t previousFence = queue.submittedFence;
+            streamer.Update();
+            completed += streamer.GetCompleted().size();
+            CHECK(streamer.GetStats().stagingBytesUsed <= stagingSize);
+            loaders.WaitIdle();
+            queue.completedFence = previousFence;
+        }
+        CHECK(completed == assetCount);
+        for (size_t i = 1; i < assets.offsets.size(); i++)
+        {
+            wrapped = wrapped || assets.offsets[i] < assets.offsets[i - 1];
+        }
+        CHECK(wrapped);
+        for (uint64_t assetId = 1; assetId <= assetCount; assetId++)
+        {
+            CHECK(CopiedIntact(assets, assetId, assetBytes));
+        }
+        CHECK(streamer.GetStats().stagingBytesUsed == 0);
+        CHECK(streamer.GetStats().bytesStreamed == assetCount * assetBytes);
+    }
+
+    // A failed load is reported and gives its staging memory back; the ones
+    // behind it still go through.
+    void TestFailedLoad()
+    {
+        FakeCopyQueue queue(1024);
+        ThreadPool loaders(1);
+        AssetStreamer streamer(queue, loaders);
+        StreamedAssets assets;
+
+        streamer.Request(MakeRequest(&assets, 1, 0, 500, true));
+        streamer.Request(MakeRequest(&assets, 2, 0, 500));
+        streamer.Update();
+        loaders.WaitIdle();
+        streamer.Update();
+        CHECK(streamer.GetFailed() == std::vector<uint64_t>({ 1 }));
+        CHECK(queue.submissions.size() == 1);
+        CHECK(queue.submissions[0] == std::vector<uint64_t>({ 2 }));
+
+        queue.completedFence = queue.submittedFence;
+        streamer.Update();
+        CHECK(streamer.GetCompleted() == std::vector<uint64_t>({ 2 }));
+        CHECK(streamer.GetStats().stagingBytesUsed == 0);
+        CHECK(streamer.GetStats().completedAssets == 1);
+    }
+}
+
+int main()
+{
+    TestOrderingAndRetirement();
+    TestStagingWraparound();
+    TestFailedLoad();
+    return TestFailures();
+}
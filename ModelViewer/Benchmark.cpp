@@ -0,0 +1,977 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+    const double DefaultMinimumMilliseconds = 0.05;
+
+    // The camera's near plane; light clusters start there too.
+    const float BenchmarkNearZ = 0.1f;
+
+    // D3D12_RESOURCE_STATE_PRESENT and D3D12_RESOURCE_STATE_RENDER_TARGET.
+    const uint32_t PresentState = 0x0;
+    const uint32_t RenderTargetState = 0x4;
+
+    bool IsKnownMetric(const std::string& metric)
+    {
+        return metric == "mean" || metric == "p50" || metric == "p95" || metric == "p99" || metric == "max";
+    }
+
+    double GetMetric(const BenchmarkMetrics& metrics, const std::string& metric)
+    {
+        if (metric == "mean")
+        {
+            return metrics.mean;
+        }
+        if (metric == "p50")
+        {
+            return metrics.p50;
+        }
+        if (metric == "p95")
+        {
+            return metrics.p95;
+        }
+        if (metric == "p99")
+        {
+            return metrics.p99;
+        }
+        return metrics.max;
+    }
+
+    BenchmarkMetrics ComputeMetrics(std::vector<double> values)
+    {
+        BenchmarkMetrics metrics = {};
+        if (values.empty())
+        {
+            return metrics;
+        }
+
+        std::sort(values.begin(), values.end());
+        double total = 0.0;
+        for (double value : values)
+        {
+            total += value;
+        }
+
+        const size_t count = values.size();
+        metrics.mean = total / count;
+        metrics.p50 = values[GetNearestRankIndex(count, 0.50)];
+        metrics.p95 = values[GetNearestRankIndex(count, 0.95)];
+        metrics.p99 = values[GetNearestRankIndex(count, 0.99)];
+        metrics.max = values.back();
+        return metrics;
+    }
+
+    // xorshift32: the same scene from the same seed on every platform.
+    uint32_t NextRandom(uint32_t* pState)
+    {
+        uint32_t x = *pState;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        *pState = x;
+        return x;
+    }
+
+    void Normalize(float v[3])
+    {
+        const float length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+        if (length > 0.0f)
+        {
+            v[0] /= length;
+            v[1] /= length;
+            v[2] /= length;
+        }
+    }
+
+    void Cross(const float a[3], const float b[3], float result[3])
+    {
+        result[0] = a[1] * b[2] - a[2] * b[1];
+        result[1] = a[2] * b[0] - a[0] * b[2];
+        result[2] = a[0] * b[1] - a[1] * b[0];
+    }
+
+    float Dot(const float a[3], const float b[3])
+    {
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    }
+
+    // Just enough JSON to read reports back: objects, arrays, strings and numbers.
+    struct JsonValue
+    {
+        enum class Type
+        {
+            Null,
+            Number,
+            String,
+            Object,
+            Array,
+        };
+
+        Type type = Type::Null;
+        double number = 0.0;
+        std::string string;
+        std::vector<std::pair<std::string, JsonValue>> members;
+        std::vector<JsonValue> elements;
+
+        const JsonValue* Find(const char* name) const
+        {
+            for (const std::pair<std::string, JsonValue>& member : members)
+            {
+                if (member.first == name)
+                {
+                    return &member.second;
+                }
+            }
+            return nullptr;
+        }
+    };
+
+    class JsonReader
+    {
+    public: explicit JsonReader(const std::string& text) : _text(text), _position(0) {}
+
+    public: bool Read(JsonValue* pValue, std::string* pError)
+        {
+            if (!ReadValue(pValue))
+            {
+                *pError = "invalid JSON at offset " + std::to_string(_position);
+                return false;
+            }
+            SkipWhitespace();
+            if (_position != _text.size())
+            {
+                *pError = "trailing characters at offset " + std::to_string(_position);
+                return false;
+            }
+            return true;
+        }
+
+    private: void SkipWhitespace()
+        {
+            while (_position < _text.size() && (_text[_position] == ' ' || _text[_position] == '\t' || _text[_position] == '\n' || _text[_position] == '\r'))
+            {
+                _position++;
+            }
+        }
+
+    private: bool Consume(char c)
+        {
+            SkipWhitespace();
+            if (_position < _text.size() && _text[_position] == c)
+            {
+                _position++;
+                return true;
+            }
+            return false;
+        }
+
+    private: bool ReadString(std::string* pString)
+        {
+            if (!Consume('"'))
+            {
+                return false;
+            }
+            pString->clear();
+            while (_position < _text.size())
+            {
+                const char c = _text[_position++];
+                if (c == '"')
+                {
+                    return true;
+                }
+                if (c != '\\')
+                {
+                    pString->push_back(c);
+                    continue;
+                }
+                if (_position >= _text.size())
+                {
+                    return false;
+                }
+                const char escaped = _text[_position++];
+                switch (escaped)
+                {
+                case 'n': pString->push_back('\n'); break;
+                case 't': pString->push_back('\t'); break;
+                case 'r': pString->push_back('\r'); break;
+                case 'b': pString->push_back('\b'); break;
+                case 'f': pString->push_back('\f'); break;
+                case 'u':
+                    // Only what AppendJsonString() writes: control characters.
+                    if (_position + 4 > _text.size())
+                    {
+                        return false;
+                    }
+                    pString->push_back(static_cast<char>(strtoul(_text.substr(_position, 4).c_str(), nullptr, 16)));
+                    _position += 4;
+                    break;
+                default: pString->push_back(escaped); break;
+                }
+            }
+            return false;
+        }
+
+    private: bool ReadValue(JsonValue* pValue)
+        {
+            SkipWhitespace();
+            if (_position >= _text.size())
+            {
+                return false;
+            }
+
+            const char c = _text[_position];
+            if (c == '{')
+            {
+                _position++;
+                pValue->type = JsonValue::Type::Object;
+                if (Consume('}'))
+                {
+                    return true;
+                }
+                do
+                {
+                    std::pair<std::string, JsonValue> member;
+                    if (!ReadString(&member.first) || !Consume(':') || !ReadValue(&member.second))
+                    {
+                        return false;
+                    }
+                    pValue->members.push_back(std::move(member));
+                } while (Consume(','));
+                return Consume('}');
+            }
+            if (c == '[')
+            {
+                _position++;
+                pValue->type = JsonValue::Type::Array;
+                if (Consume(']'))
+                {
+                    return true;
+                }
+                do
+                {
+                    JsonValue element;
+                    if (!ReadValue(&element))
+                    {
+                        return false;
+                    }
+                    pValue->elements.push_back(std::move(element));
+                } while (Consume(','));
+                return Consume(']');
+            }
+            if (c == '"')
+            {
+                pValue->type = JsonValue::Type::String;
+                return ReadString(&pValue->string);
+            }
+            if (_text.compare(_position, 4, "null") == 0)
+            {
+                _position += 4;
+                pValue->type = JsonValue::Type::Null;
+                return true;
+            }
+
+            const char* pBegin = _text.c_str() + _position;
+            char* pEnd = nullptr;
+            pValue->number = strtod(pBegin, &pEnd);
+            if (pEnd == pBegin)
+            {
+                return false;
+            }
+            pValue->type = JsonValue::Type::Number;
+            _position += pEnd - pBegin;
+            return true;
+        }
+
+    private: const std::string& _text;
+    private: size_t _position;
+    };
+
+    void AppendMetrics(const BenchmarkMetrics& metrics, std::string* pJson)
+    {
+        char text[192];
+        snprintf(text, sizeof(text), "{\"mean\":%.4f,\"p50\":%.4f,\"p95\":%.4f,\"p99\":%.4f,\"max\":%.4f}",
+            metrics.mean, metrics.p50, metrics.p95, metrics.p99, metrics.max);
+        pJson->append(text);
+    }
+
+    bool ReadMetrics(const JsonValue* pValue, BenchmarkMetrics* pMetrics)
+    {
+        if (pValue == nullptr || pValue->type != JsonValue::Type::Object)
+        {
+            return false;
+        }
+
+        const char* const names[] = { "mean", "p50", "p95", "p99", "max" };
+        double* const fields[] = { &pMetrics->mean, &pMetrics->p50, &pMetrics->p95, &pMetrics->p99, &pMetrics->max };
+        for (size_t i = 0; i < 5; i++)
+        {
+            const JsonValue* pField = pValue->Find(names[i]);
+            if (pField == nullptr || pField->type != JsonValue::Type::Number)
+            {
+                return false;
+            }
+            *fields[i] = pField->number;
+        }
+        return true;
+    }
+}
+
+bool ParseBenchmarkScript(const std::string& text, BenchmarkScript* pScript, std::string* pError)
+{
+    BenchmarkScript script;
+    std::istringstream lines(text);
+    std::string line;
+    for (int lineNumber = 1; std::getline(lines, line); lineNumber++)
+    {
+        const size_t comment = line.find('#');
+        if (comment != std::string::npos)
+        {
+            line.resize(comment);
+        }
+
+        std::istringstream tokens(line);
+        std::string directive;
+        if (!(tokens >> directive))
+        {
+            continue;
+        }
+
+        bool valid = true;
+        if (directive == "name")
+        {
+            std::getline(tokens >> std::ws, script.name);
+            valid = !script.name.empty();
+        }
+        else if (directive == "frames")
+        {
+            valid = static_cast<bool>(tokens >> script.warmupFrames >> script.measuredFrames) && script.measuredFrames > 0;
+        }
+        else if (directive == "step")
+        {
+            valid = static_cast<bool>(tokens >> script.stepSeconds) && script.stepSeconds > 0.0;
+        }
+        else if (directive == "seed")
+        {
+            valid = static_cast<bool>(tokens >> script.seed);
+        }
+        else if (directive == "grid")
+        {
+            valid = static_cast<bool>(tokens >> script.gridX >> script.gridY >> script.spacing >> script.meshCount >> script.materialCount) &&
+                script.meshCount > 0 && script.materialCount > 0;
+        }
+        else if (directive == "lights")
+        {
+            valid = static_cast<bool>(tokens >> script.lightCount >> script.lightRadius) && script.lightRadius > 0.0f;
+        }
+        else if (directive == "fov")
+        {
+            valid = static_cast<bool>(tokens >> script.fieldOfViewDegrees) && script.fieldOfViewDegrees > 0.0f && script.fieldOfViewDegrees < 180.0f;
+        }
+        else if (directive == "camera")
+        {
+            BenchmarkCameraKey key;
+            valid = static_cast<bool>(tokens >> key.time >> key.position[0] >> key.position[1] >> key.position[2] >> key.target[0] >> key.target[1] >> key.target[2]);
+            if (valid)
+            {
+                script.camera.push_back(key);
+            }
+        }
+        else if (directive == "threshold")
+        {
+            BenchmarkThreshold threshold;
+            threshold.minimumMilliseconds = DefaultMinimumMilliseconds;
+            valid = static_cast<bool>(tokens >> threshold.stage >> threshold.metric >> threshold.percent) && IsKnownMetric(threshold.metric);
+            if (valid)
+            {
+                tokens >> threshold.minimumMilliseconds;
+                script.thresholds.push_back(threshold);
+            }
+        }
+        else
+        {
+            *pError = "line " + std::to_string(lineNumber) + ": unknown directive '" + directive + "'";
+            return false;
+        }
+
+        if (!valid)
+        {
+            *pError = "line " + std::to_string(lineNumber) + ": invalid '" + directive + "'";
+            return false;
+        }
+    }
+
+    std::stable_sort(script.camera.begin(), script.camera.end(), [](const BenchmarkCameraKey& a, const BenchmarkCameraKey& b)
+    {
+        return a.time < b.time;
+    });
+
+    *pScript = std::move(script);
+    return true;
+}
+
+void BuildBenchmarkScene(const BenchmarkScript& script, std::vector<DrawItem>* pItems)
+{
+    pItems->clear();
+    pItems->reserve(static_cast<size_t>(script.gridX) * script.gridY);
+
+    uint32_t random = script.seed != 0 ? script.seed : 1;
+    const float centerX = (static_cast<float>(script.gridX) - 1.0f) * 0.5f;
+    const float centerY = (static_cast<float>(script.gridY) - 1.0f) * 0.5f;
+    for (uint32_t y = 0; y < script.gridY; y++)
+    {
+        for (uint32_t x = 0; x < script.gridX; x++)
+        {
+            DrawItem item;
+            item.meshId = NextRandom(&random) % script.meshCount;
+            item.materialId = NextRandom(&random) % script.materialCount;
+
+            // Scale, then yaw, then translation on the ground plane.
+            const float yaw = (NextRandom(&random) & 0xffff) / 65536.0f * 6.2831853f;
+            const float scale = 0.5f + (NextRandom(&random) & 0xffff) / 65536.0f;
+            const float c = std::cos(yaw) * scale;
+            const float s = std::sin(yaw) * scale;
+            const float world[16] =
+            {
+                c, 0.0f, -s, 0.0f,
+                0.0f, scale, 0.0f, 0.0f,
+                s, 0.0f, c, 0.0f,
+                (x - centerX) * script.spacing, 0.0f, (y - centerY) * script.spacing, 1.0f,
+            };
+            std::copy(world, world + 16, item.world);
+            pItems->push_back(item);
+        }
+    }
+}
+
+void BuildBenchmarkLights(const BenchmarkScript& script, std::vector<PointLight>* pLights)
+{
+    pLights->clear();
+    pLights->reserve(script.lightCount);
+
+    // A stream of its own, so adding lights leaves the objects where they were.
+    uint32_t random = (script.seed != 0 ? script.seed : 1) ^ 0x9e3779b9u;
+    const float width = std::max(static_cast<float>(script.gridX), 1.0f) * script.spacing;
+    const float depth = std::max(static_cast<float>(script.gridY), 1.0f) * script.spacing;
+    for (uint32_t i = 0; i < script.lightCount; i++)
+    {
+        PointLight light;
+        light.position[0] = ((NextRandom(&random) & 0xffff) / 65536.0f - 0.5f) * width;
+        light.position[1] = (NextRandom(&random) & 0xffff) / 65536.0f * 4.0f;
+        light.position[2] = ((NextRandom(&random) & 0xffff) / 65536.0f - 0.5f) * depth;
+        light.radius = script.lightRadius * (0.5f + (NextRandom(&random) & 0xffff) / 65536.0f);
+        for (int c = 0; c < 3; c++)
+        {
+            light.color[c] = 0.25f + (NextRandom(&random) & 0xffff) / 65536.0f * 0.75f;
+        }
+        light.intensity = 1.0f;
+        pLights->push_back(light);
+    }
+}
+
+void EvaluateBenchmarkView(const BenchmarkScript& script, uint64_t frameNumber, float view[16])
+{
+    for (int i = 0; i < 16; i++)
+    {
+        view[i] = i % 5 == 0 ? 1.0f : 0.0f;
+    }
+    if (script.camera.empty())
+    {
+        return;
+    }
+
+    // Linear between keys, held before the first and after the last.
+    const float time = static_cast<float>(frameNumber * script.stepSeconds);
+    const std::vector<BenchmarkCameraKey>& keys = script.camera;
+    size_t next = 0;
+    while (next < keys.size() && keys[next].time <= time)
+    {
+        next++;
+    }
+    const BenchmarkCameraKey& a = keys[next == 0 ? 0 : next - 1];
+    const BenchmarkCameraKey& b = keys[next == keys.size() ? keys.size() - 1 : next];
+    const float t = b.time > a.time ? std::min(std::max((time - a.time) / (b.time - a.time), 0.0f), 1.0f) : 0.0f;
+
+    float eye[3];
+    float target[3];
+    for (int i = 0; i < 3; i++)
+    {
+        eye[i] = a.position[i] + (b.position[i] - a.position[i]) * t;
+        target[i] = a.target[i] + (b.target[i] - a.target[i]) * t;
+    }
+
+    // XMMatrixLookAtLH.
+    float zAxis[3] = { target[0] - eye[0], target[1] - eye[1], target[2] - eye[2] };
+    Normalize(zAxis);
+    float up[3] = { 0.0f, 1.0f, 0.0f };
+    if (std::fabs(zAxis[1]) > 0.999f)
+    {
+        up[1] = 0.0f;
+        up[2] = 1.0f;
+    }
+    float xAxis[3];
+    Cross(up, zAxis, xAxis);
+    Normalize(xAxis);
+    float yAxis[3];
+    Cross(zAxis, xAxis, yAxis);
+
+    const float lookAt[16] =
+    {
+        xAxis[0], yAxis[0], zAxis[0], 0.0f,
+        xAxis[1], yAxis[1], zAxis[1], 0.0f,
+        xAxis[2], yAxis[2], zAxis[2], 0.0f,
+        -Dot(xAxis, eye), -Dot(yAxis, eye), -Dot(zAxis, eye), 1.0f,
+    };
+    std::copy(lookAt, lookAt + 16, view);
+}
+
+void EvaluateBenchmarkCamera(const BenchmarkScript& script, uint64_t frameNumber, float aspectRatio, float viewProjection[16])
+{
+    for (int i = 0; i < 16; i++)
+    {
+        viewProjection[i] = i % 5 == 0 ? 1.0f : 0.0f;
+    }
+    if (script.camera.empty())
+    {
+        return;
+    }
+
+    float view[16];
+    EvaluateBenchmarkView(script, frameNumber, view);
+
+    // Reverse-Z with no far plane, see DepthPass.h.
+    float projection[16];
+    MakeReverseZPerspective(script.fieldOfViewDegrees * 3.14159265f / 180.0f, aspectRatio, BenchmarkNearZ, projection);
+
+    for (int row = 0; row < 4; row++)
+    {
+        for (int column = 0; column < 4; column++)
+        {
+            float sum = 0.0f;
+            for (int k = 0; k < 4; k++)
+            {
+                sum += view[row * 4 + k] * projection[k * 4 + column];
+            }
+            viewProjection[row * 4 + column] = sum;
+        }
+    }
+}
+
+void SetBenchmarkClusterGrid(const BenchmarkScript& script, float aspectRatio, ClusterLightAssigner* pAssigner)
+{
+    ClusterGridSettings settings;
+    settings.nearZ = BenchmarkNearZ;
+    pAssigner->SetGrid(settings, script.fieldOfViewDegrees * 3.14159265f / 180.0f, aspectRatio);
+}
+
+void RunBenchmark(const BenchmarkScript& script, BenchmarkTarget& target, BenchmarkReport* pReport)
+{
+    target.LoadBenchmarkScene(script);
+
+    std::vector<ProfileEvent> events;
+    for (uint32_t frame = 0; frame < script.warmupFrames; frame++)
+    {
+        events.clear();
+        target.RunBenchmarkFrame(&events);
+    }
+
+    // A stage missing from a frame took no time in it.
+    std::vector<double> frameTimes(script.measuredFrames);
+    std::map<std::string, std::vector<double>> stageTimes;
+    for (uint32_t frame = 0; frame < script.measuredFrames; frame++)
+    {
+        events.clear();
+        const int64_t begin = CpuProfiler::Get().NowNanoseconds();
+        target.RunBenchmarkFrame(&events);
+        const int64_t end = CpuProfiler::Get().NowNanoseconds();
+        frameTimes[frame] = (end - begin) / 1000000.0;
+
+        for (const ProfileEvent& event : events)
+        {
+            std::vector<double>& times = stageTimes[event.name];
+            times.resize(script.measuredFrames);
+            times[frame] += (event.endNanoseconds - event.beginNanoseconds) / 1000000.0;
+        }
+    }
+
+    pReport->name = script.name;
+    pReport->warmupFrames = script.warmupFrames;
+    pReport->measuredFrames = script.measuredFrames;
+    pReport->frameMilliseconds = ComputeMetrics(std::move(frameTimes));
+    pReport->stages.clear();
+    for (std::pair<const std::string, std::vector<double>>& stage : stageTimes)
+    {
+        pReport->stages.push_back({ stage.first, ComputeMetrics(std::move(stage.second)) });
+    }
+}
+
+void WriteBenchmarkJson(const BenchmarkReport& report, std::string* pJson)
+{
+    pJson->assign("{\n  \"name\": ");
+    AppendJsonString(report.name.c_str(), pJson);
+
+    char counts[96];
+    snprintf(counts, sizeof(counts), ",\n  \"warmupFrames\": %u,\n  \"measuredFrames\": %u,\n  \"frame\": ",
+        report.warmupFrames, report.measuredFrames);
+    pJson->append(counts);
+    AppendMetrics(report.frameMilliseconds, pJson);
+
+    pJson->append(",\n  \"stages\": {");
+    for (size_t i = 0; i < report.stages.size(); i++)
+    {
+        pJson->append(i == 0 ? "\n    " : ",\n    ");
+        AppendJsonString(report.stages[i].name.c_str(), pJson);
+        pJson->append(": ");
+        AppendMetrics(report.stages[i].milliseconds, pJson);
+    }
+    pJson->append("\n  }\n}\n");
+}
+
+bool ParseBenchmarkJson(const std::string& json, BenchmarkReport* pReport, std::string* pError)
+{
+    JsonValue root;
+    JsonReader reader(json);
+    if (!reader.Read(&root, pError))
+    {
+        return false;
+    }
+
+    const JsonValue* pName = root.Find("name");
+    const JsonValue* pWarmup = root.Find("warmupFrames");
+    const JsonValue* pMeasured = root.Find("measuredFrames");
+    const JsonValue* pStages = root.Find("stages");
+    BenchmarkReport report;
+    if (pName == nullptr || pName->type != JsonValue::Type::String ||
+        pWarmup == nullptr || pWarmup->type != JsonValue::Type::Number ||
+        pMeasured == nullptr || pMeasured->type != JsonValue::Type::Number ||
+        pStages == nullptr || pStages->type != JsonValue::Type::Object ||
+        !ReadMetrics(root.Find("frame"), &report.frameMilliseconds))
+    {
+        *pError = "not a benchmark report";
+        return false;
+    }
+
+    report.name = pName->string;
+    report.warmupFrames = static_cast<uint32_t>(pWarmup->number);
+    report.measuredFrames = static_cast<uint32_t>(pMeasured->number);
+    for (const std::pair<std::string, JsonValue>& member : pStages->members)
+    {
+        BenchmarkStage stage;
+        stage.name = member.first;
+        if (!ReadMetrics(&member.second, &stage.milliseconds))
+        {
+            *pError = "invalid stage '" + member.first + "'";
+            return false;
+        }
+        report.stages.push_back(stage);
+    }
+
+    *pReport = std::move(report);
+    return true;
+}
+
+bool CompareBenchmarkReports(
+    const BenchmarkReport& baseline,
+    const BenchmarkReport& current,
+    const std::vector<BenchmarkThreshold>& thresholds,
+    std::vector<BenchmarkComparison>* pComparisons)
+{
+    static const BenchmarkThreshold defaultThreshold = { "frame", "p95", 10.0, DefaultMinimumMilliseconds };
+    const BenchmarkThreshold* pThresholds = thresholds.empty() ? &defaultThreshold : thresholds.data();
+    const size_t thresholdCount = thresholds.empty() ? 1 : thresholds.size();
+
+    const auto findStage = [](const BenchmarkReport& report, const std::string& name) -> const BenchmarkMetrics*
+    {
+        for (const BenchmarkStage& stage : report.stages)
+        {
+            if (stage.name == name)
+            {
+                return &stage.milliseconds;
+            }
+        }
+        return nullptr;
+    };
+
+    pComparisons->clear();
+    bool passed = true;
+    const auto check = [&](const BenchmarkThreshold& threshold, const std::string& stage, const BenchmarkMetrics& before, const BenchmarkMetrics& after)
+    {
+        BenchmarkComparison comparison;
+        comparison.stage = stage;
+        comparison.metric = threshold.metric;
+        comparison.baseline = GetMetric(before, threshold.metric);
+        comparison.current = GetMetric(after, threshold.metric);
+        comparison.limit = std::max(comparison.baseline * (1.0 + threshold.percent / 100.0), comparison.baseline + threshold.minimumMilliseconds);
+        comparison.passed = comparison.current <= comparison.limit;
+        passed = passed && comparison.passed;
+        pComparisons->push_back(comparison);
+    };
+
+    for (size_t i = 0; i < thresholdCount; i++)
+    {
+        const BenchmarkThreshold& threshold = pThresholds[i];
+        if (threshold.stage == "frame")
+        {
+            check(threshold, "frame", baseline.frameMilliseconds, current.frameMilliseconds);
+            continue;
+        }
+
+        for (const BenchmarkStage& stage : baseline.stages)
+        {
+            if (threshold.stage != "*" && threshold.stage != stage.name)
+            {
+                continue;
+            }
+            const BenchmarkMetrics* pCurrent = findStage(current, stage.name);
+            if (pCurrent != nullptr)
+            {
+                check(threshold, stage.name, stage.milliseconds, *pCurrent);
+            }
+        }
+    }
+    return passed;
+}
+
+SceneBenchmarkTarget::SceneBenchmarkTarget(bool threaded, const RecordingDeviceDesc& deviceDesc) :
+    _device(deviceDesc),
+    _stateTracker(_resourceStates),
+    _fenceValue(1),
+    _frameIndex(0),
+    _uploadBuffer(UploadRingSize),
+    _uploadRing(UploadRingSize),
+    _threaded(threaded),
+    _useIndirectDraws(false),
+    _useDepthPrepass(true),
+    _clusterLightStats()
+{
+    BuildSceneRootSignatureLayout(&_rootSignatureLayout);
+    _indirectLayout = MakeSceneIndirectLayout(_rootSignatureLayout);
+    _constantBuffers.Reset(&_uploadRing, _uploadBuffer.data(), UploadBufferAddress);
+
+    _commandList = _device.CreateCommandList();
+    _fixupCommandList = _device.CreateCommandList();
+    _fence = _device.CreateFence(0);
+
+    // Stand-ins for the swap chain buffers, with their views like the sample.
+    const RenderHandle rtvHeap = _device.CreateDescriptorHeap(RenderDescriptorType::Rtv, FrameCount);
+    _rtvStart = _device.GetDescriptorHeapStart(rtvHeap);
+    _rtvIncrement = _device.GetDescriptorIncrement(RenderDescriptorType::Rtv);
+    for (uint32_t n = 0; n < FrameCount; n++)
+    {
+        _backBuffers[n] = 0xb000 + n;
+        _resourceStates.Register(_backBuffers[n], 1, PresentState);
+        _device.CreateRenderTargetView(_backBuffers[n], _rtvStart + n * _rtvIncrement);
+    }
+    _dsv = _device.GetDescriptorHeapStart(_device.CreateDescriptorHeap(RenderDescriptorType::Dsv, 1));
+}
+
+void SceneBenchmarkTarget::LoadBenchmarkScene(const BenchmarkScript& script)
+{
+    // The update thread reads the scene; stop it before replacing it.
+    _framePipeline.reset();
+
+    _script = script;
+    BuildBenchmarkScene(_script, &_drawItems);
+    BuildBenchmarkLights(_script, &_lights);
+
+    // Made-up buffer locations and pipeline states: commands are recorded, never executed.
+    _meshBindings.resize(_script.meshCount);
+    for (uint32_t i = 0; i < _script.meshCount; i++)
+    {
+        IndirectMeshBinding& binding = _meshBindings[i];
+        binding.vertexBufferAddress = 0x10000000ull * (i + 1);
+        binding.vertexBufferSize = 24 * 32;
+        binding.vertexStride = 32;
+        binding.indexBufferAddress = binding.vertexBufferAddress + 0x8000000ull;
+        binding.indexBufferSize = 36 * 2;
+        binding.indexFormat = 57;   // DXGI_FORMAT_R16_UINT
+        binding.indexCount = 36;
+    }
+
+    // The welded cube of the position-only streams: 8 float3 positions.
+    _positionMeshBindings = _meshBindings;
+    for (IndirectMeshBinding& binding : _positionMeshBindings)
+    {
+        binding.vertexBufferAddress += 0x4000000ull;
+        binding.vertexBufferSize = 8 * 12;
+        binding.vertexStride = 12;
+        binding.indexBufferAddress += 0x4000000ull;
+    }
+
+    _materialHandles.resize(_script.materialCount);
+    for (uint32_t i = 0; i < _script.materialCount; i++)
+    {
+        _materialHandles[i] = 0x1000 + i;
+    }
+    const std::vector<DepthPrepassMode> prepassModes(_script.materialCount, DepthPrepassMode::On);
+    _prepassHandles.resize(_script.materialCount);
+    SelectDepthPrepassPipelines(prepassModes.data(), prepassModes.size(), 0x5000, _prepassHandles.data());
+
+    _framePipeline.reset(new FramePipeline([this](FramePacket& packet) { BuildFramePacket(packet); }, _threaded));
+}
+
+void SceneBenchmarkTarget::BuildFramePacket(FramePacket& packet)
+{
+    EvaluateBenchmarkCamera(_script, packet.frameNumber, 16.0f / 9.0f, packet.viewProjection);
+    EvaluateBenchmarkView(_script, packet.frameNumber, packet.view);
+    {
+        PROFILE_SCOPE("BatchDraws");
+        packet.draws.Build(_drawItems.data(), _drawItems.size());
+    }
+
+    PROFILE_SCOPE("AssignLights");
+    SetBenchmarkClusterGrid(_script, 16.0f / 9.0f, &packet.lights);
+    packet.lights.Assign(_lights.data(), _lights.size(), packet.view, &_lightThreads);
+}
+
+// A subset of D3D12HelloWindow::OnRender(), under the same scope names so
+// reports line up: the frame packet, the scene constants and lights, the
+// depth pre-pass and batched draws, barrier resolution, submission and the
+// fence wait. Left out: the RenderGraph with its upscale pass and the
+// barriers it places (the scene is drawn straight into the back buffer),
+// dynamic resolution (always 1280x720), GPU timestamps, shader rebuilds and
+// Present.
+void SceneBenchmarkTarget::RunBenchmarkFrame(std::vector<ProfileEvent>* pEvents)
+{
+    {
+        PROFILE_SCOPE("OnRender");
+        const FramePacket& packet = _framePipeline->BeginFrame();
+
+        PopulateCommandList(packet);
+
+        _fixupBarriers.clear();
+        _resourceStates.Resolve(_stateTracker, _fixupBarriers);
+
+        RenderCommandList* ppCommandLists[] = { _fixupCommandList.get(), _commandList.get() };
+        size_t first = 1;
+        if (!_fixupBarriers.empty())
+        {
+            _fixupCommandList->Reset(0);
+            _fixupCommandList->ResourceBarriers(_fixupBarriers.data(), _fixupBarriers.size());
+            _fixupCommandList->Close();
+            first = 0;
+        }
+        _device.GetQueue().ExecuteCommandLists(ppCommandLists + first, 2 - first);
+
+        _uploadRing.EndFrame(_fenceValue);
+
+        PROFILE_SCOPE("WaitForPreviousFrame");
+        const uint64_t fenceValue = _fenceValue++;
+        _device.GetQueue().Signal(*_fence, fenceValue);
+        _fence->Wait(fenceValue);
+        _frameIndex = (_frameIndex + 1) % FrameCount;
+
+        _uploadRing.Retire(_fence->GetCompletedValue());
+    }
+    CpuProfiler::Get().Collect(pEvents);
+}
+
+void SceneBenchmarkTarget::PopulateCommandList(const FramePacket& packet)
+{
+    PROFILE_SCOPE("PopulateCommandList");
+
+    _commandList->Reset(0);
+    _stateTracker.Reset();
+
+    const RenderHandle backBuffer = _backBuffers[_frameIndex];
+    const RenderDescriptor rtv = _rtvStart + _frameIndex * _rtvIncrement;
+
+    _stateTracker.Transition(backBuffer, RenderTargetState);
+    _commandList->ResourceBarriers(_stateTracker.GetBarriers().data(), _stateTracker.GetBarriers().size());
+    _stateTracker.ClearBarriers();
+
+    const float clearColor[] = { 1.0f, 0.2f, 0.4f, 1.0f };
+    _commandList->ClearRenderTarget(rtv, clearColor);
+    _commandList->ClearDepthStencil(_dsv, DepthClearValue);
+
+    RecordDrawBatches(packet, rtv);
+
+    _stateTracker.Transition(backBuffer, PresentState);
+    _commandList->ResourceBarriers(_stateTracker.GetBarriers().data(), _stateTracker.GetBarriers().size());
+    _stateTracker.ClearBarriers();
+
+    _commandList->Close();
+}
+
+void SceneBenchmarkTarget::RecordDrawBatches(const FramePacket& packet, RenderDescriptor rtv)
+{
+    PROFILE_SCOPE("RecordDrawBatches");
+
+    const std::vector<DrawBatch>& batches = packet.draws.GetBatches();
+    if (batches.empty())
+    {
+        return;
+    }
+
+    const std::vector<InstanceData>& instances = packet.draws.GetInstances();
+    uint64_t instanceOffset = 0;
+    if (!_uploadRing.Allocate(instances.size() * sizeof(InstanceData), sizeof(InstanceData), &instanceOffset))
+    {
+        throw std::runtime_error("Upload ring too small for the benchmark scene");
+    }
+    memcpy(_uploadBuffer.data() + instanceOffset, instances.data(), instances.size() * sizeof(InstanceData));
+
+    SceneLightBuffers lightBuffers;
+    if (!UploadSceneLights(_uploadRing, _uploadBuffer.data(), UploadBufferAddress, _lights, packet.lights, &lightBuffers))
+    {
+        throw std::runtime_error("Upload ring too small for the benchmark scene");
+    }
+    _clusterLightStats = packet.lights.GetStats();
+
+    _constantBuffers.ResetStats();
+
+    FrameConstants frameConstants = {};
+    frameConstants.timeSeconds = static_cast<float>(packet.frameNumber * _script.stepSeconds);
+    frameConstants.deltaSeconds = static_cast<float>(_script.stepSeconds);
+    frameConstants.frameNumber = static_cast<uint32_t>(packet.frameNumber);
+
+    ViewConstants viewConstants = {};
+    memcpy(viewConstants.viewProjection, packet.viewProjection, sizeof(viewConstants.viewProjection));
+    viewConstants.viewportSize[0] = 1280.0f;
+    viewConstants.viewportSize[1] = 720.0f;
+    viewConstants.inverseViewportSize[0] = 1.0f / 1280.0f;
+    viewConstants.inverseViewportSize[1] = 1.0f / 720.0f;
+
+    ClusterConstants clusterConstants;
+    BuildClusterConstants(packet.lights, static_cast<uint32_t>(_lights.size()), &clusterConstants);
+
+    BuildDrawConstants(batches, &_drawConstants);
+
+    const RenderViewport viewport = { 0.0f, 0.0f, 1280.0f, 720.0f, 0.0f, 1.0f };
+    const RenderRect scissorRect = { 0, 0, 1280, 720 };
+    _commandList->SetGraphicsRootSignature(0x2000);
+    BatchRootBindings bindings;
+    if (!BindSceneConstants(*_commandList, _rootSignatureLayout, _constantBuffers, frameConstants, viewConstants, _drawConstants, UploadBufferAddress + instanceOffset, &bindings) ||
+        !BindSceneLights(*_commandList, _rootSignatureLayout, _constantBuffers, clusterConstants, lightBuffers))
+    {
+        throw std::runtime_error("Upload ring too small for the benchmark scene");
+    }
+    _commandList->SetViewport(viewport);
+    _commandList->SetScissorRect(scissorRect);
+    _commandList->SetPrimitiveTopology(4);    // D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST
+
+    PROFILE_SCOPE("SubmitDraws");
+    if (_useDepthPrepass)
+    {
+        RecordDepthPrepass(*_commandList, _dsv, batches.data(), batches.size(), _positionMeshBindings.data(), _prepassHandles.data(), bindings);
+    }
+    _commandList->SetRenderTarget(rtv, _dsv);
+
+    if (_useIndirectDraws)
+    {
+        _indirectGenerator.Generate(_indirectLayout, batches.data(), batches.size(), _meshBindings.data(), bindings);
+        RecordIndirectRuns(*_commandList, _indirectGenerator, _indirectLayout, _materialHandles.data(), 0x3000, 0x4000, 0);
+    }
+    else
+    {
+        RecordBatchDraws(*_commandList, batches.data(), batches.size(), _meshBindings.data(), _materialHandles.data(), bindings);
+    }
+}
@@ -0,0 +1,224 @@
+#pragma once
+
+#include "ClusteredLights.h"
+#include "ConstantBufferPool.h"
+#include "DepthPass.h"
+#include "DrawBatcher.h"
+#include "FramePipeline.h"
+#include "IndirectArguments.h"
+#include "Profiler.h"
+#include "RecordingDevice.h"
+#include "ShaderConstants.h"
+#include "ThreadPool.h"
+#include "UploadRing.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Camera path key: where the camera is and what it looks at, seconds into the run.
+struct BenchmarkCameraKey
+{
+    float time;
+    float position[3];
+    float target[3];
+};
+
+// A stage regresses when it got slower than the baseline by more than percent
+// and by more than minimumMilliseconds, which keeps tiny stages from failing
+// on noise. stage is "frame", a profile scope name, or "*" for every scope.
+struct BenchmarkThreshold
+{
+    std::string stage;
+    std::string metric;         // "mean", "p50", "p95", "p99" or "max".
+    double percent;
+    double minimumMilliseconds;
+};
+
+// A benchmark scene script. One directive per line, '#' starts a comment:
+//
+//   name      <text>
+//   frames    <warmup> <measured>
+//   step      <seconds>                          Camera time per frame.
+//   seed      <integer>
+//   grid      <x> <y> <spacing> <meshes> <materials>
+//   lights    <count> <radius>                   Point lights over the grid.
+//   camera    <time> <px> <py> <pz> <tx> <ty> <tz>
+//   threshold <stage> <metric> <percent> [<minimum ms>]
+//
+// The scene and the camera path only depend on the script and the frame
+// number, so every run renders the same frames.
+struct BenchmarkScript
+{
+    std::string name = "benchmark";
+    uint32_t warmupFrames = 60;
+    uint32_t measuredFrames = 600;
+    double stepSeconds = 1.0 / 60.0;
+    uint32_t seed = 1;
+
+    uint32_t gridX = 0;
+    uint32_t gridY = 0;
+    float spacing = 2.0f;
+    uint32_t meshCount = 1;
+    uint32_t materialCount = 1;
+
+    uint32_t lightCount = 0;
+    float lightRadius = 5.0f;
+
+    float fieldOfViewDegrees = 60.0f;
+    std::vector<BenchmarkCameraKey> camera;
+    std::vector<BenchmarkThreshold> thresholds;
+};
+
+// False with a message naming the line on errors.
+bool ParseBenchmarkScript(const std::string& text, BenchmarkScript* pScript, std::string* pError);
+
+// The draws of the scripted scene: a grid of objects with mesh and material
+// ids spread over the script's counts, and a random yaw and scale from seed.
+void BuildBenchmarkScene(const BenchmarkScript& script, std::vector<DrawItem>* pItems);
+
+// Point lights scattered over the grid and a few units above it, with radii
+// from half to one and a half times the script's, from seed.
+void BuildBenchmarkLights(const BenchmarkScript& script, std::vector<PointLight>* pLights);
+
+// Row-major, row vectors, left-handed like DirectXMath, with the reverse-Z
+// projection of DepthPass.h. Identity without a path.
+void EvaluateBenchmarkCamera(const BenchmarkScript& script, uint64_t frameNumber, float aspectRatio, float viewProjection[16]);
+
+// The view half of EvaluateBenchmarkCamera(): world to view space.
+void EvaluateBenchmarkView(const BenchmarkScript& script, uint64_t frameNumber, float view[16]);
+
+// The grid lights are assigned to, for the camera of a script.
+void SetBenchmarkClusterGrid(const BenchmarkScript& script, float aspectRatio, ClusterLightAssigner* pAssigner);
+
+struct BenchmarkMetrics
+{
+    double mean;
+    double p50;
+    double p95;
+    double p99;
+    double max;
+};
+
+struct BenchmarkStage
+{
+    std::string name;
+    BenchmarkMetrics milliseconds;
+};
+
+struct BenchmarkReport
+{
+    std::string name;
+    uint32_t warmupFrames;
+    uint32_t measuredFrames;
+    BenchmarkMetrics frameMilliseconds;     // CPU time of a whole frame.
+    std::vector<BenchmarkStage> stages;     // Per profile scope, summed over each frame; sorted by name.
+};
+
+struct BenchmarkComparison
+{
+    std::string stage;
+    std::string metric;
+    double baseline;
+    double current;
+    double limit;           // Largest current value that passes.
+    bool passed;
+};
+
+// What the harness drives. Frames run back to back; a target that is not
+// paced by presentation measures the CPU cost of its frames alone.
+class BenchmarkTarget
+{
+public: virtual ~BenchmarkTarget() {}
+
+public: virtual void LoadBenchmarkScene(const BenchmarkScript& script) = 0;
+
+    // Runs one frame and appends the profile events it collected, which make
+    // the per-stage breakdown. Events may lag a frame behind.
+public: virtual void RunBenchmarkFrame(std::vector<ProfileEvent>* pEvents) = 0;
+};
+
+void RunBenchmark(const BenchmarkScript& script, BenchmarkTarget& target, BenchmarkReport* pReport);
+
+void WriteBenchmarkJson(const BenchmarkReport& report, std::string* pJson);
+
+// Reads back what WriteBenchmarkJson() wrote, to compare against a baseline.
+bool ParseBenchmarkJson(const std::string& json, BenchmarkReport* pReport, std::string* pError);
+
+// Checks current against baseline with the script's thresholds, or a 10% p95
+// frame time threshold when it has none. Stages missing from either report
+// are skipped. Returns whether every check passed.
+bool CompareBenchmarkReports(
+    const BenchmarkReport& baseline,
+    const BenchmarkReport& current,
+    const std::vector<BenchmarkThreshold>& thresholds,
+    std::vector<BenchmarkComparison>* pComparisons);
+
+// Runs the CPU side of the sample's frame without a GPU: frame packets built
+// through a FramePipeline, then most of the command list recording, barrier
+// resolution and submission D3D12HelloWindow::OnRender() does, against a
+// RecordingDevice; RunBenchmarkFrame() lists what it leaves out. Lets the
+// harness run headless on any platform.
+class SceneBenchmarkTarget : public BenchmarkTarget
+{
+public: explicit SceneBenchmarkTarget(bool threaded, const RecordingDeviceDesc& deviceDesc = RecordingDeviceDesc());
+
+public: virtual void LoadBenchmarkScene(const BenchmarkScript& script);
+public: virtual void RunBenchmarkFrame(std::vector<ProfileEvent>* pEvents);
+
+public: void SetIndirectDraws(bool enabled) { _useIndirectDraws = enabled; }
+public: void SetDepthPrepass(bool enabled) { _useDepthPrepass = enabled; }
+public: RecordingDevice& GetDevice() { return _device; }
+
+    // Of the last frame.
+public: const ConstantBufferStats& GetConstantBufferStats() const { return _constantBuffers.GetStats(); }
+public: uint32_t GetDrawCount() const { return static_cast<uint32_t>(_drawConstants.size()); }
+public: const ClusterLightStats& GetClusterLightStats() const { return _clusterLightStats; }
+
+private: static const uint32_t FrameCount = 2;
+private: static const uint64_t UploadRingSize = 4 * 1024 * 1024;
+private: static const uint64_t UploadBufferAddress = 0x100000000ull;
+
+private: void BuildFramePacket(FramePacket& packet);
+private: void PopulateCommandList(const FramePacket& packet);
+private: void RecordDrawBatches(const FramePacket& packet, RenderDescriptor rtv);
+
+private: RecordingDevice _device;
+private: std::unique_ptr<RenderCommandList> _commandList;
+private: std::unique_ptr<RenderCommandList> _fixupCommandList;
+private: std::unique_ptr<RenderFence> _fence;
+private: ResourceStateRegistry _resourceStates;
+private: ResourceStateTracker _stateTracker;
+private: std::vector<TrackedBarrier> _fixupBarriers;
+private: RenderHandle _backBuffers[FrameCount];
+private: RenderDescriptor _rtvStart;
+private: uint32_t _rtvIncrement;
+private: RenderDescriptor _dsv;
+private: uint64_t _fenceValue;
+private: uint32_t _frameIndex;
+
+private: BenchmarkScript _script;
+private: std::vector<DrawItem> _drawItems;
+private: std::vector<PointLight> _lights;
+private: ThreadPool _lightThreads;
+private: std::unique_ptr<FramePipeline> _framePipeline;
+private: RootSignatureLayout _rootSignatureLayout;
+private: IndirectCommandLayout _indirectLayout;
+private: IndirectDrawGenerator _indirectGenerator;
+private: std::vector<IndirectMeshBinding> _meshBindings;
+private: std::vector<RenderHandle> _materialHandles;
+private: std::vector<IndirectMeshBinding> _positionMeshBindings;
+private: std::vector<RenderHandle> _prepassHandles;
+private: std::vector<DrawConstants> _drawConstants;
+private: ClusterLightStats _clusterLightStats;
+
+    // Stands in for the persistently mapped upload buffer.
+private: std::vector<uint8_t> _uploadBuffer;
+private: UploadRing _uploadRing;
+private: ConstantBufferPool _constantBuffers;
+private: bool _threaded;
+private: bool _useIndirectDraws;
+private: bool _useDepthPrepass;
+};
@@ -0,0 +1,173 @@
+// Headless benchmark runner: plays a benchmark script against
+// SceneBenchmarkTarget, the sample's CPU frame work without a GPU, so it runs
+// on any platform and on build machines without a display.
+//
+//   ModelViewerBenchmark <script> [-baseline <report>] [-output <report>]
+//                        [-threaded] [-indirect] [-depth_prepass]
+//
+// Writes the JSON report to the output file (benchmark.json by default) and
+// to stdout. Exit codes match the sample's -benchmark mode: 0 when the run
+// passed the thresholds against the baseline (or there was none), 1 on a
+// regression, 2 when a file could not be used.
+
+#include "Benchmark.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+    bool ReadTextFile(const std::string& path, std::string* pText)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+        {
+            return false;
+        }
+        std::stringstream text;
+        text << file.rdbuf();
+        *pText = text.str();
+        return true;
+    }
+
+    void PrintUsage()
+    {
+        fprintf(stderr,
+            "usage: ModelViewerBenchmark <script> [-baseline <report>] [-output <report>]\n"
+            "                            [-threaded] [-indirect] [-depth_prepass]\n");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string scriptPath;
+    std::string baselinePath;
+    std::string outputPath = "benchmark.json";
+    bool threaded = false;
+    bool indirectDraws = false;
+    bool depthPrepass = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-baseline") == 0 && i + 1 < argc)
+        {
+            baselinePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "-output") == 0 && i + 1 < argc)
+        {
+            outputPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "-threaded") == 0)
+        {
+            threaded = true;
+        }
+        else if (strcmp(argv[i], "-indirect") == 0)
+        {
+            indirectDraws = true;
+        }
+        else if (strcmp(argv[i], "-depth_prepass") == 0)
+        {
+            depthPrepass = true;
+        }
+        else if (argv[i][0] != '-' && scriptPath.empty())
+        {
+            scriptPath = argv[i];
+        }
+        else
+        {
+            PrintUsage();
+            return 2;
+        }
+    }
+    if (scriptPath.empty())
+    {
+        PrintUsage();
+        return 2;
+    }
+
+    std::string text;
+    std::string error;
+    BenchmarkScript script;
+    if (!ReadTextFile(scriptPath, &text))
+    {
+        fprintf(stderr, "benchmark: cannot read the script %s\n", scriptPath.c_str());
+        return 2;
+    }
+    if (!ParseBenchmarkScript(text, &script, &error))
+    {
+        fprintf(stderr, "benchmark: cannot use the script: %s\n", error.c_str());
+        return 2;
+    }
+
+    SceneBenchmarkTarget target(threaded);
+    target.SetIndirectDraws(indirectDraws);
+    target.SetDepthPrepass(depthPrepass);
+    BenchmarkReport report;
+    RunBenchmark(script, target, &report);
+
+    std::string json;
+    WriteBenchmarkJson(report, &json);
+    std::ofstream output(outputPath, std::ios::binary);
+    output.write(json.data(), json.size());
+    if (!output)
+    {
+        fprintf(stderr, "benchmark: cannot write the report %s\n", outputPath.c_str());
+        return 2;
+    }
+    printf("%s", json.c_str());
+
+    // What the last frame's draws cost in upload memory: the views bound
+    // per draw, rounded up to 256 bytes each.
+    const ConstantBufferStats& constantBuffers = target.GetConstantBufferStats();
+    const uint32_t drawCount = target.GetDrawCount();
+    printf("constant buffers: %u views in %u allocations, %llu bytes (%llu written), %.1f bytes per draw over %u draws\n",
+        constantBuffers.constantBuffers,
+        constantBuffers.allocations,
+        static_cast<unsigned long long>(constantBuffers.bytesAllocated),
+        static_cast<unsigned long long>(constantBuffers.bytesWritten),
+        drawCount > 0 ? static_cast<double>(constantBuffers.bytesAllocated) / drawCount : 0.0,
+        drawCount);
+
+    // And what its lights cost: entries in the clusters' light lists, and
+    // clusters that dropped lights past the per-cluster limit.
+    const ClusterLightStats& clusterLights = target.GetClusterLightStats();
+    printf("cluster lights: %u lights, %u cluster entries, up to %u per cluster, %u clusters full\n",
+        clusterLights.lights,
+        clusterLights.indices,
+        clusterLights.maxClusterLights,
+        clusterLights.overflowClusters);
+
+    if (baselinePath.empty())
+    {
+        return 0;
+    }
+
+    BenchmarkReport baseline;
+    if (!ReadTextFile(baselinePath, &text))
+    {
+        fprintf(stderr, "benchmark: cannot read the baseline %s\n", baselinePath.c_str());
+        return 2;
+    }
+    if (!ParseBenchmarkJson(text, &baseline, &error))
+    {
+        fprintf(stderr, "benchmark: cannot use the baseline: %s\n", error.c_str());
+        return 2;
+    }
+
+    std::vector<BenchmarkComparison> comparisons;
+    const bool passed = CompareBenchmarkReports(baseline, report, script.thresholds, &comparisons);
+    for (const BenchmarkComparison& comparison : comparisons)
+    {
+        printf("%s %s: %.3f ms -> %.3f ms, limit %.3f ms%s\n",
+            comparison.stage.c_str(),
+            comparison.metric.c_str(),
+            comparison.baseline,
+            comparison.current,
+            comparison.limit,
+            comparison.passed ? "" : " REGRESSED");
+    }
+    return passed ? 0 : 1;
+}
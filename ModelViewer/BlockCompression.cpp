@@ -0,0 +1,960 @@
+#include "BlockCompression.h"
+#include "DDSFile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define BC_USE_SSE2 1
+#endif
+
+namespace
+{
+    // Texels of one block split by channel, so four texels fill one SSE register.
+    struct BlockTexels
+    {
+        alignas(16) float c[4][16];
+    };
+
+    // Interpolation weights (out of 64) of the 2 and 4-bit BC7 indices.
+    const int BC7Weights2[4] = { 0, 21, 43, 64 };
+    const int BC7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    // Encoders try this many least squares refinements of their endpoints.
+    const int RefineIterations = 2;
+
+    void LoadTexels(const uint8_t* pTexels, BlockTexels* pOut)
+    {
+        for (int i = 0; i < 16; i++)
+        {
+            for (int ch = 0; ch < 4; ch++)
+            {
+                pOut->c[ch][i] = pTexels[i * 4 + ch];
+            }
+        }
+    }
+
+    inline float Clamp255(float value)
+    {
+        return std::min(std::max(value, 0.0f), 255.0f);
+    }
+
+    // Position of every texel along a..b, rounded to the nearest of steps evenly
+    // spaced points: 0 is a, steps - 1 is b. Channels where a and b agree do not
+    // contribute.
+    void QuantizeToSegment(const BlockTexels& texels, const float a[4], const float b[4], int steps, uint8_t* pSteps)
+    {
+        float d[4];
+        float lengthSq = 0.0f;
+        float offset = 0.0f;
+        for (int ch = 0; ch < 4; ch++)
+        {
+            d[ch] = b[ch] - a[ch];
+            lengthSq += d[ch] * d[ch];
+            offset -= a[ch] * d[ch];
+        }
+
+        if (lengthSq < 1e-6f)
+        {
+            memset(pSteps, 0, 16);
+            return;
+        }
+
+        const float scale = (steps - 1) / lengthSq;
+        offset *= scale;
+        for (int ch = 0; ch < 4; ch++)
+        {
+            d[ch] *= scale;
+        }
+
+#if BC_USE_SSE2
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 half = _mm_set1_ps(0.5f);
+        const __m128 maxStep = _mm_set1_ps(static_cast<float>(steps - 1));
+
+        __m128i rounded[4];
+        for (int group = 0; group < 4; group++)
+        {
+            __m128 t = _mm_set1_ps(offset);
+            for (int ch = 0; ch < 4; ch++)
+            {
+                t = _mm_add_ps(t, _mm_mul_ps(_mm_load_ps(&texels.c[ch][group * 4]), _mm_set1_ps(d[ch])));
+            }
+            t = _mm_min_ps(_mm_max_ps(t, zero), maxStep);
+            rounded[group] = _mm_cvttps_epi32(_mm_add_ps(t, half));
+        }
+
+        const __m128i packed = _mm_packus_epi16(_mm_packs_epi32(rounded[0], rounded[1]), _mm_packs_epi32(rounded[2], rounded[3]));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pSteps), packed);
+#else
+        for (int i = 0; i < 16; i++)
+        {
+            float t = offset;
+            for (int ch = 0; ch < 4; ch++)
+            {
+                t += texels.c[ch][i] * d[ch];
+            }
+            t = std::min(std::max(t, 0.0f), static_cast<float>(steps - 1));
+            pSteps[i] = static_cast<uint8_t>(t + 0.5f);
+        }
+#endif
+    }
+
+    // Endpoints spanning the texels along their dominant direction over the
+    // first channelCount channels, found by power iteration on the covariance.
+    void ComputeAxisEndpoints(const BlockTexels& texels, int channelCount, float a[4], float b[4])
+    {
+        float mean[4] = {};
+        for (int ch = 0; ch < channelCount; ch++)
+        {
+            for (int i = 0; i < 16; i++)
+            {
+                mean[ch] += texels.c[ch][i];
+            }
+            mean[ch] /= 16.0f;
+        }
+
+        float covariance[4][4] = {};
+        for (int i = 0; i < 16; i++)
+        {
+            for (int r = 0; r < channelCount; r++)
+            {
+                for (int c = r; c < channelCount; c++)
+                {
+                    covariance[r][c] += (texels.c[r][i] - mean[r]) * (texels.c[c][i] - mean[c]);
+                }
+            }
+        }
+        for (int r = 0; r < channelCount; r++)
+        {
+            for (int c = 0; c < r; c++)
+            {
+                covariance[r][c] = covariance[c][r];
+            }
+        }
+
+        // Start from the channel that varies most so the iteration cannot begin
+        // orthogonal to the answer.
+        float axis[4] = {};
+        int widest = 0;
+        for (int ch = 1; ch < channelCount; ch++)
+        {
+            widest = covariance[ch][ch] > covariance[widest][widest] ? ch : widest;
+        }
+        for (int ch = 0; ch < channelCount; ch++)
+        {
+            axis[ch] = covariance[widest][ch];
+        }
+
+        for (int iteration = 0; iteration < 8; iteration++)
+        {
+            float next[4] = {};
+            float largest = 0.0f;
+            for (int r = 0; r < channelCount; r++)
+            {
+                for (int c = 0; c < channelCount; c++)
+                {
+                    next[r] += covariance[r][c] * axis[c];
+                }
+                largest = std::max(largest, std::fabs(next[r]));
+            }
+            if (largest < 1e-6f)
+            {
+                break;
+            }
+            for (int ch = 0; ch < channelCount; ch++)
+            {
+                axis[ch] = next[ch] / largest;
+            }
+        }
+
+        float lengthSq = 0.0f;
+        for (int ch = 0; ch < channelCount; ch++)
+        {
+            lengthSq += axis[ch] * axis[ch];
+        }
+
+        float minT = 0.0f;
+        float maxT = 0.0f;
+        if (lengthSq > 1e-6f)
+        {
+            for (int i = 0; i < 16; i++)
+            {
+                float t = 0.0f;
+                for (int ch = 0; ch < channelCount; ch++)
+                {
+                    t += (texels.c[ch][i] - mean[ch]) * axis[ch];
+                }
+                minT = std::min(minT, t);
+                maxT = std::max(maxT, t);
+            }
+            minT /= lengthSq;
+            maxT /= lengthSq;
+        }
+
+        for (int ch = 0; ch < 4; ch++)
+        {
+            a[ch] = ch < channelCount ? Clamp255(mean[ch] + axis[ch] * minT) : 0.0f;
+            b[ch] = ch < channelCount ? Clamp255(mean[ch] + axis[ch] * maxT) : 0.0f;
+        }
+    }
+
+    // Least squares endpoints for texels sitting at step / (steps - 1) between
+    // a and b. Returns false when every texel sits on the same step.
+    bool FitEndpoints(const BlockTexels& texels, int channelCount, const uint8_t* pSteps, int steps, float a[4], float b[4])
+    {
+        float aa = 0.0f;
+        float ab = 0.0f;
+        float bb = 0.0f;
+        float ax[4] = {};
+        float bx[4] = {};
+        for (int i = 0; i < 16; i++)
+        {
+            const float w = pSteps[i] / static_cast<float>(steps - 1);
+            const float v = 1.0f - w;
+            aa += v * v;
+            ab += v * w;
+            bb += w * w;
+            for (int ch = 0; ch < channelCount; ch++)
+            {
+                ax[ch] += v * texels.c[ch][i];
+                bx[ch] += w * texels.c[ch][i];
+            }
+        }
+
+        const float determinant = aa * bb - ab * ab;
+        if (std::fabs(determinant) < 1e-6f)
+        {
+            return false;
+        }
+
+        for (int ch = 0; ch < channelCount; ch++)
+        {
+            a[ch] = Clamp255((ax[ch] * bb - bx[ch] * ab) / determinant);
+            b[ch] = Clamp255((bx[ch] * aa - ax[ch] * ab) / determinant);
+        }
+        return true;
+    }
+
+    // Whether every texel matches the first over the channels in channelMask.
+    bool IsSolidBlock(const uint8_t* pTexels, uint32_t channelMask)
+    {
+        for (int i = 1; i < 16; i++)
+        {
+            for (int ch = 0; ch < 4; ch++)
+            {
+                if ((channelMask & (1u << ch)) && pTexels[i * 4 + ch] != pTexels[ch])
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // Squared error of a decoded block over the channels in channelMask.
+    uint32_t BlockError(const uint8_t* pTexels, const uint8_t* pDecoded, uint32_t channelMask)
+    {
+        uint32_t error = 0;
+        for (int i = 0; i < 16; i++)
+        {
+            for (int ch = 0; ch < 4; ch++)
+            {
+                if (channelMask & (1u << ch))
+                {
+                    const int d = static_cast<int>(pTexels[i * 4 + ch]) - pDecoded[i * 4 + ch];
+                    error += static_cast<uint32_t>(d * d);
+                }
+            }
+        }
+        return error;
+    }
+
+    //
+    // BC1 colour blocks.
+    //
+
+    uint16_t To565(const float c[4])
+    {
+        const uint32_t r = static_cast<uint32_t>(c[0] * 31.0f / 255.0f + 0.5f);
+        const uint32_t g = static_cast<uint32_t>(c[1] * 63.0f / 255.0f + 0.5f);
+        const uint32_t b = static_cast<uint32_t>(c[2] * 31.0f / 255.0f + 0.5f);
+        return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+    }
+
+    void From565(uint16_t value, float c[4])
+    {
+        const uint32_t r = value >> 11;
+        const uint32_t g = (value >> 5) & 63;
+        const uint32_t b = value & 31;
+        c[0] = static_cast<float>((r << 3) | (r >> 2));
+        c[1] = static_cast<float>((g << 2) | (g >> 4));
+        c[2] = static_cast<float>((b << 3) | (b >> 2));
+        c[3] = 0.0f;
+    }
+
+    // Endpoints of 5 and 6 bits whose 2/3 : 1/3 blend lands closest to each
+    // 8-bit value. The blends miss some values by one; nothing in BC1 does
+    // better for a solid block.
+    struct SolidColorTable
+    {
+        uint8_t endpoints[2][256][2];
+
+        SolidColorTable()
+        {
+            for (int table = 0; table < 2; table++)
+            {
+                const uint32_t bits = table == 0 ? 5 : 6;
+                for (uint32_t value = 0; value < 256; value++)
+                {
+                    int bestError = 256;
+                    for (uint32_t e0 = 0; e0 < (1u << bits); e0++)
+                    {
+                        for (uint32_t e1 = 0; e1 < (1u << bits); e1++)
+                        {
+                            const int v0 = static_cast<int>((e0 << (8 - bits)) | (e0 >> (2 * bits - 8)));
+                            const int v1 = static_cast<int>((e1 << (8 - bits)) | (e1 >> (2 * bits - 8)));
+                            const int error = std::abs((2 * v0 + v1) / 3 - static_cast<int>(value));
+                            if (error < bestError)
+                            {
+                                bestError = error;
+                                endpoints[table][value][0] = static_cast<uint8_t>(e0);
+                                endpoints[table][value][1] = static_cast<uint8_t>(e1);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    };
+
+    // Every texel on the first blend of c0..c1, whose endpoints each channel
+    // picks on its own.
+    void EncodeSolidColorBlock(const uint8_t color[4], uint8_t* pBlock)
+    {
+        static const SolidColorTable table;
+        const uint8_t* r = table.endpoints[0][color[0]];
+        const uint8_t* g = table.endpoints[1][color[1]];
+        const uint8_t* b = table.endpoints[0][color[2]];
+        uint16_t c0 = static_cast<uint16_t>((r[0] << 11) | (g[0] << 5) | b[0]);
+        uint16_t c1 = static_cast<uint16_t>((r[1] << 11) | (g[1] << 5) | b[1]);
+
+        // Index 2 is the 2/3 blend with c0 > c1, and plain c0 when they are
+        // equal; swapped endpoints need index 3.
+        uint32_t indices = 0xaaaaaaaa;
+        if (c0 < c1)
+        {
+            std::swap(c0, c1);
+            indices = 0xffffffff;
+        }
+
+        pBlock[0] = static_cast<uint8_t>(c0);
+        pBlock[1] = static_cast<uint8_t>(c0 >> 8);
+        pBlock[2] = static_cast<uint8_t>(c1);
+        pBlock[3] = static_cast<uint8_t>(c1 >> 8);
+        memcpy(pBlock + 4, &indices, sizeof(indices));
+    }
+
+    void DecodeColorBlock(const uint8_t* pBlock, bool forceFourColors, uint8_t* pTexels)
+    {
+        const uint16_t c0 = static_cast<uint16_t>(pBlock[0] | (pBlock[1] << 8));
+        const uint16_t c1 = static_cast<uint16_t>(pBlock[2] | (pBlock[3] << 8));
+
+        float e0[4];
+        float e1[4];
+        From565(c0, e0);
+        From565(c1, e1);
+
+        uint8_t palette[4][4];
+        for (int ch = 0; ch < 3; ch++)
+        {
+            const int v0 = static_cast<int>(e0[ch]);
+            const int v1 = static_cast<int>(e1[ch]);
+            palette[0][ch] = static_cast<uint8_t>(v0);
+            palette[1][ch] = static_cast<uint8_t>(v1);
+            if (c0 > c1 || forceFourColors)
+            {
+                palette[2][ch] = static_cast<uint8_t>((2 * v0 + v1) / 3);
+                palette[3][ch] = static_cast<uint8_t>((v0 + 2 * v1) / 3);
+            }
+            else
+            {
+                palette[2][ch] = static_cast<uint8_t>((v0 + v1) / 2);
+                palette[3][ch] = 0;
+            }
+        }
+        palette[0][3] = palette[1][3] = palette[2][3] = 255;
+        palette[3][3] = (c0 > c1 || forceFourColors) ? 255 : 0;
+
+        uint32_t indices;
+        memcpy(&indices, pBlock + 4, sizeof(indices));
+        for (int i = 0; i < 16; i++)
+        {
+            memcpy(pTexels + i * 4, palette[(indices >> (i * 2)) & 3], 4);
+        }
+    }
+
+    // Writes c0, c1 and the indices of the texels' steps along c0..c1. Four
+    // colour blocks need c0 > c1 and three colour blocks c0 <= c1; the
+    // endpoints are swapped when the order is wrong.
+    void PackColorBlock(uint16_t c0, uint16_t c1, const uint8_t* pSteps, bool threeColors, const BlockTexels& texels, uint8_t* pBlock)
+    {
+        // Step along c0..c1 to palette index.
+        static const uint8_t FourColorIndex[4] = { 0, 2, 3, 1 };
+        static const uint8_t ThreeColorIndex[3] = { 0, 2, 1 };
+
+        const int lastStep = threeColors ? 2 : 3;
+        const bool swap = threeColors ? c0 > c1 : c0 < c1;
+        if (swap)
+        {
+            std::swap(c0, c1);
+        }
+
+        uint32_t indices = 0;
+        for (int i = 0; i < 16; i++)
+        {
+            const int step = swap ? lastStep - pSteps[i] : pSteps[i];
+            uint32_t index;
+            if (threeColors)
+            {
+                index = texels.c[3][i] < 128.0f ? 3 : ThreeColorIndex[step];
+            }
+            else
+            {
+                // Equal endpoints decode as a three colour block; stay on c0.
+                index = c0 == c1 ? 0 : FourColorIndex[step];
+            }
+            indices |= index << (i * 2);
+        }
+
+        pBlock[0] = static_cast<uint8_t>(c0);
+        pBlock[1] = static_cast<uint8_t>(c0 >> 8);
+        pBlock[2] = static_cast<uint8_t>(c1);
+        pBlock[3] = static_cast<uint8_t>(c1 >> 8);
+        memcpy(pBlock + 4, &indices, sizeof(indices));
+    }
+
+    // BC1 blocks and the colour half of BC3 blocks. BC3 always decodes four
+    // colours, so transparency is only allowed for BC1.
+    void EncodeColorBlock(const uint8_t* pTexels, const BlockTexels& texels, bool allowTransparency, uint8_t* pBlock)
+    {
+        bool threeColors = false;
+        for (int i = 0; allowTransparency && i < 16; i++)
+        {
+            threeColors |= texels.c[3][i] < 128.0f;
+        }
+        if (!threeColors && IsSolidBlock(pTexels, 0x7))
+        {
+            EncodeSolidColorBlock(pTexels, pBlock);
+            return;
+        }
+
+        const int steps = threeColors ? 3 : 4;
+        const uint32_t channelMask = threeColors ? 0xf : 0x7;
+
+        float a[4];
+        float b[4];
+        ComputeAxisEndpoints(texels, 3, a, b);
+
+        uint32_t bestError = UINT32_MAX;
+        for (int iteration = 0; iteration <= RefineIterations; iteration++)
+        {
+            const uint16_t c0 = To565(a);
+            const uint16_t c1 = To565(b);
+
+            // Indices are picked against the endpoints the GPU will see.
+            float qa[4];
+            float qb[4];
+            From565(c0, qa);
+            From565(c1, qb);
+
+            uint8_t steps16[16];
+            QuantizeToSegment(texels, qa, qb, steps, steps16);
+
+            uint8_t candidate[8];
+            uint8_t decoded[64];
+            PackColorBlock(c0, c1, steps16, threeColors, texels, candidate);
+            DecodeColorBlock(candidate, !allowTransparency, decoded);
+
+            const uint32_t error = BlockError(pTexels, decoded, channelMask);
+            if (error < bestError)
+            {
+                bestError = error;
+                memcpy(pBlock, candidate, sizeof(candidate));
+            }
+
+            if (error == 0 || !FitEndpoints(texels, 3, steps16, steps, a, b))
+            {
+                break;
+            }
+        }
+    }
+
+    //
+    // BC4 single channel blocks, also the alpha half of BC3 and both halves of BC5.
+    //
+
+    void DecodeChannelBlock(const uint8_t* pBlock, int channel, uint8_t* pTexels)
+    {
+        const int a0 = pBlock[0];
+        const int a1 = pBlock[1];
+
+        uint8_t palette[8];
+        palette[0] = static_cast<uint8_t>(a0);
+        palette[1] = static_cast<uint8_t>(a1);
+        if (a0 > a1)
+        {
+            for (int k = 1; k < 7; k++)
+            {
+                palette[k + 1] = static_cast<uint8_t>(((7 - k) * a0 + k * a1) / 7);
+            }
+        }
+        else
+        {
+            for (int k = 1; k < 5; k++)
+            {
+                palette[k + 1] = static_cast<uint8_t>(((5 - k) * a0 + k * a1) / 5);
+            }
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+
+        uint64_t indices = 0;
+        for (int i = 0; i < 6; i++)
+        {
+            indices |= static_cast<uint64_t>(pBlock[2 + i]) << (i * 8);
+        }
+        for (int i = 0; i < 16; i++)
+        {
+            pTexels[i * 4 + channel] = palette[(indices >> (i * 3)) & 7];
+        }
+    }
+
+    void EncodeChannelBlock(const BlockTexels& texels, int channel, uint8_t* pBlock)
+    {
+        float low = 255.0f;
+        float high = 0.0f;
+        for (int i = 0; i < 16; i++)
+        {
+            low = std::min(low, texels.c[channel][i]);
+            high = std::max(high, texels.c[channel][i]);
+        }
+
+        // Eight value mode: a0 is the maximum and a1 the minimum.
+        const uint8_t a0 = static_cast<uint8_t>(high);
+        const uint8_t a1 = static_cast<uint8_t>(low);
+        memset(pBlock, 0, 8);
+        pBlock[0] = a0;
+        pBlock[1] = a1;
+        if (a0 == a1)
+        {
+            return;
+        }
+
+        float a[4] = {};
+        float b[4] = {};
+        a[channel] = a1;
+        b[channel] = a0;
+
+        uint8_t steps[16];
+        QuantizeToSegment(texels, a, b, 8, steps);
+
+        uint64_t indices = 0;
+        for (int i = 0; i < 16; i++)
+        {
+            const uint64_t index = steps[i] == 7 ? 0 : steps[i] == 0 ? 1 : 8 - steps[i];
+            indices |= index << (i * 3);
+        }
+        for (int i = 0; i < 6; i++)
+        {
+            pBlock[2 + i] = static_cast<uint8_t>(indices >> (i * 8));
+        }
+    }
+
+    //
+    // BC7 blocks are read and written LSB first.
+    //
+
+    struct BitWriter
+    {
+        uint8_t* pData;
+        uint32_t position;
+
+        void Write(uint32_t value, uint32_t bits)
+        {
+            for (uint32_t i = 0; i < bits; i++, position++)
+            {
+                pData[position >> 3] |= static_cast<uint8_t>(((value >> i) & 1) << (position & 7));
+            }
+        }
+    };
+
+    struct BitReader
+    {
+        const uint8_t* pData;
+        uint32_t position;
+
+        uint32_t Read(uint32_t bits)
+        {
+            uint32_t value = 0;
+            for (uint32_t i = 0; i < bits; i++, position++)
+            {
+                value |= static_cast<uint32_t>((pData[position >> 3] >> (position & 7)) & 1) << i;
+            }
+            return value;
+        }
+    };
+
+    //
+    // BC7 mode 5: one subset, 7-bit colour and 8-bit alpha endpoints, 2-bit
+    // indices for each. Used for solid blocks: with index 1 the colour blend
+    // reaches every 8-bit value, which mode 6's shared p-bits do not.
+    //
+
+    struct BC7SolidTable
+    {
+        uint8_t endpoints[256][2];
+
+        BC7SolidTable()
+        {
+            for (uint32_t e0 = 128; e0-- > 0;)
+            {
+                for (uint32_t e1 = 128; e1-- > 0;)
+                {
+                    const uint32_t v0 = (e0 << 1) | (e0 >> 6);
+                    const uint32_t v1 = (e1 << 1) | (e1 >> 6);
+                    const uint32_t value = ((64 - BC7Weights2[1]) * v0 + BC7Weights2[1] * v1 + 32) >> 6;
+                    endpoints[value][0] = static_cast<uint8_t>(e0);
+                    endpoints[value][1] = static_cast<uint8_t>(e1);
+                }
+            }
+        }
+    };
+
+    void EncodeBC7SolidBlock(const uint8_t color[4], uint8_t* pBlock)
+    {
+        static const BC7SolidTable table;
+
+        memset(pBlock, 0, 16);
+        BitWriter writer = { pBlock, 0 };
+        writer.Write(1 << 5, 6);
+        writer.Write(0, 2);     // No channel rotation.
+        for (int ch = 0; ch < 3; ch++)
+        {
+            writer.Write(table.endpoints[color[ch]][0], 7);
+            writer.Write(table.endpoints[color[ch]][1], 7);
+        }
+        writer.Write(color[3], 8);
+        writer.Write(color[3], 8);
+        for (int i = 0; i < 16; i++)
+        {
+            writer.Write(1, i == 0 ? 1 : 2);
+        }
+        // Alpha indices stay zero.
+    }
+
+    void DecodeBC7Mode5Block(const uint8_t* pBlock, uint8_t* pTexels)
+    {
+        BitReader reader = { pBlock, 6 };
+        const uint32_t rotation = reader.Read(2);
+        uint32_t endpoints[2][4];
+        for (int ch = 0; ch < 3; ch++)
+        {
+            for (int e = 0; e < 2; e++)
+            {
+                const uint32_t value = reader.Read(7);
+                endpoints[e][ch] = (value << 1) | (value >> 6);
+            }
+        }
+        endpoints[0][3] = reader.Read(8);
+        endpoints[1][3] = reader.Read(8);
+
+        uint32_t colorIndices[16];
+        for (int i = 0; i < 16; i++)
+        {
+            colorIndices[i] = reader.Read(i == 0 ? 1 : 2);
+        }
+        for (int i = 0; i < 16; i++)
+        {
+            const uint32_t alphaIndex = reader.Read(i == 0 ? 1 : 2);
+            for (int ch = 0; ch < 4; ch++)
+            {
+                const uint32_t weight = BC7Weights2[ch == 3 ? alphaIndex : colorIndices[i]];
+                pTexels[i * 4 + ch] = static_cast<uint8_t>(((64 - weight) * endpoints[0][ch] + weight * endpoints[1][ch] + 32) >> 6);
+            }
+            if (rotation != 0)
+            {
+                std::swap(pTexels[i * 4 + 3], pTexels[i * 4 + rotation - 1]);
+            }
+        }
+    }
+
+    //
+    // BC7 mode 6: one subset, RGBA endpoints of 7 bits plus a p-bit, 4-bit indices.
+    //
+
+    // Rounds an endpoint to 7 bits per channel and picks the p-bit, shared by
+    // all four channels, that lands closest.
+    void QuantizeBC7Endpoint(const float endpoint[4], uint8_t quantized[4], uint32_t* pPBit)
+    {
+        float bestError = HUGE_VALF;
+        for (uint32_t p = 0; p < 2; p++)
+        {
+            uint8_t candidate[4];
+            float error = 0.0f;
+            for (int ch = 0; ch < 4; ch++)
+            {
+                const float value = (endpoint[ch] - p) / 2.0f + 0.5f;
+                candidate[ch] = static_cast<uint8_t>(std::min(std::max(value, 0.0f), 127.0f));
+                const float d = static_cast<float>((candidate[ch] << 1) | p) - endpoint[ch];
+                error += d * d;
+            }
+            if (error < bestError)
+            {
+                bestError = error;
+                memcpy(quantized, candidate, 4);
+                *pPBit = p;
+            }
+        }
+    }
+
+    void DecodeBC7Block(const uint8_t* pBlock, uint8_t* pTexels)
+    {
+        if ((pBlock[0] & 0x3f) == 0x20)
+        {
+            DecodeBC7Mode5Block(pBlock, pTexels);
+            return;
+        }
+        if ((pBlock[0] & 0x7f) != 0x40)
+        {
+            memset(pTexels, 0, 64);
+            return;
+        }
+
+        BitReader reader = { pBlock, 7 };
+        uint32_t endpoints[2][4];
+        for (int ch = 0; ch < 4; ch++)
+        {
+            endpoints[0][ch] = reader.Read(7);
+            endpoints[1][ch] = reader.Read(7);
+        }
+        const uint32_t p0 = reader.Read(1);
+        const uint32_t p1 = reader.Read(1);
+        for (int ch = 0; ch < 4; ch++)
+        {
+            endpoints[0][ch] = (endpoints[0][ch] << 1) | p0;
+            endpoints[1][ch] = (endpoints[1][ch] << 1) | p1;
+        }
+
+        for (int i = 0; i < 16; i++)
+        {
+            const uint32_t weight = BC7Weights4[reader.Read(i == 0 ? 3 : 4)];
+            for (int ch = 0; ch < 4; ch++)
+            {
+                pTexels[i * 4 + ch] = static_cast<uint8_t>(((64 - weight) * endpoints[0][ch] + weight * endpoints[1][ch] + 32) >> 6);
+            }
+        }
+    }
+
+    void PackBC7Block(const uint8_t q0[4], uint32_t p0, const uint8_t q1[4], uint32_t p1, const uint8_t* pIndices, uint8_t* pBlock)
+    {
+        // The anchor texel's index has an implicit zero top bit.
+        const bool swap = pIndices[0] >= 8;
+        if (swap)
+        {
+            std::swap(q0, q1);
+            std::swap(p0, p1);
+        }
+
+        memset(pBlock, 0, 16);
+        BitWriter writer = { pBlock, 0 };
+        writer.Write(1 << 6, 7);
+        for (int ch = 0; ch < 4; ch++)
+        {
+            writer.Write(q0[ch], 7);
+            writer.Write(q1[ch], 7);
+        }
+        writer.Write(p0, 1);
+        writer.Write(p1, 1);
+        for (int i = 0; i < 16; i++)
+        {
+            const uint32_t index = swap ? 15 - pIndices[i] : pIndices[i];
+            writer.Write(index, i == 0 ? 3 : 4);
+        }
+    }
+
+    void EncodeBC7Block(const uint8_t* pTexels, const BlockTexels& texels, uint8_t* pBlock)
+    {
+        if (IsSolidBlock(pTexels, 0xf))
+        {
+            EncodeBC7SolidBlock(pTexels, pBlock);
+            return;
+        }
+
+        float a[4];
+        float b[4];
+        ComputeAxisEndpoints(texels, 4, a, b);
+
+        uint32_t bestError = UINT32_MAX;
+        for (int iteration = 0; iteration <= RefineIterations; iteration++)
+        {
+            uint8_t q0[4];
+            uint8_t q1[4];
+            uint32_t p0;
+            uint32_t p1;
+            QuantizeBC7Endpoint(a, q0, &p0);
+            QuantizeBC7Endpoint(b, q1, &p1);
+
+            float e0[4];
+            float e1[4];
+            for (int ch = 0; ch < 4; ch++)
+            {
+                e0[ch] = static_cast<float>((q0[ch] << 1) | p0);
+                e1[ch] = static_cast<float>((q1[ch] << 1) | p1);
+            }
+
+            // The weights are only nearly even; let each texel move one step if
+            // the real palette entry next to it is closer.
+            uint8_t indices[16];
+            QuantizeToSegment(texels, e0, e1, 16, indices);
+            for (int i = 0; i < 16; i++)
+            {
+                float bestDistance = HUGE_VALF;
+                const int first = std::max(indices[i] - 1, 0);
+                const int last = std::min(indices[i] + 1, 15);
+                for (int index = first; index <= last; index++)
+                {
+                    float distance = 0.0f;
+                    for (int ch = 0; ch < 4; ch++)
+                    {
+                        const float value = std::floor(((64 - BC7Weights4[index]) * e0[ch] + BC7Weights4[index] * e1[ch] + 32.0f) / 64.0f);
+                        distance += (value - texels.c[ch][i]) * (value - texels.c[ch][i]);
+                    }
+                    if (distance < bestDistance)
+                    {
+                        bestDistance = distance;
+                        indices[i] = static_cast<uint8_t>(index);
+                    }
+                }
+            }
+
+            uint8_t candidate[16];
+            uint8_t decoded[64];
+            PackBC7Block(q0, p0, q1, p1, indices, candidate);
+            DecodeBC7Block(candidate, decoded);
+
+            const uint32_t error = BlockError(pTexels, decoded, 0xf);
+            if (error < bestError)
+            {
+                bestError = error;
+                memcpy(pBlock, candidate, sizeof(candidate));
+            }
+
+            if (error == 0 || !FitEndpoints(texels, 4, indices, 16, a, b))
+            {
+                break;
+            }
+        }
+    }
+}
+
+uint32_t GetBCBlockBytes(BCFormat format)
+{
+    return format == BCFormat::BC1 || format == BCFormat::BC4 ? 8 : 16;
+}
+
+uint32_t GetBCDDSFormat(BCFormat format, bool srgb)
+{
+    switch (format)
+    {
+    case BCFormat::BC1:
+        return srgb ? DDSFormat::BC1_UNORM_SRGB : DDSFormat::BC1_UNORM;
+    case BCFormat::BC3:
+        return srgb ? DDSFormat::BC3_UNORM_SRGB : DDSFormat::BC3_UNORM;
+    case BCFormat::BC4:
+        return DDSFormat::BC4_UNORM;
+    case BCFormat::BC5:
+        return DDSFormat::BC5_UNORM;
+    case BCFormat::BC7:
+        return srgb ? DDSFormat::BC7_UNORM_SRGB : DDSFormat::BC7_UNORM;
+    }
+    return 0;
+}
+
+uint32_t GetBCChannelMask(BCFormat format)
+{
+    switch (format)
+    {
+    case BCFormat::BC1:
+        return 0x7;
+    case BCFormat::BC4:
+        return 0x1;
+    case BCFormat::BC5:
+        return 0x3;
+    default:
+        return 0xf;
+    }
+}
+
+void EncodeBCBlock(BCFormat format, const uint8_t* pTexels, uint8_t* pBlock)
+{
+    BlockTexels texels;
+    LoadTexels(pTexels, &texels);
+
+    switch (format)
+    {
+    case BCFormat::BC1:
+        EncodeColorBlock(pTexels, texels, true, pBlock);
+        break;
+    case BCFormat::BC3:
+        EncodeChannelBlock(texels, 3, pBlock);
+        EncodeColorBlock(pTexels, texels, false, pBlock + 8);
+        break;
+    case BCFormat::BC4:
+        EncodeChannelBlock(texels, 0, pBlock);
+        break;
+    case BCFormat::BC5:
+        EncodeChannelBlock(texels, 0, pBlock);
+        EncodeChannelBlock(texels, 1, pBlock + 8);
+        break;
+    case BCFormat::BC7:
+        EncodeBC7Block(pTexels, texels, pBlock);
+        break;
+    }
+}
+
+void DecodeBCBlock(BCFormat format, const uint8_t* pBlock, uint8_t* pTexels)
+{
+    // Channels the format does not store read back as the D3D defaults.
+    for (int i = 0; i < 16; i++)
+    {
+        pTexels[i * 4 + 0] = 0;
+        pTexels[i * 4 + 1] = 0;
+        pTexels[i * 4 + 2] = 0;
+        pTexels[i * 4 + 3] = 255;
+    }
+
+    switch (format)
+    {
+    case BCFormat::BC1:
+        DecodeColorBlock(pBlock, false, pTexels);
+        break;
+    case BCFormat::BC3:
+        DecodeColorBlock(pBlock + 8, true, pTexels);
+        DecodeChannelBlock(pBlock, 3, pTexels);
+        break;
+    case BCFormat::BC4:
+        DecodeChannelBlock(pBlock, 0, pTexels);
+        break;
+    case BCFormat::BC5:
+        DecodeChannelBlock(pBlock, 0, pTexels);
+        DecodeChannelBlock(pBlock + 8, 1, pTexels);
+        break;
+    case BCFormat::BC7:
+        DecodeBC7Block(pBlock, pTexels);
+        break;
+    }
+}
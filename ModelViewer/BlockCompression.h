@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+
+enum class BCFormat : uint32_t
+{
+    BC1,    // RGB, 1-bit alpha.
+    BC3,    // RGBA.
+    BC4,    // R.
+    BC5,    // RG.
+    BC7,    // RGBA, higher quality than BC3.
+};
+
+// Bytes of one 4x4 block.
+uint32_t GetBCBlockBytes(BCFormat format);
+
+// DXGI_FORMAT the blocks are stored as. Only BC1, BC3 and BC7 have sRGB variants.
+uint32_t GetBCDDSFormat(BCFormat format, bool srgb);
+
+// Channels the format stores, as a mask of 1 (R), 2 (G), 4 (B) and 8 (A).
+uint32_t GetBCChannelMask(BCFormat format);
+
+// Encodes 16 RGBA8 texels, row major, into one block. BC4 reads R, BC5 R and G.
+void EncodeBCBlock(BCFormat format, const uint8_t* pTexels, uint8_t* pBlock);
+
+// Decodes one block back into 16 RGBA8 texels. BC7 only decodes modes 5 and
+// 6, the ones the encoder emits; other modes come back as zero.
+void DecodeBCBlock(BCFormat format, const uint8_t* pBlock, uint8_t* pTexels);
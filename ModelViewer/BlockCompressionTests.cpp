@@ -0,0 +1,282 @@
+#include "BlockCompression.h"
+#include "UnitTest.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+    void FillSolid(const uint8_t color[4], uint8_t* pTexels)
+    {
+        for (int i = 0; i < 16; i++)
+        {
+            memcpy(pTexels + i * 4, color, 4);
+        }
+    }
+
+    // Largest difference over the channels the format stores.
+    int MaxError(BCFormat format, const uint8_t* pTexels, const uint8_t* pDecoded)
+    {
+        const uint32_t mask = GetBCChannelMask(format);
+        int error = 0;
+        for (int i = 0; i < 16; i++)
+        {
+            for (int ch = 0; ch < 4; ch++)
+            {
+                if (mask & (1u << ch))
+                {
+                    error = std::max(error, std::abs(pTexels[i * 4 + ch] - pDecoded[i * 4 + ch]));
+                }
+            }
+        }
+        return error;
+    }
+
+    int RoundTripError(BCFormat format, const uint8_t color[4])
+    {
+        uint8_t texels[64];
+        uint8_t block[16];
+        uint8_t decoded[64];
+        FillSolid(color, texels);
+        EncodeBCBlock(format, texels, block);
+        DecodeBCBlock(format, block, decoded);
+        return MaxError(format, texels, decoded);
+    }
+
+    uint8_t Expand(uint32_t value, uint32_t bits)
+    {
+        return static_cast<uint8_t>((value << (8 - bits)) | (value >> (2 * bits - 8)));
+    }
+
+    // BC4 and BC7 store any solid block exactly, BC7 in all four channels.
+    void TestSolidExact()
+    {
+        for (uint32_t value = 0; value < 256; value++)
+        {
+            const uint8_t v = static_cast<uint8_t>(value);
+            const uint8_t grey[4] = { v, v, v, 255 };
+            const uint8_t mixed[4] = { v, static_cast<uint8_t>(255 - v), static_cast<uint8_t>(v * 7), static_cast<uint8_t>(v * 13) };
+            const uint8_t extremes[4] = { v, 0, 255, v };
+            CHECK(RoundTripError(BCFormat::BC4, grey) == 0);
+            CHECK(RoundTripError(BCFormat::BC5, mixed) == 0);
+            CHECK(RoundTripError(BCFormat::BC7, grey) == 0);
+            CHECK(RoundTripError(BCFormat::BC7, mixed) == 0);
+            CHECK(RoundTripError(BCFormat::BC7, extremes) == 0);
+        }
+
+        uint32_t random = 1;
+        for (int i = 0; i < 10000; i++)
+        {
+            random = random * 1664525u + 1013904223u;
+            uint8_t color[4];
+            memcpy(color, &random, 4);
+            CHECK(RoundTripError(BCFormat::BC7, color) == 0);
+        }
+    }
+
+    // Every colour on the 565 grid comes back exactly; the 2/3 blends can
+    // miss a value in between by one, and no BC1 block does better.
+    void TestSolidColorBlocks()
+    {
+        for (uint32_t r = 0; r < 32; r++)
+        {
+            for (uint32_t g = 0; g < 64; g++)
+            {
+                for (uint32_t b = 0; b < 32; b += 3)
+                {
+                    const uint8_t color[4] = { Expand(r, 5), Expand(g, 6), Expand(b, 5), 255 };
+                    CHECK(RoundTripError(BCFormat::BC1, color) == 0);
+                    CHECK(RoundTripError(BCFormat::BC3, color) == 0);
+                }
+            }
+        }
+
+        for (uint32_t value = 0; value < 256; value++)
+        {
+            const uint8_t v = static_cast<uint8_t>(value);
+            const uint8_t color[4] = { v, static_cast<uint8_t>(255 - v), static_cast<uint8_t>(v * 7), 255 };
+            CHECK(RoundTripError(BCFormat::BC1, color) <= 1);
+            CHECK(RoundTripError(BCFormat::BC3, color) <= 1);
+        }
+    }
+
+    uint32_t ReadBits(const uint8_t* pBlock, uint32_t first, uint32_t count)
+    {
+        uint32_t value = 0;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const uint32_t bit = first + i;
+            value |= static_cast<uint32_t>((pBlock[bit >> 3] >> (bit & 7)) & 1) << i;
+        }
+        return value;
+    }
+
+    void WriteBits(uint8_t* pBlock, uint32_t first, uint32_t count, uint32_t value)
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const uint32_t bit = first + i;
+            pBlock[bit >> 3] |= static_cast<uint8_t>(((value >> i) & 1) << (bit & 7));
+        }
+    }
+
+    // Mode 6, LSB first: 7 mode bits (0b1000000), R0 R1 G0 G1 B0 B1 A0 A1 of
+    // 7 bits, the two p-bits, then 16 indices of 4 bits with the anchor's top
+    // bit left out.
+    void TestBC7Mode6Layout()
+    {
+        const uint32_t endpoints[2][4] = { { 10, 20, 30, 127 }, { 100, 90, 5, 64 } };
+        const uint32_t pBits[2] = { 1, 0 };
+        uint32_t indices[16];
+        for (int i = 0; i < 16; i++)
+        {
+            indices[i] = (i * 5) % 16;
+        }
+        CHECK(indices[0] < 8);
+
+        uint8_t block[16] = {};
+        uint32_t bit = 0;
+        WriteBits(block, bit, 7, 1 << 6);
+        bit += 7;
+        for (int ch = 0; ch < 4; ch++)
+        {
+            WriteBits(block, bit, 7, endpoints[0][ch]);
+            WriteBits(block, bit + 7, 7, endpoints[1][ch]);
+            bit += 14;
+        }
+        CHECK(bit == 63);
+        WriteBits(block, 63, 1, pBits[0]);
+        WriteBits(block, 64, 1, pBits[1]);
+        bit = 65;
+        for (int i = 0; i < 16; i++)
+        {
+            WriteBits(block, bit, i == 0 ? 3 : 4, indices[i]);
+            bit += i == 0 ? 3 : 4;
+        }
+        CHECK(bit == 128);
+
+        static const uint32_t Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+        uint8_t decoded[64];
+        DecodeBCBlock(BCFormat::BC7, block, decoded);
+        for (int i = 0; i < 16; i++)
+        {
+            for (int ch = 0; ch < 4; ch++)
+            {
+                const uint32_t e0 = (endpoints[0][ch] << 1) | pBits[0];
+                const uint32_t e1 = (endpoints[1][ch] << 1) | pBits[1];
+                const uint32_t expected = ((64 - Weights[indices[i]]) * e0 + Weights[indices[i]] * e1 + 32) >> 6;
+                CHECK(decoded[i * 4 + ch] == expected);
+            }
+        }
+
+        // The encoder writes mode 6 for anything not solid, and puts an
+        // anchor index that fits in 3 bits.
+        uint8_t texels[64];
+        for (int i = 0; i < 16; i++)
+        {
+            const uint8_t texel[4] = { static_cast<uint8_t>(255 - i * 16), static_cast<uint8_t>(i * 8), 40, static_cast<uint8_t>(128 + i * 4) };
+            memcpy(texels + i * 4, texel, 4);
+        }
+        uint8_t encoded[16];
+        EncodeBCBlock(BCFormat::BC7, texels, encoded);
+        CHECK(ReadBits(encoded, 0, 7) == 1 << 6);
+        uint8_t reencoded[64];
+        DecodeBCBlock(BCFormat::BC7, encoded, reencoded);
+        CHECK(MaxError(BCFormat::BC7, texels, reencoded) <= 4);
+
+        // Solid blocks are mode 5: 6 mode bits (0b100000), no rotation.
+        const uint8_t solid[4] = { 0, 255, 17, 200 };
+        FillSolid(solid, texels);
+        EncodeBCBlock(BCFormat::BC7, texels, encoded);
+        CHECK(ReadBits(encoded, 0, 6) == 1 << 5);
+        CHECK(ReadBits(encoded, 6, 2) == 0);
+        CHECK(ReadBits(encoded, 50, 8) == 200);
+        CHECK(ReadBits(encoded, 58, 8) == 200);
+
+        // Modes the decoder does not handle read as zero.
+        uint8_t mode1[16] = { 0x02 };
+        DecodeBCBlock(BCFormat::BC7, mode1, decoded);
+        CHECK(decoded[0] == 0 && decoded[3] == 0 && decoded[63] == 0);
+    }
+
+    double Psnr(BCFormat format, const uint8_t* pTexels, const uint8_t* pDecoded)
+    {
+        const uint32_t mask = GetBCChannelMask(format);
+        double squared = 0.0;
+        uint32_t samples = 0;
+        for (int i = 0; i < 16; i++)
+        {
+            for (int ch = 0; ch < 4; ch++)
+            {
+                if (mask & (1u << ch))
+                {
+                    const double d = static_cast<double>(pTexels[i * 4 + ch]) - pDecoded[i * 4 + ch];
+                    squared += d * d;
+                    samples++;
+                }
+            }
+        }
+        const double mse = squared / samples;
+        return mse == 0.0 ? 99.0 : 10.0 * std::log10(255.0 * 255.0 / mse);
+    }
+
+    // A diagonal gradient between two colours, the case block compression
+    // is built for; alpha stays opaque enough for BC1. The floors sit a
+    // little under what the encoder reaches, so a regression in endpoint
+    // fitting shows up.
+    void TestGradientQuality()
+    {
+        uint8_t texels[64];
+        for (int y = 0; y < 4; y++)
+        {
+            for (int x = 0; x < 4; x++)
+            {
+                const int t = x + y;
+                uint8_t* pTexel = texels + (y * 4 + x) * 4;
+                pTexel[0] = static_cast<uint8_t>(40 + t * 29);
+                pTexel[1] = static_cast<uint8_t>(200 - t * 17);
+                pTexel[2] = static_cast<uint8_t>(90 + t * 11);
+                pTexel[3] = static_cast<uint8_t>(250 - t * 19);
+            }
+        }
+
+        struct Floor
+        {
+            BCFormat format;
+            const char* pName;
+            double psnr;
+        };
+        const Floor floors[] =
+        {
+            { BCFormat::BC1, "BC1", 27.0 },
+            { BCFormat::BC3, "BC3", 28.0 },
+            { BCFormat::BC4, "BC4", 29.0 },
+            { BCFormat::BC5, "BC5", 30.0 },
+            { BCFormat::BC7, "BC7", 41.0 },
+        };
+        printf("gradient block PSNR:");
+        for (const Floor& floor : floors)
+        {
+            uint8_t block[16];
+            uint8_t decoded[64];
+            EncodeBCBlock(floor.format, texels, block);
+            DecodeBCBlock(floor.format, block, decoded);
+            const double psnr = Psnr(floor.format, texels, decoded);
+            CHECK(psnr >= floor.psnr);
+            printf(" %s %.1f dB", floor.pName, psnr);
+        }
+        printf("\n");
+    }
+}
+
+int main()
+{
+    TestSolidExact();
+    TestSolidColorBlocks();
+    TestBC7Mode6Layout();
+    TestGradientQuality();
+    return TestFailures();
+}
@@ -0,0 +1,314 @@
+#include "ClusteredLights.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define CLUSTER_USE_SSE2 1
+#endif
+
+namespace
+{
+    // Padding lights sit here with no radius: their squared distance to any
+    // box overflows to infinity and never passes.
+    const float FarAway = 1e30f;
+
+    void ForEach(ThreadPool* pThreads, size_t count, const std::function<void(size_t begin, size_t end)>& body)
+    {
+        if (pThreads != nullptr)
+        {
+            pThreads->ParallelFor(count, 1, body);
+        }
+        else
+        {
+            body(0, count);
+        }
+    }
+}
+
+ClusterLightAssigner::ClusterLightAssigner() :
+    _fovYRadians(0.0f),
+    _aspectRatio(0.0f),
+    _sliceScale(0.0f),
+    _sliceBias(0.0f),
+    _stats()
+{
+}
+
+void ClusterLightAssigner::SetGrid(const ClusterGridSettings& settings, float fovYRadians, float aspectRatio)
+{
+    if (!_clusterBounds.empty() &&
+        settings.tilesX == _settings.tilesX &&
+        settings.tilesY == _settings.tilesY &&
+        settings.slices == _settings.slices &&
+        settings.nearZ == _settings.nearZ &&
+        settings.farZ == _settings.farZ &&
+        settings.maxLightsPerCluster == _settings.maxLightsPerCluster &&
+        fovYRadians == _fovYRadians &&
+        aspectRatio == _aspectRatio)
+    {
+        return;
+    }
+
+    _settings = settings;
+    _settings.tilesX = std::max(_settings.tilesX, 1u);
+    _settings.tilesY = std::max(_settings.tilesY, 1u);
+    _settings.slices = std::max(_settings.slices, 1u);
+    _fovYRadians = fovYRadians;
+    _aspectRatio = aspectRatio;
+
+    const uint32_t tilesX = _settings.tilesX;
+    const uint32_t tilesY = _settings.tilesY;
+    const uint32_t slices = _settings.slices;
+    const float depthRatio = std::log(_settings.farZ / _settings.nearZ);
+    _sliceScale = slices / depthRatio;
+    _sliceBias = -std::log(_settings.nearZ) * _sliceScale;
+
+    // A tile spans [left, right] x [bottom, top] in NDC; at view depth z that
+    // is that times z * tan in view space, so a cell's extremes lie on its
+    // near or far face.
+    const float tanY = std::tan(fovYRadians * 0.5f);
+    const float tanX = tanY * aspectRatio;
+    _clusterBounds.resize(static_cast<size_t>(tilesX) * tilesY * slices);
+    _rowBounds.resize(static_cast<size_t>(tilesY) * slices);
+    _sliceBounds.resize(slices);
+    for (uint32_t slice = 0; slice < slices; slice++)
+    {
+        const float nearZ = _settings.nearZ * std::exp(depthRatio * slice / slices);
+        const float farZ = slice + 1 == slices ? _settings.farZ : _settings.nearZ * std::exp(depthRatio * (slice + 1) / slices);
+        for (uint32_t y = 0; y < tilesY; y++)
+        {
+            const float top = 1.0f - 2.0f * y / tilesY;
+            const float bottom = 1.0f - 2.0f * (y + 1) / tilesY;
+            for (uint32_t x = 0; x < tilesX; x++)
+            {
+                const float left = -1.0f + 2.0f * x / tilesX;
+                const float right = -1.0f + 2.0f * (x + 1) / tilesX;
+                Bounds& bounds = _clusterBounds[(static_cast<size_t>(slice) * tilesY + y) * tilesX + x];
+                bounds.min[0] = std::min(left * nearZ, left * farZ) * tanX;
+                bounds.max[0] = std::max(right * nearZ, right * farZ) * tanX;
+                bounds.min[1] = std::min(bottom * nearZ, bottom * farZ) * tanY;
+                bounds.max[1] = std::max(top * nearZ, top * farZ) * tanY;
+                bounds.min[2] = nearZ;
+                bounds.max[2] = farZ;
+            }
+        }
+    }
+
+    // Rows and slices bound the clusters in them.
+    for (size_t row = 0; row < _rowBounds.size(); row++)
+    {
+        Bounds& bounds = _rowBounds[row];
+        bounds = _clusterBounds[row * tilesX];
+        for (uint32_t x = 1; x < tilesX; x++)
+        {
+            const Bounds& cluster = _clusterBounds[row * tilesX + x];
+            for (int axis = 0; axis < 3; axis++)
+            {
+                bounds.min[axis] = std::min(bounds.min[axis], cluster.min[axis]);
+                bounds.max[axis] = std::max(bounds.max[axis], cluster.max[axis]);
+            }
+        }
+    }
+    for (uint32_t slice = 0; slice < slices; slice++)
+    {
+        Bounds& bounds = _sliceBounds[slice];
+        bounds = _rowBounds[static_cast<size_t>(slice) * tilesY];
+        for (uint32_t y = 1; y < tilesY; y++)
+        {
+            const Bounds& row = _rowBounds[static_cast<size_t>(slice) * tilesY + y];
+            for (int axis = 0; axis < 3; axis++)
+            {
+                bounds.min[axis] = std::min(bounds.min[axis], row.min[axis]);
+                bounds.max[axis] = std::max(bounds.max[axis], row.max[axis]);
+            }
+        }
+    }
+
+    _sliceLights.resize(slices);
+    _sliceSelected.resize(slices);
+    _rows.resize(_rowBounds.size());
+    _ranges.assign(_clusterBounds.size(), ClusterRange());
+}
+
+void ClusterLightAssigner::Assign(const PointLight* pLights, size_t count, const float view[16], ThreadPool* pThreads)
+{
+    _stats = {};
+    _stats.lights = static_cast<uint32_t>(count);
+
+    ResizeLightSet(count, &_viewLights);
+    for (size_t i = 0; i < count; i++)
+    {
+        const float* p = pLights[i].position;
+        _viewLights.x[i] = p[0] * view[0] + p[1] * view[4] + p[2] * view[8] + view[12];
+        _viewLights.y[i] = p[0] * view[1] + p[1] * view[5] + p[2] * view[9] + view[13];
+        _viewLights.z[i] = p[0] * view[2] + p[1] * view[6] + p[2] * view[10] + view[14];
+        _viewLights.radius[i] = pLights[i].radius;
+        _viewLights.index[i] = static_cast<uint32_t>(i);
+    }
+
+    ForEach(pThreads, _sliceBounds.size(), [this](size_t begin, size_t end)
+    {
+        for (size_t slice = begin; slice < end; slice++)
+        {
+            AssignSlice(static_cast<uint32_t>(slice));
+        }
+    });
+    ForEach(pThreads, _rows.size(), [this](size_t begin, size_t end)
+    {
+        for (size_t row = begin; row < end; row++)
+        {
+            AssignRow(static_cast<uint32_t>(row));
+        }
+    });
+
+    // Rows are in cluster order, so their lists go back to back.
+    uint32_t offset = 0;
+    for (ClusterRange& range : _ranges)
+    {
+        range.offset = offset;
+        offset += range.count;
+        _stats.maxClusterLights = std::max(_stats.maxClusterLights, range.count);
+    }
+    _stats.indices = offset;
+    _lightIndices.resize(offset);
+
+    const uint32_t tilesX = _settings.tilesX;
+    ForEach(pThreads, _rows.size(), [this, tilesX](size_t begin, size_t end)
+    {
+        for (size_t row = begin; row < end; row++)
+        {
+            const std::vector<uint32_t>& indices = _rows[row].indices;
+            if (!indices.empty())
+            {
+                memcpy(_lightIndices.data() + _ranges[row * tilesX].offset, indices.data(), indices.size() * sizeof(uint32_t));
+            }
+        }
+    });
+    for (const Row& row : _rows)
+    {
+        _stats.overflowClusters += row.overflowClusters;
+    }
+}
+
+void ClusterLightAssigner::AssignSlice(uint32_t slice)
+{
+    std::vector<uint32_t>& selected = _sliceSelected[slice];
+    selected.resize(_viewLights.x.size());
+    const size_t count = SelectLights(_viewLights, _sliceBounds[slice], selected.data());
+    GatherLights(_viewLights, selected.data(), count, &_sliceLights[slice]);
+}
+
+void ClusterLightAssigner::AssignRow(uint32_t rowIndex)
+{
+    Row& row = _rows[rowIndex];
+    const LightSet& sliceLights = _sliceLights[rowIndex / _settings.tilesY];
+    row.selected.resize(sliceLights.x.size());
+    row.indices.clear();
+    row.overflowClusters = 0;
+
+    const size_t rowCount = SelectLights(sliceLights, _rowBounds[rowIndex], row.selected.data());
+    GatherLights(sliceLights, row.selected.data(), rowCount, &row.lights);
+
+    const size_t firstCluster = static_cast<size_t>(rowIndex) * _settings.tilesX;
+    for (uint32_t x = 0; x < _settings.tilesX; x++)
+    {
+        size_t count = rowCount == 0 ? 0 : SelectLights(row.lights, _clusterBounds[firstCluster + x], row.selected.data());
+        if (count > _settings.maxLightsPerCluster)
+        {
+            count = _settings.maxLightsPerCluster;
+            row.overflowClusters++;
+        }
+        for (size_t i = 0; i < count; i++)
+        {
+            row.indices.push_back(row.lights.index[row.selected[i]]);
+        }
+        _ranges[firstCluster + x].count = static_cast<uint32_t>(count);
+    }
+}
+
+void ClusterLightAssigner::ResizeLightSet(size_t count, LightSet* pLights)
+{
+    const size_t padded = (count + 3) & ~static_cast<size_t>(3);
+    pLights->x.resize(padded);
+    pLights->y.resize(padded);
+    pLights->z.resize(padded);
+    pLights->radius.resize(padded);
+    pLights->index.resize(padded);
+    pLights->count = count;
+    for (size_t i = count; i < padded; i++)
+    {
+        pLights->x[i] = FarAway;
+        pLights->y[i] = FarAway;
+        pLights->z[i] = FarAway;
+        pLights->radius[i] = 0.0f;
+        pLights->index[i] = 0;
+    }
+}
+
+// Squared distance from each light's center to the box against its radius
+// squared. Every lane writes its position, only those that pass advance, so
+// there is no branch per light.
+size_t ClusterLightAssigner::SelectLights(const LightSet& lights, const Bounds& bounds, uint32_t* pSelected)
+{
+    size_t selected = 0;
+#if CLUSTER_USE_SSE2
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 minX = _mm_set1_ps(bounds.min[0]);
+    const __m128 minY = _mm_set1_ps(bounds.min[1]);
+    const __m128 minZ = _mm_set1_ps(bounds.min[2]);
+    const __m128 maxX = _mm_set1_ps(bounds.max[0]);
+    const __m128 maxY = _mm_set1_ps(bounds.max[1]);
+    const __m128 maxZ = _mm_set1_ps(bounds.max[2]);
+    for (size_t i = 0; i < lights.x.size(); i += 4)
+    {
+        const __m128 x = _mm_loadu_ps(&lights.x[i]);
+        const __m128 y = _mm_loadu_ps(&lights.y[i]);
+        const __m128 z = _mm_loadu_ps(&lights.z[i]);
+        const __m128 radius = _mm_loadu_ps(&lights.radius[i]);
+        const __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minX, x), _mm_sub_ps(x, maxX)), zero);
+        const __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minY, y), _mm_sub_ps(y, maxY)), zero);
+        const __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minZ, z), _mm_sub_ps(z, maxZ)), zero);
+        const __m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+        const int mask = _mm_movemask_ps(_mm_cmple_ps(distanceSquared, _mm_mul_ps(radius, radius)));
+
+        const uint32_t position = static_cast<uint32_t>(i);
+        pSelected[selected] = position;
+        selected += mask & 1;
+        pSelected[selected] = position + 1;
+        selected += (mask >> 1) & 1;
+        pSelected[selected] = position + 2;
+        selected += (mask >> 2) & 1;
+        pSelected[selected] = position + 3;
+        selected += (mask >> 3) & 1;
+    }
+#else
+    for (size_t i = 0; i < lights.x.size(); i++)
+    {
+        const float dx = std::max(std::max(bounds.min[0] - lights.x[i], lights.x[i] - bounds.max[0]), 0.0f);
+        const float dy = std::max(std::max(bounds.min[1] - lights.y[i], lights.y[i] - bounds.max[1]), 0.0f);
+        const float dz = std::max(std::max(bounds.min[2] - lights.z[i], lights.z[i] - bounds.max[2]), 0.0f);
+        pSelected[selected] = static_cast<uint32_t>(i);
+        selected += dx * dx + dy * dy + dz * dz <= lights.radius[i] * lights.radius[i] ? 1 : 0;
+    }
+#endif
+    return selected;
+}
+
+void ClusterLightAssigner::GatherLights(const LightSet& source, const uint32_t* pSelected, size_t count, LightSet* pTarget)
+{
+    ResizeLightSet(count, pTarget);
+    for (size_t i = 0; i < count; i++)
+    {
+        const uint32_t from = pSelected[i];
+        pTarget->x[i] = source.x[from];
+        pTarget->y[i] = source.y[from];
+        pTarget->z[i] = source.z[from];
+        pTarget->radius[i] = source.radius[from];
+        pTarget->index[i] = source.index[from];
+    }
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+// A point light as the scene shaders read it, one structured buffer element.
+struct PointLight
+{
+    float position[3];          // World space.
+    float radius;               // Where the falloff reaches zero; nothing is lit beyond.
+    float color[3];
+    float intensity;
+};
+
+// The view frustum split into tilesX * tilesY screen tiles and slices depth
+// slices. Tile (0, 0) is the top left of the viewport, like SV_Position.
+// Slices split [nearZ, farZ] of view depth exponentially, so clusters stay
+// about as deep as they are wide; lights beyond farZ are not assigned.
+struct ClusterGridSettings
+{
+    uint32_t tilesX = 16;
+    uint32_t tilesY = 9;
+    uint32_t slices = 24;
+    float nearZ = 0.1f;                     // The projection's near plane.
+    float farZ = 500.0f;
+    uint32_t maxLightsPerCluster = 128;     // Further lights are dropped, and the cluster counted.
+};
+
+// The lights of a cluster: count entries of the light index list from offset.
+struct ClusterRange
+{
+    uint32_t offset;
+    uint32_t count;
+};
+
+struct ClusterLightStats
+{
+    uint32_t lights;
+    uint32_t indices;
+    uint32_t maxClusterLights;
+    uint32_t overflowClusters;
+};
+
+// Assigns point lights to the clusters they touch, on the CPU. Lights go to
+// view space once, then through three rounds of sphere against box tests,
+// four lights at a time: the box of a slice, of a row of tiles in it, and of
+// each cluster in the row. Each round only sees the lights that passed the
+// one before. Slices, then rows, are spread over the thread pool; a row owns
+// its clusters, so workers never share output. The result is a range per
+// cluster into one compact index list, clusters ordered x fastest, then y,
+// then slice, ready to upload as is. Cluster boxes bound the frustum cells,
+// so a light near a cell's corner may be listed where it lights nothing.
+// Not thread-safe.
+class ClusterLightAssigner
+{
+public: ClusterLightAssigner();
+
+    // Left-handed perspective, as MakeReverseZPerspective() builds it. Cheap
+    // when nothing changed.
+public: void SetGrid(const ClusterGridSettings& settings, float fovYRadians, float aspectRatio);
+public: const ClusterGridSettings& GetSettings() const { return _settings; }
+
+    // The shader finds a pixel's slice as log(viewZ) * scale + bias.
+public: float GetSliceScale() const { return _sliceScale; }
+public: float GetSliceBias() const { return _sliceBias; }
+
+    // view is row-major with row vectors, world to view space. Without
+    // threads everything runs on the caller.
+public: void Assign(const PointLight* pLights, size_t count, const float view[16], ThreadPool* pThreads);
+
+public: uint32_t GetClusterCount() const { return static_cast<uint32_t>(_ranges.size()); }
+public: const std::vector<ClusterRange>& GetRanges() const { return _ranges; }
+public: const std::vector<uint32_t>& GetLightIndices() const { return _lightIndices; }
+public: const ClusterLightStats& GetStats() const { return _stats; }
+
+    // Lights in structure of arrays form, padded with lights that touch
+    // nothing to a multiple of four.
+private: struct LightSet
+    {
+        std::vector<float> x;
+        std::vector<float> y;
+        std::vector<float> z;
+        std::vector<float> radius;
+        std::vector<uint32_t> index;    // Into the lights passed to Assign().
+        size_t count = 0;               // Without the padding.
+    };
+
+private: struct Bounds
+    {
+        float min[3];
+        float max[3];
+    };
+
+private: struct Row
+    {
+        LightSet lights;                // Those touching the row's box.
+        std::vector<uint32_t> selected;
+        std::vector<uint32_t> indices;  // The row's clusters' lists, back to back.
+        uint32_t overflowClusters;
+    };
+
+    // Writes the positions in lights of those touching bounds to pSelected,
+    // which has room for lights.x.size() entries, and returns their number.
+private: static void ResizeLightSet(size_t count, LightSet* pLights);
+private: static size_t SelectLights(const LightSet& lights, const Bounds& bounds, uint32_t* pSelected);
+private: static void GatherLights(const LightSet& source, const uint32_t* pSelected, size_t count, LightSet* pTarget);
+
+private: void AssignSlice(uint32_t slice);
+private: void AssignRow(uint32_t row);
+
+private: ClusterGridSettings _settings;
+private: float _fovYRadians;
+private: float _aspectRatio;
+private: float _sliceScale;
+private: float _sliceBias;
+
+private: std::vector<Bounds> _clusterBounds;
+private: std::vector<Bounds> _rowBounds;       // Slice major, like the clusters.
+private: std::vector<Bounds> _sliceBounds;
+
+private: LightSet _viewLights;
+private: std::vector<LightSet> _sliceLights;
+private: std::vector<std::vector<uint32_t>> _sliceSelected;
+private: std::vector<Row> _rows;
+
+private: std::vector<ClusterRange> _ranges;
+private: std::vector<uint32_t> _lightIndices;
+private: ClusterLightStats _stats;
+};
@@ -0,0 +1,332 @@
+#include "Benchmark.h"
+#include "ClusteredLights.h"
+#include "ThreadPool.h"
+#include "UnitTest.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace
+{
+    const float FieldOfView = 60.0f * 3.14159265f / 180.0f;
+    const float AspectRatio = 16.0f / 9.0f;
+
+    // The city lights benchmark scene: 10000 lights over the grid, seen
+    // from the orbit.
+    const char* const CityLights =
+        "name city lights\n"
+        "seed 42\n"
+        "grid 150 150 2.5 12 6\n"
+        "lights 10000 4\n"
+        "camera 0  0 40 -200   0 0 0\n"
+        "camera 5  200 40 0    0 0 0\n"
+        "camera 10 0 40 200    0 0 0\n";
+
+    struct Scene
+    {
+        BenchmarkScript script;
+        std::vector<PointLight> lights;
+    };
+
+    bool LoadScene(const char* pText, uint32_t lightCount, Scene* pScene)
+    {
+        std::string error;
+        if (!ParseBenchmarkScript(pText, &pScene->script, &error))
+        {
+            return false;
+        }
+        pScene->script.lightCount = lightCount;
+        BuildBenchmarkLights(pScene->script, &pScene->lights);
+        return true;
+    }
+
+    // The benchmark's grid, with a different light limit.
+    void SetSceneGrid(const Scene& scene, uint32_t maxLightsPerCluster, ClusterLightAssigner* pAssigner)
+    {
+        SetBenchmarkClusterGrid(scene.script, AspectRatio, pAssigner);
+        ClusterGridSettings settings = pAssigner->GetSettings();
+        settings.maxLightsPerCluster = maxLightsPerCluster;
+        pAssigner->SetGrid(settings, FieldOfView, AspectRatio);
+    }
+
+    // The grid as the header describes it, and every light tested against
+    // every cluster's box, one at a time: what Assign() has to reproduce
+    // with its rounds of four-wide tests.
+    void AssignBruteForce(
+        const ClusterGridSettings& settings,
+        const std::vector<PointLight>& lights,
+        const float view[16],
+        std::vector<std::vector<uint32_t>>* pClusters)
+    {
+        pClusters->assign(static_cast<size_t>(settings.tilesX) * settings.tilesY * settings.slices, std::vector<uint32_t>());
+        const float tanY = std::tan(FieldOfView * 0.5f);
+        const float tanX = tanY * AspectRatio;
+        const float depthRatio = std::log(settings.farZ / settings.nearZ);
+        for (uint32_t slice = 0; slice < settings.slices; slice++)
+        {
+            const float nearZ = settings.nearZ * std::exp(depthRatio * slice / settings.slices);
+            const float farZ = slice + 1 == settings.slices ? settings.farZ : settings.nearZ * std::exp(depthRatio * (slice + 1) / settings.slices);
+            for (uint32_t y = 0; y < settings.tilesY; y++)
+            {
+                const float top = 1.0f - 2.0f * y / settings.tilesY;
+                const float bottom = 1.0f - 2.0f * (y + 1) / settings.tilesY;
+                for (uint32_t x = 0; x < settings.tilesX; x++)
+                {
+                    const float left = -1.0f + 2.0f * x / settings.tilesX;
+                    const float right = -1.0f + 2.0f * (x + 1) / settings.tilesX;
+                    const float min[3] = { std::min(left * nearZ, left * farZ) * tanX, std::min(bottom * nearZ, bottom * farZ) * tanY, nearZ };
+                    const float max[3] = { std::max(right * nearZ, right * farZ) * tanX, std::max(top * nearZ, top * farZ) * tanY, farZ };
+
+                    std::vector<uint32_t>& cluster = (*pClusters)[(static_cast<size_t>(slice) * settings.tilesY + y) * settings.tilesX + x];
+                    for (size_t i = 0; i < lights.size(); i++)
+                    {
+                        const float* p = lights[i].position;
+                        const float center[3] =
+                        {
+                            p[0] * view[0] + p[1] * view[4] + p[2] * view[8] + view[12],
+                            p[0] * view[1] + p[1] * view[5] + p[2] * view[9] + view[13],
+                            p[0] * view[2] + p[1] * view[6] + p[2] * view[10] + view[14],
+                        };
+                        float distanceSquared = 0.0f;
+                        for (int axis = 0; axis < 3; axis++)
+                        {
+                            const float d = std::max(std::max(min[axis] - center[axis], center[axis] - max[axis]), 0.0f);
+                            distanceSquared += d * d;
+                        }
+                        if (distanceSquared <= lights[i].radius * lights[i].radius)
+                        {
+                            cluster.push_back(static_cast<uint32_t>(i));
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Each cluster's list is the brute force one, cut to the limit; the
+    // stats add up.
+    bool MatchesBruteForce(const ClusterLightAssigner& assigner, const std::vector<std::vector<uint32_t>>& expected)
+    {
+        const uint32_t limit = assigner.GetSettings().maxLightsPerCluster;
+        const std::vector<ClusterRange>& ranges = assigner.GetRanges();
+        const std::vector<uint32_t>& indices = assigner.GetLightIndices();
+        if (ranges.size() != expected.size())
+        {
+            return false;
+        }
+
+        uint32_t offset = 0;
+        uint32_t maxClusterLights = 0;
+        uint32_t overflowClusters = 0;
+        for (size_t cluster = 0; cluster < ranges.size(); cluster++)
+        {
+            const uint32_t count = static_cast<uint32_t>(std::min<size_t>(expected[cluster].size(), limit));
+            if (ranges[cluster].offset != offset || ranges[cluster].count != count ||
+                !std::equal(expected[cluster].begin(), expected[cluster].begin() + count, indices.begin() + offset))
+            {
+                return false;
+            }
+            offset += count;
+            maxClusterLights = std::max(maxClusterLights, count);
+            overflowClusters += expected[cluster].size() > limit ? 1 : 0;
+        }
+
+        const ClusterLightStats& stats = assigner.GetStats();
+        return offset == indices.size() &&
+            stats.indices == offset &&
+            stats.maxClusterLights == maxClusterLights &&
+            stats.overflowClusters == overflowClusters;
+    }
+
+    size_t CountEntries(const std::vector<std::vector<uint32_t>>& clusters)
+    {
+        size_t entries = 0;
+        for (const std::vector<uint32_t>& cluster : clusters)
+        {
+            entries += cluster.size();
+        }
+        return entries;
+    }
+
+    // 10000 lights from three points of the orbit, on one thread and on
+    // four, against the brute force assignment; the limit is high enough
+    // that nothing is dropped.
+    void TestMatchesBruteForce()
+    {
+        Scene scene;
+        CHECK(LoadScene(CityLights, 10000, &scene));
+
+        ClusterLightAssigner assigner;
+        SetSceneGrid(scene, 10000, &assigner);
+        ThreadPool threads(4);
+
+        const uint64_t frames[] = { 0, 75, 200 };
+        for (uint64_t frame : frames)
+        {
+            float view[16];
+            EvaluateBenchmarkView(scene.script, frame, view);
+            std::vector<std::vector<uint32_t>> expected;
+            AssignBruteForce(assigner.GetSettings(), scene.lights, view, &expected);
+            CHECK(CountEntries(expected) > 10000);
+
+            assigner.Assign(scene.lights.data(), scene.lights.size(), view, nullptr);
+            CHECK(assigner.GetStats().lights == 10000);
+            CHECK(assigner.GetStats().overflowClusters == 0);
+            CHECK(MatchesBruteForce(assigner, expected));
+
+            assigner.Assign(scene.lights.data(), scene.lights.size(), view, &threads);
+            CHECK(MatchesBruteForce(assigner, expected));
+        }
+    }
+
+    // Counts that are not a multiple of four, a grid that is not the
+    // default, and nothing at all.
+    void TestOddCounts()
+    {
+        Scene scene;
+        CHECK(LoadScene(CityLights, 1003, &scene));
+
+        ClusterGridSettings settings;
+        settings.tilesX = 7;
+        settings.tilesY = 5;
+        settings.slices = 11;
+        settings.farZ = 120.0f;
+        settings.maxLightsPerCluster = 1003;
+        ClusterLightAssigner assigner;
+        assigner.SetGrid(settings, FieldOfView, AspectRatio);
+        CHECK(assigner.GetClusterCount() == 7 * 5 * 11);
+
+        float view[16];
+        EvaluateBenchmarkView(scene.script, 40, view);
+        std::vector<std::vector<uint32_t>> expected;
+        for (size_t count : { size_t(1003), size_t(1), size_t(0) })
+        {
+            scene.lights.resize(count);
+            AssignBruteForce(assigner.GetSettings(), scene.lights, view, &expected);
+            assigner.Assign(scene.lights.data(), scene.lights.size(), view, nullptr);
+            CHECK(MatchesBruteForce(assigner, expected));
+        }
+        CHECK(assigner.GetStats().indices == 0);
+    }
+
+    // Lights behind the camera, past the far slice or off to the side light
+    // no cluster; one in front of the camera lights the middle clusters of
+    // its slice.
+    void TestOutsideFrustum()
+    {
+        ClusterGridSettings settings;
+        settings.tilesX = 4;
+        settings.tilesY = 4;
+        settings.slices = 8;
+        settings.nearZ = 1.0f;
+        settings.farZ = 256.0f;
+        ClusterLightAssigner assigner;
+        assigner.SetGrid(settings, FieldOfView, 1.0f);
+
+        const float view[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+        PointLight lights[4] = {};
+        lights[0].position[2] = -10.0f;
+        lights[0].radius = 5.0f;
+        lights[1].position[2] = 300.0f;
+        lights[1].radius = 10.0f;
+        lights[2].position[0] = 100.0f;
+        lights[2].position[2] = 10.0f;
+        lights[2].radius = 5.0f;
+        assigner.Assign(lights, 3, view, nullptr);
+        CHECK(assigner.GetStats().indices == 0);
+
+        // At depth 6, in slice 2 of [4, 8), and on the corner of the four
+        // middle tiles.
+        lights[3].position[2] = 6.0f;
+        lights[3].radius = 0.5f;
+        assigner.Assign(lights, 4, view, nullptr);
+        CHECK(assigner.GetStats().indices == 4);
+        const std::vector<ClusterRange>& ranges = assigner.GetRanges();
+        for (uint32_t cluster = 0; cluster < assigner.GetClusterCount(); cluster++)
+        {
+            const uint32_t x = cluster % 4;
+            const uint32_t y = cluster / 4 % 4;
+            const uint32_t slice = cluster / 16;
+            const bool lit = slice == 2 && (x == 1 || x == 2) && (y == 1 || y == 2);
+            CHECK(ranges[cluster].count == (lit ? 1u : 0u));
+        }
+        CHECK(assigner.GetLightIndices()[0] == 3);
+
+        // The shader's slice of that depth is the same.
+        CHECK(static_cast<uint32_t>(std::log(6.0f) * assigner.GetSliceScale() + assigner.GetSliceBias()) == 2);
+    }
+
+    // Past the limit a cluster keeps its first lights and is counted.
+    void TestOverflow()
+    {
+        Scene scene;
+        CHECK(LoadScene(CityLights, 10000, &scene));
+
+        ClusterLightAssigner assigner;
+        SetSceneGrid(scene, 16, &assigner);
+
+        float view[16];
+        EvaluateBenchmarkView(scene.script, 0, view);
+        std::vector<std::vector<uint32_t>> expected;
+        AssignBruteForce(assigner.GetSettings(), scene.lights, view, &expected);
+        ThreadPool threads(3);
+        assigner.Assign(scene.lights.data(), scene.lights.size(), view, &threads);
+        CHECK(assigner.GetStats().overflowClusters > 0);
+        CHECK(assigner.GetStats().maxClusterLights == 16);
+        CHECK(MatchesBruteForce(assigner, expected));
+    }
+
+    double TimeAssign(ClusterLightAssigner* pAssigner, const Scene& scene, const float view[16], ThreadPool* pThreads)
+    {
+        const int runs = 20;
+        const auto start = std::chrono::steady_clock::now();
+        for (int run = 0; run < runs; run++)
+        {
+            pAssigner->Assign(scene.lights.data(), scene.lights.size(), view, pThreads);
+        }
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / runs;
+    }
+
+    // What assigning the 10000 lights costs, on one thread, on the pool the
+    // benchmark target uses, and brute force.
+    void TestAssignmentTime()
+    {
+        Scene scene;
+        CHECK(LoadScene(CityLights, 10000, &scene));
+
+        ClusterLightAssigner assigner;
+        SetBenchmarkClusterGrid(scene.script, AspectRatio, &assigner);
+        float view[16];
+        EvaluateBenchmarkView(scene.script, 0, view);
+
+        ThreadPool threads;
+        const double singleMilliseconds = TimeAssign(&assigner, scene, view, nullptr);
+        const double threadedMilliseconds = TimeAssign(&assigner, scene, view, &threads);
+
+        std::vector<std::vector<uint32_t>> expected;
+        const auto start = std::chrono::steady_clock::now();
+        AssignBruteForce(assigner.GetSettings(), scene.lights, view, &expected);
+        const double bruteForceMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        CHECK(MatchesBruteForce(assigner, expected));
+
+        const ClusterLightStats& stats = assigner.GetStats();
+        printf("%u lights into %u clusters: %.2f ms on one thread, %.2f ms on %u, %.1f ms brute force; "
+            "%u cluster entries, up to %u per cluster, %u clusters full\n",
+            stats.lights, assigner.GetClusterCount(), singleMilliseconds, threadedMilliseconds, threads.GetThreadCount(),
+            bruteForceMilliseconds, stats.indices, stats.maxClusterLights, stats.overflowClusters);
+    }
+}
+
+int main()
+{
+    TestMatchesBruteForce();
+    TestOddCounts();
+    TestOutsideFrustum();
+    TestOverflow();
+    TestAssignmentTime();
+    return TestFailures();
+}
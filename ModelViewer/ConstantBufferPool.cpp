@@ -0,0 +1,71 @@
+#include "ConstantBufferPool.h"
+
+#include <cstring>
+
+ConstantBufferPool::ConstantBufferPool() :
+    _pRing(nullptr),
+    _pCpuBase(nullptr),
+    _gpuBaseAddress(0),
+    _stats()
+{
+}
+
+void ConstantBufferPool::Reset(UploadRing* pRing, uint8_t* pCpuBase, uint64_t gpuBaseAddress)
+{
+    _pRing = pRing;
+    _pCpuBase = pCpuBase;
+    _gpuBaseAddress = gpuBaseAddress;
+    _stats = {};
+}
+
+bool ConstantBufferPool::Push(const void* pData, uint32_t size, uint64_t* pGpuAddress)
+{
+    const uint32_t alignedSize = AlignConstantBufferSize(size);
+    uint64_t offset = 0;
+    if (!_pRing->Allocate(alignedSize, ConstantBufferAlignment, &offset))
+    {
+        return false;
+    }
+
+    memcpy(_pCpuBase + offset, pData, size);
+    *pGpuAddress = _gpuBaseAddress + offset;
+
+    _stats.constantBuffers++;
+    _stats.allocations++;
+    _stats.bytesWritten += size;
+    _stats.bytesAllocated += alignedSize;
+    return true;
+}
+
+bool ConstantBufferPool::PushArray(const void* pData, uint32_t elementSize, uint32_t count, uint64_t* pFirstGpuAddress)
+{
+    if (count == 0)
+    {
+        *pFirstGpuAddress = 0;
+        return true;
+    }
+
+    const uint32_t stride = AlignConstantBufferSize(elementSize);
+    const uint64_t alignedSize = static_cast<uint64_t>(stride) * count;
+    uint64_t offset = 0;
+    if (!_pRing->Allocate(alignedSize, ConstantBufferAlignment, &offset))
+    {
+        return false;
+    }
+
+    const uint8_t* pSource = static_cast<const uint8_t*>(pData);
+    uint8_t* pDestination = _pCpuBase + offset;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        memcpy(pDestination, pSource, elementSize);
+        pSource += elementSize;
+        pDestination += stride;
+    }
+    *pFirstGpuAddress = _gpuBaseAddress + offset;
+
+    _stats.constantBuffers += count;
+    _stats.allocations++;
+    _stats.bytesWritten += static_cast<uint64_t>(elementSize) * count;
+    _stats.bytesAllocated += alignedSize;
+    return true;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "UploadRing.h"
+
+#include <cstdint>
+
+// D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT: constant buffer views start
+// and end on this boundary.
+static const uint32_t ConstantBufferAlignment = 256;
+
+// Same as CalculateConstantBufferByteSize(), without the D3D12 headers.
+inline uint32_t AlignConstantBufferSize(uint32_t byteSize)
+{
+    return (byteSize + (ConstantBufferAlignment - 1)) & ~(ConstantBufferAlignment - 1);
+}
+
+struct ConstantBufferStats
+{
+    uint32_t constantBuffers;   // Views handed out.
+    uint32_t allocations;       // Ring allocations; arrays take one for all their elements.
+    uint64_t bytesWritten;      // Constant data copied.
+    uint64_t bytesAllocated;    // Including the padding up to the alignment.
+};
+
+// Writes constants into 256-byte aligned slices of a persistently mapped
+// upload buffer and returns their GPU virtual address, to be bound as a root
+// CBV. Slices come from the renderer's UploadRing and are retired with the
+// rest of the frame's upload data.
+//
+// The buffer is usually write-combined: constants are only written, and the
+// padding between them is left alone.
+class ConstantBufferPool
+{
+public: ConstantBufferPool();
+
+    // pCpuBase and gpuBaseAddress are offset 0 of the ring's buffer.
+public: void Reset(UploadRing* pRing, uint8_t* pCpuBase, uint64_t gpuBaseAddress);
+
+    // Returns false when the ring is full, like UploadRing::Allocate().
+public: bool Push(const void* pData, uint32_t size, uint64_t* pGpuAddress);
+
+    // count constant buffers of elementSize each, packed from one allocation;
+    // element i is at *pFirstGpuAddress + i * AlignConstantBufferSize(elementSize).
+public: bool PushArray(const void* pData, uint32_t elementSize, uint32_t count, uint64_t* pFirstGpuAddress);
+
+public: template <typename T> bool Push(const T& constants, uint64_t* pGpuAddress)
+    {
+        return Push(&constants, sizeof(T), pGpuAddress);
+    }
+public: template <typename T> bool PushArray(const T* pConstants, uint32_t count, uint64_t* pFirstGpuAddress)
+    {
+        return PushArray(pConstants, sizeof(T), count, pFirstGpuAddress);
+    }
+
+public: const ConstantBufferStats& GetStats() const { return _stats; }
+public: void ResetStats() { _stats = {}; }
+
+private: UploadRing* _pRing;
+private: uint8_t* _pCpuBase;
+private: uint64_t _gpuBaseAddress;
+private: ConstantBufferStats _stats;
+};
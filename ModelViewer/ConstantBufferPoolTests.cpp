@@ -0,0 +1,170 @@
+#include "ConstantBufferPool.h"
+#include "UnitTest.h"
+
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    const uint64_t GpuBase = 0x100000000ull;
+    const uint8_t Untouched = 0xcd;
+
+    // The pool over a ring of capacity bytes and a CPU copy of the buffer,
+    // filled with Untouched to see what was written.
+    struct TestPool
+    {
+        explicit TestPool(uint64_t capacity) :
+            ring(capacity),
+            buffer(static_cast<size_t>(capacity), Untouched)
+        {
+            pool.Reset(&ring, buffer.data(), GpuBase);
+        }
+
+        const uint8_t* At(uint64_t gpuAddress) const { return buffer.data() + (gpuAddress - GpuBase); }
+
+        UploadRing ring;
+        std::vector<uint8_t> buffer;
+        ConstantBufferPool pool;
+    };
+
+    // Like DrawConstants: well under a constant buffer's 256 bytes.
+    struct SmallConstants
+    {
+        float values[20];
+    };
+
+    SmallConstants MakeConstants(uint32_t seed)
+    {
+        SmallConstants constants;
+        for (uint32_t i = 0; i < 20; i++)
+        {
+            constants.values[i] = static_cast<float>(seed * 100 + i);
+        }
+        return constants;
+    }
+
+    bool BytesAre(const uint8_t* pBytes, size_t size, uint8_t value)
+    {
+        for (size_t i = 0; i < size; i++)
+        {
+            if (pBytes[i] != value)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Every view starts on a 256-byte boundary and takes its size rounded up
+    // to 256; only the constants are written, not the padding.
+    void TestAlignment()
+    {
+        CHECK(AlignConstantBufferSize(1) == 256);
+        CHECK(AlignConstantBufferSize(256) == 256);
+        CHECK(AlignConstantBufferSize(257) == 512);
+
+        TestPool test(4096);
+        const uint32_t sizes[] = { 4, 80, 256, 260, 16 };
+        uint64_t previous = 0;
+        uint64_t expected = GpuBase;
+        for (uint32_t size : sizes)
+        {
+            std::vector<uint8_t> data(size, static_cast<uint8_t>(size));
+            uint64_t address = 0;
+            CHECK(test.pool.Push(data.data(), size, &address));
+            CHECK(address % ConstantBufferAlignment == 0);
+            CHECK(address == expected);
+            CHECK(address > previous);
+            CHECK(BytesAre(test.At(address), size, static_cast<uint8_t>(size)));
+            CHECK(BytesAre(test.At(address) + size, AlignConstantBufferSize(size) - size, Untouched));
+            previous = address;
+            expected += AlignConstantBufferSize(size);
+        }
+
+        const ConstantBufferStats& stats = test.pool.GetStats();
+        CHECK(stats.constantBuffers == 5);
+        CHECK(stats.allocations == 5);
+        CHECK(stats.bytesWritten == 4 + 80 + 256 + 260 + 16);
+        CHECK(stats.bytesAllocated == 256 + 256 + 256 + 512 + 256);
+    }
+
+    // The draws of a frame go into one allocation, one 256-byte view each:
+    // 16 draws of 80 bytes fill a 4 KB buffer exactly.
+    void TestDrawsPacked()
+    {
+        TestPool test(4096);
+        std::vector<SmallConstants> draws;
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            draws.push_back(MakeConstants(i));
+        }
+
+        uint64_t first = 0;
+        CHECK(test.pool.PushArray(draws.data(), 16, &first));
+        CHECK(first == GpuBase);
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            const uint64_t address = first + i * AlignConstantBufferSize(sizeof(SmallConstants));
+            CHECK(memcmp(test.At(address), &draws[i], sizeof(SmallConstants)) == 0);
+            CHECK(BytesAre(test.At(address) + sizeof(SmallConstants), 256 - sizeof(SmallConstants), Untouched));
+        }
+        CHECK(test.ring.GetUsedSize() == 4096);
+
+        const ConstantBufferStats& stats = test.pool.GetStats();
+        CHECK(stats.constantBuffers == 16);
+        CHECK(stats.allocations == 1);
+        CHECK(stats.bytesWritten == 16 * sizeof(SmallConstants));
+        CHECK(stats.bytesAllocated == 4096);
+
+        // Full: the next push fails instead of overwriting.
+        uint64_t address = 0;
+        CHECK(!test.pool.Push(draws[0], &address));
+        CHECK(test.pool.GetStats().constantBuffers == 16);
+
+        // An empty array takes nothing.
+        CHECK(test.pool.PushArray(draws.data(), 0, &first));
+        CHECK(first == 0);
+    }
+
+    // Once the GPU is done with a frame its views are reused. An array that
+    // does not fit before the end of the buffer starts over at the beginning
+    // rather than being split.
+    void TestRollover()
+    {
+        TestPool test(1024);
+        const SmallConstants constants[2] = { MakeConstants(1), MakeConstants(2) };
+        uint64_t address = 0;
+
+        CHECK(test.pool.Push(constants[0], &address) && address == GpuBase);
+        CHECK(test.pool.Push(constants[0], &address) && address == GpuBase + 256);
+        test.ring.EndFrame(1);
+        CHECK(test.pool.Push(constants[0], &address) && address == GpuBase + 512);
+        test.ring.EndFrame(2);
+
+        // Frame 1 still in flight: two views do not fit.
+        uint64_t first = 0;
+        CHECK(!test.pool.PushArray(constants, 2, &first));
+
+        test.ring.Retire(1);
+        CHECK(test.pool.PushArray(constants, 2, &first));
+        CHECK(first == GpuBase);
+        CHECK(memcmp(test.At(first), &constants[0], sizeof(SmallConstants)) == 0);
+        CHECK(memcmp(test.At(first + 256), &constants[1], sizeof(SmallConstants)) == 0);
+
+        // Frame 2's view was left alone.
+        CHECK(memcmp(test.At(GpuBase + 512), &constants[0], sizeof(SmallConstants)) == 0);
+        test.ring.EndFrame(3);
+
+        test.ring.Retire(3);
+        CHECK(test.pool.Push(constants[1], &address));
+        CHECK(address % ConstantBufferAlignment == 0);
+    }
+}
+
+int main()
+{
+    TestAlignment();
+    TestDrawsPacked();
+    TestRollover();
+    return TestFailures();
+}
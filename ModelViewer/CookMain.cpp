@@ -0,0 +1,354 @@
+// Texture cooking from the command line: builds the mip chain of an image
+// with MipGenerator and compresses it with TextureCooker into a DDS file the
+// streamer loads.
+//
+//   TextureCook <input> <output.dds> <bc1|bc3|bc4|bc5|bc7>
+//               [-srgb] [-kaiser] [-single_mip] [-alpha_coverage <reference>]
+//   TextureCook -benchmark [<size>]
+//
+// Inputs are uncompressed RGBA8 or BGRA8 DDS files, of which the top mip of
+// every array slice is used, or binary PPM (P6) images. -benchmark cooks a
+// generated size x size image (1024 by default) into every format and prints
+// the mip generation and encode rates and the PSNR of each.
+//
+// Exit codes: 0 on success, 2 on a bad argument or a file that could not be
+// read or written.
+
+#include "BlockCompression.h"
+#include "DDSFile.h"
+#include "MipGenerator.h"
+#include "TextureCooker.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+    struct Image
+    {
+        uint32_t width;
+        uint32_t height;
+        uint32_t arraySize;
+        std::vector<uint8_t> texels;    // RGBA8 slices back to back.
+    };
+
+    struct FormatName
+    {
+        const char* name;
+        BCFormat format;
+    };
+
+    const FormatName Formats[] =
+    {
+        { "bc1", BCFormat::BC1 },
+        { "bc3", BCFormat::BC3 },
+        { "bc4", BCFormat::BC4 },
+        { "bc5", BCFormat::BC5 },
+        { "bc7", BCFormat::BC7 },
+    };
+
+    bool ReadFile(const std::string& path, std::vector<uint8_t>* pData)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+        {
+            return false;
+        }
+        pData->assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        return true;
+    }
+
+    bool ReadDDSImage(const std::vector<uint8_t>& data, Image* pImage, std::string* pError)
+    {
+        DDSTextureInfo info;
+        if (!ReadDDSHeader(data.data(), data.size(), &info))
+        {
+            *pError = "not a DDS file the cooker can read";
+            return false;
+        }
+
+        const bool bgra = info.format == DDSFormat::B8G8R8A8_UNORM || info.format == DDSFormat::B8G8R8A8_UNORM_SRGB;
+        if (!bgra && info.format != DDSFormat::R8G8B8A8_UNORM && info.format != DDSFormat::R8G8B8A8_UNORM_SRGB)
+        {
+            *pError = "only RGBA8 and BGRA8 DDS files can be cooked";
+            return false;
+        }
+
+        pImage->width = info.width;
+        pImage->height = info.height;
+        pImage->arraySize = info.arraySize;
+        const size_t sliceBytes = static_cast<size_t>(info.width) * info.height * 4;
+        pImage->texels.resize(sliceBytes * info.arraySize);
+        for (uint32_t slice = 0; slice < info.arraySize; slice++)
+        {
+            const DDSSubresourceLayout layout = GetDDSSubresourceLayout(info, 0, slice);
+            uint8_t* pSlice = pImage->texels.data() + sliceBytes * slice;
+            memcpy(pSlice, data.data() + layout.offset, sliceBytes);
+            for (size_t i = 0; bgra && i < sliceBytes; i += 4)
+            {
+                std::swap(pSlice[i], pSlice[i + 2]);
+            }
+        }
+        return true;
+    }
+
+    bool ReadPPMImage(const std::vector<uint8_t>& data, Image* pImage, std::string* pError)
+    {
+        // P6, whitespace, width, height and maxval, one whitespace character,
+        // then the texels. Comments start with '#' and run to the end of the line.
+        size_t position = 2;
+        uint32_t fields[3];
+        for (uint32_t& field : fields)
+        {
+            while (position < data.size() && (isspace(data[position]) || data[position] == '#'))
+            {
+                if (data[position] == '#')
+                {
+                    while (position < data.size() && data[position] != '\n')
+                    {
+                        position++;
+                    }
+                }
+                else
+                {
+                    position++;
+                }
+            }
+
+            field = 0;
+            const size_t begin = position;
+            while (position < data.size() && isdigit(data[position]) && field < 100000)
+            {
+                field = field * 10 + (data[position++] - '0');
+            }
+            if (position == begin)
+            {
+                *pError = "malformed PPM header";
+                return false;
+            }
+        }
+        position++;
+
+        if (fields[0] == 0 || fields[1] == 0 || fields[0] > 16384 || fields[1] > 16384 || fields[2] != 255)
+        {
+            *pError = "only 8-bit PPM images up to 16384x16384 can be cooked";
+            return false;
+        }
+
+        const size_t texelCount = static_cast<size_t>(fields[0]) * fields[1];
+        if (position + texelCount * 3 > data.size())
+        {
+            *pError = "PPM image is truncated";
+            return false;
+        }
+
+        pImage->width = fields[0];
+        pImage->height = fields[1];
+        pImage->arraySize = 1;
+        pImage->texels.resize(texelCount * 4);
+        for (size_t i = 0; i < texelCount; i++)
+        {
+            memcpy(&pImage->texels[i * 4], &data[position + i * 3], 3);
+            pImage->texels[i * 4 + 3] = 255;
+        }
+        return true;
+    }
+
+    bool ReadImage(const std::string& path, Image* pImage, std::string* pError)
+    {
+        std::vector<uint8_t> data;
+        if (!ReadFile(path, &data))
+        {
+            *pError = "cannot read " + path;
+            return false;
+        }
+        if (data.size() >= 2 && data[0] == 'P' && data[1] == '6')
+        {
+            return ReadPPMImage(data, pImage, pError);
+        }
+        return ReadDDSImage(data, pImage, pError);
+    }
+
+    // Smooth gradients, a hard-edged pattern and a little noise, so every
+    // encoder has both easy and difficult blocks. Opaque, so BC1's 1-bit
+    // alpha does not dominate its error. Depends only on the size.
+    void GenerateImage(uint32_t size, Image* pImage)
+    {
+        pImage->width = size;
+        pImage->height = size;
+        pImage->arraySize = 1;
+        pImage->texels.resize(static_cast<size_t>(size) * size * 4);
+
+        uint32_t random = 1;
+        for (uint32_t y = 0; y < size; y++)
+        {
+            for (uint32_t x = 0; x < size; x++)
+            {
+                uint8_t* pTexel = &pImage->texels[(static_cast<size_t>(y) * size + x) * 4];
+                const int values[4] =
+                {
+                    static_cast<int>(128.0 + 100.0 * std::sin(x * 0.05)),
+                    static_cast<int>(128.0 + 100.0 * std::cos(y * 0.03)),
+                    static_cast<int>((x ^ y) & 255),
+                    255,
+                };
+                for (int ch = 0; ch < 4; ch++)
+                {
+                    random = random * 1664525u + 1013904223u;
+                    const int noise = static_cast<int>(random >> 29) - 4;
+                    pTexel[ch] = static_cast<uint8_t>(std::min(255, std::max(0, values[ch] + noise)));
+                }
+            }
+        }
+    }
+
+    int RunBenchmark(uint32_t size)
+    {
+        Image image;
+        GenerateImage(size, &image);
+
+        ThreadPool pool;
+        MipGenerator mipGenerator(pool);
+        printf("%ux%u, %u threads\n", size, size, pool.GetThreadCount());
+
+        const MipFilter filters[] = { MipFilter::Box, MipFilter::Kaiser };
+        const char* const filterNames[] = { "box", "kaiser" };
+        MipChain chain;
+        for (int f = 0; f < 2; f++)
+        {
+            for (int srgb = 0; srgb < 2; srgb++)
+            {
+                MipGenerationOptions options;
+                options.filter = filters[f];
+                options.srgb = srgb != 0;
+                mipGenerator.Generate(image.texels.data(), size, size, 1, options, &chain);
+                printf("mips %-6s %-6s %8.1f MPix/s\n", filterNames[f], srgb ? "srgb" : "linear", mipGenerator.GetStats().megapixelsPerSecond);
+            }
+        }
+
+        TextureCooker cooker(pool);
+        cooker.SetMeasureQuality(true);
+        std::vector<uint8_t> dds;
+        for (const FormatName& format : Formats)
+        {
+            cooker.Cook(chain, format.format, false, &dds);
+            const TextureCookStats& stats = cooker.GetStats();
+            printf("cook %-4s %8.1f MPix/s  PSNR %6.2f dB  %zu bytes\n", format.name, stats.megapixelsPerSecond, stats.psnr, dds.size());
+        }
+        return 0;
+    }
+
+    void PrintUsage()
+    {
+        fprintf(stderr,
+            "usage: TextureCook <input> <output.dds> <bc1|bc3|bc4|bc5|bc7>\n"
+            "                   [-srgb] [-kaiser] [-single_mip] [-alpha_coverage <reference>]\n"
+            "       TextureCook -benchmark [<size>]\n");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc >= 2 && strcmp(argv[1], "-benchmark") == 0)
+    {
+        const long size = argc >= 3 ? strtol(argv[2], nullptr, 10) : 1024;
+        if (argc > 3 || size < 4 || size > 16384)
+        {
+            PrintUsage();
+            return 2;
+        }
+        return RunBenchmark(static_cast<uint32_t>(size));
+    }
+
+    if (argc < 4)
+    {
+        PrintUsage();
+        return 2;
+    }
+
+    const FormatName* pFormat = nullptr;
+    for (const FormatName& format : Formats)
+    {
+        if (strcmp(argv[3], format.name) == 0)
+        {
+            pFormat = &format;
+        }
+    }
+    if (pFormat == nullptr)
+    {
+        PrintUsage();
+        return 2;
+    }
+
+    MipGenerationOptions options;
+    bool srgb = false;
+    for (int i = 4; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-srgb") == 0)
+        {
+            srgb = true;
+        }
+        else if (strcmp(argv[i], "-kaiser") == 0)
+        {
+            options.filter = MipFilter::Kaiser;
+        }
+        else if (strcmp(argv[i], "-single_mip") == 0)
+        {
+            options.maxMipCount = 1;
+        }
+        else if (strcmp(argv[i], "-alpha_coverage") == 0 && i + 1 < argc)
+        {
+            options.alphaCoverageReference = static_cast<float>(atof(argv[++i]));
+        }
+        else
+        {
+            PrintUsage();
+            return 2;
+        }
+    }
+
+    // Only BC1, BC3 and BC7 store sRGB; the others get linear filtering too.
+    options.srgb = srgb && GetBCDDSFormat(pFormat->format, true) != GetBCDDSFormat(pFormat->format, false);
+
+    Image image;
+    std::string error;
+    if (!ReadImage(argv[1], &image, &error))
+    {
+        fprintf(stderr, "cook: %s\n", error.c_str());
+        return 2;
+    }
+
+    ThreadPool pool;
+    MipGenerator mipGenerator(pool);
+    MipChain chain;
+    mipGenerator.Generate(image.texels.data(), image.width, image.height, image.arraySize, options, &chain);
+
+    TextureCooker cooker(pool);
+    cooker.SetMeasureQuality(true);
+    std::vector<uint8_t> dds;
+    cooker.Cook(chain, pFormat->format, options.srgb, &dds);
+
+    std::ofstream output(argv[2], std::ios::binary);
+    output.write(reinterpret_cast<const char*>(dds.data()), dds.size());
+    if (!output)
+    {
+        fprintf(stderr, "cook: cannot write %s\n", argv[2]);
+        return 2;
+    }
+
+    const TextureCookStats& stats = cooker.GetStats();
+    printf("%s: %ux%u, %u slices, %u mips, %s%s, %zu bytes\n",
+        argv[2], image.width, image.height, image.arraySize, chain.mipCount, pFormat->name, options.srgb ? " srgb" : "", dds.size());
+    printf("mips %.1f MPix/s, encode %.1f MPix/s, PSNR %.2f dB\n",
+        mipGenerator.GetStats().megapixelsPerSecond, stats.megapixelsPerSecond, stats.psnr);
+    return 0;
+}
@@ -0,0 +1,107 @@
+#include "stdafx.h"
+#include "D3D12CopyQueue.h"
+#include "D3D12MemoryTracking.h"
+
+D3D12CopyQueue::D3D12CopyQueue(ID3D12Device* pDevice, UINT64 stagingSize) :
+    _nextAllocator(0),
+    _fenceValue(0),
+    _fenceEvent(nullptr),
+    _stagingBufferBegin(nullptr),
+    _stagingSize(stagingSize)
+{
+    D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+    queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+    queueDesc.Type = D3D12_COMMAND_LIST_TYPE_COPY;
+    queueDesc.Priority = D3D12_COMMAND_QUEUE_PRIORITY_NORMAL;
+    queueDesc.NodeMask = 0;
+    ThrowIfFailed(pDevice->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&_commandQueue)));
+    NAME_D3D12_OBJECT(_commandQueue);
+
+    for (UINT i = 0; i < AllocatorCount; i++)
+    {
+        ThrowIfFailed(pDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COPY, IID_PPV_ARGS(&_commandAllocators[i])));
+        _allocatorFenceValues[i] = 0;
+    }
+
+    ThrowIfFailed(pDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COPY, _commandAllocators[0].Get(), nullptr, IID_PPV_ARGS(&_commandList)));
+    ThrowIfFailed(_commandList->Close());
+
+    ThrowIfFailed(pDevice->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&_fence)));
+    _fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+    if (_fenceEvent == nullptr)
+    {
+        ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+    }
+
+    const CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_UPLOAD);
+    const CD3DX12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(stagingSize);
+    ThrowIfFailed(pDevice->CreateCommittedResource(
+        &heapProperties,
+        D3D12_HEAP_FLAG_NONE,
+        &bufferDesc,
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(&_stagingBuffer)));
+    NAME_D3D12_OBJECT(_stagingBuffer);
+    TrackD3D12Resource(pDevice, _stagingBuffer.Get(), MemoryCategory::Upload, "CopyQueueStaging");
+
+    CD3DX12_RANGE readRange(0, 0);
+    ThrowIfFailed(_stagingBuffer->Map(0, &readRange, reinterpret_cast<void**>(&_stagingBufferBegin)));
+}
+
+D3D12CopyQueue::~D3D12CopyQueue()
+{
+    WaitIdle();
+    CloseHandle(_fenceEvent);
+}
+
+UINT64 D3D12CopyQueue::Submit(const StreamingCopy* pCopies, size_t count)
+{
+    const UINT allocatorIndex = _nextAllocator;
+    _nextAllocator = (_nextAllocator + 1) % AllocatorCount;
+
+    // Only blocks when the copies of AllocatorCount submissions ago are still running.
+    WaitForFenceValue(_allocatorFenceValues[allocatorIndex]);
+
+    ID3D12CommandAllocator* pAllocator = _commandAllocators[allocatorIndex].Get();
+    ThrowIfFailed(pAllocator->Reset());
+    ThrowIfFailed(_commandList->Reset(pAllocator, nullptr));
+
+    D3D12CopyContext context;
+    context.pCommandList = _commandList.Get();
+    context.pStagingBuffer = _stagingBuffer.Get();
+    for (size_t i = 0; i < count; i++)
+    {
+        pCopies[i].record(&context, pCopies[i].stagingOffset);
+    }
+
+    ThrowIfFailed(_commandList->Close());
+
+    ID3D12CommandList* ppCommandLists[] = { _commandList.Get() };
+    _commandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
+
+    _fenceValue++;
+    ThrowIfFailed(_commandQueue->Signal(_fence.Get(), _fenceValue));
+    _allocatorFenceValues[allocatorIndex] = _fenceValue;
+
+    return _fenceValue;
+}
+
+UINT64 D3D12CopyQueue::GetCompletedFenceValue()
+{
+    return _fence->GetCompletedValue();
+}
+
+void D3D12CopyQueue::WaitIdle()
+{
+    WaitForFenceValue(_fenceValue);
+}
+
+void D3D12CopyQueue::WaitForFenceValue(UINT64 fenceValue)
+{
+    if (_fence->GetCompletedValue() < fenceValue)
+    {
+        ThrowIfFailed(_fence->SetEventOnCompletion(fenceValue, _fenceEvent));
+        WaitForSingleObject(_fenceEvent, INFINITE);
+    }
+}
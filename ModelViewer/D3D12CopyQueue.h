@@ -0,0 +1,52 @@
+#pragma once
+
+#include "AssetStreamer.h"
+
+using Microsoft::WRL::ComPtr;
+
+// What the record function of a streaming request receives as pCopyContext.
+struct D3D12CopyContext
+{
+    ID3D12GraphicsCommandList* pCommandList;
+    ID3D12Resource* pStagingBuffer;
+};
+
+// COPY queue with its own fence and a persistently mapped staging buffer, so
+// asset uploads run next to rendering instead of on the DIRECT queue.
+// Resources written here decay to the COMMON state once the copy completes
+// and can be used by the DIRECT queue after their fence value was observed.
+class D3D12CopyQueue : public StreamingCopyQueue
+{
+public: D3D12CopyQueue(ID3D12Device* pDevice, UINT64 stagingSize);
+public: virtual ~D3D12CopyQueue();
+
+public: virtual UINT8* GetStagingMemory() { return _stagingBufferBegin; }
+public: virtual UINT64 GetStagingSize() const { return _stagingSize; }
+
+public: virtual UINT64 Submit(const StreamingCopy* pCopies, size_t count);
+public: virtual UINT64 GetCompletedFenceValue();
+
+public: void WaitIdle();
+
+    // For work that has to be ordered with the copies, like tile mapping updates.
+public: ID3D12CommandQueue* GetCommandQueue() const { return _commandQueue.Get(); }
+
+    // Command allocators are recycled once the copies recorded with them finished.
+private: static const UINT AllocatorCount = 3;
+
+private: void WaitForFenceValue(UINT64 fenceValue);
+
+private: ComPtr<ID3D12CommandQueue> _commandQueue;
+private: ComPtr<ID3D12CommandAllocator> _commandAllocators[AllocatorCount];
+private: UINT64 _allocatorFenceValues[AllocatorCount];
+private: UINT _nextAllocator;
+private: ComPtr<ID3D12GraphicsCommandList> _commandList;
+
+private: ComPtr<ID3D12Fence> _fence;
+private: UINT64 _fenceValue;
+private: HANDLE _fenceEvent;
+
+private: ComPtr<ID3D12Resource> _stagingBuffer;
+private: UINT8* _stagingBufferBegin;
+private: UINT64 _stagingSize;
+};
@@ -0,0 +1,189 @@
+#include "stdafx.h"
+#include "D3D12GpuProfiler.h"
+#include "D3D12MemoryTracking.h"
+
+D3D12GpuProfiler::D3D12GpuProfiler(ID3D12Device* pDevice, ID3D12CommandQueue* pCommandQueue, const char* timelineName, UINT maxScopesPerFrame) :
+    _commandQueue(pCommandQueue),
+    _queriesPerFrame(maxScopesPerFrame * 2),
+    _timeline(CpuProfiler::Get().RegisterTimeline(timelineName)),
+    _currentFrame(FrameLatency - 1),
+    _droppedFrames(0),
+    _timestampFrequency(0),
+    _calibrationTimestamp(0),
+    _calibrationNanoseconds(0)
+{
+    D3D12_QUERY_HEAP_DESC queryHeapDesc = {};
+    queryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+    queryHeapDesc.Count = _queriesPerFrame * FrameLatency;
+    ThrowIfFailed(pDevice->CreateQueryHeap(&queryHeapDesc, IID_PPV_ARGS(&_queryHeap)));
+    NAME_D3D12_OBJECT(_queryHeap);
+
+    // Readback resources never leave COPY_DEST.
+    const CD3DX12_HEAP_PROPERTIES readbackHeap(D3D12_HEAP_TYPE_READBACK);
+    const CD3DX12_RESOURCE_DESC readbackDesc = CD3DX12_RESOURCE_DESC::Buffer(static_cast<UINT64>(queryHeapDesc.Count) * sizeof(UINT64));
+    ThrowIfFailed(pDevice->CreateCommittedResource(
+        &readbackHeap,
+        D3D12_HEAP_FLAG_NONE,
+        &readbackDesc,
+        D3D12_RESOURCE_STATE_COPY_DEST,
+        nullptr,
+        IID_PPV_ARGS(&_readbackBuffer)));
+    NAME_D3D12_OBJECT(_readbackBuffer);
+    TrackD3D12Resource(pDevice, _readbackBuffer.Get(), MemoryCategory::Upload, "GpuProfilerReadback");
+
+    for (Frame& frame : _frames)
+    {
+        frame.scopes.reserve(maxScopesPerFrame);
+        frame.queryCount = 0;
+        frame.fenceValue = 0;
+        frame.tag = 0.0;
+        frame.pending = false;
+    }
+
+    ThrowIfFailed(_commandQueue->GetTimestampFrequency(&_timestampFrequency));
+    Calibrate();
+}
+
+// GetClockCalibration pairs a GPU timestamp with a QPC value; sampling QPC
+// and the profiler clock back to back carries it over to the profiler clock.
+void D3D12GpuProfiler::Calibrate()
+{
+    UINT64 gpuTimestamp = 0;
+    UINT64 cpuTimestamp = 0;
+    ThrowIfFailed(_commandQueue->GetClockCalibration(&gpuTimestamp, &cpuTimestamp));
+
+    LARGE_INTEGER qpcNow;
+    LARGE_INTEGER qpcFrequency;
+    QueryPerformanceCounter(&qpcNow);
+    const int64_t profilerNow = CpuProfiler::Get().NowNanoseconds();
+    QueryPerformanceFrequency(&qpcFrequency);
+
+    const double cpuAge = static_cast<double>(qpcNow.QuadPart - static_cast<LONGLONG>(cpuTimestamp)) / qpcFrequency.QuadPart;
+    _calibrationTimestamp = gpuTimestamp;
+    _calibrationNanoseconds = profilerNow - static_cast<int64_t>(cpuAge * 1e9);
+}
+
+int64_t D3D12GpuProfiler::ToProfilerNanoseconds(UINT64 timestamp) const
+{
+    const double seconds = (static_cast<double>(timestamp) - static_cast<double>(_calibrationTimestamp)) / _timestampFrequency;
+    return _calibrationNanoseconds + static_cast<int64_t>(seconds * 1e9);
+}
+
+void D3D12GpuProfiler::BeginFrame(double tag)
+{
+    _currentFrame = (_currentFrame + 1) % FrameLatency;
+
+    Frame& frame = _frames[_currentFrame];
+    if (frame.pending)
+    {
+        _droppedFrames++;
+    }
+    frame.scopes.clear();
+    frame.queryCount = 0;
+    frame.tag = tag;
+    frame.pending = false;
+    _openScopes.clear();
+}
+
+void D3D12GpuProfiler::BeginScope(ID3D12GraphicsCommandList* pCommandList, const char* name)
+{
+    // Its own two queries plus the end query of every scope still open.
+    Frame& frame = _frames[_currentFrame];
+    if (frame.queryCount + static_cast<UINT>(_openScopes.size()) + 2 > _queriesPerFrame)
+    {
+        _openScopes.push_back(NoScope);
+        return;
+    }
+
+    const Scope scope = { name, frame.queryCount, 0, static_cast<UINT>(_openScopes.size()) };
+    pCommandList->EndQuery(_queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, _currentFrame * _queriesPerFrame + frame.queryCount);
+    frame.queryCount++;
+
+    _openScopes.push_back(static_cast<UINT>(frame.scopes.size()));
+    frame.scopes.push_back(scope);
+}
+
+void D3D12GpuProfiler::EndScope(ID3D12GraphicsCommandList* pCommandList)
+{
+    const UINT scopeIndex = _openScopes.back();
+    _openScopes.pop_back();
+    if (scopeIndex == NoScope)
+    {
+        return;
+    }
+
+    // Room for the end query was reserved by BeginScope().
+    Frame& frame = _frames[_currentFrame];
+    pCommandList->EndQuery(_queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, _currentFrame * _queriesPerFrame + frame.queryCount);
+    frame.scopes[scopeIndex].endQuery = frame.queryCount;
+    frame.queryCount++;
+}
+
+void D3D12GpuProfiler::EndFrame(ID3D12GraphicsCommandList* pCommandList, UINT64 fenceValue)
+{
+    Frame& frame = _frames[_currentFrame];
+    if (frame.queryCount == 0)
+    {
+        return;
+    }
+
+    const UINT firstQuery = _currentFrame * _queriesPerFrame;
+    pCommandList->ResolveQueryData(
+        _queryHeap.Get(),
+        D3D12_QUERY_TYPE_TIMESTAMP,
+        firstQuery,
+        frame.queryCount,
+        _readbackBuffer.Get(),
+        static_cast<UINT64>(firstQuery) * sizeof(UINT64));
+
+    frame.fenceValue = fenceValue;
+    frame.pending = true;
+}
+
+void D3D12GpuProfiler::Collect(UINT64 completedFenceValue, std::vector<ProfileEvent>* pEvents, std::vector<GpuProfileFrame>* pFrames)
+{
+    bool calibrated = false;
+    for (UINT i = 1; i <= FrameLatency; i++)
+    {
+        const UINT frameIndex = (_currentFrame + i) % FrameLatency;
+        Frame& frame = _frames[frameIndex];
+        if (!frame.pending || frame.fenceValue > completedFenceValue)
+        {
+            continue;
+        }
+
+        // GPU clocks drift against the CPU and reset with power states, so
+        // the calibration is refreshed whenever there is something to convert.
+        if (!calibrated)
+        {
+            Calibrate();
+            calibrated = true;
+        }
+
+        const UINT firstQuery = frameIndex * _queriesPerFrame;
+        const CD3DX12_RANGE readRange(firstQuery * sizeof(UINT64), (firstQuery + frame.queryCount) * sizeof(UINT64));
+        const CD3DX12_RANGE writtenRange(0, 0);
+        UINT8* pData = nullptr;
+        ThrowIfFailed(_readbackBuffer->Map(0, &readRange, reinterpret_cast<void**>(&pData)));
+
+        const UINT64* pTimestamps = reinterpret_cast<const UINT64*>(pData) + firstQuery;
+        if (pFrames != nullptr)
+        {
+            const GpuProfileFrame collected = { frame.tag, pEvents->size(), frame.scopes.size() };
+            pFrames->push_back(collected);
+        }
+        for (const Scope& scope : frame.scopes)
+        {
+            ProfileEvent event;
+            event.name = scope.name;
+            event.beginNanoseconds = ToProfilerNanoseconds(pTimestamps[scope.beginQuery]);
+            event.endNanoseconds = ToProfilerNanoseconds(pTimestamps[scope.endQuery]);
+            event.timeline = _timeline;
+            event.depth = scope.depth;
+            pEvents->push_back(event);
+        }
+
+        _readbackBuffer->Unmap(0, &writtenRange);
+        frame.pending = false;
+    }
+}
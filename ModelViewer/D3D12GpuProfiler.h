@@ -0,0 +1,81 @@
+#pragma once
+
+#include "Profiler.h"
+
+using Microsoft::WRL::ComPtr;
+
+// A frame Collect() read back: the tag BeginFrame() was given and the range
+// of its scopes in the events.
+struct GpuProfileFrame
+{
+    double tag;
+    size_t firstEvent;
+    size_t eventCount;
+};
+
+// GPU scopes of one queue, measured with timestamp queries. Each frame in
+// flight resolves its queries into its own slice of a readback buffer, and
+// Collect() reads the slices of the frames the fence reports finished, a few
+// frames after they were recorded. Timestamps are converted to the
+// CpuProfiler clock, so GPU and CPU scopes line up in a trace.
+class D3D12GpuProfiler
+{
+public: D3D12GpuProfiler(ID3D12Device* pDevice, ID3D12CommandQueue* pCommandQueue, const char* timelineName, UINT maxScopesPerFrame);
+
+    // Scopes nest and have to be closed in the frame that opened them. Scopes
+    // past maxScopesPerFrame are not measured. tag comes back with the frame's
+    // timings, for what the frame was recorded with (a render scale, say).
+public: void BeginFrame(double tag = 0.0);
+public: void BeginScope(ID3D12GraphicsCommandList* pCommandList, const char* name);
+public: void EndScope(ID3D12GraphicsCommandList* pCommandList);
+
+    // Records the resolve. fenceValue is signaled on the queue once the
+    // command list executed.
+public: void EndFrame(ID3D12GraphicsCommandList* pCommandList, UINT64 fenceValue);
+
+    // Appends the scopes of every finished frame not collected yet, oldest
+    // first, and the frames themselves to pFrames when given.
+public: void Collect(UINT64 completedFenceValue, std::vector<ProfileEvent>* pEvents, std::vector<GpuProfileFrame>* pFrames = nullptr);
+
+    // Frames whose results were overwritten before being collected.
+public: UINT64 GetDroppedFrameCount() const { return _droppedFrames; }
+
+private: static const UINT FrameLatency = 3;
+private: static const UINT NoScope = 0xffffffff;
+
+private: struct Scope
+    {
+        const char* name;
+        UINT beginQuery;
+        UINT endQuery;
+        UINT depth;
+    };
+
+private: struct Frame
+    {
+        std::vector<Scope> scopes;
+        UINT queryCount;
+        UINT64 fenceValue;
+        double tag;
+        bool pending;
+    };
+
+private: void Calibrate();
+private: int64_t ToProfilerNanoseconds(UINT64 timestamp) const;
+
+private: ComPtr<ID3D12CommandQueue> _commandQueue;
+private: ComPtr<ID3D12QueryHeap> _queryHeap;
+private: ComPtr<ID3D12Resource> _readbackBuffer;
+private: UINT _queriesPerFrame;
+private: uint32_t _timeline;
+
+private: Frame _frames[FrameLatency];
+private: UINT _currentFrame;
+private: std::vector<UINT> _openScopes;
+private: UINT64 _droppedFrames;
+
+    // A GPU timestamp and the CpuProfiler time of the same instant.
+private: UINT64 _timestampFrequency;
+private: UINT64 _calibrationTimestamp;
+private: int64_t _calibrationNanoseconds;
+};
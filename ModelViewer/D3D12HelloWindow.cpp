@@ -12,19 +12,156 @@
 #include "stdafx.h"
 #include "D3D12HelloWindow.h"
 
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+    const D3D12_INPUT_ELEMENT_DESC SceneInputElements[] =
+    {
+        { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+        { "COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+    };
+
+    const float SceneClearColor[] = { 1.0f, 0.2f, 0.4f, 1.0f };
+
+    // b0 of the upscale pass: the UV scale from the back buffer onto the
+    // rendered part of the scene color, and the UV the sampler stops at half
+    // a texel inside it so bilinear taps never read past what was rendered.
+    struct UpscaleConstants
+    {
+        float uvScale[2];
+        float uvClamp[2];
+    };
+
+    int64_t NowMicroseconds()
+    {
+        LARGE_INTEGER counter;
+        QueryPerformanceCounter(&counter);
+        return Win64Application::QpcToMicroseconds(counter.QuadPart);
+    }
+
+    // The position-only streams of the depth pre-pass.
+    const D3D12_INPUT_ELEMENT_DESC PositionInputElements[] =
+    {
+        { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+    };
+
+    struct SceneVertex
+    {
+        float position[3];
+        float color[4];
+    };
+
+    // A unit cube with a color per face: 24 vertices, which weld to 8
+    // positions. Faces are clockwise seen from outside, the front faces of
+    // the default rasterizer state.
+    void BuildCube(std::vector<SceneVertex>* pVertices, std::vector<uint32_t>* pIndices)
+    {
+        for (int face = 0; face < 6; face++)
+        {
+            const int axis = face / 2;
+            const float sign = face % 2 == 0 ? -1.0f : 1.0f;
+            const int u = (axis + 1) % 3;
+            const int v = (axis + 2) % 3;
+
+            // Corners at -u-v, -u+v, +u+v, +u-v, reversed on the positive side.
+            static const float CornerU[] = { -0.5f, -0.5f, 0.5f, 0.5f };
+            static const float CornerV[] = { -0.5f, 0.5f, 0.5f, -0.5f };
+            const uint32_t first = static_cast<uint32_t>(pVertices->size());
+            for (int corner = 0; corner < 4; corner++)
+            {
+                const int c = sign > 0.0f ? (4 - corner) % 4 : corner;
+                SceneVertex vertex = {};
+                vertex.position[axis] = 0.5f * sign;
+                vertex.position[u] = CornerU[c];
+                vertex.position[v] = CornerV[c];
+                vertex.color[0] = axis == 0 ? 1.0f : 0.2f;
+                vertex.color[1] = axis == 1 ? 1.0f : 0.2f;
+                vertex.color[2] = axis == 2 ? 1.0f : 0.2f;
+                vertex.color[3] = sign > 0.0f ? 1.0f : 0.5f;
+                pVertices->push_back(vertex);
+            }
+
+            const uint32_t quad[] = { 0, 1, 2, 0, 2, 3 };
+            for (uint32_t index : quad)
+            {
+                pIndices->push_back(first + index);
+            }
+        }
+    }
+}
+
 D3D12HelloWindow::D3D12HelloWindow(UINT width, UINT height, std::wstring name) :
     DXSample(width, height, name),
+    _stateTracker(_resourceStates),
+    _shaderCompileThreads(2),
+    _pipelineMilliseconds(0.0),
+    _shaderChanges(GetWin64FileStamp),
+    _shaderSourceRevision(0),
     _frameIndex(0),
     _rtvDescriptorSize(0),
     _fenceValue(0),
-    _fenceEvent(nullptr)
+    _fenceEvent(nullptr),
+    _uploadBufferBegin(nullptr),
+    _useIndirectDraws(false),
+    _useDepthPrepass(true),
+    _drawStats(),
+    _clusterLightStats(),
+    _firstFrameNanoseconds(0),
+    _previousFrameNanoseconds(0),
+    _traceFramesLeft(0),
+    _lastTitleUpdate(0),
+    _presentSyncInterval(1),
+    _tearingSupported(false),
+    _frameLatencyWaitable(nullptr),
+    _frameStartMicroseconds(0),
+    _submitMicroseconds(0),
+    _useDynamicResolution(false),
+    _frameScale(1.0f),
+    _renderWidth(width),
+    _renderHeight(height),
+    _budgetListener(0)
 {
 }
 
 void D3D12HelloWindow::OnInit()
 {
+    CpuProfiler::Get().SetThreadName("Render");
+    const int64_t startupBegin = CpuProfiler::Get().NowNanoseconds();
+
     LoadPipeline();
     LoadAssets();
+
+    _gpuProfiler.reset(new D3D12GpuProfiler(_device.Get(), _commandQueue.Get(), "GPU", MaxGpuScopes));
+
+    // The texture streamer picks up the new budget on its next update; going
+    // over it leaves a snapshot of what was allocated at the time.
+    _budgetListener = GpuMemoryTracker::Get().AddBudgetListener([this](const MemoryBudgetEvent& budgetEvent)
+    {
+        char text[160];
+        sprintf_s(text, "GPU memory budget (%s): %llu MB, %llu MB in use\n",
+            budgetEvent.segment == MemorySegment::Local ? "local" : "non-local",
+            budgetEvent.current.budget >> 20,
+            budgetEvent.current.currentUsage >> 20);
+        OutputDebugStringA(text);
+
+        if (budgetEvent.overBudget)
+        {
+            WriteMemorySnapshot();
+        }
+    });
+
+    // Sequential until toggled; see OnKeyDown().
+    _framePipeline.reset(new FramePipeline([this](FramePacket& packet) { BuildFramePacket(packet); }, false));
+
+    // Compare against a run with -runtime_shaders to see what embedding saves.
+    char text[160];
+    sprintf_s(text, "Startup: %.1f ms, pipelines %.1f ms (%s shaders)\n",
+        (CpuProfiler::Get().NowNanoseconds() - startupBegin) / 1e6,
+        _pipelineMilliseconds,
+        _runtimeShaderCompilation || GetEmbeddedShaderVariantCount() == 0 ? "runtime" : "embedded");
+    OutputDebugStringA(text);
 }
 
 // Load the rendering pipeline dependencies.
@@ -44,6 +181,7 @@ void D3D12HelloWindow::LoadPipeline()
     {
         ComPtr<IDXGIAdapter1> hardwareAdapter;
         GetHardwareAdapter(factory.Get(), &hardwareAdapter);
+        ThrowIfFailed(hardwareAdapter.As(&_adapter));
 
         ThrowIfFailed(D3D12CreateDevice(
             hardwareAdapter.Get(),
@@ -61,6 +199,11 @@ void D3D12HelloWindow::LoadPipeline()
 
     ThrowIfFailed(_device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&_commandQueue)));
 
+    // Asset uploads go through their own COPY queue so large loads do not stall rendering.
+    _copyQueue.reset(new D3D12CopyQueue(_device.Get(), StagingBufferSize));
+    _assetStreamer.reset(new AssetStreamer(*_copyQueue, _loaderThreads));
+    _textureStreamer.reset(new TextureStreamer(_device.Get(), *_assetStreamer));
+
     // Describe and create the swap chain.
     DXGI_SWAP_CHAIN_DESC1 swapChainDesc = {};
     swapChainDesc.BufferCount = FrameCount; //    2 
@@ -71,6 +214,24 @@ void D3D12HelloWindow::LoadPipeline()
     swapChainDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
     swapChainDesc.SampleDesc.Count = 1;
 
+    // Tearing is how an unsynchronized Present() reaches a variable refresh
+    // display in a window; without it the compositor waits for the vblank.
+    ComPtr<IDXGIFactory5> factory5;
+    BOOL allowTearing = FALSE;
+    if (SUCCEEDED(factory.As(&factory5)) &&
+        SUCCEEDED(factory5->CheckFeatureSupport(DXGI_FEATURE_PRESENT_ALLOW_TEARING, &allowTearing, sizeof(allowTearing))))
+    {
+        _tearingSupported = allowTearing != FALSE;
+    }
+    if (_tearingSupported)
+    {
+        swapChainDesc.Flags |= DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING;
+    }
+    if (_lowLatencyPresentation)
+    {
+        swapChainDesc.Flags |= DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT;
+    }
+
     ComPtr<IDXGISwapChain1> swapChain;
     ThrowIfFailed(factory->CreateSwapChainForHwnd(
         _commandQueue.Get(),            // Swap chain needs the queue so that it can force a flush on it.
@@ -86,12 +247,20 @@ void D3D12HelloWindow::LoadPipeline()
 
     ThrowIfFailed(swapChain.As(&_swapChain)); // IDXGISwapChain1 -> IDXGISwapChain3
 
+    // The waitable object is signalled whenever Present() can queue a frame
+    // without blocking; with a maximum of one that is once the previous
+    // frame is on screen.
+    if (_lowLatencyPresentation)
+    {
+        ThrowIfFailed(_swapChain->SetMaximumFrameLatency(1));
+        _frameLatencyWaitable = _swapChain->GetFrameLatencyWaitableObject();
+    }
+
     _frameIndex = _swapChain->GetCurrentBackBufferIndex();
 
     LoadPipelineRTV();
-    //LoadPipelineDSV();
-    
-    
+    LoadPipelineDSV();
+    LoadPipelineSceneColor();
 
     ThrowIfFailed(_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&_commandAllocator)));
 }
@@ -102,12 +271,14 @@ void D3D12HelloWindow::LoadPipelineRTV()
     // desciptor heap gpu ҽ ϴ  Ѵ.
     {
         // Describe and create a render target view (RTV) descriptor heap.
+        // The back buffers, then _sceneColor.
         D3D12_DESCRIPTOR_HEAP_DESC rtvHeapDesc = {};
-        rtvHeapDesc.NumDescriptors = FrameCount;
+        rtvHeapDesc.NumDescriptors = FrameCount + 1;
         rtvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
         rtvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
         rtvHeapDesc.NodeMask = 0; // only one gpu
         ThrowIfFailed(_device->CreateDescriptorHeap(&rtvHeapDesc, IID_PPV_ARGS(&_rtvHeap)));
+        TrackD3D12DescriptorHeap(_device.Get(), _rtvHeap.Get(), "RtvHeap");
 
         _rtvDescriptorSize = _device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
     }
@@ -127,6 +298,9 @@ void D3D12HelloWindow::LoadPipelineRTV()
                 nullptr,
                 rtvHandle);
             rtvHandle.Offset(1, _rtvDescriptorSize);
+
+            RegisterTrackedResource(_resourceStates, _device.Get(), _renderTargets[n].Get(), D3D12_RESOURCE_STATE_PRESENT);
+            TrackD3D12Resource(_device.Get(), _renderTargets[n].Get(), MemoryCategory::RenderTarget, "BackBuffer");
         }
     }
 }
@@ -142,141 +316,237 @@ void D3D12HelloWindow::LoadPipelineDSV()
         dsvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
         dsvHeapDesc.NodeMask = 0;
         ThrowIfFailed(_device->CreateDescriptorHeap(&dsvHeapDesc, IID_PPV_ARGS(&_dsvHeap)));
+        TrackD3D12DescriptorHeap(_device.Get(), _dsvHeap.Get(), "DsvHeap");
     }
 
-    // Create frame resource.
+    // Create frame resource. One depth buffer serves every frame: frames
+    // render one after the other on the direct queue.
     {
         CD3DX12_CPU_DESCRIPTOR_HANDLE dsvHandle(_dsvHeap->GetCPUDescriptorHandleForHeapStart());
 
         // Create a DSV
         D3D12_RESOURCE_DESC dsvDesc = {};
         dsvDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
-        dsvDesc.Alignment = 1;
+        dsvDesc.Alignment = 0;
         dsvDesc.DepthOrArraySize = 1;
-        dsvDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL;
+        dsvDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL | D3D12_RESOURCE_FLAG_DENY_SHADER_RESOURCE;
         dsvDesc.Format = DXGI_FORMAT_D32_FLOAT;
-        dsvDesc.MipLevels = 0;
+        dsvDesc.MipLevels = 1;
         dsvDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
         dsvDesc.SampleDesc.Count = 1;
         dsvDesc.Width = _width;
         dsvDesc.Height = _height;
 
+        // Reverse-Z clears to 0, see DepthPass.h.
+        const CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_DEFAULT);
+        const CD3DX12_CLEAR_VALUE clearValue(DXGI_FORMAT_D32_FLOAT, DepthClearValue, 0);
+        ThrowIfFailed(_device->CreateCommittedResource(
+            &heapProperties,
+            D3D12_HEAP_FLAG_NONE,
+            &dsvDesc,
+            D3D12_RESOURCE_STATE_DEPTH_WRITE,
+            &clearValue,
+            IID_PPV_ARGS(&_depthStencil)));
+        NAME_D3D12_OBJECT(_depthStencil);
+
+        D3D12_DEPTH_STENCIL_VIEW_DESC viewDesc = {};
+        viewDesc.Format = DXGI_FORMAT_D32_FLOAT;
+        viewDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
+        _device->CreateDepthStencilView(_depthStencil.Get(), &viewDesc, dsvHandle);
+
+        RegisterTrackedResource(_resourceStates, _device.Get(), _depthStencil.Get(), D3D12_RESOURCE_STATE_DEPTH_WRITE);
+        TrackD3D12Resource(_device.Get(), _depthStencil.Get(), MemoryCategory::RenderTarget, "DepthBuffer");
+    }
+}
+
+// The scene renders here instead of into the back buffer, so dynamic
+// resolution can draw it smaller and the upscale pass stretch it back.
+// Output sized: every scale renders into its top left corner, and changing
+// the scale never reallocates.
+void D3D12HelloWindow::LoadPipelineSceneColor()
+{
+    {
+        D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
+        srvHeapDesc.NumDescriptors = 1;
+        srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+        srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+        srvHeapDesc.NodeMask = 0;
+        ThrowIfFailed(_device->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(&_srvHeap)));
+        TrackD3D12DescriptorHeap(_device.Get(), _srvHeap.Get(), "SrvHeap");
+    }
+
+    {
+        const CD3DX12_RESOURCE_DESC colorDesc = CD3DX12_RESOURCE_DESC::Tex2D(
+            DXGI_FORMAT_R8G8B8A8_UNORM, _width, _height, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET);
+
+        // Between frames it waits to be read by the upscale pass.
+        const CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_DEFAULT);
+        const CD3DX12_CLEAR_VALUE clearValue(DXGI_FORMAT_R8G8B8A8_UNORM, SceneClearColor);
+        ThrowIfFailed(_device->CreateCommittedResource(
+            &heapProperties,
+            D3D12_HEAP_FLAG_NONE,
+            &colorDesc,
+            D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
+            &clearValue,
+            IID_PPV_ARGS(&_sceneColor)));
+        NAME_D3D12_OBJECT(_sceneColor);
+
+        CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(_rtvHeap->GetCPUDescriptorHandleForHeapStart(), FrameCount, _rtvDescriptorSize);
+        _device->CreateRenderTargetView(_sceneColor.Get(), nullptr, rtvHandle);
+        _device->CreateShaderResourceView(_sceneColor.Get(), nullptr, _srvHeap->GetCPUDescriptorHandleForHeapStart());
+
+        RegisterTrackedResource(_resourceStates, _device.Get(), _sceneColor.Get(), D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+        TrackD3D12Resource(_device.Get(), _sceneColor.Get(), MemoryCategory::RenderTarget, "SceneColor");
     }
 }
 
 // Load the sample assets.
 void D3D12HelloWindow::LoadAssets()
 {
-    // Create an empty Root Signature
+    // Create the Root Signature
     {
-        CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDesc;
-        rootSignatureDesc.Init_1_1(
-            0u,                                                                 // num parameter
-            nullptr,                                                            // pParameters
-            0u,                                                                 // numStaticSamplers
-            nullptr,                                                            // pStaticSamplers
-            D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
-
-        ComPtr<ID3DBlob> signature;
-        ComPtr<ID3DBlob> error;
-
-        ThrowIfFailed(D3D12SerializeVersionedRootSignature(
-            &rootSignatureDesc,
-            signature.GetAddressOf(),
-            error.GetAddressOf()
-        ));
+        // t0 : per-instance data of the current draw batch, see RecordDrawBatches().
+        // b0-b2 : frame, view and draw constants; root constants or root CBVs
+        // into the upload ring, whichever the layout picked.
+        BuildSceneRootSignatureLayout(&_rootSignatureLayout);
+        _rootSignatureCache.Reset(_device.Get());
+        _rootSignature = _rootSignatureCache.Create(_rootSignatureLayout, D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
+    }
 
-        ThrowIfFailed(_device->CreateRootSignature(
-            0,
-            signature.Get(),
-            signature->GetBufferSize(),
-            IID_PPV_ARGS(_rootSignature.GetAddressOf())
-        ));
+    // The upscale pass: b0 holds UpscaleConstants, t0 the scene color, s0 a
+    // bilinear sampler. RootSignatureLayout has no static samplers, so this
+    // one is described directly.
+    {
+        CD3DX12_DESCRIPTOR_RANGE1 range;
+        range.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 0, D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE);
+
+        CD3DX12_ROOT_PARAMETER1 rootParameters[2];
+        rootParameters[0].InitAsConstants(sizeof(UpscaleConstants) / 4, 0, 0, D3D12_SHADER_VISIBILITY_PIXEL);
+        rootParameters[1].InitAsDescriptorTable(1, &range, D3D12_SHADER_VISIBILITY_PIXEL);
+
+        CD3DX12_STATIC_SAMPLER_DESC sampler(0, D3D12_FILTER_MIN_MAG_MIP_LINEAR, D3D12_TEXTURE_ADDRESS_MODE_CLAMP, D3D12_TEXTURE_ADDRESS_MODE_CLAMP, D3D12_TEXTURE_ADDRESS_MODE_CLAMP);
+        sampler.ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+
+        CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDesc;
+        rootSignatureDesc.Init_1_1(_countof(rootParameters), rootParameters, 1, &sampler, D3D12_ROOT_SIGNATURE_FLAG_NONE);
+        _upscaleRootSignature = _rootSignatureCache.Create(rootSignatureDesc);
     }
 
-    // Create the Pipeline State, whic includes compiling and loading shaders.
+    // Create the Pipeline States, which includes compiling and loading shaders.
+    // Only the variant without features is built now; the others are
+    // compiled in the background the first time a material draws with them.
     {
-        ComPtr<ID3DBlob> vertexShader;
-        ComPtr<ID3DBlob> pixelShader;
-#if defined(_DEBUG)
-        // Enable better shader debugging with the graphics debugging tools.
-        UINT compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
-#else
-        UINT compileFlags = 0;
+        D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = {};
+        psoDesc.InputLayout = { SceneInputElements, _countof(SceneInputElements) };
+        psoDesc.pRootSignature = _rootSignature.Get();
+        psoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
+        psoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
+        psoDesc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
+        psoDesc.DepthStencilState.DepthFunc = static_cast<D3D12_COMPARISON_FUNC>(SceneDepthComparison);
+        psoDesc.SampleMask = UINT_MAX;
+        psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+        psoDesc.NumRenderTargets = 1;
+        psoDesc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
+        psoDesc.DSVFormat = DXGI_FORMAT_D32_FLOAT;
+        psoDesc.SampleDesc.Count = 1;
 
-#endif
-        ThrowIfFailed(D3DCompileFromFile(
-            GetAssetFullPath(L"shaders.hlsl").c_str(),
-            nullptr,
-            nullptr, 
+        // Depth only, from the position-only streams. VSDepth must compute
+        // the position exactly like VSMain (precise), or the scene pass
+        // would fail its test against the depth laid down here.
+        D3D12_GRAPHICS_PIPELINE_STATE_DESC prepassDesc = psoDesc;
+        prepassDesc.InputLayout = { PositionInputElements, _countof(PositionInputElements) };
+        prepassDesc.DepthStencilState.DepthFunc = static_cast<D3D12_COMPARISON_FUNC>(PrepassDepthComparison);
+        prepassDesc.NumRenderTargets = 0;
+        prepassDesc.RTVFormats[0] = DXGI_FORMAT_UNKNOWN;
+
+        const int64_t pipelinesBegin = CpuProfiler::Get().NowNanoseconds();
+
+        // Embedded shaders were compiled without seeing the root signature.
+        std::string error;
+        if (!_runtimeShaderCompilation && !CheckEmbeddedShaders(_rootSignatureLayout, &error))
+        {
+            OutputDebugStringA((error + "\n").c_str());
+            ThrowIfFailed(E_FAIL);
+        }
+
+        _pipelineCompiler.reset(new D3D12PipelineCompiler(
+            _device.Get(),
+            psoDesc,
+            GetAssetFullPath(L"shaders.hlsl"),
+            SceneShaderFeatures,
+            SceneShaderFeatureCount,
             "VSMain",
-            "vs_5_0", 
-            compileFlags, 0, &vertexShader, nullptr));
-        ThrowIfFailed(D3DCompileFromFile(
-            GetAssetFullPath(L"shaders.hlsl").c_str(),
+            "PSMain",
+            !_runtimeShaderCompilation));
+        _pipelines.reset(new ShaderPermutationCache(*_pipelineCompiler, &_shaderCompileThreads, SceneShaderFeatureMask));
+
+        // No features change where a vertex ends up, so the pre-pass has a single variant.
+        _prepassCompiler.reset(new D3D12PipelineCompiler(
+            _device.Get(),
+            prepassDesc,
+            GetAssetFullPath(L"shaders.hlsl"),
             nullptr,
+            0,
+            "VSDepth",
             nullptr,
-            "PSMain",
-            "ps_5_0",
-            compileFlags, 0, &pixelShader, nullptr));
-    }
+            false));
+        _prepassPipelines.reset(new ShaderPermutationCache(*_prepassCompiler, &_shaderCompileThreads, 0));
 
-    // Create the command list.
-    ThrowIfFailed(_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, _commandAllocator.Get(), nullptr, IID_PPV_ARGS(&_commandList)));
-    // Command lists are created in the recording state, but there is nothing
-    // to record yet. The main loop expects it to be closed, so close it now.
-    ThrowIfFailed(_commandList->Close());
+        // A full screen triangle generated from SV_VertexID: no input layout, no depth.
+        D3D12_GRAPHICS_PIPELINE_STATE_DESC upscaleDesc = psoDesc;
+        upscaleDesc.InputLayout = { nullptr, 0 };
+        upscaleDesc.pRootSignature = _upscaleRootSignature.Get();
+        upscaleDesc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
+        upscaleDesc.DepthStencilState.DepthEnable = FALSE;
+        upscaleDesc.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ZERO;
+        upscaleDesc.DSVFormat = DXGI_FORMAT_UNKNOWN;
 
-    {
-        /*
-        virtual HRESULT STDMETHODCALLTYPE CreateCommittedResource( 
-            _In_  const D3D12_HEAP_PROPERTIES *pHeapProperties,
-            D3D12_HEAP_FLAGS HeapFlags,
-            _In_  const D3D12_RESOURCE_DESC *pDesc,
-            D3D12_RESOURCE_STATES InitialResourceState,
-            _In_opt_  const D3D12_CLEAR_VALUE *pOptimizedClearValue,
-            REFIID riidResource,
-            _COM_Outptr_opt_  void **ppvResource) = 0;
-        */
-
-        /*
-          {
-            D3D12_HEAP_TYPE Type;
-            D3D12_CPU_PAGE_PROPERTY CPUPageProperty;
-            D3D12_MEMORY_POOL MemoryPoolPreference;
-            UINT CreationNodeMask;
-            UINT VisibleNodeMask;
-           } 	D3D12_HEAP_PROPERTIES;
-        */
-      
-
-        D3D12_HEAP_PROPERTIES heapProperties = {};
-        heapProperties.Type = D3D12_HEAP_TYPE_UPLOAD;
-        heapProperties.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
-        heapProperties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
-        heapProperties.CreationNodeMask = 0; // 0 ==> 1
-        heapProperties.VisibleNodeMask = 0; //  0 ==> 1
-
-        // TODO
-        D3D12_RESOURCE_DESC resourceDesc = {};
-        resourceDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-        resourceDesc.Alignment = 0;// 
-        resourceDesc.DepthOrArraySize = 3;
-
-        _device->CreateCommittedResource(
-            &heapProperties,
-            D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS,
-            _vertexBuffer.GetAddressOf(),
+        _upscaleCompiler.reset(new D3D12PipelineCompiler(
+            _device.Get(),
+            upscaleDesc,
+            GetAssetFullPath(L"shaders.hlsl"),
+            nullptr,
+            0,
+            "VSUpscale",
+            "PSUpscale",
+            false));
+        _upscalePipelines.reset(new ShaderPermutationCache(*_upscaleCompiler, &_shaderCompileThreads, 0));
 
-        )
-        // Create the vertex buffer
+        if (_pipelines->Build(0, _rootSignatureLayout.hash, &error) == 0 ||
+            _prepassPipelines->Build(0, _rootSignatureLayout.hash, &error) == 0 ||
+            _upscalePipelines->Build(0, 0, &error) == 0)
         {
-            // Define t
+            OutputDebugStringA((error + "\n").c_str());
+            ThrowIfFailed(E_FAIL);
         }
+        _pipelineMilliseconds = (CpuProfiler::Get().NowNanoseconds() - pipelinesBegin) / 1e6;
 
+        // Until materials come from the model files: one per combination of features.
+        for (ShaderFeatureMask features = 0; features <= SceneShaderFeatureMask; features++)
+        {
+            if ((features & ~SceneShaderFeatureMask) == 0)
+            {
+                _materials.push_back(features);
+                _materialDepthPrepass.push_back(GetDefaultDepthPrepassMode(features));
+            }
+        }
     }
 
+    // Create the command list.
+    ThrowIfFailed(_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, _commandAllocator.Get(), nullptr, IID_PPV_ARGS(&_commandList)));
+    // Command lists are created in the recording state, but there is nothing
+    // to record yet. The main loop expects it to be closed, so close it now.
+    ThrowIfFailed(_commandList->Close());
+    _renderCommandList.reset(new D3D12RenderCommandList(_commandList.Get(), _commandAllocator.Get()));
+
+    ThrowIfFailed(_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&_fixupCommandAllocator)));
+    ThrowIfFailed(_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, _fixupCommandAllocator.Get(), nullptr, IID_PPV_ARGS(&_fixupCommandList)));
+    ThrowIfFailed(_fixupCommandList->Close());
 
+    LoadMeshes();
+    LoadUploadRing();
+    LoadStreamedTextures();
+    LoadCommandSignature();
 
     // Create synchronization objects.
     {
@@ -292,38 +562,574 @@ void D3D12HelloWindow::LoadAssets()
     }
 }
 
+// Upload the scene meshes into one buffer: vertices, indices, then the
+// welded position-only streams the depth pre-pass reads. The buffer stays in
+// an upload heap; the meshes are small and never change.
+void D3D12HelloWindow::LoadMeshes()
+{
+    std::vector<SceneVertex> vertices;
+    std::vector<uint32_t> indices;
+    BuildCube(&vertices, &indices);
+
+    PositionStream positionStream;
+    PositionStreamStats stats;
+    if (!BuildPositionStream(vertices.data(), vertices.size(), sizeof(SceneVertex), 0, indices.data(), indices.size(), &positionStream, &stats))
+    {
+        ThrowIfFailed(E_INVALIDARG);
+    }
+
+    char text[160];
+    sprintf_s(text, "Depth pre-pass streams: %u of %u vertices, %llu of %llu bytes\n",
+        stats.positionVertices, stats.sourceVertices, stats.positionBytes, stats.sourceBytes);
+    OutputDebugStringA(text);
+
+    const UINT vertexBytes = static_cast<UINT>(vertices.size() * sizeof(SceneVertex));
+    const UINT indexBytes = static_cast<UINT>(indices.size() * sizeof(uint32_t));
+    const UINT positionBytes = static_cast<UINT>(positionStream.positions.size() * sizeof(float));
+    const UINT positionIndexBytes = static_cast<UINT>(positionStream.indices.size() * sizeof(uint32_t));
+
+    const UINT indexOffset = vertexBytes;
+    const UINT positionOffset = indexOffset + indexBytes;
+    const UINT positionIndexOffset = positionOffset + positionBytes;
+    const UINT bufferBytes = positionIndexOffset + positionIndexBytes;
+
+    const CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_UPLOAD);
+    const CD3DX12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(bufferBytes);
+    ThrowIfFailed(_device->CreateCommittedResource(
+        &heapProperties,
+        D3D12_HEAP_FLAG_NONE,
+        &bufferDesc,
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(&_vertexBuffer)));
+    NAME_D3D12_OBJECT(_vertexBuffer);
+    TrackD3D12Resource(_device.Get(), _vertexBuffer.Get(), MemoryCategory::Mesh, "SceneMeshes");
+
+    UINT8* pData = nullptr;
+    CD3DX12_RANGE readRange(0, 0);
+    ThrowIfFailed(_vertexBuffer->Map(0, &readRange, reinterpret_cast<void**>(&pData)));
+    memcpy(pData, vertices.data(), vertexBytes);
+    memcpy(pData + indexOffset, indices.data(), indexBytes);
+    memcpy(pData + positionOffset, positionStream.positions.data(), positionBytes);
+    memcpy(pData + positionIndexOffset, positionStream.indices.data(), positionIndexBytes);
+    _vertexBuffer->Unmap(0, nullptr);
+
+    const D3D12_GPU_VIRTUAL_ADDRESS address = _vertexBuffer->GetGPUVirtualAddress();
+
+    Mesh mesh;
+    mesh.vertexBufferView.BufferLocation = address;
+    mesh.vertexBufferView.SizeInBytes = vertexBytes;
+    mesh.vertexBufferView.StrideInBytes = sizeof(SceneVertex);
+    mesh.indexBufferView.BufferLocation = address + indexOffset;
+    mesh.indexBufferView.SizeInBytes = indexBytes;
+    mesh.indexBufferView.Format = DXGI_FORMAT_R32_UINT;
+    mesh.indexCount = static_cast<UINT>(indices.size());
+    mesh.positionBufferView.BufferLocation = address + positionOffset;
+    mesh.positionBufferView.SizeInBytes = positionBytes;
+    mesh.positionBufferView.StrideInBytes = 3 * sizeof(float);
+    mesh.positionIndexBufferView.BufferLocation = address + positionIndexOffset;
+    mesh.positionIndexBufferView.SizeInBytes = positionIndexBytes;
+    mesh.positionIndexBufferView.Format = DXGI_FORMAT_R32_UINT;
+    _meshes.push_back(mesh);
+}
+
+// Create the persistently mapped upload buffer backing _uploadRing.
+void D3D12HelloWindow::LoadUploadRing()
+{
+    const CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_UPLOAD);
+    const CD3DX12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(UploadRingSize);
+    ThrowIfFailed(_device->CreateCommittedResource(
+        &heapProperties,
+        D3D12_HEAP_FLAG_NONE,
+        &bufferDesc,
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(&_uploadBuffer)));
+    NAME_D3D12_OBJECT(_uploadBuffer);
+    TrackD3D12Resource(_device.Get(), _uploadBuffer.Get(), MemoryCategory::Upload, "UploadRing");
+
+    // Upload heaps may stay mapped for their whole lifetime; we never read it back on the CPU.
+    CD3DX12_RANGE readRange(0, 0);
+    ThrowIfFailed(_uploadBuffer->Map(0, &readRange, reinterpret_cast<void**>(&_uploadBufferBegin)));
+
+    _uploadRing.Reset(UploadRingSize);
+    _constantBuffers.Reset(&_uploadRing, _uploadBufferBegin, _uploadBuffer->GetGPUVirtualAddress());
+}
+
+// Stream every DDS texture found in the assets directory. Until something
+// samples them they all ask for their full mip chain.
+void D3D12HelloWindow::LoadStreamedTextures()
+{
+    WIN32_FIND_DATA findData = {};
+    HANDLE find = FindFirstFile(GetAssetFullPath(L"*.dds").c_str(), &findData);
+    if (find == INVALID_HANDLE_VALUE)
+    {
+        return;
+    }
+
+    do
+    {
+        const UINT texture = _textureStreamer->AddTexture(GetAssetFullPath(findData.cFileName).c_str());
+        _textureStreamer->SetDesiredMip(texture, 0, 1.0f);
+    } while (FindNextFile(find, &findData));
+
+    FindClose(find);
+}
+
+// Create the command signature used by RecordIndirectDraws().
+void D3D12HelloWindow::LoadCommandSignature()
+{
+    _indirectLayout = MakeSceneIndirectLayout(_rootSignatureLayout);
+
+    std::vector<D3D12_INDIRECT_ARGUMENT_DESC> argumentDescs;
+    for (const IndirectArgument& argument : _indirectLayout.GetArguments())
+    {
+        D3D12_INDIRECT_ARGUMENT_DESC desc = {};
+        desc.Type = static_cast<D3D12_INDIRECT_ARGUMENT_TYPE>(argument.type);
+        switch (argument.type)
+        {
+        case IndirectArgumentType::VertexBufferView:
+            desc.VertexBuffer.Slot = argument.slot;
+            break;
+        case IndirectArgumentType::Constant:
+            desc.Constant.RootParameterIndex = argument.slot;
+            desc.Constant.DestOffsetIn32BitValues = argument.destOffsetIn32BitValues;
+            desc.Constant.Num32BitValuesToSet = argument.num32BitValues;
+            break;
+        case IndirectArgumentType::ConstantBufferView:
+            desc.ConstantBufferView.RootParameterIndex = argument.slot;
+            break;
+        case IndirectArgumentType::ShaderResourceView:
+            desc.ShaderResourceView.RootParameterIndex = argument.slot;
+            break;
+        case IndirectArgumentType::UnorderedAccessView:
+            desc.UnorderedAccessView.RootParameterIndex = argument.slot;
+            break;
+        default:
+            break;
+        }
+        argumentDescs.push_back(desc);
+    }
+
+    D3D12_COMMAND_SIGNATURE_DESC signatureDesc = {};
+    signatureDesc.ByteStride = _indirectLayout.GetByteStride();
+    signatureDesc.NumArgumentDescs = static_cast<UINT>(argumentDescs.size());
+    signatureDesc.pArgumentDescs = argumentDescs.data();
+
+    ThrowIfFailed(_device->CreateCommandSignature(
+        &signatureDesc,
+        _indirectLayout.ChangesRootArguments() ? _rootSignature.Get() : nullptr,
+        IID_PPV_ARGS(&_commandSignature)));
+    NAME_D3D12_OBJECT(_commandSignature);
+}
+
 // Update frame-based values.
 void D3D12HelloWindow::OnUpdate()
 {
+    PROFILE_SCOPE("OnUpdate");
+
+    // Textures get what is left of the local memory budget once everything
+    // else is accounted for. Budget changes also raise events, see OnInit().
+    PollD3D12MemoryBudget(_adapter.Get());
+    const MemoryBudget localBudget = GpuMemoryTracker::Get().GetBudget(MemorySegment::Local);
+    const UINT64 textureBytes = _textureStreamer->GetResidentBytes();
+    const UINT64 otherBytes = localBudget.currentUsage > textureBytes ? localBudget.currentUsage - textureBytes : 0;
+    _textureStreamer->Update(localBudget.budget > otherBytes ? localBudget.budget - otherBytes : 0);
+
+    // Never blocks: loaded assets are submitted to the copy queue, and the ones
+    // whose copies finished can be referenced by the command list of this frame.
+    _assetStreamer->Update();
+    _textureStreamer->OnAssetsStreamed();
 }
 
 // Render the scene.
 void D3D12HelloWindow::OnRender()
 {
+    // Picks up the scopes of the previous frame, the GPU ones of a frame
+    // that finished, before this frame's scopes open.
+    UpdateProfiler();
+
+    PROFILE_SCOPE("OnRender");
+
+    UpdateShaderRebuilds();
+
+    // In threaded mode the update thread starts on the next packet here.
+    const FramePacket& packet = _framePipeline->BeginFrame();
+
     // Record all the commands we need to render the scene into the command list.
-    PopulateCommandList();
+    PopulateCommandList(packet);
+
+    // Bring the resources into the states the command list assumed for their
+    // first use. Transitions that turn out to be no-ops are dropped here.
+    _resourceStates.ResetFrameStats();
+    _fixupBarriers.clear();
+    _resourceStates.Resolve(_stateTracker, _fixupBarriers);
 
     // Execute the command list.
-    ID3D12CommandList* ppCommandLists[] = { _commandList.Get() };
-    _commandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
+    _submitMicroseconds = NowMicroseconds();
+    if (_fixupBarriers.empty())
+    {
+        ID3D12CommandList* ppCommandLists[] = { _commandList.Get() };
+        _commandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
+    }
+    else
+    {
+        ThrowIfFailed(_fixupCommandAllocator->Reset());
+        ThrowIfFailed(_fixupCommandList->Reset(_fixupCommandAllocator.Get(), nullptr));
+        RecordTrackedBarriers(_fixupCommandList.Get(), _fixupBarriers, _fixupScratch);
+        ThrowIfFailed(_fixupCommandList->Close());
+
+        ID3D12CommandList* ppCommandLists[] = { _fixupCommandList.Get(), _commandList.Get() };
+        _commandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
+    }
 
     // Present the frame.
-    ThrowIfFailed(_swapChain->Present(1, 0));
+    {
+        PROFILE_SCOPE("Present");
+        const UINT presentFlags = _presentSyncInterval == 0 && _tearingSupported ? DXGI_PRESENT_ALLOW_TEARING : 0;
+        ThrowIfFailed(_swapChain->Present(_presentSyncInterval, presentFlags));
+    }
+
+    // The last vblank, for placing the next frame start. Fails while the
+    // statistics are being reset (after a mode change), which is harmless.
+    DXGI_FRAME_STATISTICS frameStatistics = {};
+    if (_frameLatencyWaitable != nullptr &&
+        SUCCEEDED(_swapChain->GetFrameStatistics(&frameStatistics)) &&
+        frameStatistics.SyncRefreshCount != 0)
+    {
+        _latencyController.RecordVblank(Win64Application::QpcToMicroseconds(frameStatistics.SyncQPCTime.QuadPart), frameStatistics.SyncRefreshCount);
+    }
+
+    // Everything allocated from the ring this frame is released by the fence
+    // WaitForPreviousFrame() is about to signal.
+    _uploadRing.EndFrame(_fenceValue);
 
     WaitForPreviousFrame();
+
+    // WaitForPreviousFrame() returns once the GPU finished the frame.
+    if (_frameStartMicroseconds != 0)
+    {
+        _latencyController.RecordFrame(_frameStartMicroseconds, _submitMicroseconds, NowMicroseconds());
+        _frameStartMicroseconds = 0;
+    }
+
+    _uploadRing.Retire(_fence->GetCompletedValue());
 }
 
 void D3D12HelloWindow::OnDestroy()
 {
     // Ensure that the GPU is no longer referencing resources that are about to be
     // cleaned up by the destructor.
+    _framePipeline.reset();
+    GpuMemoryTracker::Get().RemoveBudgetListener(_budgetListener);
     WaitForPreviousFrame();
+    _copyQueue->WaitIdle();
 
     CloseHandle(_fenceEvent);
+    if (_frameLatencyWaitable != nullptr)
+    {
+        CloseHandle(_frameLatencyWaitable);
+    }
+}
+
+// Low-latency mode only. Blocks until Present() can take another frame, then
+// until the controller lets the frame start; the caller reads input after.
+void D3D12HelloWindow::WaitForFrameStart()
+{
+    FrameLoop* pFrameLoop = Win64Application::GetFrameLoop();
+    if (_frameLatencyWaitable == nullptr || pFrameLoop == nullptr)
+    {
+        return;
+    }
+
+    PROFILE_SCOPE("WaitForFrameStart");
+
+    // Bounded, so a frame that never reached the screen cannot hang the loop.
+    WaitForSingleObjectEx(_frameLatencyWaitable, 1000, TRUE);
+
+    FrameLatencySettings settings = _latencyController.GetSettings();
+    settings.variableRefresh = _presentSyncInterval == 0;
+    _latencyController.SetSettings(settings);
+
+    // The frame loop's clock counts in the same microseconds as NowMicroseconds().
+    pFrameLoop->WaitUntil(_latencyController.GetFrameStart(NowMicroseconds()));
+    _frameStartMicroseconds = NowMicroseconds();
+}
+
+void D3D12HelloWindow::OnKeyDown(UINT8 key)
+{
+    switch (key)
+    {
+    case 'I':
+        // Toggle between per-batch draws and ExecuteIndirect submission.
+        _useIndirectDraws = !_useIndirectDraws;
+        break;
+
+    case 'T':
+        // Toggle between building frame packets inline and on the update thread.
+        _framePipeline->SetThreaded(!_framePipeline->IsThreaded());
+        break;
+
+    case 'P':
+        // Capture a Chrome trace of the next frames, see UpdateProfiler().
+        _traceEvents.clear();
+        _traceFramesLeft = TraceFrameCount;
+        break;
+
+    case 'M':
+        WriteMemorySnapshot();
+        break;
+
+    case 'Z':
+        // Toggle the depth pre-pass; the scene pass is correct either way.
+        _useDepthPrepass = !_useDepthPrepass;
+        break;
+
+    case 'V':
+        // Toggle between presenting on vblanks and as soon as frames are done.
+        _presentSyncInterval = _presentSyncInterval == 0 ? 1 : 0;
+        break;
+
+    case 'R':
+        // Toggle dynamic resolution; it starts over from the full output size.
+        _useDynamicResolution = !_useDynamicResolution;
+        _resolution.Reset(1.0f);
+        break;
+    }
+}
+
+void D3D12HelloWindow::WriteMemorySnapshot()
+{
+    GpuMemorySnapshot snapshot;
+    GpuMemoryTracker::Get().GetSnapshot(&snapshot);
+
+    std::string json;
+    WriteGpuMemorySnapshotJson(snapshot, &json);
+    std::ofstream file(GetAssetFullPath(L"ModelViewerMemory.json"), std::ios::binary);
+    file.write(json.data(), json.size());
+}
+
+void D3D12HelloWindow::OnBenchmarkScene(const BenchmarkScript& script)
+{
+    // The update thread reads the scene; it is paused while the scene changes.
+    const bool threaded = _framePipeline->IsThreaded();
+    _framePipeline->SetThreaded(false);
+
+    _benchmarkScript = script;
+    BuildBenchmarkScene(script, &_drawItems);
+    BuildBenchmarkLights(script, &_lights);
+
+    // Ids past the meshes and materials that are loaded wrap around; with
+    // none loaded there is nothing to draw.
+    if (_meshes.empty() || _materials.empty())
+    {
+        _drawItems.clear();
+    }
+    for (DrawItem& item : _drawItems)
+    {
+        item.meshId %= static_cast<UINT>(_meshes.size());
+        item.materialId %= static_cast<UINT>(_materials.size());
+    }
+
+    _framePipeline->SetThreaded(threaded);
+
+    // Measure the frames, not the refresh rate.
+    _presentSyncInterval = 0;
+}
+
+void D3D12HelloWindow::CollectProfileEvents(std::vector<ProfileEvent>* pEvents)
+{
+    pEvents->insert(pEvents->end(), _profileEvents.begin(), _profileEvents.end());
+}
+
+void D3D12HelloWindow::UpdateShaderRebuilds()
+{
+    ShaderPermutationCache* const caches[] = { _pipelines.get(), _prepassPipelines.get(), _upscalePipelines.get() };
+
+    // Files are tracked as variants first read them, so an edit made before
+    // that is not seen until the next one. Revisions only grow, so their sum
+    // changes whenever one does.
+    uint64_t revision = 0;
+    for (ShaderPermutationCache* pCache : caches)
+    {
+        revision += pCache->GetSourceRevision();
+    }
+    if (revision != _shaderSourceRevision)
+    {
+        _shaderSourceRevision = revision;
+        _shaderFiles.clear();
+        for (ShaderPermutationCache* pCache : caches)
+        {
+            pCache->GetSourceFiles(&_shaderFiles);
+        }
+        _shaderChanges.Track(_shaderFiles);
+        _shaderWatcher.Watch(_shaderFiles);
+    }
+
+    if (_shaderWatcher.Poll())
+    {
+        _shaderFiles.clear();
+        _shaderChanges.Detect(&_shaderFiles);
+        if (!_shaderFiles.empty())
+        {
+            size_t queued = 0;
+            for (ShaderPermutationCache* pCache : caches)
+            {
+                queued += pCache->Rebuild(_shaderFiles);
+            }
+            char text[160];
+            sprintf_s(text, "Shader sources changed: rebuilding %zu variants\n", queued);
+            OutputDebugStringA(text);
+        }
+    }
+
+    // Here, before anything resolves a pipeline, so a frame never mixes old
+    // and new variants.
+    size_t applied = 0;
+    for (ShaderPermutationCache* pCache : caches)
+    {
+        applied += pCache->ApplyRebuilds();
+    }
+    if (applied > 0)
+    {
+        const ShaderPermutationStats stats = _pipelines->GetStats();
+        char text[160];
+        sprintf_s(text, "Shader rebuild: %u variants applied, %u failed, last %.1f ms after the change was seen\n",
+            stats.rebuildsApplied, stats.rebuildsFailed, stats.lastRebuildMilliseconds);
+        OutputDebugStringA(text);
+    }
+}
+
+void D3D12HelloWindow::UpdateProfiler()
+{
+    _profileEvents.clear();
+    _gpuProfileFrames.clear();
+    CpuProfiler::Get().Collect(&_profileEvents);
+    _gpuProfiler->Collect(_fence->GetCompletedValue(), &_profileEvents, &_gpuProfileFrames);
+    _profileStatistics.AddFrame(_profileEvents.data(), _profileEvents.size());
+
+    // Each frame reports the scale it was recorded at; the controller drops
+    // the timings of scales it has already left.
+    if (_useDynamicResolution)
+    {
+        for (const GpuProfileFrame& frame : _gpuProfileFrames)
+        {
+            for (size_t i = frame.firstEvent; i < frame.firstEvent + frame.eventCount; i++)
+            {
+                const ProfileEvent& event = _profileEvents[i];
+                if (strcmp(event.name, "GPU Frame") == 0)
+                {
+                    _resolution.AddFrame(static_cast<float>(frame.tag), (event.endNanoseconds - event.beginNanoseconds) / 1e6);
+                }
+            }
+        }
+    }
+
+    if (_traceFramesLeft > 0)
+    {
+        _traceEvents.insert(_traceEvents.end(), _profileEvents.begin(), _profileEvents.end());
+        if (--_traceFramesLeft == 0)
+        {
+            std::string json;
+            WriteChromeTrace(_traceEvents.data(), _traceEvents.size(), CpuProfiler::Get().GetTimelineNames(), &json);
+            std::ofstream file(GetAssetFullPath(L"ModelViewerTrace.json"), std::ios::binary);
+            file.write(json.data(), json.size());
+            _traceEvents.clear();
+        }
+    }
+
+    // Rolling p50/p95/p99, refreshed twice a second so the title stays readable.
+    const int64_t now = CpuProfiler::Get().NowNanoseconds();
+    if (now - _lastTitleUpdate >= 500000000)
+    {
+        static const char* const summaryScopes[] = { "OnUpdate", "OnRender", "BuildFramePacket", "RecordDrawBatches", "SubmitDraws", "GPU Frame" };
+        std::string summary = _profileStatistics.FormatSummary(summaryScopes, _countof(summaryScopes));
+        {
+            // Of the last submitted frame: OnRender() resets them before resolving.
+            const ResourceStateStats& stats = _resourceStates.GetFrameStats();
+            char text[160];
+            sprintf_s(text, " | barriers %u issued, %u elided", stats.emittedBarriers, stats.eliminatedBarriers);
+            summary += text;
+        }
+        {
+            char text[160];
+            sprintf_s(text, " | %u draws in %u batches, %u calls saved",
+                _drawStats.inputDraws, _drawStats.batchedDraws, _drawStats.drawCallsSaved);
+            summary += text;
+        }
+        if (_clusterLightStats.lights > 0)
+        {
+            char text[160];
+            sprintf_s(text, " | %u lights, %u cluster entries, up to %u per cluster, %u clusters full",
+                _clusterLightStats.lights, _clusterLightStats.indices, _clusterLightStats.maxClusterLights, _clusterLightStats.overflowClusters);
+            summary += text;
+        }
+        {
+            const FramePipelineStats& stats = _framePipeline->GetStats();
+            char text[160];
+            sprintf_s(text, " | %s packets: build %.2f ms, waited %.2f ms",
+                stats.threaded ? "threaded" : "inline", stats.buildMilliseconds, stats.waitMilliseconds);
+            summary += text;
+        }
+        if (const FrameLoop* pFrameLoop = Win64Application::GetFrameLoop())
+        {
+            const FrameLoopStats stats = pFrameLoop->GetStats();
+            char text[160];
+            sprintf_s(text, " | frames p50 %.1f p95 %.1f p99 %.1f ms, %llu updates dropped",
+                stats.p50Milliseconds, stats.p95Milliseconds, stats.p99Milliseconds, stats.droppedUpdates);
+            summary += text;
+        }
+        {
+            const AssetStreamerStats& stats = _assetStreamer->GetStats();
+            char text[160];
+            sprintf_s(text, " | streaming %u queued, %u copying, %llu KB staged, %llu assets in %.1f ms avg",
+                stats.pendingRequests + stats.loadingRequests, stats.copiesInFlight, stats.stagingBytesUsed / 1024,
+                stats.completedAssets, stats.averageLatencyMilliseconds);
+            summary += text;
+        }
+        if (_frameLatencyWaitable != nullptr)
+        {
+            const FrameLatencyStats stats = _latencyController.GetStats();
+            char text[160];
+            sprintf_s(text, " | latency %.1f ms, start held %.1f ms, %llu missed vblanks",
+                stats.latencyMilliseconds, stats.lastDelayMilliseconds, stats.missedVblanks);
+            summary += text;
+        }
+        if (_useDynamicResolution)
+        {
+            const DynamicResolutionStats stats = _resolution.GetStats();
+            char text[160];
+            sprintf_s(text, " | scale %.2f (%ux%u), %llu changes",
+                _frameScale, _renderWidth, _renderHeight, stats.changes);
+            summary += text;
+        }
+        SetCustomWindowText(std::wstring(summary.begin(), summary.end()).c_str());
+        _lastTitleUpdate = now;
+    }
+}
+
+// Runs on the update thread in threaded mode, concurrently with recording the
+// previous packet: only scene state goes in, nothing the render thread owns.
+void D3D12HelloWindow::BuildFramePacket(FramePacket& packet)
+{
+    // Identity without a benchmark camera path: the scene is drawn in clip space.
+    EvaluateBenchmarkCamera(_benchmarkScript, packet.frameNumber, _aspectRatio, packet.viewProjection);
+    EvaluateBenchmarkView(_benchmarkScript, packet.frameNumber, packet.view);
+
+    {
+        PROFILE_SCOPE("BatchDraws");
+        packet.draws.Build(_drawItems.data(), _drawItems.size());
+    }
+
+    PROFILE_SCOPE("AssignLights");
+    SetBenchmarkClusterGrid(_benchmarkScript, _aspectRatio, &packet.lights);
+    packet.lights.Assign(_lights.data(), _lights.size(), packet.view, &_lightThreads);
 }
 
-void D3D12HelloWindow::PopulateCommandList()
+void D3D12HelloWindow::PopulateCommandList(const FramePacket& packet)
 {
+    PROFILE_SCOPE("PopulateCommandList");
+
     // Command list allocators can only be reset when the associated 
     // command lists have finished execution on the GPU; apps should use 
     // fences to determine GPU execution progress.
@@ -333,31 +1139,259 @@ void D3D12HelloWindow::PopulateCommandList()
     // list, that command list can then be reset at any time and must be before 
     // re-recording.
     ThrowIfFailed(_commandList->Reset(_commandAllocator.Get(), _pipelineState.Get()));
+    _stateTracker.Reset();
 
+    // The scale is fixed for the whole frame and tags its GPU timings, which
+    // UpdateProfiler() reports against it frames later.
+    _frameScale = _useDynamicResolution ? _resolution.GetScale() : 1.0f;
+    _renderWidth = GetScaledSize(_width, _frameScale);
+    _renderHeight = GetScaledSize(_height, _frameScale);
 
-    // Indicate that the back buffer will be used as a render target.
-    _commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(_renderTargets[_frameIndex].Get(), D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET));
+    _gpuProfiler->BeginFrame(_frameScale);
+    _gpuProfiler->BeginScope(_commandList.Get(), "GPU Frame");
 
 
-    CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(_rtvHeap->GetCPUDescriptorHandleForHeapStart(), _frameIndex, _rtvDescriptorSize);
+    // Passes declare what they touch; the graph places the barriers. The back
+    // buffer comes in and leaves in the present state.
+    _renderGraph.Reset();
+    _renderGraphExecutor.Reset();
 
-    // Record commands.
-    const float clearColor[] = { 1.0f, 0.2f, 0.4f, 1.0f };
-    _commandList->ClearRenderTargetView(rtvHandle, clearColor, 0, nullptr);
+    const RenderGraphResource backBuffer = _renderGraph.ImportResource("BackBuffer", D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_PRESENT);
+    _renderGraphExecutor.BindResource(backBuffer, _renderTargets[_frameIndex].Get());
+    const RenderGraphResource depthBuffer = _renderGraph.ImportResource("DepthBuffer", D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+    _renderGraphExecutor.BindResource(depthBuffer, _depthStencil.Get());
+    const RenderGraphResource sceneColor = _renderGraph.ImportResource("SceneColor", D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+    _renderGraphExecutor.BindResource(sceneColor, _sceneColor.Get());
 
-    // Indicate that the back buffer will now be used to present.
-    _commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(_renderTargets[_frameIndex].Get(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
+    CD3DX12_CPU_DESCRIPTOR_HANDLE backBufferRtv(_rtvHeap->GetCPUDescriptorHandleForHeapStart(), _frameIndex, _rtvDescriptorSize);
+    CD3DX12_CPU_DESCRIPTOR_HANDLE sceneColorRtv(_rtvHeap->GetCPUDescriptorHandleForHeapStart(), FrameCount, _rtvDescriptorSize);
+    const D3D12_CPU_DESCRIPTOR_HANDLE dsvHandle = _dsvHeap->GetCPUDescriptorHandleForHeapStart();
 
+    const uint32_t scenePass = _renderGraph.AddPass("Scene", [this, &packet, sceneColorRtv, dsvHandle]()
+    {
+        _gpuProfiler->BeginScope(_commandList.Get(), "GPU Scene");
+
+        // Record commands. Only the part the frame renders to is cleared.
+        const D3D12_RECT renderRect = { 0, 0, static_cast<LONG>(_renderWidth), static_cast<LONG>(_renderHeight) };
+        _commandList->ClearRenderTargetView(sceneColorRtv, SceneClearColor, 1, &renderRect);
+        _commandList->ClearDepthStencilView(dsvHandle, D3D12_CLEAR_FLAG_DEPTH, DepthClearValue, 0, 1, &renderRect);
+
+        RecordDrawBatches(packet, sceneColorRtv, dsvHandle);
+
+        _gpuProfiler->EndScope(_commandList.Get());
+    });
+    _renderGraph.Write(scenePass, sceneColor, D3D12_RESOURCE_STATE_RENDER_TARGET);
+    _renderGraph.Write(scenePass, depthBuffer, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+
+    // Stretches the rendered part of the scene color over the back buffer
+    // with a bilinear filter; a plain copy at full scale.
+    const uint32_t upscalePass = _renderGraph.AddPass("Upscale", [this, backBufferRtv]()
+    {
+        _gpuProfiler->BeginScope(_commandList.Get(), "GPU Upscale");
+
+        UpscaleConstants constants = {};
+        constants.uvScale[0] = static_cast<float>(_renderWidth) / _width;
+        constants.uvScale[1] = static_cast<float>(_renderHeight) / _height;
+        constants.uvClamp[0] = (_renderWidth - 0.5f) / _width;
+        constants.uvClamp[1] = (_renderHeight - 0.5f) / _height;
+
+        const CD3DX12_VIEWPORT viewport(0.0f, 0.0f, static_cast<float>(_width), static_cast<float>(_height));
+        const CD3DX12_RECT scissorRect(0, 0, static_cast<LONG>(_width), static_cast<LONG>(_height));
+        ID3D12DescriptorHeap* const heaps[] = { _srvHeap.Get() };
+
+        _commandList->OMSetRenderTargets(1, &backBufferRtv, FALSE, nullptr);
+        _commandList->RSSetViewports(1, &viewport);
+        _commandList->RSSetScissorRects(1, &scissorRect);
+        _commandList->SetDescriptorHeaps(_countof(heaps), heaps);
+        _commandList->SetGraphicsRootSignature(_upscaleRootSignature.Get());
+        _commandList->SetGraphicsRoot32BitConstants(0, sizeof(constants) / 4, &constants, 0);
+        _commandList->SetGraphicsRootDescriptorTable(1, _srvHeap->GetGPUDescriptorHandleForHeapStart());
+        _commandList->SetPipelineState(FromRenderHandle<ID3D12PipelineState>(_upscalePipelines->Resolve(0, 0)));
+        _commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+        _commandList->DrawInstanced(3, 1, 0, 0);
+
+        _gpuProfiler->EndScope(_commandList.Get());
+    });
+    _renderGraph.Read(upscalePass, sceneColor, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+    _renderGraph.Write(upscalePass, backBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET);
+
+    _renderGraph.Compile();
+    _renderGraphExecutor.AllocateTransients(_device.Get(), _renderGraph, _resourceStates);
+    _renderGraphExecutor.Execute(_renderGraph, _commandList.Get(), _stateTracker);
+
+    // The frame's fence value is the one WaitForPreviousFrame() signals next.
+    _gpuProfiler->EndScope(_commandList.Get());
+    _gpuProfiler->EndFrame(_commandList.Get(), _fenceValue);
 
     ThrowIfFailed(_commandList->Close());
 }
 
+// Draws sharing a mesh and a material were merged into one DrawIndexedInstanced
+// when the packet was built. The instance transforms of the frame are copied
+// into the upload ring and each batch sees its own slice through the root SRV
+// at t0. Constants are written next to them and bound as root CBVs: frame and
+// view constants once, draw constants per batch. With the depth pre-pass on,
+// the opaque materials first lay down depth from their position-only streams
+// so the scene pass shades each pixel about once.
+void D3D12HelloWindow::RecordDrawBatches(const FramePacket& packet, const D3D12_CPU_DESCRIPTOR_HANDLE& rtvHandle, const D3D12_CPU_DESCRIPTOR_HANDLE& dsvHandle)
+{
+    PROFILE_SCOPE("RecordDrawBatches");
+
+    const std::vector<DrawBatch>& batches = packet.draws.GetBatches();
+    const std::vector<InstanceData>& instances = packet.draws.GetInstances();
+    _drawStats = packet.draws.GetStats();
+    if (batches.empty())
+    {
+        return;
+    }
+
+    const UINT64 instanceBytes = instances.size() * sizeof(InstanceData);
+    UINT64 instanceOffset = 0;
+    if (!_uploadRing.Allocate(instanceBytes, sizeof(InstanceData), &instanceOffset))
+    {
+        // The ring is sized for the worst frame; running out means it is too small.
+        ThrowIfFailed(E_OUTOFMEMORY);
+    }
+    memcpy(_uploadBufferBegin + instanceOffset, instances.data(), static_cast<size_t>(instanceBytes));
+
+    const D3D12_GPU_VIRTUAL_ADDRESS instanceAddress = _uploadBuffer->GetGPUVirtualAddress() + instanceOffset;
+
+    // The lights and their cluster lists, assigned when the packet was built.
+    SceneLightBuffers lightBuffers;
+    if (!UploadSceneLights(_uploadRing, _uploadBufferBegin, _uploadBuffer->GetGPUVirtualAddress(), _lights, packet.lights, &lightBuffers))
+    {
+        ThrowIfFailed(E_OUTOFMEMORY);
+    }
+    _clusterLightStats = packet.lights.GetStats();
+
+    _constantBuffers.ResetStats();
+
+    const int64_t now = CpuProfiler::Get().NowNanoseconds();
+    if (_firstFrameNanoseconds == 0)
+    {
+        _firstFrameNanoseconds = now;
+        _previousFrameNanoseconds = now;
+    }
+    FrameConstants frameConstants = {};
+    frameConstants.timeSeconds = static_cast<float>((now - _firstFrameNanoseconds) * 1e-9);
+    frameConstants.deltaSeconds = static_cast<float>((now - _previousFrameNanoseconds) * 1e-9);
+    frameConstants.frameNumber = static_cast<UINT>(packet.frameNumber);
+    _previousFrameNanoseconds = now;
+
+    ViewConstants viewConstants = {};
+    memcpy(viewConstants.viewProjection, packet.viewProjection, sizeof(viewConstants.viewProjection));
+    viewConstants.viewportSize[0] = static_cast<float>(_renderWidth);
+    viewConstants.viewportSize[1] = static_cast<float>(_renderHeight);
+    viewConstants.inverseViewportSize[0] = 1.0f / _renderWidth;
+    viewConstants.inverseViewportSize[1] = 1.0f / _renderHeight;
+
+    ClusterConstants clusterConstants;
+    BuildClusterConstants(packet.lights, static_cast<uint32_t>(_lights.size()), &clusterConstants);
+
+    BuildDrawConstants(batches, &_drawConstants);
+
+    // Both paths record through the RenderDevice interface, the same code the
+    // headless benchmark runs against RecordingDevice.
+    _meshBindings.resize(_meshes.size());
+    for (size_t i = 0; i < _meshes.size(); i++)
+    {
+        const Mesh& mesh = _meshes[i];
+        IndirectMeshBinding& binding = _meshBindings[i];
+        binding.vertexBufferAddress = mesh.vertexBufferView.BufferLocation;
+        binding.vertexBufferSize = mesh.vertexBufferView.SizeInBytes;
+        binding.vertexStride = mesh.vertexBufferView.StrideInBytes;
+        binding.indexBufferAddress = mesh.indexBufferView.BufferLocation;
+        binding.indexBufferSize = mesh.indexBufferView.SizeInBytes;
+        binding.indexFormat = mesh.indexBufferView.Format;
+        binding.indexCount = mesh.indexCount;
+    }
+    _materialHandles.resize(_materials.size());
+    _pipelines->Resolve(_materials.data(), _materials.size(), _rootSignatureLayout.hash, _materialHandles.data());
+
+    _positionMeshBindings.resize(_meshes.size());
+    for (size_t i = 0; i < _meshes.size(); i++)
+    {
+        const Mesh& mesh = _meshes[i];
+        IndirectMeshBinding& binding = _positionMeshBindings[i];
+        binding.vertexBufferAddress = mesh.positionBufferView.BufferLocation;
+        binding.vertexBufferSize = mesh.positionBufferView.SizeInBytes;
+        binding.vertexStride = mesh.positionBufferView.StrideInBytes;
+        binding.indexBufferAddress = mesh.positionIndexBufferView.BufferLocation;
+        binding.indexBufferSize = mesh.positionIndexBufferView.SizeInBytes;
+        binding.indexFormat = mesh.positionIndexBufferView.Format;
+        binding.indexCount = mesh.indexCount;
+    }
+    _prepassHandles.resize(_materials.size());
+    SelectDepthPrepassPipelines(_materialDepthPrepass.data(), _materialDepthPrepass.size(), _prepassPipelines->Resolve(0, _rootSignatureLayout.hash), _prepassHandles.data());
+
+    const RenderViewport viewport = { 0.0f, 0.0f, static_cast<float>(_renderWidth), static_cast<float>(_renderHeight), 0.0f, 1.0f };
+    const RenderRect scissorRect = { 0, 0, static_cast<int32_t>(_renderWidth), static_cast<int32_t>(_renderHeight) };
+
+    _renderCommandList->SetGraphicsRootSignature(ToRenderHandle(_rootSignature.Get()));
+    BatchRootBindings bindings;
+    if (!BindSceneConstants(*_renderCommandList, _rootSignatureLayout, _constantBuffers, frameConstants, viewConstants, _drawConstants, instanceAddress, &bindings) ||
+        !BindSceneLights(*_renderCommandList, _rootSignatureLayout, _constantBuffers, clusterConstants, lightBuffers))
+    {
+        ThrowIfFailed(E_OUTOFMEMORY);
+    }
+    _renderCommandList->SetViewport(viewport);
+    _renderCommandList->SetScissorRect(scissorRect);
+    _renderCommandList->SetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+    // CPU cost of submitting the scene, comparable between both paths.
+    PROFILE_SCOPE("SubmitDraws");
+
+    // Direct draws in both modes; the pre-pass is a fraction of the scene's submission cost.
+    if (_useDepthPrepass)
+    {
+        _gpuProfiler->BeginScope(_commandList.Get(), "GPU Depth Prepass");
+        RecordDepthPrepass(*_renderCommandList, dsvHandle.ptr, batches.data(), batches.size(), _positionMeshBindings.data(), _prepassHandles.data(), bindings);
+        _gpuProfiler->EndScope(_commandList.Get());
+    }
+
+    _renderCommandList->SetRenderTarget(rtvHandle.ptr, dsvHandle.ptr);
+
+    if (_useIndirectDraws)
+    {
+        RecordIndirectDraws(batches, bindings);
+    }
+    else
+    {
+        RecordBatchDraws(*_renderCommandList, batches.data(), batches.size(), _meshBindings.data(), _materialHandles.data(), bindings);
+    }
+}
+
+// The argument buffer is generated on the CPU and carved from the upload ring,
+// which lives in GENERIC_READ and is therefore readable as indirect arguments.
+void D3D12HelloWindow::RecordIndirectDraws(const std::vector<DrawBatch>& batches, const BatchRootBindings& bindings)
+{
+    _indirectGenerator.Generate(_indirectLayout, batches.data(), batches.size(), _meshBindings.data(), bindings);
+
+    const std::vector<UINT8>& arguments = _indirectGenerator.GetArgumentBuffer();
+    UINT64 argumentOffset = 0;
+    if (!_uploadRing.Allocate(arguments.size(), sizeof(UINT64), &argumentOffset))
+    {
+        ThrowIfFailed(E_OUTOFMEMORY);
+    }
+    memcpy(_uploadBufferBegin + argumentOffset, arguments.data(), arguments.size());
+
+    RecordIndirectRuns(
+        *_renderCommandList,
+        _indirectGenerator,
+        _indirectLayout,
+        _materialHandles.data(),
+        ToRenderHandle(_commandSignature.Get()),
+        ToRenderHandle(_uploadBuffer.Get()),
+        argumentOffset);
+}
+
 void D3D12HelloWindow::WaitForPreviousFrame()
 {
     // WAITING FOR THE FRAME TO COMPLETE BEFORE CONTINUING IS NOT BEST PRACTICE.
     // This is code implemented as such for simplicity. The D3D12HelloFrameBuffering
     // sample illustrates how to use fences for efficient resource usage and to
     // maximize GPU utilization.
+    PROFILE_SCOPE("WaitForPreviousFrame");
 
     // Signal and increment the fence value.
     const UINT64 fence = _fenceValue;
@@ -12,6 +12,27 @@
 #pragma once
 
 #include "DXSample.h"
+#include "ConstantBufferPool.h"
+#include "D3D12CopyQueue.h"
+#include "D3D12GpuProfiler.h"
+#include "D3D12MemoryTracking.h"
+#include "D3D12PipelineCompiler.h"
+#include "D3D12RenderDevice.h"
+#include "D3D12RootSignature.h"
+#include "DepthPass.h"
+#include "DrawBatcher.h"
+#include "DynamicResolution.h"
+#include "EmbeddedShaders.h"
+#include "FrameLatency.h"
+#include "FramePipeline.h"
+#include "IndirectArguments.h"
+#include "MeshStreams.h"
+#include "RenderGraphExecutor.h"
+#include "ShaderConstants.h"
+#include "ShaderDependencies.h"
+#include "TextureStreamer.h"
+#include "UploadRing.h"
+#include "Win64FileWatcher.h"
 
 // Note that while ComPtr is used to manage the lifetime of resources on the CPU,
 // it has no understanding of the lifetime of resources on the GPU. Apps must account
@@ -29,10 +50,17 @@ public: virtual void OnUpdate();
 public: virtual void OnRender();
 public: virtual void OnDestroy();
 
+public: virtual void OnKeyDown(UINT8 key);
+public: virtual void WaitForFrameStart();
+
+public: virtual void OnBenchmarkScene(const BenchmarkScript& script);
+public: virtual void CollectProfileEvents(std::vector<ProfileEvent>* pEvents);
+
 private: static const UINT FrameCount = 2;
 
     // Pipeline objects.
 private: ComPtr<IDXGISwapChain3> _swapChain;
+private: ComPtr<IDXGIAdapter3> _adapter;
 private: ComPtr<ID3D12Device> _device;
 
 private: ComPtr<ID3D12Resource> _renderTargets[FrameCount];
@@ -42,20 +70,153 @@ private: ComPtr<ID3D12CommandAllocator> _commandAllocator;
 private: ComPtr<ID3D12CommandQueue> _commandQueue;
 
 private: ComPtr<ID3D12DescriptorHeap> _rtvHeap;
-private: ComPtr<ID3D12DescriptorHeap> _dsvHeap;
+private: ComPtr<ID3D12DescriptorHeap> _dsvHeap;     // One DSV, for _depthStencil.
 
 private: ComPtr<ID3D12PipelineState> _pipelineState;
 private: ComPtr<ID3D12GraphicsCommandList> _commandList;
-
+private: std::unique_ptr<D3D12RenderCommandList> _renderCommandList;     // Wraps _commandList for the scene recording.
+
+    // Resource states. The fixup list runs right before _commandList with the
+    // barriers its first uses need, see OnRender().
+private: ResourceStateRegistry _resourceStates;
+private: ResourceStateTracker _stateTracker;
+private: ComPtr<ID3D12CommandAllocator> _fixupCommandAllocator;
+private: ComPtr<ID3D12GraphicsCommandList> _fixupCommandList;
+private: std::vector<TrackedBarrier> _fixupBarriers;
+private: std::vector<D3D12_RESOURCE_BARRIER> _fixupScratch;
+
+private: RootSignatureLayout _rootSignatureLayout;
+private: D3D12RootSignatureCache _rootSignatureCache;
 private: ComPtr<ID3D12RootSignature> _rootSignature;
 
 private: UINT _rtvDescriptorSize;
 //private: UINT _dsvDescriptorSize;
 
-    // App objects
+    // App objects. The meshes' vertex, index and position-only streams, see LoadMeshes().
 private: ComPtr<ID3D12Resource> _vertexBuffer;
 
-
+    // Frame passes, rebuilt every frame by PopulateCommandList().
+private: RenderGraph _renderGraph;
+private: RenderGraphExecutor _renderGraphExecutor;
+
+    // Scene draws. Meshes and materials are referenced by index from DrawItem.
+private: struct Mesh
+    {
+        D3D12_VERTEX_BUFFER_VIEW vertexBufferView;
+        D3D12_INDEX_BUFFER_VIEW indexBufferView;
+        UINT indexCount;
+
+        // What the depth pre-pass draws, see BuildPositionStream().
+        D3D12_VERTEX_BUFFER_VIEW positionBufferView;
+        D3D12_INDEX_BUFFER_VIEW positionIndexBufferView;
+    };
+private: std::vector<Mesh> _meshes;
+private: std::vector<ShaderFeatureMask> _materials;    // The shader features each material needs.
+private: std::vector<DepthPrepassMode> _materialDepthPrepass;
+private: std::vector<DrawItem> _drawItems;
+private: std::vector<PointLight> _lights;
+private: ThreadPool _lightThreads;     // Assigns _lights to clusters for each packet.
+
+    // Turns the scene into the frame packets OnRender() records, either inline
+    // or on an update thread one frame ahead. Owns _drawItems and _lights
+    // while it runs.
+private: std::unique_ptr<FramePipeline> _framePipeline;
+private: BenchmarkScript _benchmarkScript;
+
+    // GPU-driven submission: one ExecuteIndirect per material instead of a draw per batch.
+private: ComPtr<ID3D12CommandSignature> _commandSignature;
+private: IndirectCommandLayout _indirectLayout;
+private: IndirectDrawGenerator _indirectGenerator;
+private: std::vector<IndirectMeshBinding> _meshBindings;
+private: std::vector<RenderHandle> _materialHandles;   // Pipeline of each material this frame, see _pipelines.
+private: bool _useIndirectDraws;
+
+    // Depth pre-pass: always direct draws, from the position-only streams.
+private: std::vector<IndirectMeshBinding> _positionMeshBindings;
+private: std::vector<RenderHandle> _prepassHandles;    // Pre-pass pipeline of each material, 0 for those left out.
+private: bool _useDepthPrepass;
+private: DrawBatchStats _drawStats;         // Of the last recorded frame, for the title.
+private: ClusterLightStats _clusterLightStats;  // Likewise.
+
+    // Asset streaming on the copy queue. Members go in reverse declaration
+    // order, so each streamer is declared after what it uses: the asset
+    // streamer after the loader threads and the queue, the texture streamer
+    // after the asset streamer.
+private: static const UINT64 StagingBufferSize = 64 * 1024 * 1024;
+private: ThreadPool _loaderThreads;
+private: std::unique_ptr<D3D12CopyQueue> _copyQueue;
+private: std::unique_ptr<AssetStreamer> _assetStreamer;
+private: std::unique_ptr<TextureStreamer> _textureStreamer;
+
+    // Shader variants of the materials and the depth-only pipeline of the
+    // pre-pass, compiled in the background as they are first drawn. Each
+    // cache is declared after the threads and its compiler so it is
+    // destroyed, and waits for its compiles, first.
+private: ThreadPool _shaderCompileThreads;
+private: std::unique_ptr<D3D12PipelineCompiler> _pipelineCompiler;
+private: std::unique_ptr<ShaderPermutationCache> _pipelines;
+private: std::unique_ptr<D3D12PipelineCompiler> _prepassCompiler;
+private: std::unique_ptr<ShaderPermutationCache> _prepassPipelines;
+private: double _pipelineMilliseconds;
+
+    // Variants compiled from source are rebuilt when a file they read
+    // changes, see UpdateShaderRebuilds(). Embedded ones read no files.
+private: Win64FileWatcher _shaderWatcher;
+private: SourceChangeDetector _shaderChanges;
+private: uint64_t _shaderSourceRevision;
+private: std::vector<std::string> _shaderFiles;
+
+    // Transient per-frame data (instance transforms, ...).
+private: static const UINT64 UploadRingSize = 4 * 1024 * 1024;
+private: ComPtr<ID3D12Resource> _uploadBuffer;
+private: UINT8* _uploadBufferBegin;
+private: UploadRing _uploadRing;
+
+    // Frame, view and draw constants, carved from _uploadRing.
+private: ConstantBufferPool _constantBuffers;
+private: std::vector<DrawConstants> _drawConstants;
+private: int64_t _firstFrameNanoseconds;
+private: int64_t _previousFrameNanoseconds;
+
+
+    // Profiling. CPU scopes come from every thread, GPU scopes from the direct
+    // queue; the window title shows their rolling percentiles.
+private: static const UINT MaxGpuScopes = 32;
+private: static const UINT TraceFrameCount = 300;
+private: std::unique_ptr<D3D12GpuProfiler> _gpuProfiler;
+private: std::vector<ProfileEvent> _profileEvents;
+private: std::vector<GpuProfileFrame> _gpuProfileFrames;   // Tagged with the frame's render scale.
+private: ProfileStatistics _profileStatistics;
+private: std::vector<ProfileEvent> _traceEvents;
+private: UINT _traceFramesLeft;
+private: int64_t _lastTitleUpdate;
+private: UINT _presentSyncInterval;     // 'V' toggles 0, which tears or lets a variable refresh display show frames at once.
+
+    // Low-latency presentation (-low_latency): at most one frame queued for
+    // presentation, started as late as _latencyController allows.
+private: bool _tearingSupported;
+private: HANDLE _frameLatencyWaitable;      // Null outside low-latency mode.
+private: FrameLatencyController _latencyController;
+private: int64_t _frameStartMicroseconds;   // 0 when the frame did not wait in WaitForFrameStart().
+private: int64_t _submitMicroseconds;
+
+    // Dynamic resolution ('R'): the scene renders into the top left of
+    // _sceneColor at _frameScale of the output size, which the upscale pass
+    // stretches over the back buffer. _resolution picks the scale from the
+    // GPU frame times.
+private: ComPtr<ID3D12Resource> _sceneColor;        // Output sized; its RTV follows the back buffers'.
+private: ComPtr<ID3D12DescriptorHeap> _srvHeap;     // Shader visible, one SRV for _sceneColor.
+private: ComPtr<ID3D12RootSignature> _upscaleRootSignature;
+private: std::unique_ptr<D3D12PipelineCompiler> _upscaleCompiler;
+private: std::unique_ptr<ShaderPermutationCache> _upscalePipelines;
+private: DynamicResolutionController _resolution;
+private: bool _useDynamicResolution;
+private: float _frameScale;                         // Of the frame recorded last.
+private: UINT _renderWidth;
+private: UINT _renderHeight;
+
+    // GPU memory accounting lives in GpuMemoryTracker::Get(); 'M' writes a snapshot.
+private: uint32_t _budgetListener;
 
     // Synchronization objects.
 private: UINT _frameIndex;
@@ -68,10 +229,21 @@ private: void LoadPipeline();
 
 private: void LoadPipelineRTV();
 private: void LoadPipelineDSV();
+private: void LoadPipelineSceneColor();
 
 private: void LoadAssets();
-
-
-private: void PopulateCommandList();
+private: void LoadUploadRing();
+private: void LoadStreamedTextures();
+private: void LoadCommandSignature();
+private: void LoadMeshes();
+
+
+private: void BuildFramePacket(FramePacket& packet);
+private: void UpdateProfiler();
+private: void UpdateShaderRebuilds();
+private: void WriteMemorySnapshot();
+private: void PopulateCommandList(const FramePacket& packet);
+private: void RecordDrawBatches(const FramePacket& packet, const D3D12_CPU_DESCRIPTOR_HANDLE& rtvHandle, const D3D12_CPU_DESCRIPTOR_HANDLE& dsvHandle);
+private: void RecordIndirectDraws(const std::vector<DrawBatch>& batches, const BatchRootBindings& bindings);
 private: void WaitForPreviousFrame();
 };
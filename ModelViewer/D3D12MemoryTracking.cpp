@@ -0,0 +1,100 @@
+#include "stdafx.h"
+#include "D3D12MemoryTracking.h"
+
+namespace
+{
+    // {5D0E3B52-7F7A-4C1B-9B0A-2E6C1F4D8A31}
+    const GUID MemoryTrackingGuid = { 0x5d0e3b52, 0x7f7a, 0x4c1b, { 0x9b, 0x0a, 0x2e, 0x6c, 0x1f, 0x4d, 0x8a, 0x31 } };
+
+    // Held by the tracked object only; its last Release() is the object's.
+    class MemoryTrackingToken : public IUnknown
+    {
+    public: MemoryTrackingToken(GpuMemoryTracker& tracker, uint64_t id) :
+            _tracker(tracker),
+            _id(id),
+            _refCount(1)
+        {
+        }
+
+    public: virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppvObject)
+        {
+            if (ppvObject == nullptr)
+            {
+                return E_POINTER;
+            }
+            if (riid != __uuidof(IUnknown))
+            {
+                *ppvObject = nullptr;
+                return E_NOINTERFACE;
+            }
+            AddRef();
+            *ppvObject = static_cast<IUnknown*>(this);
+            return S_OK;
+        }
+
+    public: virtual ULONG STDMETHODCALLTYPE AddRef()
+        {
+            return static_cast<ULONG>(InterlockedIncrement(&_refCount));
+        }
+
+    public: virtual ULONG STDMETHODCALLTYPE Release()
+        {
+            const LONG refCount = InterlockedDecrement(&_refCount);
+            if (refCount == 0)
+            {
+                _tracker.Release(_id);
+                delete this;
+            }
+            return static_cast<ULONG>(refCount);
+        }
+
+    private: GpuMemoryTracker& _tracker;
+    private: uint64_t _id;
+    private: LONG _refCount;
+    };
+}
+
+void TrackD3D12Object(ID3D12Object* pObject, MemoryCategory category, UINT64 bytes, const char* name, GpuMemoryTracker& tracker)
+{
+    MemoryTrackingToken* pToken = new MemoryTrackingToken(tracker, tracker.Track(category, bytes, name));
+    const HRESULT hr = pObject->SetPrivateDataInterface(MemoryTrackingGuid, pToken);
+    pToken->Release();
+    ThrowIfFailed(hr);
+}
+
+void TrackD3D12Resource(ID3D12Device* pDevice, ID3D12Resource* pResource, MemoryCategory category, const char* name, GpuMemoryTracker& tracker)
+{
+    const D3D12_RESOURCE_DESC desc = pResource->GetDesc();
+    const D3D12_RESOURCE_ALLOCATION_INFO info = pDevice->GetResourceAllocationInfo(0, 1, &desc);
+    TrackD3D12Object(pResource, category, info.SizeInBytes, name, tracker);
+}
+
+void TrackD3D12Heap(ID3D12Heap* pHeap, MemoryCategory category, const char* name, GpuMemoryTracker& tracker)
+{
+    TrackD3D12Object(pHeap, category, pHeap->GetDesc().SizeInBytes, name, tracker);
+}
+
+void TrackD3D12DescriptorHeap(ID3D12Device* pDevice, ID3D12DescriptorHeap* pHeap, const char* name, GpuMemoryTracker& tracker)
+{
+    const D3D12_DESCRIPTOR_HEAP_DESC desc = pHeap->GetDesc();
+    const UINT64 bytes = static_cast<UINT64>(desc.NumDescriptors) * pDevice->GetDescriptorHandleIncrementSize(desc.Type);
+    TrackD3D12Object(pHeap, MemoryCategory::Descriptor, bytes, name, tracker);
+}
+
+void PollD3D12MemoryBudget(IDXGIAdapter3* pAdapter, GpuMemoryTracker& tracker)
+{
+    const DXGI_MEMORY_SEGMENT_GROUP groups[] = { DXGI_MEMORY_SEGMENT_GROUP_LOCAL, DXGI_MEMORY_SEGMENT_GROUP_NON_LOCAL };
+    const MemorySegment segments[] = { MemorySegment::Local, MemorySegment::NonLocal };
+    for (size_t i = 0; i < _countof(groups); i++)
+    {
+        DXGI_QUERY_VIDEO_MEMORY_INFO info = {};
+        ThrowIfFailed(pAdapter->QueryVideoMemoryInfo(0, groups[i], &info));
+
+        MemoryBudget budget;
+        budget.budget = info.Budget;
+        budget.currentUsage = info.CurrentUsage;
+        budget.availableForReservation = info.AvailableForReservation;
+        budget.currentReservation = info.CurrentReservation;
+        tracker.UpdateBudget(segments[i], budget);
+    }
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "GpuMemoryTracker.h"
+
+// Glue between GpuMemoryTracker and D3D12. A tracked object carries a private
+// data interface that releases its allocation when the object is destroyed,
+// so every release path is accounted for without touching the call sites.
+void TrackD3D12Object(ID3D12Object* pObject, MemoryCategory category, UINT64 bytes, const char* name, GpuMemoryTracker& tracker = GpuMemoryTracker::Get());
+
+// Committed resources only: placed resources live in a tracked heap, and
+// reserved resources own no memory until tiles are mapped from one.
+void TrackD3D12Resource(ID3D12Device* pDevice, ID3D12Resource* pResource, MemoryCategory category, const char* name, GpuMemoryTracker& tracker = GpuMemoryTracker::Get());
+void TrackD3D12Heap(ID3D12Heap* pHeap, MemoryCategory category, const char* name, GpuMemoryTracker& tracker = GpuMemoryTracker::Get());
+void TrackD3D12DescriptorHeap(ID3D12Device* pDevice, ID3D12DescriptorHeap* pHeap, const char* name, GpuMemoryTracker& tracker = GpuMemoryTracker::Get());
+
+// Feeds both segments of QueryVideoMemoryInfo to the tracker; call once a frame.
+void PollD3D12MemoryBudget(IDXGIAdapter3* pAdapter, GpuMemoryTracker& tracker = GpuMemoryTracker::Get());
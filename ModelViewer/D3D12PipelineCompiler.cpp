@@ -0,0 +1,206 @@
+#include "stdafx.h"
+#include "D3D12PipelineCompiler.h"
+#include "EmbeddedShaders.h"
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+
+namespace
+{
+    std::string ToUtf8(const std::wstring& text)
+    {
+        const int size = WideCharToMultiByte(CP_UTF8, 0, text.c_str(), static_cast<int>(text.size()), nullptr, 0, nullptr, nullptr);
+        std::string utf8(size, '\0');
+        WideCharToMultiByte(CP_UTF8, 0, text.c_str(), static_cast<int>(text.size()), &utf8[0], size, nullptr, nullptr);
+        return utf8;
+    }
+
+    std::wstring GetFullPath(const std::wstring& path)
+    {
+        WCHAR fullPath[MAX_PATH];
+        const DWORD length = GetFullPathNameW(path.c_str(), _countof(fullPath), fullPath, nullptr);
+        return length > 0 && length < _countof(fullPath) ? std::wstring(fullPath, length) : path;
+    }
+
+    std::wstring GetDirectory(const std::wstring& path)
+    {
+        const size_t separator = path.find_last_of(L"\\/");
+        return separator == std::wstring::npos ? std::wstring() : path.substr(0, separator + 1);
+    }
+
+    // Opens includes relative to the including file, like
+    // D3D_COMPILE_STANDARD_FILE_INCLUDE, and remembers every file opened,
+    // the root file included, as full UTF-8 paths.
+    class RecordingInclude : public ID3DInclude
+    {
+    public: explicit RecordingInclude(const std::wstring& rootPath) :
+            _rootDirectory(GetDirectory(GetFullPath(rootPath)))
+        {
+            AddInput(GetFullPath(rootPath));
+        }
+
+    public: STDMETHOD(Open)(D3D_INCLUDE_TYPE /*includeType*/, LPCSTR pFileName, LPCVOID pParentData, LPCVOID* ppData, UINT* pBytes) override
+        {
+            auto parent = _directories.find(pParentData);
+            const std::wstring& directory = parent != _directories.end() ? parent->second : _rootDirectory;
+
+            WCHAR fileName[MAX_PATH];
+            if (MultiByteToWideChar(CP_ACP, 0, pFileName, -1, fileName, _countof(fileName)) == 0)
+            {
+                return E_FAIL;
+            }
+            const std::wstring path = GetFullPath(directory + fileName);
+
+            // Recorded before reading, so a missing include is rebuilt once it appears.
+            AddInput(path);
+
+            std::ifstream file(path, std::ios::binary | std::ios::ate);
+            if (!file)
+            {
+                return E_FAIL;
+            }
+            const std::streamoff size = file.tellg();
+            char* pData = new char[static_cast<size_t>(size) + 1];
+            file.seekg(0);
+            file.read(pData, size);
+
+            _directories[pData] = GetDirectory(path);
+            *ppData = pData;
+            *pBytes = static_cast<UINT>(size);
+            return S_OK;
+        }
+
+    public: STDMETHOD(Close)(LPCVOID pData) override
+        {
+            _directories.erase(pData);
+            delete[] static_cast<const char*>(pData);
+            return S_OK;
+        }
+
+    public: const std::vector<std::string>& GetInputs() const { return _inputs; }
+
+    private: void AddInput(const std::wstring& path)
+        {
+            const std::string utf8 = ToUtf8(path);
+            if (std::find(_inputs.begin(), _inputs.end(), utf8) == _inputs.end())
+            {
+                _inputs.push_back(utf8);
+            }
+        }
+
+    private: std::wstring _rootDirectory;
+    private: std::map<LPCVOID, std::wstring> _directories;     // Of the files open, for their own includes.
+    private: std::vector<std::string> _inputs;
+    };
+
+    bool CompileShader(
+        const std::wstring& path,
+        const D3D_SHADER_MACRO* pDefines,
+        ID3DInclude* pInclude,
+        const char* entryPoint,
+        const char* target,
+        ComPtr<ID3DBlob>* pShader,
+        std::string* pError)
+    {
+#if defined(_DEBUG)
+        // Enable better shader debugging with the graphics debugging tools.
+        const UINT compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+#else
+        const UINT compileFlags = 0;
+#endif
+        ComPtr<ID3DBlob> errors;
+        const HRESULT hr = D3DCompileFromFile(
+            path.c_str(),
+            pDefines,
+            pInclude,
+            entryPoint,
+            target,
+            compileFlags, 0, pShader->GetAddressOf(), errors.GetAddressOf());
+        if (FAILED(hr))
+        {
+            *pError = errors ? static_cast<const char*>(errors->GetBufferPointer()) : "D3DCompileFromFile failed";
+            return false;
+        }
+        return true;
+    }
+}
+
+D3D12PipelineCompiler::D3D12PipelineCompiler(
+    ID3D12Device* pDevice,
+    const D3D12_GRAPHICS_PIPELINE_STATE_DESC& baseDesc,
+    const std::wstring& shaderPath,
+    const ShaderFeatureInfo* pFeatures,
+    size_t featureCount,
+    const char* vertexEntryPoint,
+    const char* pixelEntryPoint,
+    bool useEmbeddedShaders) :
+    _device(pDevice),
+    _baseDesc(baseDesc),
+    _shaderPath(shaderPath),
+    _features(pFeatures, pFeatures + featureCount),
+    _vertexEntryPoint(vertexEntryPoint),
+    _pixelEntryPoint(pixelEntryPoint),
+    _useEmbeddedShaders(useEmbeddedShaders)
+{
+}
+
+RenderHandle D3D12PipelineCompiler::Compile(const ShaderPermutationKey& key, std::vector<std::string>* pInputs, std::string* pError)
+{
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC desc = _baseDesc;
+
+    const EmbeddedShaderVariant* pEmbedded = _useEmbeddedShaders ? FindEmbeddedShaderVariant(key.features) : nullptr;
+    if (pEmbedded != nullptr)
+    {
+        desc.VS = CD3DX12_SHADER_BYTECODE(pEmbedded->pVertexShader, pEmbedded->vertexShaderSize);
+        desc.PS = CD3DX12_SHADER_BYTECODE(pEmbedded->pPixelShader, pEmbedded->pixelShaderSize);
+        return CreatePipelineState(desc, pError);
+    }
+
+    std::vector<D3D_SHADER_MACRO> defines;
+    for (const ShaderFeatureInfo& feature : _features)
+    {
+        if ((key.features & feature.bit) != 0)
+        {
+            defines.push_back({ feature.define, "1" });
+        }
+    }
+    defines.push_back({ nullptr, nullptr });
+
+    RecordingInclude include(_shaderPath);
+    ComPtr<ID3DBlob> vertexShader;
+    ComPtr<ID3DBlob> pixelShader;
+    const bool compiled =
+        CompileShader(_shaderPath, defines.data(), &include, _vertexEntryPoint, "vs_5_0", &vertexShader, pError) &&
+        (_pixelEntryPoint == nullptr || CompileShader(_shaderPath, defines.data(), &include, _pixelEntryPoint, "ps_5_0", &pixelShader, pError));
+    *pInputs = include.GetInputs();
+    if (!compiled)
+    {
+        OutputDebugStringA(pError->c_str());
+        return 0;
+    }
+
+    desc.VS = CD3DX12_SHADER_BYTECODE(vertexShader.Get());
+    if (pixelShader)
+    {
+        desc.PS = CD3DX12_SHADER_BYTECODE(pixelShader.Get());
+    }
+    return CreatePipelineState(desc, pError);
+}
+
+RenderHandle D3D12PipelineCompiler::CreatePipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, std::string* pError)
+{
+    // The device is free-threaded; variants are created from several compile threads at once.
+    ComPtr<ID3D12PipelineState> pipelineState;
+    const HRESULT hr = _device->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(&pipelineState));
+    if (FAILED(hr))
+    {
+        *pError = "CreateGraphicsPipelineState failed";
+        OutputDebugStringA(pError->c_str());
+        return 0;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _pipelineStates.push_back(pipelineState);
+    return ToRenderHandle(pipelineState.Get());
+}
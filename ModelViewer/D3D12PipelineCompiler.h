@@ -0,0 +1,48 @@
+#pragma once
+
+#include "D3D12RenderDevice.h"
+#include "ShaderPermutations.h"
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+using Microsoft::WRL::ComPtr;
+
+// Compiles the vertex and pixel shader of a variant with the defines of its
+// features and creates its pipeline state from a template desc. Variants
+// embedded at build time (EmbeddedShaders.h) skip the compile unless
+// useEmbeddedShaders is off. Variants compiled from source report the files
+// they included, for rebuilding them when one changes. Owns the pipeline
+// states it creates; handles are the ID3D12PipelineState pointers.
+class D3D12PipelineCompiler : public PipelineCompiler
+{
+    // Everything but the shaders comes from baseDesc; the arrays it points to
+    // must outlive the compiler. A null pixelEntryPoint builds depth-only
+    // pipelines. Embedded variants hold VSMain and PSMain, so compilers of
+    // other entry points pass false for useEmbeddedShaders.
+public: D3D12PipelineCompiler(
+        ID3D12Device* pDevice,
+        const D3D12_GRAPHICS_PIPELINE_STATE_DESC& baseDesc,
+        const std::wstring& shaderPath,
+        const ShaderFeatureInfo* pFeatures,
+        size_t featureCount,
+        const char* vertexEntryPoint,
+        const char* pixelEntryPoint,
+        bool useEmbeddedShaders);
+
+public: virtual RenderHandle Compile(const ShaderPermutationKey& key, std::vector<std::string>* pInputs, std::string* pError);
+
+private: RenderHandle CreatePipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, std::string* pError);
+
+private: ComPtr<ID3D12Device> _device;
+private: D3D12_GRAPHICS_PIPELINE_STATE_DESC _baseDesc;
+private: std::wstring _shaderPath;
+private: std::vector<ShaderFeatureInfo> _features;
+private: const char* _vertexEntryPoint;
+private: const char* _pixelEntryPoint;
+private: bool _useEmbeddedShaders;
+
+private: std::mutex _mutex;
+private: std::vector<ComPtr<ID3D12PipelineState>> _pipelineStates;
+};
@@ -0,0 +1,219 @@
+#include "stdafx.h"
+#include "D3D12RenderDevice.h"
+
+D3D12RenderCommandList::D3D12RenderCommandList(ID3D12GraphicsCommandList* pCommandList, ID3D12CommandAllocator* pCommandAllocator) :
+    _commandList(pCommandList),
+    _commandAllocator(pCommandAllocator)
+{
+}
+
+void D3D12RenderCommandList::Reset(RenderHandle pipelineState)
+{
+    ThrowIfFailed(_commandAllocator->Reset());
+    ThrowIfFailed(_commandList->Reset(_commandAllocator.Get(), FromRenderHandle<ID3D12PipelineState>(pipelineState)));
+}
+
+void D3D12RenderCommandList::Close()
+{
+    ThrowIfFailed(_commandList->Close());
+}
+
+void D3D12RenderCommandList::ResourceBarriers(const TrackedBarrier* pBarriers, size_t count)
+{
+    _barriers.assign(pBarriers, pBarriers + count);
+    RecordTrackedBarriers(_commandList.Get(), _barriers, _barrierScratch);
+}
+
+void D3D12RenderCommandList::SetPipelineState(RenderHandle pipelineState)
+{
+    _commandList->SetPipelineState(FromRenderHandle<ID3D12PipelineState>(pipelineState));
+}
+
+void D3D12RenderCommandList::SetGraphicsRootSignature(RenderHandle rootSignature)
+{
+    _commandList->SetGraphicsRootSignature(FromRenderHandle<ID3D12RootSignature>(rootSignature));
+}
+
+void D3D12RenderCommandList::SetGraphicsRoot32BitConstants(uint32_t rootParameterIndex, uint32_t num32BitValues, const void* pData, uint32_t destOffsetIn32BitValues)
+{
+    _commandList->SetGraphicsRoot32BitConstants(rootParameterIndex, num32BitValues, pData, destOffsetIn32BitValues);
+}
+
+void D3D12RenderCommandList::SetGraphicsRootConstantBufferView(uint32_t rootParameterIndex, uint64_t address)
+{
+    _commandList->SetGraphicsRootConstantBufferView(rootParameterIndex, address);
+}
+
+void D3D12RenderCommandList::SetGraphicsRootShaderResourceView(uint32_t rootParameterIndex, uint64_t address)
+{
+    _commandList->SetGraphicsRootShaderResourceView(rootParameterIndex, address);
+}
+
+void D3D12RenderCommandList::SetViewport(const RenderViewport& viewport)
+{
+    const CD3DX12_VIEWPORT d3dViewport(viewport.x, viewport.y, viewport.width, viewport.height, viewport.minDepth, viewport.maxDepth);
+    _commandList->RSSetViewports(1, &d3dViewport);
+}
+
+void D3D12RenderCommandList::SetScissorRect(const RenderRect& rect)
+{
+    const CD3DX12_RECT d3dRect(rect.left, rect.top, rect.right, rect.bottom);
+    _commandList->RSSetScissorRects(1, &d3dRect);
+}
+
+void D3D12RenderCommandList::SetRenderTarget(RenderDescriptor renderTarget, RenderDescriptor depthStencil)
+{
+    D3D12_CPU_DESCRIPTOR_HANDLE renderTargetHandle = { static_cast<SIZE_T>(renderTarget) };
+    D3D12_CPU_DESCRIPTOR_HANDLE depthStencilHandle = { static_cast<SIZE_T>(depthStencil) };
+    _commandList->OMSetRenderTargets(
+        renderTarget != 0 ? 1 : 0,
+        renderTarget != 0 ? &renderTargetHandle : nullptr,
+        FALSE,
+        depthStencil != 0 ? &depthStencilHandle : nullptr);
+}
+
+void D3D12RenderCommandList::ClearRenderTarget(RenderDescriptor renderTarget, const float color[4])
+{
+    D3D12_CPU_DESCRIPTOR_HANDLE handle = { static_cast<SIZE_T>(renderTarget) };
+    _commandList->ClearRenderTargetView(handle, color, 0, nullptr);
+}
+
+void D3D12RenderCommandList::ClearDepthStencil(RenderDescriptor depthStencil, float depth)
+{
+    D3D12_CPU_DESCRIPTOR_HANDLE handle = { static_cast<SIZE_T>(depthStencil) };
+    _commandList->ClearDepthStencilView(handle, D3D12_CLEAR_FLAG_DEPTH, depth, 0, 0, nullptr);
+}
+
+void D3D12RenderCommandList::SetPrimitiveTopology(uint32_t topology)
+{
+    _commandList->IASetPrimitiveTopology(static_cast<D3D12_PRIMITIVE_TOPOLOGY>(topology));
+}
+
+void D3D12RenderCommandList::SetVertexBuffer(uint32_t slot, uint64_t address, uint32_t size, uint32_t stride)
+{
+    const D3D12_VERTEX_BUFFER_VIEW view = { address, size, stride };
+    _commandList->IASetVertexBuffers(slot, 1, &view);
+}
+
+void D3D12RenderCommandList::SetIndexBuffer(uint64_t address, uint32_t size, uint32_t format)
+{
+    const D3D12_INDEX_BUFFER_VIEW view = { address, size, static_cast<DXGI_FORMAT>(format) };
+    _commandList->IASetIndexBuffer(&view);
+}
+
+void D3D12RenderCommandList::DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t baseVertex, uint32_t firstInstance)
+{
+    _commandList->DrawIndexedInstanced(indexCount, instanceCount, firstIndex, baseVertex, firstInstance);
+}
+
+void D3D12RenderCommandList::ExecuteIndirect(RenderHandle commandSignature, uint32_t commandCount, RenderHandle argumentBuffer, uint64_t argumentOffset)
+{
+    _commandList->ExecuteIndirect(
+        FromRenderHandle<ID3D12CommandSignature>(commandSignature),
+        commandCount,
+        FromRenderHandle<ID3D12Resource>(argumentBuffer),
+        argumentOffset,
+        nullptr,
+        0);
+}
+
+D3D12RenderFence::D3D12RenderFence(ID3D12Fence* pFence) :
+    _fence(pFence)
+{
+    _fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+    if (_fenceEvent == nullptr)
+    {
+        ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+    }
+}
+
+D3D12RenderFence::~D3D12RenderFence()
+{
+    CloseHandle(_fenceEvent);
+}
+
+uint64_t D3D12RenderFence::GetCompletedValue()
+{
+    return _fence->GetCompletedValue();
+}
+
+void D3D12RenderFence::Wait(uint64_t value)
+{
+    if (_fence->GetCompletedValue() < value)
+    {
+        ThrowIfFailed(_fence->SetEventOnCompletion(value, _fenceEvent));
+        WaitForSingleObject(_fenceEvent, INFINITE);
+    }
+}
+
+D3D12RenderQueue::D3D12RenderQueue(ID3D12CommandQueue* pCommandQueue) :
+    _commandQueue(pCommandQueue)
+{
+}
+
+void D3D12RenderQueue::ExecuteCommandLists(RenderCommandList* const* ppCommandLists, size_t count)
+{
+    _commandLists.resize(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        _commandLists[i] = static_cast<D3D12RenderCommandList*>(ppCommandLists[i])->GetCommandList();
+    }
+    _commandQueue->ExecuteCommandLists(static_cast<UINT>(count), _commandLists.data());
+}
+
+void D3D12RenderQueue::Signal(RenderFence& fence, uint64_t value)
+{
+    ThrowIfFailed(_commandQueue->Signal(static_cast<D3D12RenderFence&>(fence).GetFence(), value));
+}
+
+D3D12RenderDevice::D3D12RenderDevice(ID3D12Device* pDevice, ID3D12CommandQueue* pCommandQueue) :
+    _device(pDevice),
+    _queue(pCommandQueue)
+{
+}
+
+std::unique_ptr<RenderCommandList> D3D12RenderDevice::CreateCommandList()
+{
+    ComPtr<ID3D12CommandAllocator> commandAllocator;
+    ComPtr<ID3D12GraphicsCommandList> commandList;
+    ThrowIfFailed(_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&commandAllocator)));
+    ThrowIfFailed(_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, commandAllocator.Get(), nullptr, IID_PPV_ARGS(&commandList)));
+    ThrowIfFailed(commandList->Close());
+    return std::unique_ptr<RenderCommandList>(new D3D12RenderCommandList(commandList.Get(), commandAllocator.Get()));
+}
+
+std::unique_ptr<RenderFence> D3D12RenderDevice::CreateFence(uint64_t initialValue)
+{
+    ComPtr<ID3D12Fence> fence;
+    ThrowIfFailed(_device->CreateFence(initialValue, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&fence)));
+    return std::unique_ptr<RenderFence>(new D3D12RenderFence(fence.Get()));
+}
+
+RenderHandle D3D12RenderDevice::CreateDescriptorHeap(RenderDescriptorType type, uint32_t count)
+{
+    D3D12_DESCRIPTOR_HEAP_DESC desc = {};
+    desc.NumDescriptors = count;
+    desc.Type = static_cast<D3D12_DESCRIPTOR_HEAP_TYPE>(type);
+    desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+
+    ComPtr<ID3D12DescriptorHeap> heap;
+    ThrowIfFailed(_device->CreateDescriptorHeap(&desc, IID_PPV_ARGS(&heap)));
+    _descriptorHeaps.push_back(heap);
+    return ToRenderHandle(heap.Get());
+}
+
+RenderDescriptor D3D12RenderDevice::GetDescriptorHeapStart(RenderHandle heap)
+{
+    return FromRenderHandle<ID3D12DescriptorHeap>(heap)->GetCPUDescriptorHandleForHeapStart().ptr;
+}
+
+uint32_t D3D12RenderDevice::GetDescriptorIncrement(RenderDescriptorType type)
+{
+    return _device->GetDescriptorHandleIncrementSize(static_cast<D3D12_DESCRIPTOR_HEAP_TYPE>(type));
+}
+
+void D3D12RenderDevice::CreateRenderTargetView(RenderHandle resource, RenderDescriptor destination)
+{
+    D3D12_CPU_DESCRIPTOR_HANDLE handle = { static_cast<SIZE_T>(destination) };
+    _device->CreateRenderTargetView(FromRenderHandle<ID3D12Resource>(resource), nullptr, handle);
+}
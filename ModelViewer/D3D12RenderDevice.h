@@ -0,0 +1,100 @@
+#pragma once
+
+#include "RenderDevice.h"
+#include "D3D12ResourceStates.h"
+
+using Microsoft::WRL::ComPtr;
+
+// D3D12 implementation of RenderDevice. Handles are the interface pointers.
+inline RenderHandle ToRenderHandle(IUnknown* pObject)
+{
+    return reinterpret_cast<RenderHandle>(pObject);
+}
+
+template <typename T>
+inline T* FromRenderHandle(RenderHandle handle)
+{
+    return reinterpret_cast<T*>(handle);
+}
+
+// Records into a D3D12 command list. The list and its allocator are reset together.
+class D3D12RenderCommandList : public RenderCommandList
+{
+public: D3D12RenderCommandList(ID3D12GraphicsCommandList* pCommandList, ID3D12CommandAllocator* pCommandAllocator);
+
+public: virtual void Reset(RenderHandle pipelineState);
+public: virtual void Close();
+
+public: virtual void ResourceBarriers(const TrackedBarrier* pBarriers, size_t count);
+
+public: virtual void SetPipelineState(RenderHandle pipelineState);
+public: virtual void SetGraphicsRootSignature(RenderHandle rootSignature);
+public: virtual void SetGraphicsRoot32BitConstants(uint32_t rootParameterIndex, uint32_t num32BitValues, const void* pData, uint32_t destOffsetIn32BitValues);
+public: virtual void SetGraphicsRootConstantBufferView(uint32_t rootParameterIndex, uint64_t address);
+public: virtual void SetGraphicsRootShaderResourceView(uint32_t rootParameterIndex, uint64_t address);
+
+public: virtual void SetViewport(const RenderViewport& viewport);
+public: virtual void SetScissorRect(const RenderRect& rect);
+public: virtual void SetRenderTarget(RenderDescriptor renderTarget, RenderDescriptor depthStencil);
+public: virtual void ClearRenderTarget(RenderDescriptor renderTarget, const float color[4]);
+public: virtual void ClearDepthStencil(RenderDescriptor depthStencil, float depth);
+
+public: virtual void SetPrimitiveTopology(uint32_t topology);
+public: virtual void SetVertexBuffer(uint32_t slot, uint64_t address, uint32_t size, uint32_t stride);
+public: virtual void SetIndexBuffer(uint64_t address, uint32_t size, uint32_t format);
+
+public: virtual void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t baseVertex, uint32_t firstInstance);
+public: virtual void ExecuteIndirect(RenderHandle commandSignature, uint32_t commandCount, RenderHandle argumentBuffer, uint64_t argumentOffset);
+
+public: ID3D12GraphicsCommandList* GetCommandList() const { return _commandList.Get(); }
+
+private: ComPtr<ID3D12GraphicsCommandList> _commandList;
+private: ComPtr<ID3D12CommandAllocator> _commandAllocator;
+private: std::vector<TrackedBarrier> _barriers;
+private: std::vector<D3D12_RESOURCE_BARRIER> _barrierScratch;
+};
+
+class D3D12RenderFence : public RenderFence
+{
+public: explicit D3D12RenderFence(ID3D12Fence* pFence);
+public: virtual ~D3D12RenderFence();
+
+public: virtual uint64_t GetCompletedValue();
+public: virtual void Wait(uint64_t value);
+
+public: ID3D12Fence* GetFence() const { return _fence.Get(); }
+
+private: ComPtr<ID3D12Fence> _fence;
+private: HANDLE _fenceEvent;
+};
+
+class D3D12RenderQueue : public RenderQueue
+{
+public: explicit D3D12RenderQueue(ID3D12CommandQueue* pCommandQueue);
+
+public: virtual void ExecuteCommandLists(RenderCommandList* const* ppCommandLists, size_t count);
+public: virtual void Signal(RenderFence& fence, uint64_t value);
+
+private: ComPtr<ID3D12CommandQueue> _commandQueue;
+private: std::vector<ID3D12CommandList*> _commandLists;
+};
+
+// Descriptor heaps created here are kept by the device.
+class D3D12RenderDevice : public RenderDevice
+{
+public: D3D12RenderDevice(ID3D12Device* pDevice, ID3D12CommandQueue* pCommandQueue);
+
+public: virtual RenderQueue& GetQueue() { return _queue; }
+
+public: virtual std::unique_ptr<RenderCommandList> CreateCommandList();
+public: virtual std::unique_ptr<RenderFence> CreateFence(uint64_t initialValue);
+
+public: virtual RenderHandle CreateDescriptorHeap(RenderDescriptorType type, uint32_t count);
+public: virtual RenderDescriptor GetDescriptorHeapStart(RenderHandle heap);
+public: virtual uint32_t GetDescriptorIncrement(RenderDescriptorType type);
+public: virtual void CreateRenderTargetView(RenderHandle resource, RenderDescriptor destination);
+
+private: ComPtr<ID3D12Device> _device;
+private: D3D12RenderQueue _queue;
+private: std::vector<ComPtr<ID3D12DescriptorHeap>> _descriptorHeaps;
+};
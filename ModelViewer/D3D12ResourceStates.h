@@ -0,0 +1,47 @@
+#pragma once
+
+#include "ResourceStateTracker.h"
+
+// Glue between ResourceStateTracker and D3D12: resources are tracked by their
+// ID3D12Resource pointer.
+inline TrackedResource ToTrackedResource(ID3D12Resource* pResource)
+{
+    return reinterpret_cast<TrackedResource>(pResource);
+}
+
+inline void RegisterTrackedResource(ResourceStateRegistry& registry, ID3D12Device* pDevice, ID3D12Resource* pResource, D3D12_RESOURCE_STATES initialState)
+{
+    const CD3DX12_RESOURCE_DESC desc(pResource->GetDesc());
+    const UINT subresourceCount = desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER ? 1 : desc.Subresources(pDevice);
+    registry.Register(ToTrackedResource(pResource), subresourceCount, initialState);
+}
+
+// Appends the barriers as D3D12 transitions, after what pOut already holds.
+inline void AppendTrackedBarriers(const std::vector<TrackedBarrier>& barriers, std::vector<D3D12_RESOURCE_BARRIER>* pOut)
+{
+    for (const TrackedBarrier& barrier : barriers)
+    {
+        pOut->push_back(CD3DX12_RESOURCE_BARRIER::Transition(
+            reinterpret_cast<ID3D12Resource*>(barrier.resource),
+            static_cast<D3D12_RESOURCE_STATES>(barrier.stateBefore),
+            static_cast<D3D12_RESOURCE_STATES>(barrier.stateAfter),
+            barrier.subresource == AllSubresources ? D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES : barrier.subresource,
+            static_cast<D3D12_RESOURCE_BARRIER_FLAGS>(barrier.flags)));
+    }
+}
+
+// Records the barriers in a single ResourceBarrier call. scratch is reused between calls.
+inline void RecordTrackedBarriers(
+    ID3D12GraphicsCommandList* pCommandList,
+    const std::vector<TrackedBarrier>& barriers,
+    std::vector<D3D12_RESOURCE_BARRIER>& scratch)
+{
+    if (barriers.empty())
+    {
+        return;
+    }
+
+    scratch.clear();
+    AppendTrackedBarriers(barriers, &scratch);
+    pCommandList->ResourceBarrier(static_cast<UINT>(scratch.size()), scratch.data());
+}
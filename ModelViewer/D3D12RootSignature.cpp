@@ -0,0 +1,175 @@
+#include "stdafx.h"
+#include "D3D12RootSignature.h"
+
+#include <cstddef>
+
+// RootSignatureSerializer.h mirrors the D3D12 descs member by member.
+static_assert(sizeof(RootDescriptorRange) == sizeof(D3D12_DESCRIPTOR_RANGE), "RootDescriptorRange layout");
+static_assert(sizeof(RootDescriptorRange1) == sizeof(D3D12_DESCRIPTOR_RANGE1), "RootDescriptorRange1 layout");
+static_assert(offsetof(RootDescriptorRange1, offsetInDescriptorsFromTableStart) == offsetof(D3D12_DESCRIPTOR_RANGE1, OffsetInDescriptorsFromTableStart), "RootDescriptorRange1 layout");
+static_assert(sizeof(RootParameter) == sizeof(D3D12_ROOT_PARAMETER), "RootParameter layout");
+static_assert(sizeof(RootParameter1) == sizeof(D3D12_ROOT_PARAMETER1), "RootParameter1 layout");
+static_assert(offsetof(RootParameter1, descriptorTable) == offsetof(D3D12_ROOT_PARAMETER1, DescriptorTable), "RootParameter1 layout");
+static_assert(offsetof(RootParameter1, shaderVisibility) == offsetof(D3D12_ROOT_PARAMETER1, ShaderVisibility), "RootParameter1 layout");
+static_assert(sizeof(RootStaticSampler) == sizeof(D3D12_STATIC_SAMPLER_DESC), "RootStaticSampler layout");
+static_assert(sizeof(RootSignatureDesc1) == sizeof(D3D12_ROOT_SIGNATURE_DESC1), "RootSignatureDesc1 layout");
+static_assert(offsetof(RootSignatureDesc1, flags) == offsetof(D3D12_ROOT_SIGNATURE_DESC1, Flags), "RootSignatureDesc1 layout");
+static_assert(sizeof(VersionedRootSignatureDesc) == sizeof(D3D12_VERSIONED_ROOT_SIGNATURE_DESC), "VersionedRootSignatureDesc layout");
+static_assert(offsetof(VersionedRootSignatureDesc, desc_1_1) == offsetof(D3D12_VERSIONED_ROOT_SIGNATURE_DESC, Desc_1_1), "VersionedRootSignatureDesc layout");
+
+namespace
+{
+    D3D12_DESCRIPTOR_RANGE_TYPE GetRangeType(BindingKind kind)
+    {
+        switch (kind)
+        {
+        case BindingKind::Constants:
+        case BindingKind::ConstantBuffer:
+            return D3D12_DESCRIPTOR_RANGE_TYPE_CBV;
+        case BindingKind::RWBuffer:
+        case BindingKind::RWTexture:
+            return D3D12_DESCRIPTOR_RANGE_TYPE_UAV;
+        case BindingKind::Sampler:
+            return D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER;
+        default:
+            return D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
+        }
+    }
+
+    bool SerializeD3D12RootSignature(const VersionedRootSignatureDesc& desc, std::vector<uint8_t>* pBlob, std::string* pError)
+    {
+        const D3D12_VERSIONED_ROOT_SIGNATURE_DESC& d3d12Desc = reinterpret_cast<const D3D12_VERSIONED_ROOT_SIGNATURE_DESC&>(desc);
+
+        ComPtr<ID3DBlob> signature;
+        ComPtr<ID3DBlob> error;
+        const HRESULT hr = d3d12Desc.Version == D3D_ROOT_SIGNATURE_VERSION_1_0
+            ? D3D12SerializeRootSignature(&d3d12Desc.Desc_1_0, D3D_ROOT_SIGNATURE_VERSION_1, signature.GetAddressOf(), error.GetAddressOf())
+            : D3D12SerializeVersionedRootSignature(&d3d12Desc, signature.GetAddressOf(), error.GetAddressOf());
+        if (FAILED(hr))
+        {
+            *pError = error ? static_cast<const char*>(error->GetBufferPointer()) : "Root signature serialization failed";
+            return false;
+        }
+
+        const uint8_t* pBytes = static_cast<const uint8_t*>(signature->GetBufferPointer());
+        pBlob->assign(pBytes, pBytes + signature->GetBufferSize());
+        return true;
+    }
+}
+
+D3D12RootSignatureCache::D3D12RootSignatureCache()
+{
+}
+
+void D3D12RootSignatureCache::Reset(ID3D12Device* pDevice)
+{
+    D3D12_FEATURE_DATA_ROOT_SIGNATURE featureData = {};
+    featureData.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_1;
+    if (FAILED(pDevice->CheckFeatureSupport(D3D12_FEATURE_ROOT_SIGNATURE, &featureData, sizeof(featureData))))
+    {
+        featureData.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_0;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _device = pDevice;
+    _serializer.reset(new RootSignatureSerializer(static_cast<RootSignatureVersion>(featureData.HighestVersion), SerializeD3D12RootSignature));
+    _rootSignatures.clear();
+}
+
+ComPtr<ID3D12RootSignature> D3D12RootSignatureCache::Create(const RootSignatureLayout& layout, D3D12_ROOT_SIGNATURE_FLAGS flags)
+{
+    // Ranges of all tables in one array; reserved up front so the pointers
+    // handed to the parameters stay valid.
+    size_t rangeCount = 0;
+    for (const RootParameterLayout& parameter : layout.parameters)
+    {
+        if (parameter.type == RootParameterType::DescriptorTable)
+        {
+            rangeCount += parameter.bindings.size();
+        }
+    }
+    std::vector<CD3DX12_DESCRIPTOR_RANGE1> ranges;
+    ranges.reserve(rangeCount);
+
+    std::vector<CD3DX12_ROOT_PARAMETER1> rootParameters(layout.parameters.size());
+    for (size_t p = 0; p < layout.parameters.size(); p++)
+    {
+        const RootParameterLayout& parameter = layout.parameters[p];
+        const BindingDecl& first = layout.bindings[parameter.bindings[0]];
+        const D3D12_SHADER_VISIBILITY visibility = static_cast<D3D12_SHADER_VISIBILITY>(parameter.visibility);
+        switch (parameter.type)
+        {
+        case RootParameterType::Constants:
+            rootParameters[p].InitAsConstants(parameter.num32BitValues, first.shaderRegister, first.registerSpace, visibility);
+            break;
+        case RootParameterType::ConstantBufferView:
+            rootParameters[p].InitAsConstantBufferView(first.shaderRegister, first.registerSpace, D3D12_ROOT_DESCRIPTOR_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE, visibility);
+            break;
+        case RootParameterType::ShaderResourceView:
+            rootParameters[p].InitAsShaderResourceView(first.shaderRegister, first.registerSpace, D3D12_ROOT_DESCRIPTOR_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE, visibility);
+            break;
+        case RootParameterType::UnorderedAccessView:
+            rootParameters[p].InitAsUnorderedAccessView(first.shaderRegister, first.registerSpace, D3D12_ROOT_DESCRIPTOR_FLAG_NONE, visibility);
+            break;
+        case RootParameterType::DescriptorTable:
+        {
+            const size_t firstRange = ranges.size();
+            for (size_t i = 0; i < parameter.bindings.size(); i++)
+            {
+                const uint32_t b = parameter.bindings[i];
+                const BindingDecl& binding = layout.bindings[b];
+                CD3DX12_DESCRIPTOR_RANGE1 range;
+                range.Init(
+                    GetRangeType(binding.kind),
+                    binding.descriptorCount,
+                    binding.shaderRegister,
+                    binding.registerSpace,
+                    D3D12_DESCRIPTOR_RANGE_FLAG_NONE,
+                    layout.bindingTableOffsets[b]);
+                ranges.push_back(range);
+            }
+            rootParameters[p].InitAsDescriptorTable(static_cast<UINT>(parameter.bindings.size()), ranges.data() + firstRange, visibility);
+            break;
+        }
+        }
+    }
+
+    CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDesc;
+    rootSignatureDesc.Init_1_1(
+        static_cast<UINT>(rootParameters.size()),
+        rootParameters.data(),
+        0u,
+        nullptr,
+        flags);
+    return Create(rootSignatureDesc);
+}
+
+ComPtr<ID3D12RootSignature> D3D12RootSignatureCache::Create(const D3D12_VERSIONED_ROOT_SIGNATURE_DESC& desc)
+{
+    RootSignatureBlob blob = Serialize(desc);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    ComPtr<ID3D12RootSignature>& rootSignature = _rootSignatures[blob.get()];
+    if (!rootSignature)
+    {
+        ThrowIfFailed(_device->CreateRootSignature(
+            0,
+            blob->data(),
+            blob->size(),
+            IID_PPV_ARGS(rootSignature.GetAddressOf())
+        ));
+    }
+    return rootSignature;
+}
+
+RootSignatureBlob D3D12RootSignatureCache::Serialize(const D3D12_VERSIONED_ROOT_SIGNATURE_DESC& desc)
+{
+    std::string error;
+    RootSignatureBlob blob = _serializer->Serialize(reinterpret_cast<const VersionedRootSignatureDesc&>(desc), &error);
+    if (!blob)
+    {
+        OutputDebugStringA(error.c_str());
+        ThrowIfFailed(E_INVALIDARG);
+    }
+    return blob;
+}
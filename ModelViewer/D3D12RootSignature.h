@@ -0,0 +1,35 @@
+#pragma once
+
+#include "RootSignatureLayout.h"
+#include "RootSignatureSerializer.h"
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+using Microsoft::WRL::ComPtr;
+
+// Creates root signatures through a RootSignatureSerializer, in place of
+// D3DX12SerializeVersionedRootSignature(): 1.1 descs are converted once when
+// the device only supports 1.0, each distinct desc is serialized once, and
+// the root signature created from a blob is handed out again for the same
+// blob.
+class D3D12RootSignatureCache
+{
+public: D3D12RootSignatureCache();
+
+    // Serializes for the highest root signature version pDevice supports.
+public: void Reset(ID3D12Device* pDevice);
+
+public: ComPtr<ID3D12RootSignature> Create(const RootSignatureLayout& layout, D3D12_ROOT_SIGNATURE_FLAGS flags);
+public: ComPtr<ID3D12RootSignature> Create(const D3D12_VERSIONED_ROOT_SIGNATURE_DESC& desc);
+
+public: RootSignatureBlob Serialize(const D3D12_VERSIONED_ROOT_SIGNATURE_DESC& desc);
+
+public: RootSignatureSerializerStats GetStats() const { return _serializer->GetStats(); }
+
+private: ComPtr<ID3D12Device> _device;
+private: std::unique_ptr<RootSignatureSerializer> _serializer;
+private: std::mutex _mutex;
+private: std::unordered_map<const std::vector<uint8_t>*, ComPtr<ID3D12RootSignature>> _rootSignatures;
+};
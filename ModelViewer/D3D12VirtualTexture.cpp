@@ -0,0 +1,225 @@
+#include "stdafx.h"
+#include "D3D12VirtualTexture.h"
+#include "D3D12MemoryTracking.h"
+
+namespace
+{
+    // Streaming asset ids of virtual texture pages: the tag, the texture in
+    // bits 32-47 and the page id in the low bits. Regular textures stay below.
+    const UINT64 VirtualTextureAssetTag = 1ull << 63;
+    UINT s_nextVirtualTexture = 0;
+}
+
+bool D3D12VirtualTexture::IsSupported(ID3D12Device* pDevice)
+{
+    D3D12_FEATURE_DATA_D3D12_OPTIONS options = {};
+    if (FAILED(pDevice->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &options, sizeof(options))))
+    {
+        return false;
+    }
+    return options.TiledResourcesTier != D3D12_TILED_RESOURCES_TIER_NOT_SUPPORTED;
+}
+
+D3D12VirtualTexture::D3D12VirtualTexture(
+    ID3D12Device* pDevice,
+    D3D12CopyQueue& copyQueue,
+    AssetStreamer& assetStreamer,
+    DXGI_FORMAT format,
+    UINT width,
+    UINT height,
+    UINT mipCount,
+    UINT poolTiles,
+    UINT feedbackEntries,
+    VirtualPageSource source,
+    ID3D12Fence* pDirectFence) :
+    _device(pDevice),
+    _copyQueue(copyQueue),
+    _assetStreamer(assetStreamer),
+    _source(std::move(source)),
+    _assetTag(VirtualTextureAssetTag | (static_cast<UINT64>(s_nextVirtualTexture++) << 32)),
+    _directFence(pDirectFence),
+    _lastFrameFenceValue(0),
+    _packedMipInfo(),
+    _tileShape(),
+    _feedbackEntries(feedbackEntries)
+{
+    // The copy queue only accepts resources in the COMMON state.
+    CD3DX12_RESOURCE_DESC desc = CD3DX12_RESOURCE_DESC::Tex2D(format, width, height, 1, static_cast<UINT16>(mipCount));
+    desc.Layout = D3D12_TEXTURE_LAYOUT_64KB_UNDEFINED_SWIZZLE;
+    ThrowIfFailed(_device->CreateReservedResource(&desc, D3D12_RESOURCE_STATE_COMMON, nullptr, IID_PPV_ARGS(&_resource)));
+    NAME_D3D12_OBJECT(_resource);
+
+    UINT tileCount = 0;
+    UINT subresourceTilingCount = 1;
+    D3D12_SUBRESOURCE_TILING topTiling = {};
+    _device->GetResourceTiling(_resource.Get(), &tileCount, &_packedMipInfo, &_tileShape, &subresourceTilingCount, 0, &topTiling);
+
+    const UINT heapTiles = poolTiles + _packedMipInfo.NumTilesForPackedMips;
+    const CD3DX12_HEAP_DESC heapDesc(
+        static_cast<UINT64>(heapTiles) * D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES,
+        D3D12_HEAP_TYPE_DEFAULT,
+        0,
+        D3D12_HEAP_FLAG_DENY_BUFFERS | D3D12_HEAP_FLAG_DENY_RT_DS_TEXTURES);
+    ThrowIfFailed(_device->CreateHeap(&heapDesc, IID_PPV_ARGS(&_heap)));
+    NAME_D3D12_OBJECT(_heap);
+    TrackD3D12Heap(_heap.Get(), MemoryCategory::Texture, "VirtualTextureTiles");
+
+    VirtualTextureDesc pageTableDesc = {};
+    pageTableDesc.widthInPages = topTiling.WidthInTiles;
+    pageTableDesc.heightInPages = topTiling.HeightInTiles;
+    pageTableDesc.mipCount = _packedMipInfo.NumStandardMips;
+    pageTableDesc.tileCount = poolTiles;
+    _pageTable.Reset(pageTableDesc);
+
+    // The packed tail sits after the pool and stays mapped for good.
+    if (_packedMipInfo.NumPackedMips > 0)
+    {
+        const CD3DX12_TILED_RESOURCE_COORDINATE coordinate(0, 0, 0, _packedMipInfo.NumStandardMips);
+        const CD3DX12_TILE_REGION_SIZE regionSize(_packedMipInfo.NumTilesForPackedMips, FALSE, 0, 0, 0);
+        const D3D12_TILE_RANGE_FLAGS rangeFlags = D3D12_TILE_RANGE_FLAG_NONE;
+        const UINT rangeStart = poolTiles;
+        const UINT rangeTiles = _packedMipInfo.NumTilesForPackedMips;
+        _copyQueue.GetCommandQueue()->UpdateTileMappings(
+            _resource.Get(), 1, &coordinate, &regionSize,
+            _heap.Get(), 1, &rangeFlags, &rangeStart, &rangeTiles,
+            D3D12_TILE_MAPPING_FLAG_NONE);
+    }
+
+    // Feedback: written by shaders, copied to the readback buffer every frame.
+    const UINT64 feedbackBytes = static_cast<UINT64>(_feedbackEntries) * sizeof(VirtualPageId);
+    const CD3DX12_HEAP_PROPERTIES defaultHeap(D3D12_HEAP_TYPE_DEFAULT);
+    const CD3DX12_RESOURCE_DESC feedbackDesc = CD3DX12_RESOURCE_DESC::Buffer(feedbackBytes, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+    ThrowIfFailed(_device->CreateCommittedResource(
+        &defaultHeap,
+        D3D12_HEAP_FLAG_NONE,
+        &feedbackDesc,
+        D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+        nullptr,
+        IID_PPV_ARGS(&_feedbackBuffer)));
+    NAME_D3D12_OBJECT(_feedbackBuffer);
+    TrackD3D12Resource(_device, _feedbackBuffer.Get(), MemoryCategory::Other, "VirtualTextureFeedback");
+
+    const CD3DX12_HEAP_PROPERTIES readbackHeap(D3D12_HEAP_TYPE_READBACK);
+    const CD3DX12_RESOURCE_DESC readbackDesc = CD3DX12_RESOURCE_DESC::Buffer(feedbackBytes);
+    ThrowIfFailed(_device->CreateCommittedResource(
+        &readbackHeap,
+        D3D12_HEAP_FLAG_NONE,
+        &readbackDesc,
+        D3D12_RESOURCE_STATE_COPY_DEST,
+        nullptr,
+        IID_PPV_ARGS(&_feedbackReadback)));
+    NAME_D3D12_OBJECT(_feedbackReadback);
+    TrackD3D12Resource(_device, _feedbackReadback.Get(), MemoryCategory::Upload, "VirtualTextureFeedbackReadback");
+}
+
+void D3D12VirtualTexture::RecordFeedbackReadback(ID3D12GraphicsCommandList* pCommandList)
+{
+    const CD3DX12_RESOURCE_BARRIER toCopy = CD3DX12_RESOURCE_BARRIER::Transition(_feedbackBuffer.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE);
+    pCommandList->ResourceBarrier(1, &toCopy);
+
+    pCommandList->CopyResource(_feedbackReadback.Get(), _feedbackBuffer.Get());
+
+    const CD3DX12_RESOURCE_BARRIER toUnorderedAccess = CD3DX12_RESOURCE_BARRIER::Transition(_feedbackBuffer.Get(), D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    pCommandList->ResourceBarrier(1, &toUnorderedAccess);
+}
+
+void D3D12VirtualTexture::Update(UINT maxNewPages, UINT64 lastFrameFenceValue)
+{
+    _lastFrameFenceValue = lastFrameFenceValue;
+
+    const CD3DX12_RANGE readRange(0, static_cast<SIZE_T>(_feedbackEntries) * sizeof(VirtualPageId));
+    const CD3DX12_RANGE writtenRange(0, 0);
+    VirtualPageId* pFeedback = nullptr;
+    ThrowIfFailed(_feedbackReadback->Map(0, &readRange, reinterpret_cast<void**>(&pFeedback)));
+    _pageTable.AddFeedback(pFeedback, _feedbackEntries);
+    _feedbackReadback->Unmap(0, &writtenRange);
+
+    _pageTable.Update(*this, maxNewPages);
+
+    const UINT64 tileBytes = D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES;
+    for (const PageLoad& load : _pageTable.GetLoads())
+    {
+        const VirtualPageId page = load.page;
+        const VirtualPageSource source = _source;
+        ID3D12Resource* pResource = _resource.Get();
+
+        StreamingRequest request;
+        request.assetId = _assetTag | page;
+        request.priority = static_cast<int>(GetVirtualPageMip(page));
+        request.stagingBytes = tileBytes;
+        request.stagingAlignment = D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT;
+        request.load = [source, page](UINT8* pStaging)
+        {
+            return source(page, pStaging);
+        };
+        request.record = [pResource, page](void* pCopyContext, UINT64 stagingOffset)
+        {
+            const D3D12CopyContext* pContext = static_cast<const D3D12CopyContext*>(pCopyContext);
+            CD3DX12_TILED_RESOURCE_COORDINATE coordinate(GetVirtualPageX(page), GetVirtualPageY(page), 0, GetVirtualPageMip(page));
+            CD3DX12_TILE_REGION_SIZE regionSize(1, FALSE, 0, 0, 0);
+            pContext->pCommandList->CopyTiles(
+                pResource,
+                &coordinate,
+                &regionSize,
+                pContext->pStagingBuffer,
+                stagingOffset,
+                D3D12_TILE_COPY_FLAG_LINEAR_BUFFER_TO_SWIZZLED_TILED_RESOURCE);
+        };
+
+        _assetStreamer.Request(std::move(request));
+    }
+}
+
+void D3D12VirtualTexture::OnAssetsStreamed()
+{
+    const UINT64 tagMask = 0xffffffff00000000ull;
+    for (UINT64 assetId : _assetStreamer.GetCompleted())
+    {
+        if ((assetId & tagMask) == _assetTag)
+        {
+            _pageTable.OnPageLoaded(static_cast<VirtualPageId>(assetId));
+        }
+    }
+    for (UINT64 assetId : _assetStreamer.GetFailed())
+    {
+        if ((assetId & tagMask) == _assetTag)
+        {
+            _pageTable.OnPageFailed(*this, static_cast<VirtualPageId>(assetId));
+        }
+    }
+}
+
+// Runs on the copy queue so the mapping lands before the CopyTiles filling it.
+// Unmapped tiles may still be sampled by frames in flight, which the queue
+// waits out first.
+void D3D12VirtualTexture::UpdateTileMappings(const TileMappingRegion* pRegions, size_t count)
+{
+    bool unmaps = false;
+    _coordinates.resize(count);
+    _regionSizes.resize(count);
+    _rangeFlags.resize(count);
+    _rangeStartOffsets.resize(count);
+    _rangeTileCounts.resize(count);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const TileMappingRegion& region = pRegions[i];
+        _coordinates[i] = CD3DX12_TILED_RESOURCE_COORDINATE(region.x, region.y, 0, region.mip);
+        _regionSizes[i] = CD3DX12_TILE_REGION_SIZE(region.width, TRUE, region.width, 1, 1);
+        _rangeFlags[i] = region.firstTile == NullTile ? D3D12_TILE_RANGE_FLAG_NULL : D3D12_TILE_RANGE_FLAG_NONE;
+        _rangeStartOffsets[i] = region.firstTile == NullTile ? 0 : region.firstTile;
+        _rangeTileCounts[i] = region.width;
+        unmaps = unmaps || region.firstTile == NullTile;
+    }
+
+    if (unmaps && _lastFrameFenceValue > _directFence->GetCompletedValue())
+    {
+        ThrowIfFailed(_copyQueue.GetCommandQueue()->Wait(_directFence.Get(), _lastFrameFenceValue));
+    }
+
+    const UINT regionCount = static_cast<UINT>(count);
+    _copyQueue.GetCommandQueue()->UpdateTileMappings(
+        _resource.Get(), regionCount, _coordinates.data(), _regionSizes.data(),
+        _heap.Get(), regionCount, _rangeFlags.data(), _rangeStartOffsets.data(), _rangeTileCounts.data(),
+        D3D12_TILE_MAPPING_FLAG_NONE);
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "D3D12CopyQueue.h"
+#include "VirtualTexture.h"
+
+using Microsoft::WRL::ComPtr;
+
+// Fills the texels of one page, row by row and tightly packed: the tile shape
+// of the format, as returned by GetTileWidth() and GetTileHeight().
+typedef std::function<bool(VirtualPageId page, UINT8* pTile)> VirtualPageSource;
+
+// A reserved texture backed by a fixed heap of 64KB tiles. The page table
+// decides the mappings; they are applied with UpdateTileMappings on the copy
+// queue, followed by CopyTiles of the page contents, so a page is mapped
+// before it is written. Pages are only reported resident once their copy
+// completed. Mips below the tile size (the packed tail) are mapped once at
+// creation and are the owner's to fill.
+//
+// Feedback comes from a UAV buffer of page ids that the shading pass writes in
+// full every frame (InvalidVirtualPage where nothing was sampled).
+//
+// Any frame submitted while a page was mapped may have sampled it, and
+// feedback reports that a few frames late, so the last frame to use an evicted
+// tile is the last frame submitted. Batches that unmap make the copy queue wait on
+// that frame's DIRECT queue fence value before remapping; the CopyTiles that
+// refill the tile come after on the same queue.
+class D3D12VirtualTexture : public TileMapper
+{
+public: static bool IsSupported(ID3D12Device* pDevice);
+
+public: D3D12VirtualTexture(
+    ID3D12Device* pDevice,
+    D3D12CopyQueue& copyQueue,
+    AssetStreamer& assetStreamer,
+    DXGI_FORMAT format,
+    UINT width,
+    UINT height,
+    UINT mipCount,
+    UINT poolTiles,
+    UINT feedbackEntries,
+    VirtualPageSource source,
+    ID3D12Fence* pDirectFence);
+
+    // Reads last frame's feedback, remaps pages and requests the missing ones.
+    // lastFrameFenceValue is what pDirectFence reaches once the last submitted
+    // frame completes.
+public: void Update(UINT maxNewPages, UINT64 lastFrameFenceValue);
+
+    // Call after AssetStreamer::Update().
+public: void OnAssetsStreamed();
+
+    // Copies this frame's feedback where the next Update() reads it. The
+    // feedback buffer is in the UNORDERED_ACCESS state outside this call.
+public: void RecordFeedbackReadback(ID3D12GraphicsCommandList* pCommandList);
+
+public: virtual void UpdateTileMappings(const TileMappingRegion* pRegions, size_t count);
+
+public: ID3D12Resource* GetResource() const { return _resource.Get(); }
+public: ID3D12Resource* GetFeedbackBuffer() const { return _feedbackBuffer.Get(); }
+public: const VirtualPageTable& GetPageTable() const { return _pageTable; }
+public: const D3D12_PACKED_MIP_INFO& GetPackedMipInfo() const { return _packedMipInfo; }
+public: UINT GetTileWidth() const { return _tileShape.WidthInTexels; }
+public: UINT GetTileHeight() const { return _tileShape.HeightInTexels; }
+
+private: ID3D12Device* _device;
+private: D3D12CopyQueue& _copyQueue;
+private: AssetStreamer& _assetStreamer;
+private: VirtualPageSource _source;
+private: UINT64 _assetTag;
+private: ComPtr<ID3D12Fence> _directFence;
+private: UINT64 _lastFrameFenceValue;
+
+private: ComPtr<ID3D12Resource> _resource;
+private: ComPtr<ID3D12Heap> _heap;
+private: D3D12_PACKED_MIP_INFO _packedMipInfo;
+private: D3D12_TILE_SHAPE _tileShape;
+private: VirtualPageTable _pageTable;
+
+private: UINT _feedbackEntries;
+private: ComPtr<ID3D12Resource> _feedbackBuffer;
+private: ComPtr<ID3D12Resource> _feedbackReadback;
+
+    // Scratch arrays for UpdateTileMappings, kept between calls.
+private: std::vector<D3D12_TILED_RESOURCE_COORDINATE> _coordinates;
+private: std::vector<D3D12_TILE_REGION_SIZE> _regionSizes;
+private: std::vector<D3D12_TILE_RANGE_FLAGS> _rangeFlags;
+private: std::vector<UINT> _rangeStartOffsets;
+private: std::vector<UINT> _rangeTileCounts;
+};
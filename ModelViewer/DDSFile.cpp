@@ -0,0 +1,321 @@
+#include "DDSFile.h"
+
+#include <cstring>
+
+namespace
+{
+    const uint32_t DDS_MAGIC = 0x20534444;  // "DDS "
+
+    const uint32_t DDSD_CAPS = 0x1;
+    const uint32_t DDSD_HEIGHT = 0x2;
+    const uint32_t DDSD_WIDTH = 0x4;
+    const uint32_t DDSD_PITCH = 0x8;
+    const uint32_t DDSD_PIXELFORMAT = 0x1000;
+    const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+    const uint32_t DDSD_LINEARSIZE = 0x80000;
+
+    const uint32_t DDPF_ALPHAPIXELS = 0x1;
+    const uint32_t DDPF_FOURCC = 0x4;
+    const uint32_t DDPF_RGB = 0x40;
+    const uint32_t DDSCAPS_COMPLEX = 0x8;
+    const uint32_t DDSCAPS_TEXTURE = 0x1000;
+    const uint32_t DDSCAPS_MIPMAP = 0x400000;
+    const uint32_t DDSCAPS2_CUBEMAP = 0x200;
+    const uint32_t DDSCAPS2_CUBEMAP_ALLFACES = 0xfc00;
+    const uint32_t DDS_DIMENSION_TEXTURE2D = 3;
+    const uint32_t DDS_RESOURCE_MISC_TEXTURECUBE = 0x4;
+
+    // D3D12_REQ_TEXTURE2D_U_OR_V_DIMENSION and D3D12_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION.
+    // Within them the subresource layout cannot overflow.
+    const uint32_t MaxDimension = 16384;
+    const uint32_t MaxArraySize = 2048;
+
+    inline uint32_t MakeFourCC(char a, char b, char c, char d)
+    {
+        return static_cast<uint32_t>(a) | (static_cast<uint32_t>(b) << 8) | (static_cast<uint32_t>(c) << 16) | (static_cast<uint32_t>(d) << 24);
+    }
+
+    // Mips down to 1x1: 1 + log2(max(width, height)).
+    uint32_t GetFullMipCount(uint32_t width, uint32_t height)
+    {
+        uint32_t size = width > height ? width : height;
+        uint32_t count = 1;
+        while (size > 1)
+        {
+            size >>= 1;
+            count++;
+        }
+        return count;
+    }
+
+    struct DDS_PIXELFORMAT
+    {
+        uint32_t size;
+        uint32_t flags;
+        uint32_t fourCC;
+        uint32_t rgbBitCount;
+        uint32_t rBitMask;
+        uint32_t gBitMask;
+        uint32_t bBitMask;
+        uint32_t aBitMask;
+    };
+
+    struct DDS_HEADER
+    {
+        uint32_t size;
+        uint32_t flags;
+        uint32_t height;
+        uint32_t width;
+        uint32_t pitchOrLinearSize;
+        uint32_t depth;
+        uint32_t mipMapCount;
+        uint32_t reserved1[11];
+        DDS_PIXELFORMAT ddsPixelFormat;
+        uint32_t caps;
+        uint32_t caps2;
+        uint32_t caps3;
+        uint32_t caps4;
+        uint32_t reserved2;
+    };
+
+    struct DDS_HEADER_DXT10
+    {
+        uint32_t dxgiFormat;
+        uint32_t resourceDimension;
+        uint32_t miscFlag;
+        uint32_t arraySize;
+        uint32_t miscFlags2;
+    };
+
+    uint32_t GetLegacyFormat(const DDS_PIXELFORMAT& pf)
+    {
+        if (pf.flags & DDPF_FOURCC)
+        {
+            if (pf.fourCC == MakeFourCC('D', 'X', 'T', '1')) return DDSFormat::BC1_UNORM;
+            if (pf.fourCC == MakeFourCC('D', 'X', 'T', '5')) return DDSFormat::BC3_UNORM;
+            if (pf.fourCC == MakeFourCC('A', 'T', 'I', '1') || pf.fourCC == MakeFourCC('B', 'C', '4', 'U')) return DDSFormat::BC4_UNORM;
+            if (pf.fourCC == MakeFourCC('A', 'T', 'I', '2') || pf.fourCC == MakeFourCC('B', 'C', '5', 'U')) return DDSFormat::BC5_UNORM;
+            return 0;
+        }
+
+        if ((pf.flags & DDPF_RGB) && pf.rgbBitCount == 32)
+        {
+            if (pf.rBitMask == 0x000000ff && pf.gBitMask == 0x0000ff00 && pf.bBitMask == 0x00ff0000) return DDSFormat::R8G8B8A8_UNORM;
+            if (pf.rBitMask == 0x00ff0000 && pf.gBitMask == 0x0000ff00 && pf.bBitMask == 0x000000ff && (pf.flags & DDPF_ALPHAPIXELS)) return DDSFormat::B8G8R8A8_UNORM;
+        }
+        return 0;
+    }
+}
+
+uint32_t GetDDSFormatBytes(uint32_t format, bool* pBlockCompressed)
+{
+    *pBlockCompressed = false;
+    switch (format)
+    {
+    case DDSFormat::R32G32B32A32_FLOAT:
+        return 16;
+    case DDSFormat::R16G16B16A16_FLOAT:
+        return 8;
+    case DDSFormat::R8G8B8A8_UNORM:
+    case DDSFormat::R8G8B8A8_UNORM_SRGB:
+    case DDSFormat::B8G8R8A8_UNORM:
+    case DDSFormat::B8G8R8A8_UNORM_SRGB:
+        return 4;
+    case DDSFormat::R8_UNORM:
+        return 1;
+    case DDSFormat::BC1_UNORM:
+    case DDSFormat::BC1_UNORM_SRGB:
+    case DDSFormat::BC4_UNORM:
+    case DDSFormat::BC4_SNORM:
+        *pBlockCompressed = true;
+        return 8;
+    case DDSFormat::BC3_UNORM:
+    case DDSFormat::BC3_UNORM_SRGB:
+    case DDSFormat::BC5_UNORM:
+    case DDSFormat::BC5_SNORM:
+    case DDSFormat::BC7_UNORM:
+    case DDSFormat::BC7_UNORM_SRGB:
+        *pBlockCompressed = true;
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+bool ReadDDSHeader(const uint8_t* pData, size_t size, DDSTextureInfo* pInfo)
+{
+    if (size < sizeof(uint32_t) + sizeof(DDS_HEADER))
+    {
+        return false;
+    }
+
+    uint32_t magic;
+    memcpy(&magic, pData, sizeof(magic));
+    if (magic != DDS_MAGIC)
+    {
+        return false;
+    }
+
+    DDS_HEADER header;
+    memcpy(&header, pData + sizeof(uint32_t), sizeof(header));
+    if (header.size != sizeof(DDS_HEADER) || header.ddsPixelFormat.size != sizeof(DDS_PIXELFORMAT))
+    {
+        return false;
+    }
+
+    DDSTextureInfo info = {};
+    info.width = header.width;
+    info.height = header.height;
+    info.depth = 1;
+    info.mipCount = header.mipMapCount == 0 ? 1 : header.mipMapCount;
+    info.arraySize = 1;
+    info.dataOffset = sizeof(uint32_t) + sizeof(DDS_HEADER);
+
+    if ((header.ddsPixelFormat.flags & DDPF_FOURCC) && header.ddsPixelFormat.fourCC == MakeFourCC('D', 'X', '1', '0'))
+    {
+        if (size < info.dataOffset + sizeof(DDS_HEADER_DXT10))
+        {
+            return false;
+        }
+
+        DDS_HEADER_DXT10 header10;
+        memcpy(&header10, pData + info.dataOffset, sizeof(header10));
+        info.dataOffset += sizeof(DDS_HEADER_DXT10);
+        info.format = header10.dxgiFormat;
+        info.arraySize = header10.arraySize == 0 ? 1 : header10.arraySize;
+        info.isCubeMap = (header10.miscFlag & DDS_RESOURCE_MISC_TEXTURECUBE) != 0;
+    }
+    else
+    {
+        info.format = GetLegacyFormat(header.ddsPixelFormat);
+        info.isCubeMap = (header.caps2 & DDSCAPS2_CUBEMAP) != 0;
+    }
+
+    // Sizes the layout math and a texture description cannot take.
+    if (info.width == 0 || info.height == 0 || info.width > MaxDimension || info.height > MaxDimension)
+    {
+        return false;
+    }
+    if (info.mipCount > GetFullMipCount(info.width, info.height))
+    {
+        return false;
+    }
+    if (info.arraySize > (info.isCubeMap ? MaxArraySize / 6 : MaxArraySize))
+    {
+        return false;
+    }
+
+    if (info.isCubeMap)
+    {
+        info.arraySize *= 6;
+    }
+
+    bool blockCompressed;
+    if (info.format == 0 || GetDDSFormatBytes(info.format, &blockCompressed) == 0)
+    {
+        return false;
+    }
+
+    // Reject files whose header promises more data than there is.
+    const DDSSubresourceLayout last = GetDDSSubresourceLayout(info, info.mipCount - 1, info.arraySize - 1);
+    if (last.offset + last.size > size)
+    {
+        return false;
+    }
+
+    *pInfo = info;
+    return true;
+}
+
+DDSSubresourceLayout GetDDSSubresourceLayout(const DDSTextureInfo& info, uint32_t mip, uint32_t arraySlice)
+{
+    bool blockCompressed;
+    const uint32_t formatBytes = GetDDSFormatBytes(info.format, &blockCompressed);
+
+    size_t offset = info.dataOffset;
+    size_t sliceSize = 0;
+    DDSSubresourceLayout layout = {};
+
+    for (uint32_t m = 0; m < info.mipCount; m++)
+    {
+        const uint32_t width = info.width >> m ? info.width >> m : 1;
+        const uint32_t height = info.height >> m ? info.height >> m : 1;
+        const uint32_t rowPitch = blockCompressed ? ((width + 3) / 4) * formatBytes : width * formatBytes;
+        const uint32_t rowCount = blockCompressed ? (height + 3) / 4 : height;
+        const size_t mipSize = static_cast<size_t>(rowPitch) * rowCount;
+
+        if (m == mip)
+        {
+            layout.offset = sliceSize;
+            layout.size = mipSize;
+            layout.width = width;
+            layout.height = height;
+            layout.rowPitch = rowPitch;
+            layout.rowCount = rowCount;
+        }
+        sliceSize += mipSize;
+    }
+
+    layout.offset += offset + sliceSize * arraySlice;
+    return layout;
+}
+
+size_t GetDDSMipSize(const DDSTextureInfo& info, uint32_t mip)
+{
+    return GetDDSSubresourceLayout(info, mip, 0).size * info.arraySize;
+}
+
+void WriteDDSHeader(const DDSTextureInfo& info, std::vector<uint8_t>* pOut)
+{
+    bool blockCompressed;
+    const uint32_t formatBytes = GetDDSFormatBytes(info.format, &blockCompressed);
+
+    DDS_HEADER header = {};
+    header.size = sizeof(DDS_HEADER);
+    header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT;
+    header.height = info.height;
+    header.width = info.width;
+    header.depth = 1;
+    header.mipMapCount = info.mipCount;
+    header.ddsPixelFormat.size = sizeof(DDS_PIXELFORMAT);
+    header.ddsPixelFormat.flags = DDPF_FOURCC;
+    header.ddsPixelFormat.fourCC = MakeFourCC('D', 'X', '1', '0');
+    header.caps = DDSCAPS_TEXTURE;
+
+    // Pitch of the top mip for uncompressed formats, its whole size for block
+    // compressed ones.
+    if (blockCompressed)
+    {
+        header.flags |= DDSD_LINEARSIZE;
+        header.pitchOrLinearSize = ((info.width + 3) / 4) * ((info.height + 3) / 4) * formatBytes;
+    }
+    else
+    {
+        header.flags |= DDSD_PITCH;
+        header.pitchOrLinearSize = info.width * formatBytes;
+    }
+
+    if (info.mipCount > 1)
+    {
+        header.caps |= DDSCAPS_MIPMAP | DDSCAPS_COMPLEX;
+    }
+
+    DDS_HEADER_DXT10 header10 = {};
+    header10.dxgiFormat = info.format;
+    header10.resourceDimension = DDS_DIMENSION_TEXTURE2D;
+    header10.arraySize = info.arraySize;
+    if (info.isCubeMap)
+    {
+        header.caps |= DDSCAPS_COMPLEX;
+        header.caps2 = DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_ALLFACES;
+        header10.miscFlag = DDS_RESOURCE_MISC_TEXTURECUBE;
+        header10.arraySize = info.arraySize / 6;
+    }
+
+    const size_t begin = pOut->size();
+    pOut->resize(begin + sizeof(uint32_t) + sizeof(DDS_HEADER) + sizeof(DDS_HEADER_DXT10));
+    uint8_t* pData = pOut->data() + begin;
+    memcpy(pData, &DDS_MAGIC, sizeof(uint32_t));
+    memcpy(pData + sizeof(uint32_t), &header, sizeof(header));
+    memcpy(pData + sizeof(uint32_t) + sizeof(header), &header10, sizeof(header10));
+}
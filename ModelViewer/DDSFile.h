@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// DXGI_FORMAT values the DDS helpers understand. Kept numeric so the parsing
+// code does not need dxgiformat.h.
+namespace DDSFormat
+{
+    static const uint32_t R32G32B32A32_FLOAT = 2;
+    static const uint32_t R16G16B16A16_FLOAT = 10;
+    static const uint32_t R8G8B8A8_UNORM = 28;
+    static const uint32_t R8G8B8A8_UNORM_SRGB = 29;
+    static const uint32_t R8_UNORM = 61;
+    static const uint32_t BC1_UNORM = 71;
+    static const uint32_t BC1_UNORM_SRGB = 72;
+    static const uint32_t BC3_UNORM = 77;
+    static const uint32_t BC3_UNORM_SRGB = 78;
+    static const uint32_t BC4_UNORM = 80;
+    static const uint32_t BC4_SNORM = 81;
+    static const uint32_t BC5_UNORM = 83;
+    static const uint32_t BC5_SNORM = 84;
+    static const uint32_t B8G8R8A8_UNORM = 87;
+    static const uint32_t B8G8R8A8_UNORM_SRGB = 91;
+    static const uint32_t BC7_UNORM = 98;
+    static const uint32_t BC7_UNORM_SRGB = 99;
+}
+
+struct DDSTextureInfo
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t depth;
+    uint32_t mipCount;
+    uint32_t arraySize;     // Six faces per cube for cube maps.
+    uint32_t format;        // DXGI_FORMAT.
+    bool isCubeMap;
+    size_t dataOffset;      // Start of the first subresource in the file.
+};
+
+struct DDSSubresourceLayout
+{
+    size_t offset;          // From the start of the file.
+    size_t size;
+    uint32_t width;
+    uint32_t height;
+    uint32_t rowPitch;      // Bytes per row of pixels, or per row of blocks for BC formats.
+    uint32_t rowCount;
+};
+
+// Bytes per pixel, or per 4x4 block when pBlockCompressed is set. Returns 0 for
+// formats the helpers do not handle.
+uint32_t GetDDSFormatBytes(uint32_t format, bool* pBlockCompressed);
+
+// Parses the DDS and optional DX10 header of 2D textures, texture arrays and
+// cube maps. Returns false for files that are not DDS, use a format the
+// helpers do not handle, have sizes past D3D12's limits or more mips than the
+// chain down to 1x1, or are shorter than their header says.
+bool ReadDDSHeader(const uint8_t* pData, size_t size, DDSTextureInfo* pInfo);
+
+// Subresources are stored slice by slice, each slice holding its whole mip chain.
+DDSSubresourceLayout GetDDSSubresourceLayout(const DDSTextureInfo& info, uint32_t mip, uint32_t arraySlice);
+
+// Size of one mip level summed over all array slices.
+size_t GetDDSMipSize(const DDSTextureInfo& info, uint32_t mip);
+
+// Appends the magic, DDS header and DX10 header describing info to pOut; the
+// subresources follow in the order GetDDSSubresourceLayout() expects. The
+// dataOffset and depth of info are ignored.
+void WriteDDSHeader(const DDSTextureInfo& info, std::vector<uint8_t>* pOut);
@@ -0,0 +1,160 @@
+#include "DDSFile.h"
+#include "UnitTest.h"
+
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    // Where WriteDDSHeader() puts the fields the tests corrupt: after the
+    // magic, the DDS header, then the DX10 header.
+    const size_t HeightOffset = 4 + 8;
+    const size_t WidthOffset = 4 + 12;
+    const size_t MipCountOffset = 4 + 24;
+    const size_t ArraySizeOffset = 4 + 124 + 12;
+
+    DDSTextureInfo MakeInfo(uint32_t width, uint32_t height, uint32_t mipCount, uint32_t arraySize, bool isCubeMap)
+    {
+        DDSTextureInfo info = {};
+        info.width = width;
+        info.height = height;
+        info.depth = 1;
+        info.mipCount = mipCount;
+        info.arraySize = arraySize;
+        info.format = DDSFormat::BC1_UNORM;
+        info.isCubeMap = isCubeMap;
+        return info;
+    }
+
+    // A whole file: the header and zeroed subresources.
+    std::vector<uint8_t> MakeFile(const DDSTextureInfo& info)
+    {
+        std::vector<uint8_t> file;
+        WriteDDSHeader(info, &file);
+        size_t dataBytes = 0;
+        for (uint32_t mip = 0; mip < info.mipCount; mip++)
+        {
+            dataBytes += GetDDSMipSize(info, mip);
+        }
+        file.resize(file.size() + dataBytes);
+        return file;
+    }
+
+    void SetField(std::vector<uint8_t>* pFile, size_t offset, uint32_t value)
+    {
+        memcpy(pFile->data() + offset, &value, sizeof(value));
+    }
+
+    bool Read(const std::vector<uint8_t>& file, DDSTextureInfo* pInfo)
+    {
+        return ReadDDSHeader(file.data(), file.size(), pInfo);
+    }
+
+    void TestRoundTrip()
+    {
+        const std::vector<uint8_t> file = MakeFile(MakeInfo(256, 64, 9, 3, false));
+        DDSTextureInfo info;
+        CHECK(Read(file, &info));
+        CHECK(info.width == 256);
+        CHECK(info.height == 64);
+        CHECK(info.mipCount == 9);
+        CHECK(info.arraySize == 3);
+        CHECK(info.format == DDSFormat::BC1_UNORM);
+        CHECK(!info.isCubeMap);
+
+        // Block compressed mips round up to whole 4x4 blocks.
+        const DDSSubresourceLayout last = GetDDSSubresourceLayout(info, 8, 2);
+        CHECK(last.width == 1);
+        CHECK(last.height == 1);
+        CHECK(last.rowPitch == 8);
+        CHECK(last.rowCount == 1);
+        CHECK(last.offset + last.size == file.size());
+
+        DDSTextureInfo cube;
+        CHECK(Read(MakeFile(MakeInfo(64, 64, 7, 6, true)), &cube));
+        CHECK(cube.isCubeMap);
+        CHECK(cube.arraySize == 6);
+    }
+
+    void TestTruncated()
+    {
+        std::vector<uint8_t> file = MakeFile(MakeInfo(64, 64, 7, 1, false));
+        file.pop_back();
+        DDSTextureInfo info;
+        CHECK(!Read(file, &info));
+        file.resize(16);
+        CHECK(!Read(file, &info));
+    }
+
+    void TestZeroSize()
+    {
+        DDSTextureInfo info;
+        std::vector<uint8_t> file = MakeFile(MakeInfo(64, 64, 1, 1, false));
+        SetField(&file, WidthOffset, 0);
+        CHECK(!Read(file, &info));
+
+        file = MakeFile(MakeInfo(64, 64, 1, 1, false));
+        SetField(&file, HeightOffset, 0);
+        CHECK(!Read(file, &info));
+
+        file = MakeFile(MakeInfo(64, 64, 1, 1, false));
+        SetField(&file, WidthOffset, 0x80000000);
+        CHECK(!Read(file, &info));
+    }
+
+    // 1 + log2(max(width, height)) mips at most: 64x16 has 7.
+    void TestMipCount()
+    {
+        DDSTextureInfo info;
+        CHECK(Read(MakeFile(MakeInfo(64, 16, 7, 1, false)), &info));
+
+        std::vector<uint8_t> file = MakeFile(MakeInfo(64, 16, 7, 1, false));
+        SetField(&file, MipCountOffset, 8);
+        file.resize(file.size() + 1024);
+        CHECK(!Read(file, &info));
+
+        file = MakeFile(MakeInfo(64, 16, 7, 1, false));
+        SetField(&file, MipCountOffset, 0xffffffff);
+        CHECK(!Read(file, &info));
+
+        // A zero count means the top mip only.
+        file = MakeFile(MakeInfo(64, 16, 1, 1, false));
+        SetField(&file, MipCountOffset, 0);
+        CHECK(Read(file, &info));
+        CHECK(info.mipCount == 1);
+    }
+
+    // The DX10 header counts cubes; six faces each must still be a valid
+    // array size, and must not wrap around.
+    void TestArraySize()
+    {
+        DDSTextureInfo info;
+        std::vector<uint8_t> file = MakeFile(MakeInfo(4, 4, 1, 6, true));
+        SetField(&file, ArraySizeOffset, 0x2aaaaaab);  // Times six wraps to 2.
+        CHECK(!Read(file, &info));
+
+        file = MakeFile(MakeInfo(4, 4, 1, 6, true));
+        SetField(&file, ArraySizeOffset, 342);
+        file.resize(file.size() + 342 * 6 * 8);
+        CHECK(!Read(file, &info));
+
+        file = MakeFile(MakeInfo(4, 4, 1, 1, false));
+        SetField(&file, ArraySizeOffset, 4096);
+        file.resize(file.size() + 4096 * 8);
+        CHECK(!Read(file, &info));
+
+        file = MakeFile(MakeInfo(4, 4, 1, 2048, false));
+        CHECK(Read(file, &info));
+        CHECK(info.arraySize == 2048);
+    }
+}
+
+int main()
+{
+    TestRoundTrip();
+    TestTruncated();
+    TestZeroSize();
+    TestMipCount();
+    TestArraySize();
+    return TestFailures();
+}
@@ -24,6 +24,8 @@ DXSample::DXSample(UINT width, UINT height, std::wstring name) :
     _assetsPath = assetsPath;
 
     _aspectRatio = static_cast<float>(width) / static_cast<float>(height);
+    _runtimeShaderCompilation = false;
+    _lowLatencyPresentation = false;
 }
 
 DXSample::~DXSample()
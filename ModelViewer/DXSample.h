@@ -11,6 +11,7 @@
 
 #pragma once
 
+#include "Benchmark.h"
 #include "DXSampleHelper.h"
 #include "Win64Application.h"
 
@@ -25,15 +26,36 @@ public:
     virtual void OnRender() = 0;
     virtual void OnDestroy() = 0;
 
+    // Called at a fixed rate, zero or more times per frame before OnUpdate().
+    // Samples that simulate something override it.
+    virtual void OnFixedUpdate(double /*stepSeconds*/) {}
+
     // Samples override the event handlers to handle specific messages.
     virtual void OnKeyDown(UINT8 /*key*/) {}
     virtual void OnKeyUp(UINT8 /*key*/) {}
 
+    // Called by the main loop before it reads the input of a frame; samples
+    // pacing their frames to the display block here.
+    virtual void WaitForFrameStart() {}
+
+    // Benchmark mode (-benchmark on the command line): samples that support
+    // it load the scripted scene and hand out the profile events of a frame.
+    virtual void OnBenchmarkScene(const BenchmarkScript& /*script*/) {}
+    virtual void CollectProfileEvents(std::vector<ProfileEvent>* /*pEvents*/) {}
+
     // Accessors.
     UINT GetWidth() const { return _width; }
     UINT GetHeight() const { return _height; }
     const WCHAR* GetTitle() const { return _title.c_str(); }
 
+    // Set before OnInit() (-runtime_shaders on the command line): compile
+    // shaders from source even when the build embedded their bytecode.
+    void SetRuntimeShaderCompilation(bool runtime) { _runtimeShaderCompilation = runtime; }
+
+    // Set before OnInit() (-low_latency on the command line): keep at most
+    // one frame queued for presentation and start frames as late as they can.
+    void SetLowLatencyPresentation(bool lowLatency) { _lowLatencyPresentation = lowLatency; }
+
 protected:
     std::wstring GetAssetFullPath(LPCWSTR assetName);
 
@@ -48,6 +70,8 @@ protected:
     UINT _width;
     UINT _height;
     float _aspectRatio;
+    bool _runtimeShaderCompilation;
+    bool _lowLatencyPresentation;
 
 private:
     // Root assets path.
@@ -0,0 +1,201 @@
+#include "DepthPass.h"
+#include "ShaderConstants.h"
+
+#include <algorithm>
+#include <cmath>
+
+void MakeReverseZPerspective(float fovYRadians, float aspectRatio, float nearZ, float projection[16])
+{
+    // The standard projection maps z to (z - n) f / ((f - n) z); swapping
+    // near and far and letting far go to infinity leaves n / z.
+    const float height = 1.0f / std::tan(fovYRadians * 0.5f);
+    const float width = height / aspectRatio;
+    const float matrix[16] =
+    {
+        width, 0.0f, 0.0f, 0.0f,
+        0.0f, height, 0.0f, 0.0f,
+        0.0f, 0.0f, 0.0f, 1.0f,
+        0.0f, 0.0f, nearZ, 0.0f,
+    };
+    for (int i = 0; i < 16; i++)
+    {
+        projection[i] = matrix[i];
+    }
+}
+
+DepthPrepassMode GetDefaultDepthPrepassMode(ShaderFeatureMask features)
+{
+    return (features & SceneFeatureAlphaTest) != 0 ? DepthPrepassMode::Off : DepthPrepassMode::On;
+}
+
+void SelectDepthPrepassPipelines(const DepthPrepassMode* pModes, size_t count, RenderHandle prepassPipeline, RenderHandle* pPipelines)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        pPipelines[i] = pModes[i] == DepthPrepassMode::On ? prepassPipeline : 0;
+    }
+}
+
+void RecordDepthPrepass(
+    RenderCommandList& commandList,
+    RenderDescriptor depthStencil,
+    const DrawBatch* pBatches,
+    size_t batchCount,
+    const IndirectMeshBinding* pPositionMeshes,
+    const RenderHandle* pPrepassPipelines,
+    const BatchRootBindings& bindings)
+{
+    commandList.SetRenderTarget(0, depthStencil);
+    RecordBatchDraws(commandList, pBatches, batchCount, pPositionMeshes, pPrepassPipelines, bindings);
+}
+
+namespace
+{
+    struct ScreenVertex
+    {
+        float x;
+        float y;
+        float depth;
+    };
+
+    bool PassesDepthTest(DepthComparison comparison, float depth, float stored)
+    {
+        switch (comparison)
+        {
+        case DepthComparison::Never: return false;
+        case DepthComparison::Less: return depth < stored;
+        case DepthComparison::Equal: return depth == stored;
+        case DepthComparison::LessEqual: return depth <= stored;
+        case DepthComparison::Greater: return depth > stored;
+        case DepthComparison::NotEqual: return depth != stored;
+        case DepthComparison::GreaterEqual: return depth >= stored;
+        case DepthComparison::Always: return true;
+        }
+        return false;
+    }
+
+    // Samples on the edge belong to the triangle when the edge is a top or a
+    // left one. Edges run clockwise on screen here, y down.
+    bool IsTopLeftEdge(const ScreenVertex& from, const ScreenVertex& to)
+    {
+        const float dx = to.x - from.x;
+        const float dy = to.y - from.y;
+        return (dy == 0.0f && dx > 0.0f) || dy < 0.0f;
+    }
+
+    bool IsInside(float edge, bool topLeft)
+    {
+        return edge > 0.0f || (edge == 0.0f && topLeft);
+    }
+}
+
+DepthRasterizer::DepthRasterizer(uint32_t width, uint32_t height) :
+    _width(width),
+    _height(height),
+    _depth(static_cast<size_t>(width) * height, DepthClearValue)
+{
+}
+
+void DepthRasterizer::Clear()
+{
+    std::fill(_depth.begin(), _depth.end(), DepthClearValue);
+}
+
+uint64_t DepthRasterizer::Draw(const float* pPositions, const uint32_t* pIndices, size_t indexCount, const float transform[16], DepthComparison comparison)
+{
+    uint64_t passed = 0;
+    for (size_t i = 0; i + 3 <= indexCount; i += 3)
+    {
+        ScreenVertex vertices[3];
+        bool clipped = false;
+        for (int v = 0; v < 3; v++)
+        {
+            const float* pPosition = pPositions + static_cast<size_t>(pIndices[i + v]) * 3;
+            float clip[4];
+            for (int c = 0; c < 4; c++)
+            {
+                clip[c] = pPosition[0] * transform[c] + pPosition[1] * transform[4 + c] + pPosition[2] * transform[8 + c] + transform[12 + c];
+            }
+
+            // Reverse-Z: the near plane is at z == w.
+            if (clip[3] <= 0.0f || clip[2] > clip[3])
+            {
+                clipped = true;
+                break;
+            }
+            vertices[v].x = (clip[0] / clip[3] + 1.0f) * 0.5f * _width;
+            vertices[v].y = (1.0f - clip[1] / clip[3]) * 0.5f * _height;
+            vertices[v].depth = clip[2] / clip[3];
+        }
+        if (clipped)
+        {
+            continue;
+        }
+
+        const ScreenVertex& a = vertices[0];
+        const ScreenVertex& b = vertices[1];
+        const ScreenVertex& c = vertices[2];
+        const float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+        if (!(area > 0.0f))
+        {
+            continue;
+        }
+
+        const float minX = std::max(std::min(std::min(a.x, b.x), c.x), 0.0f);
+        const float maxX = std::min(std::max(std::max(a.x, b.x), c.x), static_cast<float>(_width));
+        const float minY = std::max(std::min(std::min(a.y, b.y), c.y), 0.0f);
+        const float maxY = std::min(std::max(std::max(a.y, b.y), c.y), static_cast<float>(_height));
+        if (minX >= maxX || minY >= maxY)
+        {
+            continue;
+        }
+
+        const bool topLeftA = IsTopLeftEdge(b, c);
+        const bool topLeftB = IsTopLeftEdge(c, a);
+        const bool topLeftC = IsTopLeftEdge(a, b);
+        const uint32_t beginX = static_cast<uint32_t>(minX);
+        const uint32_t endX = std::min(static_cast<uint32_t>(maxX) + 1, _width);
+        const uint32_t beginY = static_cast<uint32_t>(minY);
+        const uint32_t endY = std::min(static_cast<uint32_t>(maxY) + 1, _height);
+        for (uint32_t y = beginY; y < endY; y++)
+        {
+            const float py = y + 0.5f;
+            for (uint32_t x = beginX; x < endX; x++)
+            {
+                // Each edge function is the weight of the vertex facing it,
+                // times twice the area.
+                const float px = x + 0.5f;
+                const float weightA = (c.x - b.x) * (py - b.y) - (c.y - b.y) * (px - b.x);
+                const float weightB = (a.x - c.x) * (py - c.y) - (a.y - c.y) * (px - c.x);
+                const float weightC = (b.x - a.x) * (py - a.y) - (b.y - a.y) * (px - a.x);
+                if (!IsInside(weightA, topLeftA) || !IsInside(weightB, topLeftB) || !IsInside(weightC, topLeftC))
+                {
+                    continue;
+                }
+
+                // Depth is linear in screen space after the divide.
+                const float depth = (weightA * a.depth + weightB * b.depth + weightC * c.depth) / area;
+                float& stored = _depth[static_cast<size_t>(y) * _width + x];
+                if (PassesDepthTest(comparison, depth, stored))
+                {
+                    stored = depth;
+                    passed++;
+                }
+            }
+        }
+    }
+    return passed;
+}
+
+uint64_t DepthRasterizer::GetCoveredPixels() const
+{
+    uint64_t covered = 0;
+    for (float depth : _depth)
+    {
+        if (depth != DepthClearValue)
+        {
+            covered++;
+        }
+    }
+    return covered;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "RenderDevice.h"
+#include "ShaderPermutations.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// The scene uses reverse-Z: depth is 1 at the near plane and falls towards 0
+// at infinity, so the float precision that piles up near 0 goes to distant
+// geometry instead of being wasted next to the camera. Depth is cleared to 0
+// and nearer means greater.
+const float DepthClearValue = 0.0f;
+
+// Mirrors D3D12_COMPARISON_FUNC.
+enum class DepthComparison : uint32_t
+{
+    Never = 1,
+    Less,
+    Equal,
+    LessEqual,
+    Greater,
+    NotEqual,
+    GreaterEqual,
+    Always,
+};
+
+// The pre-pass keeps the nearest surface. The scene pass then shades only
+// the pixels whose depth equals it; materials left out of the pre-pass still
+// write depth and test as usual under the same comparison.
+const DepthComparison PrepassDepthComparison = DepthComparison::Greater;
+const DepthComparison SceneDepthComparison = DepthComparison::GreaterEqual;
+
+// Left-handed perspective with the far plane at infinity and reverse-Z, in
+// the row-vector layout of XMMatrixPerspectiveFovLH. A point at view depth z
+// ends up at depth nearZ / z.
+void MakeReverseZPerspective(float fovYRadians, float aspectRatio, float nearZ, float projection[16]);
+
+// Per material: whether its draws go through the depth pre-pass first.
+enum class DepthPrepassMode : uint8_t
+{
+    Off,
+    On,
+};
+
+// Opaque materials take part. Alpha-tested ones would need their pixel
+// shader in the pre-pass to discard, which costs more than the pass saves.
+DepthPrepassMode GetDefaultDepthPrepassMode(ShaderFeatureMask features);
+
+// The pre-pass pipeline of each material: prepassPipeline where the mode is
+// On, 0 elsewhere, which RecordBatchDraws() skips.
+void SelectDepthPrepassPipelines(const DepthPrepassMode* pModes, size_t count, RenderHandle prepassPipeline, RenderHandle* pPipelines);
+
+// Draws the batches of the materials with a pre-pass pipeline into the depth
+// buffer only, from the position-only streams of their meshes. The caller
+// has cleared depth and bound the root signature, scene constants, viewport
+// and scissor; the render target is left bound to depthStencil alone.
+void RecordDepthPrepass(
+    RenderCommandList& commandList,
+    RenderDescriptor depthStencil,
+    const DrawBatch* pBatches,
+    size_t batchCount,
+    const IndirectMeshBinding* pPositionMeshes,
+    const RenderHandle* pPrepassPipelines,
+    const BatchRootBindings& bindings);
+
+// Depth testing on the CPU, to measure overdraw without a GPU: each Draw()
+// returns the fragments that passed, which is what the pixel shader would
+// have run on. Triangles are sampled at pixel centers with the top-left rule
+// and back faces culled, like the default rasterizer state of the scene
+// pipelines. Triangles reaching in front of the near plane are dropped
+// rather than clipped.
+class DepthRasterizer
+{
+public: DepthRasterizer(uint32_t width, uint32_t height);
+
+// Every pixel back to DepthClearValue.
+public: void Clear();
+
+// The indexed triangles of pPositions (x, y, z per vertex), taken to clip
+// space by transform (row-major, row vectors). Fragments that pass
+// comparison write their depth.
+public: uint64_t Draw(const float* pPositions, const uint32_t* pIndices, size_t indexCount, const float transform[16], DepthComparison comparison);
+
+// Pixels some fragment has written since Clear().
+public: uint64_t GetCoveredPixels() const;
+
+private: uint32_t _width;
+private: uint32_t _height;
+private: std::vector<float> _depth;
+};
@@ -0,0 +1,262 @@
+#include "Benchmark.h"
+#include "DepthPass.h"
+#include "MeshStreams.h"
+#include "UnitTest.h"
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+    struct TestVertex
+    {
+        float position[3];
+        float color[4];
+    };
+
+    // The sample's cube: 24 vertices, clockwise seen from outside.
+    void BuildCube(std::vector<TestVertex>* pVertices, std::vector<uint32_t>* pIndices)
+    {
+        for (int face = 0; face < 6; face++)
+        {
+            const int axis = face / 2;
+            const float sign = face % 2 == 0 ? -1.0f : 1.0f;
+            const int u = (axis + 1) % 3;
+            const int v = (axis + 2) % 3;
+
+            static const float CornerU[] = { -0.5f, -0.5f, 0.5f, 0.5f };
+            static const float CornerV[] = { -0.5f, 0.5f, 0.5f, -0.5f };
+            const uint32_t first = static_cast<uint32_t>(pVertices->size());
+            for (int corner = 0; corner < 4; corner++)
+            {
+                const int c = sign > 0.0f ? (4 - corner) % 4 : corner;
+                TestVertex vertex = {};
+                vertex.position[axis] = 0.5f * sign;
+                vertex.position[u] = CornerU[c];
+                vertex.position[v] = CornerV[c];
+                vertex.color[axis % 3] = 1.0f;
+                vertex.color[3] = sign > 0.0f ? 1.0f : 0.5f;
+                pVertices->push_back(vertex);
+            }
+
+            const uint32_t quad[] = { 0, 1, 2, 0, 2, 3 };
+            for (uint32_t index : quad)
+            {
+                pIndices->push_back(first + index);
+            }
+        }
+    }
+
+    void Multiply(const float a[16], const float b[16], float result[16])
+    {
+        for (int row = 0; row < 4; row++)
+        {
+            for (int column = 0; column < 4; column++)
+            {
+                float sum = 0.0f;
+                for (int k = 0; k < 4; k++)
+                {
+                    sum += a[row * 4 + k] * b[k * 4 + column];
+                }
+                result[row * 4 + column] = sum;
+            }
+        }
+    }
+
+    void Transform(const float point[4], const float matrix[16], float result[4])
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            result[c] = point[0] * matrix[c] + point[1] * matrix[4 + c] + point[2] * matrix[8 + c] + point[3] * matrix[12 + c];
+        }
+    }
+
+    // Depth is nearZ / z: 1 at the near plane, towards 0 at infinity.
+    void TestReverseZProjection()
+    {
+        float projection[16];
+        MakeReverseZPerspective(3.14159265f / 2.0f, 2.0f, 0.5f, projection);
+
+        const float depths[][2] = { { 0.5f, 1.0f }, { 1.0f, 0.5f }, { 50.0f, 0.01f }, { 1e6f, 5e-7f } };
+        for (const float* pDepth : depths)
+        {
+            const float point[4] = { 0.0f, 0.0f, pDepth[0], 1.0f };
+            float clip[4];
+            Transform(point, projection, clip);
+            CHECK(clip[3] == pDepth[0]);
+            CHECK(std::fabs(clip[2] / clip[3] - pDepth[1]) <= pDepth[1] * 1e-6f);
+        }
+
+        // 90 degrees down the middle: the frustum edge is at |y| == z, and
+        // twice as wide across.
+        const float corner[4] = { 8.0f, 4.0f, 4.0f, 1.0f };
+        float clip[4];
+        Transform(corner, projection, clip);
+        CHECK(std::fabs(clip[0] / clip[3] - 1.0f) < 1e-6f);
+        CHECK(std::fabs(clip[1] / clip[3] - 1.0f) < 1e-6f);
+    }
+
+    void TestPrepassModes()
+    {
+        CHECK(GetDefaultDepthPrepassMode(0) == DepthPrepassMode::On);
+        CHECK(GetDefaultDepthPrepassMode(SceneFeatureVertexColor | SceneFeatureTexture) == DepthPrepassMode::On);
+        CHECK(GetDefaultDepthPrepassMode(SceneFeatureAlphaTest) == DepthPrepassMode::Off);
+
+        const DepthPrepassMode modes[] = { DepthPrepassMode::On, DepthPrepassMode::Off, DepthPrepassMode::On };
+        RenderHandle pipelines[3] = { 1, 1, 1 };
+        SelectDepthPrepassPipelines(modes, 3, 7, pipelines);
+        CHECK(pipelines[0] == 7);
+        CHECK(pipelines[1] == 0);
+        CHECK(pipelines[2] == 7);
+
+        CHECK(PrepassDepthComparison == DepthComparison::Greater);
+        CHECK(SceneDepthComparison == DepthComparison::GreaterEqual);
+    }
+
+    // The cube's faces only differ in color, so its corners weld.
+    void TestPositionStream()
+    {
+        std::vector<TestVertex> vertices;
+        std::vector<uint32_t> indices;
+        BuildCube(&vertices, &indices);
+
+        PositionStream stream;
+        PositionStreamStats stats;
+        CHECK(BuildPositionStream(vertices.data(), static_cast<uint32_t>(vertices.size()), sizeof(TestVertex), 0, indices.data(), static_cast<uint32_t>(indices.size()), &stream, &stats));
+        CHECK(stats.sourceVertices == 24);
+        CHECK(stats.positionVertices == 8);
+        CHECK(stats.sourceBytes == 24 * sizeof(TestVertex));
+        CHECK(stats.positionBytes == 8 * 3 * sizeof(float));
+
+        // Same triangles in the same order.
+        CHECK(stream.indices.size() == indices.size());
+        for (size_t i = 0; i < indices.size(); i++)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                CHECK(stream.positions[stream.indices[i] * 3 + c] == vertices[indices[i]].position[c]);
+            }
+        }
+
+        indices.back() = 24;
+        CHECK(!BuildPositionStream(vertices.data(), static_cast<uint32_t>(vertices.size()), sizeof(TestVertex), 0, indices.data(), static_cast<uint32_t>(indices.size()), &stream, &stats));
+    }
+
+    // Two triangles sharing a diagonal cover every pixel once; the top-left
+    // rule gives the diagonal's pixels to one of them. Reversed, they face
+    // away and are culled.
+    void TestRasterizerCoverage()
+    {
+        const float positions[] =
+        {
+            -1.0f, 1.0f, 0.5f,
+            1.0f, 1.0f, 0.5f,
+            1.0f, -1.0f, 0.5f,
+            -1.0f, -1.0f, 0.5f,
+        };
+        const uint32_t front[] = { 0, 1, 2, 0, 2, 3 };
+        const uint32_t back[] = { 0, 2, 1, 0, 3, 2 };
+        const float identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+
+        DepthRasterizer rasterizer(37, 23);
+        CHECK(rasterizer.Draw(positions, back, 6, identity, DepthComparison::Always) == 0);
+        CHECK(rasterizer.Draw(positions, front, 6, identity, DepthComparison::Always) == 37 * 23);
+        CHECK(rasterizer.GetCoveredPixels() == 37 * 23);
+
+        // The pre-pass comparison rejects the same depth, the scene's passes it.
+        CHECK(rasterizer.Draw(positions, front, 6, identity, PrepassDepthComparison) == 0);
+        CHECK(rasterizer.Draw(positions, front, 6, identity, SceneDepthComparison) == 37 * 23);
+
+        rasterizer.Clear();
+        CHECK(rasterizer.GetCoveredPixels() == 0);
+    }
+
+    struct OverdrawResult
+    {
+        uint64_t coveredPixels;
+        uint64_t prepassFragments;
+        uint64_t shadedWithPrepass;
+        uint64_t shadedWithoutPrepass;
+    };
+
+    // A benchmark city seen from four points of a low orbit, drawn in grid
+    // order, once straight and once behind the pre-pass.
+    OverdrawResult MeasureCityOverdraw(const PositionStream& cube, uint32_t width, uint32_t height)
+    {
+        BenchmarkScript script;
+        std::string error;
+        CHECK(ParseBenchmarkScript(
+            "grid 60 60 2.5 1 1\n"
+            "camera 0  0 3 -80   0 0 0\n"
+            "camera 5  80 3 0    0 0 0\n"
+            "camera 10 0 3 80    0 0 0\n",
+            &script, &error));
+        std::vector<DrawItem> items;
+        BuildBenchmarkScene(script, &items);
+
+        OverdrawResult result = {};
+        DepthRasterizer straight(width, height);
+        DepthRasterizer prepassed(width, height);
+        for (uint64_t frame = 0; frame < 600; frame += 150)
+        {
+            float viewProjection[16];
+            EvaluateBenchmarkCamera(script, frame, static_cast<float>(width) / height, viewProjection);
+
+            std::vector<float> transforms(items.size() * 16);
+            for (size_t i = 0; i < items.size(); i++)
+            {
+                Multiply(items[i].world, viewProjection, &transforms[i * 16]);
+            }
+
+            straight.Clear();
+            prepassed.Clear();
+            for (size_t i = 0; i < items.size(); i++)
+            {
+                result.shadedWithoutPrepass += straight.Draw(cube.positions.data(), cube.indices.data(), cube.indices.size(), &transforms[i * 16], SceneDepthComparison);
+                result.prepassFragments += prepassed.Draw(cube.positions.data(), cube.indices.data(), cube.indices.size(), &transforms[i * 16], PrepassDepthComparison);
+            }
+            for (size_t i = 0; i < items.size(); i++)
+            {
+                result.shadedWithPrepass += prepassed.Draw(cube.positions.data(), cube.indices.data(), cube.indices.size(), &transforms[i * 16], SceneDepthComparison);
+            }
+
+            CHECK(straight.GetCoveredPixels() == prepassed.GetCoveredPixels());
+            result.coveredPixels += straight.GetCoveredPixels();
+        }
+        return result;
+    }
+
+    // Behind the pre-pass each covered pixel is shaded about once; only
+    // surfaces at exactly the same depth both pass.
+    void TestOverdraw()
+    {
+        std::vector<TestVertex> vertices;
+        std::vector<uint32_t> indices;
+        BuildCube(&vertices, &indices);
+        PositionStream cube;
+        PositionStreamStats stats;
+        CHECK(BuildPositionStream(vertices.data(), static_cast<uint32_t>(vertices.size()), sizeof(TestVertex), 0, indices.data(), static_cast<uint32_t>(indices.size()), &cube, &stats));
+
+        const OverdrawResult result = MeasureCityOverdraw(cube, 1280, 720);
+        CHECK(result.coveredPixels > 0);
+        CHECK(result.shadedWithPrepass >= result.coveredPixels);
+        CHECK(result.shadedWithPrepass <= result.coveredPixels + result.coveredPixels / 100);
+        CHECK(result.shadedWithoutPrepass > result.shadedWithPrepass);
+
+        printf("overdraw at 1280x720: %.2f without pre-pass, %.2f with (%.2f depth-only)\n",
+            static_cast<double>(result.shadedWithoutPrepass) / result.coveredPixels,
+            static_cast<double>(result.shadedWithPrepass) / result.coveredPixels,
+            static_cast<double>(result.prepassFragments) / result.coveredPixels);
+    }
+}
+
+int main()
+{
+    TestReverseZProjection();
+    TestPrepassModes();
+    TestPositionStream();
+    TestRasterizerCoverage();
+    TestOverdraw();
+    return TestFailures();
+}
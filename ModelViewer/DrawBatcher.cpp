@@ -0,0 +1,43 @@
+#include "DrawBatcher.h"
+
+#include <algorithm>
+#include <cstring>
+
+void DrawBatcher::Build(const DrawItem* pItems, size_t count)
+{
+    _sortEntries.resize(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        _sortEntries[i].key = (static_cast<uint64_t>(pItems[i].materialId) << 32) | pItems[i].meshId;
+        _sortEntries[i].index = static_cast<uint32_t>(i);
+    }
+
+    std::sort(_sortEntries.begin(), _sortEntries.end(), [](const SortEntry& a, const SortEntry& b)
+    {
+        return a.key != b.key ? a.key < b.key : a.index < b.index;
+    });
+
+    _batches.clear();
+    _instances.resize(count);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const DrawItem& item = pItems[_sortEntries[i].index];
+        if (i == 0 || _sortEntries[i].key != _sortEntries[i - 1].key)
+        {
+            DrawBatch batch;
+            batch.meshId = item.meshId;
+            batch.materialId = item.materialId;
+            batch.firstInstance = static_cast<uint32_t>(i);
+            batch.instanceCount = 0;
+            _batches.push_back(batch);
+        }
+
+        _batches.back().instanceCount++;
+        memcpy(_instances[i].world, item.world, sizeof(item.world));
+    }
+
+    _stats.inputDraws = static_cast<uint32_t>(count);
+    _stats.batchedDraws = static_cast<uint32_t>(_batches.size());
+    _stats.drawCallsSaved = _stats.inputDraws - _stats.batchedDraws;
+}
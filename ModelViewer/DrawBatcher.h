@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A single draw as submitted by the scene, before instancing.
+struct DrawItem
+{
+    uint32_t meshId;
+    uint32_t materialId;
+    float world[16];    // Object to world transform, laid out the way the shader reads it.
+};
+
+// Per-instance data written to the instance structured buffer.
+struct InstanceData
+{
+    float world[16];
+};
+
+// One DrawIndexedInstanced call after grouping. firstInstance indexes into the
+// instance array. SV_InstanceID does not include StartInstanceLocation, so the
+// renderer offsets the instance buffer address by firstInstance instead.
+struct DrawBatch
+{
+    uint32_t meshId;
+    uint32_t materialId;
+    uint32_t firstInstance;
+    uint32_t instanceCount;
+};
+
+struct DrawBatchStats
+{
+    uint32_t inputDraws;
+    uint32_t batchedDraws;
+    uint32_t drawCallsSaved;
+};
+
+// Collapses draws sharing the same mesh and material into instanced batches.
+// Batches come out ordered by material first and mesh second so consecutive
+// batches rarely need a pipeline state change; instances inside a batch keep
+// their submission order.
+class DrawBatcher
+{
+public: void Build(const DrawItem* pItems, size_t count);
+
+public: const std::vector<DrawBatch>& GetBatches() const { return _batches; }
+public: const std::vector<InstanceData>& GetInstances() const { return _instances; }
+public: const DrawBatchStats& GetStats() const { return _stats; }
+
+private: struct SortEntry
+    {
+        uint64_t key;
+        uint32_t index;
+    };
+
+    // Kept between frames so the per-frame grouping does not allocate.
+private: std::vector<SortEntry> _sortEntries;
+private: std::vector<DrawBatch> _batches;
+private: std::vector<InstanceData> _instances;
+private: DrawBatchStats _stats = {};
+};
@@ -0,0 +1,100 @@
+#include "DrawBatcher.h"
+#include "UnitTest.h"
+
+#include <vector>
+
+namespace
+{
+    // The transform only carries the submission index, to follow instances.
+    DrawItem MakeItem(uint32_t meshId, uint32_t materialId, uint32_t submission)
+    {
+        DrawItem item = {};
+        item.meshId = meshId;
+        item.materialId = materialId;
+        item.world[12] = static_cast<float>(submission);
+        return item;
+    }
+
+    // Batches come out by material then mesh; a batch's instances keep the
+    // order they were submitted in.
+    void TestSortAndMerge()
+    {
+        const DrawItem items[] =
+        {
+            MakeItem(1, 2, 0),
+            MakeItem(0, 2, 1),
+            MakeItem(1, 0, 2),
+            MakeItem(1, 2, 3),
+            MakeItem(5, 1, 4),
+            MakeItem(0, 2, 5),
+            MakeItem(1, 2, 6),
+        };
+
+        DrawBatcher batcher;
+        batcher.Build(items, 7);
+        const std::vector<DrawBatch>& batches = batcher.GetBatches();
+        CHECK(batches.size() == 4);
+
+        const uint32_t expected[][4] =
+        {
+            // mesh, material, first instance, instances
+            { 1, 0, 0, 1 },
+            { 5, 1, 1, 1 },
+            { 0, 2, 2, 2 },
+            { 1, 2, 4, 3 },
+        };
+        for (size_t b = 0; b < 4 && b < batches.size(); b++)
+        {
+            CHECK(batches[b].meshId == expected[b][0]);
+            CHECK(batches[b].materialId == expected[b][1]);
+            CHECK(batches[b].firstInstance == expected[b][2]);
+            CHECK(batches[b].instanceCount == expected[b][3]);
+        }
+
+        const float order[] = { 2, 4, 1, 5, 0, 3, 6 };
+        const std::vector<InstanceData>& instances = batcher.GetInstances();
+        CHECK(instances.size() == 7);
+        for (size_t i = 0; i < 7 && i < instances.size(); i++)
+        {
+            CHECK(instances[i].world[12] == order[i]);
+        }
+
+        const DrawBatchStats& stats = batcher.GetStats();
+        CHECK(stats.inputDraws == 7);
+        CHECK(stats.batchedDraws == 4);
+        CHECK(stats.drawCallsSaved == 3);
+    }
+
+    // The batcher is reused from frame to frame; nothing carries over.
+    void TestRebuild()
+    {
+        DrawBatcher batcher;
+        std::vector<DrawItem> items;
+        for (uint32_t i = 0; i < 100; i++)
+        {
+            items.push_back(MakeItem(i % 3, i % 2, i));
+        }
+        batcher.Build(items.data(), items.size());
+        CHECK(batcher.GetBatches().size() == 6);
+        CHECK(batcher.GetStats().drawCallsSaved == 94);
+
+        // Distinct draws save nothing.
+        const DrawItem distinct[] = { MakeItem(0, 0, 0), MakeItem(1, 0, 1), MakeItem(0, 1, 2) };
+        batcher.Build(distinct, 3);
+        CHECK(batcher.GetBatches().size() == 3);
+        CHECK(batcher.GetInstances().size() == 3);
+        CHECK(batcher.GetStats().drawCallsSaved == 0);
+
+        batcher.Build(nullptr, 0);
+        CHECK(batcher.GetBatches().empty());
+        CHECK(batcher.GetStats().inputDraws == 0);
+        CHECK(batcher.GetStats().drawCallsSaved == 0);
+    }
+}
+
+int main()
+{
+    TestSortAndMerge();
+    TestRebuild();
+    return TestFailures();
+}
@@ -0,0 +1,138 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // Absorbs the rounding of scales that are meant to sit on a step.
+    const float StepEpsilon = 1e-4f;
+
+    double GetMedian(std::vector<double>::const_iterator begin, std::vector<double>::const_iterator end)
+    {
+        std::vector<double> sorted(begin, end);
+        std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+        return sorted[sorted.size() / 2];
+    }
+}
+
+DynamicResolutionController::DynamicResolutionController(const DynamicResolutionSettings& settings) :
+    _settings(settings),
+    _level(0),
+    _stats()
+{
+    Reset(settings.maxScale);
+}
+
+void DynamicResolutionController::SetSettings(const DynamicResolutionSettings& settings)
+{
+    const float scale = GetScale();
+    _settings = settings;
+    Reset(scale);
+}
+
+void DynamicResolutionController::Reset(float scale)
+{
+    _level = GetLevelAtOrBelow(scale);
+    _samples.clear();
+}
+
+bool DynamicResolutionController::AddFrame(float frameScale, double gpuMilliseconds)
+{
+    const float scale = GetScale();
+    if (frameScale != scale)
+    {
+        _stats.staleSamples++;
+        return false;
+    }
+    if (gpuMilliseconds <= 0.0)
+    {
+        return false;
+    }
+
+    // The most recent frames last, at most growFrames of them.
+    const size_t dropFrames = std::max<uint32_t>(_settings.dropFrames, 1);
+    const size_t growFrames = std::max<size_t>(_settings.growFrames, dropFrames);
+    if (_samples.size() == growFrames)
+    {
+        _samples.erase(_samples.begin());
+    }
+    _samples.push_back(gpuMilliseconds);
+
+    const double target = _settings.targetMilliseconds;
+    uint32_t level = _level;
+    if (_samples.size() >= dropFrames)
+    {
+        const double measured = GetMedian(_samples.end() - dropFrames, _samples.end());
+        _stats.lastMilliseconds = measured;
+        if (measured > target * (1.0 + _settings.toleranceFraction))
+        {
+            const float desired = scale * static_cast<float>(std::pow(target / measured, _settings.downGain * 0.5));
+            level = std::min(GetLevelAtOrBelow(desired), _level > 0 ? _level - 1 : 0);
+        }
+    }
+    if (level == _level && _samples.size() == growFrames && _level < GetMaxLevel())
+    {
+        // Grow only as far as the frame is predicted to fit with the
+        // tolerance to spare, so noise cannot take the step back at once.
+        const double measured = GetMedian(_samples.begin(), _samples.end());
+        _stats.lastMilliseconds = measured;
+        const float desired = scale * static_cast<float>(std::pow(target / measured, _settings.upGain * 0.5));
+        level = std::min(std::max(GetLevelAtOrBelow(desired), _level + 1), GetMaxLevel());
+        while (level > _level)
+        {
+            const double growth = ScaleOf(level) / scale;
+            if (measured * growth * growth <= target * (1.0 - _settings.toleranceFraction))
+            {
+                break;
+            }
+            level--;
+        }
+    }
+
+    if (level == _level)
+    {
+        return false;
+    }
+    if (level > _level)
+    {
+        _stats.increases++;
+    }
+    _stats.changes++;
+    _level = level;
+    _samples.clear();
+    return true;
+}
+
+float DynamicResolutionController::ScaleOf(uint32_t level) const
+{
+    return std::min(_settings.minScale + level * _settings.scaleStep, _settings.maxScale);
+}
+
+uint32_t DynamicResolutionController::GetMaxLevel() const
+{
+    if (_settings.scaleStep <= 0.0f || _settings.maxScale <= _settings.minScale)
+    {
+        return 0;
+    }
+    return static_cast<uint32_t>(std::ceil((_settings.maxScale - _settings.minScale) / _settings.scaleStep - StepEpsilon));
+}
+
+uint32_t DynamicResolutionController::GetLevelAtOrBelow(float scale) const
+{
+    if (_settings.scaleStep <= 0.0f || scale <= _settings.minScale)
+    {
+        return 0;
+    }
+    if (scale >= _settings.maxScale)
+    {
+        return GetMaxLevel();
+    }
+    const uint32_t level = static_cast<uint32_t>(std::floor((scale - _settings.minScale) / _settings.scaleStep + StepEpsilon));
+    return std::min(level, GetMaxLevel());
+}
+
+uint32_t GetScaledSize(uint32_t size, float scale)
+{
+    return std::max(static_cast<uint32_t>(size * scale + 0.5f), 1u);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+struct DynamicResolutionSettings
+{
+    double targetMilliseconds = 14.0;   // GPU time per frame to stay under, below the frame budget.
+    double toleranceFraction = 0.05;    // Of the target: the hysteresis band between dropping and growing the scale.
+    float minScale = 0.5f;              // Of the output size, per axis.
+    float maxScale = 1.0f;
+    float scaleStep = 0.05f;            // Scales are multiples of this above minScale.
+    uint32_t dropFrames = 3;            // Frames measured at a scale before dropping it,
+    uint32_t growFrames = 12;           // and before growing it.
+    double downGain = 0.9;              // Fraction of the correction applied at once when over,
+    double upGain = 0.5;                // and when under the target.
+};
+
+struct DynamicResolutionStats
+{
+    uint64_t changes;
+    uint64_t increases;
+    uint64_t staleSamples;              // Measured at a scale that was already replaced.
+    double lastMilliseconds;            // Median of the last window a decision looked at.
+};
+
+// Picks the render scale from GPU frame times. GPU time is taken to grow
+// with the pixel count, the scale squared, so frames that measured t at
+// scale s suggest s * sqrt(target / t). Over the target plus the tolerance
+// the scale drops at once by at least a step. Under it the scale only grows
+// to a step whose predicted time fits the target minus the tolerance, which
+// keeps it from bouncing between neighbouring steps. Decisions use the
+// median of the last frames measured at the current scale: a few to drop,
+// more to grow. Neither a spike nor timings that arrive frames late cause a
+// change. Deterministic and not thread-safe.
+class DynamicResolutionController
+{
+public: explicit DynamicResolutionController(const DynamicResolutionSettings& settings = DynamicResolutionSettings());
+
+public: void SetSettings(const DynamicResolutionSettings& settings);
+public: const DynamicResolutionSettings& GetSettings() const { return _settings; }
+
+    // Starts over at the given scale, snapped to a step.
+public: void Reset(float scale);
+
+    // The GPU time of a frame rendered at frameScale, the scale GetScale()
+    // returned when the frame was recorded. Returns whether the scale changed.
+public: bool AddFrame(float frameScale, double gpuMilliseconds);
+
+public: float GetScale() const { return ScaleOf(_level); }
+public: const DynamicResolutionStats& GetStats() const { return _stats; }
+
+private: float ScaleOf(uint32_t level) const;
+private: uint32_t GetMaxLevel() const;
+private: uint32_t GetLevelAtOrBelow(float scale) const;
+
+private: DynamicResolutionSettings _settings;
+private: uint32_t _level;
+private: std::vector<double> _samples;
+private: DynamicResolutionStats _stats;
+};
+
+// Size of one axis at a scale, at least one pixel.
+uint32_t GetScaledSize(uint32_t size, float scale);
@@ -0,0 +1,254 @@
+#include "DynamicResolution.h"
+#include "UnitTest.h"
+
+#include <cmath>
+#include <deque>
+#include <utility>
+
+namespace
+{
+    // GPU time grows with the pixel count, give or take some noise. Timings
+    // come back latencyFrames after the frame was recorded, tagged with its
+    // scale, like the sample's readback.
+    struct SimulatedGpu
+    {
+        double fullScaleMilliseconds;
+        double noiseFraction;
+        uint32_t latencyFrames;
+        uint32_t random;
+        std::deque<std::pair<float, double>> inFlight;
+
+        SimulatedGpu(double fullScale, double noise, uint32_t latency) :
+            fullScaleMilliseconds(fullScale),
+            noiseFraction(noise),
+            latencyFrames(latency),
+            random(12345),
+            inFlight()
+        {
+        }
+
+        double NextNoise()
+        {
+            random = random * 1664525u + 1013904223u;
+            return ((random >> 8) / 16777216.0 * 2.0 - 1.0) * noiseFraction;
+        }
+
+        // One frame at the controller's current scale; returns the scale
+        // changes it caused.
+        uint32_t RunFrame(DynamicResolutionController* pController, double spikeMilliseconds = 0.0)
+        {
+            const float scale = pController->GetScale();
+            const double milliseconds = fullScaleMilliseconds * scale * scale * (1.0 + NextNoise()) + spikeMilliseconds;
+            inFlight.push_back(std::make_pair(scale, milliseconds));
+
+            uint32_t changes = 0;
+            while (inFlight.size() > latencyFrames)
+            {
+                changes += pController->AddFrame(inFlight.front().first, inFlight.front().second) ? 1 : 0;
+                inFlight.pop_front();
+            }
+            return changes;
+        }
+
+        uint32_t Run(DynamicResolutionController* pController, uint32_t frames)
+        {
+            uint32_t changes = 0;
+            for (uint32_t i = 0; i < frames; i++)
+            {
+                changes += RunFrame(pController);
+            }
+            return changes;
+        }
+    };
+
+    bool IsOnStep(const DynamicResolutionSettings& settings, float scale)
+    {
+        const float steps = (scale - settings.minScale) / settings.scaleStep;
+        return std::fabs(steps - std::round(steps)) < 1e-3f || scale == settings.maxScale;
+    }
+
+    // Twice over budget at full scale: drops within a few frames to the
+    // largest step that fits, sqrt(1/2) of full, and stays there.
+    void TestConvergesDown()
+    {
+        const DynamicResolutionSettings settings;
+        DynamicResolutionController controller(settings);
+        SimulatedGpu gpu(2.0 * settings.targetMilliseconds, 0.02, 3);
+
+        uint32_t frames = 0;
+        while (controller.GetScale() > 0.75f && frames < 60)
+        {
+            gpu.RunFrame(&controller);
+            frames++;
+        }
+        CHECK(frames <= 3 * (settings.dropFrames + gpu.latencyFrames));
+
+        CHECK(gpu.Run(&controller, 600) <= 2);
+        CHECK(std::fabs(controller.GetScale() - 0.70f) < 1e-4f);
+        CHECK(IsOnStep(settings, controller.GetScale()));
+        CHECK(controller.GetStats().increases == 0);
+        CHECK(gpu.Run(&controller, 2000) == 0);
+    }
+
+    // Far under budget at the smallest scale: grows back to full scale and
+    // never drops on the way.
+    void TestConvergesUp()
+    {
+        const DynamicResolutionSettings settings;
+        DynamicResolutionController controller(settings);
+        controller.Reset(settings.minScale);
+        CHECK(controller.GetScale() == settings.minScale);
+
+        SimulatedGpu gpu(0.5 * settings.targetMilliseconds, 0.02, 3);
+        gpu.Run(&controller, 2000);
+        CHECK(controller.GetScale() == settings.maxScale);
+        CHECK(controller.GetStats().changes == controller.GetStats().increases);
+
+        // Each step up waits for growFrames of timings at the new scale.
+        CHECK(controller.GetStats().increases <= 10);
+    }
+
+    // A load that hits the target right at a step. Noise within the
+    // tolerance band never moves the scale once settled. Noise past it can
+    // take the scale back up a step and down again, but only after growFrames
+    // at the lower step, so such round trips stay rare.
+    void TestNoOscillationAtStepBoundary()
+    {
+        const DynamicResolutionSettings settings;
+        for (uint32_t latency = 0; latency <= 4; latency++)
+        {
+            for (double noise : { 0.0, 0.03, 0.08 })
+            {
+                DynamicResolutionController controller(settings);
+                const double boundary = 0.8;
+                SimulatedGpu gpu(settings.targetMilliseconds / (boundary * boundary), noise, latency);
+                gpu.Run(&controller, 600);
+
+                const float settled = controller.GetScale();
+                const uint64_t changesBefore = controller.GetStats().changes;
+                gpu.Run(&controller, 3000);
+                const uint64_t changes = controller.GetStats().changes - changesBefore;
+                CHECK(noise > settings.toleranceFraction ? changes <= 8 : changes == 0);
+                CHECK(std::fabs(controller.GetScale() - settled) <= settings.scaleStep + 1e-4f);
+                CHECK(controller.GetScale() <= 0.8f + 1e-4f);
+                CHECK(controller.GetScale() >= 0.7f - 1e-4f);
+            }
+        }
+    }
+
+    // The same settings and timings give the same scales.
+    void TestDeterministic()
+    {
+        const DynamicResolutionSettings settings;
+        DynamicResolutionController a(settings);
+        DynamicResolutionController b(settings);
+        SimulatedGpu gpuA(1.6 * settings.targetMilliseconds, 0.1, 2);
+        SimulatedGpu gpuB(1.6 * settings.targetMilliseconds, 0.1, 2);
+        for (int i = 0; i < 1000; i++)
+        {
+            gpuA.RunFrame(&a);
+            gpuB.RunFrame(&b);
+            CHECK(a.GetScale() == b.GetScale());
+        }
+        CHECK(a.GetStats().changes == b.GetStats().changes);
+    }
+
+    // One slow frame is not enough to drop: decisions take the median.
+    void TestSpikeIgnored()
+    {
+        const DynamicResolutionSettings settings;
+        DynamicResolutionController controller(settings);
+        SimulatedGpu gpu(0.8 * settings.targetMilliseconds, 0.0, 2);
+        gpu.Run(&controller, 100);
+        CHECK(controller.GetScale() == settings.maxScale);
+
+        gpu.RunFrame(&controller, 10.0 * settings.targetMilliseconds);
+        gpu.Run(&controller, 100);
+        CHECK(controller.GetScale() == settings.maxScale);
+        CHECK(controller.GetStats().changes == 0);
+    }
+
+    // A load that doubles is answered within the drop window plus the
+    // readback latency.
+    void TestRespondsToLoadStep()
+    {
+        const DynamicResolutionSettings settings;
+        DynamicResolutionController controller(settings);
+        SimulatedGpu gpu(0.8 * settings.targetMilliseconds, 0.02, 3);
+        gpu.Run(&controller, 100);
+        CHECK(controller.GetScale() == settings.maxScale);
+
+        gpu.fullScaleMilliseconds *= 2.0;
+        uint32_t frames = 0;
+        while (controller.GetScale() == settings.maxScale && frames < 100)
+        {
+            gpu.RunFrame(&controller);
+            frames++;
+        }
+        CHECK(frames <= settings.dropFrames + gpu.latencyFrames);
+        gpu.Run(&controller, 600);
+        const float scale = controller.GetScale();
+        const double predicted = gpu.fullScaleMilliseconds * scale * scale;
+        CHECK(predicted <= settings.targetMilliseconds * (1.0 + settings.toleranceFraction));
+    }
+
+    // Timings of a scale the controller has left are counted and dropped.
+    void TestStaleSamples()
+    {
+        DynamicResolutionSettings settings;
+        settings.dropFrames = 1;
+        DynamicResolutionController controller(settings);
+        CHECK(controller.AddFrame(1.0f, 3.0 * settings.targetMilliseconds));
+        const float scale = controller.GetScale();
+        CHECK(scale < 1.0f);
+
+        CHECK(!controller.AddFrame(1.0f, 3.0 * settings.targetMilliseconds));
+        CHECK(!controller.AddFrame(1.0f, 3.0 * settings.targetMilliseconds));
+        CHECK(controller.GetStats().staleSamples == 2);
+        CHECK(controller.GetScale() == scale);
+
+        // Nor does a timing of zero, a frame the profiler did not measure.
+        CHECK(!controller.AddFrame(scale, 0.0));
+        CHECK(controller.GetScale() == scale);
+    }
+
+    void TestSettings()
+    {
+        DynamicResolutionSettings settings;
+        settings.minScale = 0.5f;
+        settings.maxScale = 1.0f;
+        settings.scaleStep = 0.15f;
+        DynamicResolutionController controller(settings);
+        CHECK(controller.GetScale() == 1.0f);
+
+        // Off-step scales snap down; the top step is capped at maxScale.
+        controller.Reset(0.9f);
+        CHECK(std::fabs(controller.GetScale() - 0.8f) < 1e-6f);
+        controller.Reset(0.1f);
+        CHECK(controller.GetScale() == 0.5f);
+
+        // New settings keep the scale, snapped to their own steps.
+        settings.scaleStep = 0.25f;
+        controller.Reset(0.8f);
+        controller.SetSettings(settings);
+        CHECK(controller.GetScale() == 0.75f);
+
+        CHECK(GetScaledSize(1280, 0.5f) == 640);
+        CHECK(GetScaledSize(1280, 0.75f) == 960);
+        CHECK(GetScaledSize(719, 0.5f) == 360);
+        CHECK(GetScaledSize(1, 0.1f) == 1);
+    }
+}
+
+int main()
+{
+    TestConvergesDown();
+    TestConvergesUp();
+    TestNoOscillationAtStepBoundary();
+    TestDeterministic();
+    TestSpikeIgnored();
+    TestRespondsToLoadStep();
+    TestStaleSamples();
+    TestSettings();
+    return TestFailures();
+}
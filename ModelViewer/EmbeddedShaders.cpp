@@ -0,0 +1,83 @@
+#include "EmbeddedShaders.h"
+
+#if defined(MODELVIEWER_EMBEDDED_SHADERS)
+// Generated by CompileEmbeddedShaders: the dxc -Fh headers of every variant,
+// each defining g_VSMain_<features> and g_PSMain_<features>.
+#include "EmbeddedShaderIncludes.inc"
+#endif
+
+namespace
+{
+#if defined(MODELVIEWER_EMBEDDED_SHADERS)
+#define EMBEDDED_SHADER_VARIANT(features) \
+    { features, g_VSMain_##features, sizeof(g_VSMain_##features), g_PSMain_##features, sizeof(g_PSMain_##features) },
+
+    const EmbeddedShaderVariant EmbeddedVariants[] =
+    {
+        // Generated by CompileEmbeddedShaders: one EMBEDDED_SHADER_VARIANT(features) per variant.
+#include "EmbeddedShaderVariants.inc"
+    };
+
+#undef EMBEDDED_SHADER_VARIANT
+
+    const size_t EmbeddedVariantCount = sizeof(EmbeddedVariants) / sizeof(EmbeddedVariants[0]);
+#else
+    const EmbeddedShaderVariant* const EmbeddedVariants = nullptr;
+    const size_t EmbeddedVariantCount = 0;
+#endif
+
+    bool CheckShader(const uint8_t* pData, size_t size, const char* entryPoint, ShaderFeatureMask features, const RootSignatureLayout& layout, std::string* pError)
+    {
+        ShaderContainerInfo info;
+        std::string error;
+        if (!ReadShaderContainer(pData, size, &info, &error) ||
+            !info.hasDxil ||
+            !info.hasBindings ||
+            !CheckShaderBindings(info.bindings.data(), info.bindings.size(), layout, &error))
+        {
+            if (error.empty())
+            {
+                error = "Not a DXIL container with bindings";
+            }
+            *pError = std::string(entryPoint) + " variant " + std::to_string(features) + ": " + error;
+            return false;
+        }
+        return true;
+    }
+}
+
+size_t GetEmbeddedShaderVariantCount()
+{
+    return EmbeddedVariantCount;
+}
+
+const EmbeddedShaderVariant& GetEmbeddedShaderVariant(size_t index)
+{
+    return EmbeddedVariants[index];
+}
+
+const EmbeddedShaderVariant* FindEmbeddedShaderVariant(ShaderFeatureMask features)
+{
+    for (size_t i = 0; i < EmbeddedVariantCount; i++)
+    {
+        if (EmbeddedVariants[i].features == features)
+        {
+            return &EmbeddedVariants[i];
+        }
+    }
+    return nullptr;
+}
+
+bool CheckEmbeddedShaders(const RootSignatureLayout& layout, std::string* pError)
+{
+    for (size_t i = 0; i < EmbeddedVariantCount; i++)
+    {
+        const EmbeddedShaderVariant& variant = EmbeddedVariants[i];
+        if (!CheckShader(variant.pVertexShader, variant.vertexShaderSize, "VSMain", variant.features, layout, pError) ||
+            !CheckShader(variant.pPixelShader, variant.pixelShaderSize, "PSMain", variant.features, layout, pError))
+        {
+            return false;
+        }
+    }
+    return true;
+}
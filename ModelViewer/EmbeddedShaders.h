@@ -0,0 +1,34 @@
+#pragma once
+
+#include "ShaderContainer.h"
+#include "ShaderPermutations.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Scene shader variants compiled to DXIL at build time by the
+// CompileEmbeddedShaders target in ModelViewer.vcxproj, one per feature
+// mask. The target runs when shaders.hlsl is next to the project and defines
+// MODELVIEWER_EMBEDDED_SHADERS; without it there are no embedded variants
+// and shaders are compiled at runtime.
+struct EmbeddedShaderVariant
+{
+    ShaderFeatureMask features;
+    const uint8_t* pVertexShader;   // DXIL containers, reflection parts included.
+    size_t vertexShaderSize;
+    const uint8_t* pPixelShader;
+    size_t pixelShaderSize;
+};
+
+size_t GetEmbeddedShaderVariantCount();
+const EmbeddedShaderVariant& GetEmbeddedShaderVariant(size_t index);
+
+// Null when the variant was not embedded.
+const EmbeddedShaderVariant* FindEmbeddedShaderVariant(ShaderFeatureMask features);
+
+// Reads the bindings of every embedded shader from its container and checks
+// them against the root signature, so a shader rebuilt with a binding the
+// layout lacks fails at load rather than at draw. False with the first
+// problem.
+bool CheckEmbeddedShaders(const RootSignatureLayout& layout, std::string* pError);
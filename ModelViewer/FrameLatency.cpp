@@ -0,0 +1,163 @@
+#include "FrameLatency.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace
+{
+    inline int64_t ToMicroseconds(double milliseconds)
+    {
+        return static_cast<int64_t>(milliseconds * 1000.0);
+    }
+
+    void RecordSample(std::vector<int64_t>& samples, uint64_t index, int64_t microseconds)
+    {
+        if (samples.size() < FrameLatencyController::History)
+        {
+            samples.push_back(microseconds);
+        }
+        else
+        {
+            samples[index % FrameLatencyController::History] = microseconds;
+        }
+    }
+}
+
+FrameLatencyController::FrameLatencyController(const FrameLatencySettings& settings) :
+    _settings(settings),
+    _recordedFrames(0),
+    _lastVblank(0),
+    _lastRefreshCount(0),
+    _refreshPeriod(0),
+    _margin(ToMicroseconds(settings.minMarginMilliseconds)),
+    _target(0),
+    _lastDelay(0),
+    _latency(0.0),
+    _missedVblanks(0)
+{
+    _cpuTimes.reserve(History);
+    _gpuTimes.reserve(History);
+}
+
+void FrameLatencyController::SetSettings(const FrameLatencySettings& settings)
+{
+    _settings = settings;
+    _margin = std::min(std::max(_margin, ToMicroseconds(settings.minMarginMilliseconds)), ToMicroseconds(settings.maxMarginMilliseconds));
+}
+
+void FrameLatencyController::RecordVblank(int64_t microseconds, uint64_t refreshCount)
+{
+    if (_lastRefreshCount != 0 && refreshCount == _lastRefreshCount)
+    {
+        return;
+    }
+
+    // Follow small drift, jump when the display mode changed.
+    if (_lastRefreshCount != 0 && refreshCount > _lastRefreshCount && microseconds > _lastVblank)
+    {
+        const int64_t period = (microseconds - _lastVblank) / static_cast<int64_t>(refreshCount - _lastRefreshCount);
+        if (_refreshPeriod == 0 || std::abs(period - _refreshPeriod) > _refreshPeriod / 4)
+        {
+            _refreshPeriod = period;
+        }
+        else
+        {
+            _refreshPeriod += (period - _refreshPeriod) / 8;
+        }
+    }
+
+    _lastVblank = microseconds;
+    _lastRefreshCount = refreshCount;
+}
+
+int64_t FrameLatencyController::GetFrameStart(int64_t nowMicroseconds)
+{
+    _target = 0;
+    _lastDelay = 0;
+    if (_settings.variableRefresh || _refreshPeriod == 0 || _recordedFrames == 0)
+    {
+        return nowMicroseconds;
+    }
+
+    // Aim at the vblank a frame started now usually makes, and start as late
+    // as still makes it with the pessimistic prediction. A frame with no
+    // slack starts at once: holding it back would only skip a vblank.
+    const int64_t typical = Predict(_cpuTimes, 0.5) + Predict(_gpuTimes, 0.5);
+    const int64_t work = Predict(_cpuTimes, _settings.predictionPercentile) + Predict(_gpuTimes, _settings.predictionPercentile) + _margin;
+    const int64_t target = GetNextVblank(nowMicroseconds + typical);
+    if (target - work <= nowMicroseconds)
+    {
+        return nowMicroseconds;
+    }
+
+    _target = target;
+    _lastDelay = target - work - nowMicroseconds;
+    return target - work;
+}
+
+void FrameLatencyController::RecordFrame(int64_t start, int64_t submit, int64_t done)
+{
+    RecordSample(_cpuTimes, _recordedFrames, std::max<int64_t>(submit - start, 0));
+    RecordSample(_gpuTimes, _recordedFrames, std::max<int64_t>(done - submit, 0));
+
+    const int64_t minMargin = ToMicroseconds(_settings.minMarginMilliseconds);
+    const int64_t maxMargin = ToMicroseconds(_settings.maxMarginMilliseconds);
+    if (_target != 0)
+    {
+        if (done > _target)
+        {
+            _missedVblanks++;
+            _margin = std::min(_margin + (done - _target), maxMargin);
+        }
+        else
+        {
+            _margin -= (_margin - minMargin) / 64;
+        }
+    }
+
+    const bool vblankPaced = !_settings.variableRefresh && _refreshPeriod != 0;
+    const int64_t shown = vblankPaced ? GetNextVblank(done) : done;
+    const double latency = static_cast<double>(shown - start);
+    _latency = _recordedFrames == 0 ? latency : _latency + (latency - _latency) / 16.0;
+
+    _recordedFrames++;
+    _target = 0;
+}
+
+FrameLatencyStats FrameLatencyController::GetStats() const
+{
+    FrameLatencyStats stats = {};
+    stats.frames = _recordedFrames;
+    stats.missedVblanks = _missedVblanks;
+    stats.predictedCpuMilliseconds = Predict(_cpuTimes, _settings.predictionPercentile) / 1000.0;
+    stats.predictedGpuMilliseconds = Predict(_gpuTimes, _settings.predictionPercentile) / 1000.0;
+    stats.marginMilliseconds = _margin / 1000.0;
+    stats.refreshMilliseconds = _refreshPeriod / 1000.0;
+    stats.lastDelayMilliseconds = _lastDelay / 1000.0;
+    stats.latencyMilliseconds = _latency / 1000.0;
+    return stats;
+}
+
+int64_t FrameLatencyController::Predict(const std::vector<int64_t>& samples, double percentile) const
+{
+    if (samples.empty())
+    {
+        return 0;
+    }
+
+    std::vector<int64_t> sorted(samples);
+    const size_t index = GetNearestRankIndex(sorted.size(), percentile);
+    std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+    return sorted[index];
+}
+
+int64_t FrameLatencyController::GetNextVblank(int64_t microseconds) const
+{
+    if (microseconds <= _lastVblank)
+    {
+        return _lastVblank;
+    }
+    const int64_t intervals = (microseconds - _lastVblank + _refreshPeriod - 1) / _refreshPeriod;
+    return _lastVblank + intervals * _refreshPeriod;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+struct FrameLatencySettings
+{
+    // Tearing or a variable refresh display: a frame is shown as soon as it
+    // is done, so there is no vblank to aim at and frames start at once.
+    bool variableRefresh = false;
+    double predictionPercentile = 0.95;     // Of the recent CPU and GPU times.
+    double minMarginMilliseconds = 0.5;     // Slack on top of the predictions.
+    double maxMarginMilliseconds = 8.0;
+};
+
+struct FrameLatencyStats
+{
+    uint64_t frames;
+    uint64_t missedVblanks;                 // Held back frames done after the vblank they aimed at.
+    double predictedCpuMilliseconds;
+    double predictedGpuMilliseconds;
+    double marginMilliseconds;
+    double refreshMilliseconds;             // 0 until two vblanks were seen.
+    double lastDelayMilliseconds;           // How long the last frame start was held back.
+    double latencyMilliseconds;             // Frame start to the frame being shown, smoothed.
+};
+
+// Decides when a frame starts so that its input is as fresh as possible.
+// Once the swap chain can take a frame, starting at once leaves the finished
+// frame waiting for the next vblank. Instead the controller predicts how long
+// the CPU and then the GPU take. It holds the start back until that much
+// plus a margin before the vblank the frame usually makes. Frames without
+// that much slack start at once. Held back frames that still miss grow the
+// margin at once; it shrinks slowly while they are on time.
+// Times are in microseconds of any clock the caller uses throughout. Not
+// thread-safe.
+class FrameLatencyController
+{
+public: static const uint32_t History = 64;
+
+public: explicit FrameLatencyController(const FrameLatencySettings& settings = FrameLatencySettings());
+
+public: void SetSettings(const FrameLatencySettings& settings);
+public: const FrameLatencySettings& GetSettings() const { return _settings; }
+
+    // A vblank the display reported, refreshCount counting them. Teaches the
+    // controller the refresh period and where the next vblanks fall.
+public: void RecordVblank(int64_t microseconds, uint64_t refreshCount);
+
+    // When the frame that could start now should start; never before now.
+public: int64_t GetFrameStart(int64_t nowMicroseconds);
+
+    // The frame started at start, was submitted to the GPU at submit and
+    // finished on the GPU at done.
+public: void RecordFrame(int64_t start, int64_t submit, int64_t done);
+
+public: FrameLatencyStats GetStats() const;
+
+private: int64_t Predict(const std::vector<int64_t>& samples, double percentile) const;
+private: int64_t GetNextVblank(int64_t microseconds) const;
+
+private: FrameLatencySettings _settings;
+
+private: std::vector<int64_t> _cpuTimes;        // Rings of History entries.
+private: std::vector<int64_t> _gpuTimes;
+private: uint64_t _recordedFrames;
+
+private: int64_t _lastVblank;
+private: uint64_t _lastRefreshCount;
+private: int64_t _refreshPeriod;                // 0 while unknown.
+
+private: int64_t _margin;
+private: int64_t _target;                       // Vblank the current frame aims at, 0 for none.
+private: int64_t _lastDelay;
+private: double _latency;
+private: uint64_t _missedVblanks;
+};
@@ -0,0 +1,254 @@
+#include "FrameLatency.h"
+#include "UnitTest.h"
+
+#include <cmath>
+
+namespace
+{
+    const int64_t Refresh = 16667;
+
+    // A 60 Hz display with vblanks from time first on. Present returns
+    // right after a vblank, which is when the next frame could start.
+    struct SimulatedDisplay
+    {
+        int64_t first = 1000000;
+        uint64_t reported = 0;
+
+        int64_t GetVblank(uint64_t index) const { return first + static_cast<int64_t>(index) * Refresh; }
+
+        // Reports every vblank up to time.
+        void ReportUntil(FrameLatencyController* pController, int64_t time)
+        {
+            while (GetVblank(reported) <= time)
+            {
+                pController->RecordVblank(GetVblank(reported), reported + 1);
+                reported++;
+            }
+        }
+
+        int64_t GetNextVblank(int64_t time) const
+        {
+            uint64_t index = 0;
+            while (GetVblank(index) < time)
+            {
+                index++;
+            }
+            return GetVblank(index);
+        }
+    };
+
+    // One frame that takes cpu then gpu microseconds, started when the
+    // controller says. Returns when it finished on the GPU.
+    int64_t RunFrame(FrameLatencyController* pController, SimulatedDisplay* pDisplay, int64_t now, int64_t cpu, int64_t gpu, int64_t* pStart)
+    {
+        pDisplay->ReportUntil(pController, now);
+        const int64_t start = pController->GetFrameStart(now);
+        pController->RecordFrame(start, start + cpu, start + cpu + gpu);
+        *pStart = start;
+        return start + cpu + gpu;
+    }
+
+    bool Near(double value, double expected)
+    {
+        return std::fabs(value - expected) < 1e-3;
+    }
+
+    // The period follows the reported vblanks: small drift slowly, a mode
+    // change at once. A vblank reported twice is ignored.
+    void TestRefreshPeriod()
+    {
+        FrameLatencyController controller;
+        CHECK(controller.GetStats().refreshMilliseconds == 0.0);
+        controller.RecordVblank(1000000, 10);
+        CHECK(controller.GetStats().refreshMilliseconds == 0.0);
+        controller.RecordVblank(1000000 + Refresh, 11);
+        CHECK(Near(controller.GetStats().refreshMilliseconds, 16.667));
+        controller.RecordVblank(1000000 + Refresh, 11);
+
+        // A skipped report still gives the period.
+        controller.RecordVblank(1000000 + 3 * Refresh, 13);
+        CHECK(Near(controller.GetStats().refreshMilliseconds, 16.667));
+
+        // Drift moves it an eighth of the way.
+        controller.RecordVblank(1000000 + 4 * Refresh + 80, 14);
+        CHECK(Near(controller.GetStats().refreshMilliseconds, 16.677));
+
+        // 144 Hz now.
+        controller.RecordVblank(1000000 + 4 * Refresh + 80 + 6944, 15);
+        CHECK(Near(controller.GetStats().refreshMilliseconds, 6.944));
+    }
+
+    // Until it knows the display and the frame times, frames start at once.
+    void TestNoHoldWithoutHistory()
+    {
+        FrameLatencyController controller;
+        CHECK(controller.GetFrameStart(5000) == 5000);
+
+        SimulatedDisplay display;
+        display.ReportUntil(&controller, display.GetVblank(1));
+        const int64_t now = display.GetVblank(1) + 1000;
+        CHECK(controller.GetFrameStart(now) == now);
+        controller.RecordFrame(now, now + 3000, now + 7000);
+        CHECK(controller.GetFrameStart(now + 100) > now + 100);
+    }
+
+    // With 3 ms of CPU and 4 ms of GPU work, the start is held back so the
+    // frame finishes the margin before the vblank it makes, instead of
+    // waiting most of a refresh for it.
+    void TestHoldsStartBeforeVblank()
+    {
+        FrameLatencyController controller;
+        SimulatedDisplay display;
+        int64_t now = display.GetVblank(1) + 1000;
+        int64_t start = 0;
+        int64_t done = RunFrame(&controller, &display, now, 3000, 4000, &start);
+        CHECK(start == now);
+
+        for (int frame = 0; frame < 100; frame++)
+        {
+            now = display.GetNextVblank(done) + 1000;
+            done = RunFrame(&controller, &display, now, 3000, 4000, &start);
+            const int64_t vblank = display.GetNextVblank(done);
+            const FrameLatencyStats stats = controller.GetStats();
+            CHECK(start > now);
+            CHECK(done <= vblank);
+            CHECK(vblank - done == 500);
+            CHECK(vblank == display.GetNextVblank(now));
+            CHECK(Near(stats.lastDelayMilliseconds, (start - now) / 1000.0));
+        }
+
+        const FrameLatencyStats stats = controller.GetStats();
+        CHECK(stats.missedVblanks == 0);
+        CHECK(Near(stats.predictedCpuMilliseconds, 3.0));
+        CHECK(Near(stats.predictedGpuMilliseconds, 4.0));
+        CHECK(Near(stats.lastDelayMilliseconds, (Refresh - 1000 - 7500) / 1000.0));
+
+        // Start to shown is the work and the margin, against nearly a whole
+        // refresh when frames start as soon as they can.
+        CHECK(std::fabs(stats.latencyMilliseconds - 7.5) < 0.1);
+    }
+
+    // 15.5 ms of work started a millisecond after the vblank just makes the
+    // next one, with no room for the margin: it starts at once, as holding
+    // it back would only push it to the one after.
+    void TestNoHoldWithoutSlack()
+    {
+        FrameLatencyController controller;
+        SimulatedDisplay display;
+        int64_t now = display.GetVblank(1) + 1000;
+        int64_t start = 0;
+        int64_t done = RunFrame(&controller, &display, now, 6000, 9500, &start);
+        for (int frame = 0; frame < 10; frame++)
+        {
+            now = display.GetNextVblank(done) + 1000;
+            done = RunFrame(&controller, &display, now, 6000, 9500, &start);
+            CHECK(done <= display.GetNextVblank(now));
+            CHECK(start == now);
+            CHECK(controller.GetStats().lastDelayMilliseconds == 0.0);
+        }
+    }
+
+    // A held back frame that misses its vblank grows the margin by how late
+    // it was, so the next start is that much earlier; on-time frames then
+    // shrink it back slowly.
+    void TestMissedVblankBacksOff()
+    {
+        FrameLatencyController controller;
+        SimulatedDisplay display;
+        int64_t now = display.GetVblank(1) + 1000;
+        int64_t start = 0;
+        int64_t done = RunFrame(&controller, &display, now, 3000, 4000, &start);
+        for (int frame = 0; frame < 30; frame++)
+        {
+            now = display.GetNextVblank(done) + 1000;
+            done = RunFrame(&controller, &display, now, 3000, 4000, &start);
+        }
+        const double heldDelay = controller.GetStats().lastDelayMilliseconds;
+        CHECK(controller.GetStats().marginMilliseconds == 0.5);
+
+        // The GPU takes 2 ms longer once and finishes 1.5 ms late.
+        now = display.GetNextVblank(done) + 1000;
+        done = RunFrame(&controller, &display, now, 3000, 6000, &start);
+        CHECK(done - display.GetNextVblank(now) == 1500);
+        FrameLatencyStats stats = controller.GetStats();
+        CHECK(stats.missedVblanks == 1);
+        CHECK(Near(stats.marginMilliseconds, 2.0));
+        CHECK(Near(stats.predictedGpuMilliseconds, 4.0));
+
+        now = display.GetNextVblank(done) + 1000;
+        done = RunFrame(&controller, &display, now, 3000, 4000, &start);
+        stats = controller.GetStats();
+        CHECK(Near(stats.lastDelayMilliseconds, heldDelay - 1.5));
+        CHECK(display.GetNextVblank(done) - done == 2000);
+
+        double previous = stats.marginMilliseconds;
+        CHECK(previous < 2.0 && previous > 1.95);
+        for (int frame = 0; frame < 20; frame++)
+        {
+            now = display.GetNextVblank(done) + 1000;
+            done = RunFrame(&controller, &display, now, 3000, 4000, &start);
+            const double margin = controller.GetStats().marginMilliseconds;
+            CHECK(margin < previous);
+            previous = margin;
+        }
+        for (int frame = 0; frame < 1000; frame++)
+        {
+            now = display.GetNextVblank(done) + 1000;
+            done = RunFrame(&controller, &display, now, 3000, 4000, &start);
+        }
+        stats = controller.GetStats();
+        CHECK(stats.marginMilliseconds < 0.6);
+        CHECK(stats.missedVblanks == 1);
+
+        // Never past the maximum, however late.
+        now = display.GetNextVblank(done) + 1000;
+        RunFrame(&controller, &display, now, 3000, 40000, &start);
+        CHECK(controller.GetStats().marginMilliseconds == 8.0);
+    }
+
+    // With variable refresh there is no vblank to aim at: frames start at
+    // once and are shown when done.
+    void TestVariableRefresh()
+    {
+        FrameLatencySettings settings;
+        settings.variableRefresh = true;
+        FrameLatencyController controller(settings);
+        SimulatedDisplay display;
+        int64_t now = display.GetVblank(1) + 1000;
+        int64_t start = 0;
+        for (int frame = 0; frame < 20; frame++)
+        {
+            const int64_t done = RunFrame(&controller, &display, now, 3000, 4000, &start);
+            CHECK(start == now);
+            now = done + 200;
+        }
+        FrameLatencyStats stats = controller.GetStats();
+        CHECK(Near(stats.latencyMilliseconds, 7.0));
+        CHECK(stats.lastDelayMilliseconds == 0.0);
+
+        // Turned off, the same controller starts holding frames.
+        settings.variableRefresh = false;
+        controller.SetSettings(settings);
+        now = display.GetNextVblank(now) + 1000;
+        RunFrame(&controller, &display, now, 3000, 4000, &start);
+        CHECK(start > now);
+
+        // And on again, not.
+        settings.variableRefresh = true;
+        controller.SetSettings(settings);
+        now += Refresh;
+        RunFrame(&controller, &display, now, 3000, 4000, &start);
+        CHECK(start == now);
+    }
+}
+
+int main()
+{
+    TestRefreshPeriod();
+    TestNoHoldWithoutHistory();
+    TestHoldsStartBeforeVblank();
+    TestNoHoldWithoutSlack();
+    TestMissedVblankBacksOff();
+    TestVariableRefresh();
+    return TestFailures();
+}
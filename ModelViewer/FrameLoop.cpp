@@ -0,0 +1,190 @@
+#include "FrameLoop.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+namespace
+{
+    // Bounds of the spin margin: below the minimum spinning is cheap enough to
+    // always do, above the maximum the platform's sleep is not worth using.
+    const int64_t MinSpinMicroseconds = 100;
+    const int64_t MaxSpinMicroseconds = 20000;
+
+    // Longer gaps (a breakpoint, a dragged window) are not caught up.
+    const int64_t MaxFrameMicroseconds = 250000;
+
+    inline int64_t ToMicroseconds(double rate)
+    {
+        return static_cast<int64_t>(1000000.0 / rate);
+    }
+}
+
+int64_t SteadyFrameClock::NowMicroseconds()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void SteadyFrameClock::SleepMicroseconds(int64_t microseconds)
+{
+    std::this_thread::sleep_for(std::chrono::microseconds(microseconds));
+}
+
+void SteadyFrameClock::Spin()
+{
+    std::this_thread::yield();
+}
+
+FrameLoop::FrameLoop(FrameClock& clock, const FrameLoopSettings& settings) :
+    _clock(clock),
+    _settings(settings),
+    _spinMargin(static_cast<int64_t>(settings.initialSpinMilliseconds * 1000.0))
+{
+    _frameTimes.reserve(FrameHistory);
+}
+
+void FrameLoop::SetSettings(const FrameLoopSettings& settings)
+{
+    _settings = settings;
+}
+
+void FrameLoop::SetMinimized(bool minimized)
+{
+    // Time spent minimized is neither simulated nor counted as a frame.
+    if (_minimized && !minimized)
+    {
+        _started = false;
+    }
+    _minimized = minimized;
+}
+
+void FrameLoop::RunFrame(const UpdateFunction& update, const RenderFunction& render)
+{
+    if (_minimized)
+    {
+        WaitUntil(_clock.NowMicroseconds() + ToMicroseconds(_settings.minimizedFrameRate));
+        return;
+    }
+
+    const bool firstFrame = !_started;
+    if (firstFrame)
+    {
+        _lastFrameTime = _clock.NowMicroseconds();
+        _nextFrameTime = _lastFrameTime;
+        _accumulator = 0;
+        _started = true;
+    }
+
+    if (_settings.targetFrameRate > 0.0)
+    {
+        WaitUntil(_nextFrameTime);
+    }
+
+    const int64_t now = _clock.NowMicroseconds();
+    const int64_t elapsed = now - _lastFrameTime;
+    _lastFrameTime = now;
+    if (!firstFrame)
+    {
+        RecordFrameTime(elapsed);
+    }
+
+    // Keep the phase when a frame was a little late, start over when it
+    // missed a whole interval.
+    if (_settings.targetFrameRate > 0.0)
+    {
+        const int64_t interval = ToMicroseconds(_settings.targetFrameRate);
+        _nextFrameTime += interval;
+        if (_nextFrameTime < now)
+        {
+            _nextFrameTime = now + interval;
+        }
+    }
+
+    const int64_t step = ToMicroseconds(_settings.fixedUpdateRate);
+    _accumulator += std::min(elapsed, MaxFrameMicroseconds);
+
+    _updatesLastFrame = 0;
+    while (_accumulator >= step)
+    {
+        if (_updatesLastFrame == _settings.maxUpdatesPerFrame)
+        {
+            _droppedUpdates += static_cast<uint64_t>(_accumulator / step);
+            _accumulator %= step;
+            break;
+        }
+        update(step / 1000000.0);
+        _accumulator -= step;
+        _updatesLastFrame++;
+    }
+
+    render(static_cast<double>(_accumulator) / step);
+    _frames++;
+}
+
+// One sleep, then spinning: sleeping again for what is left would overshoot
+// just the same, and shrink the margin once per sleep instead of per wait.
+void FrameLoop::WaitUntil(int64_t deadline)
+{
+    const int64_t start = _clock.NowMicroseconds();
+    const int64_t request = deadline - start - _spinMargin;
+    if (request > 0)
+    {
+        _clock.SleepMicroseconds(request);
+
+        // Grow the margin at once when a sleep overshoots it, shrink it slowly
+        // while sleeps are more accurate than assumed.
+        const int64_t overshoot = std::max<int64_t>(_clock.NowMicroseconds() - start - request, 0);
+        _spinMargin = overshoot > _spinMargin ? overshoot : _spinMargin - (_spinMargin - overshoot) / 64;
+        _spinMargin = std::min(std::max(_spinMargin, MinSpinMicroseconds), MaxSpinMicroseconds);
+    }
+
+    while (_clock.NowMicroseconds() < deadline)
+    {
+        _clock.Spin();
+    }
+}
+
+void FrameLoop::RecordFrameTime(int64_t microseconds)
+{
+    if (_frameTimes.size() < FrameHistory)
+    {
+        _frameTimes.push_back(microseconds);
+    }
+    else
+    {
+        _frameTimes[_recordedFrameTimes % FrameHistory] = microseconds;
+    }
+    _recordedFrameTimes++;
+}
+
+FrameLoopStats FrameLoop::GetStats() const
+{
+    FrameLoopStats stats = {};
+    stats.frames = _frames;
+    stats.updatesLastFrame = _updatesLastFrame;
+    stats.droppedUpdates = _droppedUpdates;
+    stats.spinMarginMilliseconds = _spinMargin / 1000.0;
+
+    if (_frameTimes.empty())
+    {
+        return stats;
+    }
+
+    std::vector<int64_t> sorted(_frameTimes);
+    std::sort(sorted.begin(), sorted.end());
+
+    int64_t total = 0;
+    for (int64_t frameTime : sorted)
+    {
+        total += frameTime;
+    }
+
+    const size_t count = sorted.size();
+    stats.averageMilliseconds = total / 1000.0 / count;
+    stats.p50Milliseconds = sorted[GetNearestRankIndex(count, 0.50)] / 1000.0;
+    stats.p95Milliseconds = sorted[GetNearestRankIndex(count, 0.95)] / 1000.0;
+    stats.p99Milliseconds = sorted[GetNearestRankIndex(count, 0.99)] / 1000.0;
+    stats.maxMilliseconds = sorted.back() / 1000.0;
+    return stats;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Time source of the frame loop; replaced by a fake clock in tests.
+class FrameClock
+{
+public: virtual ~FrameClock() {}
+
+public: virtual int64_t NowMicroseconds() = 0;
+
+    // May oversleep by the platform's timer granularity; the loop measures by
+    // how much and spins the rest of the way.
+public: virtual void SleepMicroseconds(int64_t microseconds) = 0;
+
+    // Called while spinning on the last stretch before a deadline.
+public: virtual void Spin() {}
+};
+
+// std::chrono::steady_clock and std::this_thread::sleep_for.
+class SteadyFrameClock : public FrameClock
+{
+public: virtual int64_t NowMicroseconds();
+public: virtual void SleepMicroseconds(int64_t microseconds);
+public: virtual void Spin();
+};
+
+struct FrameLoopSettings
+{
+    double targetFrameRate = 0.0;           // 0 renders as fast as presentation allows.
+    double fixedUpdateRate = 60.0;          // Simulation steps per second.
+    uint32_t maxUpdatesPerFrame = 5;        // Further steps are dropped instead of caught up.
+    double minimizedFrameRate = 10.0;       // Wake-ups per second while minimized; nothing is rendered.
+    double initialSpinMilliseconds = 2.0;   // Starting guess of how much a sleep can overshoot.
+};
+
+struct FrameLoopStats
+{
+    uint64_t frames;
+    double averageMilliseconds;             // Over the last FrameHistory frames.
+    double p50Milliseconds;
+    double p95Milliseconds;
+    double p99Milliseconds;
+    double maxMilliseconds;
+    uint32_t updatesLastFrame;
+    uint64_t droppedUpdates;
+    double spinMarginMilliseconds;
+};
+
+// Paces frames and runs the simulation at a fixed rate independent of the
+// frame rate. Every RunFrame() waits until the frame is due (sleeping most of
+// the way, then spinning for the part sleeping cannot hit precisely), runs as
+// many fixed updates as the elapsed time calls for and renders once with the
+// fraction of a step left over, for interpolating between the last two
+// simulation states. While minimized it only sleeps.
+class FrameLoop
+{
+public: typedef std::function<void(double stepSeconds)> UpdateFunction;
+public: typedef std::function<void(double interpolation)> RenderFunction;
+
+public: static const uint32_t FrameHistory = 240;
+
+public: FrameLoop(FrameClock& clock, const FrameLoopSettings& settings = FrameLoopSettings());
+
+public: void SetSettings(const FrameLoopSettings& settings);
+public: const FrameLoopSettings& GetSettings() const { return _settings; }
+
+public: void SetMinimized(bool minimized);
+
+public: void RunFrame(const UpdateFunction& update, const RenderFunction& render);
+
+    // Sleeps, then spins, until the clock reaches deadline; for callers that
+    // pace something else with the loop's clock.
+public: void WaitUntil(int64_t deadline);
+public: FrameClock& GetClock() { return _clock; }
+
+    // Percentiles are over the recent history; computing them sorts a copy.
+public: FrameLoopStats GetStats() const;
+
+private: void RecordFrameTime(int64_t microseconds);
+
+private: FrameClock& _clock;
+private: FrameLoopSettings _settings;
+private: bool _minimized = false;
+
+private: bool _started = false;
+private: int64_t _lastFrameTime = 0;
+private: int64_t _nextFrameTime = 0;
+private: int64_t _accumulator = 0;
+private: int64_t _spinMargin = 0;
+
+private: std::vector<int64_t> _frameTimes;      // Ring of FrameHistory entries.
+private: uint64_t _recordedFrameTimes = 0;
+private: uint64_t _frames = 0;
+private: uint32_t _updatesLastFrame = 0;
+private: uint64_t _droppedUpdates = 0;
+};
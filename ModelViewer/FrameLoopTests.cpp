@@ -0,0 +1,290 @@
+#include "FrameLoop.h"
+#include "UnitTest.h"
+
+#include <cmath>
+#include <vector>
+
+namespace
+{
+    // Time only moves when the loop sleeps or spins, or the test says so.
+    // Sleeps overshoot by whatever the test sets.
+    class ScriptedClock : public FrameClock
+    {
+    public: virtual int64_t NowMicroseconds() { return now; }
+
+    public: virtual void SleepMicroseconds(int64_t microseconds)
+        {
+            now += microseconds + oversleep;
+            sleeps++;
+        }
+
+    public: virtual void Spin()
+        {
+            now += spinStep;
+            spins++;
+        }
+
+    public: int64_t now = 1000000;
+    public: int64_t oversleep = 0;
+    public: int64_t spinStep = 10;
+    public: uint64_t sleeps = 0;
+    public: uint64_t spins = 0;
+    };
+
+    // What one RunFrame() did.
+    struct FrameRecord
+    {
+        std::vector<double> steps;
+        std::vector<double> interpolations;
+
+        void Run(FrameLoop* pLoop)
+        {
+            pLoop->RunFrame(
+                [this](double stepSeconds) { steps.push_back(stepSeconds); },
+                [this](double interpolation) { interpolations.push_back(interpolation); });
+        }
+
+        void Clear()
+        {
+            steps.clear();
+            interpolations.clear();
+        }
+    };
+
+    const int64_t Step = 1000000 / 60;
+
+    // Updates run once per whole step of elapsed time; the remainder carries
+    // over and is what render interpolates by.
+    void TestFixedStepAccumulation()
+    {
+        ScriptedClock clock;
+        FrameLoop loop(clock);
+        FrameRecord record;
+
+        // The first frame has nothing to catch up on.
+        record.Run(&loop);
+        CHECK(record.steps.empty());
+        CHECK(record.interpolations.size() == 1 && record.interpolations[0] == 0.0);
+
+        record.Clear();
+        clock.now += Step + Step / 2;
+        record.Run(&loop);
+        CHECK(record.steps.size() == 1);
+        CHECK(std::fabs(record.steps[0] - Step / 1000000.0) < 1e-12);
+        CHECK(std::fabs(record.interpolations[0] - 0.5) < 1e-3);
+
+        // The half step left over adds up with the next half.
+        record.Clear();
+        clock.now += Step / 2 + 1;
+        record.Run(&loop);
+        CHECK(record.steps.size() == 1);
+        CHECK(record.interpolations[0] < 1e-3);
+
+        // 100 frames of a third of a step each give 33 steps and keep the rest.
+        record.Clear();
+        for (int i = 0; i < 100; i++)
+        {
+            clock.now += Step / 3;
+            record.Run(&loop);
+        }
+        CHECK(record.steps.size() == 33);
+        CHECK(record.interpolations.size() == 100);
+        for (double interpolation : record.interpolations)
+        {
+            CHECK(interpolation >= 0.0 && interpolation < 1.0);
+        }
+        CHECK(loop.GetStats().frames == 103);
+        CHECK(loop.GetStats().droppedUpdates == 0);
+    }
+
+    // A slow frame runs at most maxUpdatesPerFrame steps and drops the rest;
+    // a stall past MaxFrameMicroseconds only counts as a quarter second.
+    void TestUpdateLimits()
+    {
+        ScriptedClock clock;
+        FrameLoopSettings settings;
+        settings.maxUpdatesPerFrame = 5;
+        FrameLoop loop(clock, settings);
+        FrameRecord record;
+        record.Run(&loop);
+
+        record.Clear();
+        clock.now += 12 * Step + Step / 4;
+        record.Run(&loop);
+        CHECK(record.steps.size() == 5);
+        CHECK(loop.GetStats().updatesLastFrame == 5);
+        CHECK(loop.GetStats().droppedUpdates == 7);
+        CHECK(std::fabs(record.interpolations[0] - 0.25) < 1e-3);
+
+        settings.maxUpdatesPerFrame = 100;
+        loop.SetSettings(settings);
+        record.Clear();
+        clock.now += 10000000;
+        record.Run(&loop);
+        CHECK(record.steps.size() == static_cast<size_t>(250000 / Step));
+        CHECK(loop.GetStats().droppedUpdates == 7);
+
+        // The stall still shows up in the frame times.
+        CHECK(loop.GetStats().maxMilliseconds == 10000.0);
+    }
+
+    // With a target rate, frames start on their deadline: never early, and
+    // late by no more than a spin.
+    void TestPacing()
+    {
+        ScriptedClock clock;
+        FrameLoopSettings settings;
+        settings.targetFrameRate = 100.0;
+        FrameLoop loop(clock, settings);
+
+        std::vector<int64_t> starts;
+        for (int i = 0; i < 50; i++)
+        {
+            loop.RunFrame([](double) {}, [&](double) { starts.push_back(clock.now); clock.now += 3000; });
+        }
+        for (size_t i = 1; i < starts.size(); i++)
+        {
+            const int64_t deadline = starts[0] + static_cast<int64_t>(i) * 10000;
+            CHECK(starts[i] >= deadline);
+            CHECK(starts[i] < deadline + clock.spinStep);
+        }
+        CHECK(clock.sleeps >= 49);
+
+        // A frame that took longer than the interval starts the next one
+        // right away and does not try to make up for it.
+        loop.RunFrame([](double) {}, [&](double) { clock.now += 25000; });
+        const int64_t late = clock.now;
+        loop.RunFrame([](double) {}, [&](double) { starts.push_back(clock.now); });
+        CHECK(starts.back() == late);
+        loop.RunFrame([](double) {}, [&](double) { starts.push_back(clock.now); });
+        CHECK(starts.back() >= late + 10000 && starts.back() < late + 10000 + clock.spinStep);
+    }
+
+    // The spin margin grows at once to a sleep's overshoot and shrinks back
+    // slowly once sleeps are accurate, within its bounds.
+    void TestSpinMargin()
+    {
+        ScriptedClock clock;
+        FrameLoopSettings settings;
+        settings.initialSpinMilliseconds = 2.0;
+        FrameLoop loop(clock, settings);
+        CHECK(loop.GetStats().spinMarginMilliseconds == 2.0);
+
+        clock.oversleep = 3000;
+        loop.WaitUntil(clock.now + 20000);
+        CHECK(loop.GetStats().spinMarginMilliseconds == 3.0);
+
+        // Overshooting past the deadline still returns, late.
+        clock.oversleep = 8000;
+        const int64_t deadline = clock.now + 5000;
+        loop.WaitUntil(deadline);
+        CHECK(clock.now >= deadline);
+        CHECK(loop.GetStats().spinMarginMilliseconds == 8.0);
+
+        // Accurate sleeps: each shrinks the margin by 1/64 of the way down.
+        clock.oversleep = 0;
+        double previous = loop.GetStats().spinMarginMilliseconds;
+        for (int i = 0; i < 20; i++)
+        {
+            loop.WaitUntil(clock.now + 30000);
+            const double margin = loop.GetStats().spinMarginMilliseconds;
+            CHECK(margin < previous);
+            CHECK(margin > previous * 0.95);
+            previous = margin;
+        }
+        for (int i = 0; i < 2000; i++)
+        {
+            loop.WaitUntil(clock.now + 30000);
+        }
+        CHECK(loop.GetStats().spinMarginMilliseconds == 0.1);
+
+        // A sleep far off is capped at 20 ms of spinning.
+        clock.oversleep = 100000;
+        loop.WaitUntil(clock.now + 200000);
+        CHECK(loop.GetStats().spinMarginMilliseconds == 20.0);
+    }
+
+    // Minimized, frames only sleep at the minimized rate. Coming back starts
+    // over: the time away is neither simulated nor counted as a frame.
+    void TestMinimized()
+    {
+        ScriptedClock clock;
+        FrameLoopSettings settings;
+        settings.minimizedFrameRate = 10.0;
+        FrameLoop loop(clock, settings);
+        FrameRecord record;
+        record.Run(&loop);
+        clock.now += Step;
+        record.Run(&loop);
+        CHECK(record.steps.size() == 1);
+
+        loop.SetMinimized(true);
+        record.Clear();
+        const int64_t minimizedAt = clock.now;
+        for (int i = 0; i < 20; i++)
+        {
+            record.Run(&loop);
+        }
+        CHECK(record.steps.empty() && record.interpolations.empty());
+        CHECK(clock.now >= minimizedAt + 20 * 100000);
+        CHECK(clock.now < minimizedAt + 20 * 100000 + 20 * clock.spinStep);
+        CHECK(loop.GetStats().frames == 2);
+
+        loop.SetMinimized(false);
+        record.Run(&loop);
+        CHECK(record.steps.empty());
+        CHECK(record.interpolations.size() == 1 && record.interpolations[0] == 0.0);
+        CHECK(loop.GetStats().maxMilliseconds < 100.0);
+
+        clock.now += Step;
+        record.Run(&loop);
+        CHECK(record.steps.size() == 1);
+        CHECK(loop.GetStats().frames == 4);
+    }
+
+    // Percentiles are nearest rank over the last FrameHistory frames.
+    void TestStats()
+    {
+        ScriptedClock clock;
+        FrameLoop loop(clock);
+        FrameRecord record;
+        record.Run(&loop);
+        CHECK(loop.GetStats().p99Milliseconds == 0.0);
+
+        // 1 to 100 ms, shuffled.
+        for (int i = 0; i < 100; i++)
+        {
+            clock.now += ((i * 37) % 100 + 1) * 1000;
+            record.Run(&loop);
+        }
+        FrameLoopStats stats = loop.GetStats();
+        CHECK(stats.frames == 101);
+        CHECK(stats.p50Milliseconds == 50.0);
+        CHECK(stats.p95Milliseconds == 95.0);
+        CHECK(stats.p99Milliseconds == 99.0);
+        CHECK(stats.maxMilliseconds == 100.0);
+        CHECK(std::fabs(stats.averageMilliseconds - 50.5) < 1e-9);
+
+        // A full history of 2 ms frames pushes them all out.
+        for (uint32_t i = 0; i < FrameLoop::FrameHistory; i++)
+        {
+            clock.now += 2000;
+            record.Run(&loop);
+        }
+        stats = loop.GetStats();
+        CHECK(stats.maxMilliseconds == 2.0);
+        CHECK(stats.p50Milliseconds == 2.0);
+        CHECK(stats.averageMilliseconds == 2.0);
+    }
+}
+
+int main()
+{
+    TestFixedStepAccumulation();
+    TestUpdateLimits();
+    TestPacing();
+    TestSpinMargin();
+    TestMinimized();
+    TestStats();
+    return TestFailures();
+}
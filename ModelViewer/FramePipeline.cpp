@@ -0,0 +1,173 @@
+#include "FramePipeline.h"
+#include "Profiler.h"
+
+#include <chrono>
+
+FramePipeline::FramePipeline(BuildFunction build, bool threaded) :
+    _build(std::move(build))
+{
+    SetThreaded(threaded);
+}
+
+FramePipeline::~FramePipeline()
+{
+    StopThread();
+}
+
+void FramePipeline::SetThreaded(bool threaded)
+{
+    if (threaded == _threaded)
+    {
+        return;
+    }
+
+    if (threaded)
+    {
+        StartThread();
+    }
+    else
+    {
+        StopThread();
+    }
+    _threaded = threaded;
+    _stats.threaded = threaded;
+}
+
+const FramePacket& FramePipeline::BeginFrame()
+{
+    if (!_threaded)
+    {
+        RethrowBuildError();
+
+        // Left over from threaded mode when one is still fresh.
+        if (!_packets.Acquire())
+        {
+            _stats.buildMilliseconds = Build();
+            _stats.packetsBuilt++;
+            _packets.Publish();
+            _packets.Acquire();
+        }
+        _stats.waitMilliseconds = 0.0;
+        return _packets.GetReadBuffer();
+    }
+
+    const auto waitStart = std::chrono::steady_clock::now();
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _published.wait(lock, [this]() { return _publishedCount == _requestedCount; });
+        RethrowBuildError();
+
+        // Nothing built ahead on the first frame or after a failed build:
+        // build this one now.
+        if (!_packets.HasFresh())
+        {
+            _requestedCount++;
+            _kick.notify_one();
+            _published.wait(lock, [this]() { return _publishedCount == _requestedCount; });
+            RethrowBuildError();
+        }
+
+        _packets.Acquire();
+        _stats.buildMilliseconds = _lastBuildMilliseconds;
+        _stats.packetsBuilt = _packetsBuilt;
+
+        // The update thread builds the next packet while the caller records this one.
+        _requestedCount++;
+        _kick.notify_one();
+    }
+    const auto waitEnd = std::chrono::steady_clock::now();
+    _stats.waitMilliseconds = std::chrono::duration<double, std::milli>(waitEnd - waitStart).count();
+
+    return _packets.GetReadBuffer();
+}
+
+double FramePipeline::Build()
+{
+    PROFILE_SCOPE("BuildFramePacket");
+    const auto buildStart = std::chrono::steady_clock::now();
+
+    FramePacket& packet = _packets.GetWriteBuffer();
+    packet.frameNumber = _nextFrameNumber++;
+    _build(packet);
+
+    const auto buildEnd = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(buildEnd - buildStart).count();
+}
+
+void FramePipeline::RethrowBuildError()
+{
+    if (_error)
+    {
+        std::exception_ptr error = _error;
+        _error = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+void FramePipeline::StartThread()
+{
+    _stopping = false;
+    _packetsBuilt = _stats.packetsBuilt;
+    _thread = std::thread(&FramePipeline::UpdateMain, this);
+}
+
+// The packet in flight is finished first; it stays fresh in the triple buffer
+// for the next BeginFrame().
+void FramePipeline::StopThread()
+{
+    if (!_thread.joinable())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _kick.notify_one();
+    _thread.join();
+
+    _stats.buildMilliseconds = _lastBuildMilliseconds;
+    _stats.packetsBuilt = _packetsBuilt;
+}
+
+void FramePipeline::UpdateMain()
+{
+    CpuProfiler::Get().SetThreadName("Update");
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    for (;;)
+    {
+        _kick.wait(lock, [this]() { return _stopping || _requestedCount > _publishedCount; });
+        if (_requestedCount == _publishedCount)
+        {
+            return;
+        }
+
+        lock.unlock();
+        std::exception_ptr error;
+        double milliseconds = 0.0;
+        try
+        {
+            milliseconds = Build();
+            _packets.Publish();
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+        lock.lock();
+
+        if (error)
+        {
+            _error = error;
+        }
+        else
+        {
+            _lastBuildMilliseconds = milliseconds;
+            _packetsBuilt++;
+        }
+        _publishedCount++;
+        _published.notify_one();
+    }
+}
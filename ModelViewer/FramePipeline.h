@@ -0,0 +1,85 @@
+#pragma once
+
+#include "ClusteredLights.h"
+#include "DrawBatcher.h"
+#include "TripleBuffer.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Everything the renderer needs from the simulation for one frame. Built by
+// the update side, then only read by the render side, so recording never
+// touches live simulation state.
+struct FramePacket
+{
+    uint64_t frameNumber = 0;
+    float view[16] = {};
+    float viewProjection[16] = {};
+    DrawBatcher draws;      // Visible instances grouped into batches, with their transforms.
+    ClusterLightAssigner lights;    // The scene's lights sorted into the clusters of the view.
+};
+
+struct FramePipelineStats
+{
+    uint64_t packetsBuilt;
+    double buildMilliseconds;           // Of the last packet.
+    double waitMilliseconds;            // The render thread spent blocked in the last BeginFrame().
+    bool threaded;
+};
+
+// Feeds frame packets to the render thread. Sequential mode builds the packet
+// inside BeginFrame(). Threaded mode builds on an update thread one frame
+// ahead: BeginFrame() takes the packet built during the previous frame and
+// starts the next, so building frame N + 1 overlaps recording frame N. The
+// packets travel through a TripleBuffer; the mutex only wakes up the sides.
+class FramePipeline
+{
+public: typedef std::function<void(FramePacket& packet)> BuildFunction;
+
+    // build runs on the update thread in threaded mode; it must not share
+    // unsynchronized state with the render thread.
+public: FramePipeline(BuildFunction build, bool threaded);
+public: ~FramePipeline();
+
+public: FramePipeline(const FramePipeline&) = delete;
+public: FramePipeline& operator=(const FramePipeline&) = delete;
+
+    // Switching waits for the packet in flight, which is then the next one
+    // handed out, so no simulated frame gets lost.
+public: void SetThreaded(bool threaded);
+public: bool IsThreaded() const { return _threaded; }
+
+    // Render thread. The packet stays valid until the next call. Rethrows
+    // what the build function threw on the update thread.
+public: const FramePacket& BeginFrame();
+
+public: const FramePipelineStats& GetStats() const { return _stats; }
+
+private: double Build();
+private: void RethrowBuildError();
+private: void StartThread();
+private: void StopThread();
+private: void UpdateMain();
+
+private: BuildFunction _build;
+private: TripleBuffer<FramePacket> _packets;
+private: uint64_t _nextFrameNumber = 0;
+private: bool _threaded = false;
+private: FramePipelineStats _stats = {};
+
+    // Guarded by _mutex while the update thread runs.
+private: std::thread _thread;
+private: std::mutex _mutex;
+private: std::condition_variable _kick;
+private: std::condition_variable _published;
+private: uint64_t _requestedCount = 0;
+private: uint64_t _publishedCount = 0;
+private: double _lastBuildMilliseconds = 0.0;
+private: uint64_t _packetsBuilt = 0;
+private: bool _stopping = false;
+private: std::exception_ptr _error;
+};
@@ -0,0 +1,265 @@
+#include "FramePipeline.h"
+#include "UnitTest.h"
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    // Published values replace each other; the reader gets the newest and
+    // keeps it until something newer arrives.
+    void TestTripleBufferOrdering()
+    {
+        TripleBuffer<int> buffer;
+        CHECK(!buffer.HasFresh());
+        CHECK(!buffer.Acquire());
+
+        buffer.GetWriteBuffer() = 1;
+        buffer.Publish();
+        CHECK(buffer.HasFresh());
+        buffer.GetWriteBuffer() = 2;
+        buffer.Publish();
+        CHECK(buffer.Acquire());
+        CHECK(buffer.GetReadBuffer() == 2);
+        CHECK(!buffer.HasFresh());
+        CHECK(!buffer.Acquire());
+        CHECK(buffer.GetReadBuffer() == 2);
+
+        buffer.GetWriteBuffer() = 3;
+        buffer.Publish();
+        CHECK(buffer.Acquire());
+        CHECK(buffer.GetReadBuffer() == 3);
+    }
+
+    // Whatever the interleaving, the writer's buffer is never the one the
+    // reader holds, and the reader only ever moves forward.
+    void TestTripleBufferSlots()
+    {
+        TripleBuffer<int> buffer;
+        uint32_t random = 7;
+        int written = 0;
+        int lastRead = 0;
+        for (int i = 0; i < 10000; i++)
+        {
+            random = random * 1664525u + 1013904223u;
+            if ((random >> 16) & 1)
+            {
+                buffer.GetWriteBuffer() = ++written;
+                buffer.Publish();
+            }
+            else if (buffer.Acquire())
+            {
+                CHECK(buffer.GetReadBuffer() == written);
+                CHECK(buffer.GetReadBuffer() > lastRead);
+                lastRead = buffer.GetReadBuffer();
+            }
+            CHECK(&buffer.GetWriteBuffer() != &buffer.GetReadBuffer());
+        }
+    }
+
+    struct Payload
+    {
+        uint64_t sequence;
+        uint64_t words[64];
+    };
+
+    // A writer thread publishing as fast as it can against a reader that
+    // holds each value for a while: a torn or overwritten value shows up as
+    // words that disagree with the sequence number.
+    void TestTripleBufferThreaded()
+    {
+        TripleBuffer<Payload> buffer;
+        const uint64_t count = 200000;
+        std::atomic<bool> done(false);
+        std::thread writer([&]()
+        {
+            for (uint64_t sequence = 1; sequence <= count; sequence++)
+            {
+                Payload& payload = buffer.GetWriteBuffer();
+                payload.sequence = sequence;
+                for (uint64_t& word : payload.words)
+                {
+                    word = sequence;
+                }
+                buffer.Publish();
+            }
+            done = true;
+        });
+
+        uint64_t reads = 0;
+        uint64_t torn = 0;
+        uint64_t lastSequence = 0;
+        bool ordered = true;
+        while (!done || buffer.HasFresh())
+        {
+            if (!buffer.Acquire())
+            {
+                continue;
+            }
+            const Payload& payload = buffer.GetReadBuffer();
+            const uint64_t sequence = payload.sequence;
+            ordered = ordered && sequence > lastSequence;
+            lastSequence = sequence;
+            for (int pass = 0; pass < 4; pass++)
+            {
+                for (uint64_t word : payload.words)
+                {
+                    torn += word != sequence ? 1 : 0;
+                }
+                std::this_thread::yield();
+            }
+            torn += payload.sequence != sequence ? 1 : 0;
+            reads++;
+        }
+        writer.join();
+
+        CHECK(torn == 0);
+        CHECK(ordered);
+        CHECK(reads > 0);
+        CHECK(lastSequence == count);
+    }
+
+    // Each packet's contents follow its frame number, to check nothing was
+    // written to a packet while the render side held it.
+    void FillPacket(FramePacket& packet)
+    {
+        for (float& value : packet.view)
+        {
+            value = static_cast<float>(packet.frameNumber);
+        }
+    }
+
+    bool PacketIntact(const FramePacket& packet, uint64_t frameNumber)
+    {
+        bool intact = packet.frameNumber == frameNumber;
+        for (float value : packet.view)
+        {
+            intact = intact && value == static_cast<float>(frameNumber);
+        }
+        return intact;
+    }
+
+    // Inline, BeginFrame() builds the packet on the calling thread.
+    void TestInline()
+    {
+        std::vector<std::thread::id> builders;
+        FramePipeline pipeline([&](FramePacket& packet)
+        {
+            builders.push_back(std::this_thread::get_id());
+            FillPacket(packet);
+        }, false);
+        CHECK(!pipeline.IsThreaded());
+
+        for (uint64_t frame = 0; frame < 5; frame++)
+        {
+            const FramePacket& packet = pipeline.BeginFrame();
+            CHECK(PacketIntact(packet, frame));
+            CHECK(builders.size() == frame + 1);
+        }
+        for (std::thread::id id : builders)
+        {
+            CHECK(id == std::this_thread::get_id());
+        }
+        CHECK(pipeline.GetStats().packetsBuilt == 5);
+        CHECK(!pipeline.GetStats().threaded);
+        CHECK(pipeline.GetStats().waitMilliseconds == 0.0);
+    }
+
+    // Threaded, packet N + 1 is built on the update thread while the caller
+    // still holds packet N, which stays untouched; frames come in order.
+    void TestThreaded()
+    {
+        std::atomic<uint64_t> building(UINT64_MAX);
+        std::atomic<bool> onOtherThread(true);
+        const std::thread::id renderThread = std::this_thread::get_id();
+        FramePipeline pipeline([&](FramePacket& packet)
+        {
+            onOtherThread = onOtherThread && std::this_thread::get_id() != renderThread;
+            FillPacket(packet);
+            building = packet.frameNumber;
+        }, true);
+        CHECK(pipeline.IsThreaded());
+
+        for (uint64_t frame = 0; frame < 50; frame++)
+        {
+            const FramePacket& packet = pipeline.BeginFrame();
+            CHECK(PacketIntact(packet, frame));
+
+            // Wait for the build of the next packet, then look again.
+            for (int i = 0; i < 10000 && building != frame + 1; i++)
+            {
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+            CHECK(building == frame + 1);
+            CHECK(PacketIntact(packet, frame));
+        }
+        CHECK(onOtherThread);
+        CHECK(pipeline.GetStats().threaded);
+        CHECK(pipeline.GetStats().packetsBuilt >= 50);
+    }
+
+    // Switching either way neither loses nor repeats a frame: the packet
+    // built ahead is the next one handed out.
+    void TestSwitching()
+    {
+        FramePipeline pipeline([](FramePacket& packet) { FillPacket(packet); }, false);
+        uint64_t expected = 0;
+        for (int round = 0; round < 6; round++)
+        {
+            for (int i = 0; i < 4; i++)
+            {
+                CHECK(PacketIntact(pipeline.BeginFrame(), expected));
+                expected++;
+            }
+            pipeline.SetThreaded(!pipeline.IsThreaded());
+            CHECK(pipeline.GetStats().threaded == pipeline.IsThreaded());
+        }
+        CHECK(PacketIntact(pipeline.BeginFrame(), expected));
+    }
+
+    // A build that throws surfaces from BeginFrame() on the render thread,
+    // and the pipeline carries on with the next frame.
+    void TestBuildErrors()
+    {
+        for (bool threaded : { false, true })
+        {
+            FramePipeline pipeline([](FramePacket& packet)
+            {
+                if (packet.frameNumber == 2)
+                {
+                    throw std::runtime_error("build failed");
+                }
+                FillPacket(packet);
+            }, threaded);
+
+            CHECK(PacketIntact(pipeline.BeginFrame(), 0));
+            CHECK(PacketIntact(pipeline.BeginFrame(), 1));
+            bool threw = false;
+            try
+            {
+                pipeline.BeginFrame();
+            }
+            catch (const std::runtime_error&)
+            {
+                threw = true;
+            }
+            CHECK(threw);
+            CHECK(PacketIntact(pipeline.BeginFrame(), 3));
+        }
+    }
+}
+
+int main()
+{
+    TestTripleBufferOrdering();
+    TestTripleBufferSlots();
+    TestTripleBufferThreaded();
+    TestInline();
+    TestThreaded();
+    TestSwitching();
+    TestBuildErrors();
+    return TestFailures();
+}
@@ -0,0 +1,208 @@
+#include "GpuMemoryTracker.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace
+{
+    // Budget moves smaller than this fraction are noise, not events.
+    const uint64_t BudgetChangeDivisor = 64;
+
+    const char* GetMemorySegmentName(MemorySegment segment)
+    {
+        return segment == MemorySegment::Local ? "local" : "nonLocal";
+    }
+}
+
+const char* GetMemoryCategoryName(MemoryCategory category)
+{
+    switch (category)
+    {
+    case MemoryCategory::Mesh: return "mesh";
+    case MemoryCategory::Texture: return "texture";
+    case MemoryCategory::RenderTarget: return "renderTarget";
+    case MemoryCategory::Upload: return "upload";
+    case MemoryCategory::Descriptor: return "descriptor";
+    default: return "other";
+    }
+}
+
+GpuMemoryTracker& GpuMemoryTracker::Get()
+{
+    static GpuMemoryTracker tracker;
+    return tracker;
+}
+
+uint64_t GpuMemoryTracker::Track(MemoryCategory category, uint64_t bytes, const char* name)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    const uint64_t id = _nextId++;
+    _allocations[id] = { id, category, bytes, name != nullptr ? name : "" };
+
+    MemoryCategoryCounters& counters = _categories[static_cast<size_t>(category)];
+    counters.liveBytes += bytes;
+    counters.peakBytes = std::max(counters.peakBytes, counters.liveBytes);
+    counters.liveAllocations++;
+    counters.totalAllocations++;
+
+    _liveBytes += bytes;
+    _peakBytes = std::max(_peakBytes, _liveBytes);
+    return id;
+}
+
+void GpuMemoryTracker::Release(uint64_t id)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::unordered_map<uint64_t, GpuMemoryAllocation>::iterator found = _allocations.find(id);
+    if (found == _allocations.end())
+    {
+        return;
+    }
+
+    MemoryCategoryCounters& counters = _categories[static_cast<size_t>(found->second.category)];
+    counters.liveBytes -= found->second.bytes;
+    counters.liveAllocations--;
+    _liveBytes -= found->second.bytes;
+    _allocations.erase(found);
+}
+
+MemoryCategoryCounters GpuMemoryTracker::GetCounters(MemoryCategory category)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _categories[static_cast<size_t>(category)];
+}
+
+uint64_t GpuMemoryTracker::GetLiveBytes()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _liveBytes;
+}
+
+void GpuMemoryTracker::UpdateBudget(MemorySegment segment, const MemoryBudget& budget)
+{
+    MemoryBudgetEvent budgetEvent;
+    std::vector<Listener> listeners;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        const size_t index = static_cast<size_t>(segment);
+        const MemoryBudget previous = _budgets[index];
+        const bool known = _budgetKnown[index];
+        _budgets[index] = budget;
+        _budgetKnown[index] = true;
+
+        const uint64_t change = budget.budget > previous.budget ? budget.budget - previous.budget : previous.budget - budget.budget;
+        const bool wasOver = previous.currentUsage > previous.budget;
+        const bool isOver = budget.currentUsage > budget.budget;
+        if (known && change <= previous.budget / BudgetChangeDivisor && wasOver == isOver)
+        {
+            return;
+        }
+
+        budgetEvent.segment = segment;
+        budgetEvent.previous = known ? previous : MemoryBudget();
+        budgetEvent.current = budget;
+        budgetEvent.overBudget = isOver;
+        listeners = _listeners;
+    }
+
+    // Listeners may call back into the tracker.
+    for (const Listener& listener : listeners)
+    {
+        listener.function(budgetEvent);
+    }
+}
+
+MemoryBudget GpuMemoryTracker::GetBudget(MemorySegment segment)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _budgets[static_cast<size_t>(segment)];
+}
+
+uint32_t GpuMemoryTracker::AddBudgetListener(BudgetListener listener)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _listeners.push_back({ _nextListenerId, std::move(listener) });
+    return _nextListenerId++;
+}
+
+void GpuMemoryTracker::RemoveBudgetListener(uint32_t id)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _listeners.erase(std::remove_if(_listeners.begin(), _listeners.end(), [id](const Listener& listener)
+    {
+        return listener.id == id;
+    }), _listeners.end());
+}
+
+void GpuMemoryTracker::GetSnapshot(GpuMemorySnapshot* pSnapshot)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        std::copy(_categories, _categories + static_cast<size_t>(MemoryCategory::Count), pSnapshot->categories);
+        std::copy(_budgets, _budgets + static_cast<size_t>(MemorySegment::Count), pSnapshot->budgets);
+        pSnapshot->liveBytes = _liveBytes;
+        pSnapshot->peakBytes = _peakBytes;
+
+        pSnapshot->allocations.clear();
+        pSnapshot->allocations.reserve(_allocations.size());
+        for (const std::pair<const uint64_t, GpuMemoryAllocation>& allocation : _allocations)
+        {
+            pSnapshot->allocations.push_back(allocation.second);
+        }
+    }
+
+    std::sort(pSnapshot->allocations.begin(), pSnapshot->allocations.end(), [](const GpuMemoryAllocation& a, const GpuMemoryAllocation& b)
+    {
+        return a.bytes != b.bytes ? a.bytes > b.bytes : a.id < b.id;
+    });
+}
+
+void WriteGpuMemorySnapshotJson(const GpuMemorySnapshot& snapshot, std::string* pJson)
+{
+    char text[256];
+    snprintf(text, sizeof(text), "{\n  \"liveBytes\": %llu,\n  \"peakBytes\": %llu,\n  \"categories\": {",
+        static_cast<unsigned long long>(snapshot.liveBytes),
+        static_cast<unsigned long long>(snapshot.peakBytes));
+    pJson->assign(text);
+
+    for (size_t i = 0; i < static_cast<size_t>(MemoryCategory::Count); i++)
+    {
+        const MemoryCategoryCounters& counters = snapshot.categories[i];
+        snprintf(text, sizeof(text), "%s\n    \"%s\": {\"liveBytes\":%llu,\"peakBytes\":%llu,\"liveAllocations\":%u,\"totalAllocations\":%llu}",
+            i == 0 ? "" : ",",
+            GetMemoryCategoryName(static_cast<MemoryCategory>(i)),
+            static_cast<unsigned long long>(counters.liveBytes),
+            static_cast<unsigned long long>(counters.peakBytes),
+            counters.liveAllocations,
+            static_cast<unsigned long long>(counters.totalAllocations));
+        pJson->append(text);
+    }
+
+    pJson->append("\n  },\n  \"budgets\": {");
+    for (size_t i = 0; i < static_cast<size_t>(MemorySegment::Count); i++)
+    {
+        const MemoryBudget& budget = snapshot.budgets[i];
+        snprintf(text, sizeof(text), "%s\n    \"%s\": {\"budget\":%llu,\"currentUsage\":%llu,\"availableForReservation\":%llu,\"currentReservation\":%llu}",
+            i == 0 ? "" : ",",
+            GetMemorySegmentName(static_cast<MemorySegment>(i)),
+            static_cast<unsigned long long>(budget.budget),
+            static_cast<unsigned long long>(budget.currentUsage),
+            static_cast<unsigned long long>(budget.availableForReservation),
+            static_cast<unsigned long long>(budget.currentReservation));
+        pJson->append(text);
+    }
+
+    pJson->append("\n  },\n  \"allocations\": [");
+    for (size_t i = 0; i < snapshot.allocations.size(); i++)
+    {
+        const GpuMemoryAllocation& allocation = snapshot.allocations[i];
+        pJson->append(i == 0 ? "\n    {\"name\":" : ",\n    {\"name\":");
+        AppendJsonString(allocation.name.c_str(), pJson);
+        snprintf(text, sizeof(text), ",\"category\":\"%s\",\"bytes\":%llu}",
+            GetMemoryCategoryName(allocation.category),
+            static_cast<unsigned long long>(allocation.bytes));
+        pJson->append(text);
+    }
+    pJson->append("\n  ]\n}\n");
+}
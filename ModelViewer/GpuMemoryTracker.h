@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+enum class MemoryCategory : uint32_t
+{
+    Mesh,
+    Texture,
+    RenderTarget,       // Render targets, depth buffers and transient render graph memory.
+    Upload,             // Upload and readback buffers.
+    Descriptor,
+    Other,
+    Count,
+};
+
+const char* GetMemoryCategoryName(MemoryCategory category);
+
+// Mirrors DXGI_MEMORY_SEGMENT_GROUP.
+enum class MemorySegment : uint32_t
+{
+    Local,
+    NonLocal,
+    Count,
+};
+
+// Mirrors DXGI_QUERY_VIDEO_MEMORY_INFO.
+struct MemoryBudget
+{
+    uint64_t budget;
+    uint64_t currentUsage;
+    uint64_t availableForReservation;
+    uint64_t currentReservation;
+};
+
+struct MemoryBudgetEvent
+{
+    MemorySegment segment;
+    MemoryBudget previous;      // All zero on the first update.
+    MemoryBudget current;
+    bool overBudget;
+};
+
+struct MemoryCategoryCounters
+{
+    uint64_t liveBytes;
+    uint64_t peakBytes;
+    uint32_t liveAllocations;
+    uint64_t totalAllocations;
+};
+
+struct GpuMemoryAllocation
+{
+    uint64_t id;
+    MemoryCategory category;
+    uint64_t bytes;
+    std::string name;
+};
+
+struct GpuMemorySnapshot
+{
+    MemoryCategoryCounters categories[static_cast<size_t>(MemoryCategory::Count)];
+    uint64_t liveBytes;
+    uint64_t peakBytes;         // Of the total, not the sum of the category peaks.
+    MemoryBudget budgets[static_cast<size_t>(MemorySegment::Count)];
+    std::vector<GpuMemoryAllocation> allocations;   // Largest first.
+};
+
+// Accounts for GPU allocations by category, with live and peak counters, and
+// turns the budget the OS reports into events. Allocations are tracked and
+// released from any thread. Budget listeners run on the thread that calls
+// UpdateBudget(), outside the lock.
+class GpuMemoryTracker
+{
+public: typedef std::function<void(const MemoryBudgetEvent& budgetEvent)> BudgetListener;
+
+    // The tracker the D3D12 helpers use by default.
+public: static GpuMemoryTracker& Get();
+
+    // Returns the id to release the allocation with.
+public: uint64_t Track(MemoryCategory category, uint64_t bytes, const char* name);
+public: void Release(uint64_t id);
+
+public: MemoryCategoryCounters GetCounters(MemoryCategory category);
+public: uint64_t GetLiveBytes();
+
+    // An event is raised on the first update of a segment, when the budget
+    // moves by more than 1/64 of itself, and when usage crosses the budget.
+public: void UpdateBudget(MemorySegment segment, const MemoryBudget& budget);
+public: MemoryBudget GetBudget(MemorySegment segment);
+
+    // Returns an id for RemoveBudgetListener().
+public: uint32_t AddBudgetListener(BudgetListener listener);
+public: void RemoveBudgetListener(uint32_t id);
+
+public: void GetSnapshot(GpuMemorySnapshot* pSnapshot);
+
+private: struct Listener
+    {
+        uint32_t id;
+        BudgetListener function;
+    };
+
+private: std::mutex _mutex;
+private: std::unordered_map<uint64_t, GpuMemoryAllocation> _allocations;
+private: uint64_t _nextId = 1;
+private: MemoryCategoryCounters _categories[static_cast<size_t>(MemoryCategory::Count)] = {};
+private: uint64_t _liveBytes = 0;
+private: uint64_t _peakBytes = 0;
+
+private: MemoryBudget _budgets[static_cast<size_t>(MemorySegment::Count)] = {};
+private: bool _budgetKnown[static_cast<size_t>(MemorySegment::Count)] = {};
+private: std::vector<Listener> _listeners;
+private: uint32_t _nextListenerId = 1;
+};
+
+void WriteGpuMemorySnapshotJson(const GpuMemorySnapshot& snapshot, std::string* pJson);
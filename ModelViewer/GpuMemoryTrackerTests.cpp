@@ -0,0 +1,181 @@
+#include "GpuMemoryTracker.h"
+#include "UnitTest.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    MemoryBudget MakeBudget(uint64_t budget, uint64_t currentUsage)
+    {
+        MemoryBudget memoryBudget = {};
+        memoryBudget.budget = budget;
+        memoryBudget.currentUsage = currentUsage;
+        return memoryBudget;
+    }
+
+    void TestCounters()
+    {
+        GpuMemoryTracker tracker;
+        const uint64_t texture = tracker.Track(MemoryCategory::Texture, 1000, "Texture");
+        const uint64_t mesh = tracker.Track(MemoryCategory::Mesh, 500, "Mesh");
+        const uint64_t other = tracker.Track(MemoryCategory::Texture, 300, "Other");
+        CHECK(tracker.GetLiveBytes() == 1800);
+
+        tracker.Release(texture);
+        tracker.Release(texture);
+        tracker.Release(12345);
+        CHECK(tracker.GetLiveBytes() == 800);
+
+        const MemoryCategoryCounters textures = tracker.GetCounters(MemoryCategory::Texture);
+        CHECK(textures.liveBytes == 300);
+        CHECK(textures.peakBytes == 1300);
+        CHECK(textures.liveAllocations == 1);
+        CHECK(textures.totalAllocations == 2);
+
+        // The total peak is that of the sum, not the sum of the category peaks.
+        tracker.Release(other);
+        tracker.Track(MemoryCategory::Mesh, 900, "Late");
+        GpuMemorySnapshot snapshot;
+        tracker.GetSnapshot(&snapshot);
+        CHECK(snapshot.liveBytes == 1400);
+        CHECK(snapshot.peakBytes == 1800);
+        CHECK(snapshot.categories[static_cast<size_t>(MemoryCategory::Mesh)].peakBytes == 1400);
+        CHECK(snapshot.allocations.size() == 2);
+        CHECK(snapshot.allocations[0].bytes == 900);
+        CHECK(snapshot.allocations[1].id == mesh);
+    }
+
+    void TestThreads()
+    {
+        GpuMemoryTracker tracker;
+        tracker.Track(MemoryCategory::Mesh, 500, "Kept");
+        std::thread other([&tracker]()
+        {
+            for (int i = 0; i < 1000; i++)
+            {
+                tracker.Release(tracker.Track(MemoryCategory::Upload, 10, "Upload"));
+            }
+        });
+        for (int i = 0; i < 1000; i++)
+        {
+            tracker.Release(tracker.Track(MemoryCategory::Other, 10, "Other"));
+        }
+        other.join();
+
+        CHECK(tracker.GetLiveBytes() == 500);
+        CHECK(tracker.GetCounters(MemoryCategory::Upload).totalAllocations == 1000);
+        CHECK(tracker.GetCounters(MemoryCategory::Upload).liveAllocations == 0);
+    }
+
+    // Events on the first update, on budget moves of more than 1/64 and on
+    // usage crossing the budget either way; nothing for the noise between.
+    void TestBudgetEvents()
+    {
+        GpuMemoryTracker tracker;
+        std::vector<MemoryBudgetEvent> events;
+        const uint32_t listener = tracker.AddBudgetListener([&events](const MemoryBudgetEvent& budgetEvent)
+        {
+            events.push_back(budgetEvent);
+        });
+
+        tracker.UpdateBudget(MemorySegment::Local, MakeBudget(6400, 100));
+        CHECK(events.size() == 1);
+        CHECK(events[0].previous.budget == 0);
+        CHECK(events[0].current.budget == 6400);
+        CHECK(!events[0].overBudget);
+
+        // Exactly 1/64 is still noise, one more byte is not.
+        tracker.UpdateBudget(MemorySegment::Local, MakeBudget(6500, 200));
+        CHECK(events.size() == 1);
+        tracker.UpdateBudget(MemorySegment::Local, MakeBudget(6398, 200));
+        CHECK(events.size() == 2);
+        CHECK(events[1].previous.budget == 6500);
+
+        // Usage alone moving within the budget is not an event.
+        tracker.UpdateBudget(MemorySegment::Local, MakeBudget(6398, 6398));
+        CHECK(events.size() == 2);
+
+        tracker.UpdateBudget(MemorySegment::Local, MakeBudget(6398, 6399));
+        CHECK(events.size() == 3);
+        CHECK(events[2].overBudget);
+        tracker.UpdateBudget(MemorySegment::Local, MakeBudget(6398, 7000));
+        CHECK(events.size() == 3);
+        tracker.UpdateBudget(MemorySegment::Local, MakeBudget(6398, 6000));
+        CHECK(events.size() == 4);
+        CHECK(!events[3].overBudget);
+
+        // Segments are independent: the first non-local update is an event.
+        tracker.UpdateBudget(MemorySegment::NonLocal, MakeBudget(100, 0));
+        CHECK(events.size() == 5);
+        CHECK(events[4].segment == MemorySegment::NonLocal);
+        CHECK(tracker.GetBudget(MemorySegment::Local).currentUsage == 6000);
+
+        tracker.RemoveBudgetListener(listener);
+        tracker.UpdateBudget(MemorySegment::Local, MakeBudget(100, 7000));
+        CHECK(events.size() == 5);
+    }
+
+    // Listeners run outside the lock, so they may use the tracker.
+    void TestListenerCallsBack()
+    {
+        GpuMemoryTracker tracker;
+        uint64_t liveBytes = 0;
+        tracker.AddBudgetListener([&tracker, &liveBytes](const MemoryBudgetEvent&)
+        {
+            liveBytes = tracker.GetLiveBytes();
+        });
+        tracker.Track(MemoryCategory::Texture, 42, "Texture");
+        tracker.UpdateBudget(MemorySegment::Local, MakeBudget(1000, 0));
+        CHECK(liveBytes == 42);
+    }
+
+    void TestSnapshotJson()
+    {
+        GpuMemoryTracker tracker;
+        const uint64_t released = tracker.Track(MemoryCategory::Texture, 1000, "Released");
+        tracker.Track(MemoryCategory::Mesh, 500, "Mesh \"quoted\"\n");
+        tracker.Track(MemoryCategory::RenderTarget, 2000, "SceneColor");
+        tracker.Release(released);
+        tracker.UpdateBudget(MemorySegment::Local, MakeBudget(4096, 2500));
+
+        GpuMemorySnapshot snapshot;
+        tracker.GetSnapshot(&snapshot);
+        std::string json;
+        WriteGpuMemorySnapshotJson(snapshot, &json);
+
+        const std::string expected =
+            "{\n"
+            "  \"liveBytes\": 2500,\n"
+            "  \"peakBytes\": 3500,\n"
+            "  \"categories\": {\n"
+            "    \"mesh\": {\"liveBytes\":500,\"peakBytes\":500,\"liveAllocations\":1,\"totalAllocations\":1},\n"
+            "    \"texture\": {\"liveBytes\":0,\"peakBytes\":1000,\"liveAllocations\":0,\"totalAllocations\":1},\n"
+            "    \"renderTarget\": {\"liveBytes\":2000,\"peakBytes\":2000,\"liveAllocations\":1,\"totalAllocations\":1},\n"
+            "    \"upload\": {\"liveBytes\":0,\"peakBytes\":0,\"liveAllocations\":0,\"totalAllocations\":0},\n"
+            "    \"descriptor\": {\"liveBytes\":0,\"peakBytes\":0,\"liveAllocations\":0,\"totalAllocations\":0},\n"
+            "    \"other\": {\"liveBytes\":0,\"peakBytes\":0,\"liveAllocations\":0,\"totalAllocations\":0}\n"
+            "  },\n"
+            "  \"budgets\": {\n"
+            "    \"local\": {\"budget\":4096,\"currentUsage\":2500,\"availableForReservation\":0,\"currentReservation\":0},\n"
+            "    \"nonLocal\": {\"budget\":0,\"currentUsage\":0,\"availableForReservation\":0,\"currentReservation\":0}\n"
+            "  },\n"
+            "  \"allocations\": [\n"
+            "    {\"name\":\"SceneColor\",\"category\":\"renderTarget\",\"bytes\":2000},\n"
+            "    {\"name\":\"Mesh \\\"quoted\\\"\\u000a\",\"category\":\"mesh\",\"bytes\":500}\n"
+            "  ]\n"
+            "}\n";
+        CHECK(json == expected);
+    }
+}
+
+int main()
+{
+    TestCounters();
+    TestThreads();
+    TestBudgetEvents();
+    TestListenerCallsBack();
+    TestSnapshotJson();
+    return TestFailures();
+}
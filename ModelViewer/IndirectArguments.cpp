@@ -0,0 +1,221 @@
+#include "IndirectArguments.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+    uint32_t GetArgumentSize(IndirectArgumentType type, uint32_t num32BitValues)
+    {
+        switch (type)
+        {
+        case IndirectArgumentType::Draw:                return 4 * sizeof(uint32_t);
+        case IndirectArgumentType::DrawIndexed:         return 5 * sizeof(uint32_t);
+        case IndirectArgumentType::Dispatch:            return 3 * sizeof(uint32_t);
+        case IndirectArgumentType::VertexBufferView:    return sizeof(uint64_t) + 2 * sizeof(uint32_t);
+        case IndirectArgumentType::IndexBufferView:     return sizeof(uint64_t) + 2 * sizeof(uint32_t);
+        case IndirectArgumentType::Constant:            return num32BitValues * sizeof(uint32_t);
+        default:                                        return sizeof(uint64_t);
+        }
+    }
+
+    template <typename T>
+    inline void Write(uint8_t* pDest, const T& value)
+    {
+        memcpy(pDest, &value, sizeof(T));
+    }
+}
+
+IndirectCommandLayout& IndirectCommandLayout::AddVertexBufferView(uint32_t slot)
+{
+    return Add(IndirectArgumentType::VertexBufferView, slot, 0, 0);
+}
+
+IndirectCommandLayout& IndirectCommandLayout::AddIndexBufferView()
+{
+    return Add(IndirectArgumentType::IndexBufferView, 0, 0, 0);
+}
+
+IndirectCommandLayout& IndirectCommandLayout::AddConstant(uint32_t rootParameterIndex, uint32_t destOffsetIn32BitValues, uint32_t num32BitValues)
+{
+    return Add(IndirectArgumentType::Constant, rootParameterIndex, destOffsetIn32BitValues, num32BitValues);
+}
+
+IndirectCommandLayout& IndirectCommandLayout::AddConstantBufferView(uint32_t rootParameterIndex)
+{
+    return Add(IndirectArgumentType::ConstantBufferView, rootParameterIndex, 0, 0);
+}
+
+IndirectCommandLayout& IndirectCommandLayout::AddShaderResourceView(uint32_t rootParameterIndex)
+{
+    return Add(IndirectArgumentType::ShaderResourceView, rootParameterIndex, 0, 0);
+}
+
+IndirectCommandLayout& IndirectCommandLayout::AddUnorderedAccessView(uint32_t rootParameterIndex)
+{
+    return Add(IndirectArgumentType::UnorderedAccessView, rootParameterIndex, 0, 0);
+}
+
+IndirectCommandLayout& IndirectCommandLayout::AddDraw()
+{
+    return Add(IndirectArgumentType::Draw, 0, 0, 0);
+}
+
+IndirectCommandLayout& IndirectCommandLayout::AddDrawIndexed()
+{
+    return Add(IndirectArgumentType::DrawIndexed, 0, 0, 0);
+}
+
+IndirectCommandLayout& IndirectCommandLayout::AddDispatch()
+{
+    return Add(IndirectArgumentType::Dispatch, 0, 0, 0);
+}
+
+IndirectCommandLayout& IndirectCommandLayout::Add(IndirectArgumentType type, uint32_t slot, uint32_t destOffset, uint32_t num32BitValues)
+{
+    if (_closed)
+    {
+        throw std::logic_error("Indirect command layout already ends with a draw or dispatch.");
+    }
+
+    IndirectArgument argument;
+    argument.type = type;
+    argument.slot = slot;
+    argument.destOffsetIn32BitValues = destOffset;
+    argument.num32BitValues = num32BitValues;
+    argument.byteOffset = _size;
+    _arguments.push_back(argument);
+
+    _size = argument.byteOffset + GetArgumentSize(type, num32BitValues);
+    _closed = type == IndirectArgumentType::Draw || type == IndirectArgumentType::DrawIndexed || type == IndirectArgumentType::Dispatch;
+
+    return *this;
+}
+
+uint32_t IndirectCommandLayout::GetByteStride() const
+{
+    return _size;
+}
+
+bool IndirectCommandLayout::ChangesRootArguments() const
+{
+    for (const IndirectArgument& argument : _arguments)
+    {
+        if (argument.type == IndirectArgumentType::Constant ||
+            argument.type == IndirectArgumentType::ConstantBufferView ||
+            argument.type == IndirectArgumentType::ShaderResourceView ||
+            argument.type == IndirectArgumentType::UnorderedAccessView)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+IndirectCommandLayout IndirectDrawGenerator::MakeInstancedLayout(uint32_t instanceRootParameter, uint32_t drawConstantsRootParameter, uint32_t drawRootConstantCount)
+{
+    IndirectCommandLayout layout;
+    layout.AddShaderResourceView(instanceRootParameter);
+    if (drawRootConstantCount > 0)
+    {
+        layout.AddConstant(drawConstantsRootParameter, 0, drawRootConstantCount);
+    }
+    else
+    {
+        layout.AddConstantBufferView(drawConstantsRootParameter);
+    }
+    layout.AddVertexBufferView(0)
+        .AddIndexBufferView()
+        .AddDrawIndexed();
+    return layout;
+}
+
+void IndirectDrawGenerator::Generate(
+    const IndirectCommandLayout& layout,
+    const DrawBatch* pBatches,
+    size_t batchCount,
+    const IndirectMeshBinding* pMeshes,
+    const BatchRootBindings& bindings)
+{
+    const uint32_t stride = layout.GetByteStride();
+    _argumentBuffer.assign(batchCount * stride, 0);
+    _runs.clear();
+
+    for (size_t i = 0; i < batchCount; i++)
+    {
+        const DrawBatch& batch = pBatches[i];
+        const IndirectMeshBinding& mesh = pMeshes[batch.meshId];
+        uint8_t* pCommand = _argumentBuffer.data() + i * stride;
+
+        // ExecuteIndirect cannot switch pipeline states, so every material starts a new run.
+        if (_runs.empty() || _runs.back().materialId != batch.materialId)
+        {
+            IndirectDrawRun run;
+            run.materialId = batch.materialId;
+            run.firstCommand = static_cast<uint32_t>(i);
+            run.commandCount = 0;
+            _runs.push_back(run);
+        }
+        _runs.back().commandCount++;
+
+        for (const IndirectArgument& argument : layout.GetArguments())
+        {
+            uint8_t* pDest = pCommand + argument.byteOffset;
+            switch (argument.type)
+            {
+            case IndirectArgumentType::ShaderResourceView:
+                Write(pDest, bindings.instanceAddress + static_cast<uint64_t>(batch.firstInstance) * bindings.instanceStride);
+                break;
+
+            case IndirectArgumentType::ConstantBufferView:
+                if (bindings.drawConstantsAddress != 0)
+                {
+                    Write(pDest, bindings.drawConstantsAddress + static_cast<uint64_t>(i) * bindings.drawConstantsStride);
+                }
+                break;
+
+            case IndirectArgumentType::Constant:
+                if (bindings.pDrawRootConstants != nullptr)
+                {
+                    memcpy(
+                        pDest,
+                        bindings.pDrawRootConstants + i * bindings.drawRootConstantCount + argument.destOffsetIn32BitValues,
+                        argument.num32BitValues * sizeof(uint32_t));
+                }
+                break;
+
+            case IndirectArgumentType::VertexBufferView:
+                Write(pDest, mesh.vertexBufferAddress);
+                Write(pDest + 8, mesh.vertexBufferSize);
+                Write(pDest + 12, mesh.vertexStride);
+                break;
+
+            case IndirectArgumentType::IndexBufferView:
+                Write(pDest, mesh.indexBufferAddress);
+                Write(pDest + 8, mesh.indexBufferSize);
+                Write(pDest + 12, mesh.indexFormat);
+                break;
+
+            case IndirectArgumentType::DrawIndexed:
+                // IndexCountPerInstance, InstanceCount, StartIndexLocation, BaseVertexLocation, StartInstanceLocation.
+                Write(pDest, mesh.indexCount);
+                Write(pDest + 4, batch.instanceCount);
+                break;
+
+            case IndirectArgumentType::Draw:
+                // VertexCountPerInstance, InstanceCount, StartVertexLocation, StartInstanceLocation.
+                Write(pDest, mesh.indexCount);
+                Write(pDest + 4, batch.instanceCount);
+                break;
+
+            default:
+                // Left zeroed; the generator has no data for other argument kinds.
+                break;
+            }
+        }
+    }
+
+    _stats.commands = static_cast<uint32_t>(batchCount);
+    _stats.executeCalls = static_cast<uint32_t>(_runs.size());
+    _stats.argumentBytes = static_cast<uint32_t>(_argumentBuffer.size());
+}
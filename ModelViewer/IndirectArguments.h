@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "DrawBatcher.h"
+
+// Mirrors D3D12_INDIRECT_ARGUMENT_TYPE so the layout can be built and filled
+// without the D3D12 headers.
+enum class IndirectArgumentType : uint32_t
+{
+    Draw,
+    DrawIndexed,
+    Dispatch,
+    VertexBufferView,
+    IndexBufferView,
+    Constant,
+    ConstantBufferView,
+    ShaderResourceView,
+    UnorderedAccessView,
+};
+
+struct IndirectArgument
+{
+    IndirectArgumentType type;
+    uint32_t slot;                      // Vertex buffer slot or root parameter index.
+    uint32_t destOffsetIn32BitValues;   // Constant only.
+    uint32_t num32BitValues;            // Constant only.
+    uint32_t byteOffset;                // Offset of the argument inside one command.
+};
+
+// Describes one command of an indirect argument buffer, i.e. the content of a
+// D3D12_COMMAND_SIGNATURE_DESC. Arguments are packed back to back in
+// declaration order, as D3D12 reads them: no padding, not even before a
+// 64-bit address that follows an odd number of root constants. The byte
+// stride is the packed size.
+class IndirectCommandLayout
+{
+public: IndirectCommandLayout& AddVertexBufferView(uint32_t slot);
+public: IndirectCommandLayout& AddIndexBufferView();
+public: IndirectCommandLayout& AddConstant(uint32_t rootParameterIndex, uint32_t destOffsetIn32BitValues, uint32_t num32BitValues);
+public: IndirectCommandLayout& AddConstantBufferView(uint32_t rootParameterIndex);
+public: IndirectCommandLayout& AddShaderResourceView(uint32_t rootParameterIndex);
+public: IndirectCommandLayout& AddUnorderedAccessView(uint32_t rootParameterIndex);
+
+    // Draw or dispatch must be the last argument of a command.
+public: IndirectCommandLayout& AddDraw();
+public: IndirectCommandLayout& AddDrawIndexed();
+public: IndirectCommandLayout& AddDispatch();
+
+public: const std::vector<IndirectArgument>& GetArguments() const { return _arguments; }
+public: uint32_t GetByteStride() const;
+
+    // A command signature that changes root arguments must be created with the root signature.
+public: bool ChangesRootArguments() const;
+
+private: IndirectCommandLayout& Add(IndirectArgumentType type, uint32_t slot, uint32_t destOffset, uint32_t num32BitValues);
+
+private: std::vector<IndirectArgument> _arguments;
+private: uint32_t _size = 0;
+private: bool _closed = false;
+};
+
+// What the generator needs to know about a mesh to fill its arguments.
+// The fields match D3D12_VERTEX_BUFFER_VIEW / D3D12_INDEX_BUFFER_VIEW.
+struct IndirectMeshBinding
+{
+    uint64_t vertexBufferAddress;
+    uint32_t vertexBufferSize;
+    uint32_t vertexStride;
+    uint64_t indexBufferAddress;
+    uint32_t indexBufferSize;
+    uint32_t indexFormat;
+    uint32_t indexCount;
+};
+
+// Where a batch's root arguments point, for direct and indirect draws alike:
+// its slice of the frame's instance data, and optionally a constant buffer of
+// its own from an array with one per batch, in batch order.
+struct BatchRootBindings
+{
+    uint32_t instanceRootParameter;
+    uint64_t instanceAddress;
+    uint32_t instanceStride;
+    uint32_t drawConstantsRootParameter;
+    uint64_t drawConstantsAddress;      // 0 when batches have no constants.
+    uint32_t drawConstantsStride;
+    const uint32_t* pDrawRootConstants; // Root constants instead of a CBV, drawRootConstantCount per batch; null for none.
+    uint32_t drawRootConstantCount;
+};
+
+// Commands sharing a pipeline state, issued by one ExecuteIndirect.
+struct IndirectDrawRun
+{
+    uint32_t materialId;
+    uint32_t firstCommand;
+    uint32_t commandCount;
+};
+
+struct IndirectDrawStats
+{
+    uint32_t commands;
+    uint32_t executeCalls;
+    uint32_t argumentBytes;
+};
+
+// CPU reference generator for the argument buffer. A GPU culling pass writes the
+// same layout; this one fills it from the draw batches of the frame.
+class IndirectDrawGenerator
+{
+    // Layout used by the renderer: instance data SRV, draw constants as root
+    // constants when drawRootConstantCount is not 0 or else a CBV, vertex
+    // buffer, index buffer, draw.
+public: static IndirectCommandLayout MakeInstancedLayout(uint32_t instanceRootParameter, uint32_t drawConstantsRootParameter, uint32_t drawRootConstantCount = 0);
+
+public: void Generate(
+        const IndirectCommandLayout& layout,
+        const DrawBatch* pBatches,
+        size_t batchCount,
+        const IndirectMeshBinding* pMeshes,
+        const BatchRootBindings& bindings);
+
+public: const std::vector<uint8_t>& GetArgumentBuffer() const { return _argumentBuffer; }
+public: const std::vector<IndirectDrawRun>& GetRuns() const { return _runs; }
+public: const IndirectDrawStats& GetStats() const { return _stats; }
+
+private: std::vector<uint8_t> _argumentBuffer;
+private: std::vector<IndirectDrawRun> _runs;
+private: IndirectDrawStats _stats = {};
+};
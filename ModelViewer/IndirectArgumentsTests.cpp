@@ -0,0 +1,165 @@
+#include "IndirectArguments.h"
+#include "UnitTest.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+    template <typename T>
+    T Read(const std::vector<uint8_t>& buffer, size_t offset)
+    {
+        T value;
+        memcpy(&value, buffer.data() + offset, sizeof(T));
+        return value;
+    }
+
+    // Arguments follow each other with no padding, whatever their size.
+    void TestLayoutPacking()
+    {
+        IndirectCommandLayout layout;
+        layout.AddConstant(1, 0, 3)
+            .AddShaderResourceView(0)
+            .AddVertexBufferView(0)
+            .AddConstant(2, 1, 1)
+            .AddIndexBufferView()
+            .AddDrawIndexed();
+
+        const std::vector<IndirectArgument>& arguments = layout.GetArguments();
+        CHECK(arguments.size() == 6);
+        CHECK(arguments[0].byteOffset == 0);
+        CHECK(arguments[1].byteOffset == 12);
+        CHECK(arguments[2].byteOffset == 20);
+        CHECK(arguments[3].byteOffset == 36);
+        CHECK(arguments[3].destOffsetIn32BitValues == 1);
+        CHECK(arguments[4].byteOffset == 40);
+        CHECK(arguments[5].byteOffset == 56);
+        CHECK(layout.GetByteStride() == 76);
+        CHECK(layout.ChangesRootArguments());
+
+        IndirectCommandLayout drawOnly;
+        drawOnly.AddVertexBufferView(0).AddDraw();
+        CHECK(drawOnly.GetByteStride() == 16 + 16);
+        CHECK(!drawOnly.ChangesRootArguments());
+
+        // Nothing goes after the draw.
+        bool threw = false;
+        try
+        {
+            drawOnly.AddIndexBufferView();
+        }
+        catch (const std::logic_error&)
+        {
+            threw = true;
+        }
+        CHECK(threw);
+    }
+
+    void TestInstancedLayout()
+    {
+        const IndirectCommandLayout withView = IndirectDrawGenerator::MakeInstancedLayout(0, 1);
+        CHECK(withView.GetArguments()[1].type == IndirectArgumentType::ConstantBufferView);
+        CHECK(withView.GetByteStride() == 8 + 8 + 16 + 16 + 20);
+
+        const IndirectCommandLayout withConstants = IndirectDrawGenerator::MakeInstancedLayout(0, 1, 3);
+        CHECK(withConstants.GetArguments()[1].type == IndirectArgumentType::Constant);
+        CHECK(withConstants.GetArguments()[2].byteOffset == 8 + 12);
+        CHECK(withConstants.GetByteStride() == 8 + 12 + 16 + 16 + 20);
+    }
+
+    // Each command carries its batch's instance slice, constants and mesh;
+    // a new material starts a new run.
+    void TestGenerator()
+    {
+        const uint32_t constantCount = 3;
+        const IndirectCommandLayout layout = IndirectDrawGenerator::MakeInstancedLayout(0, 1, constantCount);
+        const uint32_t stride = layout.GetByteStride();
+
+        const DrawBatch batches[] =
+        {
+            { 0, 0, 0, 4 },
+            { 1, 0, 4, 1 },
+            { 0, 2, 5, 7 },
+        };
+        const IndirectMeshBinding meshes[] =
+        {
+            { 0x10000, 960, 28, 0x20000, 144, 42, 36 },
+            { 0x30000, 96, 12, 0x40000, 24, 57, 6 },
+        };
+        const uint32_t constants[] = { 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+
+        BatchRootBindings bindings = {};
+        bindings.instanceRootParameter = 0;
+        bindings.instanceAddress = 0x50000;
+        bindings.instanceStride = 64;
+        bindings.drawConstantsRootParameter = 1;
+        bindings.pDrawRootConstants = constants;
+        bindings.drawRootConstantCount = constantCount;
+
+        IndirectDrawGenerator generator;
+        generator.Generate(layout, batches, 3, meshes, bindings);
+        const std::vector<uint8_t>& buffer = generator.GetArgumentBuffer();
+        CHECK(buffer.size() == 3 * stride);
+
+        for (size_t i = 0; i < 3; i++)
+        {
+            const size_t command = i * stride;
+            const IndirectMeshBinding& mesh = meshes[batches[i].meshId];
+            CHECK(Read<uint64_t>(buffer, command) == 0x50000 + batches[i].firstInstance * 64ull);
+            for (uint32_t c = 0; c < constantCount; c++)
+            {
+                CHECK(Read<uint32_t>(buffer, command + 8 + c * 4) == constants[i * constantCount + c]);
+            }
+            CHECK(Read<uint64_t>(buffer, command + 20) == mesh.vertexBufferAddress);
+            CHECK(Read<uint32_t>(buffer, command + 28) == mesh.vertexBufferSize);
+            CHECK(Read<uint32_t>(buffer, command + 32) == mesh.vertexStride);
+            CHECK(Read<uint64_t>(buffer, command + 36) == mesh.indexBufferAddress);
+            CHECK(Read<uint32_t>(buffer, command + 44) == mesh.indexBufferSize);
+            CHECK(Read<uint32_t>(buffer, command + 48) == mesh.indexFormat);
+            CHECK(Read<uint32_t>(buffer, command + 52) == mesh.indexCount);
+            CHECK(Read<uint32_t>(buffer, command + 56) == batches[i].instanceCount);
+            CHECK(Read<uint32_t>(buffer, command + 60) == 0);
+        }
+
+        const std::vector<IndirectDrawRun>& runs = generator.GetRuns();
+        CHECK(runs.size() == 2);
+        CHECK(runs[0].materialId == 0 && runs[0].firstCommand == 0 && runs[0].commandCount == 2);
+        CHECK(runs[1].materialId == 2 && runs[1].firstCommand == 2 && runs[1].commandCount == 1);
+
+        const IndirectDrawStats& stats = generator.GetStats();
+        CHECK(stats.commands == 3);
+        CHECK(stats.executeCalls == 2);
+        CHECK(stats.argumentBytes == 3 * stride);
+    }
+
+    // With a CBV per batch, each command points at its own.
+    void TestGeneratorConstantBufferViews()
+    {
+        const IndirectCommandLayout layout = IndirectDrawGenerator::MakeInstancedLayout(0, 1);
+        const DrawBatch batches[] = { { 0, 0, 0, 1 }, { 0, 0, 1, 1 } };
+        const IndirectMeshBinding mesh = { 0x10000, 960, 28, 0x20000, 144, 42, 36 };
+
+        BatchRootBindings bindings = {};
+        bindings.instanceAddress = 0x50000;
+        bindings.instanceStride = 64;
+        bindings.drawConstantsAddress = 0x60000;
+        bindings.drawConstantsStride = 256;
+
+        IndirectDrawGenerator generator;
+        generator.Generate(layout, batches, 2, &mesh, bindings);
+        const std::vector<uint8_t>& buffer = generator.GetArgumentBuffer();
+        CHECK(Read<uint64_t>(buffer, 8) == 0x60000);
+        CHECK(Read<uint64_t>(buffer, layout.GetByteStride() + 8) == 0x60000 + 256);
+        CHECK(generator.GetRuns().size() == 1);
+    }
+}
+
+int main()
+{
+    TestLayoutPacking();
+    TestInstancedLayout();
+    TestGenerator();
+    TestGeneratorConstantBufferViews();
+    return TestFailures();
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+// Read-only view of a whole file through a file mapping. Pages are brought in
+// by the OS when they are touched, so only the parts actually read cost I/O.
+class MappedFile
+{
+public: MappedFile();
+public: ~MappedFile();
+
+public: MappedFile(const MappedFile&) = delete;
+public: MappedFile& operator=(const MappedFile&) = delete;
+
+public: void Open(LPCWSTR filename);
+public: void Close();
+
+public: const UINT8* GetData() const { return _data; }
+public: UINT64 GetSize() const { return _size; }
+
+private: HANDLE _file;
+private: HANDLE _mapping;
+private: const UINT8* _data;
+private: UINT64 _size;
+};
@@ -0,0 +1,92 @@
+#include "MeshStreams.h"
+
+#include <cstring>
+#include <unordered_map>
+
+namespace
+{
+    struct PositionKey
+    {
+        uint32_t bits[3];
+
+        bool operator==(const PositionKey& other) const
+        {
+            return bits[0] == other.bits[0] && bits[1] == other.bits[1] && bits[2] == other.bits[2];
+        }
+    };
+
+    struct PositionKeyHash
+    {
+        size_t operator()(const PositionKey& key) const
+        {
+            // FNV-1a over the three words.
+            uint64_t hash = 0xcbf29ce484222325ull;
+            for (uint32_t bits : key.bits)
+            {
+                hash ^= bits;
+                hash *= 0x100000001b3ull;
+            }
+            return static_cast<size_t>(hash);
+        }
+    };
+}
+
+bool BuildPositionStream(
+    const void* pVertices,
+    uint32_t vertexCount,
+    uint32_t stride,
+    uint32_t positionOffset,
+    const uint32_t* pIndices,
+    uint32_t indexCount,
+    PositionStream* pStream,
+    PositionStreamStats* pStats)
+{
+    pStream->positions.clear();
+    pStream->indices.clear();
+    pStream->indices.reserve(indexCount);
+
+    // Source vertex -> position vertex, filled as indices first reach them.
+    std::vector<uint32_t> remap(vertexCount, UINT32_MAX);
+    std::unordered_map<PositionKey, uint32_t, PositionKeyHash> welded;
+
+    const uint8_t* pBytes = static_cast<const uint8_t*>(pVertices);
+    for (uint32_t i = 0; i < indexCount; i++)
+    {
+        const uint32_t vertex = pIndices[i];
+        if (vertex >= vertexCount)
+        {
+            return false;
+        }
+
+        if (remap[vertex] == UINT32_MAX)
+        {
+            float position[3];
+            memcpy(position, pBytes + static_cast<size_t>(vertex) * stride + positionOffset, sizeof(position));
+
+            // Bitwise equal positions transform to bitwise equal depths; -0
+            // and 0 are the same point.
+            PositionKey key;
+            for (int c = 0; c < 3; c++)
+            {
+                const float value = position[c] + 0.0f;
+                memcpy(&key.bits[c], &value, sizeof(value));
+            }
+
+            auto found = welded.find(key);
+            if (found == welded.end())
+            {
+                const uint32_t index = static_cast<uint32_t>(pStream->positions.size() / 3);
+                pStream->positions.insert(pStream->positions.end(), position, position + 3);
+                found = welded.emplace(key, index).first;
+            }
+            remap[vertex] = found->second;
+        }
+        pStream->indices.push_back(remap[vertex]);
+    }
+
+    pStats->sourceVertices = vertexCount;
+    pStats->positionVertices = static_cast<uint32_t>(pStream->positions.size() / 3);
+    pStats->sourceBytes = static_cast<uint64_t>(vertexCount) * stride;
+    pStats->positionBytes = pStream->positions.size() * sizeof(float);
+    return true;
+}
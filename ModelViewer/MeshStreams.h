@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// The position-only copy of a mesh the depth pre-pass draws from. Positions
+// are read at 12 bytes a vertex instead of the full vertex, and vertices that
+// only differed in other attributes (face normals, colors, UV seams) are
+// welded, so the pass also transforms fewer of them. Triangles and their
+// order are the same as in the full mesh.
+struct PositionStream
+{
+    std::vector<float> positions;       // x, y, z per vertex, in first-use order.
+    std::vector<uint32_t> indices;      // Into positions, one per index of the mesh.
+};
+
+struct PositionStreamStats
+{
+    uint32_t sourceVertices;
+    uint32_t positionVertices;
+    uint64_t sourceBytes;               // Vertex data the full mesh reads.
+    uint64_t positionBytes;
+};
+
+// positionOffset is the byte offset of the float3 position inside a vertex
+// of stride bytes. False when an index is out of range.
+bool BuildPositionStream(
+    const void* pVertices,
+    uint32_t vertexCount,
+    uint32_t stride,
+    uint32_t positionOffset,
+    const uint32_t* pIndices,
+    uint32_t indexCount,
+    PositionStream* pStream,
+    PositionStreamStats* pStats);
@@ -0,0 +1,374 @@
+#include "MipGenerator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define MIP_USE_SSE2 1
+#endif
+
+namespace
+{
+    const float Pi = 3.14159265358979f;
+
+    // Half width, in destination texels, and shape of the Kaiser window.
+    const float KaiserWidth = 3.0f;
+    const float KaiserAlpha = 4.0f;
+
+    // Largest alpha scale coverage preservation may apply.
+    const float MaxAlphaScale = 4.0f;
+
+    float DecodeSRGB(float c)
+    {
+        return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+    }
+
+    struct SRGBTables
+    {
+        float toLinear[256];
+
+        // thresholds[v] is the linear value from which encoding rounds to v + 1.
+        float thresholds[255];
+
+        SRGBTables()
+        {
+            for (int v = 0; v < 256; v++)
+            {
+                toLinear[v] = DecodeSRGB(v / 255.0f);
+            }
+            for (int v = 0; v < 255; v++)
+            {
+                thresholds[v] = DecodeSRGB((v + 0.5f) / 255.0f);
+            }
+        }
+    };
+
+    const SRGBTables& GetSRGBTables()
+    {
+        static const SRGBTables tables;
+        return tables;
+    }
+
+    inline uint8_t EncodeSRGB(const SRGBTables& tables, float linear)
+    {
+        return static_cast<uint8_t>(std::upper_bound(tables.thresholds, tables.thresholds + 255, linear) - tables.thresholds);
+    }
+
+    inline uint8_t EncodeUNorm(float value)
+    {
+        return static_cast<uint8_t>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+    }
+
+    // Zeroth order modified Bessel function of the first kind.
+    float BesselI0(float x)
+    {
+        float sum = 1.0f;
+        float term = 1.0f;
+        for (int k = 1; k < 32; k++)
+        {
+            term *= (x / (2.0f * k)) * (x / (2.0f * k));
+            sum += term;
+            if (term < sum * 1e-8f)
+            {
+                break;
+            }
+        }
+        return sum;
+    }
+
+    float Sinc(float x)
+    {
+        return std::fabs(x) < 1e-6f ? 1.0f : std::sin(Pi * x) / (Pi * x);
+    }
+
+    float Kaiser(float x)
+    {
+        const float t = x / KaiserWidth;
+        if (std::fabs(t) >= 1.0f)
+        {
+            return 0.0f;
+        }
+        return Sinc(x) * BesselI0(KaiserAlpha * std::sqrt(1.0f - t * t)) / BesselI0(KaiserAlpha);
+    }
+
+    // Fraction of texels whose scaled alpha passes the reference.
+    float ComputeCoverage(const float* pTexels, size_t count, float reference, float scale)
+    {
+        size_t passing = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            passing += pTexels[i * 4 + 3] * scale >= reference;
+        }
+        return static_cast<float>(passing) / count;
+    }
+
+    float FindAlphaScale(const float* pTexels, size_t count, float reference, float coverage)
+    {
+        if (coverage <= 0.0f || coverage >= 1.0f)
+        {
+            return 1.0f;
+        }
+
+        // Coverage only grows with the scale; keep the smallest scale that
+        // reaches the target.
+        float low = 0.0f;
+        float high = MaxAlphaScale;
+        for (int iteration = 0; iteration < 16; iteration++)
+        {
+            const float middle = (low + high) * 0.5f;
+            if (ComputeCoverage(pTexels, count, reference, middle) < coverage)
+            {
+                low = middle;
+            }
+            else
+            {
+                high = middle;
+            }
+        }
+        return high;
+    }
+}
+
+MipGenerator::MipGenerator(ThreadPool& pool) :
+    _pool(pool)
+{
+}
+
+// Texel i of the source covers [i, i + 1); destination texel x is centred on
+// (x + 0.5) * scale. Taps falling off the edge are clamped to it.
+void MipGenerator::BuildFilter(uint32_t sourceSize, uint32_t destinationSize, MipFilter filter, FilterTable* pTable)
+{
+    const float scale = static_cast<float>(sourceSize) / destinationSize;
+    const float support = filter == MipFilter::Box ? scale * 0.5f : KaiserWidth * scale;
+
+    pTable->first.clear();
+    pTable->indices.clear();
+    pTable->weights.clear();
+
+    for (uint32_t x = 0; x < destinationSize; x++)
+    {
+        const float center = (x + 0.5f) * scale;
+        const int begin = static_cast<int>(std::floor(center - support));
+        const int end = static_cast<int>(std::ceil(center + support));
+
+        const size_t first = pTable->weights.size();
+        float total = 0.0f;
+        for (int i = begin; i < end; i++)
+        {
+            float weight;
+            if (filter == MipFilter::Box)
+            {
+                weight = std::min(i + 1.0f, center + support) - std::max(static_cast<float>(i), center - support);
+            }
+            else
+            {
+                weight = Kaiser((i + 0.5f - center) / scale);
+            }
+            if (weight == 0.0f)
+            {
+                continue;
+            }
+
+            pTable->indices.push_back(static_cast<uint32_t>(std::min(std::max(i, 0), static_cast<int>(sourceSize) - 1)));
+            pTable->weights.push_back(weight);
+            total += weight;
+        }
+
+        for (size_t i = first; i < pTable->weights.size(); i++)
+        {
+            pTable->weights[i] /= total;
+        }
+        pTable->first.push_back(static_cast<uint32_t>(first));
+    }
+    pTable->first.push_back(static_cast<uint32_t>(pTable->weights.size()));
+}
+
+void MipGenerator::FilterRows(const float* pSource, uint32_t sourceWidth, const FilterTable& table, float* pDestination, size_t rowCount) const
+{
+    const size_t destinationWidth = table.first.size() - 1;
+    for (size_t row = 0; row < rowCount; row++)
+    {
+        const float* pRow = pSource + row * sourceWidth * 4;
+        for (size_t x = 0; x < destinationWidth; x++)
+        {
+            float* pTexel = pDestination + (row * destinationWidth + x) * 4;
+#if MIP_USE_SSE2
+            if (_useSimd)
+            {
+                __m128 sum = _mm_setzero_ps();
+                for (uint32_t tap = table.first[x]; tap < table.first[x + 1]; tap++)
+                {
+                    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(table.weights[tap]), _mm_loadu_ps(pRow + table.indices[tap] * 4)));
+                }
+                _mm_storeu_ps(pTexel, sum);
+                continue;
+            }
+#endif
+            float sum[4] = {};
+            for (uint32_t tap = table.first[x]; tap < table.first[x + 1]; tap++)
+            {
+                for (int ch = 0; ch < 4; ch++)
+                {
+                    sum[ch] += table.weights[tap] * pRow[table.indices[tap] * 4 + ch];
+                }
+            }
+            for (int ch = 0; ch < 4; ch++)
+            {
+                pTexel[ch] = sum[ch];
+            }
+        }
+    }
+}
+
+void MipGenerator::FilterColumns(const float* pSource, uint32_t width, const FilterTable& table, uint32_t row, float* pDestination) const
+{
+    const size_t count = static_cast<size_t>(width) * 4;
+    std::fill(pDestination, pDestination + count, 0.0f);
+
+    // Whole rows at a time so the source is read sequentially.
+    for (uint32_t tap = table.first[row]; tap < table.first[row + 1]; tap++)
+    {
+        const float weight = table.weights[tap];
+        const float* pRow = pSource + table.indices[tap] * count;
+        size_t i = 0;
+#if MIP_USE_SSE2
+        if (_useSimd)
+        {
+            const __m128 weights = _mm_set1_ps(weight);
+            for (; i < count; i += 4)
+            {
+                _mm_storeu_ps(pDestination + i, _mm_add_ps(_mm_loadu_ps(pDestination + i), _mm_mul_ps(weights, _mm_loadu_ps(pRow + i))));
+            }
+        }
+#endif
+        for (; i < count; i++)
+        {
+            pDestination[i] += weight * pRow[i];
+        }
+    }
+}
+
+void MipGenerator::Generate(const uint8_t* pSlices, uint32_t width, uint32_t height, uint32_t arraySize, const MipGenerationOptions& options, MipChain* pChain)
+{
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const SRGBTables& srgb = GetSRGBTables();
+
+    uint32_t mipCount = 1;
+    while ((std::max(width, height) >> mipCount) > 0)
+    {
+        mipCount++;
+    }
+    if (options.maxMipCount > 0)
+    {
+        mipCount = std::min(mipCount, options.maxMipCount);
+    }
+
+    pChain->width = width;
+    pChain->height = height;
+    pChain->mipCount = mipCount;
+    pChain->arraySize = arraySize;
+    pChain->levels.assign(static_cast<size_t>(arraySize) * mipCount, std::vector<uint8_t>());
+
+    const size_t sliceTexels = static_cast<size_t>(width) * height;
+    for (uint32_t slice = 0; slice < arraySize; slice++)
+    {
+        const uint8_t* pSlice = pSlices + slice * sliceTexels * 4;
+        pChain->levels[slice * mipCount].assign(pSlice, pSlice + sliceTexels * 4);
+    }
+
+    _current.resize(arraySize * sliceTexels * 4);
+    _pool.ParallelFor(arraySize * sliceTexels, 4096, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            for (int ch = 0; ch < 4; ch++)
+            {
+                const uint8_t value = pSlices[i * 4 + ch];
+                _current[i * 4 + ch] = options.srgb && ch < 3 ? srgb.toLinear[value] : value / 255.0f;
+            }
+        }
+    });
+
+    const bool preserveCoverage = options.alphaCoverageReference > 0.0f;
+    std::vector<float> coverage(arraySize);
+    std::vector<float> alphaScale(arraySize, 1.0f);
+    for (uint32_t slice = 0; preserveCoverage && slice < arraySize; slice++)
+    {
+        coverage[slice] = ComputeCoverage(&_current[slice * sliceTexels * 4], sliceTexels, options.alphaCoverageReference, 1.0f);
+    }
+
+    for (uint32_t mip = 1; mip < mipCount; mip++)
+    {
+        const uint32_t sourceWidth = pChain->GetMipWidth(mip - 1);
+        const uint32_t sourceHeight = pChain->GetMipHeight(mip - 1);
+        const uint32_t mipWidth = pChain->GetMipWidth(mip);
+        const uint32_t mipHeight = pChain->GetMipHeight(mip);
+        const size_t mipTexels = static_cast<size_t>(mipWidth) * mipHeight;
+
+        BuildFilter(sourceWidth, mipWidth, options.filter, &_horizontalFilter);
+        BuildFilter(sourceHeight, mipHeight, options.filter, &_verticalFilter);
+
+        // Slices are back to back, so the horizontal pass sees one tall image.
+        _horizontal.resize(static_cast<size_t>(arraySize) * sourceHeight * mipWidth * 4);
+        _pool.ParallelFor(static_cast<size_t>(arraySize) * sourceHeight, 16, [&](size_t begin, size_t end)
+        {
+            FilterRows(&_current[begin * sourceWidth * 4], sourceWidth, _horizontalFilter, &_horizontal[begin * mipWidth * 4], end - begin);
+        });
+
+        _next.resize(arraySize * mipTexels * 4);
+        _pool.ParallelFor(static_cast<size_t>(arraySize) * mipHeight, 16, [&](size_t begin, size_t end)
+        {
+            for (size_t row = begin; row < end; row++)
+            {
+                const size_t slice = row / mipHeight;
+                const float* pSlice = &_horizontal[slice * sourceHeight * mipWidth * 4];
+                FilterColumns(pSlice, mipWidth, _verticalFilter, static_cast<uint32_t>(row % mipHeight), &_next[row * mipWidth * 4]);
+            }
+        });
+
+        // The scale only applies to the stored alpha; the next level is still
+        // filtered from the unscaled values.
+        if (preserveCoverage)
+        {
+            _pool.ParallelFor(arraySize, 1, [&](size_t begin, size_t end)
+            {
+                for (size_t slice = begin; slice < end; slice++)
+                {
+                    alphaScale[slice] = FindAlphaScale(&_next[slice * mipTexels * 4], mipTexels, options.alphaCoverageReference, coverage[slice]);
+                }
+            });
+        }
+
+        for (uint32_t slice = 0; slice < arraySize; slice++)
+        {
+            pChain->levels[slice * mipCount + mip].resize(mipTexels * 4);
+        }
+        _pool.ParallelFor(static_cast<size_t>(arraySize) * mipHeight, 16, [&](size_t begin, size_t end)
+        {
+            for (size_t row = begin; row < end; row++)
+            {
+                const size_t slice = row / mipHeight;
+                const float* pSource = &_next[row * mipWidth * 4];
+                uint8_t* pDestination = &pChain->levels[slice * mipCount + mip][(row % mipHeight) * mipWidth * 4];
+                for (size_t i = 0; i < mipWidth; i++)
+                {
+                    for (int ch = 0; ch < 3; ch++)
+                    {
+                        const float value = pSource[i * 4 + ch];
+                        pDestination[i * 4 + ch] = options.srgb ? EncodeSRGB(srgb, value) : EncodeUNorm(value);
+                    }
+                    pDestination[i * 4 + 3] = EncodeUNorm(pSource[i * 4 + 3] * alphaScale[slice]);
+                }
+            }
+        });
+
+        std::swap(_current, _next);
+    }
+
+    const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    _stats.sourceTexels = arraySize * sliceTexels;
+    _stats.milliseconds = milliseconds;
+    _stats.megapixelsPerSecond = milliseconds > 0.0 ? _stats.sourceTexels / (milliseconds * 1000.0) : 0.0;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "ThreadPool.h"
+
+enum class MipFilter : uint32_t
+{
+    Box,        // Area average; cheap, slightly blurry.
+    Kaiser,     // Kaiser windowed sinc; sharper, may ring on hard edges.
+};
+
+struct MipGenerationOptions
+{
+    MipFilter filter = MipFilter::Box;
+
+    // Colour channels are sRGB encoded: they are filtered in linear space and
+    // encoded again. Alpha is always linear.
+    bool srgb = false;
+
+    // When above zero, alpha of every mip is scaled so the fraction of texels
+    // passing an alpha test against this reference matches the top mip, which
+    // keeps alpha tested foliage from thinning out in the distance.
+    float alphaCoverageReference = 0.0f;
+
+    // 0 generates the full chain down to 1x1.
+    uint32_t maxMipCount = 0;
+};
+
+// RGBA8 mips of one or more array slices.
+struct MipChain
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipCount;
+    uint32_t arraySize;
+    std::vector<std::vector<uint8_t>> levels;   // levels[slice * mipCount + mip].
+
+    uint32_t GetMipWidth(uint32_t mip) const { return width >> mip ? width >> mip : 1; }
+    uint32_t GetMipHeight(uint32_t mip) const { return height >> mip ? height >> mip : 1; }
+};
+
+struct MipGenerationStats
+{
+    uint64_t sourceTexels;
+    double milliseconds;
+    double megapixelsPerSecond;     // Of source texels.
+};
+
+// Builds mip chains at import time. Each level is filtered from the previous
+// one in linear float, separably, with rows of all array slices spread over
+// the pool. The SSE2 and scalar paths do the same operations in the same order
+// and give identical results.
+class MipGenerator
+{
+public: explicit MipGenerator(ThreadPool& pool);
+
+    // Falls back to the scalar path; for testing. Has no effect where SSE2 is
+    // not available.
+public: void SetUseSimd(bool useSimd) { _useSimd = useSimd; }
+
+    // pSlices holds arraySize tightly packed width x height RGBA8 images.
+public: void Generate(const uint8_t* pSlices, uint32_t width, uint32_t height, uint32_t arraySize, const MipGenerationOptions& options, MipChain* pChain);
+
+public: const MipGenerationStats& GetStats() const { return _stats; }
+
+    // Per output texel, the source texels it reads and their weights.
+private: struct FilterTable
+    {
+        std::vector<uint32_t> first;    // Into indices/weights, one more than outputs.
+        std::vector<uint32_t> indices;
+        std::vector<float> weights;
+    };
+
+private: static void BuildFilter(uint32_t sourceSize, uint32_t destinationSize, MipFilter filter, FilterTable* pTable);
+
+private: void FilterRows(const float* pSource, uint32_t sourceWidth, const FilterTable& table, float* pDestination, size_t rowCount) const;
+private: void FilterColumns(const float* pSource, uint32_t width, const FilterTable& table, uint32_t row, float* pDestination) const;
+
+private: ThreadPool& _pool;
+private: bool _useSimd = true;
+private: MipGenerationStats _stats = {};
+
+    // Linear float texels of the current and next level, and the horizontally
+    // filtered intermediate, of all slices back to back.
+private: std::vector<float> _current;
+private: std::vector<float> _next;
+private: std::vector<float> _horizontal;
+private: FilterTable _horizontalFilter;
+private: FilterTable _verticalFilter;
+};
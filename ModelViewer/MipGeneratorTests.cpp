@@ -0,0 +1,121 @@
+#include "MipGenerator.h"
+#include "UnitTest.h"
+
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+    // Random colours and a hard alpha pattern, deterministic. Odd sizes so
+    // the filters hit their edge cases and the SIMD loops their remainders.
+    std::vector<uint8_t> MakeSlices(uint32_t width, uint32_t height, uint32_t arraySize)
+    {
+        std::vector<uint8_t> texels(static_cast<size_t>(width) * height * arraySize * 4);
+        uint32_t random = 3;
+        for (size_t i = 0; i < texels.size(); i++)
+        {
+            random = random * 1664525u + 1013904223u;
+            texels[i] = static_cast<uint8_t>(random >> 24);
+            if (i % 4 == 3)
+            {
+                texels[i] = (i / 4) % 7 < 3 ? 255 : 0;
+            }
+        }
+        return texels;
+    }
+
+    // The SSE2 and scalar paths must produce the same bytes for every filter,
+    // colour space and the alpha coverage pass. Prints the rate of both.
+    void TestSimdMatchesScalar()
+    {
+        const uint32_t width = 515;
+        const uint32_t height = 259;
+        const uint32_t arraySize = 2;
+        const std::vector<uint8_t> slices = MakeSlices(width, height, arraySize);
+
+        ThreadPool pool;
+        MipGenerator generator(pool);
+        const MipFilter filters[] = { MipFilter::Box, MipFilter::Kaiser };
+        const char* const filterNames[] = { "box", "kaiser" };
+        for (int f = 0; f < 2; f++)
+        {
+            for (int srgb = 0; srgb < 2; srgb++)
+            {
+                MipGenerationOptions options;
+                options.filter = filters[f];
+                options.srgb = srgb != 0;
+                options.alphaCoverageReference = 0.5f;
+
+                MipChain simd;
+                generator.SetUseSimd(true);
+                generator.Generate(slices.data(), width, height, arraySize, options, &simd);
+                const double simdRate = generator.GetStats().megapixelsPerSecond;
+
+                MipChain scalar;
+                generator.SetUseSimd(false);
+                generator.Generate(slices.data(), width, height, arraySize, options, &scalar);
+                const double scalarRate = generator.GetStats().megapixelsPerSecond;
+
+                CHECK(simd.mipCount == 10);
+                CHECK(simd.mipCount == scalar.mipCount);
+                CHECK(simd.levels.size() == static_cast<size_t>(simd.mipCount) * arraySize);
+                CHECK(simd.levels == scalar.levels);
+                printf("%-6s %-6s SIMD %7.1f MPix/s, scalar %7.1f MPix/s\n",
+                    filterNames[f], srgb ? "srgb" : "linear", simdRate, scalarRate);
+            }
+        }
+    }
+
+    // Filtering a constant image gives the same constant, in both colour
+    // spaces, down to 1x1.
+    void TestConstantImage()
+    {
+        const uint32_t width = 37;
+        const uint32_t height = 19;
+        const std::vector<uint8_t> texels(static_cast<size_t>(width) * height * 4, 77);
+
+        ThreadPool pool;
+        MipGenerator generator(pool);
+        for (int f = 0; f < 2; f++)
+        {
+            MipGenerationOptions options;
+            options.filter = f == 0 ? MipFilter::Box : MipFilter::Kaiser;
+            options.srgb = true;
+            MipChain chain;
+            generator.Generate(texels.data(), width, height, 1, options, &chain);
+
+            CHECK(chain.mipCount == 6);
+            CHECK(chain.GetMipWidth(5) == 1);
+            CHECK(chain.GetMipHeight(5) == 1);
+            for (const std::vector<uint8_t>& level : chain.levels)
+            {
+                for (uint8_t value : level)
+                {
+                    CHECK(value == 77);
+                }
+            }
+        }
+    }
+
+    void TestMaxMipCount()
+    {
+        const std::vector<uint8_t> texels = MakeSlices(64, 64, 1);
+        ThreadPool pool;
+        MipGenerator generator(pool);
+        MipGenerationOptions options;
+        options.maxMipCount = 3;
+        MipChain chain;
+        generator.Generate(texels.data(), 64, 64, 1, options, &chain);
+        CHECK(chain.mipCount == 3);
+        CHECK(chain.levels.size() == 3);
+        CHECK(chain.levels[2].size() == 16 * 16 * 4);
+    }
+}
+
+int main()
+{
+    TestSimdMatchesScalar();
+    TestConstantImage();
+    TestMaxMipCount();
+    return TestFailures();
+}
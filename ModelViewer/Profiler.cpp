@@ -0,0 +1,302 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+namespace
+{
+    inline int64_t SteadyNanoseconds()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
+
+ProfileEventRing::ProfileEventRing(size_t capacity)
+{
+    size_t size = 1;
+    while (size < capacity)
+    {
+        size <<= 1;
+    }
+    _events.resize(size);
+    _mask = size - 1;
+}
+
+bool ProfileEventRing::Push(const ProfileEvent& event)
+{
+    const uint64_t head = _head.load(std::memory_order_relaxed);
+    if (head - _tail.load(std::memory_order_acquire) >= _events.size())
+    {
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    _events[head & _mask] = event;
+    _head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+void ProfileEventRing::Drain(std::vector<ProfileEvent>* pEvents)
+{
+    const uint64_t tail = _tail.load(std::memory_order_relaxed);
+    const uint64_t head = _head.load(std::memory_order_acquire);
+    for (uint64_t i = tail; i != head; i++)
+    {
+        pEvents->push_back(_events[i & _mask]);
+    }
+    _tail.store(head, std::memory_order_release);
+}
+
+CpuProfiler& CpuProfiler::Get()
+{
+    static CpuProfiler profiler;
+    return profiler;
+}
+
+CpuProfiler::CpuProfiler() :
+    _epoch(SteadyNanoseconds())
+{
+}
+
+int64_t CpuProfiler::NowNanoseconds() const
+{
+    return SteadyNanoseconds() - _epoch;
+}
+
+struct CpuProfiler::ThreadSlot
+{
+    ThreadState state = { nullptr, 0, 0 };
+
+    ~ThreadSlot()
+    {
+        if (state.pRing != nullptr)
+        {
+            CpuProfiler::Get().ReleaseThreadState(state);
+        }
+    }
+};
+
+CpuProfiler::ThreadState& CpuProfiler::GetThreadState()
+{
+    thread_local ThreadSlot slot;
+    ThreadState& state = slot.state;
+    if (state.pRing == nullptr)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_freeThreadStates.empty())
+        {
+            state = _freeThreadStates.back();
+            _freeThreadStates.pop_back();
+        }
+        else
+        {
+            _rings.emplace_back(new ProfileEventRing(RingCapacity));
+            state.pRing = _rings.back().get();
+            state.timeline = static_cast<uint32_t>(_timelineNames.size());
+            _timelineNames.push_back(std::string());
+        }
+        _timelineNames[state.timeline] = "Thread " + std::to_string(state.timeline);
+    }
+    return state;
+}
+
+void CpuProfiler::ReleaseThreadState(const ThreadState& state)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _freeThreadStates.push_back({ state.pRing, state.timeline, 0 });
+}
+
+void CpuProfiler::SetThreadName(const char* name)
+{
+    ThreadState& state = GetThreadState();
+    std::lock_guard<std::mutex> lock(_mutex);
+    _timelineNames[state.timeline] = name;
+}
+
+uint32_t CpuProfiler::RegisterTimeline(const char* name)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _timelineNames.push_back(name);
+    return static_cast<uint32_t>(_timelineNames.size() - 1);
+}
+
+int64_t CpuProfiler::BeginScope()
+{
+    if (!IsEnabled())
+    {
+        return -1;
+    }
+    GetThreadState().depth++;
+    return NowNanoseconds();
+}
+
+void CpuProfiler::EndScope(const char* name, int64_t beginNanoseconds)
+{
+    const int64_t end = NowNanoseconds();
+    ThreadState& state = GetThreadState();
+    state.depth--;
+
+    const ProfileEvent event = { name, beginNanoseconds, end, state.timeline, state.depth };
+    state.pRing->Push(event);
+}
+
+void CpuProfiler::Collect(std::vector<ProfileEvent>* pEvents)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (const std::unique_ptr<ProfileEventRing>& ring : _rings)
+    {
+        ring->Drain(pEvents);
+    }
+}
+
+std::vector<std::string> CpuProfiler::GetTimelineNames()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _timelineNames;
+}
+
+uint64_t CpuProfiler::GetDroppedCount()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    uint64_t dropped = 0;
+    for (const std::unique_ptr<ProfileEventRing>& ring : _rings)
+    {
+        dropped += ring->GetDroppedCount();
+    }
+    return dropped;
+}
+
+void ProfileStatistics::AddFrame(const ProfileEvent* pEvents, size_t count)
+{
+    _frameTotals.clear();
+    for (size_t i = 0; i < count; i++)
+    {
+        const ProfileEvent& event = pEvents[i];
+        _frameTotals[event.name] += (event.endNanoseconds - event.beginNanoseconds) / 1000000.0;
+    }
+
+    for (const std::pair<const std::string, double>& total : _frameTotals)
+    {
+        Samples& samples = _samples[total.first];
+        if (samples.values.size() < History)
+        {
+            samples.values.push_back(total.second);
+        }
+        else
+        {
+            samples.values[samples.next] = total.second;
+        }
+        samples.next = (samples.next + 1) % History;
+    }
+}
+
+size_t GetNearestRankIndex(size_t count, double p)
+{
+    // Rounds up, less a hair so 0.95 * 100 is rank 95 and not 96.
+    const size_t rank = static_cast<size_t>(p * count + 0.999999);
+    return std::min(std::max<size_t>(rank, 1), count) - 1;
+}
+
+bool ProfileStatistics::GetPercentiles(const char* name, ProfilePercentiles* pPercentiles) const
+{
+    std::map<std::string, Samples>::const_iterator found = _samples.find(name);
+    if (found == _samples.end() || found->second.values.empty())
+    {
+        return false;
+    }
+
+    std::vector<double> sorted(found->second.values);
+    std::sort(sorted.begin(), sorted.end());
+
+    const size_t count = sorted.size();
+    pPercentiles->samples = static_cast<uint32_t>(count);
+    pPercentiles->p50Milliseconds = sorted[GetNearestRankIndex(count, 0.50)];
+    pPercentiles->p95Milliseconds = sorted[GetNearestRankIndex(count, 0.95)];
+    pPercentiles->p99Milliseconds = sorted[GetNearestRankIndex(count, 0.99)];
+    pPercentiles->maxMilliseconds = sorted.back();
+    return true;
+}
+
+std::string ProfileStatistics::FormatSummary(const char* const* pNames, size_t count) const
+{
+    std::string summary;
+    for (size_t i = 0; i < count; i++)
+    {
+        ProfilePercentiles percentiles;
+        if (!GetPercentiles(pNames[i], &percentiles))
+        {
+            continue;
+        }
+
+        char text[160];
+        snprintf(text, sizeof(text), "%s%s %.2f/%.2f/%.2f ms",
+            summary.empty() ? "" : " | ",
+            pNames[i],
+            percentiles.p50Milliseconds,
+            percentiles.p95Milliseconds,
+            percentiles.p99Milliseconds);
+        summary += text;
+    }
+    return summary;
+}
+
+void AppendJsonString(const char* text, std::string* pJson)
+{
+    pJson->push_back('"');
+    for (const char* p = text; *p; p++)
+    {
+        const unsigned char c = static_cast<unsigned char>(*p);
+        if (c == '"' || c == '\\')
+        {
+            pJson->push_back('\\');
+            pJson->push_back(static_cast<char>(c));
+        }
+        else if (c < 0x20)
+        {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            pJson->append(escaped);
+        }
+        else
+        {
+            pJson->push_back(static_cast<char>(c));
+        }
+    }
+    pJson->push_back('"');
+}
+
+void WriteChromeTrace(const ProfileEvent* pEvents, size_t count, const std::vector<std::string>& timelineNames, std::string* pJson)
+{
+    pJson->clear();
+    pJson->append("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+    bool first = true;
+    for (size_t i = 0; i < timelineNames.size(); i++)
+    {
+        char prefix[96];
+        snprintf(prefix, sizeof(prefix), "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":",
+            first ? "" : ",", static_cast<unsigned>(i));
+        pJson->append(prefix);
+        AppendJsonString(timelineNames[i].c_str(), pJson);
+        pJson->append("}}");
+        first = false;
+    }
+
+    // Timestamps and durations are in microseconds.
+    for (size_t i = 0; i < count; i++)
+    {
+        const ProfileEvent& event = pEvents[i];
+        pJson->append(first ? "\n{\"name\":" : ",\n{\"name\":");
+        AppendJsonString(event.name, pJson);
+
+        char fields[128];
+        snprintf(fields, sizeof(fields), ",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+            event.timeline,
+            event.beginNanoseconds / 1000.0,
+            (event.endNanoseconds - event.beginNanoseconds) / 1000.0);
+        pJson->append(fields);
+        first = false;
+    }
+
+    pJson->append("\n]}\n");
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// One timed scope. Names are not copied: use string literals.
+struct ProfileEvent
+{
+    const char* name;
+    int64_t beginNanoseconds;       // On the CpuProfiler clock.
+    int64_t endNanoseconds;
+    uint32_t timeline;              // A thread, or a GPU queue; see CpuProfiler::RegisterTimeline().
+    uint32_t depth;                 // Nesting inside the timeline, 0 for outermost scopes.
+};
+
+// Single producer, single consumer queue of finished events. The recording
+// thread pushes without locking; the collector drains. A full ring drops the
+// event and counts it rather than blocking the thread being measured.
+class ProfileEventRing
+{
+    // capacity is rounded up to a power of two.
+public: explicit ProfileEventRing(size_t capacity);
+
+public: bool Push(const ProfileEvent& event);
+public: void Drain(std::vector<ProfileEvent>* pEvents);
+
+public: uint64_t GetDroppedCount() const { return _dropped.load(std::memory_order_relaxed); }
+
+private: std::vector<ProfileEvent> _events;
+private: uint64_t _mask;
+private: std::atomic<uint64_t> _head{ 0 };     // Next slot written.
+private: std::atomic<uint64_t> _tail{ 0 };     // Next slot read.
+private: std::atomic<uint64_t> _dropped{ 0 };
+};
+
+// Hierarchical CPU scopes of every thread. Each thread records into its own
+// ring, created the first time it opens a scope; the only lock is taken then
+// and by Collect(). Disabled, a scope costs one relaxed load.
+//
+// A thread's ring and timeline go to the next thread that starts recording
+// after it exited, so threads coming and going do not add up; events left in
+// the ring are still collected, under the timeline's new name.
+class CpuProfiler
+{
+public: static CpuProfiler& Get();
+
+public: void SetEnabled(bool enabled) { _enabled.store(enabled, std::memory_order_relaxed); }
+public: bool IsEnabled() const { return _enabled.load(std::memory_order_relaxed); }
+
+    // Since the profiler was created.
+public: int64_t NowNanoseconds() const;
+
+    // Names the calling thread in exports.
+public: void SetThreadName(const char* name);
+
+    // A timeline events can be recorded on without being a thread, for GPU queues.
+public: uint32_t RegisterTimeline(const char* name);
+
+    // Returns the begin time to pass to EndScope(), or -1 when disabled.
+public: int64_t BeginScope();
+public: void EndScope(const char* name, int64_t beginNanoseconds);
+
+    // Appends everything recorded since the last call.
+public: void Collect(std::vector<ProfileEvent>* pEvents);
+
+    // Indexed by ProfileEvent::timeline.
+public: std::vector<std::string> GetTimelineNames();
+public: uint64_t GetDroppedCount();
+
+private: struct ThreadState
+    {
+        ProfileEventRing* pRing;
+        uint32_t timeline;
+        uint32_t depth;
+    };
+
+    // Holds the calling thread's state and hands it back when the thread exits.
+private: struct ThreadSlot;
+
+private: CpuProfiler();
+private: ThreadState& GetThreadState();
+private: void ReleaseThreadState(const ThreadState& state);
+
+private: static const size_t RingCapacity = 8192;
+
+private: std::atomic<bool> _enabled{ true };
+private: int64_t _epoch;
+private: std::mutex _mutex;
+private: std::vector<std::unique_ptr<ProfileEventRing>> _rings;
+private: std::vector<std::string> _timelineNames;
+private: std::vector<ThreadState> _freeThreadStates;
+};
+
+// Times the enclosing block on the calling thread.
+class ProfileScope
+{
+public: explicit ProfileScope(const char* name) :
+        _name(name),
+        _begin(CpuProfiler::Get().BeginScope())
+    {
+    }
+public: ~ProfileScope()
+    {
+        if (_begin >= 0)
+        {
+            CpuProfiler::Get().EndScope(_name, _begin);
+        }
+    }
+
+public: ProfileScope(const ProfileScope&) = delete;
+public: ProfileScope& operator=(const ProfileScope&) = delete;
+
+private: const char* _name;
+private: int64_t _begin;
+};
+
+#define PROFILE_SCOPE_CONCAT2(a, b) a##b
+#define PROFILE_SCOPE_CONCAT(a, b) PROFILE_SCOPE_CONCAT2(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_SCOPE_CONCAT(profileScope, __LINE__)(name)
+
+// Nearest-rank percentile: the index, among count sorted samples, of the
+// smallest sample that at least a fraction p of them do not exceed. count
+// must not be 0.
+size_t GetNearestRankIndex(size_t count, double p);
+
+struct ProfilePercentiles
+{
+    uint32_t samples;
+    double p50Milliseconds;
+    double p95Milliseconds;
+    double p99Milliseconds;
+    double maxMilliseconds;
+};
+
+// Rolling per-scope statistics over the last History frames. A frame's sample
+// of a scope is the total time of all its events of that name.
+class ProfileStatistics
+{
+public: static const size_t History = 240;
+
+public: void AddFrame(const ProfileEvent* pEvents, size_t count);
+
+    // False when the scope was never seen.
+public: bool GetPercentiles(const char* name, ProfilePercentiles* pPercentiles) const;
+
+    // "name p50/p95/p99 ms" for each scope, separated by " | ".
+public: std::string FormatSummary(const char* const* pNames, size_t count) const;
+
+private: struct Samples
+    {
+        std::vector<double> values;
+        size_t next = 0;
+    };
+
+private: std::map<std::string, Samples> _samples;
+private: std::map<std::string, double> _frameTotals;
+};
+
+// Appends text as a quoted JSON string.
+void AppendJsonString(const char* text, std::string* pJson);
+
+// Chrome trace event format (chrome://tracing, Perfetto): one complete event
+// per scope and the timeline names as thread names.
+void WriteChromeTrace(const ProfileEvent* pEvents, size_t count, const std::vector<std::string>& timelineNames, std::string* pJson);
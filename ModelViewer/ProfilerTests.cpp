@@ -0,0 +1,103 @@
+#include "Profiler.h"
+#include "UnitTest.h"
+
+#include <thread>
+#include <vector>
+
+namespace
+{
+    void TestNearestRank()
+    {
+        CHECK(GetNearestRankIndex(1, 0.0) == 0);
+        CHECK(GetNearestRankIndex(1, 0.99) == 0);
+        CHECK(GetNearestRankIndex(100, 0.50) == 49);
+        CHECK(GetNearestRankIndex(100, 0.95) == 94);
+        CHECK(GetNearestRankIndex(100, 0.99) == 98);
+        CHECK(GetNearestRankIndex(100, 1.0) == 99);
+        CHECK(GetNearestRankIndex(240, 0.95) == 227);
+        CHECK(GetNearestRankIndex(3, 0.5) == 1);
+        CHECK(GetNearestRankIndex(4, 0.5) == 1);
+        CHECK(GetNearestRankIndex(4, 0.0) == 0);
+    }
+
+    // Each frame's sample is the total of the scope's events; the history
+    // keeps the last History frames.
+    void TestStatistics()
+    {
+        ProfileStatistics statistics;
+        ProfilePercentiles percentiles;
+        CHECK(!statistics.GetPercentiles("Frame", &percentiles));
+
+        for (int frame = 1; frame <= 300; frame++)
+        {
+            const int64_t milliseconds = 1000000;
+            const ProfileEvent events[] =
+            {
+                { "Frame", 0, frame * milliseconds, 0, 0 },
+                { "Frame", 0, frame * milliseconds, 0, 0 },
+            };
+            statistics.AddFrame(events, 2);
+        }
+
+        CHECK(statistics.GetPercentiles("Frame", &percentiles));
+        CHECK(percentiles.samples == ProfileStatistics::History);
+        CHECK(percentiles.p50Milliseconds == 2.0 * 180);
+        CHECK(percentiles.p95Milliseconds == 2.0 * 288);
+        CHECK(percentiles.p99Milliseconds == 2.0 * 298);
+        CHECK(percentiles.maxMilliseconds == 2.0 * 300);
+    }
+
+    // Threads that exit hand their ring and timeline to the next one, and the
+    // events they left behind are still collected.
+    void TestThreadRecycling()
+    {
+        CpuProfiler& profiler = CpuProfiler::Get();
+        std::vector<ProfileEvent> events;
+        profiler.Collect(&events);
+        events.clear();
+
+        const size_t timelinesBefore = profiler.GetTimelineNames().size();
+        for (int i = 0; i < 100; i++)
+        {
+            std::thread thread([]()
+            {
+                PROFILE_SCOPE("Worker");
+            });
+            thread.join();
+        }
+        CHECK(profiler.GetTimelineNames().size() == timelinesBefore + 1);
+
+        // Live threads each get their own.
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 4; i++)
+        {
+            threads.emplace_back([&profiler]()
+            {
+                profiler.SetThreadName("Named");
+                PROFILE_SCOPE("Worker");
+            });
+        }
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+        const std::vector<std::string> names = profiler.GetTimelineNames();
+        CHECK(names.size() <= timelinesBefore + 4);
+
+        profiler.Collect(&events);
+        CHECK(events.size() == 104);
+        for (const ProfileEvent& event : events)
+        {
+            CHECK(event.timeline >= timelinesBefore && event.timeline < names.size());
+            CHECK(event.depth == 0);
+        }
+    }
+}
+
+int main()
+{
+    TestNearestRank();
+    TestStatistics();
+    TestThreadRecycling();
+    return TestFailures();
+}
@@ -0,0 +1,582 @@
+#include "RecordingDevice.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+    // Type and argument size of a command, 4 bytes in front of the arguments.
+    struct CommandHeader
+    {
+        uint16_t type;
+        uint16_t size;
+    };
+
+    // Keeps a barrier command below the 64 KB an argument size can describe.
+    const size_t MaxBarriersPerCommand = 2048;
+
+    // Made-up descriptor addresses start here; heaps never overlap.
+    const RenderDescriptor FirstDescriptor = 0x100000;
+
+    // Typical sizes of current hardware.
+    uint32_t GetRecordingDescriptorIncrement(RenderDescriptorType type)
+    {
+        return type == RenderDescriptorType::Sampler ? 16 : 32;
+    }
+
+    int64_t NowNanoseconds()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
+
+const char* GetRecordedCommandName(RecordedCommandType type)
+{
+    switch (type)
+    {
+    case RecordedCommandType::ResourceBarriers: return "ResourceBarriers";
+    case RecordedCommandType::SetPipelineState: return "SetPipelineState";
+    case RecordedCommandType::SetRootSignature: return "SetRootSignature";
+    case RecordedCommandType::SetRootConstants: return "SetRootConstants";
+    case RecordedCommandType::SetRootConstantBuffer: return "SetRootConstantBuffer";
+    case RecordedCommandType::SetRootShaderResource: return "SetRootShaderResource";
+    case RecordedCommandType::SetViewport: return "SetViewport";
+    case RecordedCommandType::SetScissorRect: return "SetScissorRect";
+    case RecordedCommandType::SetRenderTarget: return "SetRenderTarget";
+    case RecordedCommandType::ClearRenderTarget: return "ClearRenderTarget";
+    case RecordedCommandType::ClearDepthStencil: return "ClearDepthStencil";
+    case RecordedCommandType::SetPrimitiveTopology: return "SetPrimitiveTopology";
+    case RecordedCommandType::SetVertexBuffer: return "SetVertexBuffer";
+    case RecordedCommandType::SetIndexBuffer: return "SetIndexBuffer";
+    case RecordedCommandType::DrawIndexedInstanced: return "DrawIndexedInstanced";
+    case RecordedCommandType::ExecuteIndirect: return "ExecuteIndirect";
+    default: return "Unknown";
+    }
+}
+
+RecordedCommandReader::RecordedCommandReader(const uint8_t* pData, size_t size) :
+    _pCursor(pData),
+    _pCommandEnd(pData),
+    _pEnd(pData + size)
+{
+}
+
+bool RecordedCommandReader::Next(RecordedCommandType* pType)
+{
+    _pCursor = _pCommandEnd;
+    if (_pEnd - _pCursor < static_cast<ptrdiff_t>(sizeof(CommandHeader)))
+    {
+        return false;
+    }
+
+    CommandHeader header;
+    memcpy(&header, _pCursor, sizeof(header));
+    _pCursor += sizeof(header);
+    if (_pEnd - _pCursor < header.size)
+    {
+        throw std::runtime_error("Truncated command stream");
+    }
+    _pCommandEnd = _pCursor + header.size;
+    *pType = static_cast<RecordedCommandType>(header.type);
+    return true;
+}
+
+void RecordedCommandReader::ReadBytes(void* pDestination, size_t size)
+{
+    if (static_cast<size_t>(_pCommandEnd - _pCursor) < size)
+    {
+        throw std::runtime_error("Read past the end of a recorded command");
+    }
+    memcpy(pDestination, _pCursor, size);
+    _pCursor += size;
+}
+
+void DumpCommandStream(const uint8_t* pData, size_t size, std::string* pText)
+{
+    RecordedCommandReader reader(pData, size);
+    RecordedCommandType type;
+    char line[160];
+    while (reader.Next(&type))
+    {
+        pText->append(GetRecordedCommandName(type));
+
+        switch (type)
+        {
+        case RecordedCommandType::ResourceBarriers:
+        {
+            const uint32_t count = reader.Read<uint32_t>();
+            for (uint32_t i = 0; i < count; i++)
+            {
+                const TrackedBarrier barrier = reader.Read<TrackedBarrier>();
+                snprintf(line, sizeof(line), " [0x%" PRIx64 ":%d 0x%x->0x%x %u]",
+                    barrier.resource,
+                    barrier.subresource == AllSubresources ? -1 : static_cast<int>(barrier.subresource),
+                    barrier.stateBefore,
+                    barrier.stateAfter,
+                    static_cast<uint32_t>(barrier.flags));
+                pText->append(line);
+            }
+            line[0] = '\0';
+            break;
+        }
+        case RecordedCommandType::SetPipelineState:
+        case RecordedCommandType::SetRootSignature:
+            snprintf(line, sizeof(line), " 0x%" PRIx64, reader.Read<RenderHandle>());
+            break;
+        case RecordedCommandType::SetRootConstants:
+        {
+            const uint32_t index = reader.Read<uint32_t>();
+            const uint32_t destOffset = reader.Read<uint32_t>();
+            const uint32_t count = reader.Read<uint32_t>();
+            snprintf(line, sizeof(line), " %u +%u", index, destOffset);
+            pText->append(line);
+            for (uint32_t i = 0; i < count; i++)
+            {
+                snprintf(line, sizeof(line), " 0x%x", reader.Read<uint32_t>());
+                pText->append(line);
+            }
+            line[0] = '\0';
+            break;
+        }
+        case RecordedCommandType::SetRootConstantBuffer:
+        case RecordedCommandType::SetRootShaderResource:
+        {
+            const uint32_t index = reader.Read<uint32_t>();
+            snprintf(line, sizeof(line), " %u 0x%" PRIx64, index, reader.Read<uint64_t>());
+            break;
+        }
+        case RecordedCommandType::SetViewport:
+        {
+            const RenderViewport viewport = reader.Read<RenderViewport>();
+            snprintf(line, sizeof(line), " %g %g %g %g %g %g", viewport.x, viewport.y, viewport.width, viewport.height, viewport.minDepth, viewport.maxDepth);
+            break;
+        }
+        case RecordedCommandType::SetScissorRect:
+        {
+            const RenderRect rect = reader.Read<RenderRect>();
+            snprintf(line, sizeof(line), " %d %d %d %d", rect.left, rect.top, rect.right, rect.bottom);
+            break;
+        }
+        case RecordedCommandType::SetRenderTarget:
+        {
+            const RenderDescriptor renderTarget = reader.Read<RenderDescriptor>();
+            snprintf(line, sizeof(line), " 0x%" PRIx64 " 0x%" PRIx64, renderTarget, reader.Read<RenderDescriptor>());
+            break;
+        }
+        case RecordedCommandType::ClearRenderTarget:
+        {
+            const RenderDescriptor renderTarget = reader.Read<RenderDescriptor>();
+            float color[4];
+            reader.ReadBytes(color, sizeof(color));
+            snprintf(line, sizeof(line), " 0x%" PRIx64 " %g %g %g %g", renderTarget, color[0], color[1], color[2], color[3]);
+            break;
+        }
+        case RecordedCommandType::ClearDepthStencil:
+        {
+            const RenderDescriptor depthStencil = reader.Read<RenderDescriptor>();
+            snprintf(line, sizeof(line), " 0x%" PRIx64 " %g", depthStencil, reader.Read<float>());
+            break;
+        }
+        case RecordedCommandType::SetPrimitiveTopology:
+            snprintf(line, sizeof(line), " %u", reader.Read<uint32_t>());
+            break;
+        case RecordedCommandType::SetVertexBuffer:
+        {
+            const uint32_t slot = reader.Read<uint32_t>();
+            const uint64_t address = reader.Read<uint64_t>();
+            const uint32_t bufferSize = reader.Read<uint32_t>();
+            snprintf(line, sizeof(line), " %u 0x%" PRIx64 " %u %u", slot, address, bufferSize, reader.Read<uint32_t>());
+            break;
+        }
+        case RecordedCommandType::SetIndexBuffer:
+        {
+            const uint64_t address = reader.Read<uint64_t>();
+            const uint32_t bufferSize = reader.Read<uint32_t>();
+            snprintf(line, sizeof(line), " 0x%" PRIx64 " %u %u", address, bufferSize, reader.Read<uint32_t>());
+            break;
+        }
+        case RecordedCommandType::DrawIndexedInstanced:
+        {
+            const uint32_t indexCount = reader.Read<uint32_t>();
+            const uint32_t instanceCount = reader.Read<uint32_t>();
+            const uint32_t firstIndex = reader.Read<uint32_t>();
+            const int32_t baseVertex = reader.Read<int32_t>();
+            snprintf(line, sizeof(line), " %u %u %u %d %u", indexCount, instanceCount, firstIndex, baseVertex, reader.Read<uint32_t>());
+            break;
+        }
+        case RecordedCommandType::ExecuteIndirect:
+        {
+            const RenderHandle signature = reader.Read<RenderHandle>();
+            const uint32_t commandCount = reader.Read<uint32_t>();
+            const RenderHandle buffer = reader.Read<RenderHandle>();
+            snprintf(line, sizeof(line), " 0x%" PRIx64 " %u 0x%" PRIx64 " %" PRIu64, signature, commandCount, buffer, reader.Read<uint64_t>());
+            break;
+        }
+        default:
+            line[0] = '\0';
+            break;
+        }
+
+        pText->append(line);
+        pText->push_back('\n');
+    }
+}
+
+RecordingCommandList::RecordingCommandList() :
+    _commandCount(0),
+    _open(false)
+{
+}
+
+void RecordingCommandList::Reset(RenderHandle pipelineState)
+{
+    _stream.clear();
+    _commandCount = 0;
+    _open = true;
+
+    // The initial pipeline state D3D12 takes at reset.
+    if (pipelineState != 0)
+    {
+        SetPipelineState(pipelineState);
+    }
+}
+
+void RecordingCommandList::Close()
+{
+    if (!_open)
+    {
+        throw std::logic_error("Closing a command list that is not recording");
+    }
+    _open = false;
+}
+
+void RecordingCommandList::ResourceBarriers(const TrackedBarrier* pBarriers, size_t count)
+{
+    while (count > 0)
+    {
+        const uint32_t batch = static_cast<uint32_t>(std::min(count, MaxBarriersPerCommand));
+        BeginCommand(RecordedCommandType::ResourceBarriers, sizeof(uint32_t) + batch * sizeof(TrackedBarrier));
+        Append(batch);
+        Append(pBarriers, batch * sizeof(TrackedBarrier));
+        pBarriers += batch;
+        count -= batch;
+    }
+}
+
+void RecordingCommandList::SetPipelineState(RenderHandle pipelineState)
+{
+    BeginCommand(RecordedCommandType::SetPipelineState, sizeof(pipelineState));
+    Append(pipelineState);
+}
+
+void RecordingCommandList::SetGraphicsRootSignature(RenderHandle rootSignature)
+{
+    BeginCommand(RecordedCommandType::SetRootSignature, sizeof(rootSignature));
+    Append(rootSignature);
+}
+
+void RecordingCommandList::SetGraphicsRoot32BitConstants(uint32_t rootParameterIndex, uint32_t num32BitValues, const void* pData, uint32_t destOffsetIn32BitValues)
+{
+    BeginCommand(RecordedCommandType::SetRootConstants, 3 * sizeof(uint32_t) + num32BitValues * sizeof(uint32_t));
+    Append(rootParameterIndex);
+    Append(destOffsetIn32BitValues);
+    Append(num32BitValues);
+    Append(pData, num32BitValues * sizeof(uint32_t));
+}
+
+void RecordingCommandList::SetGraphicsRootConstantBufferView(uint32_t rootParameterIndex, uint64_t address)
+{
+    BeginCommand(RecordedCommandType::SetRootConstantBuffer, sizeof(rootParameterIndex) + sizeof(address));
+    Append(rootParameterIndex);
+    Append(address);
+}
+
+void RecordingCommandList::SetGraphicsRootShaderResourceView(uint32_t rootParameterIndex, uint64_t address)
+{
+    BeginCommand(RecordedCommandType::SetRootShaderResource, sizeof(rootParameterIndex) + sizeof(address));
+    Append(rootParameterIndex);
+    Append(address);
+}
+
+void RecordingCommandList::SetViewport(const RenderViewport& viewport)
+{
+    BeginCommand(RecordedCommandType::SetViewport, sizeof(viewport));
+    Append(viewport);
+}
+
+void RecordingCommandList::SetScissorRect(const RenderRect& rect)
+{
+    BeginCommand(RecordedCommandType::SetScissorRect, sizeof(rect));
+    Append(rect);
+}
+
+void RecordingCommandList::SetRenderTarget(RenderDescriptor renderTarget, RenderDescriptor depthStencil)
+{
+    BeginCommand(RecordedCommandType::SetRenderTarget, sizeof(renderTarget) + sizeof(depthStencil));
+    Append(renderTarget);
+    Append(depthStencil);
+}
+
+void RecordingCommandList::ClearRenderTarget(RenderDescriptor renderTarget, const float color[4])
+{
+    BeginCommand(RecordedCommandType::ClearRenderTarget, sizeof(renderTarget) + 4 * sizeof(float));
+    Append(renderTarget);
+    Append(color, 4 * sizeof(float));
+}
+
+void RecordingCommandList::ClearDepthStencil(RenderDescriptor depthStencil, float depth)
+{
+    BeginCommand(RecordedCommandType::ClearDepthStencil, sizeof(depthStencil) + sizeof(depth));
+    Append(depthStencil);
+    Append(depth);
+}
+
+void RecordingCommandList::SetPrimitiveTopology(uint32_t topology)
+{
+    BeginCommand(RecordedCommandType::SetPrimitiveTopology, sizeof(topology));
+    Append(topology);
+}
+
+void RecordingCommandList::SetVertexBuffer(uint32_t slot, uint64_t address, uint32_t size, uint32_t stride)
+{
+    BeginCommand(RecordedCommandType::SetVertexBuffer, sizeof(slot) + sizeof(address) + sizeof(size) + sizeof(stride));
+    Append(slot);
+    Append(address);
+    Append(size);
+    Append(stride);
+}
+
+void RecordingCommandList::SetIndexBuffer(uint64_t address, uint32_t size, uint32_t format)
+{
+    BeginCommand(RecordedCommandType::SetIndexBuffer, sizeof(address) + sizeof(size) + sizeof(format));
+    Append(address);
+    Append(size);
+    Append(format);
+}
+
+void RecordingCommandList::DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t baseVertex, uint32_t firstInstance)
+{
+    BeginCommand(RecordedCommandType::DrawIndexedInstanced, 5 * sizeof(uint32_t));
+    Append(indexCount);
+    Append(instanceCount);
+    Append(firstIndex);
+    Append(baseVertex);
+    Append(firstInstance);
+}
+
+void RecordingCommandList::ExecuteIndirect(RenderHandle commandSignature, uint32_t commandCount, RenderHandle argumentBuffer, uint64_t argumentOffset)
+{
+    BeginCommand(RecordedCommandType::ExecuteIndirect, sizeof(commandSignature) + sizeof(commandCount) + sizeof(argumentBuffer) + sizeof(argumentOffset));
+    Append(commandSignature);
+    Append(commandCount);
+    Append(argumentBuffer);
+    Append(argumentOffset);
+}
+
+void RecordingCommandList::BeginCommand(RecordedCommandType type, size_t argumentSize)
+{
+    if (!_open)
+    {
+        throw std::logic_error("Recording into a closed command list");
+    }
+
+    const CommandHeader header = { static_cast<uint16_t>(type), static_cast<uint16_t>(argumentSize) };
+    Append(header);
+    _commandCount++;
+}
+
+void RecordingCommandList::Append(const void* pData, size_t size)
+{
+    const size_t offset = _stream.size();
+    _stream.resize(offset + size);
+    memcpy(_stream.data() + offset, pData, size);
+}
+
+RecordingFence::RecordingFence(uint64_t initialValue) :
+    _completedValue(initialValue)
+{
+}
+
+uint64_t RecordingFence::GetCompletedValue()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    Advance(NowNanoseconds());
+    return _completedValue;
+}
+
+void RecordingFence::Wait(uint64_t value)
+{
+    int64_t readyNanoseconds = 0;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        Advance(NowNanoseconds());
+        if (_completedValue >= value)
+        {
+            return;
+        }
+
+        std::deque<PendingSignal>::const_iterator signal = std::find_if(_pending.begin(), _pending.end(), [value](const PendingSignal& pending)
+        {
+            return pending.value >= value;
+        });
+        if (signal == _pending.end())
+        {
+            throw std::logic_error("Waiting for a fence value that is never signaled");
+        }
+        readyNanoseconds = signal->readyNanoseconds;
+    }
+
+    std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::nanoseconds(readyNanoseconds)));
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    Advance(std::max(NowNanoseconds(), readyNanoseconds));
+}
+
+void RecordingFence::Signal(uint64_t value, int64_t readyNanoseconds)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _pending.push_back({ value, readyNanoseconds });
+    Advance(NowNanoseconds());
+}
+
+// Signals on a queue complete in order, like the GPU timeline they model.
+void RecordingFence::Advance(int64_t nowNanoseconds)
+{
+    while (!_pending.empty() && _pending.front().readyNanoseconds <= nowNanoseconds)
+    {
+        _completedValue = _pending.front().value;
+        _pending.pop_front();
+    }
+}
+
+RecordingQueue::RecordingQueue(const RecordingDeviceDesc& desc) :
+    _desc(desc),
+    _gpuNanoseconds(0)
+{
+}
+
+void RecordingQueue::ExecuteCommandLists(RenderCommandList* const* ppCommandLists, size_t count)
+{
+    // Work starts when it is submitted or when the previous work is done.
+    _gpuNanoseconds = std::max(_gpuNanoseconds, NowNanoseconds());
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const RecordingCommandList* pCommandList = dynamic_cast<const RecordingCommandList*>(ppCommandLists[i]);
+        if (pCommandList == nullptr)
+        {
+            throw std::invalid_argument("Executing a command list of another device");
+        }
+        if (!pCommandList->IsClosed())
+        {
+            throw std::logic_error("Executing a command list that is still recording");
+        }
+
+        const std::vector<uint8_t>& stream = pCommandList->GetStream();
+        _stats.executedCommandLists++;
+        _stats.executedCommands += pCommandList->GetCommandCount();
+        _stats.executedBytes += stream.size();
+        _gpuNanoseconds += _desc.commandNanoseconds * pCommandList->GetCommandCount();
+
+        if (_desc.keepSubmissions)
+        {
+            _submitted.insert(_submitted.end(), stream.begin(), stream.end());
+        }
+    }
+}
+
+void RecordingQueue::Signal(RenderFence& fence, uint64_t value)
+{
+    RecordingFence* pFence = dynamic_cast<RecordingFence*>(&fence);
+    if (pFence == nullptr)
+    {
+        throw std::invalid_argument("Signaling a fence of another device");
+    }
+
+    _stats.signals++;
+    _gpuNanoseconds = std::max(_gpuNanoseconds, NowNanoseconds());
+    pFence->Signal(value, _gpuNanoseconds + _desc.fenceLatencyNanoseconds);
+}
+
+RecordingDevice::RecordingDevice(const RecordingDeviceDesc& desc) :
+    _queue(desc),
+    _nextDescriptor(FirstDescriptor)
+{
+}
+
+std::unique_ptr<RenderCommandList> RecordingDevice::CreateCommandList()
+{
+    return std::unique_ptr<RenderCommandList>(new RecordingCommandList());
+}
+
+std::unique_ptr<RenderFence> RecordingDevice::CreateFence(uint64_t initialValue)
+{
+    return std::unique_ptr<RenderFence>(new RecordingFence(initialValue));
+}
+
+RenderHandle RecordingDevice::CreateDescriptorHeap(RenderDescriptorType type, uint32_t count)
+{
+    DescriptorHeap heap;
+    heap.type = type;
+    heap.start = _nextDescriptor;
+    heap.count = count;
+    _descriptorHeaps.push_back(heap);
+
+    // A gap between heaps so running off the end of one is caught.
+    _nextDescriptor += static_cast<RenderDescriptor>(count + 1) * GetDescriptorIncrement(type);
+
+    // Handles start at 1; 0 stays invalid.
+    return _descriptorHeaps.size();
+}
+
+RenderDescriptor RecordingDevice::GetDescriptorHeapStart(RenderHandle heap)
+{
+    if (heap == 0 || heap > _descriptorHeaps.size())
+    {
+        throw std::invalid_argument("Unknown descriptor heap");
+    }
+    return _descriptorHeaps[heap - 1].start;
+}
+
+uint32_t RecordingDevice::GetDescriptorIncrement(RenderDescriptorType type)
+{
+    return GetRecordingDescriptorIncrement(type);
+}
+
+void RecordingDevice::CreateRenderTargetView(RenderHandle resource, RenderDescriptor destination)
+{
+    const DescriptorHeap* pHeap = FindDescriptorHeap(destination);
+    if (pHeap == nullptr || pHeap->type != RenderDescriptorType::Rtv)
+    {
+        throw std::out_of_range("Render target view outside of a render target view heap");
+    }
+    if ((destination - pHeap->start) % GetRecordingDescriptorIncrement(pHeap->type) != 0)
+    {
+        throw std::invalid_argument("Misaligned render target view descriptor");
+    }
+    _renderTargetViews[destination] = resource;
+}
+
+RenderHandle RecordingDevice::GetRenderTargetViewResource(RenderDescriptor descriptor) const
+{
+    std::unordered_map<RenderDescriptor, RenderHandle>::const_iterator found = _renderTargetViews.find(descriptor);
+    return found != _renderTargetViews.end() ? found->second : 0;
+}
+
+const RecordingDevice::DescriptorHeap* RecordingDevice::FindDescriptorHeap(RenderDescriptor descriptor) const
+{
+    for (const DescriptorHeap& heap : _descriptorHeaps)
+    {
+        const RenderDescriptor end = heap.start + static_cast<RenderDescriptor>(heap.count) * GetRecordingDescriptorIncrement(heap.type);
+        if (descriptor >= heap.start && descriptor < end)
+        {
+            return &heap;
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,201 @@
+#pragma once
+
+#include "RenderDevice.h"
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+enum class RecordedCommandType : uint16_t
+{
+    ResourceBarriers,       // uint32_t count, TrackedBarrier[count]
+    SetPipelineState,       // RenderHandle
+    SetRootSignature,       // RenderHandle
+    SetRootConstants,       // uint32_t index, uint32_t destOffset, uint32_t count, uint32_t[count]
+    SetRootConstantBuffer,  // uint32_t index, uint64_t address
+    SetRootShaderResource,  // uint32_t index, uint64_t address
+    SetViewport,            // RenderViewport
+    SetScissorRect,         // RenderRect
+    SetRenderTarget,        // RenderDescriptor renderTarget, RenderDescriptor depthStencil
+    ClearRenderTarget,      // RenderDescriptor, float[4]
+    ClearDepthStencil,      // RenderDescriptor, float
+    SetPrimitiveTopology,   // uint32_t
+    SetVertexBuffer,        // uint32_t slot, uint64_t address, uint32_t size, uint32_t stride
+    SetIndexBuffer,         // uint64_t address, uint32_t size, uint32_t format
+    DrawIndexedInstanced,   // uint32_t indexCount, instanceCount, firstIndex, int32_t baseVertex, uint32_t firstInstance
+    ExecuteIndirect,        // RenderHandle signature, uint32_t count, RenderHandle buffer, uint64_t offset
+    Count,
+};
+
+const char* GetRecordedCommandName(RecordedCommandType type);
+
+// Walks a recorded command stream. Every command is a header with its type
+// and argument size, followed by the arguments listed above packed without
+// padding; Read() them in that order.
+class RecordedCommandReader
+{
+public: RecordedCommandReader(const uint8_t* pData, size_t size);
+
+    // False at the end of the stream. Skips what was not read of the previous command.
+public: bool Next(RecordedCommandType* pType);
+
+public: template <typename T> T Read()
+    {
+        T value;
+        ReadBytes(&value, sizeof(value));
+        return value;
+    }
+public: void ReadBytes(void* pDestination, size_t size);
+
+private: const uint8_t* _pCursor;
+private: const uint8_t* _pCommandEnd;
+private: const uint8_t* _pEnd;
+};
+
+// One line per command, for comparing streams in tests and diffs.
+void DumpCommandStream(const uint8_t* pData, size_t size, std::string* pText);
+
+// Records commands into a compact binary stream instead of a GPU command list.
+// Like D3D12, recording is only valid between Reset() and Close(); misuse throws
+// std::logic_error instead of being caught by the debug layer.
+class RecordingCommandList : public RenderCommandList
+{
+public: RecordingCommandList();
+
+public: virtual void Reset(RenderHandle pipelineState);
+public: virtual void Close();
+
+public: virtual void ResourceBarriers(const TrackedBarrier* pBarriers, size_t count);
+
+public: virtual void SetPipelineState(RenderHandle pipelineState);
+public: virtual void SetGraphicsRootSignature(RenderHandle rootSignature);
+public: virtual void SetGraphicsRoot32BitConstants(uint32_t rootParameterIndex, uint32_t num32BitValues, const void* pData, uint32_t destOffsetIn32BitValues);
+public: virtual void SetGraphicsRootConstantBufferView(uint32_t rootParameterIndex, uint64_t address);
+public: virtual void SetGraphicsRootShaderResourceView(uint32_t rootParameterIndex, uint64_t address);
+
+public: virtual void SetViewport(const RenderViewport& viewport);
+public: virtual void SetScissorRect(const RenderRect& rect);
+public: virtual void SetRenderTarget(RenderDescriptor renderTarget, RenderDescriptor depthStencil);
+public: virtual void ClearRenderTarget(RenderDescriptor renderTarget, const float color[4]);
+public: virtual void ClearDepthStencil(RenderDescriptor depthStencil, float depth);
+
+public: virtual void SetPrimitiveTopology(uint32_t topology);
+public: virtual void SetVertexBuffer(uint32_t slot, uint64_t address, uint32_t size, uint32_t stride);
+public: virtual void SetIndexBuffer(uint64_t address, uint32_t size, uint32_t format);
+
+public: virtual void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t baseVertex, uint32_t firstInstance);
+public: virtual void ExecuteIndirect(RenderHandle commandSignature, uint32_t commandCount, RenderHandle argumentBuffer, uint64_t argumentOffset);
+
+public: bool IsClosed() const { return !_open; }
+public: const std::vector<uint8_t>& GetStream() const { return _stream; }
+public: uint32_t GetCommandCount() const { return _commandCount; }
+
+private: void BeginCommand(RecordedCommandType type, size_t argumentSize);
+private: void Append(const void* pData, size_t size);
+private: template <typename T> void Append(const T& value) { Append(&value, sizeof(value)); }
+
+private: std::vector<uint8_t> _stream;
+private: uint32_t _commandCount;
+private: bool _open;
+};
+
+// Fences complete on a simulated GPU timeline, see RecordingDeviceDesc.
+class RecordingFence : public RenderFence
+{
+public: explicit RecordingFence(uint64_t initialValue);
+
+public: virtual uint64_t GetCompletedValue();
+
+    // Throws std::logic_error when nothing signaled will ever reach value,
+    // where a GPU would hang.
+public: virtual void Wait(uint64_t value);
+
+    // Called by the queue: value is reached at readyNanoseconds, steady clock.
+public: void Signal(uint64_t value, int64_t readyNanoseconds);
+
+private: struct PendingSignal
+    {
+        uint64_t value;
+        int64_t readyNanoseconds;
+    };
+
+private: void Advance(int64_t nowNanoseconds);
+
+private: std::mutex _mutex;
+private: uint64_t _completedValue;
+private: std::deque<PendingSignal> _pending;
+};
+
+// With both delays at zero every fence completes as soon as it is signaled and
+// runs are fully deterministic. Otherwise submissions run one after another on
+// a simulated GPU: each takes commandNanoseconds per recorded command, and a
+// fence is reached fenceLatencyNanoseconds after the work before it finished.
+struct RecordingDeviceDesc
+{
+    int64_t commandNanoseconds = 0;
+    int64_t fenceLatencyNanoseconds = 0;
+    bool keepSubmissions = false;       // Append executed streams to GetSubmittedStream().
+};
+
+struct RecordingDeviceStats
+{
+    uint64_t executedCommandLists;
+    uint64_t executedCommands;
+    uint64_t executedBytes;
+    uint64_t signals;
+};
+
+class RecordingQueue : public RenderQueue
+{
+public: explicit RecordingQueue(const RecordingDeviceDesc& desc);
+
+public: virtual void ExecuteCommandLists(RenderCommandList* const* ppCommandLists, size_t count);
+public: virtual void Signal(RenderFence& fence, uint64_t value);
+
+public: const RecordingDeviceStats& GetStats() const { return _stats; }
+public: const std::vector<uint8_t>& GetSubmittedStream() const { return _submitted; }
+public: void ClearSubmittedStream() { _submitted.clear(); }
+
+private: RecordingDeviceDesc _desc;
+private: int64_t _gpuNanoseconds;      // When the simulated GPU is done with everything submitted.
+private: RecordingDeviceStats _stats = {};
+private: std::vector<uint8_t> _submitted;
+};
+
+// Device of the recording backend. Only works with the command lists and
+// fences it created. Descriptors are made-up addresses; heaps remember which
+// resource each render target view was created for.
+class RecordingDevice : public RenderDevice
+{
+public: explicit RecordingDevice(const RecordingDeviceDesc& desc = RecordingDeviceDesc());
+
+public: virtual RenderQueue& GetQueue() { return _queue; }
+
+public: virtual std::unique_ptr<RenderCommandList> CreateCommandList();
+public: virtual std::unique_ptr<RenderFence> CreateFence(uint64_t initialValue);
+
+public: virtual RenderHandle CreateDescriptorHeap(RenderDescriptorType type, uint32_t count);
+public: virtual RenderDescriptor GetDescriptorHeapStart(RenderHandle heap);
+public: virtual uint32_t GetDescriptorIncrement(RenderDescriptorType type);
+public: virtual void CreateRenderTargetView(RenderHandle resource, RenderDescriptor destination);
+
+    // 0 when no view was created at descriptor.
+public: RenderHandle GetRenderTargetViewResource(RenderDescriptor descriptor) const;
+
+public: RecordingQueue& GetRecordingQueue() { return _queue; }
+
+private: struct DescriptorHeap
+    {
+        RenderDescriptorType type;
+        RenderDescriptor start;
+        uint32_t count;
+    };
+
+private: const DescriptorHeap* FindDescriptorHeap(RenderDescriptor descriptor) const;
+
+private: RecordingQueue _queue;
+private: std::vector<DescriptorHeap> _descriptorHeaps;
+private: RenderDescriptor _nextDescriptor;
+private: std::unordered_map<RenderDescriptor, RenderHandle> _renderTargetViews;
+};
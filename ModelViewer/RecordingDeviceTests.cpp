@@ -0,0 +1,266 @@
+#include "RecordingDevice.h"
+#include "UnitTest.h"
+
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+    template <typename Exception, typename Function>
+    bool Throws(Function function)
+    {
+        try
+        {
+            function();
+        }
+        catch (const Exception&)
+        {
+            return true;
+        }
+        return false;
+    }
+
+    // One of every command, with arguments that are easy to tell apart.
+    void RecordEverything(RecordingCommandList* pList)
+    {
+        pList->Reset(0x11);
+
+        const TrackedBarrier barriers[] =
+        {
+            { 0x100, AllSubresources, 0x4, 0x80, TrackedBarrierFlags::None },
+            { 0x200, 3, 0x1, 0x8, TrackedBarrierFlags::BeginOnly },
+        };
+        pList->ResourceBarriers(barriers, 2);
+        pList->SetGraphicsRootSignature(0x22);
+        const uint32_t constants[] = { 7, 8, 9 };
+        pList->SetGraphicsRoot32BitConstants(1, 3, constants, 2);
+        pList->SetGraphicsRootConstantBufferView(2, 0xabc00);
+        pList->SetGraphicsRootShaderResourceView(3, 0xdef00);
+        pList->SetViewport({ 0.0f, 0.0f, 1280.0f, 720.0f, 0.0f, 1.0f });
+        pList->SetScissorRect({ 0, 0, 1280, 720 });
+        pList->SetRenderTarget(0x1000, 0x2000);
+        const float color[4] = { 0.25f, 0.5f, 0.75f, 1.0f };
+        pList->ClearRenderTarget(0x1000, color);
+        pList->ClearDepthStencil(0x2000, 1.0f);
+        pList->SetPrimitiveTopology(4);
+        pList->SetVertexBuffer(0, 0x30000, 960, 32);
+        pList->SetIndexBuffer(0x40000, 144, 42);
+        pList->DrawIndexedInstanced(36, 2, 6, -4, 1);
+        pList->ExecuteIndirect(0x33, 5, 0x44, 256);
+        pList->Close();
+    }
+
+    // Every command reads back with the arguments it was recorded with, in
+    // order, and the text dump shows them.
+    void TestStreamRoundTrip()
+    {
+        RecordingCommandList list;
+        RecordEverything(&list);
+        CHECK(list.IsClosed());
+        CHECK(list.GetCommandCount() == static_cast<uint32_t>(RecordedCommandType::Count));
+
+        const std::vector<uint8_t>& stream = list.GetStream();
+        RecordedCommandReader reader(stream.data(), stream.size());
+        RecordedCommandType type;
+
+        CHECK(reader.Next(&type) && type == RecordedCommandType::SetPipelineState);
+        CHECK(reader.Read<RenderHandle>() == 0x11);
+
+        CHECK(reader.Next(&type) && type == RecordedCommandType::ResourceBarriers);
+        CHECK(reader.Read<uint32_t>() == 2);
+        const TrackedBarrier first = reader.Read<TrackedBarrier>();
+        CHECK(first.resource == 0x100 && first.subresource == AllSubresources && first.stateBefore == 0x4 && first.stateAfter == 0x80);
+        const TrackedBarrier second = reader.Read<TrackedBarrier>();
+        CHECK(second.resource == 0x200 && second.subresource == 3 && second.flags == TrackedBarrierFlags::BeginOnly);
+
+        CHECK(reader.Next(&type) && type == RecordedCommandType::SetRootSignature);
+        CHECK(reader.Read<RenderHandle>() == 0x22);
+
+        CHECK(reader.Next(&type) && type == RecordedCommandType::SetRootConstants);
+        CHECK(reader.Read<uint32_t>() == 1);
+        CHECK(reader.Read<uint32_t>() == 2);
+        CHECK(reader.Read<uint32_t>() == 3);
+        CHECK(reader.Read<uint32_t>() == 7);
+        CHECK(reader.Read<uint32_t>() == 8);
+        CHECK(reader.Read<uint32_t>() == 9);
+
+        // Reading past the end of a command throws; skipping the rest of one
+        // is fine.
+        CHECK(Throws<std::runtime_error>([&]() { reader.Read<uint32_t>(); }));
+        CHECK(reader.Next(&type) && type == RecordedCommandType::SetRootConstantBuffer);
+        CHECK(reader.Next(&type) && type == RecordedCommandType::SetRootShaderResource);
+        CHECK(reader.Read<uint32_t>() == 3);
+        CHECK(reader.Read<uint64_t>() == 0xdef00);
+
+        CHECK(reader.Next(&type) && type == RecordedCommandType::SetViewport);
+        const RenderViewport viewport = reader.Read<RenderViewport>();
+        CHECK(viewport.width == 1280.0f && viewport.height == 720.0f && viewport.maxDepth == 1.0f);
+
+        for (int i = 0; i < 7; i++)
+        {
+            CHECK(reader.Next(&type));
+        }
+        CHECK(type == RecordedCommandType::SetIndexBuffer);
+
+        CHECK(reader.Next(&type) && type == RecordedCommandType::DrawIndexedInstanced);
+        CHECK(reader.Read<uint32_t>() == 36);
+        CHECK(reader.Read<uint32_t>() == 2);
+        CHECK(reader.Read<uint32_t>() == 6);
+        CHECK(reader.Read<int32_t>() == -4);
+        CHECK(reader.Read<uint32_t>() == 1);
+
+        CHECK(reader.Next(&type) && type == RecordedCommandType::ExecuteIndirect);
+        CHECK(reader.Read<RenderHandle>() == 0x33);
+        CHECK(reader.Read<uint32_t>() == 5);
+        CHECK(reader.Read<RenderHandle>() == 0x44);
+        CHECK(reader.Read<uint64_t>() == 256);
+        CHECK(!reader.Next(&type));
+
+        std::string text;
+        DumpCommandStream(stream.data(), stream.size(), &text);
+        CHECK(text.find("SetPipelineState 0x11\n") == 0);
+        CHECK(text.find("ResourceBarriers [0x100:-1 0x4->0x80 0] [0x200:3 0x1->0x8 1]\n") != std::string::npos);
+        CHECK(text.find("SetRootConstants 1 +2 0x7 0x8 0x9\n") != std::string::npos);
+        CHECK(text.find("ClearRenderTarget 0x1000 0.25 0.5 0.75 1\n") != std::string::npos);
+        CHECK(text.find("DrawIndexedInstanced 36 2 6 -4 1\n") != std::string::npos);
+        CHECK(text.find("ExecuteIndirect 0x33 5 0x44 256\n") != std::string::npos);
+
+        // A stream cut short in the middle of a command is caught.
+        RecordedCommandReader truncated(stream.data(), 6);
+        CHECK(Throws<std::runtime_error>([&]() { truncated.Next(&type); }));
+    }
+
+    // Recording the same commands twice gives the same stream; the queue
+    // keeps what it executed and counts it.
+    void TestQueueSubmissions()
+    {
+        RecordingDeviceDesc desc;
+        desc.keepSubmissions = true;
+        RecordingDevice device(desc);
+        std::unique_ptr<RenderCommandList> first = device.CreateCommandList();
+        std::unique_ptr<RenderCommandList> second = device.CreateCommandList();
+        RecordEverything(static_cast<RecordingCommandList*>(first.get()));
+        RecordEverything(static_cast<RecordingCommandList*>(second.get()));
+
+        RenderCommandList* const lists[] = { first.get(), second.get() };
+        device.GetQueue().ExecuteCommandLists(lists, 2);
+        const RecordingDeviceStats& stats = device.GetRecordingQueue().GetStats();
+        const std::vector<uint8_t>& stream = static_cast<RecordingCommandList*>(first.get())->GetStream();
+        CHECK(stats.executedCommandLists == 2);
+        CHECK(stats.executedCommands == 2 * static_cast<uint64_t>(RecordedCommandType::Count));
+        CHECK(stats.executedBytes == 2 * stream.size());
+
+        std::string one;
+        std::string both;
+        DumpCommandStream(stream.data(), stream.size(), &one);
+        const std::vector<uint8_t>& submitted = device.GetRecordingQueue().GetSubmittedStream();
+        DumpCommandStream(submitted.data(), submitted.size(), &both);
+        CHECK(both == one + one);
+
+        device.GetRecordingQueue().ClearSubmittedStream();
+        CHECK(device.GetRecordingQueue().GetSubmittedStream().empty());
+    }
+
+    // Recording outside Reset()/Close(), or executing an open list, throws
+    // where D3D12's debug layer would complain.
+    void TestMisuse()
+    {
+        RecordingDevice device;
+        RecordingCommandList list;
+        CHECK(Throws<std::logic_error>([&]() { list.SetPrimitiveTopology(4); }));
+        CHECK(Throws<std::logic_error>([&]() { list.Close(); }));
+
+        list.Reset(0);
+        CHECK(list.GetCommandCount() == 0);
+        list.SetPrimitiveTopology(4);
+        RenderCommandList* const lists[] = { &list };
+        CHECK(Throws<std::logic_error>([&]() { device.GetQueue().ExecuteCommandLists(lists, 1); }));
+        list.Close();
+        CHECK(Throws<std::logic_error>([&]() { list.Close(); }));
+        CHECK(Throws<std::logic_error>([&]() { list.SetPrimitiveTopology(4); }));
+
+        // Reset starts over.
+        list.Reset(0);
+        CHECK(list.GetStream().empty());
+        list.Close();
+    }
+
+    // With no delays a fence completes when it is signaled; waiting for a
+    // value nothing will signal throws instead of hanging.
+    void TestFenceWait()
+    {
+        RecordingDevice device;
+        std::unique_ptr<RenderFence> fence = device.CreateFence(0);
+        CHECK(fence->GetCompletedValue() == 0);
+        fence->Wait(0);
+
+        device.GetQueue().Signal(*fence, 1);
+        CHECK(fence->GetCompletedValue() == 1);
+        fence->Wait(1);
+
+        CHECK(Throws<std::logic_error>([&]() { fence->Wait(2); }));
+
+        // A later signal covers every value below it.
+        device.GetQueue().Signal(*fence, 5);
+        fence->Wait(3);
+        CHECK(fence->GetCompletedValue() == 5);
+        CHECK(device.GetRecordingQueue().GetStats().signals == 2);
+    }
+
+    double MillisecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // With delays, a fence lags behind its signal by the simulated GPU time:
+    // the commands before it plus the fence latency, and submissions queue
+    // up behind each other. Only lower bounds are checked, a busy machine
+    // can always be later.
+    void TestSimulatedLatency()
+    {
+        RecordingDeviceDesc desc;
+        desc.commandNanoseconds = 1000000;
+        desc.fenceLatencyNanoseconds = 5000000;
+        RecordingDevice device(desc);
+        std::unique_ptr<RenderFence> fence = device.CreateFence(0);
+        std::unique_ptr<RenderCommandList> list = device.CreateCommandList();
+        RecordEverything(static_cast<RecordingCommandList*>(list.get()));
+        const uint32_t commands = static_cast<RecordingCommandList*>(list.get())->GetCommandCount();
+        RenderCommandList* const lists[] = { list.get() };
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        device.GetQueue().ExecuteCommandLists(lists, 1);
+        device.GetQueue().Signal(*fence, 1);
+        CHECK(fence->GetCompletedValue() == 0);
+        fence->Wait(1);
+        const double single = MillisecondsSince(start);
+        CHECK(fence->GetCompletedValue() == 1);
+        CHECK(single >= commands + 5.0);
+
+        // Two submissions back to back: the second fence waits for both.
+        start = std::chrono::steady_clock::now();
+        device.GetQueue().ExecuteCommandLists(lists, 1);
+        device.GetQueue().Signal(*fence, 2);
+        device.GetQueue().ExecuteCommandLists(lists, 1);
+        device.GetQueue().Signal(*fence, 3);
+        fence->Wait(2);
+        CHECK(fence->GetCompletedValue() == 2);
+        fence->Wait(3);
+        const double queued = MillisecondsSince(start);
+        CHECK(queued >= 2 * commands + 5.0);
+
+        printf("simulated submit: %u commands %.1f ms, two queued %.1f ms\n", commands, single, queued);
+    }
+}
+
+int main()
+{
+    TestStreamRoundTrip();
+    TestQueueSubmissions();
+    TestMisuse();
+    TestFenceWait();
+    TestSimulatedLatency();
+    return TestFailures();
+}
@@ -0,0 +1,66 @@
+#include "RenderDevice.h"
+
+void RecordBatchDraws(
+    RenderCommandList& commandList,
+    const DrawBatch* pBatches,
+    size_t batchCount,
+    const IndirectMeshBinding* pMeshes,
+    const RenderHandle* pPipelineStates,
+    const BatchRootBindings& bindings)
+{
+    uint32_t currentMaterial = UINT32_MAX;
+    uint32_t currentMesh = UINT32_MAX;
+    for (size_t i = 0; i < batchCount; i++)
+    {
+        const DrawBatch& batch = pBatches[i];
+        if (pPipelineStates[batch.materialId] == 0)
+        {
+            continue;
+        }
+        if (batch.materialId != currentMaterial)
+        {
+            commandList.SetPipelineState(pPipelineStates[batch.materialId]);
+            currentMaterial = batch.materialId;
+        }
+
+        const IndirectMeshBinding& mesh = pMeshes[batch.meshId];
+        if (batch.meshId != currentMesh)
+        {
+            commandList.SetVertexBuffer(0, mesh.vertexBufferAddress, mesh.vertexBufferSize, mesh.vertexStride);
+            commandList.SetIndexBuffer(mesh.indexBufferAddress, mesh.indexBufferSize, mesh.indexFormat);
+            currentMesh = batch.meshId;
+        }
+
+        commandList.SetGraphicsRootShaderResourceView(bindings.instanceRootParameter, bindings.instanceAddress + static_cast<uint64_t>(batch.firstInstance) * bindings.instanceStride);
+        if (bindings.pDrawRootConstants != nullptr)
+        {
+            commandList.SetGraphicsRoot32BitConstants(bindings.drawConstantsRootParameter, bindings.drawRootConstantCount, bindings.pDrawRootConstants + i * bindings.drawRootConstantCount, 0);
+        }
+        else if (bindings.drawConstantsAddress != 0)
+        {
+            commandList.SetGraphicsRootConstantBufferView(bindings.drawConstantsRootParameter, bindings.drawConstantsAddress + i * bindings.drawConstantsStride);
+        }
+        commandList.DrawIndexedInstanced(mesh.indexCount, batch.instanceCount, 0, 0, 0);
+    }
+}
+
+void RecordIndirectRuns(
+    RenderCommandList& commandList,
+    const IndirectDrawGenerator& generator,
+    const IndirectCommandLayout& layout,
+    const RenderHandle* pPipelineStates,
+    RenderHandle commandSignature,
+    RenderHandle argumentBuffer,
+    uint64_t argumentOffset)
+{
+    const uint32_t stride = layout.GetByteStride();
+    for (const IndirectDrawRun& run : generator.GetRuns())
+    {
+        commandList.SetPipelineState(pPipelineStates[run.materialId]);
+        commandList.ExecuteIndirect(
+            commandSignature,
+            run.commandCount,
+            argumentBuffer,
+            argumentOffset + static_cast<uint64_t>(run.firstCommand) * stride);
+    }
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "DrawBatcher.h"
+#include "IndirectArguments.h"
+#include "ResourceStateTracker.h"
+
+// The device, queue, fence and command list operations the renderer records
+// frames with, so the recording code also runs against RecordingDevice, which
+// needs neither Windows nor a GPU. The D3D12 implementation lives in
+// D3D12RenderDevice.h.
+//
+// Objects are referred to by opaque handles; the D3D12 implementation uses the
+// interface pointers, like TrackedResource. Values of enums and flags mirror
+// the D3D12 ones.
+typedef uint64_t RenderHandle;
+
+// D3D12_CPU_DESCRIPTOR_HANDLE::ptr.
+typedef uint64_t RenderDescriptor;
+
+// Mirrors D3D12_DESCRIPTOR_HEAP_TYPE.
+enum class RenderDescriptorType : uint32_t
+{
+    CbvSrvUav,
+    Sampler,
+    Rtv,
+    Dsv,
+    Count,
+};
+
+// Mirrors D3D12_VIEWPORT.
+struct RenderViewport
+{
+    float x;
+    float y;
+    float width;
+    float height;
+    float minDepth;
+    float maxDepth;
+};
+
+// Mirrors D3D12_RECT.
+struct RenderRect
+{
+    int32_t left;
+    int32_t top;
+    int32_t right;
+    int32_t bottom;
+};
+
+class RenderCommandList
+{
+public: virtual ~RenderCommandList() {}
+
+    // Starts recording over the previous content; only once the GPU is done with it.
+public: virtual void Reset(RenderHandle pipelineState) = 0;
+public: virtual void Close() = 0;
+
+public: virtual void ResourceBarriers(const TrackedBarrier* pBarriers, size_t count) = 0;
+
+public: virtual void SetPipelineState(RenderHandle pipelineState) = 0;
+public: virtual void SetGraphicsRootSignature(RenderHandle rootSignature) = 0;
+public: virtual void SetGraphicsRoot32BitConstants(uint32_t rootParameterIndex, uint32_t num32BitValues, const void* pData, uint32_t destOffsetIn32BitValues) = 0;
+public: virtual void SetGraphicsRootConstantBufferView(uint32_t rootParameterIndex, uint64_t address) = 0;
+public: virtual void SetGraphicsRootShaderResourceView(uint32_t rootParameterIndex, uint64_t address) = 0;
+
+public: virtual void SetViewport(const RenderViewport& viewport) = 0;
+public: virtual void SetScissorRect(const RenderRect& rect) = 0;
+public: virtual void SetRenderTarget(RenderDescriptor renderTarget, RenderDescriptor depthStencil) = 0;   // 0 for none.
+public: virtual void ClearRenderTarget(RenderDescriptor renderTarget, const float color[4]) = 0;
+public: virtual void ClearDepthStencil(RenderDescriptor depthStencil, float depth) = 0;
+
+public: virtual void SetPrimitiveTopology(uint32_t topology) = 0;
+public: virtual void SetVertexBuffer(uint32_t slot, uint64_t address, uint32_t size, uint32_t stride) = 0;
+public: virtual void SetIndexBuffer(uint64_t address, uint32_t size, uint32_t format) = 0;
+
+public: virtual void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t baseVertex, uint32_t firstInstance) = 0;
+public: virtual void ExecuteIndirect(RenderHandle commandSignature, uint32_t commandCount, RenderHandle argumentBuffer, uint64_t argumentOffset) = 0;
+};
+
+class RenderFence
+{
+public: virtual ~RenderFence() {}
+
+public: virtual uint64_t GetCompletedValue() = 0;
+
+    // Blocks until the fence reaches value.
+public: virtual void Wait(uint64_t value) = 0;
+};
+
+class RenderQueue
+{
+public: virtual ~RenderQueue() {}
+
+    // Lists run in order and must be closed.
+public: virtual void ExecuteCommandLists(RenderCommandList* const* ppCommandLists, size_t count) = 0;
+
+    // The fence reaches value once everything submitted before has run.
+public: virtual void Signal(RenderFence& fence, uint64_t value) = 0;
+};
+
+class RenderDevice
+{
+public: virtual ~RenderDevice() {}
+
+    // The direct queue.
+public: virtual RenderQueue& GetQueue() = 0;
+
+    // Created closed, with an allocator of its own.
+public: virtual std::unique_ptr<RenderCommandList> CreateCommandList() = 0;
+public: virtual std::unique_ptr<RenderFence> CreateFence(uint64_t initialValue) = 0;
+
+    // Descriptor heaps are owned by the device and live as long as it does.
+public: virtual RenderHandle CreateDescriptorHeap(RenderDescriptorType type, uint32_t count) = 0;
+public: virtual RenderDescriptor GetDescriptorHeapStart(RenderHandle heap) = 0;
+public: virtual uint32_t GetDescriptorIncrement(RenderDescriptorType type) = 0;
+public: virtual void CreateRenderTargetView(RenderHandle resource, RenderDescriptor destination) = 0;
+};
+
+// Scene recording shared by the renderer and the headless benchmark. Meshes
+// and pipeline states are indexed by the batch ids.
+
+// A DrawIndexedInstanced per batch; pipeline state and buffers are only set
+// when they change between consecutive batches. Root arguments are set per
+// batch from bindings. Batches whose material has no pipeline state (0) are
+// skipped: not compiled yet, or left out of the pass.
+void RecordBatchDraws(
+    RenderCommandList& commandList,
+    const DrawBatch* pBatches,
+    size_t batchCount,
+    const IndirectMeshBinding* pMeshes,
+    const RenderHandle* pPipelineStates,
+    const BatchRootBindings& bindings);
+
+// One ExecuteIndirect per run of the generator, reading the arguments it
+// generated from argumentBuffer at argumentOffset.
+void RecordIndirectRuns(
+    RenderCommandList& commandList,
+    const IndirectDrawGenerator& generator,
+    const IndirectCommandLayout& layout,
+    const RenderHandle* pPipelineStates,
+    RenderHandle commandSignature,
+    RenderHandle argumentBuffer,
+    uint64_t argumentOffset);
@@ -0,0 +1,420 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+
+namespace
+{
+    const uint32_t NoUse = UINT32_MAX;
+
+    inline uint64_t AlignUp(uint64_t value, uint64_t alignment)
+    {
+        return (value + (alignment - 1)) / alignment * alignment;
+    }
+}
+
+void RenderGraph::Reset()
+{
+    _resources.clear();
+    _passes.clear();
+    _accesses.clear();
+    _livePasses.clear();
+    for (std::vector<RenderGraphBarrier>& batch : _batches)
+    {
+        batch.clear();
+    }
+    _stats = {};
+}
+
+RenderGraphResource RenderGraph::ImportResource(const char* name, uint32_t initialState, uint32_t finalState)
+{
+    Resource resource = {};
+    resource.name = name;
+    resource.transient = false;
+    resource.initialState = initialState;
+    resource.finalState = finalState;
+    _resources.push_back(resource);
+    return static_cast<RenderGraphResource>(_resources.size() - 1);
+}
+
+RenderGraphResource RenderGraph::CreateTransient(const char* name, uint64_t sizeInBytes, uint64_t alignment)
+{
+    Resource resource = {};
+    resource.name = name;
+    resource.transient = true;
+    resource.size = sizeInBytes;
+    resource.alignment = alignment == 0 ? 1 : alignment;
+    _resources.push_back(resource);
+    return static_cast<RenderGraphResource>(_resources.size() - 1);
+}
+
+uint32_t RenderGraph::AddPass(const char* name, ExecuteFunction execute)
+{
+    Pass pass;
+    pass.name = name;
+    pass.execute = std::move(execute);
+    pass.sideEffects = false;
+    pass.live = false;
+    _passes.push_back(std::move(pass));
+    return static_cast<uint32_t>(_passes.size() - 1);
+}
+
+void RenderGraph::Read(uint32_t pass, RenderGraphResource resource, uint32_t state)
+{
+    _accesses.push_back({ pass, resource, state, false });
+}
+
+void RenderGraph::Write(uint32_t pass, RenderGraphResource resource, uint32_t state)
+{
+    _accesses.push_back({ pass, resource, state, true });
+}
+
+void RenderGraph::SetSideEffects(uint32_t pass)
+{
+    _passes[pass].sideEffects = true;
+}
+
+void RenderGraph::Compile()
+{
+    // Accesses are grouped per pass in execution order from here on.
+    std::stable_sort(_accesses.begin(), _accesses.end(), [](const Access& a, const Access& b)
+    {
+        return a.pass < b.pass;
+    });
+
+    CullPasses();
+    PlaceTransients();
+    BuildBarriers();
+}
+
+// A pass stays alive when it has side effects, writes an imported resource, or
+// writes something a live pass reads. Walking backwards visits consumers first.
+void RenderGraph::CullPasses()
+{
+    std::vector<bool> needed(_resources.size(), false);
+
+    size_t end = _accesses.size();
+    for (size_t p = _passes.size(); p-- > 0;)
+    {
+        size_t begin = end;
+        while (begin > 0 && _accesses[begin - 1].pass == p)
+        {
+            begin--;
+        }
+
+        Pass& pass = _passes[p];
+        pass.live = pass.sideEffects;
+        for (size_t a = begin; a < end && !pass.live; a++)
+        {
+            const Access& access = _accesses[a];
+            pass.live = access.write && (!_resources[access.resource].transient || needed[access.resource]);
+        }
+
+        if (pass.live)
+        {
+            for (size_t a = begin; a < end; a++)
+            {
+                if (!_accesses[a].write)
+                {
+                    needed[_accesses[a].resource] = true;
+                }
+            }
+        }
+
+        end = begin;
+    }
+
+    _livePasses.clear();
+    _passToLive.assign(_passes.size(), NoUse);
+    for (uint32_t p = 0; p < _passes.size(); p++)
+    {
+        if (_passes[p].live)
+        {
+            _passToLive[p] = static_cast<uint32_t>(_livePasses.size());
+            _livePasses.push_back(p);
+        }
+    }
+
+    _stats.declaredPasses = static_cast<uint32_t>(_passes.size());
+    _stats.culledPasses = static_cast<uint32_t>(_passes.size() - _livePasses.size());
+}
+
+// Greedy interval packing: biggest resources first, each at the lowest offset that
+// does not collide with an already placed resource whose lifetime overlaps.
+void RenderGraph::PlaceTransients()
+{
+    for (Resource& resource : _resources)
+    {
+        resource.firstUse = NoUse;
+        resource.lastUse = NoUse;
+    }
+
+    for (const Access& access : _accesses)
+    {
+        const uint32_t liveIndex = _passToLive[access.pass];
+        if (liveIndex == NoUse)
+        {
+            continue;
+        }
+
+        Resource& resource = _resources[access.resource];
+        if (resource.firstUse == NoUse)
+        {
+            resource.firstUse = liveIndex;
+        }
+        resource.lastUse = liveIndex;
+    }
+
+    std::vector<RenderGraphResource> transients;
+    for (RenderGraphResource r = 0; r < _resources.size(); r++)
+    {
+        if (_resources[r].transient && _resources[r].firstUse != NoUse)
+        {
+            transients.push_back(r);
+        }
+    }
+    std::stable_sort(transients.begin(), transients.end(), [this](RenderGraphResource a, RenderGraphResource b)
+    {
+        return _resources[a].size > _resources[b].size;
+    });
+
+    struct Interval
+    {
+        uint64_t begin;
+        uint64_t end;
+    };
+    std::vector<Interval> occupied;
+
+    uint64_t totalBytes = 0;
+    uint64_t heapBytes = 0;
+    for (size_t i = 0; i < transients.size(); i++)
+    {
+        Resource& resource = _resources[transients[i]];
+
+        occupied.clear();
+        for (size_t j = 0; j < i; j++)
+        {
+            const Resource& placed = _resources[transients[j]];
+            if (placed.firstUse <= resource.lastUse && resource.firstUse <= placed.lastUse)
+            {
+                occupied.push_back({ placed.heapOffset, placed.heapOffset + placed.size });
+            }
+        }
+        std::sort(occupied.begin(), occupied.end(), [](const Interval& a, const Interval& b)
+        {
+            return a.begin < b.begin;
+        });
+
+        uint64_t offset = 0;
+        for (const Interval& interval : occupied)
+        {
+            if (AlignUp(offset, resource.alignment) + resource.size <= interval.begin)
+            {
+                break;
+            }
+            offset = std::max(offset, interval.end);
+        }
+
+        resource.heapOffset = AlignUp(offset, resource.alignment);
+        totalBytes += resource.size;
+        heapBytes = std::max(heapBytes, resource.heapOffset + resource.size);
+    }
+
+    _stats.transientBytes = totalBytes;
+    _stats.transientHeapBytes = heapBytes;
+}
+
+void RenderGraph::AddBarrier(uint32_t batch, const RenderGraphBarrier& barrier)
+{
+    _batches[batch].push_back(barrier);
+    _stats.barriers++;
+}
+
+void RenderGraph::BuildBarriers()
+{
+    const uint32_t batchCount = static_cast<uint32_t>(_livePasses.size() + 1);
+    if (_batches.size() < batchCount)
+    {
+        _batches.resize(batchCount);
+    }
+    for (std::vector<RenderGraphBarrier>& batch : _batches)
+    {
+        batch.clear();
+    }
+
+    // Live accesses in execution order, tagged with the index of their live pass.
+    struct LiveAccess
+    {
+        uint32_t liveIndex;
+        RenderGraphResource resource;
+        uint32_t state;
+        bool write;
+    };
+    std::vector<LiveAccess> liveAccesses;
+    for (const Access& access : _accesses)
+    {
+        if (_passToLive[access.pass] != NoUse)
+        {
+            liveAccesses.push_back({ _passToLive[access.pass], access.resource, access.state, access.write });
+        }
+    }
+
+    std::vector<uint32_t> currentState(_resources.size());
+    std::vector<uint32_t> lastUse(_resources.size(), NoUse);
+    for (RenderGraphResource r = 0; r < _resources.size(); r++)
+    {
+        currentState[r] = _resources[r].initialState;
+    }
+
+    for (size_t a = 0; a < liveAccesses.size(); a++)
+    {
+        const LiveAccess& access = liveAccesses[a];
+        const RenderGraphResource r = access.resource;
+        Resource& resource = _resources[r];
+
+        if (lastUse[r] == access.liveIndex)
+        {
+            // Already handled with the first access of this pass.
+            continue;
+        }
+
+        // Several accesses of the same pass collapse into one state.
+        uint32_t state = access.state;
+        bool write = access.write;
+        size_t next = a + 1;
+        for (; next < liveAccesses.size() && liveAccesses[next].liveIndex == access.liveIndex; next++)
+        {
+            if (liveAccesses[next].resource == r)
+            {
+                state |= liveAccesses[next].state;
+                write = write || liveAccesses[next].write;
+            }
+        }
+
+        if (!write)
+        {
+            // Merge the states of the following readers up to the next writer so a
+            // run of readers needs a single transition.
+            for (size_t b = next; b < liveAccesses.size(); b++)
+            {
+                if (liveAccesses[b].resource != r)
+                {
+                    continue;
+                }
+                if (liveAccesses[b].write)
+                {
+                    break;
+                }
+                state |= liveAccesses[b].state;
+            }
+        }
+
+        if (resource.transient && lastUse[r] == NoUse)
+        {
+            // First use of a transient: it is created in the state it is first
+            // needed in, but it may inherit memory from another transient.
+            bool aliased = false;
+            for (RenderGraphResource other = 0; other < _resources.size() && !aliased; other++)
+            {
+                const Resource& o = _resources[other];
+                aliased = other != r && o.transient && o.firstUse != NoUse && o.firstUse < resource.firstUse &&
+                    o.heapOffset < resource.heapOffset + resource.size && resource.heapOffset < o.heapOffset + o.size;
+            }
+            if (aliased)
+            {
+                RenderGraphBarrier barrier = {};
+                barrier.type = RenderGraphBarrierType::Aliasing;
+                barrier.flags = RenderGraphBarrierFlags::None;
+                barrier.resource = r;
+                barrier.resourceBefore = InvalidRenderGraphResource;
+                AddBarrier(access.liveIndex, barrier);
+                _stats.aliasingBarriers++;
+            }
+
+            resource.initialState = state;
+            currentState[r] = state;
+            lastUse[r] = access.liveIndex;
+            continue;
+        }
+
+        const uint32_t current = currentState[r];
+        const bool satisfied = current == state || (!write && state != 0 && (current & state) == state);
+        if (!satisfied)
+        {
+            RenderGraphBarrier barrier = {};
+            barrier.type = RenderGraphBarrierType::Transition;
+            barrier.resource = r;
+            barrier.resourceBefore = InvalidRenderGraphResource;
+            barrier.stateBefore = current;
+            barrier.stateAfter = state;
+
+            if (lastUse[r] != NoUse && access.liveIndex - lastUse[r] >= 2)
+            {
+                // Passes in between do not touch the resource: start the transition
+                // right after its last use and finish it just before this pass.
+                barrier.flags = RenderGraphBarrierFlags::BeginOnly;
+                AddBarrier(lastUse[r] + 1, barrier);
+                barrier.flags = RenderGraphBarrierFlags::EndOnly;
+                AddBarrier(access.liveIndex, barrier);
+                _stats.splitBarriers++;
+            }
+            else
+            {
+                barrier.flags = RenderGraphBarrierFlags::None;
+                AddBarrier(access.liveIndex, barrier);
+            }
+            currentState[r] = state;
+        }
+        lastUse[r] = access.liveIndex;
+    }
+
+    // Imported resources leave in their final state; transients return to their
+    // creation state so the next frame finds them where it expects them.
+    const uint32_t finalBatch = batchCount - 1;
+    for (RenderGraphResource r = 0; r < _resources.size(); r++)
+    {
+        const Resource& resource = _resources[r];
+        const uint32_t target = resource.transient ? resource.initialState : resource.finalState;
+        if (lastUse[r] != NoUse && currentState[r] != target)
+        {
+            RenderGraphBarrier barrier = {};
+            barrier.type = RenderGraphBarrierType::Transition;
+            barrier.flags = RenderGraphBarrierFlags::None;
+            barrier.resource = r;
+            barrier.resourceBefore = InvalidRenderGraphResource;
+            barrier.stateBefore = currentState[r];
+            barrier.stateAfter = target;
+            AddBarrier(finalBatch, barrier);
+        }
+    }
+
+    for (uint32_t b = 0; b < batchCount; b++)
+    {
+        if (!_batches[b].empty())
+        {
+            _stats.barrierBatches++;
+        }
+    }
+}
+
+void RenderGraph::Execute(const BarrierFunction& submitBarriers) const
+{
+    for (size_t i = 0; i < _livePasses.size(); i++)
+    {
+        if (!_batches[i].empty())
+        {
+            submitBarriers(_batches[i].data(), static_cast<uint32_t>(_batches[i].size()));
+        }
+
+        const Pass& pass = _passes[_livePasses[i]];
+        if (pass.execute)
+        {
+            pass.execute();
+        }
+    }
+
+    const std::vector<RenderGraphBarrier>& finalBatch = _batches[_livePasses.size()];
+    if (!finalBatch.empty())
+    {
+        submitBarriers(finalBatch.data(), static_cast<uint32_t>(finalBatch.size()));
+    }
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+typedef uint32_t RenderGraphResource;
+
+static const RenderGraphResource InvalidRenderGraphResource = UINT32_MAX;
+
+enum class RenderGraphBarrierType : uint32_t
+{
+    Transition,
+    Aliasing,
+};
+
+// Mirrors D3D12_RESOURCE_BARRIER_FLAGS.
+enum class RenderGraphBarrierFlags : uint32_t
+{
+    None = 0,
+    BeginOnly = 1,
+    EndOnly = 2,
+};
+
+// Resource states are opaque bit masks to the graph. The D3D12 renderer passes
+// D3D12_RESOURCE_STATES values straight through; read states are combined with OR.
+struct RenderGraphBarrier
+{
+    RenderGraphBarrierType type;
+    RenderGraphBarrierFlags flags;
+    RenderGraphResource resource;       // Transition resource, or resource after for aliasing.
+    RenderGraphResource resourceBefore; // Aliasing only; InvalidRenderGraphResource means any.
+    uint32_t stateBefore;
+    uint32_t stateAfter;
+};
+
+struct RenderGraphStats
+{
+    uint32_t declaredPasses;
+    uint32_t culledPasses;
+    uint32_t barriers;
+    uint32_t barrierBatches;
+    uint32_t splitBarriers;
+    uint32_t aliasingBarriers;
+    uint64_t transientBytes;        // Sum of all live transient resources.
+    uint64_t transientHeapBytes;    // Size of the heap they are aliased into.
+};
+
+// Frame graph of render passes. Passes declare the resources they read and write
+// in the state they need them; Compile() then
+//  - culls passes whose results are never consumed,
+//  - batches all barriers needed before a pass into a single ResourceBarrier call,
+//  - splits transitions across idle passes into begin/end pairs,
+//  - places transient resources with disjoint lifetimes at overlapping heap offsets.
+// Passes must be added in execution order. The graph is rebuilt every frame; Reset()
+// keeps the allocations around. A transient that follows an aliasing barrier holds
+// garbage, so its first pass has to clear, discard or fully overwrite it.
+class RenderGraph
+{
+public: typedef std::function<void()> ExecuteFunction;
+public: typedef std::function<void(const RenderGraphBarrier* pBarriers, uint32_t count)> BarrierFunction;
+
+public: void Reset();
+
+    // Resources owned outside the graph (e.g. the back buffer). They are left in finalState.
+public: RenderGraphResource ImportResource(const char* name, uint32_t initialState, uint32_t finalState);
+
+    // Resources that only live during the frame and can share memory with each other.
+public: RenderGraphResource CreateTransient(const char* name, uint64_t sizeInBytes, uint64_t alignment);
+
+public: uint32_t AddPass(const char* name, ExecuteFunction execute);
+public: void Read(uint32_t pass, RenderGraphResource resource, uint32_t state);
+public: void Write(uint32_t pass, RenderGraphResource resource, uint32_t state);
+
+    // Passes with side effects outside the graph (readbacks, present) are never culled.
+public: void SetSideEffects(uint32_t pass);
+
+public: void Compile();
+public: void Execute(const BarrierFunction& submitBarriers) const;
+
+public: bool IsPassCulled(uint32_t pass) const { return !_passes[pass].live; }
+public: bool IsTransient(RenderGraphResource resource) const { return _resources[resource].transient; }
+public: uint32_t GetInitialState(RenderGraphResource resource) const { return _resources[resource].initialState; }
+public: uint64_t GetTransientOffset(RenderGraphResource resource) const { return _resources[resource].heapOffset; }
+public: uint64_t GetTransientSize(RenderGraphResource resource) const { return _resources[resource].size; }
+public: uint64_t GetTransientHeapSize() const { return _stats.transientHeapBytes; }
+public: uint32_t GetResourceCount() const { return static_cast<uint32_t>(_resources.size()); }
+public: const char* GetResourceName(RenderGraphResource resource) const { return _resources[resource].name.c_str(); }
+public: const char* GetPassName(uint32_t pass) const { return _passes[pass].name.c_str(); }
+public: const RenderGraphStats& GetStats() const { return _stats; }
+
+private: struct Resource
+    {
+        std::string name;
+        bool transient;
+        uint32_t initialState;
+        uint32_t finalState;
+        uint64_t size;
+        uint64_t alignment;
+        uint64_t heapOffset;
+        uint32_t firstUse;  // Index into _livePasses.
+        uint32_t lastUse;
+    };
+
+private: struct Access
+    {
+        uint32_t pass;
+        RenderGraphResource resource;
+        uint32_t state;
+        bool write;
+    };
+
+private: struct Pass
+    {
+        std::string name;
+        ExecuteFunction execute;
+        bool sideEffects;
+        bool live;
+    };
+
+private: void CullPasses();
+private: void PlaceTransients();
+private: void BuildBarriers();
+private: void AddBarrier(uint32_t batch, const RenderGraphBarrier& barrier);
+
+private: std::vector<Resource> _resources;
+private: std::vector<Pass> _passes;
+private: std::vector<Access> _accesses;
+
+    // Compiled data. Batch i is submitted before live pass i, the last batch after all passes.
+private: std::vector<uint32_t> _livePasses;
+private: std::vector<uint32_t> _passToLive;
+private: std::vector<std::vector<RenderGraphBarrier>> _batches;
+private: RenderGraphStats _stats = {};
+};
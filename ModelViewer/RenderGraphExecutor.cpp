@@ -0,0 +1,141 @@
+#include "stdafx.h"
+#include "RenderGraphExecutor.h"
+#include "D3D12MemoryTracking.h"
+
+void RenderGraphExecutor::Reset()
+{
+    _resources.clear();
+    for (Transient& transient : _transients)
+    {
+        transient.declared = false;
+    }
+}
+
+void RenderGraphExecutor::BindResource(RenderGraphResource resource, ID3D12Resource* pResource)
+{
+    if (_resources.size() <= resource)
+    {
+        _resources.resize(resource + 1, nullptr);
+    }
+    _resources[resource] = pResource;
+}
+
+RenderGraphResource RenderGraphExecutor::CreateTransient(ID3D12Device* pDevice, RenderGraph& graph, const char* name, const D3D12_RESOURCE_DESC& desc)
+{
+    const D3D12_RESOURCE_ALLOCATION_INFO info = pDevice->GetResourceAllocationInfo(0, 1, &desc);
+    const RenderGraphResource resource = graph.CreateTransient(name, info.SizeInBytes, info.Alignment);
+
+    if (_transients.size() <= resource)
+    {
+        _transients.resize(resource + 1);
+    }
+
+    Transient& transient = _transients[resource];
+    if (transient.resource && memcmp(&transient.desc, &desc, sizeof(desc)) != 0)
+    {
+        transient.resource.Reset();
+    }
+    transient.desc = desc;
+    transient.declared = true;
+
+    return resource;
+}
+
+void RenderGraphExecutor::AllocateTransients(ID3D12Device* pDevice, const RenderGraph& graph, ResourceStateRegistry& registry)
+{
+    const UINT64 heapSize = graph.GetTransientHeapSize();
+    if (heapSize > _transientHeapSize)
+    {
+        for (Transient& transient : _transients)
+        {
+            if (transient.resource)
+            {
+                registry.Unregister(ToTrackedResource(transient.resource.Get()));
+                transient.resource.Reset();
+            }
+        }
+
+        // Transients are render targets and depth buffers; this keeps the heap
+        // usable on resource heap tier 1 hardware.
+        CD3DX12_HEAP_DESC heapDesc(heapSize, D3D12_HEAP_TYPE_DEFAULT, 0, D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES);
+        ThrowIfFailed(pDevice->CreateHeap(&heapDesc, IID_PPV_ARGS(&_transientHeap)));
+        NAME_D3D12_OBJECT(_transientHeap);
+        TrackD3D12Heap(_transientHeap.Get(), MemoryCategory::RenderTarget, "RenderGraphTransients");
+        _transientHeapSize = heapSize;
+    }
+
+    for (RenderGraphResource r = 0; r < _transients.size(); r++)
+    {
+        Transient& transient = _transients[r];
+        if (!transient.declared || !graph.IsTransient(r))
+        {
+            continue;
+        }
+
+        const UINT64 offset = graph.GetTransientOffset(r);
+        if (!transient.resource || transient.heapOffset != offset)
+        {
+            if (transient.resource)
+            {
+                registry.Unregister(ToTrackedResource(transient.resource.Get()));
+                transient.resource.Reset();
+            }
+
+            const D3D12_RESOURCE_STATES initialState = static_cast<D3D12_RESOURCE_STATES>(graph.GetInitialState(r));
+            ThrowIfFailed(pDevice->CreatePlacedResource(
+                _transientHeap.Get(),
+                offset,
+                &transient.desc,
+                initialState,
+                nullptr,
+                IID_PPV_ARGS(&transient.resource)));
+            transient.heapOffset = offset;
+
+            RegisterTrackedResource(registry, pDevice, transient.resource.Get(), initialState);
+        }
+
+        BindResource(r, transient.resource.Get());
+    }
+}
+
+void RenderGraphExecutor::Execute(const RenderGraph& graph, ID3D12GraphicsCommandList* pCommandList, ResourceStateTracker& tracker)
+{
+    graph.Execute([this, pCommandList, &tracker](const RenderGraphBarrier* pBarriers, uint32_t count)
+    {
+        // One ResourceBarrier call per batch: aliasing barriers first, as the
+        // graph placed them, then the transitions the tracker kept (it drops
+        // the ones that are no-ops).
+        _barriers.clear();
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const RenderGraphBarrier& barrier = pBarriers[i];
+            if (barrier.type == RenderGraphBarrierType::Aliasing)
+            {
+                ID3D12Resource* pBefore = barrier.resourceBefore != InvalidRenderGraphResource ? _resources[barrier.resourceBefore] : nullptr;
+                _barriers.push_back(CD3DX12_RESOURCE_BARRIER::Aliasing(pBefore, _resources[barrier.resource]));
+                continue;
+            }
+
+            const TrackedResource resource = ToTrackedResource(_resources[barrier.resource]);
+            switch (barrier.flags)
+            {
+            case RenderGraphBarrierFlags::BeginOnly:
+                tracker.BeginTransition(resource, barrier.stateAfter);
+                break;
+            case RenderGraphBarrierFlags::EndOnly:
+                tracker.EndTransition(resource, barrier.stateAfter);
+                break;
+            default:
+                tracker.Transition(resource, barrier.stateAfter);
+                break;
+            }
+        }
+
+        AppendTrackedBarriers(tracker.GetBarriers(), &_barriers);
+        tracker.ClearBarriers();
+        if (!_barriers.empty())
+        {
+            pCommandList->ResourceBarrier(static_cast<UINT>(_barriers.size()), _barriers.data());
+        }
+    });
+}
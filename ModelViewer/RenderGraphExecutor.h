@@ -0,0 +1,42 @@
+#pragma once
+
+#include "RenderGraph.h"
+#include "D3D12ResourceStates.h"
+
+using Microsoft::WRL::ComPtr;
+
+// D3D12 side of RenderGraph: binds graph handles to ID3D12Resource objects,
+// backs transient resources with placed resources in one shared heap and turns
+// the compiled barrier batches into ResourceBarrier calls. Transitions go through
+// the command list's ResourceStateTracker, so the graph's idea of where an
+// imported resource starts is checked against the global state at submit.
+class RenderGraphExecutor
+{
+    // Call together with RenderGraph::Reset() at the start of a frame.
+public: void Reset();
+
+public: void BindResource(RenderGraphResource resource, ID3D12Resource* pResource);
+
+    // Declares a transient on the graph with the size the device needs for desc.
+public: RenderGraphResource CreateTransient(ID3D12Device* pDevice, RenderGraph& graph, const char* name, const D3D12_RESOURCE_DESC& desc);
+
+    // Call after RenderGraph::Compile(). Growing the heap recreates every transient,
+    // so the GPU must not be using the previous ones anymore.
+public: void AllocateTransients(ID3D12Device* pDevice, const RenderGraph& graph, ResourceStateRegistry& registry);
+
+public: void Execute(const RenderGraph& graph, ID3D12GraphicsCommandList* pCommandList, ResourceStateTracker& tracker);
+
+private: struct Transient
+    {
+        ComPtr<ID3D12Resource> resource;
+        D3D12_RESOURCE_DESC desc;
+        UINT64 heapOffset;
+        bool declared;
+    };
+
+private: std::vector<ID3D12Resource*> _resources;
+private: std::vector<Transient> _transients;
+private: std::vector<D3D12_RESOURCE_BARRIER> _barriers;
+private: ComPtr<ID3D12Heap> _transientHeap;
+private: UINT64 _transientHeapSize = 0;
+};
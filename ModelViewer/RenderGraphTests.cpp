@@ -0,0 +1,283 @@
+#include "RenderGraph.h"
+#include "UnitTest.h"
+
+#include <string>
+#include <vector>
+
+namespace
+{
+    // D3D12_RESOURCE_STATES values, which the graph passes through untouched.
+    const uint32_t StateCommon = 0x0;
+    const uint32_t StateRenderTarget = 0x4;
+    const uint32_t StateUnorderedAccess = 0x8;
+    const uint32_t StatePixelShaderResource = 0x80;
+
+    const uint64_t MiB = 1024 * 1024;
+
+    // What Execute() hands out: one entry per ResourceBarrier() call.
+    struct RecordedGraph
+    {
+        std::vector<std::string> executed;
+        std::vector<std::vector<RenderGraphBarrier>> batches;
+    };
+
+    RenderGraph::ExecuteFunction RecordPass(RecordedGraph* pRecorded, const char* name)
+    {
+        return [pRecorded, name]() { pRecorded->executed.push_back(name); };
+    }
+
+    void ExecuteGraph(const RenderGraph& graph, RecordedGraph* pRecorded)
+    {
+        graph.Execute([pRecorded](const RenderGraphBarrier* pBarriers, uint32_t count)
+        {
+            pRecorded->executed.push_back("barriers");
+            pRecorded->batches.push_back(std::vector<RenderGraphBarrier>(pBarriers, pBarriers + count));
+        });
+    }
+
+    // A pass whose output nobody reads goes, with the barriers it would need;
+    // passes with side effects stay even when they write nothing.
+    void TestCulling()
+    {
+        RenderGraph graph;
+        RecordedGraph recorded;
+        const RenderGraphResource backBuffer = graph.ImportResource("BackBuffer", StateCommon, StateCommon);
+        const RenderGraphResource scene = graph.CreateTransient("Scene", 8 * MiB, 65536);
+        const RenderGraphResource unused = graph.CreateTransient("Unused", 1 * MiB, 65536);
+
+        const uint32_t scenePass = graph.AddPass("Scene", RecordPass(&recorded, "Scene"));
+        graph.Write(scenePass, scene, StateRenderTarget);
+        const uint32_t deadPass = graph.AddPass("Dead", RecordPass(&recorded, "Dead"));
+        graph.Read(deadPass, scene, StatePixelShaderResource);
+        graph.Write(deadPass, unused, StateRenderTarget);
+        const uint32_t readbackPass = graph.AddPass("Readback", RecordPass(&recorded, "Readback"));
+        graph.SetSideEffects(readbackPass);
+        const uint32_t compositePass = graph.AddPass("Composite", RecordPass(&recorded, "Composite"));
+        graph.Read(compositePass, scene, StatePixelShaderResource);
+        graph.Write(compositePass, backBuffer, StateRenderTarget);
+        graph.Compile();
+        ExecuteGraph(graph, &recorded);
+
+        CHECK(!graph.IsPassCulled(scenePass));
+        CHECK(graph.IsPassCulled(deadPass));
+        CHECK(!graph.IsPassCulled(readbackPass));
+        CHECK(!graph.IsPassCulled(compositePass));
+        CHECK(graph.GetStats().declaredPasses == 4);
+        CHECK(graph.GetStats().culledPasses == 1);
+
+        for (const std::string& name : recorded.executed)
+        {
+            CHECK(name != "Dead");
+        }
+        for (const std::vector<RenderGraphBarrier>& batch : recorded.batches)
+        {
+            for (const RenderGraphBarrier& barrier : batch)
+            {
+                CHECK(barrier.resource != unused);
+            }
+        }
+
+        // Only the culled pass's output is left out of the transient heap.
+        CHECK(graph.GetStats().transientBytes == 8 * MiB);
+    }
+
+    // Each pass gets at most one ResourceBarrier() call, and everything
+    // imported is back in its final state after the last pass.
+    void TestBarrierBatches()
+    {
+        RenderGraph graph;
+        RecordedGraph recorded;
+        const RenderGraphResource backBuffer = graph.ImportResource("BackBuffer", StateCommon, StateCommon);
+        const RenderGraphResource gbuffer = graph.CreateTransient("GBuffer", 8 * MiB, 65536);
+        const RenderGraphResource occlusion = graph.CreateTransient("Occlusion", 4 * MiB, 65536);
+        const RenderGraphResource blurred = graph.CreateTransient("Blurred", 4 * MiB, 65536);
+
+        const uint32_t gbufferPass = graph.AddPass("GBuffer", RecordPass(&recorded, "GBuffer"));
+        graph.Write(gbufferPass, gbuffer, StateRenderTarget);
+        const uint32_t occlusionPass = graph.AddPass("Occlusion", RecordPass(&recorded, "Occlusion"));
+        graph.Read(occlusionPass, gbuffer, StatePixelShaderResource);
+        graph.Write(occlusionPass, occlusion, StateUnorderedAccess);
+        const uint32_t blurPass = graph.AddPass("Blur", RecordPass(&recorded, "Blur"));
+        graph.Read(blurPass, occlusion, StatePixelShaderResource);
+        graph.Write(blurPass, blurred, StateUnorderedAccess);
+        const uint32_t lightingPass = graph.AddPass("Lighting", RecordPass(&recorded, "Lighting"));
+        graph.Read(lightingPass, gbuffer, StatePixelShaderResource);
+        graph.Read(lightingPass, blurred, StatePixelShaderResource);
+        graph.Write(lightingPass, backBuffer, StateRenderTarget);
+        graph.Compile();
+        ExecuteGraph(graph, &recorded);
+
+        const std::vector<std::string> expected =
+        {
+            "GBuffer", "barriers", "Occlusion", "barriers", "Blur", "barriers", "Lighting", "barriers",
+        };
+        CHECK(recorded.executed == expected);
+
+        const RenderGraphStats& stats = graph.GetStats();
+        CHECK(stats.barrierBatches == 4);
+        CHECK(stats.barrierBatches == recorded.batches.size());
+        CHECK(stats.barriers == 8);
+        CHECK(stats.splitBarriers == 0);
+        CHECK(stats.aliasingBarriers == 0);
+
+        // Transients start in the state of their first use, so the first
+        // pass needs no barrier.
+        CHECK(graph.GetInitialState(gbuffer) == StateRenderTarget);
+
+        bool backBufferRestored = false;
+        for (const RenderGraphBarrier& barrier : recorded.batches.back())
+        {
+            if (barrier.resource == backBuffer)
+            {
+                backBufferRestored = barrier.stateBefore == StateRenderTarget && barrier.stateAfter == StateCommon;
+            }
+        }
+        CHECK(backBufferRestored);
+
+        // Every transient lives until Lighting or overlaps one that does.
+        CHECK(stats.transientBytes == 16 * MiB);
+        CHECK(stats.transientHeapBytes == 16 * MiB);
+    }
+
+    // A -> B -> C -> D, each transient read by the next pass only, and
+    // History written in A but not read until D.
+    struct ChainGraph
+    {
+        RenderGraph graph;
+        RecordedGraph recorded;
+        RenderGraphResource history;
+        RenderGraphResource first;
+        RenderGraphResource second;
+        RenderGraphResource third;
+    };
+
+    void BuildChainGraph(ChainGraph* pChain)
+    {
+        RenderGraph& graph = pChain->graph;
+        const RenderGraphResource backBuffer = graph.ImportResource("BackBuffer", StateCommon, StateCommon);
+        pChain->history = graph.ImportResource("History", StatePixelShaderResource, StatePixelShaderResource);
+        pChain->first = graph.CreateTransient("First", 4 * MiB, 65536);
+        pChain->second = graph.CreateTransient("Second", 4 * MiB, 65536);
+        pChain->third = graph.CreateTransient("Third", 4 * MiB, 65536);
+
+        const uint32_t a = graph.AddPass("A", nullptr);
+        graph.Write(a, pChain->first, StateRenderTarget);
+        graph.Write(a, pChain->history, StateRenderTarget);
+        const uint32_t b = graph.AddPass("B", nullptr);
+        graph.Read(b, pChain->first, StatePixelShaderResource);
+        graph.Write(b, pChain->second, StateUnorderedAccess);
+        const uint32_t c = graph.AddPass("C", nullptr);
+        graph.Read(c, pChain->second, StatePixelShaderResource);
+        graph.Write(c, pChain->third, StateUnorderedAccess);
+        const uint32_t d = graph.AddPass("D", nullptr);
+        graph.Read(d, pChain->third, StatePixelShaderResource);
+        graph.Read(d, pChain->history, StatePixelShaderResource);
+        graph.Write(d, backBuffer, StateRenderTarget);
+        graph.Compile();
+        ExecuteGraph(graph, &pChain->recorded);
+    }
+
+    // First and Third never live at the same time, so they share memory, and
+    // Third gets an aliasing barrier before its first use in C.
+    void TestAliasing()
+    {
+        ChainGraph chain;
+        BuildChainGraph(&chain);
+        const RenderGraph& graph = chain.graph;
+
+        CHECK(graph.GetTransientOffset(chain.first) == graph.GetTransientOffset(chain.third));
+        CHECK(graph.GetTransientOffset(chain.second) != graph.GetTransientOffset(chain.first));
+        CHECK(graph.GetStats().transientBytes == 12 * MiB);
+        CHECK(graph.GetStats().transientHeapBytes == 8 * MiB);
+        CHECK(graph.GetTransientHeapSize() == 8 * MiB);
+        CHECK(graph.GetStats().aliasingBarriers == 1);
+
+        // A batch before each pass and one after the last.
+        CHECK(chain.recorded.batches.size() == 5);
+        uint32_t aliasingBarriers = 0;
+        for (size_t batch = 0; batch < chain.recorded.batches.size(); batch++)
+        {
+            for (const RenderGraphBarrier& barrier : chain.recorded.batches[batch])
+            {
+                if (barrier.type == RenderGraphBarrierType::Aliasing)
+                {
+                    aliasingBarriers++;
+                    CHECK(barrier.resource == chain.third);
+                    CHECK(batch == 2);
+                }
+            }
+        }
+        CHECK(aliasingBarriers == 1);
+    }
+
+    // History is idle through B and C, so its transition begins right after A
+    // and ends right before D.
+    void TestSplitBarriers()
+    {
+        ChainGraph chain;
+        BuildChainGraph(&chain);
+        const RenderGraphStats& stats = chain.graph.GetStats();
+
+        CHECK(stats.splitBarriers == 1);
+        CHECK(stats.barriers == 12);
+        CHECK(stats.barrierBatches == 5);
+
+        int beginBatch = -1;
+        int endBatch = -1;
+        for (size_t batch = 0; batch < chain.recorded.batches.size(); batch++)
+        {
+            for (const RenderGraphBarrier& barrier : chain.recorded.batches[batch])
+            {
+                if (barrier.resource != chain.history || barrier.type != RenderGraphBarrierType::Transition)
+                {
+                    continue;
+                }
+                if (barrier.flags == RenderGraphBarrierFlags::BeginOnly)
+                {
+                    beginBatch = static_cast<int>(batch);
+                    CHECK(barrier.stateBefore == StateRenderTarget);
+                    CHECK(barrier.stateAfter == StatePixelShaderResource);
+                }
+                else if (barrier.flags == RenderGraphBarrierFlags::EndOnly)
+                {
+                    endBatch = static_cast<int>(batch);
+                    CHECK(barrier.stateBefore == StateRenderTarget);
+                    CHECK(barrier.stateAfter == StatePixelShaderResource);
+                }
+            }
+        }
+        CHECK(beginBatch == 1);
+        CHECK(endBatch == 3);
+    }
+
+    // Reset() and a rebuild of the same frame compile to the same result.
+    void TestReset()
+    {
+        ChainGraph chain;
+        BuildChainGraph(&chain);
+        const RenderGraphStats first = chain.graph.GetStats();
+
+        chain.graph.Reset();
+        chain.recorded = RecordedGraph();
+        BuildChainGraph(&chain);
+        const RenderGraphStats& second = chain.graph.GetStats();
+
+        CHECK(second.declaredPasses == first.declaredPasses);
+        CHECK(second.barriers == first.barriers);
+        CHECK(second.barrierBatches == first.barrierBatches);
+        CHECK(second.splitBarriers == first.splitBarriers);
+        CHECK(second.aliasingBarriers == first.aliasingBarriers);
+        CHECK(second.transientHeapBytes == first.transientHeapBytes);
+        CHECK(chain.graph.GetResourceCount() == 5);
+    }
+}
+
+int main()
+{
+    TestCulling();
+    TestBarrierBatches();
+    TestAliasing();
+    TestSplitBarriers();
+    TestReset();
+    return TestFailures();
+}
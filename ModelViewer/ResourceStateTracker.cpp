@@ -0,0 +1,312 @@
+#include "ResourceStateTracker.h"
+
+#include <stdexcept>
+
+const uint32_t ResourceStateTracker::UnknownState;
+
+void ResourceStateRegistry::Register(TrackedResource resource, uint32_t subresourceCount, uint32_t initialState)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _entries[resource].states.assign(subresourceCount == 0 ? 1 : subresourceCount, initialState);
+}
+
+void ResourceStateRegistry::Unregister(TrackedResource resource)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _entries.erase(resource);
+}
+
+uint32_t ResourceStateRegistry::GetSubresourceCount(TrackedResource resource) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _entries.find(resource);
+    if (it == _entries.end())
+    {
+        throw std::logic_error("Resource is not registered for state tracking.");
+    }
+    return static_cast<uint32_t>(it->second.states.size());
+}
+
+uint32_t ResourceStateRegistry::GetState(TrackedResource resource, uint32_t subresource) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _entries.find(resource);
+    if (it == _entries.end())
+    {
+        throw std::logic_error("Resource is not registered for state tracking.");
+    }
+    return it->second.states[subresource == AllSubresources ? 0 : subresource];
+}
+
+void ResourceStateRegistry::Resolve(ResourceStateTracker& tracker, std::vector<TrackedBarrier>& fixups)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    const size_t firstFixup = fixups.size();
+
+    for (const ResourceStateTracker::PendingTransition& pending : tracker._pending)
+    {
+        auto it = _entries.find(pending.resource);
+        if (it == _entries.end())
+        {
+            throw std::logic_error("Resource is not registered for state tracking.");
+        }
+
+        const std::vector<uint32_t>& states = it->second.states;
+        const uint32_t count = static_cast<uint32_t>(states.size());
+
+        if (pending.subresource == AllSubresources)
+        {
+            bool uniform = true;
+            for (uint32_t s = 1; s < count && uniform; s++)
+            {
+                uniform = states[s] == states[0];
+            }
+
+            if (uniform)
+            {
+                if (states[0] != pending.stateAfter)
+                {
+                    fixups.push_back({ pending.resource, AllSubresources, states[0], pending.stateAfter, TrackedBarrierFlags::None });
+                }
+                continue;
+            }
+
+            for (uint32_t s = 0; s < count; s++)
+            {
+                if (states[s] != pending.stateAfter)
+                {
+                    fixups.push_back({ pending.resource, s, states[s], pending.stateAfter, TrackedBarrierFlags::None });
+                }
+            }
+        }
+        else if (states[pending.subresource] != pending.stateAfter)
+        {
+            fixups.push_back({ pending.resource, pending.subresource, states[pending.subresource], pending.stateAfter, TrackedBarrierFlags::None });
+        }
+    }
+
+    // Per-subresource fixups that ended up covering a whole resource with the
+    // same transition collapse into a single barrier.
+    for (size_t i = firstFixup; i < fixups.size(); i++)
+    {
+        const TrackedBarrier& barrier = fixups[i];
+        if (barrier.subresource == AllSubresources)
+        {
+            continue;
+        }
+
+        const size_t count = _entries[barrier.resource].states.size();
+        size_t matching = 0;
+        bool uniform = true;
+        for (size_t j = firstFixup; j < fixups.size(); j++)
+        {
+            if (fixups[j].resource == barrier.resource)
+            {
+                matching++;
+                uniform = uniform && fixups[j].stateBefore == barrier.stateBefore && fixups[j].stateAfter == barrier.stateAfter;
+            }
+        }
+
+        if (uniform && matching == count)
+        {
+            const TrackedBarrier merged = { barrier.resource, AllSubresources, barrier.stateBefore, barrier.stateAfter, TrackedBarrierFlags::None };
+            size_t out = firstFixup;
+            for (size_t j = firstFixup; j < fixups.size(); j++)
+            {
+                if (fixups[j].resource != merged.resource)
+                {
+                    fixups[out++] = fixups[j];
+                }
+                else if (j == i)
+                {
+                    fixups[out++] = merged;
+                }
+            }
+            fixups.resize(out);
+        }
+    }
+
+    // Record the states the command list leaves behind.
+    for (const auto& local : tracker._localStates)
+    {
+        std::vector<uint32_t>& states = _entries[local.first].states;
+        for (size_t s = 0; s < states.size() && s < local.second.states.size(); s++)
+        {
+            if (local.second.states[s] != ResourceStateTracker::UnknownState)
+            {
+                states[s] = local.second.states[s];
+            }
+        }
+    }
+
+    ResourceStateStats& stats = tracker._stats;
+    stats.emittedBarriers += static_cast<uint32_t>(fixups.size() - firstFixup);
+    stats.eliminatedBarriers = stats.requestedTransitions > stats.emittedBarriers ? stats.requestedTransitions - stats.emittedBarriers : 0;
+
+    _frameStats.requestedTransitions += stats.requestedTransitions;
+    _frameStats.emittedBarriers += stats.emittedBarriers;
+    _frameStats.eliminatedBarriers += stats.eliminatedBarriers;
+}
+
+ResourceStateTracker::ResourceStateTracker(const ResourceStateRegistry& registry) :
+    _registry(registry)
+{
+}
+
+void ResourceStateTracker::Reset()
+{
+    _localStates.clear();
+    _pending.clear();
+    _barriers.clear();
+    _stats = {};
+}
+
+ResourceStateTracker::LocalState& ResourceStateTracker::GetLocalState(TrackedResource resource)
+{
+    auto it = _localStates.find(resource);
+    if (it != _localStates.end())
+    {
+        return it->second;
+    }
+
+    const uint32_t count = _registry.GetSubresourceCount(resource);
+    LocalState& local = _localStates[resource];
+    local.states.assign(count, UnknownState);
+    local.splitFrom.assign(count, UnknownState);
+    return local;
+}
+
+void ResourceStateTracker::Transition(TrackedResource resource, uint32_t stateAfter, uint32_t subresource)
+{
+    Request(resource, stateAfter, subresource, TrackedBarrierFlags::None);
+}
+
+void ResourceStateTracker::BeginTransition(TrackedResource resource, uint32_t stateAfter, uint32_t subresource)
+{
+    Request(resource, stateAfter, subresource, TrackedBarrierFlags::BeginOnly);
+}
+
+void ResourceStateTracker::EndTransition(TrackedResource resource, uint32_t stateAfter, uint32_t subresource)
+{
+    LocalState& local = GetLocalState(resource);
+    const uint32_t count = static_cast<uint32_t>(local.states.size());
+    const uint32_t first = subresource == AllSubresources ? 0 : subresource;
+    const uint32_t last = subresource == AllSubresources ? count : subresource + 1;
+
+    // The end has to match the begin, which covered the whole resource when
+    // every subresource came from the same state.
+    bool whole = subresource == AllSubresources || count == 1;
+    for (uint32_t s = first; s < last && whole; s++)
+    {
+        whole = local.splitFrom[s] != UnknownState && local.splitFrom[s] == local.splitFrom[first] && local.states[s] == stateAfter;
+    }
+
+    if (whole)
+    {
+        Emit(resource, AllSubresources, local.splitFrom[first], stateAfter, TrackedBarrierFlags::EndOnly);
+        for (uint32_t s = first; s < last; s++)
+        {
+            local.splitFrom[s] = UnknownState;
+        }
+        return;
+    }
+
+    for (uint32_t s = first; s < last; s++)
+    {
+        if (local.splitFrom[s] != UnknownState && local.states[s] == stateAfter)
+        {
+            Emit(resource, s, local.splitFrom[s], stateAfter, TrackedBarrierFlags::EndOnly);
+            local.splitFrom[s] = UnknownState;
+        }
+    }
+}
+
+void ResourceStateTracker::Request(TrackedResource resource, uint32_t stateAfter, uint32_t subresource, TrackedBarrierFlags flags)
+{
+    _stats.requestedTransitions++;
+
+    LocalState& local = GetLocalState(resource);
+    const uint32_t count = static_cast<uint32_t>(local.states.size());
+    const bool whole = subresource == AllSubresources || count == 1;
+    const uint32_t first = subresource == AllSubresources ? 0 : subresource;
+    const uint32_t last = subresource == AllSubresources ? count : subresource + 1;
+
+    // A split transition still in flight has to end before anything else happens.
+    for (uint32_t s = first; s < last; s++)
+    {
+        if (local.splitFrom[s] != UnknownState)
+        {
+            Emit(resource, count == 1 ? AllSubresources : s, local.splitFrom[s], local.states[s], TrackedBarrierFlags::EndOnly);
+            local.splitFrom[s] = UnknownState;
+        }
+    }
+
+    uint32_t unknown = 0;
+    uint32_t changed = 0;
+    bool sameBefore = true;
+    for (uint32_t s = first; s < last; s++)
+    {
+        const uint32_t before = local.states[s];
+        if (before == UnknownState)
+        {
+            unknown++;
+        }
+        else if (before != stateAfter)
+        {
+            sameBefore = sameBefore && (changed == 0 || before == local.states[first]);
+            changed++;
+        }
+    }
+
+    const uint32_t range = last - first;
+    if (whole && unknown == range)
+    {
+        // First use of the whole resource: the registry knows where it starts.
+        _pending.push_back({ resource, AllSubresources, stateAfter });
+    }
+    else if (whole && changed == range && sameBefore)
+    {
+        Emit(resource, AllSubresources, local.states[first], stateAfter, flags);
+        if (flags == TrackedBarrierFlags::BeginOnly)
+        {
+            for (uint32_t s = first; s < last; s++)
+            {
+                local.splitFrom[s] = local.states[s];
+            }
+        }
+    }
+    else
+    {
+        for (uint32_t s = first; s < last; s++)
+        {
+            const uint32_t before = local.states[s];
+            if (before == UnknownState)
+            {
+                _pending.push_back({ resource, s, stateAfter });
+            }
+            else if (before != stateAfter)
+            {
+                Emit(resource, s, before, stateAfter, flags);
+                if (flags == TrackedBarrierFlags::BeginOnly)
+                {
+                    local.splitFrom[s] = before;
+                }
+            }
+        }
+    }
+
+    for (uint32_t s = first; s < last; s++)
+    {
+        local.states[s] = stateAfter;
+    }
+}
+
+void ResourceStateTracker::Emit(TrackedResource resource, uint32_t subresource, uint32_t before, uint32_t after, TrackedBarrierFlags flags)
+{
+    _barriers.push_back({ resource, subresource, before, after, flags });
+    if (flags != TrackedBarrierFlags::EndOnly)
+    {
+        _stats.emittedBarriers++;
+    }
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Resources are identified by an opaque key; the D3D12 renderer uses the
+// ID3D12Resource pointer. States are D3D12_RESOURCE_STATES values.
+typedef uint64_t TrackedResource;
+
+static const uint32_t AllSubresources = 0xffffffff;
+
+// Mirrors D3D12_RESOURCE_BARRIER_FLAGS.
+enum class TrackedBarrierFlags : uint32_t
+{
+    None = 0,
+    BeginOnly = 1,
+    EndOnly = 2,
+};
+
+struct TrackedBarrier
+{
+    TrackedResource resource;
+    uint32_t subresource;   // AllSubresources when every subresource moves together.
+    uint32_t stateBefore;
+    uint32_t stateAfter;
+    TrackedBarrierFlags flags;
+};
+
+struct ResourceStateStats
+{
+    uint32_t requestedTransitions;
+    uint32_t emittedBarriers;
+    uint32_t eliminatedBarriers;
+};
+
+class ResourceStateTracker;
+
+// State of every resource as of the last submitted command list. Shared by all
+// command lists; Resolve() is the only place where it changes.
+class ResourceStateRegistry
+{
+public: void Register(TrackedResource resource, uint32_t subresourceCount, uint32_t initialState);
+public: void Unregister(TrackedResource resource);
+
+public: uint32_t GetSubresourceCount(TrackedResource resource) const;
+public: uint32_t GetState(TrackedResource resource, uint32_t subresource) const;
+
+    // Call at submit time, in submission order. Produces the barriers that must
+    // run before the tracker's command list so its first uses find the states it
+    // assumed, then records the states the command list leaves behind.
+public: void Resolve(ResourceStateTracker& tracker, std::vector<TrackedBarrier>& fixups);
+
+public: const ResourceStateStats& GetFrameStats() const { return _frameStats; }
+public: void ResetFrameStats() { _frameStats = {}; }
+
+private: struct Entry
+    {
+        std::vector<uint32_t> states;
+    };
+
+private: mutable std::mutex _mutex;
+private: std::unordered_map<TrackedResource, Entry> _entries;
+private: ResourceStateStats _frameStats = {};
+};
+
+// Per command list view of resource states. Transitions are requested with the
+// state the recording code wants; the tracker knows the state it left each
+// subresource in and only emits barriers that change something. The first use
+// of a subresource in the command list cannot be resolved locally: it is kept
+// pending and resolved against the registry at submit time.
+class ResourceStateTracker
+{
+public: explicit ResourceStateTracker(const ResourceStateRegistry& registry);
+
+    // Forget every local state, call when the command list is reset.
+public: void Reset();
+
+public: void Transition(TrackedResource resource, uint32_t stateAfter, uint32_t subresource = AllSubresources);
+
+    // Split transition. When the current state is not known locally the whole
+    // transition is moved to submit time and EndTransition() has nothing to do.
+public: void BeginTransition(TrackedResource resource, uint32_t stateAfter, uint32_t subresource = AllSubresources);
+public: void EndTransition(TrackedResource resource, uint32_t stateAfter, uint32_t subresource = AllSubresources);
+
+    // Barriers ready to be recorded into the command list, in order.
+public: const std::vector<TrackedBarrier>& GetBarriers() const { return _barriers; }
+public: void ClearBarriers() { _barriers.clear(); }
+
+public: const ResourceStateStats& GetStats() const { return _stats; }
+
+private: friend class ResourceStateRegistry;
+
+private: static const uint32_t UnknownState = 0xffffffff;
+
+private: struct LocalState
+    {
+        std::vector<uint32_t> states;       // UnknownState until first use.
+        std::vector<uint32_t> splitFrom;    // Before state of a BeginOnly barrier waiting for its end.
+    };
+
+private: struct PendingTransition
+    {
+        TrackedResource resource;
+        uint32_t subresource;
+        uint32_t stateAfter;
+    };
+
+private: LocalState& GetLocalState(TrackedResource resource);
+private: void Request(TrackedResource resource, uint32_t stateAfter, uint32_t subresource, TrackedBarrierFlags flags);
+private: void Emit(TrackedResource resource, uint32_t subresource, uint32_t before, uint32_t after, TrackedBarrierFlags flags);
+
+private: const ResourceStateRegistry& _registry;
+private: std::unordered_map<TrackedResource, LocalState> _localStates;
+private: std::vector<PendingTransition> _pending;
+private: std::vector<TrackedBarrier> _barriers;
+private: ResourceStateStats _stats = {};
+};
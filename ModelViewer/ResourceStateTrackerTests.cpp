@@ -0,0 +1,216 @@
+#include "ResourceStateTracker.h"
+#include "UnitTest.h"
+
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+    // D3D12_RESOURCE_STATES values.
+    const uint32_t StateCommon = 0x0;
+    const uint32_t StateRenderTarget = 0x4;
+    const uint32_t StatePixelShaderResource = 0x80;
+    const uint32_t StateCopyDest = 0x400;
+
+    const TrackedResource Texture = 1;
+    const TrackedResource MipChain = 2;
+
+    bool IsBarrier(const TrackedBarrier& barrier, TrackedResource resource, uint32_t subresource, uint32_t before, uint32_t after, TrackedBarrierFlags flags)
+    {
+        return barrier.resource == resource
+            && barrier.subresource == subresource
+            && barrier.stateBefore == before
+            && barrier.stateAfter == after
+            && barrier.flags == flags;
+    }
+
+    // The first use resolves against the registry at submit time; repeats of
+    // the current state are dropped.
+    void TestRedundantTransitions()
+    {
+        ResourceStateRegistry registry;
+        registry.Register(Texture, 1, StateCommon);
+        ResourceStateTracker tracker(registry);
+
+        tracker.Transition(Texture, StateRenderTarget);
+        tracker.Transition(Texture, StateRenderTarget);
+        tracker.Transition(Texture, StatePixelShaderResource);
+        tracker.Transition(Texture, StatePixelShaderResource);
+
+        CHECK(tracker.GetBarriers().size() == 1);
+        CHECK(IsBarrier(tracker.GetBarriers()[0], Texture, AllSubresources, StateRenderTarget, StatePixelShaderResource, TrackedBarrierFlags::None));
+
+        std::vector<TrackedBarrier> fixups;
+        registry.Resolve(tracker, fixups);
+        CHECK(fixups.size() == 1);
+        CHECK(IsBarrier(fixups[0], Texture, AllSubresources, StateCommon, StateRenderTarget, TrackedBarrierFlags::None));
+        CHECK(registry.GetState(Texture, 0) == StatePixelShaderResource);
+
+        const ResourceStateStats& stats = tracker.GetStats();
+        CHECK(stats.requestedTransitions == 4);
+        CHECK(stats.emittedBarriers == 2);
+        CHECK(stats.eliminatedBarriers == 2);
+    }
+
+    // A first use in the state the previous command list left behind needs
+    // no barrier at all.
+    void TestFirstUseInRegisteredState()
+    {
+        ResourceStateRegistry registry;
+        registry.Register(Texture, 1, StatePixelShaderResource);
+        ResourceStateTracker tracker(registry);
+
+        tracker.Transition(Texture, StatePixelShaderResource);
+
+        std::vector<TrackedBarrier> fixups;
+        registry.Resolve(tracker, fixups);
+        CHECK(tracker.GetBarriers().empty());
+        CHECK(fixups.empty());
+        CHECK(tracker.GetStats().eliminatedBarriers == 1);
+    }
+
+    // Subresources are tracked one by one; fixups that end up moving every
+    // subresource the same way merge into one whole-resource barrier.
+    void TestSubresources()
+    {
+        ResourceStateRegistry registry;
+        registry.Register(MipChain, 4, StateCommon);
+        ResourceStateTracker tracker(registry);
+
+        for (uint32_t mip = 0; mip < 4; mip++)
+        {
+            tracker.Transition(MipChain, StateCopyDest, mip);
+        }
+        tracker.Transition(MipChain, StatePixelShaderResource, 2);
+
+        CHECK(tracker.GetBarriers().size() == 1);
+        CHECK(IsBarrier(tracker.GetBarriers()[0], MipChain, 2, StateCopyDest, StatePixelShaderResource, TrackedBarrierFlags::None));
+
+        std::vector<TrackedBarrier> fixups;
+        registry.Resolve(tracker, fixups);
+        CHECK(fixups.size() == 1);
+        CHECK(IsBarrier(fixups[0], MipChain, AllSubresources, StateCommon, StateCopyDest, TrackedBarrierFlags::None));
+
+        // The next command list starts from mixed states, so a whole-resource
+        // first use resolves per subresource.
+        CHECK(registry.GetState(MipChain, 1) == StateCopyDest);
+        CHECK(registry.GetState(MipChain, 2) == StatePixelShaderResource);
+
+        ResourceStateTracker next(registry);
+        next.Transition(MipChain, StatePixelShaderResource);
+        fixups.clear();
+        registry.Resolve(next, fixups);
+        CHECK(fixups.size() == 3);
+        for (const TrackedBarrier& fixup : fixups)
+        {
+            CHECK(fixup.subresource != 2 && fixup.subresource != AllSubresources);
+            CHECK(fixup.stateBefore == StateCopyDest);
+        }
+    }
+
+    void TestSplitTransitions()
+    {
+        ResourceStateRegistry registry;
+        registry.Register(Texture, 1, StateCommon);
+        ResourceStateTracker tracker(registry);
+
+        tracker.Transition(Texture, StateRenderTarget);
+        tracker.BeginTransition(Texture, StatePixelShaderResource);
+        tracker.EndTransition(Texture, StatePixelShaderResource);
+
+        const std::vector<TrackedBarrier>& barriers = tracker.GetBarriers();
+        CHECK(barriers.size() == 2);
+        CHECK(IsBarrier(barriers[0], Texture, AllSubresources, StateRenderTarget, StatePixelShaderResource, TrackedBarrierFlags::BeginOnly));
+        CHECK(IsBarrier(barriers[1], Texture, AllSubresources, StateRenderTarget, StatePixelShaderResource, TrackedBarrierFlags::EndOnly));
+
+        // The end half is not a barrier of its own in the stats.
+        CHECK(tracker.GetStats().emittedBarriers == 1);
+
+        // A transition while a split is in flight ends it first.
+        tracker.ClearBarriers();
+        tracker.BeginTransition(Texture, StateCopyDest);
+        tracker.Transition(Texture, StateRenderTarget);
+        CHECK(barriers.size() == 3);
+        CHECK(IsBarrier(barriers[0], Texture, AllSubresources, StatePixelShaderResource, StateCopyDest, TrackedBarrierFlags::BeginOnly));
+        CHECK(IsBarrier(barriers[1], Texture, AllSubresources, StatePixelShaderResource, StateCopyDest, TrackedBarrierFlags::EndOnly));
+        CHECK(IsBarrier(barriers[2], Texture, AllSubresources, StateCopyDest, StateRenderTarget, TrackedBarrierFlags::None));
+    }
+
+    // Without a local state there is nothing to split: the whole transition
+    // moves to submit time.
+    void TestSplitOnFirstUse()
+    {
+        ResourceStateRegistry registry;
+        registry.Register(Texture, 1, StateCommon);
+        ResourceStateTracker tracker(registry);
+
+        tracker.BeginTransition(Texture, StatePixelShaderResource);
+        tracker.EndTransition(Texture, StatePixelShaderResource);
+        CHECK(tracker.GetBarriers().empty());
+
+        std::vector<TrackedBarrier> fixups;
+        registry.Resolve(tracker, fixups);
+        CHECK(fixups.size() == 1);
+        CHECK(IsBarrier(fixups[0], Texture, AllSubresources, StateCommon, StatePixelShaderResource, TrackedBarrierFlags::None));
+    }
+
+    // The registry sums the stats of every command list resolved since the
+    // last reset.
+    void TestFrameStats()
+    {
+        ResourceStateRegistry registry;
+        registry.Register(Texture, 1, StateCommon);
+        ResourceStateTracker first(registry);
+        ResourceStateTracker second(registry);
+
+        first.Transition(Texture, StateRenderTarget);
+        first.Transition(Texture, StateRenderTarget);
+        second.Transition(Texture, StateRenderTarget);
+        second.Transition(Texture, StatePixelShaderResource);
+
+        std::vector<TrackedBarrier> fixups;
+        registry.Resolve(first, fixups);
+        registry.Resolve(second, fixups);
+        CHECK(fixups.size() == 1);
+
+        const ResourceStateStats& stats = registry.GetFrameStats();
+        CHECK(stats.requestedTransitions == 4);
+        CHECK(stats.emittedBarriers == 2);
+        CHECK(stats.eliminatedBarriers == 2);
+
+        registry.ResetFrameStats();
+        CHECK(registry.GetFrameStats().requestedTransitions == 0);
+        CHECK(registry.GetFrameStats().emittedBarriers == 0);
+    }
+
+    void TestUnregistered()
+    {
+        ResourceStateRegistry registry;
+        registry.Register(Texture, 1, StateCommon);
+        registry.Unregister(Texture);
+        ResourceStateTracker tracker(registry);
+
+        bool threw = false;
+        try
+        {
+            tracker.Transition(Texture, StateRenderTarget);
+        }
+        catch (const std::logic_error&)
+        {
+            threw = true;
+        }
+        CHECK(threw);
+    }
+}
+
+int main()
+{
+    TestRedundantTransitions();
+    TestFirstUseInRegisteredState();
+    TestSubresources();
+    TestSplitTransitions();
+    TestSplitOnFirstUse();
+    TestFrameStats();
+    TestUnregistered();
+    return TestFailures();
+}
@@ -0,0 +1,290 @@
+#include "RootSignatureLayout.h"
+
+#include <algorithm>
+#include <map>
+#include <tuple>
+
+namespace
+{
+    enum class BindingForm
+    {
+        RootConstants,
+        RootDescriptor,
+        Table,
+    };
+
+    // Tables are shared by bindings of the same frequency, visibility and heap.
+    typedef std::tuple<UpdateFrequency, BindingVisibility, bool> TableKey;
+
+    uint32_t GetConstantDwords(const BindingDecl& binding)
+    {
+        return (binding.sizeInBytes + 3) / 4;
+    }
+
+    bool IsSampler(const BindingDecl& binding)
+    {
+        return binding.kind == BindingKind::Sampler;
+    }
+
+    TableKey GetTableKey(const BindingDecl& binding)
+    {
+        return TableKey(binding.frequency, binding.visibility, IsSampler(binding));
+    }
+
+    BindingForm GetPreferredForm(const BindingDecl& binding, const RootSignatureOptions& options)
+    {
+        if (binding.descriptorCount > 1)
+        {
+            return BindingForm::Table;
+        }
+
+        switch (binding.kind)
+        {
+        case BindingKind::Constants:
+            return GetConstantDwords(binding) <= options.maxRootConstantDwords ? BindingForm::RootConstants : BindingForm::RootDescriptor;
+        case BindingKind::ConstantBuffer:
+        case BindingKind::Buffer:
+        case BindingKind::RWBuffer:
+            return BindingForm::RootDescriptor;
+        default:
+            return BindingForm::Table;
+        }
+    }
+
+    // Root constants of one or two DWORDs are no bigger than a root CBV and go
+    // straight into a table.
+    BindingForm GetDemotedForm(const BindingDecl& binding, BindingForm form)
+    {
+        if (form == BindingForm::RootConstants && GetConstantDwords(binding) > 2)
+        {
+            return BindingForm::RootDescriptor;
+        }
+        return BindingForm::Table;
+    }
+
+    uint32_t GetLayoutCost(const std::vector<BindingDecl>& bindings, const std::vector<BindingForm>& forms)
+    {
+        uint32_t cost = 0;
+        std::vector<TableKey> tables;
+        for (size_t i = 0; i < bindings.size(); i++)
+        {
+            switch (forms[i])
+            {
+            case BindingForm::RootConstants:
+                cost += GetRootParameterCost(RootParameterType::Constants, GetConstantDwords(bindings[i]));
+                break;
+            case BindingForm::RootDescriptor:
+                cost += GetRootParameterCost(RootParameterType::ConstantBufferView, 0);
+                break;
+            case BindingForm::Table:
+            {
+                const TableKey key = GetTableKey(bindings[i]);
+                if (std::find(tables.begin(), tables.end(), key) == tables.end())
+                {
+                    tables.push_back(key);
+                    cost += GetRootParameterCost(RootParameterType::DescriptorTable, 0);
+                }
+                break;
+            }
+            }
+        }
+        return cost;
+    }
+
+    RootParameterType GetRootDescriptorType(const BindingDecl& binding)
+    {
+        switch (binding.kind)
+        {
+        case BindingKind::Buffer: return RootParameterType::ShaderResourceView;
+        case BindingKind::RWBuffer: return RootParameterType::UnorderedAccessView;
+        default: return RootParameterType::ConstantBufferView;
+        }
+    }
+
+    void HashValue(uint64_t value, uint64_t* pHash)
+    {
+        // FNV-1a over the bytes of value.
+        for (int i = 0; i < 8; i++)
+        {
+            *pHash ^= (value >> (i * 8)) & 0xff;
+            *pHash *= 0x100000001b3ull;
+        }
+    }
+}
+
+uint32_t GetRootParameterCost(RootParameterType type, uint32_t num32BitValues)
+{
+    switch (type)
+    {
+    case RootParameterType::Constants: return num32BitValues;
+    case RootParameterType::DescriptorTable: return 1;
+    default: return 2;
+    }
+}
+
+RootSignatureBuilder::RootSignatureBuilder()
+{
+}
+
+uint32_t RootSignatureBuilder::AddBinding(const BindingDecl& binding)
+{
+    _bindings.push_back(binding);
+    return static_cast<uint32_t>(_bindings.size() - 1);
+}
+
+uint32_t RootSignatureBuilder::AddConstants(const char* name, uint32_t shaderRegister, uint32_t sizeInBytes, UpdateFrequency frequency, BindingVisibility visibility)
+{
+    return AddBinding({ name, BindingKind::Constants, shaderRegister, 0, 1, sizeInBytes, frequency, visibility });
+}
+
+uint32_t RootSignatureBuilder::AddConstantBuffer(const char* name, uint32_t shaderRegister, UpdateFrequency frequency, BindingVisibility visibility)
+{
+    return AddBinding({ name, BindingKind::ConstantBuffer, shaderRegister, 0, 1, 0, frequency, visibility });
+}
+
+uint32_t RootSignatureBuilder::AddBuffer(const char* name, uint32_t shaderRegister, UpdateFrequency frequency, BindingVisibility visibility)
+{
+    return AddBinding({ name, BindingKind::Buffer, shaderRegister, 0, 1, 0, frequency, visibility });
+}
+
+uint32_t RootSignatureBuilder::AddTextures(const char* name, uint32_t shaderRegister, uint32_t count, UpdateFrequency frequency, BindingVisibility visibility)
+{
+    return AddBinding({ name, BindingKind::Texture, shaderRegister, 0, count, 0, frequency, visibility });
+}
+
+uint32_t RootSignatureBuilder::AddSamplers(const char* name, uint32_t shaderRegister, uint32_t count, UpdateFrequency frequency, BindingVisibility visibility)
+{
+    return AddBinding({ name, BindingKind::Sampler, shaderRegister, 0, count, 0, frequency, visibility });
+}
+
+bool RootSignatureBuilder::Build(const RootSignatureOptions& options, RootSignatureLayout* pLayout, std::string* pError) const
+{
+    std::vector<BindingForm> forms(_bindings.size());
+    for (size_t i = 0; i < _bindings.size(); i++)
+    {
+        forms[i] = GetPreferredForm(_bindings[i], options);
+    }
+
+    const uint32_t budget = std::min(options.budgetDwords, MaxRootSignatureDwords);
+    uint32_t cost = GetLayoutCost(_bindings, forms);
+    while (cost > budget)
+    {
+        size_t best = _bindings.size();
+        uint32_t bestSaving = 0;
+        for (size_t i = 0; i < _bindings.size(); i++)
+        {
+            if (forms[i] == BindingForm::Table)
+            {
+                continue;
+            }
+
+            const BindingForm form = forms[i];
+            forms[i] = GetDemotedForm(_bindings[i], form);
+            const uint32_t demotedCost = GetLayoutCost(_bindings, forms);
+            forms[i] = form;
+            if (demotedCost >= cost)
+            {
+                continue;
+            }
+
+            const uint32_t saving = cost - demotedCost;
+            const bool lessFrequent = best == _bindings.size() || _bindings[i].frequency > _bindings[best].frequency;
+            const bool sameFrequency = best != _bindings.size() && _bindings[i].frequency == _bindings[best].frequency;
+            if (lessFrequent || (sameFrequency && saving > bestSaving))
+            {
+                best = i;
+                bestSaving = saving;
+            }
+        }
+
+        if (best == _bindings.size())
+        {
+            *pError = "Root signature needs " + std::to_string(cost) + " DWORDs, the budget is " + std::to_string(budget);
+            return false;
+        }
+        forms[best] = GetDemotedForm(_bindings[best], forms[best]);
+        cost = GetLayoutCost(_bindings, forms);
+    }
+
+    // One parameter per root binding and per table, in declaration order first.
+    std::vector<RootParameterLayout> parameters;
+    std::map<TableKey, size_t> tables;
+    for (uint32_t i = 0; i < _bindings.size(); i++)
+    {
+        const BindingDecl& binding = _bindings[i];
+        if (forms[i] == BindingForm::Table)
+        {
+            const TableKey key = GetTableKey(binding);
+            std::map<TableKey, size_t>::const_iterator table = tables.find(key);
+            if (table != tables.end())
+            {
+                parameters[table->second].bindings.push_back(i);
+                continue;
+            }
+            tables[key] = parameters.size();
+        }
+
+        RootParameterLayout parameter;
+        parameter.frequency = binding.frequency;
+        parameter.visibility = binding.visibility;
+        parameter.num32BitValues = 0;
+        parameter.samplerTable = false;
+        parameter.bindings.push_back(i);
+        switch (forms[i])
+        {
+        case BindingForm::RootConstants:
+            parameter.type = RootParameterType::Constants;
+            parameter.num32BitValues = GetConstantDwords(binding);
+            break;
+        case BindingForm::RootDescriptor:
+            parameter.type = GetRootDescriptorType(binding);
+            break;
+        case BindingForm::Table:
+            parameter.type = RootParameterType::DescriptorTable;
+            parameter.samplerTable = IsSampler(binding);
+            break;
+        }
+        parameters.push_back(parameter);
+    }
+
+    std::stable_sort(parameters.begin(), parameters.end(), [](const RootParameterLayout& a, const RootParameterLayout& b)
+    {
+        return a.frequency < b.frequency;
+    });
+
+    pLayout->bindings = _bindings;
+    pLayout->parameters = std::move(parameters);
+    pLayout->bindingParameters.assign(_bindings.size(), 0);
+    pLayout->bindingTableOffsets.assign(_bindings.size(), 0);
+    pLayout->dwordCount = cost;
+
+    // The hash covers what ends up in the serialized root signature, not names
+    // or frequencies.
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (uint32_t p = 0; p < pLayout->parameters.size(); p++)
+    {
+        const RootParameterLayout& parameter = pLayout->parameters[p];
+        HashValue(static_cast<uint64_t>(parameter.type), &hash);
+        HashValue(static_cast<uint64_t>(parameter.visibility), &hash);
+        HashValue(parameter.num32BitValues, &hash);
+
+        uint32_t tableOffset = 0;
+        for (uint32_t b : parameter.bindings)
+        {
+            const BindingDecl& binding = _bindings[b];
+            pLayout->bindingParameters[b] = p;
+            pLayout->bindingTableOffsets[b] = tableOffset;
+            if (parameter.type == RootParameterType::DescriptorTable)
+            {
+                tableOffset += binding.descriptorCount;
+            }
+
+            HashValue(static_cast<uint64_t>(binding.kind), &hash);
+            HashValue(binding.shaderRegister, &hash);
+            HashValue(binding.registerSpace, &hash);
+            HashValue(binding.descriptorCount, &hash);
+        }
+    }
+    pLayout->hash = hash;
+    return true;
+}
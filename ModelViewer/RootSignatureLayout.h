@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Root signatures hold at most 64 DWORDs. Root constants cost one DWORD each,
+// root descriptors two and descriptor tables one.
+static const uint32_t MaxRootSignatureDwords = 64;
+
+// What a shader binds, before it is decided how.
+enum class BindingKind : uint32_t
+{
+    Constants,          // Constant data written per use: root constants when small, else a root CBV.
+    ConstantBuffer,     // A constant buffer that lives elsewhere: root CBV.
+    Buffer,             // Structured or raw buffer SRV: root SRV.
+    RWBuffer,           // Structured or raw buffer UAV: root UAV.
+    Texture,            // SRVs that need descriptors: always in a table.
+    RWTexture,          // UAVs that need descriptors: always in a table.
+    Sampler,            // Always in a sampler table.
+};
+
+// Most frequent first; root parameters are ordered the same way.
+enum class UpdateFrequency : uint32_t
+{
+    PerDraw,
+    PerMaterial,
+    PerView,
+    PerFrame,
+    Static,
+};
+
+// Mirrors D3D12_SHADER_VISIBILITY.
+enum class BindingVisibility : uint32_t
+{
+    All,
+    Vertex,
+    Hull,
+    Domain,
+    Geometry,
+    Pixel,
+};
+
+struct BindingDecl
+{
+    std::string name;
+    BindingKind kind;
+    uint32_t shaderRegister;
+    uint32_t registerSpace;
+    uint32_t descriptorCount;   // More than one forces a table.
+    uint32_t sizeInBytes;       // Constants only.
+    UpdateFrequency frequency;
+    BindingVisibility visibility;
+};
+
+// Mirrors D3D12_ROOT_PARAMETER_TYPE.
+enum class RootParameterType : uint32_t
+{
+    DescriptorTable,
+    Constants,
+    ConstantBufferView,
+    ShaderResourceView,
+    UnorderedAccessView,
+};
+
+uint32_t GetRootParameterCost(RootParameterType type, uint32_t num32BitValues);
+
+struct RootParameterLayout
+{
+    RootParameterType type;
+    UpdateFrequency frequency;
+    BindingVisibility visibility;
+    uint32_t num32BitValues;            // Constants only.
+    bool samplerTable;                  // Tables only: samplers live in a heap of their own.
+    std::vector<uint32_t> bindings;     // One, or the ranges of a table in declaration order.
+};
+
+struct RootSignatureLayout
+{
+    std::vector<BindingDecl> bindings;
+    std::vector<RootParameterLayout> parameters;
+    std::vector<uint32_t> bindingParameters;        // Root parameter index of each binding.
+    std::vector<uint32_t> bindingTableOffsets;      // Descriptor offset inside its table; 0 outside tables.
+    uint32_t dwordCount;
+    uint64_t hash;                                  // Of everything above; equal layouts hash equal.
+};
+
+struct RootSignatureOptions
+{
+    uint32_t maxRootConstantDwords = 8;     // Constants up to this size become root constants.
+    uint32_t budgetDwords = MaxRootSignatureDwords;   // Never more than MaxRootSignatureDwords.
+};
+
+// Turns declared bindings into a root signature layout. Every binding first
+// gets its cheapest form to update: small constants inline, buffers as root
+// descriptors, the rest in one table per frequency and visibility. While the
+// layout is over budget, the binding updated least often is demoted one step
+// (root constants to a root CBV, root descriptors into a table), the one
+// saving most space first among equals. Parameters come out ordered by
+// frequency, so what changes per draw sits at the front of the root
+// signature where hardware keeps it in the fastest storage.
+class RootSignatureBuilder
+{
+public: RootSignatureBuilder();
+
+    // Returns the binding index the layout refers to.
+public: uint32_t AddBinding(const BindingDecl& binding);
+
+public: uint32_t AddConstants(const char* name, uint32_t shaderRegister, uint32_t sizeInBytes, UpdateFrequency frequency, BindingVisibility visibility = BindingVisibility::All);
+public: uint32_t AddConstantBuffer(const char* name, uint32_t shaderRegister, UpdateFrequency frequency, BindingVisibility visibility = BindingVisibility::All);
+public: uint32_t AddBuffer(const char* name, uint32_t shaderRegister, UpdateFrequency frequency, BindingVisibility visibility = BindingVisibility::All);
+public: uint32_t AddTextures(const char* name, uint32_t shaderRegister, uint32_t count, UpdateFrequency frequency, BindingVisibility visibility = BindingVisibility::All);
+public: uint32_t AddSamplers(const char* name, uint32_t shaderRegister, uint32_t count, UpdateFrequency frequency, BindingVisibility visibility = BindingVisibility::All);
+
+    // False with a message when the bindings cannot fit the budget in any form.
+public: bool Build(const RootSignatureOptions& options, RootSignatureLayout* pLayout, std::string* pError) const;
+
+private: std::vector<BindingDecl> _bindings;
+};
@@ -0,0 +1,218 @@
+#include "RootSignatureLayout.h"
+#include "UnitTest.h"
+
+#include <string>
+
+namespace
+{
+    const RootParameterLayout& GetParameter(const RootSignatureLayout& layout, uint32_t binding)
+    {
+        return layout.parameters[layout.bindingParameters[binding]];
+    }
+
+    bool IsOrderedByFrequency(const RootSignatureLayout& layout)
+    {
+        for (size_t p = 1; p < layout.parameters.size(); p++)
+        {
+            if (layout.parameters[p].frequency < layout.parameters[p - 1].frequency)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    uint32_t SumParameterCosts(const RootSignatureLayout& layout)
+    {
+        uint32_t cost = 0;
+        for (const RootParameterLayout& parameter : layout.parameters)
+        {
+            cost += GetRootParameterCost(parameter.type, parameter.num32BitValues);
+        }
+        return cost;
+    }
+
+    // Under budget every binding keeps its cheapest form to update, and what
+    // changes per draw comes first.
+    void TestPreferredForms()
+    {
+        RootSignatureBuilder builder;
+        const uint32_t frame = builder.AddConstants("Frame", 0, 16, UpdateFrequency::PerFrame);
+        const uint32_t view = builder.AddConstants("View", 1, 80, UpdateFrequency::PerView);
+        const uint32_t draw = builder.AddConstants("Draw", 2, 16, UpdateFrequency::PerDraw);
+        const uint32_t material = builder.AddConstantBuffer("Material", 3, UpdateFrequency::PerMaterial, BindingVisibility::Pixel);
+        const uint32_t instances = builder.AddBuffer("Instances", 0, UpdateFrequency::PerDraw, BindingVisibility::Vertex);
+        const uint32_t textures = builder.AddTextures("Textures", 1, 4, UpdateFrequency::PerMaterial, BindingVisibility::Pixel);
+
+        RootSignatureLayout layout;
+        std::string error;
+        CHECK(builder.Build(RootSignatureOptions(), &layout, &error));
+
+        CHECK(GetParameter(layout, frame).type == RootParameterType::Constants);
+        CHECK(GetParameter(layout, frame).num32BitValues == 4);
+        CHECK(GetParameter(layout, view).type == RootParameterType::ConstantBufferView);
+        CHECK(GetParameter(layout, draw).type == RootParameterType::Constants);
+        CHECK(GetParameter(layout, material).type == RootParameterType::ConstantBufferView);
+        CHECK(GetParameter(layout, instances).type == RootParameterType::ShaderResourceView);
+        CHECK(GetParameter(layout, textures).type == RootParameterType::DescriptorTable);
+
+        // Declaration order within a frequency.
+        CHECK(layout.bindingParameters[draw] == 0);
+        CHECK(layout.bindingParameters[instances] == 1);
+        CHECK(layout.bindingParameters[frame] == layout.parameters.size() - 1);
+        CHECK(IsOrderedByFrequency(layout));
+        CHECK(layout.dwordCount == 4 + 2 + 4 + 2 + 2 + 1);
+        CHECK(layout.dwordCount == SumParameterCosts(layout));
+    }
+
+    // Over budget, the least frequently updated bindings give way first, the
+    // biggest saving first among equals; per-draw constants stay inline.
+    void TestDemotionOrder()
+    {
+        RootSignatureBuilder builder;
+        const uint32_t draw = builder.AddConstants("Draw", 0, 32, UpdateFrequency::PerDraw);
+        const uint32_t view = builder.AddConstants("View", 1, 32, UpdateFrequency::PerView);
+        const uint32_t lights = builder.AddBuffer("Lights", 0, UpdateFrequency::PerFrame);
+        const uint32_t frame = builder.AddConstants("Frame", 2, 32, UpdateFrequency::PerFrame);
+
+        RootSignatureOptions options;
+        RootSignatureLayout layout;
+        std::string error;
+        CHECK(builder.Build(options, &layout, &error));
+        CHECK(layout.dwordCount == 8 + 8 + 2 + 8);
+
+        // One step: the per-frame constants save 6 DWORDs as a root CBV, the
+        // per-frame buffer only 1 in a table.
+        options.budgetDwords = 25;
+        CHECK(builder.Build(options, &layout, &error));
+        CHECK(layout.dwordCount == 20);
+        CHECK(GetParameter(layout, frame).type == RootParameterType::ConstantBufferView);
+        CHECK(GetParameter(layout, lights).type == RootParameterType::ShaderResourceView);
+        CHECK(GetParameter(layout, view).type == RootParameterType::Constants);
+
+        // Per-frame bindings end up sharing one table before the view moves.
+        options.budgetDwords = 18;
+        CHECK(builder.Build(options, &layout, &error));
+        CHECK(layout.dwordCount == 17);
+        CHECK(GetParameter(layout, frame).type == RootParameterType::DescriptorTable);
+        CHECK(layout.bindingParameters[frame] == layout.bindingParameters[lights]);
+        CHECK(GetParameter(layout, view).type == RootParameterType::Constants);
+
+        options.budgetDwords = 16;
+        CHECK(builder.Build(options, &layout, &error));
+        CHECK(GetParameter(layout, view).type == RootParameterType::ConstantBufferView);
+        CHECK(GetParameter(layout, draw).type == RootParameterType::Constants);
+        CHECK(layout.dwordCount == 8 + 2 + 1);
+        CHECK(IsOrderedByFrequency(layout));
+    }
+
+    // Past 64 DWORDs of root constants the layout demotes down to the hardware
+    // limit even when the budget asks for more; among equals the bindings
+    // declared first go first.
+    void TestHardwareLimit()
+    {
+        RootSignatureBuilder builder;
+        for (uint32_t i = 0; i < 10; i++)
+        {
+            builder.AddConstants("Constants", i, 32, UpdateFrequency::PerDraw);
+        }
+
+        RootSignatureOptions options;
+        options.budgetDwords = 100;
+        RootSignatureLayout layout;
+        std::string error;
+        CHECK(builder.Build(options, &layout, &error));
+        CHECK(layout.dwordCount <= MaxRootSignatureDwords);
+        CHECK(layout.dwordCount == SumParameterCosts(layout));
+        CHECK(layout.dwordCount == 62);
+        for (uint32_t i = 0; i < 10; i++)
+        {
+            CHECK(GetParameter(layout, i).type == (i < 3 ? RootParameterType::ConstantBufferView : RootParameterType::Constants));
+        }
+    }
+
+    // Every binding already in a table and still over budget.
+    void TestOverflow()
+    {
+        RootSignatureBuilder builder;
+        builder.AddTextures("Draw", 0, 2, UpdateFrequency::PerDraw);
+        builder.AddTextures("Material", 2, 2, UpdateFrequency::PerMaterial);
+        builder.AddSamplers("Samplers", 0, 2, UpdateFrequency::Static);
+
+        RootSignatureOptions options;
+        options.budgetDwords = 2;
+        RootSignatureLayout layout = {};
+        std::string error;
+        CHECK(!builder.Build(options, &layout, &error));
+        CHECK(error == "Root signature needs 3 DWORDs, the budget is 2");
+        CHECK(layout.parameters.empty());
+
+        options.budgetDwords = 3;
+        error.clear();
+        CHECK(builder.Build(options, &layout, &error));
+        CHECK(error.empty());
+    }
+
+    // Tables are shared by frequency, visibility and heap; each binding's
+    // offset follows the descriptors declared before it in the same table.
+    void TestTableSharing()
+    {
+        RootSignatureBuilder builder;
+        const uint32_t albedo = builder.AddTextures("Albedo", 0, 4, UpdateFrequency::PerMaterial, BindingVisibility::Pixel);
+        const uint32_t samplers = builder.AddSamplers("Samplers", 0, 2, UpdateFrequency::PerMaterial, BindingVisibility::Pixel);
+        const uint32_t normal = builder.AddTextures("Normal", 4, 2, UpdateFrequency::PerMaterial, BindingVisibility::Pixel);
+        const uint32_t displacement = builder.AddTextures("Displacement", 6, 2, UpdateFrequency::PerMaterial, BindingVisibility::Vertex);
+        const uint32_t shadows = builder.AddTextures("Shadows", 8, 2, UpdateFrequency::PerFrame, BindingVisibility::Pixel);
+
+        RootSignatureLayout layout;
+        std::string error;
+        CHECK(builder.Build(RootSignatureOptions(), &layout, &error));
+        CHECK(layout.parameters.size() == 4);
+        CHECK(layout.dwordCount == 4);
+
+        CHECK(layout.bindingParameters[albedo] == layout.bindingParameters[normal]);
+        CHECK(layout.bindingTableOffsets[albedo] == 0);
+        CHECK(layout.bindingTableOffsets[normal] == 4);
+        CHECK(GetParameter(layout, albedo).bindings.size() == 2);
+        CHECK(!GetParameter(layout, albedo).samplerTable);
+
+        CHECK(layout.bindingParameters[samplers] != layout.bindingParameters[albedo]);
+        CHECK(GetParameter(layout, samplers).samplerTable);
+        CHECK(layout.bindingTableOffsets[samplers] == 0);
+
+        CHECK(layout.bindingParameters[displacement] != layout.bindingParameters[albedo]);
+        CHECK(layout.bindingParameters[shadows] == 3);
+    }
+
+    // The hash follows what gets serialized: registers, not names.
+    void TestHash()
+    {
+        RootSignatureBuilder a;
+        RootSignatureBuilder b;
+        RootSignatureBuilder c;
+        a.AddConstants("A", 0, 16, UpdateFrequency::PerDraw);
+        b.AddConstants("B", 0, 16, UpdateFrequency::PerDraw);
+        c.AddConstants("A", 1, 16, UpdateFrequency::PerDraw);
+
+        RootSignatureLayout layoutA;
+        RootSignatureLayout layoutB;
+        RootSignatureLayout layoutC;
+        std::string error;
+        CHECK(a.Build(RootSignatureOptions(), &layoutA, &error));
+        CHECK(b.Build(RootSignatureOptions(), &layoutB, &error));
+        CHECK(c.Build(RootSignatureOptions(), &layoutC, &error));
+        CHECK(layoutA.hash == layoutB.hash);
+        CHECK(layoutA.hash != layoutC.hash);
+    }
+}
+
+int main()
+{
+    TestPreferredForms();
+    TestDemotionOrder();
+    TestHardwareLimit();
+    TestOverflow();
+    TestTableSharing();
+    TestHash();
+    return TestFailures();
+}
@@ -0,0 +1,245 @@
+#include "RootSignatureSerializer.h"
+
+#include <chrono>
+#include <cstring>
+
+namespace
+{
+    template <typename T>
+    void AppendKey(const T& value, std::vector<uint8_t>* pKey)
+    {
+        const uint8_t* pBytes = reinterpret_cast<const uint8_t*>(&value);
+        pKey->insert(pKey->end(), pBytes, pBytes + sizeof(T));
+    }
+
+    // Ranges and samplers have no padding and are appended whole.
+    template <typename T>
+    void AppendKeyArray(const T* pValues, uint32_t count, std::vector<uint8_t>* pKey)
+    {
+        AppendKey(count, pKey);
+        if (count > 0)
+        {
+            const uint8_t* pBytes = reinterpret_cast<const uint8_t*>(pValues);
+            pKey->insert(pKey->end(), pBytes, pBytes + count * sizeof(T));
+        }
+    }
+
+    template <typename Parameter>
+    void AppendParameterHeader(const Parameter& parameter, std::vector<uint8_t>* pKey)
+    {
+        AppendKey(parameter.parameterType, pKey);
+        AppendKey(parameter.shaderVisibility, pKey);
+        if (parameter.parameterType == RootParameterType::Constants)
+        {
+            AppendKey(parameter.constants.shaderRegister, pKey);
+            AppendKey(parameter.constants.registerSpace, pKey);
+            AppendKey(parameter.constants.num32BitValues, pKey);
+        }
+        else if (parameter.parameterType != RootParameterType::DescriptorTable)
+        {
+            AppendKey(parameter.descriptor.shaderRegister, pKey);
+            AppendKey(parameter.descriptor.registerSpace, pKey);
+        }
+    }
+
+    inline size_t AlignArena(size_t size)
+    {
+        return (size + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
+    }
+}
+
+void AppendRootSignatureKey(const VersionedRootSignatureDesc& desc, std::vector<uint8_t>* pKey)
+{
+    AppendKey(desc.version, pKey);
+    if (desc.version == RootSignatureVersion::Version1_0)
+    {
+        const RootSignatureDesc& desc_1_0 = desc.desc_1_0;
+        AppendKey(desc_1_0.flags, pKey);
+        AppendKey(desc_1_0.numParameters, pKey);
+        for (uint32_t i = 0; i < desc_1_0.numParameters; i++)
+        {
+            const RootParameter& parameter = desc_1_0.pParameters[i];
+            AppendParameterHeader(parameter, pKey);
+            if (parameter.parameterType == RootParameterType::DescriptorTable)
+            {
+                AppendKeyArray(parameter.descriptorTable.pDescriptorRanges, parameter.descriptorTable.numDescriptorRanges, pKey);
+            }
+        }
+        AppendKeyArray(desc_1_0.pStaticSamplers, desc_1_0.numStaticSamplers, pKey);
+    }
+    else
+    {
+        const RootSignatureDesc1& desc_1_1 = desc.desc_1_1;
+        AppendKey(desc_1_1.flags, pKey);
+        AppendKey(desc_1_1.numParameters, pKey);
+        for (uint32_t i = 0; i < desc_1_1.numParameters; i++)
+        {
+            const RootParameter1& parameter = desc_1_1.pParameters[i];
+            AppendParameterHeader(parameter, pKey);
+            if (parameter.parameterType == RootParameterType::DescriptorTable)
+            {
+                AppendKeyArray(parameter.descriptorTable.pDescriptorRanges, parameter.descriptorTable.numDescriptorRanges, pKey);
+            }
+            else if (parameter.parameterType != RootParameterType::Constants)
+            {
+                AppendKey(parameter.descriptor.flags, pKey);
+            }
+        }
+        AppendKeyArray(desc_1_1.pStaticSamplers, desc_1_1.numStaticSamplers, pKey);
+    }
+}
+
+uint64_t HashRootSignatureKey(const uint8_t* pKey, size_t size)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= pKey[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+DownlevelRootSignature::DownlevelRootSignature()
+{
+    _desc.version = RootSignatureVersion::Version1_0;
+    _desc.desc_1_0 = {};
+}
+
+void DownlevelRootSignature::Convert(const RootSignatureDesc1& desc)
+{
+    uint32_t rangeCount = 0;
+    for (uint32_t i = 0; i < desc.numParameters; i++)
+    {
+        if (desc.pParameters[i].parameterType == RootParameterType::DescriptorTable)
+        {
+            rangeCount += desc.pParameters[i].descriptorTable.numDescriptorRanges;
+        }
+    }
+
+    // Parameters, then ranges, then static samplers.
+    const size_t rangesOffset = AlignArena(desc.numParameters * sizeof(RootParameter));
+    const size_t samplersOffset = rangesOffset + AlignArena(rangeCount * sizeof(RootDescriptorRange));
+    const size_t size = samplersOffset + AlignArena(desc.numStaticSamplers * sizeof(RootStaticSampler));
+    _arena.resize(size / sizeof(uint64_t));
+
+    uint8_t* pArena = reinterpret_cast<uint8_t*>(_arena.data());
+    RootParameter* pParameters = reinterpret_cast<RootParameter*>(pArena);
+    RootDescriptorRange* pRanges = reinterpret_cast<RootDescriptorRange*>(pArena + rangesOffset);
+    RootStaticSampler* pSamplers = reinterpret_cast<RootStaticSampler*>(pArena + samplersOffset);
+
+    for (uint32_t i = 0; i < desc.numParameters; i++)
+    {
+        const RootParameter1& source = desc.pParameters[i];
+        RootParameter& parameter = pParameters[i];
+        parameter.parameterType = source.parameterType;
+        parameter.shaderVisibility = source.shaderVisibility;
+        switch (source.parameterType)
+        {
+        case RootParameterType::Constants:
+            parameter.constants = source.constants;
+            break;
+        case RootParameterType::DescriptorTable:
+            parameter.descriptorTable.numDescriptorRanges = source.descriptorTable.numDescriptorRanges;
+            parameter.descriptorTable.pDescriptorRanges = pRanges;
+            for (uint32_t r = 0; r < source.descriptorTable.numDescriptorRanges; r++)
+            {
+                const RootDescriptorRange1& range = source.descriptorTable.pDescriptorRanges[r];
+                pRanges->rangeType = range.rangeType;
+                pRanges->numDescriptors = range.numDescriptors;
+                pRanges->baseShaderRegister = range.baseShaderRegister;
+                pRanges->registerSpace = range.registerSpace;
+                pRanges->offsetInDescriptorsFromTableStart = range.offsetInDescriptorsFromTableStart;
+                pRanges++;
+            }
+            break;
+        default:
+            parameter.descriptor.shaderRegister = source.descriptor.shaderRegister;
+            parameter.descriptor.registerSpace = source.descriptor.registerSpace;
+            break;
+        }
+    }
+
+    if (desc.numStaticSamplers > 0)
+    {
+        memcpy(pSamplers, desc.pStaticSamplers, desc.numStaticSamplers * sizeof(RootStaticSampler));
+    }
+
+    _desc.version = RootSignatureVersion::Version1_0;
+    _desc.desc_1_0.numParameters = desc.numParameters;
+    _desc.desc_1_0.pParameters = pParameters;
+    _desc.desc_1_0.numStaticSamplers = desc.numStaticSamplers;
+    _desc.desc_1_0.pStaticSamplers = pSamplers;
+    _desc.desc_1_0.flags = desc.flags;
+}
+
+RootSignatureSerializer::RootSignatureSerializer(RootSignatureVersion maxVersion, Backend backend) :
+    _maxVersion(maxVersion),
+    _backend(std::move(backend)),
+    _stats()
+{
+}
+
+RootSignatureBlob RootSignatureSerializer::Serialize(const VersionedRootSignatureDesc& desc, std::string* pError)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stats.requests++;
+
+    _key.clear();
+    AppendRootSignatureKey(desc, &_key);
+    const uint64_t hash = HashRootSignatureKey(_key.data(), _key.size());
+
+    auto found = _entries.find(hash);
+    const bool collision = found != _entries.end() && found->second.key != _key;
+    if (found != _entries.end() && !collision)
+    {
+        _stats.hits++;
+        return found->second.blob;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    const VersionedRootSignatureDesc* pDesc = &desc;
+    if (desc.version == RootSignatureVersion::Version1_1 && _maxVersion == RootSignatureVersion::Version1_0)
+    {
+        _downlevel.Convert(desc.desc_1_1);
+        pDesc = &_downlevel.GetDesc();
+        _stats.conversions++;
+    }
+
+    std::shared_ptr<std::vector<uint8_t>> blob = std::make_shared<std::vector<uint8_t>>();
+    _stats.serializations++;
+    const bool serialized = _backend(*pDesc, blob.get(), pError);
+
+    const auto end = std::chrono::steady_clock::now();
+    _stats.missMicroseconds += std::chrono::duration<double, std::micro>(end - start).count();
+
+    if (!serialized)
+    {
+        return nullptr;
+    }
+
+    if (collision)
+    {
+        _stats.collisions++;
+    }
+    else
+    {
+        Entry& entry = _entries[hash];
+        entry.key = _key;
+        entry.blob = blob;
+    }
+    return blob;
+}
+
+RootSignatureSerializerStats RootSignatureSerializer::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stats;
+}
+
+size_t RootSignatureSerializer::GetBlobCount() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _entries.size();
+}
@@ -0,0 +1,233 @@
+#pragma once
+
+#include "RootSignatureLayout.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Root signature descs without the D3D12 headers. Every struct has the
+// members of its D3D12 counterpart in the same order, so the layouts match;
+// D3D12RootSignature.cpp checks that and casts between them.
+
+// Mirrors D3D_ROOT_SIGNATURE_VERSION.
+enum class RootSignatureVersion : uint32_t
+{
+    Version1_0 = 0x1,
+    Version1_1 = 0x2,
+};
+
+// Mirrors D3D12_DESCRIPTOR_RANGE_TYPE.
+enum class DescriptorRangeType : uint32_t
+{
+    Srv,
+    Uav,
+    Cbv,
+    Sampler,
+};
+
+// Mirrors D3D12_DESCRIPTOR_RANGE.
+struct RootDescriptorRange
+{
+    DescriptorRangeType rangeType;
+    uint32_t numDescriptors;
+    uint32_t baseShaderRegister;
+    uint32_t registerSpace;
+    uint32_t offsetInDescriptorsFromTableStart;
+};
+
+// Mirrors D3D12_DESCRIPTOR_RANGE1.
+struct RootDescriptorRange1
+{
+    DescriptorRangeType rangeType;
+    uint32_t numDescriptors;
+    uint32_t baseShaderRegister;
+    uint32_t registerSpace;
+    uint32_t flags;
+    uint32_t offsetInDescriptorsFromTableStart;
+};
+
+// Mirrors D3D12_ROOT_DESCRIPTOR_TABLE.
+struct RootDescriptorTable
+{
+    uint32_t numDescriptorRanges;
+    const RootDescriptorRange* pDescriptorRanges;
+};
+
+// Mirrors D3D12_ROOT_DESCRIPTOR_TABLE1.
+struct RootDescriptorTable1
+{
+    uint32_t numDescriptorRanges;
+    const RootDescriptorRange1* pDescriptorRanges;
+};
+
+// Mirrors D3D12_ROOT_CONSTANTS.
+struct RootConstants
+{
+    uint32_t shaderRegister;
+    uint32_t registerSpace;
+    uint32_t num32BitValues;
+};
+
+// Mirrors D3D12_ROOT_DESCRIPTOR.
+struct RootDescriptor
+{
+    uint32_t shaderRegister;
+    uint32_t registerSpace;
+};
+
+// Mirrors D3D12_ROOT_DESCRIPTOR1.
+struct RootDescriptor1
+{
+    uint32_t shaderRegister;
+    uint32_t registerSpace;
+    uint32_t flags;
+};
+
+// Mirrors D3D12_ROOT_PARAMETER.
+struct RootParameter
+{
+    RootParameterType parameterType;
+    union
+    {
+        RootDescriptorTable descriptorTable;
+        RootConstants constants;
+        RootDescriptor descriptor;
+    };
+    BindingVisibility shaderVisibility;
+};
+
+// Mirrors D3D12_ROOT_PARAMETER1.
+struct RootParameter1
+{
+    RootParameterType parameterType;
+    union
+    {
+        RootDescriptorTable1 descriptorTable;
+        RootConstants constants;
+        RootDescriptor1 descriptor;
+    };
+    BindingVisibility shaderVisibility;
+};
+
+// Mirrors D3D12_STATIC_SAMPLER_DESC.
+struct RootStaticSampler
+{
+    uint32_t filter;
+    uint32_t addressU;
+    uint32_t addressV;
+    uint32_t addressW;
+    float mipLODBias;
+    uint32_t maxAnisotropy;
+    uint32_t comparisonFunc;
+    uint32_t borderColor;
+    float minLOD;
+    float maxLOD;
+    uint32_t shaderRegister;
+    uint32_t registerSpace;
+    BindingVisibility shaderVisibility;
+};
+
+// Mirrors D3D12_ROOT_SIGNATURE_DESC.
+struct RootSignatureDesc
+{
+    uint32_t numParameters;
+    const RootParameter* pParameters;
+    uint32_t numStaticSamplers;
+    const RootStaticSampler* pStaticSamplers;
+    uint32_t flags;
+};
+
+// Mirrors D3D12_ROOT_SIGNATURE_DESC1.
+struct RootSignatureDesc1
+{
+    uint32_t numParameters;
+    const RootParameter1* pParameters;
+    uint32_t numStaticSamplers;
+    const RootStaticSampler* pStaticSamplers;
+    uint32_t flags;
+};
+
+// Mirrors D3D12_VERSIONED_ROOT_SIGNATURE_DESC.
+struct VersionedRootSignatureDesc
+{
+    RootSignatureVersion version;
+    union
+    {
+        RootSignatureDesc desc_1_0;
+        RootSignatureDesc1 desc_1_1;
+    };
+};
+
+// Appends everything a versioned desc serializes to, pointed-to arrays
+// included, to pKey. Equal descs give equal keys wherever they live.
+void AppendRootSignatureKey(const VersionedRootSignatureDesc& desc, std::vector<uint8_t>* pKey);
+
+// FNV-1a of the key above.
+uint64_t HashRootSignatureKey(const uint8_t* pKey, size_t size);
+
+// A 1.1 desc converted to 1.0, like D3DX12SerializeVersionedRootSignature()
+// does when only 1.0 is supported: range and root descriptor flags are
+// dropped. Parameters, ranges and static samplers are copied into a single
+// allocation the desc points into.
+class DownlevelRootSignature
+{
+public: DownlevelRootSignature();
+
+public: void Convert(const RootSignatureDesc1& desc);
+
+public: const VersionedRootSignatureDesc& GetDesc() const { return _desc; }
+public: size_t GetArenaSize() const { return _arena.size() * sizeof(uint64_t); }
+
+private: std::vector<uint64_t> _arena;
+private: VersionedRootSignatureDesc _desc;
+};
+
+struct RootSignatureSerializerStats
+{
+    uint32_t requests;
+    uint32_t hits;
+    uint32_t conversions;       // 1.1 descs converted to 1.0.
+    uint32_t serializations;    // Calls into the backend.
+    uint32_t collisions;        // Equal hashes of different descs; serialized without caching.
+    double missMicroseconds;    // Total over all misses.
+};
+
+typedef std::shared_ptr<const std::vector<uint8_t>> RootSignatureBlob;
+
+// Serializes root signatures at most once per distinct desc. Blobs are kept
+// by a content hash of the versioned desc, checked against the full key on a
+// hit, and returned as the same shared blob on every request. 1.1 descs are
+// converted to 1.0 when the backend only supports that. Thread-safe.
+class RootSignatureSerializer
+{
+    // Serializes a desc of a version the backend supports; false with a message on failure.
+public: typedef std::function<bool(const VersionedRootSignatureDesc& desc, std::vector<uint8_t>* pBlob, std::string* pError)> Backend;
+
+public: RootSignatureSerializer(RootSignatureVersion maxVersion, Backend backend);
+
+    // Null with a message on failure; failures are not cached.
+public: RootSignatureBlob Serialize(const VersionedRootSignatureDesc& desc, std::string* pError);
+
+public: RootSignatureVersion GetMaxVersion() const { return _maxVersion; }
+public: RootSignatureSerializerStats GetStats() const;
+public: size_t GetBlobCount() const;
+
+private: struct Entry
+    {
+        std::vector<uint8_t> key;
+        RootSignatureBlob blob;
+    };
+
+private: RootSignatureVersion _maxVersion;
+private: Backend _backend;
+private: mutable std::mutex _mutex;
+private: std::unordered_map<uint64_t, Entry> _entries;
+private: std::vector<uint8_t> _key;
+private: DownlevelRootSignature _downlevel;
+private: RootSignatureSerializerStats _stats;
+};
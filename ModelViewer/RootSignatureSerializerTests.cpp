@@ -0,0 +1,295 @@
+#include "RootSignatureSerializer.h"
+#include "UnitTest.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    // A 1.1 desc with a bit of everything: root constants, a root SRV, two
+    // tables and a static sampler, with range and descriptor flags set.
+    struct TestRootSignature
+    {
+        RootDescriptorRange1 ranges[3];
+        RootParameter1 parameters[4];
+        RootStaticSampler sampler;
+        VersionedRootSignatureDesc desc;
+
+        TestRootSignature()
+        {
+            const RootDescriptorRange1 textureRange = { DescriptorRangeType::Srv, 4, 0, 0, 2, 0 };
+            const RootDescriptorRange1 constantRange = { DescriptorRangeType::Cbv, 1, 1, 0, 4, 4 };
+            const RootDescriptorRange1 samplerRange = { DescriptorRangeType::Sampler, 2, 0, 0, 0, 0 };
+            ranges[0] = textureRange;
+            ranges[1] = constantRange;
+            ranges[2] = samplerRange;
+
+            memset(parameters, 0, sizeof(parameters));
+            parameters[0].parameterType = RootParameterType::Constants;
+            parameters[0].constants.num32BitValues = 4;
+            parameters[1].parameterType = RootParameterType::ShaderResourceView;
+            parameters[1].descriptor.registerSpace = 1;
+            parameters[1].descriptor.flags = 8;
+            parameters[1].shaderVisibility = BindingVisibility::Vertex;
+            parameters[2].parameterType = RootParameterType::DescriptorTable;
+            parameters[2].descriptorTable.numDescriptorRanges = 2;
+            parameters[2].descriptorTable.pDescriptorRanges = ranges;
+            parameters[2].shaderVisibility = BindingVisibility::Pixel;
+            parameters[3].parameterType = RootParameterType::DescriptorTable;
+            parameters[3].descriptorTable.numDescriptorRanges = 1;
+            parameters[3].descriptorTable.pDescriptorRanges = ranges + 2;
+            parameters[3].shaderVisibility = BindingVisibility::Pixel;
+
+            sampler = RootStaticSampler();
+            sampler.filter = 0x15;
+            sampler.maxLOD = 1000.0f;
+            sampler.shaderVisibility = BindingVisibility::Pixel;
+
+            desc.version = RootSignatureVersion::Version1_1;
+            desc.desc_1_1.numParameters = 4;
+            desc.desc_1_1.pParameters = parameters;
+            desc.desc_1_1.numStaticSamplers = 1;
+            desc.desc_1_1.pStaticSamplers = &sampler;
+            desc.desc_1_1.flags = 1;
+        }
+
+        TestRootSignature(const TestRootSignature&) = delete;
+        TestRootSignature& operator=(const TestRootSignature&) = delete;
+    };
+
+    // Stands in for D3D12SerializeVersionedRootSignature: the blob is the key
+    // of the desc it was given, so tests can see what the backend saw. Descs
+    // without static samplers fail.
+    struct FakeBackend
+    {
+        uint32_t calls = 0;
+
+        RootSignatureSerializer::Backend GetFunction()
+        {
+            return [this](const VersionedRootSignatureDesc& desc, std::vector<uint8_t>* pBlob, std::string* pError)
+            {
+                calls++;
+                const uint32_t samplers = desc.version == RootSignatureVersion::Version1_0 ? desc.desc_1_0.numStaticSamplers : desc.desc_1_1.numStaticSamplers;
+                if (samplers == 0)
+                {
+                    *pError = "no static samplers";
+                    return false;
+                }
+                AppendRootSignatureKey(desc, pBlob);
+                return true;
+            };
+        }
+    };
+
+    void TestDownlevelConversion()
+    {
+        const TestRootSignature signature;
+        DownlevelRootSignature downlevel;
+        downlevel.Convert(signature.desc.desc_1_1);
+        const VersionedRootSignatureDesc& converted = downlevel.GetDesc();
+
+        CHECK(converted.version == RootSignatureVersion::Version1_0);
+        const RootSignatureDesc& desc = converted.desc_1_0;
+        CHECK(desc.numParameters == 4);
+        CHECK(desc.flags == 1);
+        CHECK(desc.pParameters[0].parameterType == RootParameterType::Constants);
+        CHECK(desc.pParameters[0].constants.num32BitValues == 4);
+        CHECK(desc.pParameters[1].descriptor.registerSpace == 1);
+        CHECK(desc.pParameters[1].shaderVisibility == BindingVisibility::Vertex);
+
+        const RootDescriptorTable& table = desc.pParameters[2].descriptorTable;
+        CHECK(table.numDescriptorRanges == 2);
+        CHECK(table.pDescriptorRanges[0].numDescriptors == 4);
+        CHECK(table.pDescriptorRanges[1].rangeType == DescriptorRangeType::Cbv);
+        CHECK(table.pDescriptorRanges[1].baseShaderRegister == 1);
+        CHECK(table.pDescriptorRanges[1].offsetInDescriptorsFromTableStart == 4);
+        CHECK(desc.pParameters[3].descriptorTable.pDescriptorRanges[0].rangeType == DescriptorRangeType::Sampler);
+
+        // Everything is copied: the converted desc outlives the source.
+        CHECK(desc.pStaticSamplers != &signature.sampler);
+        CHECK(desc.pStaticSamplers[0].filter == 0x15);
+        CHECK(desc.pStaticSamplers[0].maxLOD == 1000.0f);
+        CHECK(static_cast<const void*>(table.pDescriptorRanges) != static_cast<const void*>(signature.ranges));
+        CHECK(downlevel.GetArenaSize() > 0);
+
+        // Converting again reuses the object.
+        downlevel.Convert(signature.desc.desc_1_1);
+        CHECK(downlevel.GetDesc().desc_1_0.numParameters == 4);
+    }
+
+    // Keys follow the contents, pointed-to arrays included, not where the
+    // arrays live.
+    void TestKeys()
+    {
+        const TestRootSignature a;
+        const TestRootSignature b;
+        std::vector<uint8_t> keyA;
+        std::vector<uint8_t> keyB;
+        AppendRootSignatureKey(a.desc, &keyA);
+        AppendRootSignatureKey(b.desc, &keyB);
+        CHECK(keyA == keyB);
+        CHECK(HashRootSignatureKey(keyA.data(), keyA.size()) == HashRootSignatureKey(keyB.data(), keyB.size()));
+
+        TestRootSignature c;
+        c.ranges[1].flags = 0;
+        std::vector<uint8_t> keyC;
+        AppendRootSignatureKey(c.desc, &keyC);
+        CHECK(keyA != keyC);
+
+        TestRootSignature d;
+        d.sampler.maxLOD = 8.0f;
+        std::vector<uint8_t> keyD;
+        AppendRootSignatureKey(d.desc, &keyD);
+        CHECK(keyA != keyD);
+
+        // Appends rather than replaces.
+        std::vector<uint8_t> twice;
+        AppendRootSignatureKey(a.desc, &twice);
+        AppendRootSignatureKey(a.desc, &twice);
+        CHECK(twice.size() == 2 * keyA.size());
+    }
+
+    void TestMemoization()
+    {
+        const TestRootSignature a;
+        const TestRootSignature same;
+        TestRootSignature different;
+        different.ranges[1].flags = 0;
+
+        FakeBackend backend;
+        RootSignatureSerializer serializer(RootSignatureVersion::Version1_0, backend.GetFunction());
+        std::string error;
+        const RootSignatureBlob first = serializer.Serialize(a.desc, &error);
+        const RootSignatureBlob second = serializer.Serialize(same.desc, &error);
+        const RootSignatureBlob third = serializer.Serialize(different.desc, &error);
+
+        // The range flags are dropped going to 1.0, but the cache is keyed
+        // by what was asked for, so the two descs are two entries.
+        CHECK(first && second && third);
+        CHECK(first == second);
+        CHECK(first != third);
+        CHECK(*first == *third);
+        CHECK(backend.calls == 2);
+        CHECK(serializer.GetBlobCount() == 2);
+
+        // The backend saw the 1.0 desc.
+        DownlevelRootSignature downlevel;
+        downlevel.Convert(a.desc.desc_1_1);
+        std::vector<uint8_t> key;
+        AppendRootSignatureKey(downlevel.GetDesc(), &key);
+        CHECK(*first == key);
+
+        const RootSignatureSerializerStats stats = serializer.GetStats();
+        CHECK(stats.requests == 3);
+        CHECK(stats.hits == 1);
+        CHECK(stats.conversions == 2);
+        CHECK(stats.serializations == 2);
+        CHECK(stats.collisions == 0);
+
+        // A backend that takes 1.1 gets the desc as it is.
+        FakeBackend backend11;
+        RootSignatureSerializer serializer11(RootSignatureVersion::Version1_1, backend11.GetFunction());
+        const RootSignatureBlob blob11 = serializer11.Serialize(a.desc, &error);
+        std::vector<uint8_t> key11;
+        AppendRootSignatureKey(a.desc, &key11);
+        CHECK(blob11 && *blob11 == key11);
+        CHECK(serializer11.GetStats().conversions == 0);
+    }
+
+    void TestFailuresNotCached()
+    {
+        TestRootSignature signature;
+        signature.desc.desc_1_1.numStaticSamplers = 0;
+
+        FakeBackend backend;
+        RootSignatureSerializer serializer(RootSignatureVersion::Version1_0, backend.GetFunction());
+        std::string error;
+        CHECK(!serializer.Serialize(signature.desc, &error));
+        CHECK(error == "no static samplers");
+        CHECK(!serializer.Serialize(signature.desc, &error));
+        CHECK(backend.calls == 2);
+        CHECK(serializer.GetBlobCount() == 0);
+    }
+
+    void TestThreads()
+    {
+        const TestRootSignature a;
+        TestRootSignature b;
+        b.parameters[0].constants.num32BitValues = 8;
+
+        FakeBackend backend;
+        RootSignatureSerializer serializer(RootSignatureVersion::Version1_0, backend.GetFunction());
+        std::vector<std::thread> threads;
+        std::vector<RootSignatureBlob> blobs(8 * 2);
+        for (int t = 0; t < 8; t++)
+        {
+            threads.emplace_back([&serializer, &a, &b, &blobs, t]()
+            {
+                std::string error;
+                for (int i = 0; i < 1000; i++)
+                {
+                    blobs[t * 2 + (i & 1)] = serializer.Serialize((i & 1) ? b.desc : a.desc, &error);
+                }
+            });
+        }
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+
+        CHECK(backend.calls == 2);
+        CHECK(serializer.GetStats().requests == 8000);
+        for (int t = 0; t < 8; t++)
+        {
+            CHECK(blobs[t * 2] == blobs[0]);
+            CHECK(blobs[t * 2 + 1] == blobs[1]);
+        }
+    }
+
+    // The fake backend costs next to nothing, so this is the overhead of a
+    // cache hit (key, hash, lock) next to converting and walking the desc;
+    // D3D12's own serializer takes far longer than either.
+    void BenchmarkCache()
+    {
+        const TestRootSignature signature;
+        FakeBackend backend;
+        const RootSignatureSerializer::Backend function = backend.GetFunction();
+        RootSignatureSerializer serializer(RootSignatureVersion::Version1_0, function);
+        std::string error;
+        const int iterations = 100000;
+
+        const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++)
+        {
+            DownlevelRootSignature downlevel;
+            downlevel.Convert(signature.desc.desc_1_1);
+            std::vector<uint8_t> blob;
+            function(downlevel.GetDesc(), &blob, &error);
+        }
+        const std::chrono::steady_clock::time_point uncached = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++)
+        {
+            CHECK(serializer.Serialize(signature.desc, &error) != nullptr);
+        }
+        const std::chrono::steady_clock::time_point cached = std::chrono::steady_clock::now();
+
+        printf("convert and fake serialize %.3f us, cache hit %.3f us\n",
+            std::chrono::duration<double, std::micro>(uncached - begin).count() / iterations,
+            std::chrono::duration<double, std::micro>(cached - uncached).count() / iterations);
+    }
+}
+
+int main()
+{
+    TestDownlevelConversion();
+    TestKeys();
+    TestMemoization();
+    TestFailuresNotCached();
+    TestThreads();
+    BenchmarkCache();
+    return TestFailures();
+}
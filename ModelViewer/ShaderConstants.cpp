@@ -0,0 +1,190 @@
+#include "ShaderConstants.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+    const RootParameterLayout& GetBindingParameter(const RootSignatureLayout& layout, SceneBinding binding)
+    {
+        return layout.parameters[layout.bindingParameters[binding]];
+    }
+
+    bool BindConstants(
+        RenderCommandList& commandList,
+        const RootSignatureLayout& layout,
+        SceneBinding binding,
+        ConstantBufferPool& constantBuffers,
+        const void* pData,
+        uint32_t size)
+    {
+        const uint32_t rootParameter = layout.bindingParameters[binding];
+        const RootParameterLayout& parameter = layout.parameters[rootParameter];
+        if (parameter.type == RootParameterType::Constants)
+        {
+            commandList.SetGraphicsRoot32BitConstants(rootParameter, parameter.num32BitValues, pData, 0);
+            return true;
+        }
+
+        uint64_t address = 0;
+        if (!constantBuffers.Push(pData, size, &address))
+        {
+            return false;
+        }
+        commandList.SetGraphicsRootConstantBufferView(rootParameter, address);
+        return true;
+    }
+
+    bool UploadBuffer(UploadRing& ring, uint8_t* pCpuBase, uint64_t gpuBaseAddress, const void* pData, size_t size, size_t elementSize, uint64_t* pGpuAddress)
+    {
+        uint64_t offset = 0;
+        if (!ring.Allocate(std::max(size, elementSize), elementSize, &offset))
+        {
+            return false;
+        }
+        if (size > 0)
+        {
+            memcpy(pCpuBase + offset, pData, size);
+        }
+        *pGpuAddress = gpuBaseAddress + offset;
+        return true;
+    }
+}
+
+const ShaderFeatureInfo SceneShaderFeatures[] =
+{
+    { SceneFeatureVertexColor, "VERTEX_COLOR" },
+    { SceneFeatureTexture, "TEXTURE" },
+    { SceneFeatureAlphaTest, "ALPHA_TEST" },
+};
+
+const size_t SceneShaderFeatureCount = sizeof(SceneShaderFeatures) / sizeof(SceneShaderFeatures[0]);
+
+void BuildSceneRootSignatureLayout(RootSignatureLayout* pLayout)
+{
+    RootSignatureBuilder builder;
+    builder.AddBuffer("Instances", 0, UpdateFrequency::PerDraw, BindingVisibility::Vertex);
+    builder.AddConstants("FrameConstants", 0, sizeof(FrameConstants), UpdateFrequency::PerFrame);
+    builder.AddConstants("ViewConstants", 1, sizeof(ViewConstants), UpdateFrequency::PerView);
+    builder.AddConstants("DrawConstants", 2, sizeof(DrawConstants), UpdateFrequency::PerDraw);
+    builder.AddBuffer("Lights", 1, UpdateFrequency::PerFrame, BindingVisibility::Pixel);
+    builder.AddBuffer("ClusterRanges", 2, UpdateFrequency::PerView, BindingVisibility::Pixel);
+    builder.AddBuffer("ClusterLightIndices", 3, UpdateFrequency::PerView, BindingVisibility::Pixel);
+    builder.AddConstants("ClusterConstants", 3, sizeof(ClusterConstants), UpdateFrequency::PerView, BindingVisibility::Pixel);
+
+    std::string error;
+    if (!builder.Build(RootSignatureOptions(), pLayout, &error))
+    {
+        throw std::runtime_error(error);
+    }
+
+    // Draw code only knows how to feed these forms.
+    if (GetBindingParameter(*pLayout, SceneBindingInstances).type != RootParameterType::ShaderResourceView ||
+        GetBindingParameter(*pLayout, SceneBindingDrawConstants).type == RootParameterType::DescriptorTable ||
+        GetBindingParameter(*pLayout, SceneBindingLights).type != RootParameterType::ShaderResourceView ||
+        GetBindingParameter(*pLayout, SceneBindingClusterRanges).type != RootParameterType::ShaderResourceView ||
+        GetBindingParameter(*pLayout, SceneBindingLightIndices).type != RootParameterType::ShaderResourceView)
+    {
+        throw std::runtime_error("Scene bindings need root descriptors or root constants");
+    }
+}
+
+IndirectCommandLayout MakeSceneIndirectLayout(const RootSignatureLayout& layout)
+{
+    const RootParameterLayout& drawParameter = GetBindingParameter(layout, SceneBindingDrawConstants);
+    return IndirectDrawGenerator::MakeInstancedLayout(
+        layout.bindingParameters[SceneBindingInstances],
+        layout.bindingParameters[SceneBindingDrawConstants],
+        drawParameter.type == RootParameterType::Constants ? drawParameter.num32BitValues : 0);
+}
+
+void BuildDrawConstants(const std::vector<DrawBatch>& batches, std::vector<DrawConstants>* pDrawConstants)
+{
+    pDrawConstants->resize(batches.size());
+    for (size_t i = 0; i < batches.size(); i++)
+    {
+        const DrawBatch& batch = batches[i];
+        DrawConstants& drawConstants = (*pDrawConstants)[i];
+        drawConstants.materialId = batch.materialId;
+        drawConstants.meshId = batch.meshId;
+        drawConstants.instanceCount = batch.instanceCount;
+        drawConstants.padding = 0;
+    }
+}
+
+void BuildClusterConstants(const ClusterLightAssigner& assigner, uint32_t lightCount, ClusterConstants* pConstants)
+{
+    const ClusterGridSettings& settings = assigner.GetSettings();
+    *pConstants = {};
+    pConstants->clusterCounts[0] = settings.tilesX;
+    pConstants->clusterCounts[1] = settings.tilesY;
+    pConstants->clusterCounts[2] = settings.slices;
+    pConstants->lightCount = lightCount;
+    pConstants->sliceScale = assigner.GetSliceScale();
+    pConstants->sliceBias = assigner.GetSliceBias();
+    pConstants->farZ = settings.farZ;
+}
+
+bool UploadSceneLights(
+    UploadRing& ring,
+    uint8_t* pCpuBase,
+    uint64_t gpuBaseAddress,
+    const std::vector<PointLight>& lights,
+    const ClusterLightAssigner& assigner,
+    SceneLightBuffers* pBuffers)
+{
+    const std::vector<ClusterRange>& ranges = assigner.GetRanges();
+    const std::vector<uint32_t>& indices = assigner.GetLightIndices();
+    return
+        UploadBuffer(ring, pCpuBase, gpuBaseAddress, lights.data(), lights.size() * sizeof(PointLight), sizeof(PointLight), &pBuffers->lightsAddress) &&
+        UploadBuffer(ring, pCpuBase, gpuBaseAddress, ranges.data(), ranges.size() * sizeof(ClusterRange), sizeof(ClusterRange), &pBuffers->clusterRangesAddress) &&
+        UploadBuffer(ring, pCpuBase, gpuBaseAddress, indices.data(), indices.size() * sizeof(uint32_t), sizeof(uint32_t), &pBuffers->lightIndicesAddress);
+}
+
+bool BindSceneConstants(
+    RenderCommandList& commandList,
+    const RootSignatureLayout& layout,
+    ConstantBufferPool& constantBuffers,
+    const FrameConstants& frameConstants,
+    const ViewConstants& viewConstants,
+    const std::vector<DrawConstants>& drawConstants,
+    uint64_t instanceAddress,
+    BatchRootBindings* pBindings)
+{
+    if (!BindConstants(commandList, layout, SceneBindingFrameConstants, constantBuffers, &frameConstants, sizeof(frameConstants)) ||
+        !BindConstants(commandList, layout, SceneBindingViewConstants, constantBuffers, &viewConstants, sizeof(viewConstants)))
+    {
+        return false;
+    }
+
+    *pBindings = {};
+    pBindings->instanceRootParameter = layout.bindingParameters[SceneBindingInstances];
+    pBindings->instanceAddress = instanceAddress;
+    pBindings->instanceStride = sizeof(InstanceData);
+    pBindings->drawConstantsRootParameter = layout.bindingParameters[SceneBindingDrawConstants];
+
+    const RootParameterLayout& drawParameter = GetBindingParameter(layout, SceneBindingDrawConstants);
+    if (drawParameter.type == RootParameterType::Constants)
+    {
+        pBindings->pDrawRootConstants = reinterpret_cast<const uint32_t*>(drawConstants.data());
+        pBindings->drawRootConstantCount = drawParameter.num32BitValues;
+        return true;
+    }
+
+    pBindings->drawConstantsStride = AlignConstantBufferSize(sizeof(DrawConstants));
+    return constantBuffers.PushArray(drawConstants.data(), static_cast<uint32_t>(drawConstants.size()), &pBindings->drawConstantsAddress);
+}
+
+bool BindSceneLights(
+    RenderCommandList& commandList,
+    const RootSignatureLayout& layout,
+    ConstantBufferPool& constantBuffers,
+    const ClusterConstants& clusterConstants,
+    const SceneLightBuffers& buffers)
+{
+    commandList.SetGraphicsRootShaderResourceView(layout.bindingParameters[SceneBindingLights], buffers.lightsAddress);
+    commandList.SetGraphicsRootShaderResourceView(layout.bindingParameters[SceneBindingClusterRanges], buffers.clusterRangesAddress);
+    commandList.SetGraphicsRootShaderResourceView(layout.bindingParameters[SceneBindingLightIndices], buffers.lightIndicesAddress);
+    return BindConstants(commandList, layout, SceneBindingClusterConstants, constantBuffers, &clusterConstants, sizeof(clusterConstants));
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "ClusteredLights.h"
+#include "ConstantBufferPool.h"
+#include "RenderDevice.h"
+#include "RootSignatureLayout.h"
+#include "ShaderPermutations.h"
+#include "UploadRing.h"
+
+#include <cstdint>
+#include <vector>
+
+// Bindings of the scene shaders and the constant buffer layouts shaders.hlsl
+// declares for them. Where each binding goes in the root signature is up to
+// RootSignatureBuilder: constants are either inline root constants or root
+// CBVs pointing into the upload ring, see ConstantBufferPool; no descriptor
+// is ever created for them. Layouts follow HLSL packing: no member crosses a
+// 16-byte boundary.
+enum SceneBinding : uint32_t
+{
+    SceneBindingInstances,          // t0, InstanceData of the batch.
+    SceneBindingFrameConstants,     // b0, FrameConstants.
+    SceneBindingViewConstants,      // b1, ViewConstants.
+    SceneBindingDrawConstants,      // b2, DrawConstants of the batch.
+    SceneBindingLights,             // t1, PointLight of the frame.
+    SceneBindingClusterRanges,      // t2, ClusterRange of each cluster of the view.
+    SceneBindingLightIndices,       // t3, the clusters' light lists, see ClusterLightAssigner.
+    SceneBindingClusterConstants,   // b3, ClusterConstants.
+    SceneBindingCount,
+};
+
+// Optional features of the scene shaders; materials ask for a mask of them.
+enum SceneShaderFeature : ShaderFeatureMask
+{
+    SceneFeatureVertexColor = 1 << 0,   // VERTEX_COLOR
+    SceneFeatureTexture = 1 << 1,       // TEXTURE: samples the material's streamed texture.
+    SceneFeatureAlphaTest = 1 << 2,     // ALPHA_TEST
+};
+
+static const ShaderFeatureMask SceneShaderFeatureMask = SceneFeatureVertexColor | SceneFeatureTexture | SceneFeatureAlphaTest;
+
+extern const ShaderFeatureInfo SceneShaderFeatures[];
+extern const size_t SceneShaderFeatureCount;
+
+// Once per frame.
+struct FrameConstants
+{
+    float timeSeconds;
+    float deltaSeconds;
+    uint32_t frameNumber;
+    uint32_t padding;
+};
+
+// Once per view rendered in the frame.
+struct ViewConstants
+{
+    float viewProjection[16];
+    float viewportSize[2];
+    float inverseViewportSize[2];
+};
+
+// Once per view, for clustered lighting. A pixel's cluster is its tile,
+// SV_Position.xy * inverseViewportSize * clusterCounts.xy, and its slice,
+// log(SV_Position.w) * sliceScale + sliceBias; w is the view depth.
+struct ClusterConstants
+{
+    uint32_t clusterCounts[3];      // Tiles across, tiles down, depth slices.
+    uint32_t lightCount;
+    float sliceScale;
+    float sliceBias;
+    float farZ;                     // No light reaches past it.
+    uint32_t padding;
+};
+
+// Once per draw batch.
+struct DrawConstants
+{
+    uint32_t materialId;
+    uint32_t meshId;
+    uint32_t instanceCount;
+    uint32_t padding;
+};
+
+// Declares the bindings above, in order. Throws std::runtime_error when they
+// do not fit a root signature.
+void BuildSceneRootSignatureLayout(RootSignatureLayout* pLayout);
+
+// The indirect command layout matching the scene root signature.
+IndirectCommandLayout MakeSceneIndirectLayout(const RootSignatureLayout& layout);
+
+void BuildDrawConstants(const std::vector<DrawBatch>& batches, std::vector<DrawConstants>* pDrawConstants);
+
+void BuildClusterConstants(const ClusterLightAssigner& assigner, uint32_t lightCount, ClusterConstants* pConstants);
+
+// Where UploadSceneLights() put the buffers.
+struct SceneLightBuffers
+{
+    uint64_t lightsAddress;
+    uint64_t clusterRangesAddress;
+    uint64_t lightIndicesAddress;
+};
+
+// Copies the lights and the lists assigner built from them into the upload
+// ring, whose buffer starts at pCpuBase and gpuBaseAddress. Empty buffers
+// still get an element, so the root SRVs never point nowhere. False when
+// the ring is full.
+bool UploadSceneLights(
+    UploadRing& ring,
+    uint8_t* pCpuBase,
+    uint64_t gpuBaseAddress,
+    const std::vector<PointLight>& lights,
+    const ClusterLightAssigner& assigner,
+    SceneLightBuffers* pBuffers);
+
+// Binds frame and view constants on the command list and fills the root
+// bindings of the batches, writing to the pool whatever the layout binds
+// through a root CBV. The scene root signature must be set. False when the
+// pool is full.
+bool BindSceneConstants(
+    RenderCommandList& commandList,
+    const RootSignatureLayout& layout,
+    ConstantBufferPool& constantBuffers,
+    const FrameConstants& frameConstants,
+    const ViewConstants& viewConstants,
+    const std::vector<DrawConstants>& drawConstants,
+    uint64_t instanceAddress,
+    BatchRootBindings* pBindings);
+
+// Binds the buffers of UploadSceneLights() and the cluster constants. The
+// scene root signature must be set. False when the pool is full.
+bool BindSceneLights(
+    RenderCommandList& commandList,
+    const RootSignatureLayout& layout,
+    ConstantBufferPool& constantBuffers,
+    const ClusterConstants& clusterConstants,
+    const SceneLightBuffers& buffers);
@@ -0,0 +1,226 @@
+#include "ShaderContainer.h"
+
+#include <cstring>
+
+namespace
+{
+    // 'DXBC', digest[16], uint16 major, uint16 minor, uint32 size, uint32 partCount.
+    const size_t ContainerHeaderSize = 32;
+
+    // Each part: uint32 fourCC, uint32 size, then the data.
+    const size_t PartHeaderSize = 8;
+
+    // Mirrors PSVResourceType in DxilPipelineStateValidation.h.
+    enum PsvResourceType : uint32_t
+    {
+        PsvInvalid,
+        PsvSampler,
+        PsvCbv,
+        PsvSrvTyped,
+        PsvSrvRaw,
+        PsvSrvStructured,
+        PsvUavTyped,
+        PsvUavRaw,
+        PsvUavStructured,
+        PsvUavStructuredWithCounter,
+    };
+
+    uint32_t ReadUint32(const uint8_t* pData)
+    {
+        uint32_t value;
+        memcpy(&value, pData, sizeof(value));
+        return value;
+    }
+
+    bool GetResourceClass(uint32_t resourceType, ShaderResourceClass* pClass)
+    {
+        switch (resourceType)
+        {
+        case PsvSampler:
+            *pClass = ShaderResourceClass::Sampler;
+            return true;
+        case PsvCbv:
+            *pClass = ShaderResourceClass::Cbv;
+            return true;
+        case PsvSrvTyped:
+        case PsvSrvRaw:
+        case PsvSrvStructured:
+            *pClass = ShaderResourceClass::Srv;
+            return true;
+        case PsvUavTyped:
+        case PsvUavRaw:
+        case PsvUavStructured:
+        case PsvUavStructuredWithCounter:
+            *pClass = ShaderResourceClass::Uav;
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // uint32 runtimeInfoSize, runtime info, uint32 resourceCount, then when
+    // there are resources uint32 bindInfoSize and the bind infos, each
+    // starting with type, space, lower bound and upper bound.
+    bool ReadPipelineStateValidation(const uint8_t* pData, uint32_t size, std::vector<ShaderResourceBinding>* pBindings, std::string* pError)
+    {
+        if (size < 4)
+        {
+            *pError = "PSV0 part too small";
+            return false;
+        }
+        const uint32_t runtimeInfoSize = ReadUint32(pData);
+        uint64_t offset = 4 + static_cast<uint64_t>(runtimeInfoSize);
+        if (offset + 4 > size)
+        {
+            *pError = "PSV0 part too small for its runtime info";
+            return false;
+        }
+
+        const uint32_t resourceCount = ReadUint32(pData + offset);
+        offset += 4;
+        if (resourceCount == 0)
+        {
+            return true;
+        }
+        if (offset + 4 > size)
+        {
+            *pError = "PSV0 part too small for its resources";
+            return false;
+        }
+
+        const uint32_t bindInfoSize = ReadUint32(pData + offset);
+        offset += 4;
+        if (bindInfoSize < 16 || offset + static_cast<uint64_t>(resourceCount) * bindInfoSize > size)
+        {
+            *pError = "PSV0 resource list does not fit the part";
+            return false;
+        }
+
+        for (uint32_t i = 0; i < resourceCount; i++)
+        {
+            const uint8_t* pBindInfo = pData + offset + static_cast<uint64_t>(i) * bindInfoSize;
+            ShaderResourceBinding binding;
+            if (!GetResourceClass(ReadUint32(pBindInfo), &binding.resourceClass))
+            {
+                continue;
+            }
+            binding.space = ReadUint32(pBindInfo + 4);
+            binding.lowerBound = ReadUint32(pBindInfo + 8);
+            binding.upperBound = ReadUint32(pBindInfo + 12);
+            pBindings->push_back(binding);
+        }
+        return true;
+    }
+
+    ShaderResourceClass GetDeclaredClass(BindingKind kind)
+    {
+        switch (kind)
+        {
+        case BindingKind::Constants:
+        case BindingKind::ConstantBuffer:
+            return ShaderResourceClass::Cbv;
+        case BindingKind::RWBuffer:
+        case BindingKind::RWTexture:
+            return ShaderResourceClass::Uav;
+        case BindingKind::Sampler:
+            return ShaderResourceClass::Sampler;
+        default:
+            return ShaderResourceClass::Srv;
+        }
+    }
+
+    bool IsRegisterDeclared(ShaderResourceClass resourceClass, uint32_t space, uint32_t shaderRegister, const RootSignatureLayout& layout)
+    {
+        for (const BindingDecl& decl : layout.bindings)
+        {
+            if (GetDeclaredClass(decl.kind) == resourceClass &&
+                decl.registerSpace == space &&
+                shaderRegister >= decl.shaderRegister &&
+                shaderRegister - decl.shaderRegister < decl.descriptorCount)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+bool ReadShaderContainer(const uint8_t* pData, size_t size, ShaderContainerInfo* pInfo, std::string* pError)
+{
+    pInfo->parts.clear();
+    pInfo->bindings.clear();
+    pInfo->hasDxil = false;
+    pInfo->hasBindings = false;
+
+    if (size < ContainerHeaderSize || ReadUint32(pData) != MakeFourCC('D', 'X', 'B', 'C'))
+    {
+        *pError = "Not a shader container";
+        return false;
+    }
+
+    const uint32_t containerSize = ReadUint32(pData + 24);
+    const uint32_t partCount = ReadUint32(pData + 28);
+    if (containerSize > size || ContainerHeaderSize + static_cast<uint64_t>(partCount) * 4 > containerSize)
+    {
+        *pError = "Shader container is truncated";
+        return false;
+    }
+
+    for (uint32_t i = 0; i < partCount; i++)
+    {
+        const uint32_t partOffset = ReadUint32(pData + ContainerHeaderSize + i * 4);
+        if (static_cast<uint64_t>(partOffset) + PartHeaderSize > containerSize)
+        {
+            *pError = "Shader container part out of bounds";
+            return false;
+        }
+
+        ShaderContainerPart part;
+        part.fourCC = ReadUint32(pData + partOffset);
+        part.size = ReadUint32(pData + partOffset + 4);
+        part.offset = partOffset + static_cast<uint32_t>(PartHeaderSize);
+        if (static_cast<uint64_t>(part.offset) + part.size > containerSize)
+        {
+            *pError = "Shader container part out of bounds";
+            return false;
+        }
+        pInfo->parts.push_back(part);
+
+        if (part.fourCC == MakeFourCC('D', 'X', 'I', 'L'))
+        {
+            pInfo->hasDxil = true;
+        }
+        else if (part.fourCC == MakeFourCC('P', 'S', 'V', '0'))
+        {
+            if (!ReadPipelineStateValidation(pData + part.offset, part.size, &pInfo->bindings, pError))
+            {
+                return false;
+            }
+            pInfo->hasBindings = true;
+        }
+    }
+    return true;
+}
+
+bool CheckShaderBindings(const ShaderResourceBinding* pBindings, size_t count, const RootSignatureLayout& layout, std::string* pError)
+{
+    static const char* const ClassNames[] = { "s", "b", "t", "u" };
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const ShaderResourceBinding& binding = pBindings[i];
+
+        // Unbounded arrays are checked at their first register only.
+        const uint32_t upperBound = binding.upperBound == UINT32_MAX ? binding.lowerBound : binding.upperBound;
+        for (uint32_t shaderRegister = binding.lowerBound; shaderRegister <= upperBound; shaderRegister++)
+        {
+            if (!IsRegisterDeclared(binding.resourceClass, binding.space, shaderRegister, layout))
+            {
+                *pError = std::string("Shader binds ") + ClassNames[static_cast<uint32_t>(binding.resourceClass)] +
+                    std::to_string(shaderRegister) + ", space" + std::to_string(binding.space) + ", which the root signature does not declare";
+                return false;
+            }
+        }
+    }
+    return true;
+}
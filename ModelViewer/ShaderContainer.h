@@ -0,0 +1,59 @@
+#pragma once
+
+#include "RootSignatureLayout.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Reads the DXBC/DXIL container compiled shaders come in. DXC keeps the
+// pipeline state validation part (PSV0) in DXIL containers; it lists the
+// resource ranges the shader binds, which is the reflection the renderer
+// needs to check a shader against a root signature without the compiler.
+
+enum class ShaderResourceClass : uint32_t
+{
+    Sampler,
+    Cbv,
+    Srv,
+    Uav,
+};
+
+struct ShaderResourceBinding
+{
+    ShaderResourceClass resourceClass;
+    uint32_t space;
+    uint32_t lowerBound;
+    uint32_t upperBound;    // Inclusive; UINT32_MAX for unbounded arrays.
+};
+
+struct ShaderContainerPart
+{
+    uint32_t fourCC;
+    uint32_t offset;        // Of the part data, from the start of the container.
+    uint32_t size;
+};
+
+struct ShaderContainerInfo
+{
+    std::vector<ShaderContainerPart> parts;
+    bool hasDxil;                                   // A DXIL program part; FXC output has SHEX/SHDR instead.
+    bool hasBindings;                               // A PSV0 part was found and read.
+    std::vector<ShaderResourceBinding> bindings;
+};
+
+inline uint32_t MakeFourCC(char a, char b, char c, char d)
+{
+    return static_cast<uint32_t>(static_cast<uint8_t>(a)) |
+        (static_cast<uint32_t>(static_cast<uint8_t>(b)) << 8) |
+        (static_cast<uint32_t>(static_cast<uint8_t>(c)) << 16) |
+        (static_cast<uint32_t>(static_cast<uint8_t>(d)) << 24);
+}
+
+// False with a message when the data is not a well-formed container.
+bool ReadShaderContainer(const uint8_t* pData, size_t size, ShaderContainerInfo* pInfo, std::string* pError);
+
+// Every register the shader binds must be declared in the layout, in the
+// same space and of the same class. False with the first one missing.
+bool CheckShaderBindings(const ShaderResourceBinding* pBindings, size_t count, const RootSignatureLayout& layout, std::string* pError);
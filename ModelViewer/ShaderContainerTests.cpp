@@ -0,0 +1,272 @@
+#include "EmbeddedShaders.h"
+#include "ShaderConstants.h"
+#include "ShaderContainer.h"
+#include "UnitTest.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+    // Builds containers the way DXC and FXC lay them out: the header, the
+    // part offsets, then each part's fourCC, size and data.
+    class ContainerBuilder
+    {
+    public: void AddPart(uint32_t fourCC, const std::vector<uint8_t>& data)
+        {
+            _parts.push_back(Part{ fourCC, data });
+        }
+
+    public: std::vector<uint8_t> Build() const
+        {
+            std::vector<uint8_t> container(32 + _parts.size() * 4, 0);
+            Write(&container, 0, MakeFourCC('D', 'X', 'B', 'C'));
+            Write(&container, 20, 0x00000001u);    // Version 1.0.
+            Write(&container, 28, static_cast<uint32_t>(_parts.size()));
+            for (size_t i = 0; i < _parts.size(); i++)
+            {
+                Write(&container, 32 + i * 4, static_cast<uint32_t>(container.size()));
+                const size_t header = container.size();
+                container.resize(header + 8);
+                Write(&container, header, _parts[i].fourCC);
+                Write(&container, header + 4, static_cast<uint32_t>(_parts[i].data.size()));
+                container.insert(container.end(), _parts[i].data.begin(), _parts[i].data.end());
+            }
+            Write(&container, 24, static_cast<uint32_t>(container.size()));
+            return container;
+        }
+
+    public: static void Write(std::vector<uint8_t>* pData, size_t offset, uint32_t value)
+        {
+            memcpy(pData->data() + offset, &value, sizeof(value));
+        }
+
+    public: static void Append(std::vector<uint8_t>* pData, uint32_t value)
+        {
+            pData->resize(pData->size() + 4);
+            Write(pData, pData->size() - 4, value);
+        }
+
+    private: struct Part
+        {
+            uint32_t fourCC;
+            std::vector<uint8_t> data;
+        };
+
+    private: std::vector<Part> _parts;
+    };
+
+    struct PsvResource
+    {
+        uint32_t type;      // PSVResourceType: 1 sampler, 2 CBV, 3-5 SRV, 6-9 UAV.
+        uint32_t space;
+        uint32_t lowerBound;
+        uint32_t upperBound;
+    };
+
+    // A PSV0 part: runtime info, resource count, bind info size and the bind
+    // infos. Newer validator versions add fields after the first four, so
+    // bindInfoSize can be larger than 16.
+    std::vector<uint8_t> MakePipelineStateValidation(const std::vector<PsvResource>& resources, uint32_t bindInfoSize = 16)
+    {
+        std::vector<uint8_t> data;
+        ContainerBuilder::Append(&data, 24);
+        data.resize(data.size() + 24, 0xee);
+        ContainerBuilder::Append(&data, static_cast<uint32_t>(resources.size()));
+        if (resources.empty())
+        {
+            return data;
+        }
+        ContainerBuilder::Append(&data, bindInfoSize);
+        for (const PsvResource& resource : resources)
+        {
+            const size_t start = data.size();
+            ContainerBuilder::Append(&data, resource.type);
+            ContainerBuilder::Append(&data, resource.space);
+            ContainerBuilder::Append(&data, resource.lowerBound);
+            ContainerBuilder::Append(&data, resource.upperBound);
+            data.resize(start + bindInfoSize, 0xff);
+        }
+        return data;
+    }
+
+    const uint32_t Dxil = MakeFourCC('D', 'X', 'I', 'L');
+    const uint32_t Psv0 = MakeFourCC('P', 'S', 'V', '0');
+
+    // Parts come back in order with their offsets and sizes; DXIL and PSV0
+    // are recognized, the resource types map to their register classes.
+    void TestDxilContainer()
+    {
+        const std::vector<uint8_t> program(40, 0x42);
+        ContainerBuilder builder;
+        builder.AddPart(MakeFourCC('S', 'F', 'I', '0'), std::vector<uint8_t>(8, 0));
+        builder.AddPart(Psv0, MakePipelineStateValidation({
+            { 2, 0, 0, 1 },
+            { 5, 0, 3, 3 },
+            { 0, 0, 9, 9 },
+            { 1, 2, 0, 0 },
+            { 9, 1, 4, UINT32_MAX },
+        }, 24));
+        builder.AddPart(Dxil, program);
+        const std::vector<uint8_t> container = builder.Build();
+
+        ShaderContainerInfo info;
+        std::string error;
+        CHECK(ReadShaderContainer(container.data(), container.size(), &info, &error));
+        CHECK(info.hasDxil);
+        CHECK(info.hasBindings);
+        CHECK(info.parts.size() == 3);
+        CHECK(info.parts[0].fourCC == MakeFourCC('S', 'F', 'I', '0') && info.parts[0].size == 8);
+        CHECK(info.parts[0].offset == 32 + 3 * 4 + 8);
+        CHECK(info.parts[2].fourCC == Dxil && info.parts[2].size == 40);
+        CHECK(memcmp(container.data() + info.parts[2].offset, program.data(), program.size()) == 0);
+
+        // The invalid resource is skipped.
+        CHECK(info.bindings.size() == 4);
+        CHECK(info.bindings[0].resourceClass == ShaderResourceClass::Cbv && info.bindings[0].lowerBound == 0 && info.bindings[0].upperBound == 1);
+        CHECK(info.bindings[1].resourceClass == ShaderResourceClass::Srv && info.bindings[1].lowerBound == 3);
+        CHECK(info.bindings[2].resourceClass == ShaderResourceClass::Sampler && info.bindings[2].space == 2);
+        CHECK(info.bindings[3].resourceClass == ShaderResourceClass::Uav && info.bindings[3].upperBound == UINT32_MAX);
+
+        // A shader without resources still has a PSV0 part.
+        ContainerBuilder empty;
+        empty.AddPart(Dxil, program);
+        empty.AddPart(Psv0, MakePipelineStateValidation({}));
+        const std::vector<uint8_t> emptyContainer = empty.Build();
+        CHECK(ReadShaderContainer(emptyContainer.data(), emptyContainer.size(), &info, &error));
+        CHECK(info.hasDxil && info.hasBindings && info.bindings.empty());
+    }
+
+    // FXC output has SHEX and no PSV0: it reads, but has neither.
+    void TestDxbcContainer()
+    {
+        ContainerBuilder builder;
+        builder.AddPart(MakeFourCC('R', 'D', 'E', 'F'), std::vector<uint8_t>(28, 0));
+        builder.AddPart(MakeFourCC('S', 'H', 'E', 'X'), std::vector<uint8_t>(64, 0));
+        const std::vector<uint8_t> container = builder.Build();
+
+        ShaderContainerInfo info;
+        std::string error;
+        CHECK(ReadShaderContainer(container.data(), container.size(), &info, &error));
+        CHECK(info.parts.size() == 2);
+        CHECK(!info.hasDxil);
+        CHECK(!info.hasBindings);
+    }
+
+    bool Rejects(const std::vector<uint8_t>& data)
+    {
+        ShaderContainerInfo info;
+        std::string error;
+        return !ReadShaderContainer(data.data(), data.size(), &info, &error) && !error.empty();
+    }
+
+    // Anything pointing past the data is an error, not a read out of bounds.
+    void TestMalformed()
+    {
+        ContainerBuilder builder;
+        builder.AddPart(Dxil, std::vector<uint8_t>(16, 0));
+        builder.AddPart(Psv0, MakePipelineStateValidation({ { 2, 0, 0, 0 } }));
+        const std::vector<uint8_t> good = builder.Build();
+        CHECK(!Rejects(good));
+
+        CHECK(Rejects(std::vector<uint8_t>(good.begin(), good.begin() + 16)));
+
+        std::vector<uint8_t> badMagic = good;
+        badMagic[0] = 'X';
+        CHECK(Rejects(badMagic));
+
+        // Claims more than there is.
+        std::vector<uint8_t> truncated(good.begin(), good.end() - 4);
+        CHECK(Rejects(truncated));
+
+        std::vector<uint8_t> tooManyParts = good;
+        ContainerBuilder::Write(&tooManyParts, 28, 1000);
+        CHECK(Rejects(tooManyParts));
+
+        std::vector<uint8_t> partOffset = good;
+        ContainerBuilder::Write(&partOffset, 32, static_cast<uint32_t>(good.size()));
+        CHECK(Rejects(partOffset));
+
+        std::vector<uint8_t> partSize = good;
+        ContainerBuilder::Write(&partSize, 32 + 2 * 4 + 4, 0x10000);
+        CHECK(Rejects(partSize));
+
+        // PSV0 resource lists that do not fit their part.
+        ContainerBuilder bigRuntimeInfo;
+        std::vector<uint8_t> psv = MakePipelineStateValidation({ { 2, 0, 0, 0 } });
+        ContainerBuilder::Write(&psv, 0, 1000);
+        bigRuntimeInfo.AddPart(Psv0, psv);
+        CHECK(Rejects(bigRuntimeInfo.Build()));
+
+        ContainerBuilder shortBindInfo;
+        psv = MakePipelineStateValidation({ { 2, 0, 0, 0 } });
+        ContainerBuilder::Write(&psv, 4 + 24 + 4, 8);
+        shortBindInfo.AddPart(Psv0, psv);
+        CHECK(Rejects(shortBindInfo.Build()));
+
+        ContainerBuilder manyResources;
+        psv = MakePipelineStateValidation({ { 2, 0, 0, 0 } });
+        ContainerBuilder::Write(&psv, 4 + 24, 3);
+        manyResources.AddPart(Psv0, psv);
+        CHECK(Rejects(manyResources.Build()));
+    }
+
+    // Against the scene root signature: every register the shaders bind is
+    // declared; anything else is named in the error.
+    void TestCheckBindings()
+    {
+        RootSignatureLayout layout;
+        BuildSceneRootSignatureLayout(&layout);
+        std::string error;
+
+        const ShaderResourceBinding scene[] =
+        {
+            { ShaderResourceClass::Cbv, 0, 0, 3 },
+            { ShaderResourceClass::Srv, 0, 0, 3 },
+        };
+        CHECK(CheckShaderBindings(scene, 2, layout, &error));
+
+        // Unbounded arrays only need their first register.
+        const ShaderResourceBinding unbounded = { ShaderResourceClass::Srv, 0, 2, UINT32_MAX };
+        CHECK(CheckShaderBindings(&unbounded, 1, layout, &error));
+
+        const ShaderResourceBinding pastEnd = { ShaderResourceClass::Srv, 0, 3, 4 };
+        CHECK(!CheckShaderBindings(&pastEnd, 1, layout, &error));
+        CHECK(error == "Shader binds t4, space0, which the root signature does not declare");
+
+        const ShaderResourceBinding uav = { ShaderResourceClass::Uav, 0, 0, 0 };
+        CHECK(!CheckShaderBindings(&uav, 1, layout, &error));
+        CHECK(error.find("u0") != std::string::npos);
+
+        const ShaderResourceBinding otherSpace = { ShaderResourceClass::Cbv, 1, 0, 0 };
+        CHECK(!CheckShaderBindings(&otherSpace, 1, layout, &error));
+        CHECK(error.find("b0, space1") != std::string::npos);
+    }
+
+    // Without dxc nothing is embedded; the table must still answer.
+    void TestEmbeddedTable()
+    {
+        RootSignatureLayout layout;
+        BuildSceneRootSignatureLayout(&layout);
+        std::string error;
+        CHECK(CheckEmbeddedShaders(layout, &error));
+
+        for (size_t i = 0; i < GetEmbeddedShaderVariantCount(); i++)
+        {
+            const EmbeddedShaderVariant& variant = GetEmbeddedShaderVariant(i);
+            CHECK(FindEmbeddedShaderVariant(variant.features) == &variant);
+        }
+        CHECK(FindEmbeddedShaderVariant(0x80000000) == nullptr);
+    }
+}
+
+int main()
+{
+    TestDxilContainer();
+    TestDxbcContainer();
+    TestMalformed();
+    TestCheckBindings();
+    TestEmbeddedTable();
+    return TestFailures();
+}
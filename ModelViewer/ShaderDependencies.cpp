@@ -0,0 +1,99 @@
+#include "ShaderDependencies.h"
+
+ShaderDependencyGraph::ShaderDependencyGraph() :
+    _revision(0)
+{
+}
+
+void ShaderDependencyGraph::Record(const ShaderPermutationKey& key, const std::vector<std::string>& inputs)
+{
+    std::vector<std::string>& recorded = _inputs[key];
+    for (const std::string& file : recorded)
+    {
+        _readers[file].erase(key);
+    }
+
+    recorded = inputs;
+    for (const std::string& file : recorded)
+    {
+        KeySet& readers = _readers[file];
+        if (readers.empty())
+        {
+            _revision++;
+        }
+        readers.insert(key);
+    }
+}
+
+void ShaderDependencyGraph::GetAffected(const std::vector<std::string>& changedFiles, std::vector<ShaderPermutationKey>* pKeys) const
+{
+    KeySet affected;
+    for (const std::string& file : changedFiles)
+    {
+        auto found = _readers.find(file);
+        if (found == _readers.end())
+        {
+            continue;
+        }
+        for (const ShaderPermutationKey& key : found->second)
+        {
+            if (affected.insert(key).second)
+            {
+                pKeys->push_back(key);
+            }
+        }
+    }
+}
+
+void ShaderDependencyGraph::GetFiles(std::vector<std::string>* pFiles) const
+{
+    for (const auto& readers : _readers)
+    {
+        if (!readers.second.empty())
+        {
+            pFiles->push_back(readers.first);
+        }
+    }
+}
+
+uint64_t MakeFileStamp(uint64_t writeTime, uint64_t size)
+{
+    const uint64_t stamp = writeTime ^ (size * 0x100000001b3ull);
+    return stamp != 0 ? stamp : 1;
+}
+
+SourceChangeDetector::SourceChangeDetector(FileStampFunction stamp) :
+    _stamp(stamp)
+{
+}
+
+void SourceChangeDetector::Track(const std::vector<std::string>& files)
+{
+    for (const std::string& file : files)
+    {
+        if (_stamps.find(file) == _stamps.end())
+        {
+            uint64_t stamp = 0;
+            _stamps[file] = _stamp(file, &stamp) ? stamp : 0;
+        }
+    }
+}
+
+void SourceChangeDetector::Detect(std::vector<std::string>* pChanged)
+{
+    for (auto& tracked : _stamps)
+    {
+        uint64_t stamp = 0;
+        if (!_stamp(tracked.first, &stamp))
+        {
+            stamp = 0;
+        }
+        if (stamp != tracked.second)
+        {
+            // Editors often save by deleting and renaming; the file comes
+            // back with a new stamp, which is reported as a second change.
+            tracked.second = stamp;
+            pChanged->push_back(tracked.first);
+        }
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "ShaderPermutations.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// The source files each compiled variant read: its root file and everything
+// it includes, transitively. An edit to any of them makes the variant stale.
+// Paths are compared as given, so the compiler must spell them the same way
+// every time. Not thread-safe.
+class ShaderDependencyGraph
+{
+public: ShaderDependencyGraph();
+
+    // Replaces what the variant read before; the includes can change with an edit.
+public: void Record(const ShaderPermutationKey& key, const std::vector<std::string>& inputs);
+
+    // Appends the variants that read any of the files, each once.
+public: void GetAffected(const std::vector<std::string>& changedFiles, std::vector<ShaderPermutationKey>* pKeys) const;
+
+    // Every file some variant read.
+public: void GetFiles(std::vector<std::string>* pFiles) const;
+
+    // Changes whenever a file is read by a variant for the first time.
+public: uint64_t GetRevision() const { return _revision; }
+
+private: typedef std::unordered_set<ShaderPermutationKey, ShaderPermutationKeyHash> KeySet;
+
+private: std::unordered_map<ShaderPermutationKey, std::vector<std::string>, ShaderPermutationKeyHash> _inputs;
+private: std::unordered_map<std::string, KeySet> _readers;
+private: uint64_t _revision;
+};
+
+// Modification stamp of a file, its write time and size folded together;
+// false when the file cannot be read.
+typedef std::function<bool(const std::string& path, uint64_t* pStamp)> FileStampFunction;
+
+// The stamp of a file with this write time and size. Never 0, which
+// SourceChangeDetector keeps for unreadable files.
+uint64_t MakeFileStamp(uint64_t writeTime, uint64_t size);
+
+// Finds which of a set of files changed by comparing their stamps with the
+// ones seen last time. Meant to run after the OS reported a change in their
+// directories, not every frame.
+class SourceChangeDetector
+{
+public: explicit SourceChangeDetector(FileStampFunction stamp);
+
+    // Starts tracking the files not tracked yet at their current stamps.
+public: void Track(const std::vector<std::string>& files);
+
+    // Appends the tracked files whose stamp changed since the last call,
+    // including ones that were deleted or could not be read.
+public: void Detect(std::vector<std::string>* pChanged);
+
+public: size_t GetTrackedCount() const { return _stamps.size(); }
+
+private: FileStampFunction _stamp;
+private: std::unordered_map<std::string, uint64_t> _stamps;   // 0 while unreadable.
+};
@@ -0,0 +1,327 @@
+#include "ShaderPermutations.h"
+#include "ShaderDependencies.h"
+
+#include <bitset>
+
+namespace
+{
+    uint32_t CountFeatures(ShaderFeatureMask features)
+    {
+        return static_cast<uint32_t>(std::bitset<32>(features).count());
+    }
+
+    void HashValue(uint64_t value, uint32_t bytes, uint64_t* pHash)
+    {
+        // FNV-1a over the low bytes of value.
+        for (uint32_t i = 0; i < bytes; i++)
+        {
+            *pHash ^= (value >> (i * 8)) & 0xff;
+            *pHash *= 0x100000001b3ull;
+        }
+    }
+}
+
+uint64_t HashShaderPermutationKey(const ShaderPermutationKey& key)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    HashValue(key.features, sizeof(key.features), &hash);
+    HashValue(key.pipelineStateHash, sizeof(key.pipelineStateHash), &hash);
+    return hash;
+}
+
+size_t SelectFallbackVariant(ShaderFeatureMask requested, const ShaderFeatureMask* pAvailable, size_t count)
+{
+    size_t best = count;
+    for (size_t i = 0; i < count; i++)
+    {
+        const ShaderFeatureMask features = pAvailable[i];
+        if ((features & ~requested) != 0)
+        {
+            continue;
+        }
+
+        if (best == count ||
+            CountFeatures(features) > CountFeatures(pAvailable[best]) ||
+            (CountFeatures(features) == CountFeatures(pAvailable[best]) && features < pAvailable[best]))
+        {
+            best = i;
+        }
+    }
+    return best;
+}
+
+ShaderPermutationCache::ShaderPermutationCache(PipelineCompiler& compiler, ThreadPool* pCompileThreads, ShaderFeatureMask knownFeatures) :
+    _compiler(compiler),
+    _pCompileThreads(pCompileThreads),
+    _knownFeatures(knownFeatures),
+    _pendingCompiles(0),
+    _dependencies(new ShaderDependencyGraph()),
+    _pendingRebuilds(0),
+    _stats()
+{
+}
+
+ShaderPermutationCache::~ShaderPermutationCache()
+{
+    // Queued jobs refer to this.
+    WaitIdle();
+}
+
+RenderHandle ShaderPermutationCache::Build(ShaderFeatureMask features, uint64_t pipelineStateHash, std::string* pError)
+{
+    const ShaderPermutationKey key = { features & _knownFeatures, pipelineStateHash };
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    auto found = _variants.find(key);
+    if (found == _variants.end())
+    {
+        _variants[key] = { VariantState::Compiling, 0, 0 };
+        _pendingCompiles++;
+        lock.unlock();
+
+        std::vector<std::string> inputs;
+        const auto start = std::chrono::steady_clock::now();
+        const RenderHandle pipeline = _compiler.Compile(key, &inputs, pError);
+        const auto end = std::chrono::steady_clock::now();
+        FinishCompile(key, pipeline, inputs, std::chrono::duration<double, std::milli>(end - start).count());
+        return pipeline;
+    }
+
+    // Already queued: wait for it rather than compiling it twice.
+    _compileFinished.wait(lock, [&]() { return _variants[key].state != VariantState::Compiling; });
+    const Variant& variant = _variants[key];
+    if (variant.state == VariantState::Failed)
+    {
+        *pError = "Shader variant failed to compile earlier";
+        return 0;
+    }
+    return variant.pipeline;
+}
+
+void ShaderPermutationCache::Resolve(const ShaderFeatureMask* pRequested, size_t count, uint64_t pipelineStateHash, RenderHandle* pPipelines)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    for (size_t i = 0; i < count; i++)
+    {
+        pPipelines[i] = ResolveLocked(pRequested[i], pipelineStateHash, lock);
+    }
+}
+
+RenderHandle ShaderPermutationCache::Resolve(ShaderFeatureMask requested, uint64_t pipelineStateHash)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return ResolveLocked(requested, pipelineStateHash, lock);
+}
+
+size_t ShaderPermutationCache::Rebuild(const std::vector<std::string>& changedFiles)
+{
+    std::vector<ShaderPermutationKey> keys;
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _dependencies->GetAffected(changedFiles, &keys);
+    if (!keys.empty() && _pendingRebuilds == 0 && _rebuilt.empty())
+    {
+        _rebuildStart = std::chrono::steady_clock::now();
+    }
+
+    for (const ShaderPermutationKey& key : keys)
+    {
+        const uint32_t generation = ++_variants[key].generation;
+        _pendingCompiles++;
+        _pendingRebuilds++;
+        _stats.rebuildsQueued++;
+        if (_pCompileThreads != nullptr)
+        {
+            _pCompileThreads->Submit([this, key, generation]() { RebuildVariant(key, generation); });
+        }
+        else
+        {
+            lock.unlock();
+            RebuildVariant(key, generation);
+            lock.lock();
+        }
+    }
+    return keys.size();
+}
+
+size_t ShaderPermutationCache::ApplyRebuilds()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_rebuilt.empty())
+    {
+        return 0;
+    }
+
+    size_t applied = 0;
+    for (const RebuiltVariant& rebuilt : _rebuilt)
+    {
+        Variant& variant = _variants[rebuilt.key];
+        if (rebuilt.generation != variant.generation)
+        {
+            // Edited again meanwhile; a later result is on its way.
+            continue;
+        }
+        if (rebuilt.pipeline == 0)
+        {
+            _stats.rebuildsFailed++;
+            continue;
+        }
+
+        if (variant.state != VariantState::Ready)
+        {
+            _ready.push_back(rebuilt.key);
+        }
+        variant.state = VariantState::Ready;
+        variant.pipeline = rebuilt.pipeline;
+        applied++;
+    }
+    _rebuilt.clear();
+
+    _stats.rebuildsApplied += static_cast<uint32_t>(applied);
+    if (_pendingRebuilds == 0)
+    {
+        _stats.lastRebuildMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _rebuildStart).count();
+    }
+    return applied;
+}
+
+void ShaderPermutationCache::GetSourceFiles(std::vector<std::string>* pFiles) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _dependencies->GetFiles(pFiles);
+}
+
+uint64_t ShaderPermutationCache::GetSourceRevision() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _dependencies->GetRevision();
+}
+
+void ShaderPermutationCache::WaitIdle()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _compileFinished.wait(lock, [this]() { return _pendingCompiles == 0; });
+}
+
+ShaderPermutationStats ShaderPermutationCache::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stats;
+}
+
+RenderHandle ShaderPermutationCache::ResolveLocked(ShaderFeatureMask requested, uint64_t pipelineStateHash, std::unique_lock<std::mutex>& lock)
+{
+    _stats.requests++;
+
+    const ShaderPermutationKey key = { requested & _knownFeatures, pipelineStateHash };
+    auto found = _variants.find(key);
+    if (found != _variants.end() && found->second.state == VariantState::Ready)
+    {
+        return found->second.pipeline;
+    }
+
+    if (found == _variants.end())
+    {
+        _variants[key] = { VariantState::Compiling, 0, 0 };
+        _pendingCompiles++;
+        if (_pCompileThreads != nullptr)
+        {
+            _stats.compilesQueued++;
+            _pCompileThreads->Submit([this, key]() { Compile(key); });
+        }
+        else
+        {
+            lock.unlock();
+            Compile(key);
+            lock.lock();
+
+            const Variant& variant = _variants[key];
+            if (variant.state == VariantState::Ready)
+            {
+                return variant.pipeline;
+            }
+        }
+    }
+
+    _candidates.clear();
+    for (const ShaderPermutationKey& ready : _ready)
+    {
+        if (ready.pipelineStateHash == pipelineStateHash)
+        {
+            _candidates.push_back(ready.features);
+        }
+    }
+
+    const size_t fallback = SelectFallbackVariant(key.features, _candidates.data(), _candidates.size());
+    if (fallback == _candidates.size())
+    {
+        _stats.unresolved++;
+        return 0;
+    }
+
+    _stats.fallbacks++;
+    const ShaderPermutationKey fallbackKey = { _candidates[fallback], pipelineStateHash };
+    return _variants[fallbackKey].pipeline;
+}
+
+void ShaderPermutationCache::Compile(const ShaderPermutationKey& key)
+{
+    std::vector<std::string> inputs;
+    std::string error;
+    const auto start = std::chrono::steady_clock::now();
+    const RenderHandle pipeline = _compiler.Compile(key, &inputs, &error);
+    const auto end = std::chrono::steady_clock::now();
+    FinishCompile(key, pipeline, inputs, std::chrono::duration<double, std::milli>(end - start).count());
+}
+
+void ShaderPermutationCache::FinishCompile(const ShaderPermutationKey& key, RenderHandle pipeline, const std::vector<std::string>& inputs, double milliseconds)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // Recorded for failed compiles too, so fixing the source rebuilds them.
+    if (!inputs.empty())
+    {
+        _dependencies->Record(key, inputs);
+    }
+
+    Variant& variant = _variants[key];
+    variant.pipeline = pipeline;
+    variant.state = pipeline != 0 ? VariantState::Ready : VariantState::Failed;
+    if (pipeline != 0)
+    {
+        _ready.push_back(key);
+    }
+
+    _stats.compilesFinished++;
+    _stats.compilesFailed += pipeline == 0 ? 1 : 0;
+    _stats.compileMilliseconds += milliseconds;
+
+    _pendingCompiles--;
+    _compileFinished.notify_all();
+}
+
+void ShaderPermutationCache::RebuildVariant(const ShaderPermutationKey& key, uint32_t generation)
+{
+    std::vector<std::string> inputs;
+    std::string error;
+    const auto start = std::chrono::steady_clock::now();
+    const RenderHandle pipeline = _compiler.Compile(key, &inputs, &error);
+    const auto end = std::chrono::steady_clock::now();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // Results of earlier edits that finish late must not undo the includes of the latest.
+    if (!inputs.empty() && generation == _variants[key].generation)
+    {
+        _dependencies->Record(key, inputs);
+    }
+    _rebuilt.push_back({ key, generation, pipeline });
+
+    _stats.compilesFinished++;
+    _stats.compilesFailed += pipeline == 0 ? 1 : 0;
+    _stats.compileMilliseconds += std::chrono::duration<double, std::milli>(end - start).count();
+
+    _pendingRebuilds--;
+    _pendingCompiles--;
+    _compileFinished.notify_all();
+}
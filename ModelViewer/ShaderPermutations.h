@@ -0,0 +1,179 @@
+#pragma once
+
+#include "RenderDevice.h"
+#include "ThreadPool.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class ShaderDependencyGraph;
+
+// One bit per optional shader feature. Each set bit turns on a preprocessor
+// define when the variant is compiled, see ShaderFeatureInfo.
+typedef uint32_t ShaderFeatureMask;
+
+struct ShaderFeatureInfo
+{
+    ShaderFeatureMask bit;
+    const char* define;     // Defined to 1 when the bit is set.
+};
+
+// A compiled variant: the features it was built with and a hash of the rest
+// of the pipeline state it belongs to (root signature, render target
+// formats, ...). Variants of different pipeline states never stand in for
+// each other.
+struct ShaderPermutationKey
+{
+    ShaderFeatureMask features;
+    uint64_t pipelineStateHash;
+
+    bool operator==(const ShaderPermutationKey& other) const
+    {
+        return features == other.features && pipelineStateHash == other.pipelineStateHash;
+    }
+};
+
+// Stable across runs, so it can name variants on disk.
+uint64_t HashShaderPermutationKey(const ShaderPermutationKey& key);
+
+struct ShaderPermutationKeyHash
+{
+    size_t operator()(const ShaderPermutationKey& key) const
+    {
+        return static_cast<size_t>(HashShaderPermutationKey(key));
+    }
+};
+
+// The variant to draw with while the one requested is not built: the one
+// with the most features among those with no feature the request lacks, the
+// smallest mask among equals. Extra features could read bindings the
+// material does not provide; missing ones only lose detail. Returns count
+// when none qualifies.
+size_t SelectFallbackVariant(ShaderFeatureMask requested, const ShaderFeatureMask* pAvailable, size_t count);
+
+// Builds the pipeline state of one variant. Called from the compile threads,
+// several at a time.
+class PipelineCompiler
+{
+public: virtual ~PipelineCompiler() {}
+
+    // 0 with a message on failure. pInputs receives every source file the
+    // compile read, the root file and its includes, even when it failed;
+    // nothing for variants that were not compiled from source.
+public: virtual RenderHandle Compile(const ShaderPermutationKey& key, std::vector<std::string>* pInputs, std::string* pError) = 0;
+};
+
+struct ShaderPermutationStats
+{
+    uint32_t requests;          // Pipelines resolved.
+    uint32_t fallbacks;         // Resolved to another variant while the requested one was not ready.
+    uint32_t unresolved;        // Resolved to 0: no variant of the pipeline state was ready.
+    uint32_t compilesQueued;
+    uint32_t compilesFinished;
+    uint32_t compilesFailed;
+    double compileMilliseconds; // Total over all compiles, on the compile threads.
+    uint32_t rebuildsQueued;    // Variants recompiled because a source file changed.
+    uint32_t rebuildsApplied;
+    uint32_t rebuildsFailed;    // Kept their previous pipeline.
+    double lastRebuildMilliseconds; // From Rebuild() to the ApplyRebuilds() that finished it.
+};
+
+// Maps feature masks to compiled pipeline states. Frames never wait for a
+// compile: a variant that is not built yet is queued on the compile threads
+// and the nearest built one (see SelectFallbackVariant()) is returned
+// meanwhile. Variants that fail to compile keep using their fallback.
+// Build() the variant without features up front so there always is one.
+//
+// Feature bits the shaders do not know are dropped before lookup, so they
+// cannot multiply the variants. Thread-safe.
+//
+// Edited sources are picked up with Rebuild(): only the variants that read
+// the changed files are recompiled, in the background, and ApplyRebuilds()
+// swaps them in at a frame boundary. Replaced pipelines are not released;
+// the compiler owns them and frames in flight may still use them.
+class ShaderPermutationCache
+{
+    // Without compile threads, variants are compiled inline when first requested.
+public: ShaderPermutationCache(PipelineCompiler& compiler, ThreadPool* pCompileThreads, ShaderFeatureMask knownFeatures);
+public: ~ShaderPermutationCache();
+
+public: ShaderPermutationCache(const ShaderPermutationCache&) = delete;
+public: ShaderPermutationCache& operator=(const ShaderPermutationCache&) = delete;
+
+    // Compiles a variant right away if it is not built yet; 0 with a message on failure.
+public: RenderHandle Build(ShaderFeatureMask features, uint64_t pipelineStateHash, std::string* pError);
+
+    // One pipeline per requested mask, 0 where nothing is ready. Missing
+    // variants are queued.
+public: void Resolve(const ShaderFeatureMask* pRequested, size_t count, uint64_t pipelineStateHash, RenderHandle* pPipelines);
+public: RenderHandle Resolve(ShaderFeatureMask requested, uint64_t pipelineStateHash);
+
+    // Queues the variants whose inputs include any of the files. A variant
+    // already rebuilding is queued again; only its latest result is applied.
+    // Returns the number queued.
+public: size_t Rebuild(const std::vector<std::string>& changedFiles);
+
+    // Swaps in the rebuilt variants that finished since the last call.
+    // Returns the number swapped in.
+public: size_t ApplyRebuilds();
+
+    // Every source file a variant was compiled from, and a revision that
+    // changes whenever the list grows.
+public: void GetSourceFiles(std::vector<std::string>* pFiles) const;
+public: uint64_t GetSourceRevision() const;
+
+    // Blocks until no compile is queued or running.
+public: void WaitIdle();
+
+public: ShaderPermutationStats GetStats() const;
+public: ShaderFeatureMask GetKnownFeatures() const { return _knownFeatures; }
+
+private: enum class VariantState
+    {
+        Compiling,
+        Ready,
+        Failed,
+    };
+
+private: struct Variant
+    {
+        VariantState state;
+        RenderHandle pipeline;
+        uint32_t generation;    // Bumped by each Rebuild() of the variant.
+    };
+
+private: struct RebuiltVariant
+    {
+        ShaderPermutationKey key;
+        uint32_t generation;
+        RenderHandle pipeline;
+    };
+
+private: RenderHandle ResolveLocked(ShaderFeatureMask requested, uint64_t pipelineStateHash, std::unique_lock<std::mutex>& lock);
+private: void Compile(const ShaderPermutationKey& key);
+private: void FinishCompile(const ShaderPermutationKey& key, RenderHandle pipeline, const std::vector<std::string>& inputs, double milliseconds);
+private: void RebuildVariant(const ShaderPermutationKey& key, uint32_t generation);
+
+private: PipelineCompiler& _compiler;
+private: ThreadPool* _pCompileThreads;
+private: ShaderFeatureMask _knownFeatures;
+
+private: mutable std::mutex _mutex;
+private: std::condition_variable _compileFinished;
+private: std::unordered_map<ShaderPermutationKey, Variant, ShaderPermutationKeyHash> _variants;
+private: std::vector<ShaderPermutationKey> _ready;     // Fallback candidates, in the order they finished.
+private: std::vector<ShaderFeatureMask> _candidates;   // Scratch for SelectFallbackVariant().
+private: uint32_t _pendingCompiles;
+private: std::unique_ptr<ShaderDependencyGraph> _dependencies;
+private: std::vector<RebuiltVariant> _rebuilt;         // Finished, waiting for ApplyRebuilds().
+private: uint32_t _pendingRebuilds;
+private: std::chrono::steady_clock::time_point _rebuildStart;
+private: ShaderPermutationStats _stats;
+};
@@ -0,0 +1,261 @@
+#include "ShaderPermutations.h"
+#include "UnitTest.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace
+{
+    // Each variant compiles to a handle made from its key. Variants with a
+    // held feature mask wait in Compile() until released, so a test can keep
+    // them pending; failing masks return 0.
+    class StubCompiler : public PipelineCompiler
+    {
+    public: virtual RenderHandle Compile(const ShaderPermutationKey& key, std::vector<std::string>* pInputs, std::string* pError)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            compiles.push_back(key);
+            _released.wait(lock, [&]() { return held.count(key.features) == 0; });
+
+            pInputs->push_back("shaders.hlsl");
+            if (failing.count(key.features) != 0)
+            {
+                *pError = "stub compile error";
+                return 0;
+            }
+            return PipelineFor(key);
+        }
+
+    public: static RenderHandle PipelineFor(const ShaderPermutationKey& key)
+        {
+            return 0x1000000 + key.pipelineStateHash * 0x10000 + key.features;
+        }
+
+    public: void Hold(ShaderFeatureMask features)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            held.insert(features);
+        }
+
+    public: void Release(ShaderFeatureMask features)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            held.erase(features);
+            _released.notify_all();
+        }
+
+    public: size_t GetCompileCount()
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return compiles.size();
+        }
+
+    public: std::vector<ShaderPermutationKey> compiles;
+    public: std::set<ShaderFeatureMask> held;
+    public: std::set<ShaderFeatureMask> failing;
+
+    private: std::mutex _mutex;
+    private: std::condition_variable _released;
+    };
+
+    RenderHandle PipelineFor(ShaderFeatureMask features, uint64_t pipelineStateHash)
+    {
+        return StubCompiler::PipelineFor({ features, pipelineStateHash });
+    }
+
+    // Equal keys hash the same, every field counts, and the value does not
+    // change between runs or builds.
+    void TestKeyHashing()
+    {
+        const ShaderPermutationKey key = { 0x5, 0x1234 };
+        const ShaderPermutationKey same = { 0x5, 0x1234 };
+        CHECK(key == same);
+        CHECK(HashShaderPermutationKey(key) == HashShaderPermutationKey(same));
+        CHECK(HashShaderPermutationKey(key) == 0x4bd208bb5a3c479aull);
+
+        const ShaderPermutationKey otherFeatures = { 0x4, 0x1234 };
+        const ShaderPermutationKey otherState = { 0x5, 0x1235 };
+        const ShaderPermutationKey swapped = { 0x1234, 0x5 };
+        CHECK(!(key == otherFeatures) && !(key == otherState));
+        CHECK(HashShaderPermutationKey(key) != HashShaderPermutationKey(otherFeatures));
+        CHECK(HashShaderPermutationKey(key) != HashShaderPermutationKey(otherState));
+        CHECK(HashShaderPermutationKey(key) != HashShaderPermutationKey(swapped));
+
+        // Every mask of 8 features over a few pipeline states: no collisions.
+        std::set<uint64_t> hashes;
+        for (uint64_t state = 0; state < 4; state++)
+        {
+            for (ShaderFeatureMask features = 0; features < 256; features++)
+            {
+                hashes.insert(HashShaderPermutationKey({ features, state }));
+            }
+        }
+        CHECK(hashes.size() == 4 * 256);
+    }
+
+    // The fallback has no feature the request lacks, and the most of the
+    // ones it has; the smaller mask wins a tie.
+    void TestSelectFallback()
+    {
+        const ShaderFeatureMask available[] = { 0x0, 0x1, 0xa, 0x4, 0x3, 0xf };
+        CHECK(SelectFallbackVariant(0xb, available, 6) == 4);
+        CHECK(SelectFallbackVariant(0xf, available, 6) == 5);
+        CHECK(SelectFallbackVariant(0x4, available, 6) == 3);
+        CHECK(SelectFallbackVariant(0x10, available, 6) == 0);
+        CHECK(SelectFallbackVariant(0x0, available, 6) == 0);
+
+        // Nothing qualifies without the empty mask.
+        const ShaderFeatureMask withFeatures[] = { 0x2, 0x6 };
+        CHECK(SelectFallbackVariant(0x1, withFeatures, 2) == 2);
+        CHECK(SelectFallbackVariant(0x1, nullptr, 0) == 0);
+    }
+
+    // While a variant compiles in the background, requests for it get the
+    // closest built subset and the compile is queued once. When it finishes
+    // it is handed out itself. Other pipeline states never stand in.
+    void TestFallbackWhilePending()
+    {
+        StubCompiler compiler;
+        ThreadPool compileThreads(2);
+        ShaderPermutationCache cache(compiler, &compileThreads, 0xf);
+
+        std::string error;
+        CHECK(cache.Build(0x0, 1, &error) == PipelineFor(0x0, 1));
+        CHECK(cache.Build(0x1, 1, &error) == PipelineFor(0x1, 1));
+        CHECK(cache.Build(0x8, 1, &error) == PipelineFor(0x8, 1));
+
+        compiler.Hold(0xb);
+        CHECK(cache.Resolve(0xb, 1) == PipelineFor(0x1, 1));
+        CHECK(cache.Resolve(0xb, 1) == PipelineFor(0x1, 1));
+
+        // Feature bits the shaders do not know are dropped.
+        CHECK(cache.Resolve(0xb | 0x100, 1) == PipelineFor(0x1, 1));
+
+        // A pipeline state with nothing built resolves to 0.
+        compiler.Hold(0x1);
+        CHECK(cache.Resolve(0x1, 2) == 0);
+
+        ShaderPermutationStats stats = cache.GetStats();
+        CHECK(stats.requests == 4);
+        CHECK(stats.fallbacks == 3);
+        CHECK(stats.unresolved == 1);
+        CHECK(stats.compilesQueued == 2);
+
+        compiler.Release(0xb);
+        compiler.Release(0x1);
+        cache.WaitIdle();
+        CHECK(cache.Resolve(0xb, 1) == PipelineFor(0xb, 1));
+        CHECK(cache.Resolve(0x1, 2) == PipelineFor(0x1, 2));
+
+        // The new variant is a fallback candidate too.
+        CHECK(cache.Resolve(0xf, 1) == PipelineFor(0xb, 1));
+        cache.WaitIdle();
+
+        stats = cache.GetStats();
+        CHECK(stats.compilesQueued == 3);
+        CHECK(stats.compilesFinished == 6);
+        CHECK(stats.compilesFailed == 0);
+        CHECK(compiler.GetCompileCount() == 6);
+    }
+
+    // The background threads finish every queued variant; each is compiled
+    // once however many frames ask for it meanwhile.
+    void TestBackgroundQueue()
+    {
+        StubCompiler compiler;
+        ThreadPool compileThreads(4);
+        ShaderPermutationCache cache(compiler, &compileThreads, 0xff);
+        std::string error;
+        cache.Build(0x0, 7, &error);
+
+        std::vector<ShaderFeatureMask> requested;
+        for (ShaderFeatureMask features = 1; features < 256; features++)
+        {
+            requested.push_back(features);
+        }
+        std::vector<RenderHandle> pipelines(requested.size());
+        for (int frame = 0; frame < 3; frame++)
+        {
+            cache.Resolve(requested.data(), requested.size(), 7, pipelines.data());
+            for (RenderHandle pipeline : pipelines)
+            {
+                CHECK(pipeline != 0);
+            }
+        }
+        cache.WaitIdle();
+
+        cache.Resolve(requested.data(), requested.size(), 7, pipelines.data());
+        for (size_t i = 0; i < requested.size(); i++)
+        {
+            CHECK(pipelines[i] == PipelineFor(requested[i], 7));
+        }
+        CHECK(compiler.GetCompileCount() == 256);
+        CHECK(cache.GetStats().compilesQueued == 255);
+        CHECK(cache.GetStats().compilesFinished == 256);
+    }
+
+    // A variant that fails keeps resolving to its fallback and is not
+    // queued again; Build() reports the failure.
+    void TestFailedCompile()
+    {
+        StubCompiler compiler;
+        ThreadPool compileThreads(1);
+        ShaderPermutationCache cache(compiler, &compileThreads, 0xf);
+        compiler.failing.insert(0x6);
+
+        std::string error;
+        CHECK(cache.Build(0x0, 1, &error) == PipelineFor(0x0, 1));
+        CHECK(cache.Build(0x2, 1, &error) == PipelineFor(0x2, 1));
+
+        CHECK(cache.Resolve(0x6, 1) == PipelineFor(0x2, 1));
+        cache.WaitIdle();
+        CHECK(cache.Resolve(0x6, 1) == PipelineFor(0x2, 1));
+        cache.WaitIdle();
+
+        const ShaderPermutationStats stats = cache.GetStats();
+        CHECK(stats.compilesQueued == 1);
+        CHECK(stats.compilesFailed == 1);
+        CHECK(stats.fallbacks == 2);
+        CHECK(compiler.GetCompileCount() == 3);
+
+        error.clear();
+        CHECK(cache.Build(0x6, 1, &error) == 0);
+        CHECK(!error.empty());
+
+        // Built up front, the failure comes back from the compiler itself.
+        error.clear();
+        compiler.failing.insert(0x1);
+        CHECK(cache.Build(0x1, 1, &error) == 0);
+        CHECK(error == "stub compile error");
+    }
+
+    // Without compile threads a missing variant is compiled on the spot.
+    void TestInlineCompiles()
+    {
+        StubCompiler compiler;
+        ShaderPermutationCache cache(compiler, nullptr, 0xf);
+        CHECK(cache.Resolve(0x3, 1) == PipelineFor(0x3, 1));
+        CHECK(cache.Resolve(0x3, 1) == PipelineFor(0x3, 1));
+        CHECK(compiler.GetCompileCount() == 1);
+
+        // A failed one falls back to what there is.
+        compiler.failing.insert(0x7);
+        CHECK(cache.Resolve(0x7, 1) == PipelineFor(0x3, 1));
+        CHECK(cache.GetStats().compilesQueued == 0);
+        CHECK(cache.GetStats().fallbacks == 1);
+    }
+}
+
+int main()
+{
+    TestKeyHashing();
+    TestSelectFallback();
+    TestFallbackWhilePending();
+    TestBackgroundQueue();
+    TestFailedCompile();
+    TestInlineCompiles();
+    return TestFailures();
+}
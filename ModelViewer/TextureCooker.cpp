@@ -0,0 +1,164 @@
+#include "TextureCooker.h"
+#include "DDSFile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    // Copies the 4x4 texels of block (bx, by), clamping at the image edges.
+    void GatherBlock(const uint8_t* pRGBA, uint32_t width, uint32_t height, uint32_t bx, uint32_t by, uint8_t* pTexels)
+    {
+        for (uint32_t y = 0; y < 4; y++)
+        {
+            const uint32_t sy = std::min(by * 4 + y, height - 1);
+            for (uint32_t x = 0; x < 4; x++)
+            {
+                const uint32_t sx = std::min(bx * 4 + x, width - 1);
+                memcpy(pTexels + (y * 4 + x) * 4, pRGBA + (static_cast<size_t>(sy) * width + sx) * 4, 4);
+            }
+        }
+    }
+}
+
+TextureCooker::TextureCooker(ThreadPool& pool) :
+    _pool(pool)
+{
+}
+
+void TextureCooker::EncodeImage(const uint8_t* pRGBA, uint32_t width, uint32_t height, BCFormat format, uint8_t* pBlocks)
+{
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    const uint32_t blocksWide = (width + 3) / 4;
+    const uint32_t blocksHigh = (height + 3) / 4;
+    const uint32_t blockBytes = GetBCBlockBytes(format);
+
+    _pool.ParallelFor(blocksHigh, 1, [=](size_t begin, size_t end)
+    {
+        uint8_t texels[64];
+        for (size_t by = begin; by < end; by++)
+        {
+            uint8_t* pRow = pBlocks + by * blocksWide * blockBytes;
+            for (uint32_t bx = 0; bx < blocksWide; bx++)
+            {
+                GatherBlock(pRGBA, width, height, bx, static_cast<uint32_t>(by), texels);
+                EncodeBCBlock(format, texels, pRow + bx * blockBytes);
+            }
+        }
+    });
+
+    const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    _stats.texels += static_cast<uint64_t>(width) * height;
+    _stats.encodeMilliseconds += milliseconds;
+    _stats.megapixelsPerSecond = _stats.encodeMilliseconds > 0.0 ? _stats.texels / (_stats.encodeMilliseconds * 1000.0) : 0.0;
+}
+
+void TextureCooker::Cook(const uint8_t* pRGBA, uint32_t width, uint32_t height, BCFormat format, bool srgb, std::vector<uint8_t>* pDDS)
+{
+    CookLevels(&pRGBA, width, height, 1, 1, format, srgb, pDDS);
+}
+
+void TextureCooker::Cook(const MipChain& chain, BCFormat format, bool srgb, std::vector<uint8_t>* pDDS)
+{
+    std::vector<const uint8_t*> levels;
+    for (const std::vector<uint8_t>& level : chain.levels)
+    {
+        levels.push_back(level.data());
+    }
+    CookLevels(levels.data(), chain.width, chain.height, chain.mipCount, chain.arraySize, format, srgb, pDDS);
+}
+
+// ppLevels is slice major, the same order the DDS stores subresources in.
+void TextureCooker::CookLevels(const uint8_t* const* ppLevels, uint32_t width, uint32_t height, uint32_t mipCount, uint32_t arraySize, BCFormat format, bool srgb, std::vector<uint8_t>* pDDS)
+{
+    _stats = TextureCookStats();
+
+    DDSTextureInfo info = {};
+    info.width = width;
+    info.height = height;
+    info.depth = 1;
+    info.mipCount = mipCount;
+    info.arraySize = arraySize;
+    info.format = GetBCDDSFormat(format, srgb);
+
+    pDDS->clear();
+    WriteDDSHeader(info, pDDS);
+    info.dataOffset = pDDS->size();
+
+    const DDSSubresourceLayout last = GetDDSSubresourceLayout(info, mipCount - 1, arraySize - 1);
+    pDDS->resize(last.offset + last.size);
+
+    uint64_t squaredErrorTexels = 0;
+    double weightedSquaredError = 0.0;
+    for (uint32_t slice = 0; slice < arraySize; slice++)
+    {
+        for (uint32_t mip = 0; mip < mipCount; mip++)
+        {
+            const DDSSubresourceLayout layout = GetDDSSubresourceLayout(info, mip, slice);
+            const uint8_t* pLevel = ppLevels[slice * mipCount + mip];
+            EncodeImage(pLevel, layout.width, layout.height, format, pDDS->data() + layout.offset);
+
+            // Quality is averaged over all texels of all subresources.
+            if (_measureQuality)
+            {
+                const double psnr = ComputePSNR(pLevel, layout.width, layout.height, format, pDDS->data() + layout.offset);
+                const uint64_t texels = static_cast<uint64_t>(layout.width) * layout.height;
+                weightedSquaredError += std::isinf(psnr) ? 0.0 : texels * 255.0 * 255.0 / std::pow(10.0, psnr / 10.0);
+                squaredErrorTexels += texels;
+            }
+        }
+    }
+
+    if (_measureQuality)
+    {
+        const double meanSquaredError = weightedSquaredError / squaredErrorTexels;
+        _stats.psnr = meanSquaredError > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / meanSquaredError) : HUGE_VAL;
+    }
+}
+
+double TextureCooker::ComputePSNR(const uint8_t* pRGBA, uint32_t width, uint32_t height, BCFormat format, const uint8_t* pBlocks)
+{
+    const uint32_t blocksWide = (width + 3) / 4;
+    const uint32_t blocksHigh = (height + 3) / 4;
+    const uint32_t blockBytes = GetBCBlockBytes(format);
+    const uint32_t channelMask = GetBCChannelMask(format);
+
+    uint64_t squaredError = 0;
+    uint64_t samples = 0;
+    for (uint32_t by = 0; by < blocksHigh; by++)
+    {
+        for (uint32_t bx = 0; bx < blocksWide; bx++)
+        {
+            uint8_t decoded[64];
+            DecodeBCBlock(format, pBlocks + (static_cast<size_t>(by) * blocksWide + bx) * blockBytes, decoded);
+
+            // Padding texels outside the image do not count.
+            for (uint32_t y = 0; y < 4 && by * 4 + y < height; y++)
+            {
+                for (uint32_t x = 0; x < 4 && bx * 4 + x < width; x++)
+                {
+                    const uint8_t* pSource = pRGBA + ((static_cast<size_t>(by) * 4 + y) * width + bx * 4 + x) * 4;
+                    for (uint32_t ch = 0; ch < 4; ch++)
+                    {
+                        if (channelMask & (1u << ch))
+                        {
+                            const int d = static_cast<int>(pSource[ch]) - decoded[(y * 4 + x) * 4 + ch];
+                            squaredError += static_cast<uint64_t>(d * d);
+                            samples++;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    if (squaredError == 0)
+    {
+        return HUGE_VAL;
+    }
+    const double meanSquaredError = static_cast<double>(squaredError) / samples;
+    return 10.0 * std::log10(255.0 * 255.0 / meanSquaredError);
+}
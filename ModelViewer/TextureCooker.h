@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "BlockCompression.h"
+#include "MipGenerator.h"
+#include "ThreadPool.h"
+
+struct TextureCookStats
+{
+    uint64_t texels;
+    double encodeMilliseconds;
+    double megapixelsPerSecond;
+    double psnr;                // Over the channels the format stores; 0 unless quality is measured.
+};
+
+// Offline texture compression: turns RGBA8 images into BC compressed DDS files
+// the streamer can load. Rows of blocks are encoded in parallel on the pool.
+class TextureCooker
+{
+public: explicit TextureCooker(ThreadPool& pool);
+
+    // Decodes the output again after encoding to fill in TextureCookStats::psnr.
+public: void SetMeasureQuality(bool measure) { _measureQuality = measure; }
+
+    // Encodes width x height texels with a row pitch of width * 4 bytes into
+    // rows of blocks. Partial blocks at the right and bottom edges repeat the
+    // last column and row. Adds to the stats of the current Cook().
+public: void EncodeImage(const uint8_t* pRGBA, uint32_t width, uint32_t height, BCFormat format, uint8_t* pBlocks);
+
+    // Produce a whole DDS file with a DX10 header, holding a single mip or
+    // every mip and array slice of the chain.
+public: void Cook(const uint8_t* pRGBA, uint32_t width, uint32_t height, BCFormat format, bool srgb, std::vector<uint8_t>* pDDS);
+public: void Cook(const MipChain& chain, BCFormat format, bool srgb, std::vector<uint8_t>* pDDS);
+
+public: const TextureCookStats& GetStats() const { return _stats; }
+
+public: static double ComputePSNR(const uint8_t* pRGBA, uint32_t width, uint32_t height, BCFormat format, const uint8_t* pBlocks);
+
+private: void CookLevels(const uint8_t* const* ppLevels, uint32_t width, uint32_t height, uint32_t mipCount, uint32_t arraySize, BCFormat format, bool srgb, std::vector<uint8_t>* pDDS);
+
+private: ThreadPool& _pool;
+private: bool _measureQuality = false;
+private: TextureCookStats _stats = {};
+};
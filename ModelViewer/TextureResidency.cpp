@@ -0,0 +1,199 @@
+#include "TextureResidency.h"
+
+#include <algorithm>
+#include <cmath>
+
+uint32_t TextureResidencyManager::AddTexture(const StreamedTextureDesc& desc)
+{
+    Texture texture;
+    texture.desc = desc;
+    texture.desc.mipCount = std::min(std::max(desc.mipCount, 1u), MaxStreamedMips);
+    texture.desc.tailMipCount = std::min(std::max(desc.tailMipCount, 1u), texture.desc.mipCount);
+    texture.residentMip = texture.desc.mipCount - texture.desc.tailMipCount;
+    texture.desiredMip = texture.residentMip;
+    texture.priority = 0.0f;
+    texture.unloadable = false;
+
+    _stats.residentBytes += GetResidentBytes(texture);
+
+    _textures.push_back(texture);
+    return static_cast<uint32_t>(_textures.size() - 1);
+}
+
+void TextureResidencyManager::SetDesiredMip(uint32_t texture, uint32_t mip, float priority)
+{
+    Texture& t = _textures[texture];
+    if (t.unloadable)
+    {
+        return;
+    }
+    t.desiredMip = std::min(mip, GetCoarsestStreamedMip(t));
+    t.priority = priority;
+}
+
+void TextureResidencyManager::MarkUnloadable(uint32_t texture, uint32_t residentMip)
+{
+    Texture& t = _textures[texture];
+    _stats.residentBytes -= GetResidentBytes(t);
+    t.residentMip = std::min(residentMip, t.desc.mipCount);
+    t.desiredMip = t.residentMip;
+    t.unloadable = true;
+    _stats.residentBytes += GetResidentBytes(t);
+}
+
+uint32_t TextureResidencyManager::ComputeDesiredMip(uint32_t width, uint32_t height, float screenWidth, float screenHeight)
+{
+    if (screenWidth <= 0.0f || screenHeight <= 0.0f)
+    {
+        return MaxStreamedMips - 1;
+    }
+
+    // One texel per pixel along the more minified axis.
+    const float ratio = std::max(width / screenWidth, height / screenHeight);
+    if (ratio <= 1.0f)
+    {
+        return 0;
+    }
+    return std::min(static_cast<uint32_t>(std::floor(std::log2(ratio))), MaxStreamedMips - 1);
+}
+
+uint64_t TextureResidencyManager::GetResidentBytes(const Texture& texture)
+{
+    uint64_t bytes = 0;
+    for (uint32_t mip = texture.residentMip; mip < texture.desc.mipCount; mip++)
+    {
+        bytes += texture.desc.mipBytes[mip];
+    }
+    return bytes;
+}
+
+uint32_t TextureResidencyManager::GetCoarsestStreamedMip(const Texture& texture) const
+{
+    return texture.desc.mipCount - texture.desc.tailMipCount;
+}
+
+void TextureResidencyManager::Evict(uint32_t texture)
+{
+    Texture& t = _textures[texture];
+    const uint64_t bytes = t.desc.mipBytes[t.residentMip];
+
+    _actions.push_back({ ResidencyActionType::Evict, texture, t.residentMip });
+    t.residentMip++;
+
+    _stats.residentBytes -= bytes;
+    _stats.bytesEvicted += bytes;
+    _stats.evictionsLastUpdate++;
+}
+
+// Drops the finest mip of the lowest priority texture that still has one to
+// give, ignoring textures at or above belowPriority. Ties go to the texture with
+// the biggest mip, then to the lowest index so the choice stays deterministic.
+bool TextureResidencyManager::EvictOne(float belowPriority, uint32_t exceptTexture)
+{
+    uint32_t victim = UINT32_MAX;
+    for (uint32_t i = 0; i < _textures.size(); i++)
+    {
+        const Texture& t = _textures[i];
+        if (i == exceptTexture || t.unloadable || t.residentMip >= GetCoarsestStreamedMip(t) || t.priority >= belowPriority)
+        {
+            continue;
+        }
+
+        if (victim == UINT32_MAX)
+        {
+            victim = i;
+            continue;
+        }
+
+        const Texture& v = _textures[victim];
+        if (t.priority < v.priority ||
+            (t.priority == v.priority && t.desc.mipBytes[t.residentMip] > v.desc.mipBytes[v.residentMip]))
+        {
+            victim = i;
+        }
+    }
+
+    if (victim == UINT32_MAX)
+    {
+        return false;
+    }
+
+    Evict(victim);
+    return true;
+}
+
+void TextureResidencyManager::Update(uint64_t budgetBytes, uint64_t maxBytesPerUpdate)
+{
+    _actions.clear();
+    _stats.loadsLastUpdate = 0;
+    _stats.evictionsLastUpdate = 0;
+
+    // Mips finer than what a texture wants are dropped right away.
+    for (uint32_t i = 0; i < _textures.size(); i++)
+    {
+        while (_textures[i].residentMip < _textures[i].desiredMip)
+        {
+            Evict(i);
+        }
+    }
+
+    _order.clear();
+    for (uint32_t i = 0; i < _textures.size(); i++)
+    {
+        if (_textures[i].residentMip > _textures[i].desiredMip)
+        {
+            _order.push_back(i);
+        }
+    }
+    std::stable_sort(_order.begin(), _order.end(), [this](uint32_t a, uint32_t b)
+    {
+        return _textures[a].priority > _textures[b].priority;
+    });
+
+    uint64_t streamedThisUpdate = 0;
+    for (uint32_t index : _order)
+    {
+        Texture& t = _textures[index];
+        while (t.residentMip > t.desiredMip)
+        {
+            const uint32_t mip = t.residentMip - 1;
+            const uint64_t bytes = t.desc.mipBytes[mip];
+            if (streamedThisUpdate > 0 && streamedThisUpdate + bytes > maxBytesPerUpdate)
+            {
+                break;
+            }
+
+            // Only textures that matter less than this one make room for it.
+            bool fits = true;
+            while (_stats.residentBytes + bytes > budgetBytes)
+            {
+                if (!EvictOne(t.priority, index))
+                {
+                    fits = false;
+                    break;
+                }
+            }
+            if (!fits)
+            {
+                break;
+            }
+
+            _actions.push_back({ ResidencyActionType::Load, index, mip });
+            t.residentMip = mip;
+            _stats.residentBytes += bytes;
+            _stats.bytesStreamed += bytes;
+            _stats.loadsLastUpdate++;
+            streamedThisUpdate += bytes;
+        }
+    }
+
+    // The budget can shrink below what is resident; give memory back until it
+    // fits or only the always resident tails are left.
+    while (_stats.residentBytes > budgetBytes && EvictOne(HUGE_VALF, UINT32_MAX))
+    {
+    }
+
+    _stats.budgetOvershootBytes = _stats.residentBytes > budgetBytes ? _stats.residentBytes - budgetBytes : 0;
+    _stats.peakOvershootBytes = std::max(_stats.peakOvershootBytes, _stats.budgetOvershootBytes);
+    _stats.overshootUpdates += _stats.budgetOvershootBytes > 0 ? 1 : 0;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+static const uint32_t MaxStreamedMips = 16;
+
+struct StreamedTextureDesc
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipCount;
+    uint32_t tailMipCount;              // Coarsest mips that always stay resident.
+    uint64_t mipBytes[MaxStreamedMips];
+};
+
+enum class ResidencyActionType : uint32_t
+{
+    Load,
+    Evict,
+};
+
+struct ResidencyAction
+{
+    ResidencyActionType type;
+    uint32_t texture;
+    uint32_t mip;
+};
+
+struct TextureResidencyStats
+{
+    uint64_t residentBytes;
+    uint64_t bytesStreamed;             // Totals since the manager was created.
+    uint64_t bytesEvicted;
+    uint64_t budgetOvershootBytes;      // Of the last Update().
+    uint64_t peakOvershootBytes;
+    uint32_t overshootUpdates;
+    uint32_t loadsLastUpdate;
+    uint32_t evictionsLastUpdate;
+};
+
+// Decides which mips of which textures should be resident. A texture is always
+// resident from some mip down to the end of its chain; feedback (screen-space
+// size or sampler feedback) sets the finest mip it wants. Each Update() moves
+// textures towards what they want, one mip at a time from coarse to fine, and
+// keeps the resident size under the budget by dropping the finest mip of the
+// lowest priority textures first. Purely bookkeeping: the caller applies the
+// actions, and the result only depends on the inputs.
+class TextureResidencyManager
+{
+public: uint32_t AddTexture(const StreamedTextureDesc& desc);
+
+    // Priority orders both loading (highest first) and eviction (lowest first).
+public: void SetDesiredMip(uint32_t texture, uint32_t mip, float priority);
+
+    // For textures whose mips can no longer be streamed, e.g. from a broken
+    // file: the texture stays at residentMip, what the caller actually holds,
+    // and Update() neither loads nor evicts it again. residentMip may be
+    // mipCount when nothing is resident.
+public: void MarkUnloadable(uint32_t texture, uint32_t residentMip);
+
+    // Finest mip worth having when the texture covers the given screen area.
+public: static uint32_t ComputeDesiredMip(uint32_t width, uint32_t height, float screenWidth, float screenHeight);
+
+public: void Update(uint64_t budgetBytes, uint64_t maxBytesPerUpdate);
+
+public: const std::vector<ResidencyAction>& GetActions() const { return _actions; }
+public: uint32_t GetResidentMip(uint32_t texture) const { return _textures[texture].residentMip; }
+public: const TextureResidencyStats& GetStats() const { return _stats; }
+
+private: struct Texture
+    {
+        StreamedTextureDesc desc;
+        uint32_t residentMip;
+        uint32_t desiredMip;
+        float priority;
+        bool unloadable;
+    };
+
+private: static uint64_t GetResidentBytes(const Texture& texture);
+private: uint32_t GetCoarsestStreamedMip(const Texture& texture) const;
+private: bool EvictOne(float belowPriority, uint32_t exceptTexture);
+private: void Evict(uint32_t texture);
+
+private: std::vector<Texture> _textures;
+private: std::vector<uint32_t> _order;
+private: std::vector<ResidencyAction> _actions;
+private: TextureResidencyStats _stats = {};
+};
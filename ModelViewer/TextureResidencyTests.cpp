@@ -0,0 +1,113 @@
+#include "TextureResidency.h"
+#include "UnitTest.h"
+
+namespace
+{
+    // 1024x1024, one byte per texel, the last four mips always resident.
+    StreamedTextureDesc MakeDesc()
+    {
+        StreamedTextureDesc desc = {};
+        desc.width = 1024;
+        desc.height = 1024;
+        desc.mipCount = 11;
+        desc.tailMipCount = 4;
+        for (uint32_t mip = 0; mip < desc.mipCount; mip++)
+        {
+            desc.mipBytes[mip] = static_cast<uint64_t>(1024 >> mip) * (1024 >> mip);
+        }
+        return desc;
+    }
+
+    uint64_t BytesFrom(const StreamedTextureDesc& desc, uint32_t mip)
+    {
+        uint64_t bytes = 0;
+        for (; mip < desc.mipCount; mip++)
+        {
+            bytes += desc.mipBytes[mip];
+        }
+        return bytes;
+    }
+
+    void TestLoadsUnderBudget()
+    {
+        const StreamedTextureDesc desc = MakeDesc();
+        TextureResidencyManager residency;
+        const uint32_t high = residency.AddTexture(desc);
+        const uint32_t low = residency.AddTexture(desc);
+        CHECK(residency.GetResidentMip(high) == 7);
+        CHECK(residency.GetStats().residentBytes == 2 * BytesFrom(desc, 7));
+
+        residency.SetDesiredMip(high, 0, 2.0f);
+        residency.SetDesiredMip(low, 0, 1.0f);
+        for (int update = 0; update < 10; update++)
+        {
+            residency.Update(1500000, 2000000);
+        }
+
+        // Mip 0 of one texture alone is 1MB: the important one gets it, the
+        // other one what is left.
+        CHECK(residency.GetResidentMip(high) == 0);
+        CHECK(residency.GetResidentMip(low) == 2);
+        CHECK(residency.GetStats().residentBytes == BytesFrom(desc, 0) + BytesFrom(desc, 2));
+        CHECK(residency.GetStats().residentBytes <= 1500000);
+
+        // A shrinking budget takes from the less important texture first,
+        // down to its tail, before touching the other one.
+        residency.Update(1200000, 2000000);
+        CHECK(residency.GetResidentMip(low) == 7);
+        CHECK(residency.GetResidentMip(high) == 1);
+        CHECK(residency.GetStats().budgetOvershootBytes == 0);
+    }
+
+    // A texture that failed to stream counts what it actually holds, and
+    // stays out of loading and eviction.
+    void TestUnloadable()
+    {
+        const StreamedTextureDesc desc = MakeDesc();
+        TextureResidencyManager residency;
+        const uint32_t broken = residency.AddTexture(desc);
+        const uint32_t other = residency.AddTexture(desc);
+        residency.SetDesiredMip(broken, 0, 1.0f);
+        residency.Update(UINT64_MAX, UINT64_MAX);
+        CHECK(residency.GetResidentMip(broken) == 0);
+
+        // The upload of mips 0 to 6 never landed; the tail still is.
+        residency.MarkUnloadable(broken, 7);
+        CHECK(residency.GetResidentMip(broken) == 7);
+        CHECK(residency.GetStats().residentBytes == 2 * BytesFrom(desc, 7));
+
+        residency.SetDesiredMip(broken, 0, 10.0f);
+        residency.SetDesiredMip(other, 3, 1.0f);
+        residency.Update(UINT64_MAX, UINT64_MAX);
+        CHECK(residency.GetResidentMip(broken) == 7);
+        for (const ResidencyAction& action : residency.GetActions())
+        {
+            CHECK(action.texture != broken);
+        }
+        CHECK(residency.GetStats().residentBytes == BytesFrom(desc, 7) + BytesFrom(desc, 3));
+
+        // Not even its tail arrived.
+        residency.MarkUnloadable(broken, desc.mipCount);
+        CHECK(residency.GetStats().residentBytes == BytesFrom(desc, 3));
+
+        residency.Update(0, UINT64_MAX);
+        CHECK(residency.GetResidentMip(other) == 7);
+        CHECK(residency.GetResidentMip(broken) == desc.mipCount);
+        CHECK(residency.GetStats().residentBytes == BytesFrom(desc, 7));
+    }
+
+    void TestComputeDesiredMip()
+    {
+        CHECK(TextureResidencyManager::ComputeDesiredMip(1024, 1024, 1024.0f, 1024.0f) == 0);
+        CHECK(TextureResidencyManager::ComputeDesiredMip(1024, 1024, 256.0f, 512.0f) == 2);
+        CHECK(TextureResidencyManager::ComputeDesiredMip(1024, 1024, 0.0f, 0.0f) == MaxStreamedMips - 1);
+    }
+}
+
+int main()
+{
+    TestLoadsUnderBudget();
+    TestUnloadable();
+    TestComputeDesiredMip();
+    return TestFailures();
+}
@@ -0,0 +1,219 @@
+#include "stdafx.h"
+#include "TextureStreamer.h"
+#include "D3D12MemoryTracking.h"
+
+namespace
+{
+    // Where each subresource of a tail goes in staging memory. Shared between
+    // the load and record functions of one request.
+    struct TailUploadLayout
+    {
+        std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> footprints;
+        UINT64 totalBytes;
+    };
+
+    bool IsBlockAligned(const DDSTextureInfo& info, UINT mip)
+    {
+        bool blockCompressed = false;
+        GetDDSFormatBytes(info.format, &blockCompressed);
+        if (!blockCompressed)
+        {
+            return true;
+        }
+
+        // Block compressed resources need their top mip to be whole blocks.
+        const UINT width = max(info.width >> mip, 1u);
+        const UINT height = max(info.height >> mip, 1u);
+        return width % 4 == 0 && height % 4 == 0;
+    }
+}
+
+TextureStreamer::TextureStreamer(ID3D12Device* pDevice, AssetStreamer& assetStreamer) :
+    _device(pDevice),
+    _assetStreamer(assetStreamer)
+{
+}
+
+UINT TextureStreamer::AddTexture(LPCWSTR filename)
+{
+    Texture texture = {};
+    texture.file.reset(new MappedFile());
+    texture.file->Open(filename);
+    if (!ReadDDSHeader(texture.file->GetData(), static_cast<size_t>(texture.file->GetSize()), &texture.info))
+    {
+        ThrowIfFailed(E_INVALIDARG);
+    }
+    texture.info.mipCount = min(texture.info.mipCount, MaxStreamedMips);
+
+    StreamedTextureDesc desc = {};
+    desc.width = texture.info.width;
+    desc.height = texture.info.height;
+    desc.mipCount = texture.info.mipCount;
+    for (UINT mip = 0; mip < desc.mipCount; mip++)
+    {
+        desc.mipBytes[mip] = GetDDSMipSize(texture.info, mip);
+    }
+
+    // The tail starts at the finest mip that is still worth streaming on its
+    // own and that a resource can start with.
+    UINT firstTailMip = 0;
+    while (firstTailMip + 1 < desc.mipCount &&
+        desc.mipBytes[firstTailMip + 1] >= TailMipBytes &&
+        IsBlockAligned(texture.info, firstTailMip + 1))
+    {
+        firstTailMip++;
+    }
+    desc.tailMipCount = desc.mipCount - firstTailMip;
+
+    const UINT index = _residency.AddTexture(desc);
+    texture.residentMip = desc.mipCount;
+    texture.pendingMip = desc.mipCount;
+    _textures.push_back(std::move(texture));
+
+    RequestTail(index, _residency.GetResidentMip(index));
+    return index;
+}
+
+void TextureStreamer::SetDesiredMip(UINT texture, UINT mip, float priority)
+{
+    _residency.SetDesiredMip(texture, mip, priority);
+}
+
+void TextureStreamer::Update(UINT64 budgetBytes)
+{
+    _retired.clear();
+
+    _residency.Update(budgetBytes, MaxBytesPerUpdate);
+
+    // Only one upload per texture is in flight: the copy queue may still write
+    // into the pending resource. Textures that moved again meanwhile catch up
+    // once it landed.
+    for (UINT i = 0; i < _textures.size(); i++)
+    {
+        const Texture& texture = _textures[i];
+        const UINT mip = _residency.GetResidentMip(i);
+        if (!texture.pending && !texture.failed && mip != texture.residentMip)
+        {
+            RequestTail(i, mip);
+        }
+    }
+}
+
+void TextureStreamer::OnAssetsStreamed()
+{
+    for (UINT64 assetId : _assetStreamer.GetCompleted())
+    {
+        const UINT index = static_cast<UINT>(assetId >> 32);
+        if (index >= _textures.size() || static_cast<UINT>(assetId) != _textures[index].generation)
+        {
+            continue;
+        }
+
+        Texture& texture = _textures[index];
+        _retired.push_back(std::move(texture.resource));
+        texture.resource = std::move(texture.pending);
+        texture.residentMip = texture.pendingMip;
+    }
+
+    for (UINT64 assetId : _assetStreamer.GetFailed())
+    {
+        const UINT index = static_cast<UINT>(assetId >> 32);
+        if (index >= _textures.size() || static_cast<UINT>(assetId) != _textures[index].generation)
+        {
+            continue;
+        }
+
+        // A truncated file stays broken; keep whatever was resident before,
+        // and have residency count that instead of the mip it asked for.
+        Texture& texture = _textures[index];
+        texture.pending.Reset();
+        texture.failed = true;
+        _residency.MarkUnloadable(index, texture.residentMip);
+    }
+}
+
+// Creates a resource holding mips [mip, mipCount) of the texture and streams
+// them into it.
+void TextureStreamer::RequestTail(UINT index, UINT mip)
+{
+    Texture& texture = _textures[index];
+    const DDSTextureInfo info = texture.info;
+    const UINT mipCount = info.mipCount - mip;
+    const UINT subresourceCount = mipCount * info.arraySize;
+
+    const CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_DEFAULT);
+    const CD3DX12_RESOURCE_DESC desc = CD3DX12_RESOURCE_DESC::Tex2D(
+        static_cast<DXGI_FORMAT>(info.format),
+        max(info.width >> mip, 1u),
+        max(info.height >> mip, 1u),
+        static_cast<UINT16>(info.arraySize),
+        static_cast<UINT16>(mipCount));
+
+    // The copy queue only accepts resources in the COMMON state.
+    ComPtr<ID3D12Resource> resource;
+    ThrowIfFailed(_device->CreateCommittedResource(
+        &heapProperties,
+        D3D12_HEAP_FLAG_NONE,
+        &desc,
+        D3D12_RESOURCE_STATE_COMMON,
+        nullptr,
+        IID_PPV_ARGS(&resource)));
+    TrackD3D12Resource(_device, resource.Get(), MemoryCategory::Texture, "StreamedTexture");
+
+    std::shared_ptr<TailUploadLayout> layout = std::make_shared<TailUploadLayout>();
+    layout->footprints.resize(subresourceCount);
+    _device->GetCopyableFootprints(&desc, 0, subresourceCount, 0, layout->footprints.data(), nullptr, nullptr, &layout->totalBytes);
+
+    texture.pending = resource;
+    texture.pendingMip = mip;
+    texture.generation++;
+
+    const MappedFile* pFile = texture.file.get();
+
+    StreamingRequest request;
+    request.assetId = (static_cast<UINT64>(index) << 32) | texture.generation;
+    // First the tail of new textures, then coarse mips before fine ones.
+    request.priority = texture.resource ? static_cast<int>(mip) : INT_MAX;
+    request.stagingBytes = layout->totalBytes;
+    request.stagingAlignment = D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT;
+
+    request.load = [pFile, info, mip, mipCount, layout](UINT8* pStaging)
+    {
+        for (UINT slice = 0; slice < info.arraySize; slice++)
+        {
+            for (UINT level = 0; level < mipCount; level++)
+            {
+                const DDSSubresourceLayout source = GetDDSSubresourceLayout(info, mip + level, slice);
+                if (source.offset + source.size > pFile->GetSize())
+                {
+                    return false;
+                }
+
+                const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& footprint = layout->footprints[level + slice * mipCount];
+                const UINT8* pSource = pFile->GetData() + source.offset;
+                UINT8* pDestination = pStaging + footprint.Offset;
+                for (UINT row = 0; row < source.rowCount; row++)
+                {
+                    memcpy(pDestination + row * footprint.Footprint.RowPitch, pSource + row * source.rowPitch, source.rowPitch);
+                }
+            }
+        }
+        return true;
+    };
+
+    request.record = [resource, layout](void* pCopyContext, UINT64 stagingOffset)
+    {
+        const D3D12CopyContext* pContext = static_cast<const D3D12CopyContext*>(pCopyContext);
+        for (UINT i = 0; i < layout->footprints.size(); i++)
+        {
+            D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint = layout->footprints[i];
+            footprint.Offset += stagingOffset;
+
+            const CD3DX12_TEXTURE_COPY_LOCATION destination(resource.Get(), i);
+            const CD3DX12_TEXTURE_COPY_LOCATION source(pContext->pStagingBuffer, footprint);
+            pContext->pCommandList->CopyTextureRegion(&destination, 0, 0, 0, &source, nullptr);
+        }
+    };
+
+    _assetStreamer.Request(std::move(request));
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "D3D12CopyQueue.h"
+#include "DDSFile.h"
+#include "MappedFile.h"
+#include "TextureResidency.h"
+
+using Microsoft::WRL::ComPtr;
+
+// Streams the mip chains of DDS textures under a GPU memory budget. Each
+// texture lives in a committed resource holding only its resident mips; when
+// the residency manager moves a texture to another mip, the new tail is read
+// from the memory mapped file, copied on the copy queue into a fresh resource,
+// and swapped in once the copy completed. The old resource is kept until the
+// frame that may still sample it is done.
+class TextureStreamer
+{
+public: TextureStreamer(ID3D12Device* pDevice, AssetStreamer& assetStreamer);
+
+    // Returns the texture index. The coarse tail is requested right away; the
+    // texture has no resource until it arrived.
+public: UINT AddTexture(LPCWSTR filename);
+
+public: void SetDesiredMip(UINT texture, UINT mip, float priority);
+
+    // Runs residency and requests the uploads it asks for. Call once per frame
+    // after the previous frame was retired, with the bytes textures may use.
+public: void Update(UINT64 budgetBytes);
+
+    // Call after AssetStreamer::Update(): textures whose upload finished swap
+    // in their new resources.
+public: void OnAssetsStreamed();
+
+    // Mip 0 of the resource is mip GetResidentMip() of the full chain.
+public: ID3D12Resource* GetResource(UINT texture) const { return _textures[texture].resource.Get(); }
+public: UINT GetResidentMip(UINT texture) const { return _textures[texture].residentMip; }
+
+public: UINT64 GetResidentBytes() const { return _residency.GetStats().residentBytes; }
+public: const TextureResidencyStats& GetStats() const { return _residency.GetStats(); }
+
+    // Bytes of new mips requested per Update(), so one frame never saturates
+    // the copy queue.
+private: static const UINT64 MaxBytesPerUpdate = 16 * 1024 * 1024;
+
+    // Mips smaller than a 64KB tile are not worth streaming individually.
+private: static const UINT64 TailMipBytes = 64 * 1024;
+
+private: struct Texture
+    {
+        std::unique_ptr<MappedFile> file;
+        DDSTextureInfo info;
+        ComPtr<ID3D12Resource> resource;
+        UINT residentMip;
+        ComPtr<ID3D12Resource> pending;
+        UINT pendingMip;
+        UINT generation;
+        bool failed;
+    };
+
+private: void RequestTail(UINT texture, UINT mip);
+
+private: ID3D12Device* _device;
+private: AssetStreamer& _assetStreamer;
+private: TextureResidencyManager _residency;
+private: std::vector<Texture> _textures;
+
+    // Resources replaced during the last frame, released on the next Update().
+private: std::vector<ComPtr<ID3D12Resource>> _retired;
+};
@@ -0,0 +1,129 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+
+ThreadPool::ThreadPool(unsigned threadCount)
+{
+    if (threadCount == 0)
+    {
+        const unsigned hardwareThreads = std::thread::hardware_concurrency();
+        threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+    }
+
+    _threads.reserve(threadCount);
+    for (unsigned i = 0; i < threadCount; i++)
+    {
+        _threads.emplace_back(&ThreadPool::WorkerMain, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _jobAvailable.notify_all();
+
+    for (std::thread& thread : _threads)
+    {
+        thread.join();
+    }
+}
+
+void ThreadPool::Submit(Job job)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _jobs.push_back(std::move(job));
+    }
+    _jobAvailable.notify_one();
+}
+
+void ThreadPool::WaitIdle()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _idle.wait(lock, [this]() { return _jobs.empty() && _running == 0; });
+}
+
+void ThreadPool::ParallelFor(size_t count, size_t minChunk, const std::function<void(size_t begin, size_t end)>& body)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    const size_t workers = _threads.size() + 1;
+    const size_t chunk = std::max(minChunk == 0 ? 1 : minChunk, (count + workers - 1) / workers);
+    const size_t chunkCount = (count + chunk - 1) / chunk;
+    if (chunkCount == 1)
+    {
+        body(0, count);
+        return;
+    }
+
+    // Chunks are claimed from a shared counter so the caller helps out instead
+    // of waiting. Helpers may start late and find nothing left; the state they
+    // share lives on this stack, so we wait for every one of them to leave.
+    const size_t helpers = std::min(_threads.size(), chunkCount - 1);
+    std::atomic<size_t> nextChunk(0);
+    size_t finishedHelpers = 0;
+    std::mutex doneMutex;
+    std::condition_variable doneCondition;
+
+    auto work = [&]()
+    {
+        for (size_t c = nextChunk++; c < chunkCount; c = nextChunk++)
+        {
+            body(c * chunk, std::min(count, (c + 1) * chunk));
+        }
+    };
+
+    for (size_t i = 0; i < helpers; i++)
+    {
+        Submit([&]()
+        {
+            work();
+
+            std::lock_guard<std::mutex> lock(doneMutex);
+            finishedHelpers++;
+            doneCondition.notify_all();
+        });
+    }
+    work();
+
+    std::unique_lock<std::mutex> lock(doneMutex);
+    doneCondition.wait(lock, [&]() { return finishedHelpers == helpers; });
+}
+
+void ThreadPool::WorkerMain()
+{
+    for (;;)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _jobAvailable.wait(lock, [this]() { return _stopping || !_jobs.empty(); });
+            if (_jobs.empty())
+            {
+                return;
+            }
+
+            job = std::move(_jobs.front());
+            _jobs.pop_front();
+            _running++;
+        }
+
+        job();
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _running--;
+            if (_jobs.empty() && _running == 0)
+            {
+                _idle.notify_all();
+            }
+        }
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads consuming a FIFO of jobs.
+class ThreadPool
+{
+public: typedef std::function<void()> Job;
+
+    // threadCount == 0 picks one thread per hardware thread, minus the caller's.
+public: explicit ThreadPool(unsigned threadCount = 0);
+public: ~ThreadPool();
+
+public: ThreadPool(const ThreadPool&) = delete;
+public: ThreadPool& operator=(const ThreadPool&) = delete;
+
+public: void Submit(Job job);
+
+    // Blocks until the queue is empty and no job is running.
+public: void WaitIdle();
+
+    // Runs body(begin, end) over [0, count) split into chunks of at least
+    // minChunk items, using the calling thread as one of the workers.
+public: void ParallelFor(size_t count, size_t minChunk, const std::function<void(size_t begin, size_t end)>& body);
+
+public: unsigned GetThreadCount() const { return static_cast<unsigned>(_threads.size()); }
+
+private: void WorkerMain();
+
+private: std::vector<std::thread> _threads;
+private: std::deque<Job> _jobs;
+private: std::mutex _mutex;
+private: std::condition_variable _jobAvailable;
+private: std::condition_variable _idle;
+private: size_t _running = 0;
+private: bool _stopping = false;
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Hands values from one writer thread to one reader thread without locks. The
+// writer fills the back buffer and publishes it; the reader picks up the most
+// recently published one. Neither side ever waits for the other: three
+// buffers means the writer always has one the reader is not looking at, and
+// a value published before the reader got to the previous one replaces it.
+template <typename T>
+class TripleBuffer
+{
+    // Writer side. Publish() makes the back buffer the newest value and hands
+    // the writer whichever buffer the reader is not holding.
+public: T& GetWriteBuffer() { return _buffers[_back]; }
+public: void Publish()
+    {
+        const uint32_t previous = _middle.exchange(_back | FreshBit, std::memory_order_acq_rel);
+        _back = previous & IndexMask;
+    }
+
+    // Reader side. Acquire() moves to the newest value and returns false when
+    // nothing was published since the last call, leaving the read buffer as is.
+public: bool Acquire()
+    {
+        if ((_middle.load(std::memory_order_relaxed) & FreshBit) == 0)
+        {
+            return false;
+        }
+        const uint32_t previous = _middle.exchange(_front, std::memory_order_acq_rel);
+        _front = previous & IndexMask;
+        return true;
+    }
+public: const T& GetReadBuffer() const { return _buffers[_front]; }
+
+public: bool HasFresh() const { return (_middle.load(std::memory_order_relaxed) & FreshBit) != 0; }
+
+    // The middle word holds the index of the buffer between the two sides and
+    // whether it was published since the reader last took it.
+private: static const uint32_t IndexMask = 0x3;
+private: static const uint32_t FreshBit = 0x4;
+
+private: T _buffers[3];
+private: uint32_t _back = 0;
+private: std::atomic<uint32_t> _middle{ 1 };
+private: uint32_t _front = 2;
+};
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdio>
+
+// Just enough for the module tests. Each *Tests.cpp is an executable that
+// runs its test functions from main() and returns TestFailures(), which is
+// what ctest looks at. A failed CHECK() prints where and carries on.
+inline int& TestFailures()
+{
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(condition) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            fprintf(stderr, "%s(%d): CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            TestFailures()++; \
+        } \
+    } while (false)
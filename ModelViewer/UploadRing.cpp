@@ -0,0 +1,107 @@
+#include "UploadRing.h"
+
+namespace
+{
+    inline uint64_t AlignUp(uint64_t value, uint64_t alignment)
+    {
+        return (value + (alignment - 1)) & ~(alignment - 1);
+    }
+}
+
+UploadRing::UploadRing(uint64_t capacity)
+{
+    Reset(capacity);
+}
+
+void UploadRing::Reset(uint64_t capacity)
+{
+    _capacity = capacity;
+    _head = 0;
+    _tail = 0;
+    _allocatedTotal = 0;
+    _retiredTotal = 0;
+    _frames.clear();
+}
+
+bool UploadRing::Allocate(uint64_t size, uint64_t alignment, uint64_t* pOffset)
+{
+    if (alignment == 0)
+    {
+        alignment = 1;
+    }
+
+    const uint64_t used = GetUsedSize();
+    if (size == 0 || size > _capacity || used + size > _capacity)
+    {
+        return false;
+    }
+
+    if (used == 0 && _frames.empty())
+    {
+        // Nothing is in flight, so both ends can move back to the start.
+        _head = 0;
+        _tail = 0;
+    }
+
+    uint64_t offset = AlignUp(_head, alignment);
+    uint64_t newHead = 0;
+
+    if (_head >= _tail)
+    {
+        // Free space is [head, capacity) followed by [0, tail).
+        if (offset + size <= _capacity)
+        {
+            newHead = offset + size;
+        }
+        else if (size <= _tail)
+        {
+            // Skip the remainder of the buffer and start again from zero.
+            offset = 0;
+            newHead = size;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    else
+    {
+        // Free space is [head, tail).
+        if (offset + size > _tail)
+        {
+            return false;
+        }
+        newHead = offset + size;
+    }
+
+    const uint64_t consumed = (newHead >= _head) ? newHead - _head : (_capacity - _head) + newHead;
+    if (used + consumed > _capacity)
+    {
+        return false;
+    }
+
+    _allocatedTotal += consumed;
+    _head = (newHead == _capacity) ? 0 : newHead;
+
+    *pOffset = offset;
+    return true;
+}
+
+void UploadRing::EndFrame(uint64_t fenceValue)
+{
+    FrameMarker marker;
+    marker.fenceValue = fenceValue;
+    marker.head = _head;
+    marker.allocatedTotal = _allocatedTotal;
+    _frames.push_back(marker);
+}
+
+void UploadRing::Retire(uint64_t completedFenceValue)
+{
+    while (!_frames.empty() && _frames.front().fenceValue <= completedFenceValue)
+    {
+        _tail = _frames.front().head;
+        _retiredTotal = _frames.front().allocatedTotal;
+        _frames.pop_front();
+    }
+}
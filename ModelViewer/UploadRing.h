@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+
+// Ring allocator for transient per-frame data living in a persistently mapped
+// upload buffer. Only offsets are managed here so the policy does not depend on
+// D3D12; the owner of the buffer turns an offset into a CPU pointer and a GPU
+// virtual address.
+//
+// Allocations made between two EndFrame() calls belong to that frame and are
+// released together once the GPU has passed the fence value of the frame.
+class UploadRing
+{
+public: explicit UploadRing(uint64_t capacity = 0);
+
+public: void Reset(uint64_t capacity);
+
+    // Returns false when the ring has no room left for the request; callers are
+    // expected to wait for the GPU and Retire() before trying again.
+public: bool Allocate(uint64_t size, uint64_t alignment, uint64_t* pOffset);
+
+    // Closes the current frame, tagging everything allocated since the previous
+    // call with the fence value that will be signaled after it.
+public: void EndFrame(uint64_t fenceValue);
+
+    // Releases every frame whose fence value is less or equal to completedFenceValue.
+public: void Retire(uint64_t completedFenceValue);
+
+public: uint64_t GetCapacity() const { return _capacity; }
+public: uint64_t GetUsedSize() const { return _allocatedTotal - _retiredTotal; }
+
+private: struct FrameMarker
+    {
+        uint64_t fenceValue;
+        uint64_t head;
+        uint64_t allocatedTotal;
+    };
+
+private: uint64_t _capacity;
+private: uint64_t _head;
+private: uint64_t _tail;
+
+    // Running byte counters, including alignment padding and the bytes skipped
+    // when an allocation wraps around. Their difference is the used size.
+private: uint64_t _allocatedTotal;
+private: uint64_t _retiredTotal;
+
+private: std::deque<FrameMarker> _frames;
+};
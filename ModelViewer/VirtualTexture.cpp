@@ -0,0 +1,336 @@
+#include "VirtualTexture.h"
+
+#include <algorithm>
+
+void VirtualPageTable::Reset(const VirtualTextureDesc& desc)
+{
+    _desc = desc;
+    _tiles.assign(desc.tileCount, Tile{ InvalidVirtualPage, TileState::Free, 0, NullTile, NullTile });
+    _lruHead = NullTile;
+    _lruTail = NullTile;
+
+    // Popped from the back, so tile 0 is handed out first.
+    _freeTiles.clear();
+    for (uint32_t tile = desc.tileCount; tile > 0; tile--)
+    {
+        _freeTiles.push_back(tile - 1);
+    }
+
+    _pageToTile.clear();
+    _requested.clear();
+    _pendingRegions.clear();
+    _loads.clear();
+    _frame = 1;
+    _stats = VirtualTextureStats();
+}
+
+bool VirtualPageTable::IsInside(VirtualPageId page) const
+{
+    const uint32_t mip = GetVirtualPageMip(page);
+    if (page == InvalidVirtualPage || mip >= _desc.mipCount)
+    {
+        return false;
+    }
+    const uint32_t round = (1u << mip) - 1;
+    return GetVirtualPageX(page) < ((_desc.widthInPages + round) >> mip) &&
+        GetVirtualPageY(page) < ((_desc.heightInPages + round) >> mip);
+}
+
+void VirtualPageTable::AddFeedback(const VirtualPageId* pPages, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!IsInside(pPages[i]))
+        {
+            continue;
+        }
+
+        // Stop climbing once a page was already requested: its parents are too.
+        VirtualPageId page = pPages[i];
+        while (_requested.insert(page).second)
+        {
+            std::unordered_map<VirtualPageId, uint32_t>::const_iterator found = _pageToTile.find(page);
+            if (found != _pageToTile.end())
+            {
+                Touch(found->second);
+            }
+
+            const uint32_t mip = GetVirtualPageMip(page);
+            if (mip + 1 >= _desc.mipCount)
+            {
+                break;
+            }
+            page = MakeVirtualPageId(mip + 1, GetVirtualPageX(page) / 2, GetVirtualPageY(page) / 2);
+        }
+    }
+}
+
+void VirtualPageTable::Touch(uint32_t tile)
+{
+    _tiles[tile].lastUsedFrame = _frame;
+    Unlink(tile);
+    LinkAtTail(tile);
+}
+
+void VirtualPageTable::Unlink(uint32_t tile)
+{
+    Tile& t = _tiles[tile];
+    if (t.previous != NullTile)
+    {
+        _tiles[t.previous].next = t.next;
+    }
+    else
+    {
+        _lruHead = t.next;
+    }
+    if (t.next != NullTile)
+    {
+        _tiles[t.next].previous = t.previous;
+    }
+    else
+    {
+        _lruTail = t.previous;
+    }
+    t.previous = NullTile;
+    t.next = NullTile;
+}
+
+void VirtualPageTable::LinkAtTail(uint32_t tile)
+{
+    Tile& t = _tiles[tile];
+    t.previous = _lruTail;
+    t.next = NullTile;
+    if (_lruTail != NullTile)
+    {
+        _tiles[_lruTail].next = tile;
+    }
+    else
+    {
+        _lruHead = tile;
+    }
+    _lruTail = tile;
+}
+
+// A free tile, or the least recently used resident one the current feedback
+// does not need. NullTile when every tile is needed or still loading.
+uint32_t VirtualPageTable::AllocateTile()
+{
+    if (!_freeTiles.empty())
+    {
+        const uint32_t tile = _freeTiles.back();
+        _freeTiles.pop_back();
+        return tile;
+    }
+
+    for (uint32_t tile = _lruHead; tile != NullTile; tile = _tiles[tile].next)
+    {
+        if (_tiles[tile].state == TileState::Resident && _tiles[tile].lastUsedFrame != _frame)
+        {
+            Unlink(tile);
+            return tile;
+        }
+    }
+    return NullTile;
+}
+
+void VirtualPageTable::Update(TileMapper& mapper, uint32_t maxNewPages)
+{
+    _missing.clear();
+    for (VirtualPageId page : _requested)
+    {
+        if (_pageToTile.find(page) == _pageToTile.end())
+        {
+            _missing.push_back(page);
+        }
+    }
+
+    // Coarse mips first: they are the fallback of everything finer.
+    std::sort(_missing.begin(), _missing.end(), [](VirtualPageId a, VirtualPageId b)
+    {
+        if (GetVirtualPageMip(a) != GetVirtualPageMip(b))
+        {
+            return GetVirtualPageMip(a) > GetVirtualPageMip(b);
+        }
+        return a < b;
+    });
+
+    _loads.clear();
+    _stats.mappedLastUpdate = 0;
+    _stats.evictedLastUpdate = 0;
+
+    for (VirtualPageId page : _missing)
+    {
+        if (_stats.mappedLastUpdate >= maxNewPages)
+        {
+            break;
+        }
+
+        const uint32_t tile = AllocateTile();
+        if (tile == NullTile)
+        {
+            break;
+        }
+
+        Tile& t = _tiles[tile];
+        if (t.state != TileState::Free)
+        {
+            const VirtualPageId evicted = t.page;
+            _pageToTile.erase(evicted);
+            _pendingRegions.push_back({ GetVirtualPageMip(evicted), GetVirtualPageX(evicted), GetVirtualPageY(evicted), 1, NullTile });
+            _stats.residentPages--;
+            _stats.evictedLastUpdate++;
+        }
+
+        t.page = page;
+        t.state = TileState::Loading;
+        t.lastUsedFrame = _frame;
+        LinkAtTail(tile);
+        _pageToTile[page] = tile;
+
+        _pendingRegions.push_back({ GetVirtualPageMip(page), GetVirtualPageX(page), GetVirtualPageY(page), 1, tile });
+        _loads.push_back({ page, tile });
+        _stats.loadingPages++;
+        _stats.mappedLastUpdate++;
+    }
+
+    FlushMappings(mapper);
+
+    _stats.requestedPages = static_cast<uint32_t>(_requested.size());
+    _stats.missingPages = static_cast<uint32_t>(_missing.size()) - _stats.mappedLastUpdate;
+    _stats.totalMapped += _stats.mappedLastUpdate;
+    _stats.totalEvicted += _stats.evictedLastUpdate;
+
+    _requested.clear();
+    _frame++;
+}
+
+// Sends all mapping changes as one batch. Neighbouring pages of a row going to
+// neighbouring tiles, or all being unmapped, share a region.
+void VirtualPageTable::FlushMappings(TileMapper& mapper)
+{
+    std::sort(_pendingRegions.begin(), _pendingRegions.end(), [](const TileMappingRegion& a, const TileMappingRegion& b)
+    {
+        if (a.mip != b.mip)
+        {
+            return a.mip < b.mip;
+        }
+        if (a.y != b.y)
+        {
+            return a.y < b.y;
+        }
+        return a.x < b.x;
+    });
+
+    _regions.clear();
+    for (const TileMappingRegion& region : _pendingRegions)
+    {
+        if (!_regions.empty())
+        {
+            TileMappingRegion& last = _regions.back();
+            const bool adjacent = last.mip == region.mip && last.y == region.y && last.x + last.width == region.x;
+            const bool contiguous = last.firstTile == NullTile ? region.firstTile == NullTile :
+                region.firstTile != NullTile && last.firstTile + last.width == region.firstTile;
+            if (adjacent && contiguous)
+            {
+                last.width++;
+                continue;
+            }
+        }
+        _regions.push_back(region);
+    }
+    _pendingRegions.clear();
+
+    _stats.regionsLastUpdate = static_cast<uint32_t>(_regions.size());
+    if (!_regions.empty())
+    {
+        mapper.UpdateTileMappings(_regions.data(), _regions.size());
+    }
+}
+
+void VirtualPageTable::OnPageLoaded(VirtualPageId page)
+{
+    std::unordered_map<VirtualPageId, uint32_t>::const_iterator found = _pageToTile.find(page);
+    if (found == _pageToTile.end() || _tiles[found->second].state != TileState::Loading)
+    {
+        return;
+    }
+
+    _tiles[found->second].state = TileState::Resident;
+    _stats.loadingPages--;
+    _stats.residentPages++;
+}
+
+void VirtualPageTable::OnPageFailed(TileMapper& mapper, VirtualPageId page)
+{
+    std::unordered_map<VirtualPageId, uint32_t>::const_iterator found = _pageToTile.find(page);
+    if (found == _pageToTile.end() || _tiles[found->second].state != TileState::Loading)
+    {
+        return;
+    }
+
+    const uint32_t tile = found->second;
+    _pageToTile.erase(found);
+    Unlink(tile);
+    _tiles[tile].page = InvalidVirtualPage;
+    _tiles[tile].state = TileState::Free;
+    _freeTiles.push_back(tile);
+    _stats.loadingPages--;
+
+    const TileMappingRegion region = { GetVirtualPageMip(page), GetVirtualPageX(page), GetVirtualPageY(page), 1, NullTile };
+    mapper.UpdateTileMappings(&region, 1);
+}
+
+bool VirtualPageTable::IsResident(VirtualPageId page) const
+{
+    std::unordered_map<VirtualPageId, uint32_t>::const_iterator found = _pageToTile.find(page);
+    return found != _pageToTile.end() && _tiles[found->second].state == TileState::Resident;
+}
+
+void VirtualPageTable::BuildResidencyMap(std::vector<uint8_t>* pMinMip) const
+{
+    pMinMip->assign(static_cast<size_t>(_desc.widthInPages) * _desc.heightInPages, static_cast<uint8_t>(_desc.mipCount));
+
+    for (uint32_t y = 0; y < _desc.heightInPages; y++)
+    {
+        for (uint32_t x = 0; x < _desc.widthInPages; x++)
+        {
+            uint8_t& minMip = (*pMinMip)[y * _desc.widthInPages + x];
+            for (uint32_t mip = _desc.mipCount; mip > 0; mip--)
+            {
+                if (!IsResident(MakeVirtualPageId(mip - 1, x >> (mip - 1), y >> (mip - 1))))
+                {
+                    break;
+                }
+                minMip = static_cast<uint8_t>(mip - 1);
+            }
+        }
+    }
+}
+
+void SimulatedTileMapper::UpdateTileMappings(const TileMappingRegion* pRegions, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        const TileMappingRegion& region = pRegions[i];
+        for (uint32_t page = 0; page < region.width; page++)
+        {
+            const VirtualPageId id = MakeVirtualPageId(region.mip, region.x + page, region.y);
+            if (region.firstTile == NullTile)
+            {
+                _mappings.erase(id);
+            }
+            else
+            {
+                _mappings[id] = region.firstTile + page;
+            }
+        }
+    }
+    _calls++;
+    _regionCount += count;
+}
+
+uint32_t SimulatedTileMapper::GetTile(VirtualPageId page) const
+{
+    std::unordered_map<VirtualPageId, uint32_t>::const_iterator found = _mappings.find(page);
+    return found != _mappings.end() ? found->second : NullTile;
+}
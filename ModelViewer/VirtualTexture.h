@@ -0,0 +1,162 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// A page of a virtual texture: one 64KB tile of one mip. Packed the same way
+// the feedback pass writes it: mip in the top 4 bits, then y and x in 14 bits.
+typedef uint32_t VirtualPageId;
+
+static const VirtualPageId InvalidVirtualPage = 0xffffffff;
+static const uint32_t NullTile = 0xffffffff;
+
+inline VirtualPageId MakeVirtualPageId(uint32_t mip, uint32_t x, uint32_t y)
+{
+    return (mip << 28) | ((y & 0x3fff) << 14) | (x & 0x3fff);
+}
+
+inline uint32_t GetVirtualPageMip(VirtualPageId page) { return page >> 28; }
+inline uint32_t GetVirtualPageX(VirtualPageId page) { return page & 0x3fff; }
+inline uint32_t GetVirtualPageY(VirtualPageId page) { return (page >> 14) & 0x3fff; }
+
+// width pages of one row of a mip, mapped to the consecutive pool tiles
+// starting at firstTile, or unmapped when firstTile is NullTile.
+struct TileMappingRegion
+{
+    uint32_t mip;
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t firstTile;
+};
+
+// Whatever applies mapping changes: UpdateTileMappings for D3D12, a plain
+// table for SimulatedTileMapper.
+class TileMapper
+{
+public: virtual ~TileMapper() {}
+
+public: virtual void UpdateTileMappings(const TileMappingRegion* pRegions, size_t count) = 0;
+};
+
+// A page that was just mapped and needs its contents copied into its tile.
+struct PageLoad
+{
+    VirtualPageId page;
+    uint32_t tile;
+};
+
+struct VirtualTextureDesc
+{
+    uint32_t widthInPages;      // Of mip 0.
+    uint32_t heightInPages;
+    uint32_t mipCount;          // Mips made of whole tiles; the packed tail is not paged.
+    uint32_t tileCount;         // Size of the physical tile pool.
+};
+
+struct VirtualTextureStats
+{
+    uint32_t residentPages;
+    uint32_t loadingPages;
+    uint32_t requestedPages;            // Distinct pages in the last feedback, parents included.
+    uint32_t missingPages;              // Requested but not resident after the last Update().
+    uint32_t mappedLastUpdate;
+    uint32_t evictedLastUpdate;
+    uint32_t regionsLastUpdate;         // After coalescing mappings into rows.
+    uint64_t totalMapped;
+    uint64_t totalEvicted;
+};
+
+// CPU side of a sparse virtual texture: which virtual pages live in which
+// tiles of a fixed physical pool. Feedback names the pages the last frame
+// wanted; Update() maps the missing ones, coarse mips first, recycling the
+// least recently used tiles no page of the current feedback needs, and hands
+// the mapping changes to the TileMapper in one batch. A page requested also
+// keeps its coarser parents, so trilinear filtering always has a resident
+// fallback. Pages being loaded are never evicted.
+class VirtualPageTable
+{
+public: void Reset(const VirtualTextureDesc& desc);
+
+    // Feedback of one frame; InvalidVirtualPage entries and pages outside the
+    // texture are skipped, duplicates are fine.
+public: void AddFeedback(const VirtualPageId* pPages, size_t count);
+
+public: void Update(TileMapper& mapper, uint32_t maxNewPages);
+
+    // Pages mapped by the last Update(). Report each back once its contents
+    // are in place, or when they could not be loaded.
+public: const std::vector<PageLoad>& GetLoads() const { return _loads; }
+public: void OnPageLoaded(VirtualPageId page);
+public: void OnPageFailed(TileMapper& mapper, VirtualPageId page);
+
+public: bool IsResident(VirtualPageId page) const;
+
+    // One byte per mip 0 page: the finest mip that is resident there together
+    // with every coarser paged mip, or mipCount when none is. Meant as a
+    // MinLOD clamp so sampling never touches unmapped tiles.
+public: void BuildResidencyMap(std::vector<uint8_t>* pMinMip) const;
+
+public: const VirtualTextureStats& GetStats() const { return _stats; }
+
+private: enum class TileState : uint8_t
+    {
+        Free,
+        Loading,
+        Resident,
+    };
+
+    // Physical tiles form a doubly linked LRU list; the head is the tile used
+    // least recently.
+private: struct Tile
+    {
+        VirtualPageId page;
+        TileState state;
+        uint32_t lastUsedFrame;
+        uint32_t previous;
+        uint32_t next;
+    };
+
+private: bool IsInside(VirtualPageId page) const;
+private: void Request(VirtualPageId page);
+private: void Touch(uint32_t tile);
+private: void Unlink(uint32_t tile);
+private: void LinkAtTail(uint32_t tile);
+private: uint32_t AllocateTile();
+private: void FlushMappings(TileMapper& mapper);
+
+private: VirtualTextureDesc _desc = {};
+private: std::vector<Tile> _tiles;
+private: uint32_t _lruHead = NullTile;
+private: uint32_t _lruTail = NullTile;
+private: std::vector<uint32_t> _freeTiles;
+private: std::unordered_map<VirtualPageId, uint32_t> _pageToTile;
+
+private: uint32_t _frame = 1;
+private: std::unordered_set<VirtualPageId> _requested;
+private: std::vector<VirtualPageId> _missing;
+private: std::vector<TileMappingRegion> _pendingRegions;
+private: std::vector<TileMappingRegion> _regions;
+private: std::vector<PageLoad> _loads;
+private: VirtualTextureStats _stats = {};
+};
+
+// Applies mapping batches to an in-memory table, standing in for the GPU when
+// exercising the page table.
+class SimulatedTileMapper : public TileMapper
+{
+public: virtual void UpdateTileMappings(const TileMappingRegion* pRegions, size_t count);
+
+    // NullTile for unmapped pages.
+public: uint32_t GetTile(VirtualPageId page) const;
+public: size_t GetMappedPageCount() const { return _mappings.size(); }
+public: uint64_t GetCallCount() const { return _calls; }
+public: uint64_t GetRegionCount() const { return _regionCount; }
+
+private: std::unordered_map<VirtualPageId, uint32_t> _mappings;
+private: uint64_t _calls = 0;
+private: uint64_t _regionCount = 0;
+};
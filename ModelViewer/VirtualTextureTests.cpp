@@ -0,0 +1,233 @@
+#include "VirtualTexture.h"
+#include "UnitTest.h"
+
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+    // Counts what goes through the mapper while keeping its table.
+    class CountingTileMapper : public SimulatedTileMapper
+    {
+    public: virtual void UpdateTileMappings(const TileMappingRegion* pRegions, size_t count)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                CHECK(pRegions[i].width > 0);
+                pages += pRegions[i].width;
+            }
+            SimulatedTileMapper::UpdateTileMappings(pRegions, count);
+        }
+
+    public: uint64_t pages = 0;
+    };
+
+    uint32_t Random(uint32_t* pState)
+    {
+        *pState = *pState * 1664525u + 1013904223u;
+        return *pState >> 8;
+    }
+
+    // What the GPU sees must match the table: every page the table holds is
+    // mapped to its own tile, and nothing else is mapped.
+    void CheckMappings(const VirtualPageTable& table, const SimulatedTileMapper& mapper, const VirtualTextureDesc& desc)
+    {
+        const VirtualTextureStats& stats = table.GetStats();
+        CHECK(mapper.GetMappedPageCount() == stats.residentPages + stats.loadingPages);
+        CHECK(stats.residentPages + stats.loadingPages <= desc.tileCount);
+
+        std::vector<bool> used(desc.tileCount, false);
+        uint32_t resident = 0;
+        for (uint32_t mip = 0; mip < desc.mipCount; mip++)
+        {
+            for (uint32_t y = 0; y < desc.heightInPages >> mip; y++)
+            {
+                for (uint32_t x = 0; x < desc.widthInPages >> mip; x++)
+                {
+                    const VirtualPageId page = MakeVirtualPageId(mip, x, y);
+                    const uint32_t tile = mapper.GetTile(page);
+                    if (tile == NullTile)
+                    {
+                        CHECK(!table.IsResident(page));
+                        continue;
+                    }
+                    CHECK(tile < desc.tileCount);
+                    CHECK(tile < desc.tileCount && !used[tile]);
+                    if (tile < desc.tileCount)
+                    {
+                        used[tile] = true;
+                    }
+                    resident += table.IsResident(page) ? 1 : 0;
+                }
+            }
+        }
+        CHECK(resident == stats.residentPages);
+    }
+
+    // A camera panning across a 64x64 page texture for 200 frames with a pool
+    // too small for everything it passed over. Each frame's feedback is a
+    // window of pages over three mips plus garbage, one load in fifty fails.
+    void TestPanningCamera()
+    {
+        const VirtualTextureDesc desc = { 64, 64, 7, 300 };
+        const uint32_t maxNewPages = 32;
+        VirtualPageTable table;
+        table.Reset(desc);
+        CountingTileMapper mapper;
+
+        uint32_t random = 5;
+        uint64_t failures = 0;
+        uint64_t changes = 0;
+        uint64_t regions = 0;
+        uint32_t batches = 0;
+        std::vector<VirtualPageId> feedback;
+        std::vector<VirtualPageId> wanted;
+        for (uint32_t frame = 0; frame < 200; frame++)
+        {
+            feedback.clear();
+            const uint32_t centerX = (frame * 2) % 56;
+            const uint32_t centerY = frame % 56;
+            for (int i = 0; i < 400; i++)
+            {
+                const uint32_t mip = Random(&random) % 3;
+                const uint32_t x = (centerX + Random(&random) % 8) >> mip;
+                const uint32_t y = (centerY + Random(&random) % 8) >> mip;
+                feedback.push_back(MakeVirtualPageId(mip, x, y));
+            }
+            feedback.push_back(InvalidVirtualPage);
+            feedback.push_back(MakeVirtualPageId(9, 0, 0));
+            feedback.push_back(MakeVirtualPageId(0, 70, 0));
+            feedback.push_back(MakeVirtualPageId(6, 1, 0));
+
+            // Pages resident before the update that the feedback still wants
+            // must survive it.
+            wanted.clear();
+            for (VirtualPageId page : feedback)
+            {
+                if (table.IsResident(page))
+                {
+                    wanted.push_back(page);
+                }
+            }
+
+            const uint64_t callsBefore = mapper.GetCallCount();
+            const uint64_t pagesBefore = mapper.pages;
+            table.AddFeedback(feedback.data(), feedback.size());
+            table.Update(mapper, maxNewPages);
+
+            // One batch per update, covering exactly the new and evicted pages.
+            const VirtualTextureStats& stats = table.GetStats();
+            CHECK(mapper.GetCallCount() - callsBefore == (stats.mappedLastUpdate + stats.evictedLastUpdate > 0 ? 1u : 0u));
+            CHECK(mapper.pages - pagesBefore == stats.mappedLastUpdate + stats.evictedLastUpdate);
+            CHECK(stats.regionsLastUpdate <= stats.mappedLastUpdate + stats.evictedLastUpdate);
+            if (stats.regionsLastUpdate > 0)
+            {
+                changes += stats.mappedLastUpdate + stats.evictedLastUpdate;
+                regions += stats.regionsLastUpdate;
+                batches++;
+            }
+            CHECK(stats.mappedLastUpdate <= maxNewPages);
+            CHECK(table.GetLoads().size() == stats.mappedLastUpdate);
+            for (VirtualPageId page : wanted)
+            {
+                CHECK(table.IsResident(page));
+            }
+
+            for (const PageLoad& load : table.GetLoads())
+            {
+                CHECK(mapper.GetTile(load.page) == load.tile);
+                CHECK(!table.IsResident(load.page));
+                if (Random(&random) % 50 == 0)
+                {
+                    table.OnPageFailed(mapper, load.page);
+                    CHECK(mapper.GetTile(load.page) == NullTile);
+                    failures++;
+                }
+                else
+                {
+                    table.OnPageLoaded(load.page);
+                }
+            }
+            CHECK(table.GetStats().loadingPages == 0);
+            CheckMappings(table, mapper, desc);
+        }
+
+        const VirtualTextureStats& stats = table.GetStats();
+        CHECK(stats.totalEvicted > 0);
+        CHECK(mapper.pages == stats.totalMapped + stats.totalEvicted + failures);
+        printf("panning camera: %u mapping batches, %.1f page changes (%.1f mapped) in %.1f regions per batch\n",
+            batches, static_cast<double>(changes) / batches, static_cast<double>(stats.totalMapped) / batches,
+            static_cast<double>(regions) / batches);
+
+        // Where the residency map allows a mip, it and every coarser one are
+        // there to sample.
+        std::vector<uint8_t> minMip;
+        table.BuildResidencyMap(&minMip);
+        CHECK(minMip.size() == 64 * 64);
+        uint32_t covered = 0;
+        for (uint32_t y = 0; y < desc.heightInPages; y++)
+        {
+            for (uint32_t x = 0; x < desc.widthInPages; x++)
+            {
+                const uint32_t finest = minMip[y * desc.widthInPages + x];
+                covered += finest < desc.mipCount ? 1 : 0;
+                for (uint32_t mip = finest; mip < desc.mipCount; mip++)
+                {
+                    CHECK(table.IsResident(MakeVirtualPageId(mip, x >> mip, y >> mip)));
+                }
+            }
+        }
+        CHECK(covered > 0);
+    }
+
+    // One mip 0 page brings its parents, coarsest first.
+    void TestParentsFirst()
+    {
+        const VirtualTextureDesc desc = { 16, 16, 5, 8 };
+        VirtualPageTable table;
+        table.Reset(desc);
+        SimulatedTileMapper mapper;
+
+        const VirtualPageId page = MakeVirtualPageId(0, 13, 6);
+        for (uint32_t mip = desc.mipCount; mip > 0; mip--)
+        {
+            table.AddFeedback(&page, 1);
+            table.Update(mapper, 1);
+            CHECK(table.GetLoads().size() == 1);
+            CHECK(GetVirtualPageMip(table.GetLoads()[0].page) == mip - 1);
+            table.OnPageLoaded(table.GetLoads()[0].page);
+        }
+        CHECK(table.IsResident(page));
+        CHECK(table.IsResident(MakeVirtualPageId(4, 0, 0)));
+        CHECK(table.GetStats().missingPages == 0);
+    }
+
+    // A row of new pages on consecutive tiles is one region.
+    void TestRowCoalescing()
+    {
+        const VirtualTextureDesc desc = { 16, 16, 1, 64 };
+        VirtualPageTable table;
+        table.Reset(desc);
+        SimulatedTileMapper mapper;
+
+        std::vector<VirtualPageId> row;
+        for (uint32_t x = 0; x < 16; x++)
+        {
+            row.push_back(MakeVirtualPageId(0, x, 3));
+        }
+        table.AddFeedback(row.data(), row.size());
+        table.Update(mapper, 64);
+        CHECK(table.GetStats().mappedLastUpdate == 16);
+        CHECK(table.GetStats().regionsLastUpdate == 1);
+        CHECK(mapper.GetCallCount() == 1);
+        CHECK(mapper.GetRegionCount() == 1);
+    }
+}
+
+int main()
+{
+    TestPanningCamera();
+    TestParentsFirst();
+    TestRowCoalescing();
+    return TestFailures();
+}
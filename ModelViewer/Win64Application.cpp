@@ -12,7 +12,129 @@
 #include "stdafx.h"
 #include "Win64Application.h"
 
+#include <fstream>
+#include <sstream>
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+namespace
+{
+    // Sleeps on a high resolution waitable timer where the OS has one (Windows
+    // 10 1803 and later). Sleep() alone overshoots by up to the 15.6ms system
+    // timer period, which leaves the frame loop spinning most of the frame.
+    class Win64FrameClock : public FrameClock
+    {
+    public: Win64FrameClock()
+        {
+            _timer = CreateWaitableTimerEx(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+            if (_timer == nullptr)
+            {
+                _timer = CreateWaitableTimerEx(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+            }
+        }
+
+    public: virtual ~Win64FrameClock()
+        {
+            if (_timer != nullptr)
+            {
+                CloseHandle(_timer);
+            }
+        }
+
+    public: virtual int64_t NowMicroseconds()
+        {
+            LARGE_INTEGER counter;
+            QueryPerformanceCounter(&counter);
+            return Win64Application::QpcToMicroseconds(counter.QuadPart);
+        }
+
+    public: virtual void SleepMicroseconds(int64_t microseconds)
+        {
+            if (_timer == nullptr)
+            {
+                Sleep(static_cast<DWORD>(microseconds / 1000));
+                return;
+            }
+
+            // Negative due times are relative, in 100ns units.
+            LARGE_INTEGER dueTime;
+            dueTime.QuadPart = -microseconds * 10;
+            if (SetWaitableTimer(_timer, &dueTime, 0, nullptr, nullptr, FALSE))
+            {
+                WaitForSingleObject(_timer, INFINITE);
+            }
+        }
+
+    public: virtual void Spin()
+        {
+            YieldProcessor();
+        }
+
+    private: HANDLE _timer;
+    };
+
+    // Drives a sample through its regular lifecycle, one unpaced frame at a
+    // time, pumping messages in between so the window stays responsive.
+    class DXSampleBenchmarkTarget : public BenchmarkTarget
+    {
+    public: explicit DXSampleBenchmarkTarget(DXSample* pSample) : _pSample(pSample) {}
+
+    public: virtual void LoadBenchmarkScene(const BenchmarkScript& script)
+        {
+            _pSample->OnBenchmarkScene(script);
+        }
+
+    public: virtual void RunBenchmarkFrame(std::vector<ProfileEvent>* pEvents)
+        {
+            MSG msg = {};
+            while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
+            {
+                TranslateMessage(&msg);
+                DispatchMessage(&msg);
+            }
+
+            _pSample->OnUpdate();
+            _pSample->OnRender();
+            _pSample->CollectProfileEvents(pEvents);
+        }
+
+    private: DXSample* _pSample;
+    };
+
+    bool ReadTextFile(const std::wstring& path, std::string* pText)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+        {
+            return false;
+        }
+        std::stringstream text;
+        text << file.rdbuf();
+        *pText = text.str();
+        return true;
+    }
+
+    void ReportBenchmark(const std::string& line)
+    {
+        OutputDebugStringA((line + "\n").c_str());
+    }
+}
+
 HWND Win64Application::m_hwnd = nullptr;
+FrameLoop* Win64Application::m_pFrameLoop = nullptr;
+
+int64_t Win64Application::QpcToMicroseconds(int64_t counter)
+{
+    static const int64_t frequency = []()
+    {
+        LARGE_INTEGER value;
+        QueryPerformanceFrequency(&value);
+        return value.QuadPart;
+    }();
+    return counter / frequency * 1000000 + counter % frequency * 1000000 / frequency;
+}
 
 int Win64Application::Run(DXSample* pSample, HINSTANCE hInstance, int nCmdShow)
 {    
@@ -44,31 +166,166 @@ int Win64Application::Run(DXSample* pSample, HINSTANCE hInstance, int nCmdShow)
         hInstance,
         pSample);
 
+    // -benchmark <script> [-baseline <report>] [-output <report>] [-runtime_shaders] [-low_latency] [-target_fps <rate>]
+    int argc = 0;
+    LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+    std::wstring benchmarkPath;
+    std::wstring baselinePath;
+    std::wstring outputPath = L"benchmark.json";
+    bool runtimeShaders = false;
+    bool lowLatency = false;
+    FrameLoopSettings frameLoopSettings;
+    for (int i = 1; argv != nullptr && i < argc; i++)
+    {
+        if (_wcsicmp(argv[i], L"-benchmark") == 0 && i + 1 < argc)
+        {
+            benchmarkPath = argv[++i];
+        }
+        else if (_wcsicmp(argv[i], L"-baseline") == 0 && i + 1 < argc)
+        {
+            baselinePath = argv[++i];
+        }
+        else if (_wcsicmp(argv[i], L"-output") == 0 && i + 1 < argc)
+        {
+            outputPath = argv[++i];
+        }
+        else if (_wcsicmp(argv[i], L"-runtime_shaders") == 0)
+        {
+            runtimeShaders = true;
+        }
+        else if (_wcsicmp(argv[i], L"-low_latency") == 0)
+        {
+            lowLatency = true;
+        }
+        else if (_wcsicmp(argv[i], L"-target_fps") == 0 && i + 1 < argc)
+        {
+            // 0 paces by presentation alone.
+            const double rate = _wtof(argv[++i]);
+            frameLoopSettings.targetFrameRate = rate > 0.0 ? rate : 0.0;
+        }
+    }
+    LocalFree(argv);
+
     // Initialize the sample. OnInit is defined in each child-implementation of DXSample.
+    pSample->SetRuntimeShaderCompilation(runtimeShaders);
+    pSample->SetLowLatencyPresentation(lowLatency);
     pSample->OnInit();
 
     ShowWindow(m_hwnd, nCmdShow);
 
-    // Main sample loop.
+    if (!benchmarkPath.empty())
+    {
+        const int exitCode = RunBenchmarkMode(pSample, benchmarkPath, baselinePath, outputPath);
+        pSample->OnDestroy();
+        return exitCode;
+    }
+
+    Win64FrameClock clock;
+    FrameLoop frameLoop(clock, frameLoopSettings);
+    m_pFrameLoop = &frameLoop;
+
+    const FrameLoop::UpdateFunction update = [pSample](double stepSeconds)
+    {
+        pSample->OnFixedUpdate(stepSeconds);
+    };
+    // Nothing the sample simulates in fixed steps is drawn yet, so there is
+    // no state to interpolate and the fraction of a step goes unused.
+    const FrameLoop::RenderFunction render = [pSample](double /*interpolation*/)
+    {
+        pSample->OnUpdate();
+        pSample->OnRender();
+    };
+
+    // Main sample loop: drain the message queue, then run one paced frame.
+    // The frame loop sleeps until the frame is due and only wakes up a few
+    // times per second while the window is minimized. In low-latency mode the
+    // sample first waits until its frame should start, so the input read
+    // below is as fresh as it can be when the frame is recorded.
     MSG msg = {};
     while (msg.message != WM_QUIT)
     {
-        // Process any messages in the queue.
-        if (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
+        if (IsIconic(m_hwnd) == FALSE)
+        {
+            pSample->WaitForFrameStart();
+        }
+
+        while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
         {
+            if (msg.message == WM_QUIT)
+            {
+                break;
+            }
             TranslateMessage(&msg);
             DispatchMessage(&msg);
         }
-        pSample->OnUpdate();
-        pSample->OnRender();
+        if (msg.message == WM_QUIT)
+        {
+            break;
+        }
+
+        frameLoop.SetMinimized(IsIconic(m_hwnd) != FALSE);
+        frameLoop.RunFrame(update, render);
     }
 
     pSample->OnDestroy();
+    m_pFrameLoop = nullptr;
 
     // Return this part of the WM_QUIT message to Windows.
     return static_cast<char>(msg.wParam);
 }
 
+// Exit codes: 0 when the run passed the thresholds against the baseline (or
+// there was none), 1 on a regression, 2 when a file could not be used.
+int Win64Application::RunBenchmarkMode(DXSample* pSample, const std::wstring& scriptPath, const std::wstring& baselinePath, const std::wstring& outputPath)
+{
+    std::string text;
+    std::string error;
+    BenchmarkScript script;
+    if (!ReadTextFile(scriptPath, &text) || !ParseBenchmarkScript(text, &script, &error))
+    {
+        ReportBenchmark("benchmark: cannot use the script: " + error);
+        return 2;
+    }
+
+    DXSampleBenchmarkTarget target(pSample);
+    BenchmarkReport report;
+    RunBenchmark(script, target, &report);
+
+    std::string json;
+    WriteBenchmarkJson(report, &json);
+    std::ofstream output(outputPath, std::ios::binary);
+    output.write(json.data(), json.size());
+    ReportBenchmark(json);
+
+    if (baselinePath.empty())
+    {
+        return 0;
+    }
+
+    BenchmarkReport baseline;
+    if (!ReadTextFile(baselinePath, &text) || !ParseBenchmarkJson(text, &baseline, &error))
+    {
+        ReportBenchmark("benchmark: cannot use the baseline: " + error);
+        return 2;
+    }
+
+    std::vector<BenchmarkComparison> comparisons;
+    const bool passed = CompareBenchmarkReports(baseline, report, script.thresholds, &comparisons);
+    for (const BenchmarkComparison& comparison : comparisons)
+    {
+        char line[256];
+        sprintf_s(line, "%s %s: %.3f ms -> %.3f ms, limit %.3f ms%s",
+            comparison.stage.c_str(),
+            comparison.metric.c_str(),
+            comparison.baseline,
+            comparison.current,
+            comparison.limit,
+            comparison.passed ? "" : " REGRESSED");
+        ReportBenchmark(line);
+    }
+    return passed ? 0 : 1;
+}
+
 // Main message handler for the sample.
 LRESULT CALLBACK Win64Application::WindowProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
 {
@@ -99,11 +356,8 @@ LRESULT CALLBACK Win64Application::WindowProc(HWND hWnd, UINT message, WPARAM wP
         return 0;
 
     case WM_PAINT:
-        if (pSample)
-        {
-            pSample->OnUpdate();
-            pSample->OnRender();
-        }
+        // Frames come from the main loop; presenting repaints the window.
+        ValidateRect(hWnd, nullptr);
         return 0;
 
     case WM_DESTROY:
@@ -12,6 +12,7 @@
 #pragma once
 
 #include "DXSample.h"
+#include "FrameLoop.h"
 
 class DXSample;
 
@@ -20,7 +21,18 @@ class Win64Application
 public: static int Run(DXSample* pSample, HINSTANCE hInstance, int nCmdShow);
 public: static HWND GetHwnd() { return m_hwnd; }
 
+    // Pacing of the main loop; only valid while Run() is running.
+public: static FrameLoop* GetFrameLoop() { return m_pFrameLoop; }
+
+    // QueryPerformanceCounter ticks in microseconds, the time base of the
+    // frame loop's clock.
+public: static int64_t QpcToMicroseconds(int64_t counter);
+
+    // Runs the script instead of the paced loop and writes the report.
+private: static int RunBenchmarkMode(DXSample* pSample, const std::wstring& scriptPath, const std::wstring& baselinePath, const std::wstring& outputPath);
+
 protected: static LRESULT CALLBACK WindowProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam);
 
 private: static HWND m_hwnd;
+private: static FrameLoop* m_pFrameLoop;
 };
@@ -0,0 +1,83 @@
+#include "stdafx.h"
+#include "Win64FileWatcher.h"
+#include "ShaderDependencies.h"
+
+#include <algorithm>
+
+namespace
+{
+    std::wstring FromUtf8(const std::string& text)
+    {
+        const int size = MultiByteToWideChar(CP_UTF8, 0, text.c_str(), static_cast<int>(text.size()), nullptr, 0);
+        std::wstring wide(size, L'\0');
+        MultiByteToWideChar(CP_UTF8, 0, text.c_str(), static_cast<int>(text.size()), &wide[0], size);
+        return wide;
+    }
+}
+
+Win64FileWatcher::Win64FileWatcher()
+{
+}
+
+Win64FileWatcher::~Win64FileWatcher()
+{
+    for (HANDLE notification : _notifications)
+    {
+        FindCloseChangeNotification(notification);
+    }
+}
+
+void Win64FileWatcher::Watch(const std::vector<std::string>& files)
+{
+    for (const std::string& file : files)
+    {
+        const std::wstring path = FromUtf8(file);
+        const size_t separator = path.find_last_of(L"\\/");
+        const std::wstring directory = separator == std::wstring::npos ? std::wstring(L".") : path.substr(0, separator);
+        if (std::find(_directories.begin(), _directories.end(), directory) != _directories.end())
+        {
+            continue;
+        }
+        _directories.push_back(directory);
+
+        // Editors save in place or through a renamed temporary; both show up here.
+        const HANDLE notification = FindFirstChangeNotificationW(
+            directory.c_str(),
+            FALSE,
+            FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE);
+        if (notification == INVALID_HANDLE_VALUE)
+        {
+            OutputDebugStringA(("Cannot watch " + file + "\n").c_str());
+            continue;
+        }
+        _notifications.push_back(notification);
+    }
+}
+
+bool Win64FileWatcher::Poll()
+{
+    bool changed = false;
+    for (HANDLE notification : _notifications)
+    {
+        if (WaitForSingleObject(notification, 0) == WAIT_OBJECT_0)
+        {
+            changed = true;
+            FindNextChangeNotification(notification);
+        }
+    }
+    return changed;
+}
+
+bool GetWin64FileStamp(const std::string& path, uint64_t* pStamp)
+{
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (!GetFileAttributesExW(FromUtf8(path).c_str(), GetFileExInfoStandard, &attributes))
+    {
+        return false;
+    }
+
+    const uint64_t writeTime = (static_cast<uint64_t>(attributes.ftLastWriteTime.dwHighDateTime) << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+    const uint64_t size = (static_cast<uint64_t>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+    *pStamp = MakeFileStamp(writeTime, size);
+    return true;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Watches the directories of a set of files with change notifications.
+// Poll() only tells that something in them was written, created or renamed;
+// SourceChangeDetector finds out which files it was.
+class Win64FileWatcher
+{
+public: Win64FileWatcher();
+public: ~Win64FileWatcher();
+
+public: Win64FileWatcher(const Win64FileWatcher&) = delete;
+public: Win64FileWatcher& operator=(const Win64FileWatcher&) = delete;
+
+    // Starts watching the directories of the files not watched yet. Paths are UTF-8.
+public: void Watch(const std::vector<std::string>& files);
+
+    // True when a watched directory changed since the last call. Never blocks.
+public: bool Poll();
+
+private: std::vector<std::wstring> _directories;
+private: std::vector<HANDLE> _notifications;
+};
+
+// FileStampFunction for SourceChangeDetector: last write time and size.
+bool GetWin64FileStamp(const std::string& path, uint64_t* pStamp);
@@ -0,0 +1,241 @@
+//*********************************************************
+//
+// Scene and upscale shaders of the sample. Compiled at runtime with
+// D3DCompileFromFile (vs_5_0/ps_5_0) and at build time with dxc (6.0) by
+// CompileEmbeddedShaders, so nothing here may need more than shader model 5.
+//
+// The scene shaders come in variants; the features are the defines of
+// SceneShaderFeatures in ShaderConstants.cpp:
+//   VERTEX_COLOR  color from the vertex instead of the material
+//   TEXTURE       modulate by the material's texture (procedural for now)
+//   ALPHA_TEST    discard pixels below half coverage
+//
+// Registers are those of SceneBinding in ShaderConstants.h. The root
+// signature comes from RootSignatureBuilder, not from here; every register
+// used must be declared there or the embedded variants fail
+// CheckEmbeddedShaders(). Matrices are row-major with row vectors, as
+// DirectXMath writes them.
+//
+//*********************************************************
+
+// Layouts match ShaderConstants.h, DrawBatcher.h and ClusteredLights.h.
+struct InstanceData
+{
+    row_major float4x4 world;
+};
+
+struct PointLight
+{
+    float3 position;
+    float radius;
+    float3 color;
+    float intensity;
+};
+
+struct ClusterRange
+{
+    uint offset;
+    uint count;
+};
+
+cbuffer FrameConstants : register(b0)
+{
+    float timeSeconds;
+    float deltaSeconds;
+    uint frameNumber;
+};
+
+cbuffer ViewConstants : register(b1)
+{
+    row_major float4x4 viewProjection;
+    float2 viewportSize;
+    float2 inverseViewportSize;
+};
+
+cbuffer DrawConstants : register(b2)
+{
+    uint materialId;
+    uint meshId;
+    uint instanceCount;
+};
+
+cbuffer ClusterConstants : register(b3)
+{
+    uint3 clusterCounts;
+    uint lightCount;
+    float sliceScale;
+    float sliceBias;
+    float farZ;
+};
+
+// The batch's instances; the renderer offsets the root SRV by the batch's
+// first instance, so SV_InstanceID indexes it directly.
+StructuredBuffer<InstanceData> Instances : register(t0);
+
+StructuredBuffer<PointLight> Lights : register(t1);
+StructuredBuffer<ClusterRange> ClusterRanges : register(t2);
+StructuredBuffer<uint> ClusterLightIndices : register(t3);
+
+static const float3 AmbientLight = float3(0.08f, 0.08f, 0.1f);
+
+struct PSInput
+{
+    float4 position : SV_POSITION;
+    float3 worldPosition : WORLDPOS;
+    float3 objectPosition : OBJECTPOS;
+#if VERTEX_COLOR
+    float4 color : COLOR;
+#endif
+};
+
+// Shared by VSMain and VSDepth, and precise, so both produce the same bits
+// and the scene pass passes its depth test against the pre-pass.
+float4 TransformPosition(float3 position, uint instance, out float3 worldPosition)
+{
+    precise float4 world = mul(float4(position, 1.0f), Instances[instance].world);
+    precise float4 clipPosition = mul(world, viewProjection);
+    worldPosition = world.xyz;
+    return clipPosition;
+}
+
+PSInput VSMain(
+    float3 position : POSITION,
+#if VERTEX_COLOR
+    float4 color : COLOR,
+#endif
+    uint instance : SV_InstanceID)
+{
+    PSInput result;
+    result.position = TransformPosition(position, instance, result.worldPosition);
+    result.objectPosition = position;
+#if VERTEX_COLOR
+    result.color = color;
+#endif
+    return result;
+}
+
+float4 VSDepth(float3 position : POSITION, uint instance : SV_InstanceID) : SV_POSITION
+{
+    float3 worldPosition;
+    return TransformPosition(position, instance, worldPosition);
+}
+
+// Until materials carry colors: a stable hue per material.
+float4 GetMaterialColor(uint material)
+{
+    const uint hash = (material + 1) * 2654435761u;
+    return float4(float3(hash & 0xff, (hash >> 8) & 0xff, (hash >> 16) & 0xff) / 255.0f * 0.6f + 0.3f, 1.0f);
+}
+
+// Until materials bind texture descriptors: a procedural checker over the
+// object's own coordinates, whose dark squares are transparent.
+float4 SampleMaterialTexture(float3 objectPosition)
+{
+    const float3 cell = floor(objectPosition * 4.0f);
+    const bool dark = fmod(abs(cell.x + cell.y + cell.z), 2.0f) >= 1.0f;
+    return dark ? float4(0.35f, 0.35f, 0.35f, 0.25f) : float4(1.0f, 1.0f, 1.0f, 1.0f);
+}
+
+// The cluster a pixel belongs to, see ClusterConstants in ShaderConstants.h.
+// False past farZ, where no light was assigned.
+bool GetCluster(float4 position, out uint cluster)
+{
+    cluster = 0;
+    const float viewZ = position.w;
+    if (viewZ > farZ)
+    {
+        return false;
+    }
+
+    const uint2 tile = min(uint2(position.xy * inverseViewportSize * float2(clusterCounts.xy)), clusterCounts.xy - 1);
+    const uint slice = min(uint(max(log(viewZ) * sliceScale + sliceBias, 0.0f)), clusterCounts.z - 1);
+    cluster = tile.x + clusterCounts.x * (tile.y + clusterCounts.y * slice);
+    return true;
+}
+
+// Sums the point lights listed for the pixel's cluster.
+float3 ShadeClusteredLights(float4 position, float3 worldPosition, float3 normal)
+{
+    float3 lighting = float3(0.0f, 0.0f, 0.0f);
+    uint cluster;
+    if (lightCount == 0 || !GetCluster(position, cluster))
+    {
+        return lighting;
+    }
+
+    const ClusterRange range = ClusterRanges[cluster];
+    [loop]
+    for (uint i = 0; i < range.count; i++)
+    {
+        const PointLight light = Lights[ClusterLightIndices[range.offset + i]];
+        const float3 toLight = light.position - worldPosition;
+        const float lightDistance = length(toLight);
+        if (lightDistance >= light.radius)
+        {
+            continue;
+        }
+
+        // Smooth falloff to zero at the radius; clusters may list lights
+        // that do not reach the pixel, which this drops.
+        const float fraction = lightDistance / light.radius;
+        const float falloff = saturate(1.0f - fraction * fraction);
+        const float diffuse = saturate(dot(normal, toLight / max(lightDistance, 1e-4f)));
+        lighting += light.color * (light.intensity * falloff * falloff * diffuse);
+    }
+    return lighting;
+}
+
+float4 PSMain(PSInput input) : SV_TARGET
+{
+#if VERTEX_COLOR
+    float4 color = input.color;
+#else
+    float4 color = GetMaterialColor(materialId);
+#endif
+
+#if TEXTURE
+    color *= SampleMaterialTexture(input.objectPosition);
+#endif
+
+#if ALPHA_TEST
+    clip(color.a - 0.5f);
+#endif
+
+    // No normals in the vertex streams: the face normal from the position
+    // derivatives, which points towards the viewer in a left-handed view.
+    const float3 normal = normalize(cross(ddx(input.worldPosition), ddy(input.worldPosition)));
+    const float3 lighting = AmbientLight + ShadeClusteredLights(input.position, input.worldPosition, normal);
+    return float4(color.rgb * lighting, color.a);
+}
+
+// The upscale pass: one triangle over the back buffer, sampling the part of
+// the scene color that was rendered. b0 holds UpscaleConstants as root
+// constants, t0 the scene color through a table, s0 is a static sampler.
+cbuffer UpscaleConstants : register(b0)
+{
+    float2 uvScale;
+    float2 uvClamp;
+};
+
+Texture2D<float4> SceneColor : register(t0);
+SamplerState LinearClamp : register(s0);
+
+struct UpscaleInput
+{
+    float4 position : SV_POSITION;
+    float2 uv : TEXCOORD;
+};
+
+UpscaleInput VSUpscale(uint vertexId : SV_VertexID)
+{
+    // (0, 0), (2, 0), (0, 2): covers the viewport with one triangle.
+    UpscaleInput result;
+    result.uv = float2((vertexId << 1) & 2, vertexId & 2);
+    result.position = float4(result.uv * float2(2.0f, -2.0f) + float2(-1.0f, 1.0f), 0.0f, 1.0f);
+    return result;
+}
+
+float4 PSUpscale(UpscaleInput input) : SV_TARGET
+{
+    return SceneColor.Sample(LinearClamp, min(input.uv * uvScale, uvClamp));
+}
@@ -8,6 +8,9 @@
 #include <DirectXMath.h>
 #include "d3dx12.h"
 
+#include <chrono>
+#include <memory>
 #include <string>
+#include <vector>
 #include <wrl.h>
 #include <shellapi.h>